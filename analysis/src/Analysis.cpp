@@ -62,7 +62,42 @@ TimedMotionVector3f extractTimedMotionVector(const Sirikata::Trace::ITimedMotion
     return TimedMotionVector3f( tmv.t(), MotionVector3f(tmv.position(), tmv.velocity()) );
 }
 
+namespace {
+// Copies the next field out of a raw binary record, advancing the offset.
+template<typename T>
+bool read_raw_field(const std::string& record, size_t* offset, T* field_out) {
+    if (*offset + sizeof(T) > record.size())
+        return false;
+    memcpy(field_out, record.data() + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+}
+
 Event* Event::parse(uint16 type_hint, const std::string& record, const ServerID& trace_server_id) {
+    // Message timestamps are by far the most common records and are raw
+    // structs, so handle them directly without setting up a stream.
+    if (type_hint == MessageCreationTimestampTag) {
+        MessageCreationTimestampEvent *pevt = new MessageCreationTimestampEvent;
+        size_t offset = 0;
+        if (!read_raw_field(record, &offset, &pevt->time) ||
+            !read_raw_field(record, &offset, &pevt->uid) ||
+            !read_raw_field(record, &offset, &pevt->path) ||
+            !read_raw_field(record, &offset, &pevt->srcport) ||
+            !read_raw_field(record, &offset, &pevt->dstport))
+            SILOG(analysis, error, "Truncated message creation timestamp record");
+        return pevt;
+    }
+    else if (type_hint == MessageTimestampTag) {
+        MessageTimestampEvent *pevt = new MessageTimestampEvent;
+        size_t offset = 0;
+        if (!read_raw_field(record, &offset, &pevt->time) ||
+            !read_raw_field(record, &offset, &pevt->uid) ||
+            !read_raw_field(record, &offset, &pevt->path))
+            SILOG(analysis, error, "Truncated message timestamp record");
+        return pevt;
+    }
+
     std::istringstream record_is(record);
 
     if (!record_is)
@@ -100,22 +135,6 @@ Event* Event::parse(uint16 type_hint, const std::string& record, const ServerID&
     else if (type_hint == ObjectHitPointTag) {
         PARSE_PBJ_RECORD(Trace::Ping::HitPoint);
     }
-    else if (type_hint == MessageCreationTimestampTag) {
-              MessageCreationTimestampEvent *pevt = new MessageCreationTimestampEvent;
-              record_is.read((char*)&pevt->time, sizeof(pevt->time));
-              record_is.read((char*)&pevt->uid, sizeof(pevt->uid));
-              record_is.read((char*)&pevt->path, sizeof(pevt->path));
-              record_is.read((char*)&pevt->srcport, sizeof(pevt->srcport));
-              record_is.read((char*)&pevt->dstport,sizeof(pevt->dstport));
-              evt=pevt;
-          }
-    else if (type_hint == MessageTimestampTag) {
-              MessageTimestampEvent *pevt = new MessageTimestampEvent;
-              record_is.read((char*)&pevt->time, sizeof(pevt->time));
-              record_is.read((char*)&pevt->uid, sizeof(pevt->uid));
-              record_is.read((char*)&pevt->path, sizeof(pevt->path));
-              evt=pevt;
-          }
     else if (type_hint == ServerDatagramQueuedTag) {
         PARSE_PBJ_RECORD(Trace::Datagram::Queued);
         pevt->data.set_source_server(trace_server_id);
@@ -44,96 +44,99 @@ typedef PBJEvent<Trace::Object::GeneratedLoc> GeneratedLocationEvent;
 typedef PBJEvent<Trace::Ping::HitPoint> HitPointEvent;
 
 
-FlowStatsAnalysis::FlowStatsAnalysis(const char* opt_name, const uint32 nservers) {
-    RegionWeightCalculator* swc =
-        RegionWeightCalculatorFactory::getSingleton().getConstructor(GetOptionValue<String>(OPT_REGION_WEIGHT))(GetOptionValue<String>(OPT_REGION_WEIGHT_ARGS))
-;
-    Time smallestHitPointTime(Time::epoch());
-    bool firstHitPointSample=true;
-    for(uint32 server_id = 1; server_id <= nservers; server_id++) {
-        String loc_file = GetPerServerFile(opt_name, server_id);
-        std::ifstream is(loc_file.c_str(), std::ios::in);
-
-        while(is) {
-            uint16 type_hint;
-            std::string raw_evt;
-            if (!read_record(is, &type_hint, &raw_evt)) break;
-            if (!is) break;
-            Event* evt = Event::parse(type_hint, raw_evt, server_id);
-            if (evt == NULL)
-                break;
-
-            {
-                ObjectConnectedEvent* conn_evt = dynamic_cast<ObjectConnectedEvent*>(evt);
-                if (conn_evt != NULL) {
-                    mObjectMap[conn_evt->data.source()].server = conn_evt->data.server();
-                }
-            }
-            {
-                GeneratedLocationEvent* gen_loc_evt = dynamic_cast<GeneratedLocationEvent*>(evt);
-                if (gen_loc_evt != NULL) {
-                    mObjectMap[gen_loc_evt->data.source()].path.add(gen_loc_evt);
-                    mObjectMap[gen_loc_evt->data.source()].bounds = gen_loc_evt->data.bounds();
-                }
-            }
-            {
-                PingCreatedEvent* ping_evt = dynamic_cast<PingCreatedEvent*>(evt);
-                if (ping_evt != NULL) {
-                    mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].sent_count++;
-                    mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].sent_bytes += ping_evt->data.size();
-                }
-            }
-            {
-                PingEvent* ping_evt = dynamic_cast<PingEvent*>(evt);
-                if (ping_evt != NULL) {
-                    mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].recv_count++;
-                    mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].recv_bytes += ping_evt->data.size();
-                }
-            }
+FlowStatsAnalysis::FlowStatsAnalysis()
+ : mWeightCalculator(
+     RegionWeightCalculatorFactory::getSingleton().getConstructor(GetOptionValue<String>(OPT_REGION_WEIGHT))(GetOptionValue<String>(OPT_REGION_WEIGHT_ARGS))
+   ),
+   mSmallestHitPointTime(Time::epoch()),
+   mFirstHitPointSample(true)
+{
+}
 
-            {
-                HitPointEvent* ping_evt = dynamic_cast<HitPointEvent*>(evt);
-                if (ping_evt != NULL) {
-                    HitPointInfo * hpi=NULL;
-                    ObjectPair pair(ping_evt->data.sender(),ping_evt->data.receiver());
-                    if (mHitPointMap.find(pair)==mHitPointMap.end()) {
-                        
-                        ObjectMap::iterator source_it = mObjectMap.find(ping_evt->data.sender());
-                        ObjectMap::iterator dest_it = mObjectMap.find(ping_evt->data.receiver());
-                        if (source_it!=mObjectMap.end()&&dest_it!=mObjectMap.end()) {
-                            hpi=&mHitPointMap[pair];
-                            hpi->distance=ping_evt->data.distance();
-                            TimedMotionVector3f start1 = source_it->second.path.initial();
-                            TimedMotionVector3f start2 = dest_it->second.path.initial();
-                            
-                            BoundingBox3f world_bounds1 = BoundingBox3f(source_it->second.bounds.center() + start1.position(), source_it->second.bounds.radius());
-                            BoundingBox3f world_bounds2 = BoundingBox3f(dest_it->second.bounds.center() + start2.position(), dest_it->second.bounds.radius());
-                            double priority = swc->weight(world_bounds1, world_bounds2);
-
-
-                            hpi->weight=priority;
-                        }else {
-                            SILOG(analysis,error, "Unable to find "<<ping_evt->data.sender().toString()<<" and/or "<<ping_evt->data.receiver().toString());
-                        }
-                    }else {
-                        hpi=&mHitPointMap[pair];
-                    }
-                    hpi->samples.push_back(HitPointInfo::Sample(ping_evt->data.t(),ping_evt->data.received()));
-                    
-                    hpi->samples.back().starthp=ping_evt->data.sent_hp();
-                    hpi->samples.back().endhp=ping_evt->data.actual_hp();
-                    if(firstHitPointSample) 
-                        smallestHitPointTime=ping_evt->data.t();
-                    else if (smallestHitPointTime>ping_evt->data.t()) {
-                        smallestHitPointTime=ping_evt->data.t();
-                    }
-                    firstHitPointSample=false;
+FlowStatsAnalysis::~FlowStatsAnalysis() {
+    delete mWeightCalculator;
+}
+
+bool FlowStatsAnalysis::wants(uint16 type_hint) const {
+    return (type_hint == ObjectConnectedTag ||
+        type_hint == ObjectGeneratedLocationTag ||
+        type_hint == ObjectPingCreatedTag ||
+        type_hint == ObjectPingTag ||
+        type_hint == ObjectHitPointTag);
+}
+
+void FlowStatsAnalysis::handleEvent(const Event* evt, ServerID server) {
+    {
+        const ObjectConnectedEvent* conn_evt = dynamic_cast<const ObjectConnectedEvent*>(evt);
+        if (conn_evt != NULL) {
+            mObjectMap[conn_evt->data.source()].server = conn_evt->data.server();
+        }
+    }
+    {
+        const GeneratedLocationEvent* gen_loc_evt = dynamic_cast<const GeneratedLocationEvent*>(evt);
+        if (gen_loc_evt != NULL) {
+            mObjectMap[gen_loc_evt->data.source()].path.add(gen_loc_evt);
+            mObjectMap[gen_loc_evt->data.source()].bounds = gen_loc_evt->data.bounds();
+        }
+    }
+    {
+        const PingCreatedEvent* ping_evt = dynamic_cast<const PingCreatedEvent*>(evt);
+        if (ping_evt != NULL) {
+            mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].sent_count++;
+            mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].sent_bytes += ping_evt->data.size();
+        }
+    }
+    {
+        const PingEvent* ping_evt = dynamic_cast<const PingEvent*>(evt);
+        if (ping_evt != NULL) {
+            mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].recv_count++;
+            mFlowMap[ ObjectPair(ping_evt->data.sender(),ping_evt->data.receiver()) ].recv_bytes += ping_evt->data.size();
+        }
+    }
+
+    {
+        const HitPointEvent* ping_evt = dynamic_cast<const HitPointEvent*>(evt);
+        if (ping_evt != NULL) {
+            HitPointInfo * hpi=NULL;
+            ObjectPair pair(ping_evt->data.sender(),ping_evt->data.receiver());
+            if (mHitPointMap.find(pair)==mHitPointMap.end()) {
+                
+                ObjectMap::iterator source_it = mObjectMap.find(ping_evt->data.sender());
+                ObjectMap::iterator dest_it = mObjectMap.find(ping_evt->data.receiver());
+                if (source_it!=mObjectMap.end()&&dest_it!=mObjectMap.end()) {
+                    hpi=&mHitPointMap[pair];
+                    hpi->distance=ping_evt->data.distance();
+                    TimedMotionVector3f start1 = source_it->second.path.initial();
+                    TimedMotionVector3f start2 = dest_it->second.path.initial();
                     
+                    BoundingBox3f world_bounds1 = BoundingBox3f(source_it->second.bounds.center() + start1.position(), source_it->second.bounds.radius());
+                    BoundingBox3f world_bounds2 = BoundingBox3f(dest_it->second.bounds.center() + start2.position(), dest_it->second.bounds.radius());
+                    double priority = mWeightCalculator->weight(world_bounds1, world_bounds2);
+
+
+                    hpi->weight=priority;
+                }else {
+                    SILOG(analysis,error, "Unable to find "<<ping_evt->data.sender().toString()<<" and/or "<<ping_evt->data.receiver().toString());
                 }
+            }else {
+                hpi=&mHitPointMap[pair];
+            }
+            hpi->samples.push_back(HitPointInfo::Sample(ping_evt->data.t(),ping_evt->data.received()));
+            
+            hpi->samples.back().starthp=ping_evt->data.sent_hp();
+            hpi->samples.back().endhp=ping_evt->data.actual_hp();
+            if(mFirstHitPointSample) 
+                mSmallestHitPointTime=ping_evt->data.t();
+            else if (mSmallestHitPointTime>ping_evt->data.t()) {
+                mSmallestHitPointTime=ping_evt->data.t();
             }
-            delete evt;
+            mFirstHitPointSample=false;
+            
         }
     }
+}
+
+void FlowStatsAnalysis::finish() {
     if (mHitPointMap.size()) {
         FILE * fp = fopen("hitpointstats.txt","w");
         if (fp )  {
@@ -145,8 +148,8 @@ FlowStatsAnalysis::FlowStatsAnalysis(const char* opt_name, const uint32 nservers
                 for (size_t j=0;j<i->second.samples.size();++j) {
                     HitPointInfo::Sample  s= i->second.samples[j];
                     fprintf(fp,", %f, %f, %f, %f",
-                            (s.start-smallestHitPointTime).toSeconds(),
-                            (s.end-smallestHitPointTime).toSeconds(),
+                            (s.start-mSmallestHitPointTime).toSeconds(),
+                            (s.end-mSmallestHitPointTime).toSeconds(),
                             s.starthp,
                             s.endhp);
                             
@@ -176,7 +179,7 @@ FlowStatsAnalysis::FlowStatsAnalysis(const char* opt_name, const uint32 nservers
 
         double server_priority = 0.0; // FIXME
         double distance_priority = 0.0; // FIXME
-        double priority = swc->weight(world_bounds1, world_bounds2);
+        double priority = mWeightCalculator->weight(world_bounds1, world_bounds2);
         uint64 recv_bytes = it->second.recv_bytes;
         uint64 sent_bytes = it->second.sent_bytes;
 
@@ -193,8 +196,6 @@ FlowStatsAnalysis::FlowStatsAnalysis(const char* opt_name, const uint32 nservers
             sent_bytes
         );
     }
-
-    delete swc;
 }
 
 } // namespace Sirikata
@@ -35,18 +35,32 @@
 
 #include <sirikata/core/trace/Trace.hpp>
 #include "RecordedMotionPath.hpp"
+#include "TraceStream.hpp"
 
 namespace Sirikata {
 
+class RegionWeightCalculator;
+
 /** Generates summary statistics on a per flow basis.  A flow is data between an
  *  ordered pair of objects (source, dest).  Summary information includes
- *  weights, sent bytes, received bytes.
+ *  weights, sent bytes, received bytes. Run it over the traces with a
+ *  TraceAnalysisPipeline, results are reported when it finishes.
  */
-class FlowStatsAnalysis {
+class FlowStatsAnalysis : public TraceEventHandler {
 public:
-    FlowStatsAnalysis(const char* opt_name, const uint32 nservers);
+    FlowStatsAnalysis();
+    ~FlowStatsAnalysis();
+
+    // TraceEventHandler Interface
+    virtual bool wants(uint16 type_hint) const;
+    virtual void handleEvent(const Event* evt, ServerID server);
+    virtual void finish();
 
 private:
+    RegionWeightCalculator* mWeightCalculator;
+    Time mSmallestHitPointTime;
+    bool mFirstHitPointSample;
+
     struct ObjectInfo {
         ServerID server;
         RecordedMotionPath path;
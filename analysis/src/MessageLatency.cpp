@@ -74,6 +74,17 @@ class Average {
     uint32 samples() const {
         return numSamples;
     }
+
+    void save(std::ostream& os) const {
+        WriteCheckpointValue(os, sample_sum);
+        WriteCheckpointValue(os, sample2_sum);
+        WriteCheckpointValue(os, numSamples);
+    }
+    bool load(std::istream& is) {
+        return ReadCheckpointValue(is, &sample_sum) &&
+            ReadCheckpointValue(is, &sample2_sum) &&
+            ReadCheckpointValue(is, &numSamples);
+    }
 };
 
 
@@ -201,6 +212,8 @@ class PacketData {
     uint64 id;
     ObjectMessagePort source_port;
     ObjectMessagePort dest_port;
+    // Latest timestamp seen for the packet
+    Time last_stamp;
 
     typedef std::map<uint32, PacketSampleList> ServerPacketMap;
 
@@ -209,7 +222,8 @@ class PacketData {
     PacketData()
             : id(0),
               source_port(0),
-              dest_port(0)
+              dest_port(0),
+              last_stamp(Time::null())
     {
     }
 };
@@ -823,195 +837,309 @@ MessageLatencyFilters::MessageLatencyFilters(ObjectMessagePort *destPort, const
 
 
 
-void MessageLatencyAnalysis(const char* opt_name, const uint32 nservers, MessageLatencyFilters filter, const String& stage_dump_filename)
-{
-    // Setup the graph of valid stage transitions
-    PacketStageGraph stage_graph;
-
-    stage_graph.addEdge(Trace::CREATED, Trace::OH_HIT_NETWORK);
-    stage_graph.addEdge(Trace::CREATED, Trace::OH_DROPPED_AT_SEND); // drop
-
-    stage_graph.addEdge(Trace::OH_HIT_NETWORK, Trace::HANDLE_OBJECT_HOST_MESSAGE, PacketStageGraph::ASYNC);
-    stage_graph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::FORWARDED_LOCALLY);
-    stage_graph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::OSEG_CACHE_CHECK_STARTED);
-    stage_graph.addEdge(Trace::OSEG_CACHE_CHECK_STARTED, Trace::OSEG_CACHE_CHECK_FINISHED);
-    stage_graph.addEdge(Trace::OSEG_CACHE_CHECK_FINISHED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
-    stage_graph.addEdge(Trace::OSEG_CACHE_CHECK_FINISHED, Trace::FORWARDING_STARTED);
-    stage_graph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING); // drop
-
-    stage_graph.addEdge(Trace::HANDLE_SPACE_MESSAGE, Trace::FORWARDING_STARTED);
-
-    stage_graph.addEdge(Trace::FORWARDED_LOCALLY, Trace::DROPPED_AT_FORWARDED_LOCALLY); // drop
-    stage_graph.addEdge(Trace::FORWARDED_LOCALLY, Trace::SPACE_TO_OH_ENQUEUED);
-
-    stage_graph.addEdge(Trace::FORWARDING_STARTED, Trace::FORWARDED_LOCALLY_SLOW_PATH);
-    stage_graph.addEdge(Trace::FORWARDING_STARTED, Trace::OSEG_LOOKUP_STARTED);
-
-    stage_graph.addEdge(Trace::FORWARDED_LOCALLY_SLOW_PATH, Trace::SPACE_TO_OH_ENQUEUED);
-    stage_graph.addEdge(Trace::FORWARDED_LOCALLY_SLOW_PATH, Trace::DROPPED_DURING_FORWARDING); // drop
-
-    stage_graph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::DROPPED_DURING_FORWARDING); // drop
-    stage_graph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
-    stage_graph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::OSEG_SERVER_LOOKUP_FINISHED);
-    stage_graph.addEdge(Trace::OSEG_CACHE_LOOKUP_FINISHED, Trace::OSEG_LOOKUP_FINISHED);
-    stage_graph.addEdge(Trace::OSEG_SERVER_LOOKUP_FINISHED, Trace::OSEG_LOOKUP_FINISHED);
-
-    stage_graph.addEdge(Trace::OSEG_LOOKUP_FINISHED, Trace::SPACE_TO_SPACE_ENQUEUED);
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_ENQUEUED, Trace::DROPPED_AT_SPACE_ENQUEUED); // drop
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_ENQUEUED, Trace::SPACE_TO_SPACE_HIT_NETWORK);
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_HIT_NETWORK, Trace::SPACE_TO_SPACE_READ_FROM_NET, PacketStageGraph::ASYNC);
-
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_READ_FROM_NET, Trace::SPACE_TO_SPACE_SMR_DEQUEUED);
-
-    // Slow path out of SMR
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::HANDLE_SPACE_MESSAGE);
-    // Fast path(s) out of SMR
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::FORWARDED_LOCALLY);
-    stage_graph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
-
-    stage_graph.addEdge(Trace::SPACE_TO_OH_ENQUEUED, Trace::OH_NET_RECEIVED, PacketStageGraph::ASYNC);
-    stage_graph.addEdge(Trace::OH_NET_RECEIVED, Trace::OH_RECEIVED);
-    stage_graph.addEdge(Trace::OH_NET_RECEIVED, Trace::OH_DROPPED_AT_RECEIVE_QUEUE); // drop
-    stage_graph.addEdge(Trace::OH_RECEIVED, Trace::DESTROYED);
-
-    // In order to handle large traces, we use a multi-pass approach. Each pass
-    // over the data does 2 things:
-    //  1. Collect timestamp info for a subset of the packets and process them.
-    //  2. Figure out next group of packet IDs to consider.
-    // Each pass processes a fixed number of packets (or possibly fewer for the
-    // last pass).
-    //
-    // In order to minimize the state we need to maintain between passes we
-    // define the current and next group of packets we need to process
-    // implicitly. We assume we're going to try to process as many as N packets
-    // each pass.  We just choose a minimum packet ID m to start collecting
-    // packets and choose the N packets from the entire trace with the smallest
-    // packet IDs greater than than m.  Our starting point for the next round is
-    // then the largest packet ID from the current round.  For the first round,
-    // the base packet ID will obviously be 0.
+struct MessageLatencyAnalysis::Impl {
+    Impl(MessageLatencyFilters f, const Duration& _horizon, const String& stage_dump_filename)
+     : filter(f),
+       horizon(_horizon),
+       stageDumpFilename(stage_dump_filename),
+       stageDumpFile(NULL)
+    {
+        // Setup the graph of valid stage transitions
+        stageGraph.addEdge(Trace::CREATED, Trace::OH_HIT_NETWORK);
+        stageGraph.addEdge(Trace::CREATED, Trace::OH_DROPPED_AT_SEND); // drop
+
+        stageGraph.addEdge(Trace::OH_HIT_NETWORK, Trace::HANDLE_OBJECT_HOST_MESSAGE, PacketStageGraph::ASYNC);
+        stageGraph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::FORWARDED_LOCALLY);
+        stageGraph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::OSEG_CACHE_CHECK_STARTED);
+        stageGraph.addEdge(Trace::OSEG_CACHE_CHECK_STARTED, Trace::OSEG_CACHE_CHECK_FINISHED);
+        stageGraph.addEdge(Trace::OSEG_CACHE_CHECK_FINISHED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
+        stageGraph.addEdge(Trace::OSEG_CACHE_CHECK_FINISHED, Trace::FORWARDING_STARTED);
+        stageGraph.addEdge(Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING); // drop
+
+        stageGraph.addEdge(Trace::HANDLE_SPACE_MESSAGE, Trace::FORWARDING_STARTED);
+
+        stageGraph.addEdge(Trace::FORWARDED_LOCALLY, Trace::DROPPED_AT_FORWARDED_LOCALLY); // drop
+        stageGraph.addEdge(Trace::FORWARDED_LOCALLY, Trace::SPACE_TO_OH_ENQUEUED);
+
+        stageGraph.addEdge(Trace::FORWARDING_STARTED, Trace::FORWARDED_LOCALLY_SLOW_PATH);
+        stageGraph.addEdge(Trace::FORWARDING_STARTED, Trace::OSEG_LOOKUP_STARTED);
+
+        stageGraph.addEdge(Trace::FORWARDED_LOCALLY_SLOW_PATH, Trace::SPACE_TO_OH_ENQUEUED);
+        stageGraph.addEdge(Trace::FORWARDED_LOCALLY_SLOW_PATH, Trace::DROPPED_DURING_FORWARDING); // drop
+
+        stageGraph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::DROPPED_DURING_FORWARDING); // drop
+        stageGraph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
+        stageGraph.addEdge(Trace::OSEG_LOOKUP_STARTED, Trace::OSEG_SERVER_LOOKUP_FINISHED);
+        stageGraph.addEdge(Trace::OSEG_CACHE_LOOKUP_FINISHED, Trace::OSEG_LOOKUP_FINISHED);
+        stageGraph.addEdge(Trace::OSEG_SERVER_LOOKUP_FINISHED, Trace::OSEG_LOOKUP_FINISHED);
+
+        stageGraph.addEdge(Trace::OSEG_LOOKUP_FINISHED, Trace::SPACE_TO_SPACE_ENQUEUED);
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_ENQUEUED, Trace::DROPPED_AT_SPACE_ENQUEUED); // drop
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_ENQUEUED, Trace::SPACE_TO_SPACE_HIT_NETWORK);
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_HIT_NETWORK, Trace::SPACE_TO_SPACE_READ_FROM_NET, PacketStageGraph::ASYNC);
+
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_READ_FROM_NET, Trace::SPACE_TO_SPACE_SMR_DEQUEUED);
+
+        // Slow path out of SMR
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::HANDLE_SPACE_MESSAGE);
+        // Fast path(s) out of SMR
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::FORWARDED_LOCALLY);
+        stageGraph.addEdge(Trace::SPACE_TO_SPACE_SMR_DEQUEUED, Trace::OSEG_CACHE_LOOKUP_FINISHED);
+
+        stageGraph.addEdge(Trace::SPACE_TO_OH_ENQUEUED, Trace::OH_NET_RECEIVED, PacketStageGraph::ASYNC);
+        stageGraph.addEdge(Trace::OH_NET_RECEIVED, Trace::OH_RECEIVED);
+        stageGraph.addEdge(Trace::OH_NET_RECEIVED, Trace::OH_DROPPED_AT_RECEIVE_QUEUE); // drop
+        stageGraph.addEdge(Trace::OH_RECEIVED, Trace::DESTROYED);
+    }
 
-    typedef std::tr1::unordered_map<uint64,PacketData> PacketMap;
-    typedef std::priority_queue<uint64> PacketIDPriority;
+    ~Impl() {
+        closeStageDump();
+    }
+
+    // The stage dump is opened lazily so a restored checkpoint can continue
+    // writing where it left off instead of truncating it.
+    bool openStageDump(int64 offset) {
+        if (stageDumpFilename.empty() || stageDumpFile != NULL)
+            return true;
+
+        if (offset <= 0) {
+            stageDumpFile = new std::fstream(stageDumpFilename.c_str(), std::ios::out | std::ios::trunc);
+        }
+        else {
+            stageDumpFile = new std::fstream(stageDumpFilename.c_str(), std::ios::in | std::ios::out);
+            stageDumpFile->seekp(offset);
+        }
+        if (!(*stageDumpFile)) {
+            ERROR_LOG("Couldn't open stage dump file " << stageDumpFilename);
+            delete stageDumpFile;
+            stageDumpFile = NULL;
+            stageDumpFilename = "";
+            return false;
+        }
+        return true;
+    }
+
+    void closeStageDump() {
+        if (stageDumpFile) {
+            stageDumpFile->close();
+            delete stageDumpFile;
+            stageDumpFile = NULL;
+        }
+    }
+
+    // Perform a stable sort for each packet's server timestamp lists, then try
+    // to match it to the graph.
+    // Note that the stable sort is only necessary because the logging is
+    // multithreaded and may not get everything perfectly in order.
+    void process(PacketData& pd) {
+        if ( !matches(filter, pd) || (pd.stamps.size() == 0) ) return;
+
+        for(PacketData::ServerPacketMap::iterator server_it = pd.stamps.begin();
+            server_it != pd.stamps.end();
+            server_it++) {
+            std::stable_sort(server_it->second.begin(), server_it->second.end());
+        }
+
+        openStageDump(0);
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+        stageGraph.match_path(pd, std::tr1::bind(&reportPair, _1, _2, &results, stageDumpFile));
+    }
 
-    // Prepare output data structures
-    std::ofstream* stage_dump_file = NULL;
-    if (!stage_dump_filename.empty()) {
-        stage_dump_file = new std::ofstream(stage_dump_filename.c_str());
+    // Process all packets which haven't been stamped within the horizon.
+    void expire(const Time& now) {
+        while(!lastStamps.empty() && lastStamps.front().time + horizon < now) {
+            LastStamp ls = lastStamps.front();
+            lastStamps.pop_front();
+
+            PacketMap::iterator it = packets.find(ls.id);
+            // Skip packets which have been stamped since this entry was added
+            if (it == packets.end() || it->second.last_stamp != ls.time)
+                continue;
+
+            process(it->second);
+            packets.erase(it);
+        }
     }
+
+    MessageLatencyFilters filter;
+    Duration horizon;
+    PacketStageGraph stageGraph;
+
+    typedef std::tr1::unordered_map<uint64,PacketData> PacketMap;
+    PacketMap packets;
+    // Packets in the order they were last stamped. An entry is added each
+    // time a packet is stamped, so older entries for a packet are stale.
+    struct LastStamp {
+        Time time;
+        uint64 id;
+    };
+    std::deque<LastStamp> lastStamps;
+
     PathAverageMap results;
+    String stageDumpFilename;
+    std::fstream* stageDumpFile;
+};
 
+MessageLatencyAnalysis::MessageLatencyAnalysis(MessageLatencyFilters filter, const Duration& horizon, const String& stage_dump_filename)
+ : mImpl(new Impl(filter, horizon, stage_dump_filename))
+{
+}
+
+MessageLatencyAnalysis::~MessageLatencyAnalysis() {
+    delete mImpl;
+}
+
+bool MessageLatencyAnalysis::wants(uint16 type_hint) const {
+    return (type_hint == MessageTimestampTag || type_hint == MessageCreationTimestampTag);
+}
+
+void MessageLatencyAnalysis::handleEvent(const Event* evt, ServerID server_id) {
+    const MessageTimestampEvent* tevt = dynamic_cast<const MessageTimestampEvent*>(evt);
+    if (tevt == NULL) return;
+
+    mImpl->expire(tevt->time);
+
+    PacketData* pd = &mImpl->packets[tevt->uid];
+    pd->id = tevt->uid;
+    pd->stamps[server_id].push_back(PacketSample(tevt->time, server_id, tevt->path));
+    const MessageCreationTimestampEvent* cevt = dynamic_cast<const MessageCreationTimestampEvent*>(evt);
+    if (cevt != NULL) {
+        if (cevt->srcport!=0) pd->source_port = cevt->srcport;
+        if (cevt->dstport!=0) pd->dest_port = cevt->dstport;
+    }
+
+    if (pd->last_stamp < tevt->time)
+        pd->last_stamp = tevt->time;
+    Impl::LastStamp ls;
+    ls.time = pd->last_stamp;
+    ls.id = tevt->uid;
+    mImpl->lastStamps.push_back(ls);
+}
+
+void MessageLatencyAnalysis::finish() {
+    // Anything left is either complete or was still in flight when the trace
+    // ended.
+    for (Impl::PacketMap::iterator iter = mImpl->packets.begin(),ie=mImpl->packets.end();
+         iter!=ie;
+         ++iter) {
+        mImpl->process(iter->second);
+    }
+    mImpl->packets.clear();
+    mImpl->lastStamps.clear();
+
+    mImpl->closeStageDump();
+
+    // Report results for all stages which we've found pairs for
     using std::tr1::placeholders::_1;
-    using std::tr1::placeholders::_2;
-    ReportPairFunction report_func = std::tr1::bind(&reportPair, _1, _2, &results, stage_dump_file);
-
-    // Round data
-    uint32 round_max_packets = 1024*1024; // maximum # of packets per round
-    uint64 round_base_id = 0; // we'll choose from ID's greater than this, and
-                              // it will be updated at the end of each round
-    while(true) { // condition near bottom will break out of loop if we end up
-                  // processing fewer than our target number of packets
-
-        PacketMap packetFlow;
-        PacketIDPriority packetPriorities;
-
-        // Read in data for this round
-        for(uint32 server_id = 1; server_id <= nservers; server_id++) {
-            String loc_file = GetPerServerFile(opt_name, server_id);
-            std::ifstream is(loc_file.c_str(), std::ios::in);
-
-            while(is) {
-                uint16 type_hint;
-                std::string raw_evt;
-                if (!read_record(is, &type_hint, &raw_evt)) break;
-                Event* evt = Event::parse(type_hint, raw_evt, server_id);
-                if (evt == NULL)
-                    break;
+    mImpl->stageGraph.depth_first_edge_traversal(
+        std::tr1::bind(&reportStats, _1, &mImpl->results)
+                                           );
+}
 
-                {
-                    MessageTimestampEvent* tevt = dynamic_cast<MessageTimestampEvent*>(evt);
-                    if (tevt != NULL) {
-                        uint64 pid = tevt->uid;
-
-                        // Figure out if we need to / can add this packet
-                        bool should_insert = false;
-                        if (packetFlow.find(pid) != packetFlow.end()) {
-                            should_insert = true;
-                        }
-                        else {
-                            if (pid > round_base_id) {
-                                // Either we fit in now problem
-                                if (packetPriorities.size() < round_max_packets) {
-                                    packetPriorities.push(pid);
-                                    should_insert = true;
-                                }
-                                else {
-                                    // Or we need to evict, or are ignored
-                                    uint64 top_pid = packetPriorities.top();
-                                    if (top_pid > pid) {
-                                        packetPriorities.pop();
-                                        packetFlow.erase(top_pid);
-                                        packetPriorities.push(pid);
-                                        should_insert = true;
-                                    }
-                                }
-                            }
-                        }
-
-                        if (should_insert) {
-                            PacketData* pd = &packetFlow[tevt->uid];
-                            pd->stamps[server_id].push_back(PacketSample(tevt->time, server_id, tevt->path));
-                            MessageCreationTimestampEvent* cevt = dynamic_cast<MessageCreationTimestampEvent*>(evt);
-                            if (cevt != NULL) {
-                                if (cevt->srcport!=0) pd->source_port = cevt->srcport;
-                                if (cevt->dstport!=0) pd->dest_port = cevt->dstport;
-                            }
-                        }
-                    }
-                }
-                delete evt;
+bool MessageLatencyAnalysis::saveCheckpoint(std::ostream& os) {
+    int64 stage_dump_offset = 0;
+    if (mImpl->stageDumpFile != NULL) {
+        mImpl->stageDumpFile->flush();
+        stage_dump_offset = mImpl->stageDumpFile->tellp();
+    }
+    WriteCheckpointValue(os, stage_dump_offset);
+
+    WriteCheckpointValue(os, (uint32)mImpl->results.size());
+    for(PathAverageMap::iterator it = mImpl->results.begin(); it != mImpl->results.end(); it++) {
+        WriteCheckpointValue(os, (uint32)it->first.first);
+        WriteCheckpointValue(os, (uint32)it->first.second);
+        it->second.save(os);
+    }
+
+    WriteCheckpointValue(os, (uint64)mImpl->packets.size());
+    for (Impl::PacketMap::iterator it = mImpl->packets.begin(); it != mImpl->packets.end(); it++) {
+        const PacketData& pd = it->second;
+        WriteCheckpointValue(os, pd.id);
+        WriteCheckpointValue(os, pd.source_port);
+        WriteCheckpointValue(os, pd.dest_port);
+        WriteCheckpointValue(os, pd.last_stamp.raw());
+        WriteCheckpointValue(os, (uint32)pd.stamps.size());
+        for(PacketData::ServerPacketMap::const_iterator server_it = pd.stamps.begin(); server_it != pd.stamps.end(); server_it++) {
+            WriteCheckpointValue(os, server_it->first);
+            WriteCheckpointValue(os, (uint32)server_it->second.size());
+            for(PacketSampleList::const_iterator sample_it = server_it->second.begin(); sample_it != server_it->second.end(); sample_it++) {
+                WriteCheckpointValue(os, sample_it->raw());
+                WriteCheckpointValue(os, (uint32)sample_it->tag);
             }
         }
+    }
 
-        // Perform a stable sort for each packet's server timestamp lists, then try
-        // to match it to the graph.
-        // Note that the stable sort is only necessary because the logging is
-        // multithreaded and may not get everything perfectly in order.
-        for (PacketMap::iterator iter = packetFlow.begin(),ie=packetFlow.end();
-             iter!=ie;
-             ++iter) {
-            PacketData& pd = iter->second;
-            if ( !matches(filter, pd) || (pd.stamps.size() == 0) ) continue;
-
-            for(PacketData::ServerPacketMap::iterator server_it = pd.stamps.begin();
-                server_it != pd.stamps.end();
-                server_it++) {
-                std::stable_sort(server_it->second.begin(), server_it->second.end());
-            }
+    WriteCheckpointValue(os, (uint64)mImpl->lastStamps.size());
+    for(std::deque<Impl::LastStamp>::iterator it = mImpl->lastStamps.begin(); it != mImpl->lastStamps.end(); it++) {
+        WriteCheckpointValue(os, it->time.raw());
+        WriteCheckpointValue(os, it->id);
+    }
 
-            stage_graph.match_path(pd, report_func);
-        }
+    return os.good();
+}
+
+bool MessageLatencyAnalysis::loadCheckpoint(std::istream& is) {
+    mImpl->results.clear();
+    mImpl->packets.clear();
+    mImpl->lastStamps.clear();
+
+    int64 stage_dump_offset;
+    if (!ReadCheckpointValue(is, &stage_dump_offset)) return false;
+    mImpl->closeStageDump();
+    if (!mImpl->openStageDump(stage_dump_offset)) return false;
+
+    uint32 nresults;
+    if (!ReadCheckpointValue(is, &nresults)) return false;
+    for(uint32 i = 0; i < nresults; i++) {
+        uint32 first, second;
+        if (!ReadCheckpointValue(is, &first) || !ReadCheckpointValue(is, &second))
+            return false;
+        PathPair pp((Trace::MessagePath)first, (Trace::MessagePath)second);
+        if (!mImpl->results[pp].load(is)) return false;
+    }
 
-        // Finally, with all of this rounds packets report, prepare for next round
-        if (packetPriorities.empty()) {
-            SILOG(analysis,error,"Empty packet priorities\n");
-            break;
+    uint64 npackets;
+    if (!ReadCheckpointValue(is, &npackets)) return false;
+    for(uint64 i = 0; i < npackets; i++) {
+        uint64 id, last_stamp;
+        if (!ReadCheckpointValue(is, &id)) return false;
+        PacketData& pd = mImpl->packets[id];
+        pd.id = id;
+        uint32 nservers;
+        if (!ReadCheckpointValue(is, &pd.source_port) ||
+            !ReadCheckpointValue(is, &pd.dest_port) ||
+            !ReadCheckpointValue(is, &last_stamp) ||
+            !ReadCheckpointValue(is, &nservers))
+            return false;
+        pd.last_stamp = Time::microseconds(last_stamp);
+        for(uint32 si = 0; si < nservers; si++) {
+            uint32 server_id, nsamples;
+            if (!ReadCheckpointValue(is, &server_id) || !ReadCheckpointValue(is, &nsamples))
+                return false;
+            PacketSampleList& samples = pd.stamps[server_id];
+            for(uint32 sample_idx = 0; sample_idx < nsamples; sample_idx++) {
+                uint64 t;
+                uint32 tag;
+                if (!ReadCheckpointValue(is, &t) || !ReadCheckpointValue(is, &tag))
+                    return false;
+                samples.push_back(PacketSample(Time::microseconds(t), server_id, (Trace::MessagePath)tag));
+            }
         }
-        round_base_id = packetPriorities.top();
-        // We can stop when we had fewer than our max number of packets for the round
-        if (packetPriorities.size() < round_max_packets)
-            break;
     }
 
-    if (stage_dump_file) {
-        stage_dump_file->close();
-        delete stage_dump_file;
-        stage_dump_file = NULL;
+    uint64 nstamps;
+    if (!ReadCheckpointValue(is, &nstamps)) return false;
+    for(uint64 i = 0; i < nstamps; i++) {
+        uint64 t;
+        Impl::LastStamp ls;
+        if (!ReadCheckpointValue(is, &t) || !ReadCheckpointValue(is, &ls.id))
+            return false;
+        ls.time = Time::microseconds(t);
+        mImpl->lastStamps.push_back(ls);
     }
 
-    // Report results for all stages which we've found pairs for
-    stage_graph.depth_first_edge_traversal(
-        std::tr1::bind(&reportStats, _1, &results)
-                                           );
+    return true;
 }
 
 } // namespace Sirikata
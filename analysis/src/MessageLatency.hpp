@@ -34,6 +34,7 @@
 #define _ANALYSIS_MESSAGE_LATENCY_HPP_
 
 #include <sirikata/core/trace/Trace.hpp>
+#include "TraceStream.hpp"
 
 namespace Sirikata {
 
@@ -48,7 +49,29 @@ class MessageLatencyFilters {
     const ObjectMessagePort* mDestPort;
 };
 
-void MessageLatencyAnalysis(const char* opt_name, const uint32 nservers, MessageLatencyFilters f, const String& stage_dump_file = "stage_samples.txt");
+/** Breaks down message latency by the stages messages pass through, using the
+ *  timestamps recorded along the way. Messages are handled as the trace is
+ *  streamed through a TraceAnalysisPipeline: once no timestamp has been seen
+ *  for a message for horizon (in trace time), it's assumed to be finished and
+ *  is matched against the graph of stages. Only messages which are still in
+ *  flight need to be kept in memory.
+ */
+class MessageLatencyAnalysis : public TraceEventHandler {
+public:
+    MessageLatencyAnalysis(MessageLatencyFilters f, const Duration& horizon, const String& stage_dump_file = "stage_samples.txt");
+    ~MessageLatencyAnalysis();
+
+    // TraceEventHandler Interface
+    virtual bool wants(uint16 type_hint) const;
+    virtual void handleEvent(const Event* evt, ServerID server);
+    virtual void finish();
+    virtual bool saveCheckpoint(std::ostream& os);
+    virtual bool loadCheckpoint(std::istream& is);
+
+private:
+    struct Impl;
+    Impl* mImpl;
+};
 
 } // namespace Sirikata
 
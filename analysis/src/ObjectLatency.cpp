@@ -36,31 +36,43 @@
 
 namespace Sirikata {
 
-ObjectLatencyAnalysis::ObjectLatencyAnalysis(const char*opt_name, const uint32 nservers) {
-    mNumberOfServers = nservers;
-    for(uint32 server_id = 1; server_id <= nservers; server_id++) {
-        String loc_file = GetPerServerFile(opt_name, server_id);
-        std::ifstream is(loc_file.c_str(), std::ios::in);
-
-        while(is) {
-            uint16 type_hint;
-            std::string raw_evt;
-            if (!read_record(is, &type_hint, &raw_evt)) break;
-            Event* evt = Event::parse(type_hint, raw_evt, server_id);
-            if (evt == NULL)
-                break;
-
-            {
-                PingEvent* ping_evt = dynamic_cast<PingEvent*>(evt);
-                if (ping_evt != NULL) {
-                    mLatency.insert(
-                        PingMap::value_type(ping_evt->data.distance(),ping_evt->data.received()-ping_evt->data.t()));
-                }
-            }
-            delete evt;
-        }
+ObjectLatencyAnalysis::ObjectLatencyAnalysis() {
+}
+
+bool ObjectLatencyAnalysis::wants(uint16 type_hint) const {
+    return (type_hint == ObjectPingTag);
+}
+
+void ObjectLatencyAnalysis::handleEvent(const Event* evt, ServerID server) {
+    const PingEvent* ping_evt = dynamic_cast<const PingEvent*>(evt);
+    if (ping_evt != NULL) {
+        mLatency.insert(
+            PingMap::value_type(ping_evt->data.distance(),ping_evt->data.received()-ping_evt->data.t()));
+    }
+}
+
+bool ObjectLatencyAnalysis::saveCheckpoint(std::ostream& os) {
+    WriteCheckpointValue(os, (uint64)mLatency.size());
+    for (PingMap::iterator it = mLatency.begin(); it != mLatency.end(); ++it) {
+        WriteCheckpointValue(os, it->first);
+        WriteCheckpointValue(os, it->second.toMicroseconds());
     }
+    return true;
+}
 
+bool ObjectLatencyAnalysis::loadCheckpoint(std::istream& is) {
+    mLatency.clear();
+    uint64 count;
+    if (!ReadCheckpointValue(is, &count)) return false;
+    for(uint64 i = 0; i < count; i++) {
+        double dist;
+        int64 latency;
+        if (!ReadCheckpointValue(is, &dist) || !ReadCheckpointValue(is, &latency))
+            return false;
+        // Samples are written in order, so hint the insert at the end
+        mLatency.insert(mLatency.end(), PingMap::value_type(dist, Duration::microseconds(latency)));
+    }
+    return true;
 }
 
 void ObjectLatencyAnalysis::histogramDistanceData(uint32 numBuckets, AverageHistogram &retval) {
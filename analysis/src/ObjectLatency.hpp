@@ -34,15 +34,24 @@
 #define _SIRIKATA_OBJECT_LATENCY_ANALYSIS_HPP_
 
 #include <sirikata/core/trace/Trace.hpp>
+#include "TraceStream.hpp"
 
 namespace Sirikata {
 
-class ObjectLatencyAnalysis {
+/** Collects ping latencies by the distance between the objects. Run it over
+ *  the traces with a TraceAnalysisPipeline.
+ */
+class ObjectLatencyAnalysis : public TraceEventHandler {
     typedef std::multimap<double, Duration> PingMap;
     PingMap mLatency;
 public:
-    int mNumberOfServers;
-    ObjectLatencyAnalysis(const char* opt_name, const uint32 nservers);
+    ObjectLatencyAnalysis();
+
+    // TraceEventHandler Interface
+    virtual bool wants(uint16 type_hint) const;
+    virtual void handleEvent(const Event* evt, ServerID server);
+    virtual bool saveCheckpoint(std::ostream& os);
+    virtual bool loadCheckpoint(std::istream& is);
 
     struct Average{
         Average()
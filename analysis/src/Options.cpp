@@ -70,6 +70,19 @@ void InitAnalysisOptions() {
         .addOption(new OptionValue(ANALYSIS_PROX_DUMP, "", Sirikata::OptionValueType<String>(), "Run proximity dump analysis -- just dumps a textual form of all proximity events to the specified file"))
 
         .addOption(new OptionValue(ANALYSIS_FLOW_STATS, "false", Sirikata::OptionValueType<bool>(), "Get summary object pair flow statistics"))
+
+        .addOption(new OptionValue(ANALYSIS_MESSAGE_LATENCY_HORIZON, "30s", Sirikata::OptionValueType<Duration>(), "Trace time after a message's last timestamp before it is considered finished by the message latency analysis"))
+
+        .addOption(new OptionValue(ANALYSIS_THREADED, "true", Sirikata::OptionValueType<bool>(), "Run each streaming analysis (object latency, message latency, flow stats) in its own thread"))
+        .addOption(new OptionValue(ANALYSIS_BATCH_SIZE, "4096", Sirikata::OptionValueType<uint32>(), "Number of trace events handed to streaming analyses at a time"))
+        .addOption(new OptionValue(ANALYSIS_QUEUE_DEPTH, "8", Sirikata::OptionValueType<uint32>(), "Maximum number of batches of events queued for each streaming analysis"))
+        .addOption(new OptionValue(ANALYSIS_CHECKPOINT, "", Sirikata::OptionValueType<String>(), "File to periodically save the state of streaming analyses to. If it exists, the analyses resume from it."))
+        .addOption(new OptionValue(ANALYSIS_CHECKPOINT_INTERVAL, "10000000", Sirikata::OptionValueType<uint32>(), "Number of trace events between checkpoints"))
+
+        .addOption(new OptionValue(ANALYSIS_TRACE_BENCHMARK, "", Sirikata::OptionValueType<String>(), "Generate synthetic traces in the specified directory and time the different ways of running analyses over them"))
+        .addOption(new OptionValue(ANALYSIS_TRACE_BENCHMARK_SERVERS, "16", Sirikata::OptionValueType<uint32>(), "Number of servers to generate traces for in the trace benchmark"))
+        .addOption(new OptionValue(ANALYSIS_TRACE_BENCHMARK_PACKETS, "100000", Sirikata::OptionValueType<uint32>(), "Number of messages created by each server in the trace benchmark"))
+        .addOption(new OptionValue(ANALYSIS_TRACE_BENCHMARK_ANALYSES, "2", Sirikata::OptionValueType<uint32>(), "Number of message latency analyses to run at once in the trace benchmark"))
       ;
 }
 
@@ -49,6 +49,18 @@
 #define ANALYSIS_LOC_LATENCY "analysis.loc.latency"
 #define ANALYSIS_PROX_DUMP "analysis.prox.dump"
 #define ANALYSIS_FLOW_STATS "analysis.flow.stats"
+#define ANALYSIS_MESSAGE_LATENCY_HORIZON "analysis.message.latency.horizon"
+
+#define ANALYSIS_THREADED "analysis.threaded"
+#define ANALYSIS_BATCH_SIZE "analysis.batch-size"
+#define ANALYSIS_QUEUE_DEPTH "analysis.queue-depth"
+#define ANALYSIS_CHECKPOINT "analysis.checkpoint"
+#define ANALYSIS_CHECKPOINT_INTERVAL "analysis.checkpoint.interval"
+
+#define ANALYSIS_TRACE_BENCHMARK "analysis.trace-benchmark"
+#define ANALYSIS_TRACE_BENCHMARK_SERVERS "analysis.trace-benchmark.servers"
+#define ANALYSIS_TRACE_BENCHMARK_PACKETS "analysis.trace-benchmark.packets"
+#define ANALYSIS_TRACE_BENCHMARK_ANALYSES "analysis.trace-benchmark.analyses"
 
 #define ANALYSIS_TOTAL_NUM_ALL_SERVERS "analysis.total.num.all.servers"
 
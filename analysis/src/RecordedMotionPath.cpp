@@ -48,8 +48,8 @@ RecordedMotionPath::RecordedMotionPath()
 RecordedMotionPath::~RecordedMotionPath() {
 }
 
-void RecordedMotionPath::add(Event* evt) {
-    GeneratedLocationEvent* gen_loc_evt = dynamic_cast<GeneratedLocationEvent*>(evt);
+void RecordedMotionPath::add(const Event* evt) {
+    const GeneratedLocationEvent* gen_loc_evt = dynamic_cast<const GeneratedLocationEvent*>(evt);
     if (gen_loc_evt != NULL)
         addUpdate(extractTimedMotionVector(gen_loc_evt->data.loc()));
 }
@@ -52,7 +52,7 @@ public:
 
     virtual ~RecordedMotionPath();
 
-    void add(Event* evt);
+    void add(const Event* evt);
 
     virtual const TimedMotionVector3f initial() const;
     virtual const TimedMotionVector3f* nextUpdate(const Time& curtime) const;
@@ -0,0 +1,188 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "TraceBenchmark.hpp"
+#include "TraceStream.hpp"
+#include "MessageLatency.hpp"
+#include <sirikata/core/util/Timer.hpp>
+
+namespace Sirikata {
+
+namespace {
+
+// Records are written the same way Trace::writeRecord does
+void writeRecordHeader(std::ostream& os, uint32 size, uint16 type_hint) {
+    os.write((const char*)&size, sizeof(size));
+    os.write((const char*)&type_hint, sizeof(type_hint));
+}
+
+void writeTimestamp(std::ostream& os, const Time& t, uint64 uid, Trace::MessagePath path) {
+    writeRecordHeader(os, sizeof(t) + sizeof(uid) + sizeof(path), MessageTimestampTag);
+    os.write((const char*)&t, sizeof(t));
+    os.write((const char*)&uid, sizeof(uid));
+    os.write((const char*)&path, sizeof(path));
+}
+
+void writeCreationTimestamp(std::ostream& os, const Time& t, uint64 uid, Trace::MessagePath path, ObjectMessagePort srcport, ObjectMessagePort dstport) {
+    writeRecordHeader(os, sizeof(t) + sizeof(uid) + sizeof(path) + sizeof(srcport) + sizeof(dstport), MessageCreationTimestampTag);
+    os.write((const char*)&t, sizeof(t));
+    os.write((const char*)&uid, sizeof(uid));
+    os.write((const char*)&path, sizeof(path));
+    os.write((const char*)&srcport, sizeof(srcport));
+    os.write((const char*)&dstport, sizeof(dstport));
+}
+
+// Each message is created on one server, forwarded locally by another and
+// delivered back to the first. Messages are spaced far enough apart that all
+// of a message's timestamps come before the next message's, so every trace is
+// sorted.
+std::vector<String> generateTraces(const String& dir, const uint32 nservers, const uint32 packets_per_server) {
+    std::vector<String> files;
+    std::vector<std::ofstream*> streams;
+    for(uint32 i = 0; i < nservers; i++) {
+        std::ostringstream fname;
+        fname << dir << "/trace_benchmark_" << (i+1) << ".trace";
+        files.push_back(fname.str());
+        streams.push_back(new std::ofstream(fname.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc));
+    }
+
+    const Trace::MessagePath stages[] = {
+        Trace::CREATED, Trace::OH_HIT_NETWORK,
+        // On the forwarding server
+        Trace::HANDLE_OBJECT_HOST_MESSAGE, Trace::FORWARDED_LOCALLY, Trace::SPACE_TO_OH_ENQUEUED,
+        Trace::OH_NET_RECEIVED, Trace::OH_RECEIVED, Trace::DESTROYED
+    };
+    const uint32 nstages = sizeof(stages) / sizeof(stages[0]);
+    Duration stage_spacing = Duration::microseconds(10);
+    Duration packet_spacing = Duration::microseconds(100);
+
+    Time t = Time::epoch() + Duration::seconds(1);
+    uint64 npackets = (uint64)nservers * packets_per_server;
+    for(uint64 uid = 1; uid <= npackets; uid++) {
+        std::ostream& src = *streams[uid % nservers];
+        std::ostream& fwd = *streams[(uid * 7 + 3) % nservers];
+
+        Time st = t;
+        for(uint32 stage = 0; stage < nstages; stage++) {
+            if (stage == 0)
+                writeCreationTimestamp(src, st, uid, stages[stage], 14050, 14050);
+            else
+                writeTimestamp((stage >= 2 && stage <= 4) ? fwd : src, st, uid, stages[stage]);
+            st = st + stage_spacing;
+        }
+
+        t = t + packet_spacing;
+    }
+
+    for(uint32 i = 0; i < nservers; i++) {
+        streams[i]->close();
+        delete streams[i];
+    }
+    return files;
+}
+
+typedef std::vector<MessageLatencyAnalysis*> AnalysisList;
+
+AnalysisList createAnalyses(const uint32 nanalyses) {
+    AnalysisList analyses;
+    for(uint32 i = 0; i < nanalyses; i++)
+        analyses.push_back( new MessageLatencyAnalysis(MessageLatencyFilters(), Duration::seconds(1), "") );
+    return analyses;
+}
+
+void destroyAnalyses(AnalysisList& analyses) {
+    for(uint32 i = 0; i < analyses.size(); i++)
+        delete analyses[i];
+    analyses.clear();
+}
+
+struct LoadedEvent {
+    Event* event;
+    ServerID server;
+    uint16 type_hint;
+
+    bool operator<(const LoadedEvent& rhs) const {
+        return event->time < rhs.event->time;
+    }
+};
+
+// The way analyses used to work: read all the traces, sort them and then
+// process them.
+uint64 runLoadAndSort(const std::vector<String>& files, AnalysisList& analyses) {
+    std::vector<LoadedEvent> events;
+    for(uint32 i = 0; i < files.size(); i++) {
+        std::ifstream is(files[i].c_str(), std::ios::in | std::ios::binary);
+        while(is) {
+            LoadedEvent loaded;
+            std::string raw_evt;
+            if (!read_record(is, &loaded.type_hint, &raw_evt)) break;
+            loaded.server = i + 1;
+            loaded.event = Event::parse(loaded.type_hint, raw_evt, loaded.server);
+            if (loaded.event == NULL)
+                break;
+            events.push_back(loaded);
+        }
+    }
+    std::stable_sort(events.begin(), events.end());
+
+    for(uint32 i = 0; i < events.size(); i++) {
+        for(uint32 a = 0; a < analyses.size(); a++) {
+            if (analyses[a]->wants(events[i].type_hint))
+                analyses[a]->handleEvent(events[i].event, events[i].server);
+        }
+    }
+    for(uint32 a = 0; a < analyses.size(); a++)
+        analyses[a]->finish();
+
+    for(uint32 i = 0; i < events.size(); i++)
+        delete events[i].event;
+    return events.size();
+}
+
+void report(const char* name, const Duration& dt, uint64 events, uint64 peak) {
+    printf("%-24s %10.3fs %12.0f events/s %12llu peak events in memory\n",
+        name, dt.toSeconds(),
+        (dt.toSeconds() > 0 ? (events / dt.toSeconds()) : 0.0),
+        (unsigned long long)peak);
+}
+
+} // namespace
+
+void TraceBenchmark(const String& dir, const uint32 nservers, const uint32 packets_per_server, const uint32 nanalyses) {
+    Time gen_start = Timer::now();
+    std::vector<String> files = generateTraces(dir, nservers, packets_per_server);
+    Duration gen_dt = Timer::now() - gen_start;
+    {
+        MergedTraceReader sizes(files);
+        printf("Generated %u traces, %llu bytes, in %fs\n",
+            nservers, (unsigned long long)sizes.totalSize(), gen_dt.toSeconds());
+    }
+
+    {
+        AnalysisList analyses = createAnalyses(nanalyses);
+        Time start = Timer::now();
+        uint64 events = runLoadAndSort(files, analyses);
+        report("load and sort", Timer::now() - start, events, events);
+        destroyAnalyses(analyses);
+    }
+
+    for(uint32 threaded = 0; threaded < 2; threaded++) {
+        AnalysisList analyses = createAnalyses(nanalyses);
+        TraceAnalysisPipeline pipeline(files);
+        pipeline.setThreaded(threaded != 0);
+        for(uint32 a = 0; a < analyses.size(); a++)
+            pipeline.addHandler(analyses[a]);
+
+        Time start = Timer::now();
+        pipeline.run();
+        report(threaded ? "streaming, threaded" : "streaming, one thread",
+            Timer::now() - start, pipeline.eventsProcessed(), pipeline.peakEventsBuffered());
+        destroyAnalyses(analyses);
+    }
+
+    for(uint32 i = 0; i < files.size(); i++)
+        std::remove(files[i].c_str());
+}
+
+} // namespace Sirikata
@@ -0,0 +1,23 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_ANALYSIS_TRACE_BENCHMARK_HPP_
+#define _SIRIKATA_ANALYSIS_TRACE_BENCHMARK_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** Generates synthetic message timestamp traces for nservers servers in dir
+ *  and times running nanalyses message latency analyses over them:
+ *   - loading every event into memory and sorting them before processing
+ *   - streaming a merge of the traces, processing everything in one thread
+ *   - streaming a merge of the traces with a worker thread per analysis
+ *  Results are printed along with the peak number of events held in memory.
+ */
+void TraceBenchmark(const String& dir, const uint32 nservers, const uint32 packets_per_server, const uint32 nanalyses);
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_ANALYSIS_TRACE_BENCHMARK_HPP_
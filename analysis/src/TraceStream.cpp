@@ -0,0 +1,610 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "TraceStream.hpp"
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#define NUM_TYPE_HINTS 65536
+
+namespace Sirikata {
+
+std::vector<String> GetPerServerFiles(const char* opt_name, const uint32 nservers) {
+    std::vector<String> files;
+    for(uint32 server_id = 1; server_id <= nservers; server_id++)
+        files.push_back( GetPerServerFile(opt_name, server_id) );
+    return files;
+}
+
+
+TraceRecordReader::TraceRecordReader(const String& filename, ServerID server)
+ : mBuffer(new char[BUFFER_SIZE]),
+   mServer(server),
+   mGood(false),
+   mOffset(0),
+   mSize(0),
+   mPayloadSize(0)
+{
+    // The buffer has to be set before the file is opened to take effect
+    mStream.rdbuf()->pubsetbuf(mBuffer, BUFFER_SIZE);
+    mStream.open(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!mStream) {
+        SILOG(analysis, error, "Couldn't open trace file " << filename);
+        return;
+    }
+
+    mStream.seekg(0, std::ios::end);
+    mSize = mStream.tellg();
+    mStream.seekg(0, std::ios::beg);
+    mGood = mStream.good();
+}
+
+TraceRecordReader::~TraceRecordReader() {
+    mStream.close();
+    delete[] mBuffer;
+}
+
+bool TraceRecordReader::readHeader(uint16* type_hint_out) {
+    if (!mGood) return false;
+
+    uint32 record_size;
+    mStream.read( (char*)&record_size, sizeof(record_size) );
+    mStream.read( (char*)type_hint_out, sizeof(uint16) );
+    if (!mStream) {
+        mGood = false;
+        return false;
+    }
+
+    uint64 header_end = mOffset + sizeof(uint32) + sizeof(uint16);
+    if (header_end + record_size > mSize) {
+        // Either corrupt or the last record was only partially written.
+        SILOG(analysis, error, "Truncated record in trace for server " << mServer << " at offset " << mOffset);
+        mGood = false;
+        return false;
+    }
+
+    mPayloadSize = record_size;
+    return true;
+}
+
+bool TraceRecordReader::readPayload(std::string* payload_out) {
+    payload_out->resize(mPayloadSize);
+    if (mPayloadSize > 0)
+        mStream.read( &((*payload_out)[0]), mPayloadSize );
+    if (!mStream) {
+        mGood = false;
+        return false;
+    }
+    mOffset += sizeof(uint32) + sizeof(uint16) + mPayloadSize;
+    return true;
+}
+
+bool TraceRecordReader::skipPayload() {
+    mStream.seekg(mPayloadSize, std::ios::cur);
+    if (!mStream) {
+        mGood = false;
+        return false;
+    }
+    mOffset += sizeof(uint32) + sizeof(uint16) + mPayloadSize;
+    return true;
+}
+
+bool TraceRecordReader::seek(uint64 offset) {
+    if (offset > mSize) return false;
+
+    mStream.clear();
+    mStream.seekg(offset, std::ios::beg);
+    mOffset = offset;
+    mGood = mStream.good();
+    return mGood;
+}
+
+
+
+MergedTraceReader::MergedTraceReader(const std::vector<String>& files)
+ : mWanted(NUM_TYPE_HINTS, false),
+   mFiltered(false),
+   mStarted(false)
+{
+    for(uint32 i = 0; i < files.size(); i++)
+        mStreams.push_back( new TraceRecordReader(files[i], i+1) );
+}
+
+MergedTraceReader::~MergedTraceReader() {
+    clearHeads();
+    for(uint32 i = 0; i < mStreams.size(); i++)
+        delete mStreams[i];
+}
+
+void MergedTraceReader::want(uint16 type_hint) {
+    // Heads are only read on the first call to next(), so filtering must be
+    // setup before then.
+    assert(!mStarted);
+    mFiltered = true;
+    mWanted[type_hint] = true;
+}
+
+void MergedTraceReader::advance(uint32 stream) {
+    TraceRecordReader* reader = mStreams[stream];
+
+    while(true) {
+        uint64 offset = reader->offset();
+        uint16 type_hint;
+        if (!reader->readHeader(&type_hint)) return;
+
+        if (mFiltered && !mWanted[type_hint]) {
+            if (!reader->skipPayload()) return;
+            continue;
+        }
+
+        if (!reader->readPayload(&mPayload)) return;
+        Event* evt = Event::parse(type_hint, mPayload, reader->server());
+        // Unknown records are reported by Event::parse, just skip them.
+        if (evt == NULL) continue;
+
+        Head head;
+        head.event = evt;
+        head.stream = stream;
+        head.type_hint = type_hint;
+        head.offset = offset;
+        mHeads.push_back(head);
+        std::push_heap(mHeads.begin(), mHeads.end(), HeadComparator());
+        return;
+    }
+}
+
+void MergedTraceReader::clearHeads() {
+    for(uint32 i = 0; i < mHeads.size(); i++)
+        delete mHeads[i].event;
+    mHeads.clear();
+}
+
+Event* MergedTraceReader::next(ServerID* server_out, uint16* type_hint_out) {
+    if (!mStarted) {
+        mStarted = true;
+        for(uint32 i = 0; i < mStreams.size(); i++)
+            advance(i);
+    }
+
+    if (mHeads.empty()) return NULL;
+
+    std::pop_heap(mHeads.begin(), mHeads.end(), HeadComparator());
+    Head head = mHeads.back();
+    mHeads.pop_back();
+    advance(head.stream);
+
+    *server_out = mStreams[head.stream]->server();
+    *type_hint_out = head.type_hint;
+    return head.event;
+}
+
+void MergedTraceReader::getPosition(std::vector<uint64>* offsets_out) const {
+    offsets_out->resize(mStreams.size());
+    for(uint32 i = 0; i < mStreams.size(); i++)
+        (*offsets_out)[i] = mStreams[i]->offset();
+    // Heads have been read but not returned yet, so they need to be read
+    // again when resuming.
+    for(uint32 i = 0; i < mHeads.size(); i++)
+        (*offsets_out)[mHeads[i].stream] = mHeads[i].offset;
+}
+
+bool MergedTraceReader::setPosition(const std::vector<uint64>& offsets) {
+    if (offsets.size() != mStreams.size()) return false;
+
+    clearHeads();
+    mStarted = true;
+    for(uint32 i = 0; i < mStreams.size(); i++) {
+        if (!mStreams[i]->seek(offsets[i])) return false;
+        advance(i);
+    }
+    return true;
+}
+
+uint64 MergedTraceReader::totalSize() const {
+    uint64 total = 0;
+    for(uint32 i = 0; i < mStreams.size(); i++)
+        total += mStreams[i]->size();
+    return total;
+}
+
+
+
+struct TraceAnalysisPipeline::Batch {
+    struct Item {
+        Event* event;
+        ServerID server;
+        uint16 type_hint;
+    };
+
+    Batch(AtomicValue<uint32>* buffered_counter)
+     : buffered(buffered_counter)
+    {}
+
+    ~Batch() {
+        for(uint32 i = 0; i < items.size(); i++)
+            delete items[i].event;
+        *buffered -= (uint32)items.size();
+    }
+
+    std::vector<Item> items;
+    AtomicValue<uint32>* buffered;
+};
+
+/** Runs a single handler. Batches are shared by all workers and are freed
+ *  once the last worker is done with them.
+ */
+class TraceAnalysisPipeline::Worker : Noncopyable {
+public:
+    Worker(TraceEventHandler* handler, uint32 depth)
+     : mHandler(handler),
+       mWanted(NUM_TYPE_HINTS, false),
+       mDepth(depth),
+       mBusy(false),
+       mThread(NULL)
+    {
+        for(uint32 i = 0; i < NUM_TYPE_HINTS; i++)
+            mWanted[i] = handler->wants((uint16)i);
+    }
+
+    ~Worker() {
+        stop();
+    }
+
+    TraceEventHandler* handler() const { return mHandler; }
+
+    bool wants(uint16 type_hint) const {
+        return mWanted[type_hint];
+    }
+
+    void handle(const Event* evt, ServerID server, uint16 type_hint) {
+        if (mWanted[type_hint])
+            mHandler->handleEvent(evt, server);
+    }
+
+    void start() {
+        mThread = new Thread("Analysis Worker", std::tr1::bind(&Worker::run, this));
+    }
+
+    // Queue a batch, waiting for space if the queue is full.
+    void push(const BatchPtr& batch) {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        while(mQueue.size() >= mDepth)
+            mChanged.wait(lock);
+        mQueue.push_back(batch);
+        mChanged.notify_all();
+    }
+
+    // Wait for all queued batches to be handled.
+    void drain() {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        while(!mQueue.empty() || mBusy)
+            mChanged.wait(lock);
+    }
+
+    // Finish all queued batches and shut down the thread.
+    void stop() {
+        if (mThread == NULL) return;
+        push(BatchPtr());
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+
+private:
+    void run() {
+        while(true) {
+            BatchPtr batch;
+            {
+                boost::unique_lock<boost::mutex> lock(mMutex);
+                while(mQueue.empty())
+                    mChanged.wait(lock);
+                batch = mQueue.front();
+                mQueue.pop_front();
+                mBusy = (bool)batch;
+                mChanged.notify_all();
+            }
+            // An empty batch signals the end of the trace
+            if (!batch) break;
+
+            for(uint32 i = 0; i < batch->items.size(); i++) {
+                const Batch::Item& item = batch->items[i];
+                handle(item.event, item.server, item.type_hint);
+            }
+            batch.reset();
+
+            {
+                boost::unique_lock<boost::mutex> lock(mMutex);
+                mBusy = false;
+                mChanged.notify_all();
+            }
+        }
+
+        mHandler->finish();
+    }
+
+    TraceEventHandler* mHandler;
+    std::vector<bool> mWanted;
+
+    uint32 mDepth;
+    boost::mutex mMutex;
+    boost::condition_variable mChanged;
+    std::deque<BatchPtr> mQueue;
+    bool mBusy;
+
+    Thread* mThread;
+};
+
+
+namespace {
+enum {
+    CHECKPOINT_MAGIC = 0x4b434e41, // "ANCK"
+    CHECKPOINT_VERSION = 1
+};
+}
+
+TraceAnalysisPipeline::TraceAnalysisPipeline(const std::vector<String>& files)
+ : mFiles(files),
+   mThreaded(true),
+   mBatchSize(4096),
+   mQueueDepth(8),
+   mCheckpointInterval(0),
+   mEventsProcessed(0),
+   mEventsBuffered(0),
+   mPeakEventsBuffered(0)
+{
+}
+
+TraceAnalysisPipeline::~TraceAnalysisPipeline() {
+}
+
+void TraceAnalysisPipeline::addHandler(TraceEventHandler* handler) {
+    mHandlers.push_back(handler);
+}
+
+void TraceAnalysisPipeline::setCheckpoint(const String& filename, uint64 interval_events) {
+    mCheckpointFile = filename;
+    mCheckpointInterval = std::max(interval_events, (uint64)1);
+}
+
+bool TraceAnalysisPipeline::checkpointable() const {
+    // There's no way to ask a handler whether it supports checkpoints without
+    // doing one, so just try with throwaway output.
+    for(uint32 i = 0; i < mHandlers.size(); i++) {
+        std::ostringstream discard(std::ios::out | std::ios::binary);
+        if (!mHandlers[i]->saveCheckpoint(discard))
+            return false;
+    }
+    return true;
+}
+
+bool TraceAnalysisPipeline::saveCheckpoint(MergedTraceReader& reader) {
+    // Write to a temporary file and swap it in so a crash while writing
+    // leaves the previous checkpoint intact.
+    String tmp_file = mCheckpointFile + ".tmp";
+    std::ofstream os(tmp_file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!os) {
+        SILOG(analysis, error, "Couldn't open checkpoint file " << tmp_file);
+        return false;
+    }
+
+    WriteCheckpointValue(os, (uint32)CHECKPOINT_MAGIC);
+    WriteCheckpointValue(os, (uint32)CHECKPOINT_VERSION);
+
+    std::vector<uint64> offsets;
+    reader.getPosition(&offsets);
+    WriteCheckpointValue(os, (uint32)offsets.size());
+    for(uint32 i = 0; i < offsets.size(); i++)
+        WriteCheckpointValue(os, offsets[i]);
+    WriteCheckpointValue(os, mEventsProcessed);
+
+    WriteCheckpointValue(os, (uint32)mHandlers.size());
+    for(uint32 i = 0; i < mHandlers.size(); i++) {
+        std::ostringstream handler_os(std::ios::out | std::ios::binary);
+        if (!mHandlers[i]->saveCheckpoint(handler_os)) {
+            SILOG(analysis, error, "Analysis failed to save checkpoint");
+            return false;
+        }
+        String data = handler_os.str();
+        WriteCheckpointValue(os, (uint64)data.size());
+        os.write(data.data(), data.size());
+    }
+    os.close();
+    if (!os) {
+        SILOG(analysis, error, "Failed to write checkpoint file " << tmp_file);
+        return false;
+    }
+
+    if (std::rename(tmp_file.c_str(), mCheckpointFile.c_str()) != 0) {
+        // Windows won't rename over an existing file
+        std::remove(mCheckpointFile.c_str());
+        if (std::rename(tmp_file.c_str(), mCheckpointFile.c_str()) != 0) {
+            SILOG(analysis, error, "Couldn't move checkpoint into place at " << mCheckpointFile);
+            return false;
+        }
+    }
+
+    SILOG(analysis, info, "Saved checkpoint after " << mEventsProcessed << " events");
+    return true;
+}
+
+bool TraceAnalysisPipeline::loadCheckpoint(MergedTraceReader& reader) {
+    std::ifstream is(mCheckpointFile.c_str(), std::ios::in | std::ios::binary);
+    // No checkpoint, start from the beginning
+    if (!is) return true;
+
+    uint32 magic = 0, version = 0, nstreams = 0, nhandlers = 0;
+    if (!ReadCheckpointValue(is, &magic) || magic != CHECKPOINT_MAGIC ||
+        !ReadCheckpointValue(is, &version) || version != CHECKPOINT_VERSION) {
+        SILOG(analysis, error, mCheckpointFile << " isn't a valid checkpoint");
+        return false;
+    }
+
+    if (!ReadCheckpointValue(is, &nstreams) || nstreams != reader.numStreams()) {
+        SILOG(analysis, error, "Checkpoint was saved with a different number of traces");
+        return false;
+    }
+    std::vector<uint64> offsets(nstreams);
+    for(uint32 i = 0; i < nstreams; i++) {
+        if (!ReadCheckpointValue(is, &offsets[i])) {
+            SILOG(analysis, error, "Truncated checkpoint " << mCheckpointFile);
+            return false;
+        }
+    }
+    uint64 events_processed;
+    if (!ReadCheckpointValue(is, &events_processed) ||
+        !ReadCheckpointValue(is, &nhandlers) || nhandlers != mHandlers.size()) {
+        SILOG(analysis, error, "Checkpoint was saved with a different set of analyses");
+        return false;
+    }
+
+    for(uint32 i = 0; i < nhandlers; i++) {
+        uint64 size;
+        if (!ReadCheckpointValue(is, &size)) {
+            SILOG(analysis, error, "Truncated checkpoint " << mCheckpointFile);
+            return false;
+        }
+        String data(size, '\0');
+        if (size > 0) is.read(&data[0], size);
+        if (!is) {
+            SILOG(analysis, error, "Truncated checkpoint " << mCheckpointFile);
+            return false;
+        }
+        std::istringstream handler_is(data, std::ios::in | std::ios::binary);
+        if (!mHandlers[i]->loadCheckpoint(handler_is)) {
+            SILOG(analysis, error, "Analysis failed to restore checkpoint");
+            return false;
+        }
+    }
+
+    if (!reader.setPosition(offsets)) {
+        SILOG(analysis, error, "Traces don't match checkpoint, were they modified?");
+        return false;
+    }
+
+    mEventsProcessed = events_processed;
+    SILOG(analysis, info, "Resuming from checkpoint after " << mEventsProcessed << " events");
+    return true;
+}
+
+void TraceAnalysisPipeline::dispatch(const BatchPtr& batch) {
+    for(uint32 i = 0; i < mWorkers.size(); i++)
+        mWorkers[i]->push(batch);
+}
+
+void TraceAnalysisPipeline::drain() {
+    for(uint32 i = 0; i < mWorkers.size(); i++)
+        mWorkers[i]->drain();
+}
+
+bool TraceAnalysisPipeline::run() {
+    mEventsProcessed = 0;
+    mEventsBuffered = 0;
+    // The merge always holds one event per trace
+    mPeakEventsBuffered = mFiles.size();
+
+    MergedTraceReader reader(mFiles);
+    for(uint32 i = 0; i < mHandlers.size(); i++)
+        mWorkers.push_back( new Worker(mHandlers[i], mQueueDepth) );
+    for(uint32 type_hint = 0; type_hint < NUM_TYPE_HINTS; type_hint++) {
+        for(uint32 i = 0; i < mWorkers.size(); i++) {
+            if (mWorkers[i]->wants((uint16)type_hint)) {
+                reader.want((uint16)type_hint);
+                break;
+            }
+        }
+    }
+
+    bool checkpointing = !mCheckpointFile.empty();
+    if (checkpointing && !checkpointable()) {
+        SILOG(analysis, warning, "Not all analyses support checkpoints, checkpointing disabled.");
+        checkpointing = false;
+    }
+    if (checkpointing && !loadCheckpoint(reader)) {
+        for(uint32 i = 0; i < mWorkers.size(); i++)
+            delete mWorkers[i];
+        mWorkers.clear();
+        return false;
+    }
+
+    if (mThreaded) {
+        for(uint32 i = 0; i < mWorkers.size(); i++)
+            mWorkers[i]->start();
+    }
+
+    uint64 since_checkpoint = 0;
+    BatchPtr batch;
+    while(true) {
+        ServerID server;
+        uint16 type_hint;
+        Event* evt = reader.next(&server, &type_hint);
+        if (evt == NULL) break;
+        mEventsProcessed++;
+
+        if (!mThreaded) {
+            for(uint32 i = 0; i < mWorkers.size(); i++)
+                mWorkers[i]->handle(evt, server, type_hint);
+            delete evt;
+        }
+        else {
+            if (!batch) batch = BatchPtr(new Batch(&mEventsBuffered));
+            Batch::Item item;
+            item.event = evt;
+            item.server = server;
+            item.type_hint = type_hint;
+            batch->items.push_back(item);
+            uint64 buffered = ++mEventsBuffered + mFiles.size();
+            if (buffered > mPeakEventsBuffered)
+                mPeakEventsBuffered = buffered;
+
+            if (batch->items.size() >= mBatchSize) {
+                dispatch(batch);
+                batch.reset();
+            }
+        }
+
+        if (checkpointing && ++since_checkpoint >= mCheckpointInterval) {
+            // Handlers can only be saved when they've caught up with the
+            // reader, so this stalls the pipeline briefly.
+            if (batch) {
+                dispatch(batch);
+                batch.reset();
+            }
+            drain();
+            if (!saveCheckpoint(reader)) {
+                SILOG(analysis, error, "Checkpointing disabled for the rest of the analysis.");
+                checkpointing = false;
+            }
+            since_checkpoint = 0;
+        }
+    }
+
+    if (batch) {
+        dispatch(batch);
+        batch.reset();
+    }
+
+    if (mThreaded) {
+        // Workers finish their handlers themselves so they can run in parallel
+        for(uint32 i = 0; i < mWorkers.size(); i++)
+            mWorkers[i]->stop();
+    }
+    else {
+        for(uint32 i = 0; i < mHandlers.size(); i++)
+            mHandlers[i]->finish();
+    }
+
+    for(uint32 i = 0; i < mWorkers.size(); i++)
+        delete mWorkers[i];
+    mWorkers.clear();
+
+    // The analysis completed so there's nothing left to resume
+    if (checkpointing)
+        std::remove(mCheckpointFile.c_str());
+
+    return true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,221 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_ANALYSIS_TRACE_STREAM_HPP_
+#define _SIRIKATA_ANALYSIS_TRACE_STREAM_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Noncopyable.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include "AnalysisEvents.hpp"
+
+namespace Sirikata {
+
+/** Get the names of the per-server trace files for servers 1..nservers. */
+std::vector<String> GetPerServerFiles(const char* opt_name, const uint32 nservers);
+
+/** Reads records from a single trace file, keeping track of the file offset of
+ *  each record so reading can be restarted from a checkpoint.
+ */
+class TraceRecordReader : Noncopyable {
+public:
+    TraceRecordReader(const String& filename, ServerID server);
+    ~TraceRecordReader();
+
+    ServerID server() const { return mServer; }
+    bool good() const { return mGood; }
+    // Offset of the next record in the file.
+    uint64 offset() const { return mOffset; }
+    // Total size of the file when it was opened.
+    uint64 size() const { return mSize; }
+
+    /** Read the header of the next record. Must be followed by a call to
+     *  readPayload or skipPayload.
+     */
+    bool readHeader(uint16* type_hint_out);
+    bool readPayload(std::string* payload_out);
+    bool skipPayload();
+
+    /** Move to a record offset previously returned by offset(). */
+    bool seek(uint64 offset);
+
+private:
+    enum {
+        BUFFER_SIZE = 1 << 20
+    };
+
+    std::ifstream mStream;
+    char* mBuffer;
+    ServerID mServer;
+    bool mGood;
+    uint64 mOffset;
+    uint64 mSize;
+    uint32 mPayloadSize;
+};
+
+/** Merges the events from a set of per-server traces, returning them in
+ *  timestamp order. Each trace is assumed to be (roughly) sorted already, so
+ *  only the head of each file is kept in memory instead of the entire trace.
+ *  Ties are broken by server so the order is deterministic.
+ */
+class MergedTraceReader : Noncopyable {
+public:
+    /** Create a reader for the given files. The file at index i is treated as
+     *  the trace for server i+1.
+     */
+    MergedTraceReader(const std::vector<String>& files);
+    ~MergedTraceReader();
+
+    /** Only parse records with the given type. If this is never called every
+     *  record is parsed. Records which aren't wanted are skipped without
+     *  being parsed, which is much cheaper.
+     */
+    void want(uint16 type_hint);
+
+    /** Get the next event, or NULL if all traces have been read. The caller
+     *  takes ownership of the event.
+     */
+    Event* next(ServerID* server_out, uint16* type_hint_out);
+
+    // Offsets of the next unread record in each file. These are only valid
+    // until the next call to next().
+    void getPosition(std::vector<uint64>* offsets_out) const;
+    // Restart reading from offsets returned by getPosition.
+    bool setPosition(const std::vector<uint64>& offsets);
+
+    uint32 numStreams() const { return mStreams.size(); }
+    // Sizes of the traces being read, in bytes.
+    uint64 totalSize() const;
+
+private:
+    struct Head {
+        Event* event;
+        uint32 stream;
+        uint16 type_hint;
+        uint64 offset;
+    };
+    struct HeadComparator {
+        // Inverted since the std heap functions produce a max-heap
+        bool operator()(const Head& lhs, const Head& rhs) const {
+            if (lhs.event->time == rhs.event->time)
+                return lhs.stream > rhs.stream;
+            return rhs.event->time < lhs.event->time;
+        }
+    };
+
+    // Reads the next wanted record from a stream and adds it to the heap.
+    void advance(uint32 stream);
+    void clearHeads();
+
+    std::vector<TraceRecordReader*> mStreams;
+    std::vector<Head> mHeads;
+    std::vector<bool> mWanted;
+    bool mFiltered;
+    bool mStarted;
+    std::string mPayload;
+};
+
+
+/** An analysis which can be run over a merged stream of trace events by a
+ *  TraceAnalysisPipeline.
+ */
+class TraceEventHandler {
+public:
+    virtual ~TraceEventHandler() {}
+
+    /** Returns true if events with the given type are needed by this
+     *  handler. Only those are delivered to handleEvent.
+     */
+    virtual bool wants(uint16 type_hint) const = 0;
+    /** Handle a single event. Events are delivered in timestamp order. The
+     *  event is only valid for the duration of the call.
+     */
+    virtual void handleEvent(const Event* evt, ServerID server) = 0;
+    /** Invoked after the last event has been delivered. */
+    virtual void finish() {}
+
+    /** Save the state of the analysis so it can be resumed later. Return
+     *  false if checkpointing isn't supported.
+     */
+    virtual bool saveCheckpoint(std::ostream& os) { return false; }
+    /** Restore state saved by saveCheckpoint. */
+    virtual bool loadCheckpoint(std::istream& is) { return false; }
+};
+
+template<typename T>
+void WriteCheckpointValue(std::ostream& os, const T& val) {
+    os.write((const char*)&val, sizeof(T));
+}
+template<typename T>
+bool ReadCheckpointValue(std::istream& is, T* val_out) {
+    is.read((char*)val_out, sizeof(T));
+    return is.good();
+}
+
+/** Runs a set of analyses over a set of per-server traces in a single pass.
+ *  Events are read through a MergedTraceReader and handed out in batches.
+ *  By default each handler runs in its own thread and only a limited number
+ *  of batches may be waiting for any handler, so memory use is bounded by the
+ *  batch size and queue depth rather than by the size of the trace.
+ *
+ *  If a checkpoint file is set, the position in each trace and the state of
+ *  each handler are periodically written to it. If the file already exists
+ *  when run() is called the analysis resumes from it.
+ */
+class TraceAnalysisPipeline : Noncopyable {
+public:
+    TraceAnalysisPipeline(const std::vector<String>& files);
+    ~TraceAnalysisPipeline();
+
+    /** Add a handler. The pipeline doesn't take ownership of it. */
+    void addHandler(TraceEventHandler* handler);
+
+    // Run each handler in its own thread. Otherwise everything is processed
+    // in the calling thread.
+    void setThreaded(bool threaded) { mThreaded = threaded; }
+    void setBatchSize(uint32 events) { mBatchSize = std::max(events, (uint32)1); }
+    // Maximum number of batches queued for each handler.
+    void setQueueDepth(uint32 batches) { mQueueDepth = std::max(batches, (uint32)1); }
+    void setCheckpoint(const String& filename, uint64 interval_events);
+
+    /** Run all handlers over the traces. Returns false if the checkpoint
+     *  file exists but couldn't be restored. Failing to write a checkpoint
+     *  only disables checkpointing for the rest of the run.
+     */
+    bool run();
+
+    // Number of events delivered by the last run.
+    uint64 eventsProcessed() const { return mEventsProcessed; }
+    // Largest number of events held in memory at once during the last run.
+    uint64 peakEventsBuffered() const { return mPeakEventsBuffered; }
+
+private:
+    class Worker;
+    struct Batch;
+    typedef std::tr1::shared_ptr<Batch> BatchPtr;
+
+    bool checkpointable() const;
+    bool saveCheckpoint(MergedTraceReader& reader);
+    bool loadCheckpoint(MergedTraceReader& reader);
+    void dispatch(const BatchPtr& batch);
+    void drain();
+
+    std::vector<String> mFiles;
+    std::vector<TraceEventHandler*> mHandlers;
+    std::vector<Worker*> mWorkers;
+
+    bool mThreaded;
+    uint32 mBatchSize;
+    uint32 mQueueDepth;
+    String mCheckpointFile;
+    uint64 mCheckpointInterval;
+
+    uint64 mEventsProcessed;
+    AtomicValue<uint32> mEventsBuffered;
+    uint64 mPeakEventsBuffered;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_ANALYSIS_TRACE_STREAM_HPP_
@@ -44,6 +44,8 @@
 #include "MessageLatency.hpp"
 #include "ObjectLatency.hpp"
 #include "FlowStats.hpp"
+#include "TraceStream.hpp"
+#include "TraceBenchmark.hpp"
 //#include "Visualization.hpp"
 
 void *main_loop(void *);
@@ -62,12 +64,64 @@ bool is_analysis() {
         GetOptionValue<bool>(ANALYSIS_OBJECT_LATENCY) ||
         GetOptionValue<bool>(ANALYSIS_LOC_LATENCY) ||
         !GetOptionValue<String>(ANALYSIS_PROX_DUMP).empty() ||
-        GetOptionValue<bool>(ANALYSIS_FLOW_STATS))
+        GetOptionValue<bool>(ANALYSIS_FLOW_STATS) ||
+        !GetOptionValue<String>(ANALYSIS_TRACE_BENCHMARK).empty())
         return true;
 
     return false;
 }
 
+// Object latency, message latency and flow stats stream the traces, so any
+// combination of them that was requested is run in a single pass.
+bool run_streaming_analyses(uint32 nservers) {
+    using namespace Sirikata;
+
+    TraceAnalysisPipeline pipeline( GetPerServerFiles(STATS_TRACE_FILE, nservers) );
+    pipeline.setThreaded( GetOptionValue<bool>(ANALYSIS_THREADED) );
+    pipeline.setBatchSize( GetOptionValue<uint32>(ANALYSIS_BATCH_SIZE) );
+    pipeline.setQueueDepth( GetOptionValue<uint32>(ANALYSIS_QUEUE_DEPTH) );
+    String checkpoint_file = GetOptionValue<String>(ANALYSIS_CHECKPOINT);
+    if (!checkpoint_file.empty())
+        pipeline.setCheckpoint(checkpoint_file, GetOptionValue<uint32>(ANALYSIS_CHECKPOINT_INTERVAL));
+
+    ObjectLatencyAnalysis* ola = NULL;
+    if ( GetOptionValue<bool>(ANALYSIS_OBJECT_LATENCY) ) {
+        ola = new ObjectLatencyAnalysis();
+        pipeline.addHandler(ola);
+    }
+
+    uint32 ping_port=14050;//OBJECT_PORT_PING;
+    uint32 unservers=nservers;
+    MessageLatencyFilters filter(&ping_port,&unservers,//filter by created @ object host
+                   &unservers);//filter by destroyed @ object host
+    MessageLatencyFilters nilfilter;
+    MessageLatencyFilters pingfilter(&ping_port);
+    MessageLatencyAnalysis* mla = NULL;
+    if ( GetOptionValue<bool>(ANALYSIS_MESSAGE_LATENCY) ) {
+        mla = new MessageLatencyAnalysis(nilfilter, GetOptionValue<Duration>(ANALYSIS_MESSAGE_LATENCY_HORIZON)/*,"stage_samples.txt"*/);
+        pipeline.addHandler(mla);
+    }
+
+    FlowStatsAnalysis* fsa = NULL;
+    if ( GetOptionValue<bool>(ANALYSIS_FLOW_STATS) ) {
+        fsa = new FlowStatsAnalysis();
+        pipeline.addHandler(fsa);
+    }
+
+    bool success = pipeline.run();
+    if (success && ola != NULL) {
+        std::ofstream histogram_data("distance_latency_histogram.csv");
+        ola->printHistogramDistanceData(histogram_data,10);
+        ola->printTotalAverage(histogram_data);
+        histogram_data.close();
+    }
+
+    delete ola;
+    delete mla;
+    delete fsa;
+    return success;
+}
+
 int main(int argc, char** argv) {
     using namespace Sirikata;
 
@@ -132,22 +186,11 @@ int main(int argc, char** argv) {
 
         exit(0);
     }
-    else if ( GetOptionValue<bool>(ANALYSIS_OBJECT_LATENCY) ) {
-        ObjectLatencyAnalysis la(STATS_TRACE_FILE,nservers);
-        std::ofstream histogram_data("distance_latency_histogram.csv");
-        la.printHistogramDistanceData(histogram_data,10);
-        la.printTotalAverage(histogram_data);
-        histogram_data.close();
-        exit(0);
-    }
-    else if ( GetOptionValue<bool>(ANALYSIS_MESSAGE_LATENCY) ) {
-        uint32 ping_port=14050;//OBJECT_PORT_PING;
-        uint32 unservers=nservers;
-        MessageLatencyFilters filter(&ping_port,&unservers,//filter by created @ object host
-                       &unservers);//filter by destroyed @ object host
-        MessageLatencyFilters nilfilter;
-        MessageLatencyFilters pingfilter(&ping_port);
-        MessageLatencyAnalysis(STATS_TRACE_FILE,nservers,nilfilter/*,"stage_samples.txt"*/);
+    else if ( GetOptionValue<bool>(ANALYSIS_OBJECT_LATENCY) ||
+        GetOptionValue<bool>(ANALYSIS_MESSAGE_LATENCY) ) {
+        // Flow stats, if also requested, runs in the same pass
+        if (!run_streaming_analyses(nservers))
+            exit(-1);
         exit(0);
     }
     else if ( GetOptionValue<bool>(ANALYSIS_BANDWIDTH) ) {
@@ -366,7 +409,17 @@ int main(int argc, char** argv) {
         exit(0);
     }
     else if ( GetOptionValue<bool>(ANALYSIS_FLOW_STATS) ) {
-        FlowStatsAnalysis(STATS_TRACE_FILE, nservers);
+        if (!run_streaming_analyses(nservers))
+            exit(-1);
+        exit(0);
+    }
+    else if ( !GetOptionValue<String>(ANALYSIS_TRACE_BENCHMARK).empty() ) {
+        TraceBenchmark(
+            GetOptionValue<String>(ANALYSIS_TRACE_BENCHMARK),
+            GetOptionValue<uint32>(ANALYSIS_TRACE_BENCHMARK_SERVERS),
+            GetOptionValue<uint32>(ANALYSIS_TRACE_BENCHMARK_PACKETS),
+            GetOptionValue<uint32>(ANALYSIS_TRACE_BENCHMARK_ANALYSES)
+        );
         exit(0);
     }
 
@@ -66,7 +66,43 @@ class Benchmark : public Service {
     virtual void start() = 0;
     virtual void stop() = 0;
 
+    /** A single measurement reported by a run of a benchmark, e.g. calls/s or
+     *  ms/frame. The runner aggregates these across trials.
+     */
+    struct Result {
+        String metric;
+        float64 value;
+        String units;
+        bool lowerIsBetter;
+    };
+    typedef std::vector<Result> ResultList;
+
+    /** Get the results reported by this run. Only valid once the benchmark
+     *  has finished.
+     */
+    const ResultList& results() const {
+        return mResults;
+    }
+
   protected:
+    /** Report a measurement for this run. Benchmarks should report their key
+     *  numbers this way in addition to logging them so that the runner can
+     *  compute statistics across trials and compare against a baseline.
+     *  \param metric name of the measurement, unique within this benchmark
+     *  \param value the measured value
+     *  \param units units of the value, for display
+     *  \param lower_is_better whether a decrease in the value is an
+     *         improvement, e.g. true for latencies and false for throughputs
+     */
+    void reportResult(const String& metric, float64 value, const String& units, bool lower_is_better) {
+        Result r;
+        r.metric = metric;
+        r.value = value;
+        r.units = units;
+        r.lowerIsBetter = lower_is_better;
+        mResults.push_back(r);
+    }
+
     /** Notify the parent of this benchmark that the run has finished.  This
      *  should be used by benchmark implementations to indicate when they have
      *  finished and cleaned up without issues.
@@ -77,6 +113,7 @@ class Benchmark : public Service {
 
   private:
     FinishedCallback mFinishedCallback;
+    ResultList mResults;
 }; // class Benchmark
 
 } // namespace Sirikata
@@ -0,0 +1,21 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "BenchmarkFactory.hpp"
+
+namespace Sirikata {
+
+BenchmarkFactory& BenchmarkFactory::getSingleton() {
+    static BenchmarkFactory sFactory;
+    return sFactory;
+}
+
+bool BenchmarkFactory::registerBenchmark(const String& _name, const ConstructorType& ctor) {
+    if (!registerConstructor(_name, ctor))
+        return false;
+    mBenchmarks.push_back(_name);
+    return true;
+}
+
+} // namespace Sirikata
@@ -38,11 +38,58 @@
 namespace Sirikata {
 
 /** BenchmarkFactory handles registration of Benchmark types and instantiates
- *  individual Benchmarks.
+ *  individual Benchmarks. Benchmarks register themselves with
+ *  SIRIKATA_REGISTER_BENCHMARK, so adding one only requires adding its source
+ *  to the build.
  */
 class BenchmarkFactory : public Sirikata::Factory2<Benchmark*,Benchmark::FinishedCallback,String> {
+  public:
+    typedef std::vector<String> BenchmarkNameList;
+
+    /** Get the factory benchmarks are registered with. This is a function
+     *  local static rather than an AutoSingleton because registration happens
+     *  during static initialization.
+     */
+    static BenchmarkFactory& getSingleton();
+
+    /** Register a benchmark and add it to the list run by "all".
+     *  \param _name the name used to select the benchmark
+     *  \param ctor function which instantiates the benchmark
+     *  \returns true if the benchmark was registered, false if the name was
+     *           already in use
+     */
+    bool registerBenchmark(const String& _name, const ConstructorType& ctor);
+
+    /** Get the names of all registered benchmarks in registration order. */
+    const BenchmarkNameList& benchmarks() const {
+        return mBenchmarks;
+    }
+
+  private:
+    BenchmarkNameList mBenchmarks;
+};
+
+/** Registers a benchmark with the BenchmarkFactory singleton when
+ *  constructed. Use through SIRIKATA_REGISTER_BENCHMARK.
+ */
+class BenchmarkRegistration {
+  public:
+    BenchmarkRegistration(const String& _name, const std::tr1::function<Benchmark*(Benchmark::FinishedCallback,String)>& ctor) {
+        BenchmarkFactory::getSingleton().registerBenchmark(_name, ctor);
+    }
 };
 
+#define SIRIKATA_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define SIRIKATA_BENCHMARK_CONCAT(a, b) SIRIKATA_BENCHMARK_CONCAT_IMPL(a, b)
+
+/** Register a benchmark under the given name. Use at namespace scope in the
+ *  benchmark's source file, e.g.
+ *    SIRIKATA_REGISTER_BENCHMARK("timer-speed", TimerSpeedBenchmark::create);
+ */
+#define SIRIKATA_REGISTER_BENCHMARK(name, create_cb)                     \
+    static ::Sirikata::BenchmarkRegistration                             \
+    SIRIKATA_BENCHMARK_CONCAT(sBenchmarkRegistration, __LINE__)(name, create_cb)
+
 } // namespace Sirikata
 
 #endif //_SIRIKATA_BENCHMARK_FACTORY_HPP_
@@ -32,12 +32,106 @@
 
 #include "BenchmarkRunner.hpp"
 #include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/util/Percentile.hpp>
+#include <json_spirit/json_spirit.h>
+#include <fstream>
+#include <cmath>
+
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Sirikata {
 
+namespace {
+
+void computeStats(BenchmarkRunner::MetricStats& m) {
+    std::vector<float64> sorted(m.samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    m.count = sorted.size();
+    float64 sum = 0;
+    for(uint32 i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+    m.mean = sum / sorted.size();
+    // Sample standard deviation, since trials are a sample of the runs we
+    // could have done
+    float64 sq_diff = 0;
+    for(uint32 i = 0; i < sorted.size(); i++)
+        sq_diff += (sorted[i] - m.mean) * (sorted[i] - m.mean);
+    m.stddev = (sorted.size() > 1) ? sqrt(sq_diff / (sorted.size() - 1)) : 0;
+
+    m.min = sorted.front();
+    m.p50 = percentile(sorted, 0.5);
+    m.p90 = percentile(sorted, 0.9);
+    m.p99 = percentile(sorted, 0.99);
+    m.max = sorted.back();
+}
+
+// Two-sided critical values of Student's t distribution at the 5% level, by
+// degrees of freedom.
+float64 tCritical(float64 df) {
+    static const float64 kTable[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    static const uint32 kTableSize = sizeof(kTable)/sizeof(kTable[0]);
+    if (df < 1)
+        return kTable[0];
+    if (df <= kTableSize)
+        return kTable[(uint32)floor(df) - 1];
+    if (df <= 60) return 2.000;
+    if (df <= 120) return 1.980;
+    return 1.960;
+}
+
+// Welch's t-test for a difference in means between two samples with possibly
+// different variances.
+bool significantlyDifferent(
+    float64 mean_a, float64 stddev_a, uint32 count_a,
+    float64 mean_b, float64 stddev_b, uint32 count_b)
+{
+    if (count_a < 2 || count_b < 2)
+        return false;
+    float64 var_a = stddev_a * stddev_a / count_a;
+    float64 var_b = stddev_b * stddev_b / count_b;
+    float64 se = sqrt(var_a + var_b);
+    if (se == 0)
+        return mean_a != mean_b;
+    float64 t = fabs(mean_a - mean_b) / se;
+    float64 df = (var_a + var_b) * (var_a + var_b) /
+        (var_a * var_a / (count_a - 1) + var_b * var_b / (count_b - 1));
+    return t > tCritical(df);
+}
+
+String csvField(const String& val) {
+    if (val.find_first_of(",\"\n") == String::npos)
+        return val;
+    String escaped = "\"";
+    for(uint32 i = 0; i < val.size(); i++) {
+        if (val[i] == '"') escaped += '"';
+        escaped += val[i];
+    }
+    escaped += "\"";
+    return escaped;
+}
+
+String metricLabel(const String& benchmark, const String& param, const String& metric) {
+    if (param.empty())
+        return benchmark + " " + metric;
+    return benchmark + "(" + param + ") " + metric;
+}
+
+}
+
 BenchmarkRunner::BenchmarkRunner(BenchmarkFactory& bf, const Duration& timeout)
         : mFactory(bf),
           mTimeout(timeout),
+          mWarmup(0),
+          mTrials(1),
+          mCPU(-1),
           mIOService( new Network::IOService("BenchmarkRunner") ),
           mForcefulStop(false)
 {
@@ -47,19 +141,76 @@ BenchmarkRunner::~BenchmarkRunner() {
     delete mIOService;
 }
 
+void BenchmarkRunner::setTrials(uint32 warmup, uint32 trials) {
+    mWarmup = warmup;
+    mTrials = std::max(trials, (uint32)1);
+}
+
+void BenchmarkRunner::setCPUAffinity(int32 cpu) {
+    mCPU = cpu;
+}
+
 void BenchmarkRunner::run(const String& _name) {
     run(_name, "");
 }
 
 void BenchmarkRunner::run(const String& _name, const String& _param) {
+    if (!mFactory.hasConstructor(_name)) {
+        SILOG(benchmark,error,"Unknown benchmark: " << _name);
+        return;
+    }
+
+    // Metrics in the order they were first reported
+    MetricStatsList metrics;
+    for(uint32 trial = 0; trial < mWarmup + mTrials; trial++) {
+        Benchmark* bm = mFactory.getConstructor(_name)(
+            std::tr1::bind(&BenchmarkRunner::handleBenchmarkFinished, this),
+            _param
+                                                       );
+        bool finished = runTrial(bm);
+
+        if (finished && trial >= mWarmup) {
+            const Benchmark::ResultList& results = bm->results();
+            for(uint32 ri = 0; ri < results.size(); ri++) {
+                uint32 mi = 0;
+                while(mi < metrics.size() && metrics[mi].metric != results[ri].metric)
+                    mi++;
+                if (mi == metrics.size()) {
+                    MetricStats m;
+                    m.benchmark = _name;
+                    m.param = _param;
+                    m.metric = results[ri].metric;
+                    m.units = results[ri].units;
+                    m.lowerIsBetter = results[ri].lowerIsBetter;
+                    metrics.push_back(m);
+                }
+                metrics[mi].samples.push_back(results[ri].value);
+            }
+        }
+
+        delete bm;
+
+        // A benchmark that timed out will almost certainly do so again
+        if (!finished)
+            break;
+    }
+
+    for(uint32 mi = 0; mi < metrics.size(); mi++) {
+        MetricStats& m = metrics[mi];
+        computeStats(m);
+        SILOG(benchmark,info,
+              "BENCHMARK RESULT - " << metricLabel(m.benchmark, m.param, m.metric) << ": "
+              << "mean " << m.mean << " " << m.units << ", stddev " << m.stddev << ", "
+              << "min " << m.min << ", p50 " << m.p50 << ", p90 " << m.p90 << ", "
+              << "p99 " << m.p99 << ", max " << m.max << " (" << m.count << " trials)");
+        mStats.push_back(m);
+    }
+}
+
+bool BenchmarkRunner::runTrial(Benchmark* bm) {
     mForcefulStop = false;
     mIOService->reset();
 
-    Benchmark* bm = mFactory.getConstructor(_name)(
-        std::tr1::bind(&BenchmarkRunner::handleBenchmarkFinished, this),
-        _param
-                                                   );
-
     Thread bm_thread(
         "Benchmark Worker",
         std::tr1::bind(&BenchmarkRunner::benchmarkThread, this, bm)
@@ -76,10 +227,22 @@ void BenchmarkRunner::run(const String& _name, const String& _param) {
 
     bm_thread.join();
 
-    delete bm;
+    return !mForcefulStop;
 }
 
 void BenchmarkRunner::benchmarkThread(Benchmark* bm) {
+    if (mCPU >= 0) {
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(mCPU, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            SILOG(benchmark,warning,"Couldn't pin benchmark thread to CPU " << mCPU);
+#else
+        SILOG(benchmark,warning,"Pinning benchmark threads isn't supported on this platform");
+#endif
+    }
+
     SILOG(benchmark,info,"BENCHMARK START - " << bm->name());
 
     bm->start();
@@ -103,4 +266,132 @@ void BenchmarkRunner::handleTimeout(Benchmark* bm) {
     // And exit of IOService will consequently call delete bm
 }
 
+bool BenchmarkRunner::writeJSON(const String& filename) const {
+    namespace json = json_spirit;
+
+    json::Value output = json::Object();
+    output.put("benchmarks", json::Array());
+    json::Array& benchmarks = output.getArray("benchmarks");
+    for(uint32 i = 0; i < mStats.size(); i++) {
+        const MetricStats& m = mStats[i];
+        json::Value m_json = json::Object();
+        m_json.put("benchmark", m.benchmark);
+        m_json.put("param", m.param);
+        m_json.put("metric", m.metric);
+        m_json.put("units", m.units);
+        m_json.put("lower_is_better", m.lowerIsBetter);
+        m_json.put("count", (int64)m.count);
+        m_json.put("mean", m.mean);
+        m_json.put("stddev", m.stddev);
+        m_json.put("min", m.min);
+        m_json.put("p50", m.p50);
+        m_json.put("p90", m.p90);
+        m_json.put("p99", m.p99);
+        m_json.put("max", m.max);
+        json::Array samples;
+        for(uint32 si = 0; si < m.samples.size(); si++)
+            samples.push_back(json::Value(m.samples[si]));
+        m_json.put("samples", samples);
+        benchmarks.push_back(m_json);
+    }
+
+    std::ofstream fp(filename.c_str());
+    if (!fp) {
+        SILOG(benchmark,error,"Couldn't open " << filename << " for writing");
+        return false;
+    }
+    fp << json::write(output);
+    return fp.good();
+}
+
+bool BenchmarkRunner::writeCSV(const String& filename) const {
+    std::ofstream fp(filename.c_str());
+    if (!fp) {
+        SILOG(benchmark,error,"Couldn't open " << filename << " for writing");
+        return false;
+    }
+    fp << "benchmark,param,metric,units,lower_is_better,count,mean,stddev,min,p50,p90,p99,max" << std::endl;
+    for(uint32 i = 0; i < mStats.size(); i++) {
+        const MetricStats& m = mStats[i];
+        fp << csvField(m.benchmark) << "," << csvField(m.param) << ","
+           << csvField(m.metric) << "," << csvField(m.units) << ","
+           << (m.lowerIsBetter ? "true" : "false") << "," << m.count << ","
+           << m.mean << "," << m.stddev << "," << m.min << ","
+           << m.p50 << "," << m.p90 << "," << m.p99 << "," << m.max << std::endl;
+    }
+    return fp.good();
+}
+
+int32 BenchmarkRunner::compareBaseline(const String& filename, float64 threshold) const {
+    namespace json = json_spirit;
+
+    std::ifstream fp(filename.c_str());
+    if (!fp) {
+        SILOG(benchmark,error,"Couldn't open baseline " << filename);
+        return -1;
+    }
+    std::stringstream baseline_data;
+    baseline_data << fp.rdbuf();
+    json::Value baseline;
+    if (!json::read(baseline_data.str(), baseline) || !baseline.isArray("benchmarks")) {
+        SILOG(benchmark,error,"Couldn't parse baseline " << filename);
+        return -1;
+    }
+
+    int32 regressions = 0;
+    const json::Array& base_metrics = baseline.getArray("benchmarks");
+    for(uint32 i = 0; i < mStats.size(); i++) {
+        const MetricStats& m = mStats[i];
+        String label = metricLabel(m.benchmark, m.param, m.metric);
+
+        json::Array::const_iterator base_it = base_metrics.begin();
+        for(; base_it != base_metrics.end(); base_it++) {
+            if (base_it->getString("benchmark", "") == m.benchmark &&
+                base_it->getString("param", "") == m.param &&
+                base_it->getString("metric", "") == m.metric)
+                break;
+        }
+        if (base_it == base_metrics.end()) {
+            SILOG(benchmark,info,"BENCHMARK BASELINE - " << label << ": not in baseline");
+            continue;
+        }
+
+        float64 base_mean = base_it->getReal("mean", 0);
+        float64 base_stddev = base_it->getReal("stddev", 0);
+        uint32 base_count = (uint32)base_it->getInt("count", 0);
+        if (base_mean == 0)
+            continue;
+
+        // Positive means worse, regardless of the direction of the metric
+        float64 change = (m.mean - base_mean) / fabs(base_mean);
+        if (!m.lowerIsBetter)
+            change = -change;
+        bool significant = significantlyDifferent(
+            m.mean, m.stddev, m.count,
+            base_mean, base_stddev, base_count
+        );
+
+        if (fabs(change) >= threshold && significant) {
+            if (change > 0) {
+                regressions++;
+                SILOG(benchmark,warning,
+                      "BENCHMARK REGRESSION - " << label << ": " << m.mean << " " << m.units
+                      << " vs. baseline " << base_mean << " (" << change*100 << "% worse)");
+            }
+            else {
+                SILOG(benchmark,info,
+                      "BENCHMARK IMPROVEMENT - " << label << ": " << m.mean << " " << m.units
+                      << " vs. baseline " << base_mean << " (" << -change*100 << "% better)");
+            }
+        }
+        else {
+            SILOG(benchmark,info,
+                  "BENCHMARK BASELINE - " << label << ": " << m.mean << " " << m.units
+                  << " vs. baseline " << base_mean << ", no significant change"
+                  << ((m.count < 2 || base_count < 2) ? " (needs at least 2 trials in both runs)" : ""));
+        }
+    }
+    return regressions;
+}
+
 } // namespace Sirikata
@@ -38,9 +38,35 @@
 
 namespace Sirikata {
 
-/** BenchmarkRunner handles running benchmarks with a specified timeout. */
+/** BenchmarkRunner handles running benchmarks with a specified timeout. Each
+ *  benchmark can be run a number of times, optionally after some warmup runs
+ *  whose results are discarded, and the results it reports are summarized
+ *  across the trials. The summaries can be written as JSON or CSV and
+ *  compared against a previously saved JSON file to find regressions.
+ */
 class BenchmarkRunner {
   public:
+    /** Summary of one metric across all the trials of a benchmark. */
+    struct MetricStats {
+        String benchmark;
+        String param;
+        String metric;
+        String units;
+        bool lowerIsBetter;
+
+        uint32 count;
+        float64 mean;
+        float64 stddev;
+        float64 min;
+        float64 p50;
+        float64 p90;
+        float64 p99;
+        float64 max;
+
+        std::vector<float64> samples;
+    };
+    typedef std::vector<MetricStats> MetricStatsList;
+
     /** Create a BenchmarkRunner that will create benchmarks using the
      *  specified factory and kill benchmarks after the specified timeout.
      *  \param bf the factory to use to instantiate each Benchmark
@@ -50,6 +76,18 @@ class BenchmarkRunner {
 
     ~BenchmarkRunner();
 
+    /** Set how many times each benchmark is run.
+     *  \param warmup number of initial runs whose results are discarded
+     *  \param trials number of runs whose results are recorded
+     */
+    void setTrials(uint32 warmup, uint32 trials);
+
+    /** Pin the benchmark thread to the given CPU, or don't pin it if cpu is
+     *  negative. Only supported on Linux. Threads the benchmark starts itself
+     *  are not pinned.
+     */
+    void setCPUAffinity(int32 cpu);
+
     /** Run an individual benchmark.
      *  \param _name the name of the benchmark to run
      */
@@ -61,7 +99,41 @@ class BenchmarkRunner {
      */
     void run(const String& _name, const String& _param);
 
+    /** Get the summaries of all benchmarks run so far. */
+    const MetricStatsList& stats() const {
+        return mStats;
+    }
+
+    /** Write the summaries of all benchmarks run so far as JSON. The output
+     *  can be used as a baseline for compareBaseline().
+     *  \returns true if the file was written successfully
+     */
+    bool writeJSON(const String& filename) const;
+
+    /** Write the summaries of all benchmarks run so far as CSV, one line per
+     *  metric, without the individual samples.
+     *  \returns true if the file was written successfully
+     */
+    bool writeCSV(const String& filename) const;
+
+    /** Compare the summaries of all benchmarks run so far against a JSON file
+     *  written by writeJSON(). A metric is flagged as a regression if it got
+     *  worse by more than threshold (relative to the baseline mean) and
+     *  Welch's t-test says the difference is significant at the 5% level,
+     *  which requires at least 2 trials in both runs.
+     *  \param filename the baseline JSON file
+     *  \param threshold smallest relative change that is reported, e.g. 0.05
+     *  \returns the number of regressions found, or -1 if the baseline
+     *            couldn't be loaded
+     */
+    int32 compareBaseline(const String& filename, float64 threshold) const;
+
   private:
+    /** Run a single trial of a benchmark. Returns true if it finished
+     *  before the timeout.
+     */
+    bool runTrial(Benchmark* bm);
+
     /** Main process for benchmarking thread. */
     void benchmarkThread(Benchmark* bm);
 
@@ -75,9 +147,14 @@ class BenchmarkRunner {
 
     BenchmarkFactory& mFactory;
     Duration mTimeout;
+    uint32 mWarmup;
+    uint32 mTrials;
+    int32 mCPU;
 
     Network::IOService* mIOService;
     bool mForcefulStop;
+
+    MetricStatsList mStats;
 }; // class BenchmarkRunner
 
 } // namespace Sirikata
@@ -0,0 +1,114 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "BulletStepBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include "btBulletDynamicsCommon.h"
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_NUM_BODIES 2000
+#define NUM_FRAMES 600
+#define FIXED_STEP (1.f/60.f)
+#define MAX_SUBSTEPS 10
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("bullet-step", BulletStepBenchmark::create);
+
+BulletStepBenchmark::BulletStepBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mNumBodies(DEFAULT_NUM_BODIES),
+          mForceStop(false)
+{
+    if (!param.empty()) {
+        try {
+            mNumBodies = boost::lexical_cast<uint32>(param);
+        } catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of bodies: " << param << ", using " << mNumBodies);
+        }
+    }
+}
+
+String BulletStepBenchmark::name() {
+    return "bullet-step";
+}
+
+void BulletStepBenchmark::start() {
+    mForceStop = false;
+
+    btDbvtBroadphase broadphase;
+    btDefaultCollisionConfiguration collision_config;
+    btCollisionDispatcher dispatcher(&collision_config);
+    btSequentialImpulseConstraintSolver solver;
+    btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &collision_config);
+    world.setGravity(btVector3(0,-9.8,0));
+
+    btStaticPlaneShape ground_shape(btVector3(0,1,0), 0);
+    btDefaultMotionState ground_motion;
+    btRigidBody ground(btRigidBody::btRigidBodyConstructionInfo(0, &ground_motion, &ground_shape, btVector3(0,0,0)));
+    world.addRigidBody(&ground);
+
+    // Spheres in a loose grid, so they land and pile up rather than all
+    // colliding in the first frame
+    btSphereShape sphere_shape(0.5f);
+    btVector3 inertia(0,0,0);
+    sphere_shape.calculateLocalInertia(1.f, inertia);
+    uint32 side = 1;
+    while(side * side * side < mNumBodies) side++;
+    std::vector<btDefaultMotionState*> motions;
+    std::vector<btRigidBody*> bodies;
+    for(uint32 i = 0; i < mNumBodies; i++) {
+        btVector3 pos(
+            (i % side) * 1.5f - side * 0.75f,
+            5.f + (i / (side*side)) * 1.5f,
+            ((i / side) % side) * 1.5f - side * 0.75f
+        );
+        btDefaultMotionState* motion = new btDefaultMotionState(btTransform(btQuaternion(0,0,0,1), pos));
+        btRigidBody* body = new btRigidBody(btRigidBody::btRigidBodyConstructionInfo(1.f, motion, &sphere_shape, inertia));
+        world.addRigidBody(body);
+        motions.push_back(motion);
+        bodies.push_back(body);
+    }
+
+    // Alternate between short and long frames so substepping and
+    // interpolation both get exercised
+    Duration total = Duration::zero(), worst = Duration::zero();
+    int substeps = 0;
+    uint32 frame;
+    for(frame = 0; frame < NUM_FRAMES && !mForceStop; frame++) {
+        btScalar dt = (frame % 3 == 0) ? (2.5f * FIXED_STEP) : (0.5f * FIXED_STEP);
+        Time step_start = Timer::now();
+        substeps += world.stepSimulation(dt, MAX_SUBSTEPS, FIXED_STEP);
+        Duration step_time = Timer::now() - step_start;
+        total += step_time;
+        if (step_time > worst) worst = step_time;
+    }
+
+    for(uint32 i = 0; i < bodies.size(); i++) {
+        world.removeRigidBody(bodies[i]);
+        delete bodies[i];
+        delete motions[i];
+    }
+    world.removeRigidBody(&ground);
+
+    if (mForceStop)
+        return;
+
+    SILOG(benchmark,info,
+          mNumBodies << " bodies, " << frame << " frames, " << substeps << " internal steps: "
+          << "mean " << (total / (uint64)frame) << " per frame, "
+          << "mean " << (total / (uint64)std::max(substeps, 1)) << " per internal step, "
+          << "max " << worst << " per frame");
+    reportResult("frame time", (total / (uint64)frame).toSeconds() * 1000.0, "ms", true);
+    reportResult("internal step time", (total / (uint64)std::max(substeps, 1)).toSeconds() * 1000.0, "ms", true);
+    reportResult("max frame time", worst.toSeconds() * 1000.0, "ms", true);
+
+    notifyFinished();
+}
+
+void BulletStepBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,40 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_BULLET_STEP_BENCHMARK_HPP_
+#define _SIRIKATA_BULLET_STEP_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Report how long it takes to step a Bullet world with thousands of rigid
+ *  bodies dropped onto a ground plane, configured the way the bulletphysics
+ *  location service sets up its world. Frames are driven at an uneven rate
+ *  and stepped with fixed size substeps, as the service does. The parameter
+ *  is the number of bodies (default 2000).
+ */
+class BulletStepBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new BulletStepBenchmark(finished_cb, _param);
+    }
+
+    BulletStepBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    uint32 mNumBodies;
+    bool mForceStop;
+}; // class BulletStepBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_BULLET_STEP_BENCHMARK_HPP_
@@ -0,0 +1,116 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "FlowHashBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/util/UUID.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_FLOWS 100000
+// Number of destinations the flows converge on
+#define NUM_SINKS 16
+// Number of passes over the flows, simulating pushes on existing flows
+#define LOOKUP_PASSES 10
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("flow-hash", FlowHashBenchmark::create);
+
+namespace {
+
+typedef std::pair<UUID, UUID> Flow;
+
+struct LegacyFlowHasher {
+    size_t operator() (const Flow& f) const {
+        return *(uint32*)f.first.getArray().data() ^ *(uint32*)f.second.getArray().data();
+    }
+};
+
+struct PairFlowHasher {
+    size_t operator() (const Flow& f) const {
+        return UUID::hash(f.first, f.second);
+    }
+};
+
+// Returns the throughput in ops/s
+template<typename HasherT>
+float64 runFlowTable(const String& label, const std::vector<Flow>& flows, const bool& force_stop) {
+    typedef std::tr1::unordered_map<Flow, uint32, HasherT> FlowTable;
+    FlowTable table;
+
+    Time start_time = Timer::now();
+    for(uint32 i = 0; i < flows.size() && !force_stop; i++)
+        table[flows[i]] = i;
+    uint64 hits = 0;
+    for(uint32 pass = 0; pass < LOOKUP_PASSES && !force_stop; pass++) {
+        for(uint32 i = 0; i < flows.size(); i++)
+            hits += (table.find(flows[i]) != table.end()) ? 1 : 0;
+    }
+    if (force_stop)
+        return 0;
+    Duration dur = Timer::now() - start_time;
+
+    uint32 max_bucket = 0;
+    for(uint32 b = 0; b < table.bucket_count(); b++)
+        max_bucket = std::max(max_bucket, (uint32)table.bucket_size(b));
+
+    uint64 ops = flows.size() * (1 + LOOKUP_PASSES);
+    SILOG(benchmark,info,
+          label << ": " << flows.size() << " flows, " << ops << " ops, " << dur << ": "
+          << float(ops)/dur.toSeconds() << " ops/s, "
+          << "longest bucket " << max_bucket << ", " << hits << " hits");
+    return float(ops)/dur.toSeconds();
+}
+
+}
+
+FlowHashBenchmark::FlowHashBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mNumFlows(DEFAULT_FLOWS),
+          mForceStop(false)
+{
+    if (!param.empty())
+        mNumFlows = boost::lexical_cast<uint32>(param);
+}
+
+String FlowHashBenchmark::name() {
+    return "flow-hash";
+}
+
+void FlowHashBenchmark::start() {
+    mForceStop = false;
+
+    std::vector<UUID> sinks;
+    for(uint32 i = 0; i < NUM_SINKS; i++)
+        sinks.push_back(UUID::random());
+
+    // Many sources sending to a few sinks, half of which also get replies,
+    // giving both the many-to-one and the A->B/B->A patterns.
+    std::vector<Flow> flows;
+    flows.reserve(mNumFlows);
+    while(flows.size() < mNumFlows) {
+        UUID source = UUID::random();
+        const UUID& sink = sinks[flows.size() % NUM_SINKS];
+        flows.push_back(Flow(source, sink));
+        if (flows.size() < mNumFlows && flows.size() % 2 == 0)
+            flows.push_back(Flow(sink, source));
+    }
+
+    float64 xor_ops = runFlowTable<LegacyFlowHasher>("xor hash", flows, mForceStop);
+    float64 pair_ops = runFlowTable<PairFlowHasher>("pair hash", flows, mForceStop);
+
+    if (mForceStop)
+        return;
+
+    reportResult("xor hash", xor_ops, "ops/s", false);
+    reportResult("pair hash", pair_ops, "ops/s", false);
+
+    notifyFinished();
+}
+
+void FlowHashBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
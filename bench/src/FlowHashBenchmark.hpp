@@ -0,0 +1,40 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_FLOW_HASH_BENCHMARK_HPP_
+#define _SIRIKATA_FLOW_HASH_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Test the throughput of a flow table keyed by (source, dest) UUID pairs, as
+ *  used by the space server's flow schedulers. Traffic is many-to-one with
+ *  return flows, comparing the old xor-of-first-words hash with
+ *  UUID::hash(first, second). The parameter is the number of flows, defaulting
+ *  to 100k.
+ */
+class FlowHashBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new FlowHashBenchmark(finished_cb, _param);
+    }
+
+    FlowHashBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    uint32 mNumFlows;
+    bool mForceStop;
+}; // class FlowHashBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_FLOW_HASH_BENCHMARK_HPP_
@@ -0,0 +1,104 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "HttpDecodeBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/transfer/HttpTransferHandler.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("http-decode", HttpDecodeBenchmark::create);
+
+HttpDecodeBenchmark::HttpDecodeBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mStartTime(Time::null()),
+          mFirstTime(Time::null()),
+          mCompleted(0),
+          mFailed(0),
+          mBytes(0)
+{
+    boost::split(mURLs, param, boost::is_any_of(","));
+    mURLs.erase(std::remove(mURLs.begin(), mURLs.end(), String()), mURLs.end());
+}
+
+String HttpDecodeBenchmark::name() {
+    return "http-decode";
+}
+
+void HttpDecodeBenchmark::handleChunk(Transfer::DenseDataPtr data) {
+    boost::mutex::scoped_lock lock(mMutex);
+    if (mCompleted == 0)
+        mFirstTime = Timer::now();
+    mCompleted++;
+    if (data)
+        mBytes += data->length();
+    else
+        mFailed++;
+    mCond.notify_all();
+}
+
+void HttpDecodeBenchmark::start() {
+    using namespace Sirikata::Transfer;
+
+    mForceStop = false;
+    if (mURLs.empty()) {
+        SILOG(benchmark,error,"http-decode requires a comma separated list of URLs");
+        notifyFinished();
+        return;
+    }
+
+    HttpChunkHandler& handler = HttpChunkHandler::getSingleton();
+    uint32 decoded_before = handler.statsChunksDecoded();
+    uint64 decode_us_before = handler.statsDecodeMicroseconds();
+
+    mStartTime = Timer::now();
+    for(uint32 i = 0; i < mURLs.size(); i++) {
+        // Random fingerprints guarantee we miss the cache and go to the CDN
+        unsigned char digest[SHA256::static_size];
+        for(uint32 b = 0; b < SHA256::static_size; b++)
+            digest[b] = (unsigned char)randInt<uint32>(0, 255);
+        Fingerprint fp = SHA256::convertFromBinary(digest);
+
+        std::tr1::shared_ptr<Chunk> chunk(new Chunk(fp, Range(true)));
+        ChunkList chunks;
+        chunks.push_back(*chunk);
+        std::tr1::shared_ptr<RemoteFileMetadata> file(
+            new RemoteFileMetadata(fp, URI(mURLs[i]), 0, chunks, FileHeaders())
+        );
+        handler.get(file, chunk, std::tr1::bind(&HttpDecodeBenchmark::handleChunk, this, _1));
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mMutex);
+        while(mCompleted < mURLs.size() && !mForceStop)
+            mCond.wait(lock);
+    }
+    if (mForceStop)
+        return;
+    Time end_time = Timer::now();
+
+    uint32 decoded = handler.statsChunksDecoded() - decoded_before;
+    uint64 decode_us = handler.statsDecodeMicroseconds() - decode_us_before;
+    SILOG(benchmark,info,
+          mURLs.size() << " assets (" << mFailed << " failed), " << mBytes << " bytes: "
+          << "first usable after " << (mFirstTime - mStartTime) << ", "
+          << "all usable after " << (end_time - mStartTime) << ", "
+          << decoded << " decoded in " << (decode_us / 1000.0) << " ms of decode time");
+    reportResult("first usable", (mFirstTime - mStartTime).toSeconds() * 1000.0, "ms", true);
+    reportResult("all usable", (end_time - mStartTime).toSeconds() * 1000.0, "ms", true);
+    reportResult("decode time", decode_us / 1000.0, "ms", true);
+
+    notifyFinished();
+}
+
+void HttpDecodeBenchmark::stop() {
+    boost::mutex::scoped_lock lock(mMutex);
+    mForceStop = true;
+    mCond.notify_all();
+}
+
+} // namespace Sirikata
@@ -0,0 +1,52 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_HTTP_DECODE_BENCHMARK_HPP_
+#define _SIRIKATA_HTTP_DECODE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/transfer/TransferData.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Sirikata {
+
+/** Request a batch of assets through HttpChunkHandler, which decodes 7z/ARHC
+ *  compressed responses, and report the time until the first and the last
+ *  asset are usable. The parameter is a comma separated list of URLs, e.g.
+ *  compressed textures served by cdn/fake-sirikata-cdn.py.
+ */
+class HttpDecodeBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new HttpDecodeBenchmark(finished_cb, _param);
+    }
+
+    HttpDecodeBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void handleChunk(Transfer::DenseDataPtr data);
+
+    std::vector<String> mURLs;
+    bool mForceStop;
+
+    boost::mutex mMutex;
+    boost::condition_variable mCond;
+    Time mStartTime;
+    Time mFirstTime;
+    uint32 mCompleted;
+    uint32 mFailed;
+    uint64 mBytes;
+}; // class HttpDecodeBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_HTTP_DECODE_BENCHMARK_HPP_
@@ -0,0 +1,146 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "IOServicePoolBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/util/Percentile.hpp>
+#include <boost/thread.hpp>
+
+#define NUM_THREADS 4
+#define NUM_STRANDS 64
+// Handler chains running concurrently in each strand
+#define CHAINS_PER_STRAND 4
+// One in this many handlers continues its chain on another strand
+#define HOP_RATE 8
+#define RUN_DURATION Duration::seconds(2.0)
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("ioservice-pool", IOServicePoolBenchmark::create);
+
+// Only touched by handlers in its strand, so needs no locking
+struct IOServicePoolBenchmark::StrandData {
+    Network::IOStrand* strand;
+    // Amount of work each handler does, varied between strands so some
+    // threads end up busier than others
+    uint32 work;
+    uint32 rng;
+    uint64 executed;
+    std::vector<uint32> latencies;
+};
+
+IOServicePoolBenchmark::IOServicePoolBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mParam(param),
+          mForceStop(false),
+          mStopping(false)
+{
+}
+
+String IOServicePoolBenchmark::name() {
+    return "ioservice-pool";
+}
+
+void IOServicePoolBenchmark::handler(StrandData* data, const Time& posted) {
+    Time start = Timer::now();
+    data->latencies.push_back((uint32)(start - posted).toMicroseconds());
+    data->executed++;
+
+    volatile uint32 accum = 0;
+    for(uint32 i = 0; i < data->work * 64; i++)
+        accum += i * 2654435761u;
+
+    if (mStopping)
+        return;
+
+    data->rng = data->rng * 1103515245 + 12345;
+    StrandData* next = data;
+    if ((data->rng >> 16) % HOP_RATE == 0)
+        next = mStrands[(data->rng >> 8) % mStrands.size()];
+    next->strand->post(
+        std::tr1::bind(&IOServicePoolBenchmark::handler, this, next, Timer::now()),
+        "IOServicePoolBenchmark::handler"
+    );
+}
+
+void IOServicePoolBenchmark::runPool(const String& label, Network::IOServicePool::ThreadingModel model, bool steal) {
+    Network::IOServicePool* pool = new Network::IOServicePool("IOServicePoolBenchmark", NUM_THREADS, model);
+    pool->setWorkStealing(steal);
+    pool->startWork();
+
+    mStopping = false;
+    for(uint32 i = 0; i < NUM_STRANDS; i++) {
+        StrandData* data = new StrandData();
+        data->strand = pool->service()->createStrand("IOServicePoolBenchmark Strand");
+        data->work = 1 + (i % 8) * (i % 8);
+        data->rng = i + 1;
+        data->executed = 0;
+        mStrands.push_back(data);
+    }
+    for(uint32 i = 0; i < NUM_STRANDS; i++) {
+        for(uint32 c = 0; c < CHAINS_PER_STRAND; c++) {
+            mStrands[i]->strand->post(
+                std::tr1::bind(&IOServicePoolBenchmark::handler, this, mStrands[i], Timer::now()),
+                "IOServicePoolBenchmark::handler"
+            );
+        }
+    }
+
+    Time start_time = Timer::now();
+    pool->run();
+    while(!mForceStop && Timer::now() - start_time < RUN_DURATION)
+        Timer::sleep(Duration::milliseconds((int64)10));
+    mStopping = true;
+    Duration dur = Timer::now() - start_time;
+    pool->join();
+
+    uint64 executed = 0;
+    std::vector<uint32> latencies;
+    for(uint32 i = 0; i < mStrands.size(); i++) {
+        executed += mStrands[i]->executed;
+        latencies.insert(latencies.end(), mStrands[i]->latencies.begin(), mStrands[i]->latencies.end());
+        delete mStrands[i]->strand;
+        delete mStrands[i];
+    }
+    mStrands.clear();
+    delete pool;
+
+    if (mForceStop)
+        return;
+
+    std::sort(latencies.begin(), latencies.end());
+    float64 throughput = executed / dur.toSeconds();
+    SILOG(benchmark,info,
+          label << ": " << executed << " handlers in " << dur << ": " << throughput << " handlers/s, latency "
+          << "p50 " << percentile(latencies, 0.5) << "us, "
+          << "p99 " << percentile(latencies, 0.99) << "us, "
+          << "p99.9 " << percentile(latencies, 0.999) << "us");
+    reportResult(label + " throughput", throughput, "handlers/s", false);
+    reportResult(label + " p50 latency", percentile(latencies, 0.5), "us", true);
+    reportResult(label + " p99 latency", percentile(latencies, 0.99), "us", true);
+}
+
+void IOServicePoolBenchmark::start() {
+    mForceStop = false;
+
+    if (mParam.empty() || mParam == "shared")
+        runPool("shared", Network::IOServicePool::SharedService, false);
+    if (!mForceStop && (mParam.empty() || mParam == "per-thread"))
+        runPool("per-thread", Network::IOServicePool::PerThreadServices, true);
+    if (!mForceStop && (mParam.empty() || mParam == "per-thread-nosteal"))
+        runPool("per-thread-nosteal", Network::IOServicePool::PerThreadServices, false);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void IOServicePoolBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,50 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_IOSERVICE_POOL_BENCHMARK_HPP_
+#define _SIRIKATA_IOSERVICE_POOL_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/network/IOServicePool.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+
+namespace Sirikata {
+
+/** Compare handler throughput and latency for IOServicePool's threading
+ *  models. Many strands each run chains of handlers with uneven amounts of
+ *  work, occasionally hopping to another strand like messages passed between
+ *  components. The parameter selects the pool: "shared", "per-thread" or
+ *  "per-thread-nosteal". By default all three are run.
+ */
+class IOServicePoolBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new IOServicePoolBenchmark(finished_cb, _param);
+    }
+
+    IOServicePoolBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    struct StrandData;
+
+    void runPool(const String& label, Network::IOServicePool::ThreadingModel model, bool steal);
+    void handler(StrandData* data, const Time& posted);
+
+    String mParam;
+    bool mForceStop;
+    // Set when handlers should stop reposting themselves
+    AtomicValue<bool> mStopping;
+    std::vector<StrandData*> mStrands;
+}; // class IOServicePoolBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_IOSERVICE_POOL_BENCHMARK_HPP_
@@ -0,0 +1,168 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "JpegArhcBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/jpeg-arhc/Kernels.hpp>
+#include <sirikata/core/jpeg-arhc/Decoder.hpp>
+#include <sirikata/core/jpeg-arhc/Reader.hpp>
+#include <stdio.h>
+
+// Size of the synthetic scan buffer
+#define SCAN_BYTES (16*1024*1024)
+#define SCAN_PASSES 20
+#define ROUND_TRIP_TRIALS 5
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("jpeg-arhc", JpegArhcBenchmark::create);
+
+namespace {
+
+typedef size_t (*ScanFn)(const uint8 *data, size_t len);
+
+// Walk the buffer the way the decoder does: scan for the next 0xff, step over
+// the stuffed byte and continue.
+uint64 scanAll(ScanFn scan, const std::vector<uint8>& data) {
+    uint64 found = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        pos += scan(&data[pos], data.size() - pos);
+        if (pos < data.size()) {
+            found++;
+            pos += 2;
+        }
+    }
+    return found;
+}
+
+// Returns the throughput in MB/s
+float64 reportScan(const String& label, ScanFn scan, const std::vector<uint8>& data, const bool& force_stop) {
+    uint64 found = 0;
+    Time start_time = Timer::now();
+    for(uint32 pass = 0; pass < SCAN_PASSES && !force_stop; pass++)
+        found += scanAll(scan, data);
+    if (force_stop)
+        return 0;
+    Duration dur = Timer::now() - start_time;
+    double mb = double(data.size()) * SCAN_PASSES / (1024.0 * 1024.0);
+    SILOG(benchmark,info,
+          label << ": " << mb << " MB in " << dur << ": " << mb / dur.toSeconds() << " MB/s, "
+          << found / SCAN_PASSES << " stuffed bytes per pass");
+    return mb / dur.toSeconds();
+}
+
+size_t ScanScalar(const uint8 *data, size_t len) {
+    return FindStuffedByteScalar(data, len);
+}
+size_t ScanDispatched(const uint8 *data, size_t len) {
+    return FindStuffedByte(data, len);
+}
+
+}
+
+JpegArhcBenchmark::JpegArhcBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mFilename(param),
+          mForceStop(false)
+{
+}
+
+String JpegArhcBenchmark::name() {
+    return "jpeg-arhc";
+}
+
+void JpegArhcBenchmark::runScanKernels() {
+    // Random bytes with 0xff followed by a stuffed 0x00, as in entropy coded
+    // segments.
+    std::vector<uint8> data(SCAN_BYTES);
+    for(size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8)(rand() & 0xff);
+        if (data[i] == 0xff && i + 1 < data.size())
+            data[++i] = 0x00;
+    }
+    if (data.back() == 0xff)
+        data.back() = 0xfe;
+
+    float64 scalar_mbps = reportScan("scalar scan", &ScanScalar, data, mForceStop);
+    float64 dispatched_mbps = reportScan(String(JpegKernelName()) + " scan", &ScanDispatched, data, mForceStop);
+    if (mForceStop)
+        return;
+    reportResult("scalar scan", scalar_mbps, "MB/s", false);
+    // Not named after the kernel so results compare across machines
+    reportResult("dispatched scan", dispatched_mbps, "MB/s", false);
+}
+
+void JpegArhcBenchmark::runRoundTrip() {
+    FILE* fp = fopen(mFilename.c_str(), "rb");
+    if (fp == NULL) {
+        SILOG(benchmark,error,"Couldn't open " << mFilename);
+        return;
+    }
+    JpegAllocator<uint8_t> alloc;
+    std::vector<uint8, JpegAllocator<uint8_t> > input(alloc);
+    uint8 chunk[65536];
+    size_t nread;
+    while((nread = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        input.insert(input.end(), chunk, chunk + nread);
+    fclose(fp);
+
+    uint8 componentCoalescing = Decoder::comp12coalesce;
+    Duration encode_time = Duration::zero(), decode_time = Duration::zero();
+    bool exact = true;
+    size_t arhc_size = 0;
+    for(uint32 trial = 0; trial < ROUND_TRIP_TRIALS && !mForceStop; trial++) {
+        MemReadWriter original(alloc);
+        original.CopyIn(input, 0);
+        MemReadWriter arhc(alloc);
+        Time start_time = Timer::now();
+        JpegError err = Decode(original, arhc, componentCoalescing, alloc);
+        Time encoded_time = Timer::now();
+        if (err != JpegError()) {
+            SILOG(benchmark,error,"Failed to convert " << mFilename << " to ARHC");
+            return;
+        }
+        arhc_size = arhc.buffer().size();
+        MemReadWriter round(alloc);
+        err = Decode(arhc, round, componentCoalescing, alloc);
+        Time finish_time = Timer::now();
+        if (err != JpegError()) {
+            SILOG(benchmark,error,"Failed to convert " << mFilename << " back to JPEG");
+            return;
+        }
+        encode_time += encoded_time - start_time;
+        decode_time += finish_time - encoded_time;
+        exact = exact && (round.buffer() == input);
+    }
+    if (mForceStop)
+        return;
+
+    double mb = double(input.size()) * ROUND_TRIP_TRIALS / (1024.0 * 1024.0);
+    SILOG(benchmark,info,
+          mFilename << ": " << input.size() << " bytes, " << arhc_size << " bytes as ARHC, "
+          << "jpeg->arhc " << mb / encode_time.toSeconds() << " MB/s, "
+          << "arhc->jpeg " << mb / decode_time.toSeconds() << " MB/s, "
+          << (exact ? "bit-exact" : "MISMATCH"));
+    reportResult("jpeg->arhc", mb / encode_time.toSeconds(), "MB/s", false);
+    reportResult("arhc->jpeg", mb / decode_time.toSeconds(), "MB/s", false);
+}
+
+void JpegArhcBenchmark::start() {
+    mForceStop = false;
+
+    runScanKernels();
+    if (!mFilename.empty() && !mForceStop)
+        runRoundTrip();
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void JpegArhcBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
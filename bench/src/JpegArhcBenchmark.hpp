@@ -0,0 +1,42 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JPEG_ARHC_BENCHMARK_HPP_
+#define _SIRIKATA_JPEG_ARHC_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Report the throughput, in MB/s, of the jpeg-arhc byte stuffing scan kernel
+ *  (scalar vs. the dispatched vector version) over synthetic entropy coded
+ *  data. If the parameter names a JPEG file, also report the JPEG -> ARHC and
+ *  ARHC -> JPEG throughput for it and check that the round trip is bit-exact.
+ */
+class JpegArhcBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new JpegArhcBenchmark(finished_cb, _param);
+    }
+
+    JpegArhcBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void runScanKernels();
+    void runRoundTrip();
+
+    String mFilename;
+    bool mForceStop;
+}; // class JpegArhcBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_JPEG_ARHC_BENCHMARK_HPP_
@@ -0,0 +1,139 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "LocUpdateCodecBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/network/Message.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
+#include "Protocol_Loc.pbj.hpp"
+
+#define NUM_OBJECTS 1000
+#define NUM_MESSAGES 20000
+// Matches AlwaysLocationUpdatePolicy's default loc.max-per-result
+#define UPDATES_PER_MESSAGE 5
+// Every ORIENTATION_PERIOD'th update for an object also turns it
+#define ORIENTATION_PERIOD 4
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("loc-update-codec", LocUpdateCodecBenchmark::create);
+
+namespace {
+
+UUID objectID(uint32 idx) {
+    uint8 data[UUID::static_size] = { 0 };
+    memcpy(data, &idx, sizeof(idx));
+    return UUID(data, UUID::static_size);
+}
+
+// Builds the idx'th message of the stream. Objects are updated round robin,
+// moving along fixed paths, with the full set of properties filled in as
+// AlwaysLocationUpdatePolicy does.
+void buildMessage(uint32 idx, Sirikata::Protocol::Loc::BulkLocationUpdate& blu) {
+    for(uint32 i = 0; i < UPDATES_PER_MESSAGE; i++) {
+        uint32 n = idx * UPDATES_PER_MESSAGE + i;
+        uint32 obj = n % NUM_OBJECTS;
+        uint32 round = n / NUM_OBJECTS;
+
+        Sirikata::Protocol::Loc::ILocationUpdate update = blu.add_update();
+        update.set_object(objectID(obj));
+        update.set_seqno(round);
+
+        Vector3f vel((float32)(obj % 7) - 3.f, 0.f, (float32)(obj % 5) - 2.f);
+        Time t = Time::microseconds(1000000 + (int64)n * 100);
+        Sirikata::Protocol::ITimedMotionVector loc = update.mutable_location();
+        loc.set_t(t);
+        loc.set_position(Vector3f((float32)(obj % 100) * 10.f, 2.f, (float32)(obj / 100) * 10.f) + vel * (float32)(round * 0.5));
+        loc.set_velocity(vel);
+
+        uint32 turn = round / ORIENTATION_PERIOD;
+        Sirikata::Protocol::ITimedMotionQuaternion orient = update.mutable_orientation();
+        orient.set_t(Time::microseconds(1000000 + (int64)turn * 100 * NUM_OBJECTS * ORIENTATION_PERIOD));
+        orient.set_position(Quaternion(Vector3f::unitY(), (float32)turn * 0.1f));
+        orient.set_velocity(Quaternion::identity());
+
+        Sirikata::Protocol::IAggregateBoundingInfo bounds = update.mutable_aggregate_bounds();
+        bounds.set_center_offset(Vector3f(0, 0, 0));
+        bounds.set_center_bounds_radius(0);
+        bounds.set_max_object_size(1.f + (float32)(obj % 3));
+
+        update.set_mesh(obj % 2 ? "meerkat:///test/duck.dae/optimized/0/duck.dae" : "meerkat:///test/sphere.dae/optimized/0/sphere.dae");
+        update.set_physics("");
+    }
+}
+
+}
+
+LocUpdateCodecBenchmark::LocUpdateCodecBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mParam(param),
+          mForceStop(false)
+{
+}
+
+String LocUpdateCodecBenchmark::name() {
+    return "loc-update-codec";
+}
+
+void LocUpdateCodecBenchmark::runCodec(const String& label, bool compact) {
+    std::vector<Sirikata::Protocol::Loc::BulkLocationUpdate> messages(NUM_MESSAGES);
+    for(uint32 i = 0; i < NUM_MESSAGES; i++)
+        buildMessage(i, messages[i]);
+
+    CompactLocUpdateEncoder encoder(0.001f, 0.001f);
+    std::vector<String> encoded(NUM_MESSAGES);
+    uint64 total_bytes = 0;
+    Time encode_start = Timer::now();
+    for(uint32 i = 0; i < NUM_MESSAGES && !mForceStop; i++) {
+        encoded[i] = compact ? encoder.encode(messages[i]) : serializePBJMessage(messages[i]);
+        total_bytes += encoded[i].size();
+    }
+    Duration encode_dur = Timer::now() - encode_start;
+
+    CompactLocUpdateDecoder decoder;
+    uint32 failures = 0;
+    Time decode_start = Timer::now();
+    for(uint32 i = 0; i < NUM_MESSAGES && !mForceStop; i++) {
+        Sirikata::Protocol::Loc::BulkLocationUpdate decoded;
+        if (!decoder.decode(encoded[i], decoded) || decoded.update_size() != UPDATES_PER_MESSAGE)
+            failures++;
+    }
+    Duration decode_dur = Timer::now() - decode_start;
+
+    if (mForceStop)
+        return;
+
+    uint32 num_updates = NUM_MESSAGES * UPDATES_PER_MESSAGE;
+    float64 bytes_per_update = (float64)total_bytes / num_updates;
+    float64 encode_ns = encode_dur.toMicroseconds() * 1000.0 / num_updates;
+    float64 decode_ns = decode_dur.toMicroseconds() * 1000.0 / num_updates;
+    SILOG(benchmark,info,
+          label << ": " << num_updates << " updates in " << total_bytes << " bytes, "
+          << bytes_per_update << " bytes/update, "
+          << "encode " << encode_ns << " ns/update, decode " << decode_ns << " ns/update, "
+          << failures << " decode failures");
+    reportResult(label + " size", bytes_per_update, "bytes/update", true);
+    reportResult(label + " encode", encode_ns, "ns/update", true);
+    reportResult(label + " decode", decode_ns, "ns/update", true);
+}
+
+void LocUpdateCodecBenchmark::start() {
+    mForceStop = false;
+
+    if (mParam.empty() || mParam == "pbj")
+        runCodec("pbj", false);
+    if (!mForceStop && (mParam.empty() || mParam == "compact"))
+        runCodec("compact", true);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void LocUpdateCodecBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,42 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LOC_UPDATE_CODEC_BENCHMARK_HPP_
+#define _SIRIKATA_LOC_UPDATE_CODEC_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Compare the size and speed of location updates encoded as plain
+ *  BulkLocationUpdates and with CompactLocUpdateEncoder. A stream of updates
+ *  for a set of moving objects, as one subscriber would receive them, is
+ *  encoded and decoded, reporting bytes per update and encode and decode
+ *  time. The parameter selects "pbj" or "compact"; by default both are run.
+ */
+class LocUpdateCodecBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new LocUpdateCodecBenchmark(finished_cb, _param);
+    }
+
+    LocUpdateCodecBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void runCodec(const String& label, bool compact);
+
+    String mParam;
+    bool mForceStop;
+}; // class LocUpdateCodecBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LOC_UPDATE_CODEC_BENCHMARK_HPP_
@@ -0,0 +1,176 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MeshFormatBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/mesh/Meshdata.hpp>
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+#include <fstream>
+#include <sstream>
+
+// Number of times each encoding is loaded
+#define LOAD_ITERATIONS 20
+// Vertices per side of the synthetic grid mesh
+#define GRID_DIM 200
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("mesh-format", MeshFormatBenchmark::create);
+
+namespace {
+
+Mesh::MeshdataPtr makeGridMesh() {
+    Mesh::MeshdataPtr mesh(new Mesh::Meshdata());
+    Mesh::SubMeshGeometry geo;
+    geo.name = "grid";
+    Mesh::SubMeshGeometry::TextureSet uvs;
+    uvs.stride = 2;
+    for(int y = 0; y < GRID_DIM; y++) {
+        for(int x = 0; x < GRID_DIM; x++) {
+            geo.positions.push_back(Vector3f(x, y, sinf(x * .1f) * cosf(y * .1f)));
+            geo.normals.push_back(Vector3f(0, 0, 1));
+            uvs.uvs.push_back(x / (float)GRID_DIM);
+            uvs.uvs.push_back(y / (float)GRID_DIM);
+        }
+    }
+    geo.texUVs.push_back(uvs);
+    // Multiple primitives to stay within 16-bit indices
+    const int rows_per_prim = 65535 / GRID_DIM - 1;
+    for(int y0 = 0; y0 < GRID_DIM-1; y0 += rows_per_prim) {
+        Mesh::SubMeshGeometry::Primitive prim;
+        prim.primitiveType = Mesh::SubMeshGeometry::Primitive::TRIANGLES;
+        prim.materialId = 0;
+        for(int y = y0; y < std::min(y0 + rows_per_prim, GRID_DIM-1); y++) {
+            for(int x = 0; x < GRID_DIM-1; x++) {
+                uint32 i = (y-y0)*GRID_DIM+x;
+                prim.indices.push_back(i); prim.indices.push_back(i+1); prim.indices.push_back(i+GRID_DIM);
+                prim.indices.push_back(i+1); prim.indices.push_back(i+GRID_DIM+1); prim.indices.push_back(i+GRID_DIM);
+            }
+        }
+        geo.primitives.push_back(prim);
+    }
+    geo.recomputeBounds();
+    mesh->geometry.push_back(geo);
+
+    Mesh::MaterialEffectInfo mat;
+    mat.shininess = 1.f;
+    mat.reflectivity = 0.f;
+    mesh->materials.push_back(mat);
+
+    mesh->nodes.push_back(Mesh::Node(Matrix4x4f::identity()));
+    mesh->rootNodes.push_back(0);
+    Mesh::GeometryInstance inst;
+    inst.geometryIndex = 0;
+    inst.parentNode = 0;
+    inst.materialBindingMap[0] = 0;
+    mesh->instances.push_back(inst);
+    mesh->globalTransform = Matrix4x4f::identity();
+    return mesh;
+}
+
+Transfer::DenseDataPtr encode(ModelsSystem* msys, Mesh::MeshdataPtr mesh) {
+    std::stringstream ss;
+    if (!msys->convertVisual(mesh, "", ss))
+        return Transfer::DenseDataPtr();
+    return Transfer::DenseDataPtr(new Transfer::DenseData(ss.str()));
+}
+
+// Returns the mean time per load in ms, or a negative value if it couldn't be
+// measured
+float64 timeLoads(const String& label, ModelsSystem* msys, Transfer::DenseDataPtr data, const bool& force_stop) {
+    if (!data) {
+        SILOG(benchmark,error,label << ": encoding failed");
+        return -1;
+    }
+
+    Time start_time = Timer::now();
+    uint32 loaded = 0;
+    for(uint32 i = 0; i < LOAD_ITERATIONS && !force_stop; i++) {
+        if (msys->load(data))
+            loaded++;
+    }
+    if (force_stop)
+        return -1;
+    Duration dur = Timer::now() - start_time;
+
+    SILOG(benchmark,info,
+          label << ": " << data->length() << " bytes, "
+          << loaded << "/" << LOAD_ITERATIONS << " loads in " << dur << ", "
+          << (dur.toMilliseconds() / (double)LOAD_ITERATIONS) << " ms/load");
+    return dur.toMilliseconds() / (double)LOAD_ITERATIONS;
+}
+
+}
+
+MeshFormatBenchmark::MeshFormatBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mFilename(param),
+          mForceStop(false)
+{
+}
+
+String MeshFormatBenchmark::name() {
+    return "mesh-format";
+}
+
+void MeshFormatBenchmark::start() {
+    mForceStop = false;
+
+    PluginManager plugins;
+    plugins.loadList("colladamodels,mesh-binary");
+
+    ModelsSystemFactory& factory = ModelsSystemFactory::getSingleton();
+    if (!factory.hasConstructor("mesh-binary")) {
+        SILOG(benchmark,error,"mesh-binary plugin is not available");
+        notifyFinished();
+        return;
+    }
+    ModelsSystem* collada = factory.hasConstructor("colladamodels") ? factory.getConstructor("colladamodels")("") : NULL;
+    ModelsSystem* binary = factory.getConstructor("mesh-binary")("");
+    ModelsSystem* quantized = factory.getConstructor("mesh-binary-quantized")("");
+
+    Mesh::MeshdataPtr mesh;
+    Transfer::DenseDataPtr collada_data;
+    if (!mFilename.empty()) {
+        std::ifstream fin(mFilename.c_str(), std::ios::in | std::ios::binary);
+        std::stringstream contents;
+        contents << fin.rdbuf();
+        collada_data = Transfer::DenseDataPtr(new Transfer::DenseData(contents.str()));
+        if (collada)
+            mesh = std::tr1::dynamic_pointer_cast<Mesh::Meshdata>(collada->load(collada_data));
+        if (!mesh)
+            SILOG(benchmark,error,"Couldn't load " << mFilename << " as COLLADA");
+    }
+    else {
+        mesh = makeGridMesh();
+        if (collada)
+            collada_data = encode(collada, mesh);
+    }
+
+    if (mesh) {
+        float64 load_ms;
+        if (collada && (load_ms = timeLoads("colladamodels", collada, collada_data, mForceStop)) >= 0)
+            reportResult("colladamodels load", load_ms, "ms", true);
+        if ((load_ms = timeLoads("mesh-binary", binary, encode(binary, mesh), mForceStop)) >= 0)
+            reportResult("mesh-binary load", load_ms, "ms", true);
+        if ((load_ms = timeLoads("mesh-binary-quantized", quantized, encode(quantized, mesh), mForceStop)) >= 0)
+            reportResult("mesh-binary-quantized load", load_ms, "ms", true);
+    }
+
+    delete collada;
+    delete binary;
+    delete quantized;
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void MeshFormatBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,38 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
+#define _SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Compare the encoded size and load time of COLLADA against the mesh-binary
+ *  formats. The parameter is the path of a model to load with the
+ *  colladamodels plugin; without it a synthetic grid mesh is used.
+ */
+class MeshFormatBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new MeshFormatBenchmark(finished_cb, _param);
+    }
+
+    MeshFormatBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    String mFilename;
+    bool mForceStop;
+}; // class MeshFormatBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESH_FORMAT_BENCHMARK_HPP_
@@ -0,0 +1,223 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ObjectHostScalingBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/network/IOServicePool.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/proxyobject/ProxyObject.hpp>
+#include <sirikata/proxyobject/ProxyManager.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#define NUM_PRESENCES 256
+#define PROXIES_PER_PRESENCE 200
+#define UPDATE_ROUNDS 20
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("oh-strand-scaling", ObjectHostScalingBenchmark::create);
+
+namespace {
+
+ObjectReference objectID(uint32 presence, uint32 idx) {
+    uint8 data[UUID::static_size] = { 0 };
+    memcpy(data, &idx, sizeof(idx));
+    memcpy(data + sizeof(idx), &presence, sizeof(presence));
+    data[UUID::static_size-1] = 1;
+    return ObjectReference(UUID(data, UUID::static_size));
+}
+
+// Stands in for the script watching a presence's proxies
+class CountingBatchListener : public ProxyUpdateBatchListener {
+public:
+    CountingBatchListener() : count(0) {}
+
+    virtual void onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes) { count += changes.size(); }
+
+    uint64 count;
+};
+
+}
+
+// Only touched on the presence's strand once the run starts
+struct ObjectHostScalingBenchmark::PresenceData {
+    Network::IOStrand* strand;
+    ProxyManagerPtr proxies;
+    std::vector<SpaceObjectReference> observed;
+    CountingBatchListener listener;
+    uint32 round;
+};
+
+struct ObjectHostScalingBenchmark::PendingUpdate {
+    PendingUpdate(uint32 _proxy, const TimedMotionVector3f& _loc, const TimedMotionQuaternion& _orient)
+     : proxy(_proxy), loc(_loc), orient(_orient)
+    {}
+
+    uint32 proxy;
+    TimedMotionVector3f loc;
+    TimedMotionQuaternion orient;
+};
+
+ObjectHostScalingBenchmark::ObjectHostScalingBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mMaxStrands(std::max<uint32>(1, boost::thread::hardware_concurrency())),
+          mForceStop(false),
+          mMainStrand(NULL)
+{
+    if (!param.empty()) {
+        try {
+            mMaxStrands = std::max<uint32>(1, boost::lexical_cast<uint32>(param));
+        } catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of strands: " << param << ", using " << mMaxStrands);
+        }
+    }
+}
+
+String ObjectHostScalingBenchmark::name() {
+    return "oh-strand-scaling";
+}
+
+void ObjectHostScalingBenchmark::dispatchUpdates(PresenceData* pd) {
+    if (mForceStop || pd->round == UPDATE_ROUNDS) {
+        --mRemaining;
+        return;
+    }
+
+    // Like a parsed BulkLocationUpdate, the batch is copied into the handler
+    // for the presence's strand
+    Time t = Time::microseconds((int64)(pd->round + 1) * 1000000);
+    PendingUpdateList updates;
+    updates.reserve(PROXIES_PER_PRESENCE);
+    for(uint32 i = 0; i < PROXIES_PER_PRESENCE; i++) {
+        updates.push_back(PendingUpdate(
+                i,
+                TimedMotionVector3f(t, MotionVector3f(Vector3f((float32)i, (float32)pd->round, 0), Vector3f(1, 0, 0))),
+                TimedMotionQuaternion(t, MotionQuaternion(Quaternion(Vector3f::unitY(), 0.1f * pd->round), Quaternion::identity()))
+            ));
+    }
+    pd->strand->post(
+        std::tr1::bind(&ObjectHostScalingBenchmark::processUpdates, this, pd, updates),
+        "ObjectHostScalingBenchmark::processUpdates"
+    );
+}
+
+void ObjectHostScalingBenchmark::processUpdates(PresenceData* pd, const PendingUpdateList& updates) {
+    uint64 seqno = pd->round + 2;
+    for(PendingUpdateList::const_iterator it = updates.begin(); it != updates.end(); it++) {
+        ProxyObjectPtr proxy = pd->proxies->getProxyObject(pd->observed[it->proxy]);
+        if (!proxy) continue;
+        proxy->setLocation(it->loc, seqno);
+        proxy->setOrientation(it->orient, seqno);
+    }
+    pd->round++;
+
+    mMainStrand->post(
+        std::tr1::bind(&ObjectHostScalingBenchmark::dispatchUpdates, this, pd),
+        "ObjectHostScalingBenchmark::dispatchUpdates"
+    );
+}
+
+float64 ObjectHostScalingBenchmark::runStrands(uint32 nstrands) {
+    Network::IOServicePool* pool = new Network::IOServicePool("ObjectHostScalingBenchmark", nstrands);
+    mMainStrand = pool->service()->createStrand("ObjectHostScalingBenchmark Main");
+    std::vector<Network::IOStrand*> strands;
+    for(uint32 i = 0; i < nstrands; i++)
+        strands.push_back(pool->service()->createStrand("ObjectHostScalingBenchmark Objects"));
+
+    SpaceID space(UUID::random());
+    Transfer::URI mesh("meerkat:///test/duck.dae/optimized/0/duck.dae");
+    AggregateBoundingInfo bounds(Vector3f(0, 0, 0), 0.f, 1.f);
+    TimedMotionQuaternion orient(Time::null(), MotionQuaternion(Quaternion::identity(), Quaternion::identity()));
+    std::vector<PresenceData*> presences;
+    for(uint32 p = 0; p < NUM_PRESENCES; p++) {
+        PresenceData* pd = new PresenceData();
+        SpaceObjectReference id(space, objectID(p, PROXIES_PER_PRESENCE));
+        // Same assignment ObjectHost::objectStrand uses
+        pd->strand = strands[ UUID::Hasher()(id.object().getAsUUID()) % strands.size() ];
+        pd->proxies = ProxyManager::construct(VWObjectPtr(), id, pd->strand);
+        pd->proxies->addBatchListener(&pd->listener);
+        for(uint32 i = 0; i < PROXIES_PER_PRESENCE; i++) {
+            SpaceObjectReference observed(space, objectID(p, i));
+            TimedMotionVector3f loc(Time::null(), MotionVector3f(Vector3f((float32)i, 0, 0), Vector3f(1, 0, 0)));
+            pd->proxies->createObject(observed, loc, orient, bounds, mesh, "", false, 1);
+            pd->observed.push_back(observed);
+        }
+        pd->proxies->flushUpdates();
+        pd->listener.count = 0;
+        pd->round = 0;
+        presences.push_back(pd);
+    }
+
+    mRemaining = NUM_PRESENCES;
+    for(uint32 p = 0; p < NUM_PRESENCES; p++) {
+        mMainStrand->post(
+            std::tr1::bind(&ObjectHostScalingBenchmark::dispatchUpdates, this, presences[p]),
+            "ObjectHostScalingBenchmark::dispatchUpdates"
+        );
+    }
+
+    Time start_time = Timer::now();
+    pool->run();
+    while(!mForceStop && mRemaining.read() > 0)
+        Timer::sleep(Duration::milliseconds((int64)1));
+    Duration dur = Timer::now() - start_time;
+    pool->join();
+
+    uint64 notifications = 0;
+    uint64 updates = 0;
+    for(uint32 p = 0; p < presences.size(); p++) {
+        notifications += presences[p]->listener.count;
+        updates += (uint64)presences[p]->round * PROXIES_PER_PRESENCE;
+        presences[p]->proxies->removeBatchListener(&presences[p]->listener);
+        presences[p]->proxies->destroy();
+        delete presences[p];
+    }
+    presences.clear();
+    for(uint32 i = 0; i < strands.size(); i++)
+        delete strands[i];
+    delete mMainStrand;
+    mMainStrand = NULL;
+    delete pool;
+
+    if (mForceStop)
+        return 0;
+
+    float64 throughput = updates / dur.toSeconds();
+    SILOG(benchmark,info,
+          nstrands << " strands: " << updates << " updates in " << dur << ": "
+          << throughput << " updates/s, " << notifications << " proxies notified");
+    return throughput;
+}
+
+void ObjectHostScalingBenchmark::start() {
+    mForceStop = false;
+
+    float64 base = 0;
+    for(uint32 nstrands = 1; !mForceStop; ) {
+        float64 throughput = runStrands(nstrands);
+        if (mForceStop) break;
+
+        String label = boost::lexical_cast<String>(nstrands) + " strands";
+        reportResult(label + " throughput", throughput, "updates/s", false);
+        if (nstrands == 1)
+            base = throughput;
+        else if (base > 0)
+            reportResult(label + " speedup", throughput / base, "x", false);
+
+        if (nstrands == mMaxStrands) break;
+        nstrands = std::min(nstrands * 2, mMaxStrands);
+    }
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void ObjectHostScalingBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,62 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_OBJECT_HOST_SCALING_BENCHMARK_HPP_
+#define _SIRIKATA_OBJECT_HOST_SCALING_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+
+namespace Sirikata {
+
+/** Measures how location update processing for hosted objects scales as
+ *  they're spread across more strands and threads, the way ObjectHost does
+ *  with its strands option. Each simulated presence owns a ProxyManager
+ *  full of proxies on its own strand. A main strand hands each presence
+ *  batches of location updates, which are applied to its proxies on the
+ *  presence's strand, as HostedObject::processLocationUpdate would.
+ *
+ *  Runs with 1, 2, 4, ... strands up to the parameter, or the number of
+ *  cores if none is given, and reports updates processed per second for
+ *  each.
+ */
+class ObjectHostScalingBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new ObjectHostScalingBenchmark(finished_cb, _param);
+    }
+
+    ObjectHostScalingBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    struct PresenceData;
+    struct PendingUpdate;
+    typedef std::vector<PendingUpdate> PendingUpdateList;
+
+    // Returns updates processed per second, or 0 if stopped early
+    float64 runStrands(uint32 nstrands);
+
+    // Main strand: build the next batch of updates for a presence and hand
+    // it off to the presence's strand
+    void dispatchUpdates(PresenceData* pd);
+    // Presence strand: apply a batch of updates to the presence's proxies
+    void processUpdates(PresenceData* pd, const PendingUpdateList& updates);
+
+    uint32 mMaxStrands;
+    AtomicValue<bool> mForceStop;
+    Network::IOStrand* mMainStrand;
+    AtomicValue<uint32> mRemaining;
+}; // class ObjectHostScalingBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_OBJECT_HOST_SCALING_BENCHMARK_HPP_
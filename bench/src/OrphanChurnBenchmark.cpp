@@ -0,0 +1,167 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "OrphanChurnBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/service/Context.hpp>
+#include <sirikata/pintoloc/OrphanLocUpdateManager.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_NUM_OBJECTS 100000
+#define UPDATES_PER_OBJECT 2
+#define CHURN_ROUNDS 20
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("orphan-churn", OrphanChurnBenchmark::create);
+
+namespace {
+
+ObjectReference objectID(uint32 idx) {
+    uint8 data[UUID::static_size] = { 0 };
+    memcpy(data, &idx, sizeof(idx));
+    data[UUID::static_size-1] = 1;
+    return ObjectReference(UUID(data, UUID::static_size));
+}
+
+class CountingOrphanListener : public OrphanLocUpdateManager::Listener {
+public:
+    CountingOrphanListener() : count(0) {}
+
+    void onOrphanLocUpdate(const LocUpdate& lu, uint32 idx) {
+        if (lu.has_location()) count++;
+    }
+
+    uint64 count;
+};
+
+}
+
+OrphanChurnBenchmark::OrphanChurnBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mNumObjects(DEFAULT_NUM_OBJECTS),
+          mForceStop(false)
+{
+    if (!param.empty()) {
+        try {
+            mNumObjects = boost::lexical_cast<uint32>(param);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of objects for orphan-churn: " << param);
+        }
+    }
+}
+
+String OrphanChurnBenchmark::name() {
+    return "orphan-churn";
+}
+
+void OrphanChurnBenchmark::start() {
+    mForceStop = false;
+
+    Network::IOService* ios = new Network::IOService("OrphanChurnBenchmark");
+    Network::IOStrand* strand = ios->createStrand("OrphanChurnBenchmark");
+    Context* ctx = new Context("OrphanChurnBenchmark", ios, strand, NULL, Timer::now());
+    // The manager isn't started, expiration is driven directly so it can be
+    // timed
+    Duration timeout = Duration::seconds(10);
+    OrphanLocUpdateManager* orphans = new OrphanLocUpdateManager(ctx, strand, timeout);
+    CountingOrphanListener listener;
+
+    SpaceID space(UUID::random());
+    SequencedPresenceProperties props;
+    props.setMesh(Transfer::URI("meerkat:///test/duck.dae/optimized/0/duck.dae"), 1);
+    props.setBounds(AggregateBoundingInfo(Vector3f(0, 0, 0), 0.f, 1.f), 1);
+
+    // Fill up the manager, as after a burst of location updates arrives ahead
+    // of the proximity results
+    uint64 seqno = 1;
+    Time add_start = Timer::now();
+    for(uint32 i = 0; i < mNumObjects; i++) {
+        SpaceObjectReference sporef(space, objectID(i));
+        for(uint32 u = 0; u < UPDATES_PER_OBJECT; u++) {
+            seqno++;
+            props.setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f((float32)i, (float32)u, 0), Vector3f(1, 0, 0))), seqno);
+            orphans->addOrphanUpdate(sporef, PresencePropertiesLocUpdate(sporef.object(), props));
+        }
+    }
+    Duration add_dur = Timer::now() - add_start;
+
+    // Each round, proximity additions claim the updates for a slice of the
+    // objects and new updates arrive for another slice, with expiration
+    // checks interleaved as the poller would do them
+    uint32 slice = std::max(mNumObjects / CHURN_ROUNDS, (uint32)1);
+    uint64 invoked = 0, readded = 0, polls = 0;
+    Duration invoke_dur = Duration::zero(), churn_add_dur = Duration::zero(), poll_dur = Duration::zero();
+    for(uint32 round = 0; round < CHURN_ROUNDS && !mForceStop; round++) {
+        Time invoke_start = Timer::now();
+        uint64 count_before = listener.count;
+        for(uint32 i = round * slice; i < (round + 1) * slice && i < mNumObjects; i++)
+            orphans->invokeOrphanUpdates1(SpaceObjectReference(space, objectID(i)), &listener, i);
+        invoke_dur += Timer::now() - invoke_start;
+        invoked += listener.count - count_before;
+
+        Time readd_start = Timer::now();
+        for(uint32 j = 0; j < slice; j++) {
+            uint32 i = (round * slice + j * 7) % mNumObjects;
+            SpaceObjectReference sporef(space, objectID(i));
+            seqno++;
+            props.setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f((float32)i, (float32)round, 0), Vector3f(1, 0, 0))), seqno);
+            orphans->addOrphanUpdate(sporef, PresencePropertiesLocUpdate(sporef.object(), props));
+            readded++;
+
+            if (j % 1000 == 0) {
+                Time poll_start = Timer::now();
+                orphans->expire(ctx->simTime());
+                poll_dur += Timer::now() - poll_start;
+                polls++;
+            }
+        }
+        churn_add_dur += Timer::now() - readd_start;
+    }
+    churn_add_dur -= poll_dur;
+
+    // Everything left times out
+    uint32 remaining = orphans->size();
+    Time expire_start = Timer::now();
+    orphans->expire(ctx->simTime() + timeout * 2);
+    Duration expire_dur = Timer::now() - expire_start;
+    bool all_expired = orphans->empty();
+
+    delete orphans;
+    delete ctx;
+    delete strand;
+    delete ios;
+
+    if (mForceStop)
+        return;
+
+    if (!all_expired)
+        SILOG(benchmark,error,"Orphan updates remained after expiration");
+
+    float64 add_ns = add_dur.toMicroseconds() * 1000.0 / (mNumObjects * UPDATES_PER_OBJECT);
+    float64 invoke_ns = invoked > 0 ? invoke_dur.toMicroseconds() * 1000.0 / invoked : 0;
+    float64 churn_add_ns = readded > 0 ? churn_add_dur.toMicroseconds() * 1000.0 / readded : 0;
+    float64 poll_ns = polls > 0 ? poll_dur.toMicroseconds() * 1000.0 / polls : 0;
+    float64 expire_ns = remaining > 0 ? expire_dur.toMicroseconds() * 1000.0 / remaining : 0;
+    SILOG(benchmark,info,
+          "orphan-churn with " << mNumObjects << " objects: add " << add_ns << " ns/update, "
+          << "invoke " << invoke_ns << " ns/update, churn add " << churn_add_ns << " ns/update, "
+          << "poll " << poll_ns << " ns, expire " << expire_ns << " ns/update");
+    reportResult("add", add_ns, "ns/update", true);
+    reportResult("invoke", invoke_ns, "ns/update", true);
+    reportResult("churn add", churn_add_ns, "ns/update", true);
+    reportResult("poll", poll_ns, "ns/poll", true);
+    reportResult("expire", expire_ns, "ns/update", true);
+
+    notifyFinished();
+}
+
+void OrphanChurnBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,40 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_ORPHAN_CHURN_BENCHMARK_HPP_
+#define _SIRIKATA_ORPHAN_CHURN_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Measures the cost of saving, invoking and expiring orphaned location
+ *  updates in an OrphanLocUpdateManager under churn: a large number of
+ *  objects get updates saved, some of them are claimed by proximity
+ *  additions while new ones keep arriving, and the rest time out. The
+ *  parameter is the number of objects, 100000 by default.
+ */
+class OrphanChurnBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new OrphanChurnBenchmark(finished_cb, _param);
+    }
+
+    OrphanChurnBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    uint32 mNumObjects;
+    bool mForceStop;
+}; // class OrphanChurnBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_ORPHAN_CHURN_BENCHMARK_HPP_
@@ -0,0 +1,196 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ProxyChurnBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/proxyobject/ProxyObject.hpp>
+#include <sirikata/proxyobject/ProxyManager.hpp>
+#include <sirikata/proxyobject/PositionListener.hpp>
+#include <sirikata/proxyobject/MeshListener.hpp>
+
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+#include <unistd.h>
+#endif
+
+#define NUM_PROXIES 100000
+#define UPDATE_ROUNDS 5
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("proxy-churn", ProxyChurnBenchmark::create);
+
+namespace {
+
+// Resident memory in bytes, or 0 if we can't tell
+uint64 residentBytes() {
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return 0;
+    unsigned long size = 0, resident = 0;
+    int nread = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+    if (nread != 2) return 0;
+    return (uint64)resident * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+ObjectReference proxyID(uint32 idx) {
+    uint8 data[UUID::static_size] = { 0 };
+    memcpy(data, &idx, sizeof(idx));
+    data[UUID::static_size-1] = 1;
+    return ObjectReference(UUID(data, UUID::static_size));
+}
+
+// Stands in for the per-proxy listeners clients like JSVisibleManager used,
+// doing a minimal amount of work per notification
+class CountingProxyListener : public PositionListener, public MeshListener {
+public:
+    CountingProxyListener() : count(0) {}
+
+    virtual void updateLocation(ProxyObjectPtr obj, const TimedMotionVector3f &newLocation, const TimedMotionQuaternion& newOrient, const AggregateBoundingInfo& newBounds, const SpaceObjectReference& sporef) { count++; }
+    virtual void onSetMesh(ProxyObjectPtr proxy, Transfer::URI const& newMesh, const SpaceObjectReference& sporef) { count++; }
+    virtual void onSetScale(ProxyObjectPtr proxy, float32 newScale, const SpaceObjectReference& sporef) { count++; }
+    virtual void onSetIsAggregate(ProxyObjectPtr proxy, bool isAggregate, const SpaceObjectReference& sporef) { count++; }
+
+    uint64 count;
+};
+
+class CountingBatchListener : public ProxyUpdateBatchListener {
+public:
+    CountingBatchListener() : count(0) {}
+
+    virtual void onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes) { count += changes.size(); }
+
+    uint64 count;
+};
+
+}
+
+ProxyChurnBenchmark::ProxyChurnBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mParam(param),
+          mForceStop(false)
+{
+}
+
+String ProxyChurnBenchmark::name() {
+    return "proxy-churn";
+}
+
+void ProxyChurnBenchmark::runChurn(const String& label, bool batch) {
+    SpaceID space(UUID::random());
+    ProxyManagerPtr manager = ProxyManager::construct(VWObjectPtr(), SpaceObjectReference(space, proxyID(NUM_PROXIES)));
+    CountingProxyListener proxy_listener;
+    CountingBatchListener batch_listener;
+    if (batch)
+        manager->addBatchListener(&batch_listener);
+
+    Transfer::URI mesh("meerkat:///test/duck.dae/optimized/0/duck.dae");
+    AggregateBoundingInfo bounds(Vector3f(0, 0, 0), 0.f, 1.f);
+    TimedMotionQuaternion orient(Time::null(), MotionQuaternion(Quaternion::identity(), Quaternion::identity()));
+
+    uint64 rss_start = residentBytes();
+    std::vector<ProxyObjectPtr> proxies(NUM_PROXIES);
+    Time create_start = Timer::now();
+    for(uint32 i = 0; i < NUM_PROXIES; i++) {
+        TimedMotionVector3f loc(Time::null(), MotionVector3f(Vector3f((float32)i, 0, 0), Vector3f(1, 0, 0)));
+        proxies[i] = manager->createObject(SpaceObjectReference(space, proxyID(i)), loc, orient, bounds, mesh, "", false, 1);
+        if (!batch) {
+            proxies[i]->PositionProvider::addListener(&proxy_listener);
+            proxies[i]->MeshProvider::addListener(&proxy_listener);
+        }
+    }
+    manager->flushUpdates();
+    Duration create_dur = Timer::now() - create_start;
+    uint64 rss_created = residentBytes();
+    uint64 notifications_start = proxy_listener.count + batch_listener.count;
+
+    // Each round updates every proxy's location, orientation and bounds, as a
+    // full loc update would
+    Time update_start = Timer::now();
+    for(uint32 round = 0; round < UPDATE_ROUNDS && !mForceStop; round++) {
+        uint64 seqno = round + 2;
+        Time t = Time::microseconds((int64)(round + 1) * 1000000);
+        for(uint32 i = 0; i < NUM_PROXIES; i++) {
+            proxies[i]->setLocation(TimedMotionVector3f(t, MotionVector3f(Vector3f((float32)i, (float32)round, 0), Vector3f(1, 0, 0))), seqno);
+            proxies[i]->setOrientation(TimedMotionQuaternion(t, MotionQuaternion(Quaternion(Vector3f::unitY(), 0.1f * round), Quaternion::identity())), seqno);
+            proxies[i]->setBounds(AggregateBoundingInfo(Vector3f(0, 0, 0), 0.f, 1.f + round), seqno);
+        }
+        manager->flushUpdates();
+    }
+    Duration update_dur = Timer::now() - update_start;
+    uint64 notifications = proxy_listener.count + batch_listener.count - notifications_start;
+
+    // Drop half the proxies from the result set and add them back, as when
+    // objects move in and out of a query
+    Time churn_start = Timer::now();
+    for(uint32 i = 0; i < NUM_PROXIES && !mForceStop; i += 2) {
+        if (!batch) {
+            proxies[i]->PositionProvider::removeListener(&proxy_listener);
+            proxies[i]->MeshProvider::removeListener(&proxy_listener);
+        }
+        manager->destroyObject(proxies[i]);
+        proxies[i].reset();
+    }
+    for(uint32 i = 0; i < NUM_PROXIES && !mForceStop; i += 2) {
+        TimedMotionVector3f loc(Time::null(), MotionVector3f(Vector3f((float32)i, 0, 0), Vector3f(1, 0, 0)));
+        proxies[i] = manager->createObject(SpaceObjectReference(space, proxyID(i)), loc, orient, bounds, mesh, "", false, 1);
+        if (!batch) {
+            proxies[i]->PositionProvider::addListener(&proxy_listener);
+            proxies[i]->MeshProvider::addListener(&proxy_listener);
+        }
+    }
+    manager->flushUpdates();
+    Duration churn_dur = Timer::now() - churn_start;
+
+    for(uint32 i = 0; i < NUM_PROXIES; i++) {
+        if (!proxies[i] || batch) continue;
+        proxies[i]->PositionProvider::removeListener(&proxy_listener);
+        proxies[i]->MeshProvider::removeListener(&proxy_listener);
+    }
+    if (batch)
+        manager->removeBatchListener(&batch_listener);
+    proxies.clear();
+    manager->destroy();
+    manager.reset();
+
+    if (mForceStop)
+        return;
+
+    float64 create_ns = create_dur.toMicroseconds() * 1000.0 / NUM_PROXIES;
+    float64 update_ns = update_dur.toMicroseconds() * 1000.0 / (NUM_PROXIES * UPDATE_ROUNDS);
+    float64 churn_ns = churn_dur.toMicroseconds() * 1000.0 / NUM_PROXIES;
+    SILOG(benchmark,info,
+          label << ": create " << create_ns << " ns/proxy, "
+          << "update " << update_ns << " ns/update with " << notifications << " notifications, "
+          << "churn " << churn_ns << " ns/proxy");
+    reportResult(label + " create", create_ns, "ns/proxy", true);
+    reportResult(label + " update", update_ns, "ns/update", true);
+    reportResult(label + " notifications", (float64)notifications / (NUM_PROXIES * UPDATE_ROUNDS), "notifications/update", true);
+    reportResult(label + " churn", churn_ns, "ns/proxy", true);
+    if (rss_start != 0 && rss_created > rss_start)
+        reportResult(label + " memory", (float64)(rss_created - rss_start) / NUM_PROXIES, "bytes/proxy", true);
+}
+
+void ProxyChurnBenchmark::start() {
+    mForceStop = false;
+
+    if (mParam.empty() || mParam == "proxy")
+        runChurn("proxy", false);
+    if (!mForceStop && (mParam.empty() || mParam == "batch"))
+        runChurn("batch", true);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void ProxyChurnBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,44 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_PROXY_CHURN_BENCHMARK_HPP_
+#define _SIRIKATA_PROXY_CHURN_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Measures the cost of tracking a large number of proxies in a
+ *  ProxyManager: creating them, applying location, orientation and bounds
+ *  updates, and churning the result set by destroying and recreating half of
+ *  them. Updates are observed either by a listener registered on each
+ *  ProxyObject ("proxy") or by a ProxyUpdateBatchListener flushed once per
+ *  round ("batch"); by default both are run. Also reports resident memory
+ *  per proxy where it can be measured.
+ */
+class ProxyChurnBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new ProxyChurnBenchmark(finished_cb, _param);
+    }
+
+    ProxyChurnBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void runChurn(const String& label, bool batch);
+
+    String mParam;
+    bool mForceStop;
+}; // class ProxyChurnBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_PROXY_CHURN_BENCHMARK_HPP_
@@ -38,6 +38,7 @@
 
 #include <functional>
 #include "TCPSSTBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
 #include <sirikata/core/util/Timer.hpp>
 #include <sirikata/core/options/Options.hpp>
 #include <sirikata/core/util/PluginManager.hpp>
@@ -45,6 +46,8 @@
 
 namespace Sirikata {
 
+SIRIKATA_REGISTER_BENCHMARK("ping", SSTBenchmark::create);
+
 using std::tr1::placeholders::_1;
 using std::tr1::placeholders::_2;
 
@@ -186,6 +189,8 @@ void SSTBenchmark::computePingTime(Sirikata::Network::Chunk&chk, const Sirikata:
         SILOG(benchmark,info,"Test Time: "<<cur-mStartTime);
         SILOG(benchmark,info,"Ping Average "<<avg);
         SILOG(benchmark,info,"Transfer Rate "<<2*mNumPings*(double)chk.size()/(cur-mStartTime).toSeconds());
+        reportResult("ping average", avg.toSeconds()*1000.0, "ms", true);
+        reportResult("transfer rate", 2*mNumPings*(double)chk.size()/(cur-mStartTime).toSeconds(), "B/s", false);
         stop();
     }else
     if (mPingRate.toSeconds()==0) {
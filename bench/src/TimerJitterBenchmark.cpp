@@ -31,12 +31,15 @@
  */
 
 #include "TimerJitterBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
 #include <sirikata/core/util/Timer.hpp>
 
 #define ITERATIONS 1000000
 
 namespace Sirikata {
 
+SIRIKATA_REGISTER_BENCHMARK("timer-jitter", TimerJitterBenchmark::create);
+
 TimerJitterBenchmark::TimerJitterBenchmark(const FinishedCallback& finished_cb)
         : Benchmark(finished_cb),
           mForceStop(false)
@@ -84,6 +87,7 @@ void TimerJitterBenchmark::start() {
           ITERATIONS << " timer invokations, " << dur << ": "
           << "stddev " << sqrt((double)diff_var) << " ns"
           );
+    reportResult("interval stddev", sqrt((double)diff_var), "ns", true);
 
     notifyFinished();
 }
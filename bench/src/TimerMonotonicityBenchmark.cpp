@@ -31,12 +31,15 @@
  */
 
 #include "TimerMonotonicityBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
 #include <sirikata/core/util/Timer.hpp>
 
 #define ITERATIONS 10000000
 
 namespace Sirikata {
 
+SIRIKATA_REGISTER_BENCHMARK("timer-monotonicity", TimerMonotonicityBenchmark::create);
+
 TimerMonotonicityBenchmark::TimerMonotonicityBenchmark(const FinishedCallback& finished_cb)
         : Benchmark(finished_cb),
           mForceStop(false)
@@ -79,6 +82,7 @@ void TimerMonotonicityBenchmark::start() {
           << num_inversions << " timer inversions, "
           << float(num_inversions)/float(ITERATIONS)*100.f << "%"
           );
+    reportResult("inversions", float(num_inversions)/float(ITERATIONS)*100.f, "%", true);
 
     notifyFinished();
 }
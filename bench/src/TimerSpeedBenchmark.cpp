@@ -31,12 +31,15 @@
  */
 
 #include "TimerSpeedBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
 #include <sirikata/core/util/Timer.hpp>
 
 #define ITERATIONS 1000000
 
 namespace Sirikata {
 
+SIRIKATA_REGISTER_BENCHMARK("timer-speed", TimerSpeedBenchmark::create);
+
 TimerSpeedBenchmark::TimerSpeedBenchmark(const FinishedCallback& finished_cb)
         : Benchmark(finished_cb),
           mForceStop(false)
@@ -67,6 +70,7 @@ void TimerSpeedBenchmark::start() {
           ITERATIONS << " timer invokations, " << dur << ": "
           << (dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/call, "
           << float(ITERATIONS)/dur.toSeconds() << " calls/s");
+    reportResult("call time", dur.toMicroseconds()*1000/double(ITERATIONS), "ns", true);
 
     notifyFinished();
 }
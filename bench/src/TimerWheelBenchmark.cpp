@@ -0,0 +1,119 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "TimerWheelBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/IOTimer.hpp>
+#include <sirikata/core/util/Percentile.hpp>
+
+#define NUM_TIMERS 100000
+#define WHEEL_SLACK Duration::milliseconds((int64)1)
+// Timeouts are spread over [MIN_TIMEOUT, MIN_TIMEOUT + TIMEOUT_SPREAD)
+#define MIN_TIMEOUT Duration::milliseconds((int64)200)
+#define TIMEOUT_SPREAD 300000
+
+namespace Sirikata {
+
+SIRIKATA_REGISTER_BENCHMARK("timer-wheel", TimerWheelBenchmark::create);
+
+namespace {
+
+Duration timeout(uint32 idx, uint32 round) {
+    return MIN_TIMEOUT + Duration::microseconds((int64)(((idx + round) * 7919) % TIMEOUT_SPREAD));
+}
+
+}
+
+TimerWheelBenchmark::TimerWheelBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mParam(param),
+          mForceStop(false)
+{
+}
+
+String TimerWheelBenchmark::name() {
+    return "timer-wheel";
+}
+
+void TimerWheelBenchmark::handleTimeout(uint32 idx) {
+    mLateness.push_back((uint32)(Timer::now() - mExpected[idx]).toMicroseconds());
+}
+
+void TimerWheelBenchmark::runTimers(const String& label, bool wheel) {
+    Network::IOService* ios = new Network::IOService("TimerWheelBenchmark");
+    if (wheel)
+        ios->enableTimerWheel(WHEEL_SLACK);
+    Network::IOStrand* strand = ios->createStrand("TimerWheelBenchmark Strand");
+
+    std::vector<Network::IOTimerPtr> timers;
+    for(uint32 i = 0; i < NUM_TIMERS; i++)
+        timers.push_back(Network::IOTimer::create(strand, std::tr1::bind(&TimerWheelBenchmark::handleTimeout, this, i)));
+    mExpected.resize(NUM_TIMERS);
+    mLateness.clear();
+    mLateness.reserve(NUM_TIMERS);
+
+    Time arm_start = Timer::now();
+    for(uint32 i = 0; i < NUM_TIMERS; i++) {
+        timers[i]->wait(timeout(i, 0));
+    }
+    Duration arm_dur = Timer::now() - arm_start;
+
+    // Push every timer back, as happens when SST reschedules servicing
+    Time rearm_start = Timer::now();
+    for(uint32 i = 0; i < NUM_TIMERS; i++) {
+        Duration to = timeout(i, 1);
+        mExpected[i] = Timer::now() + to;
+        timers[i]->cancel();
+        timers[i]->wait(to);
+    }
+    Duration rearm_dur = Timer::now() - rearm_start;
+
+    Time run_start = Timer::now();
+    if (!mForceStop)
+        ios->run();
+    Duration run_dur = Timer::now() - run_start;
+
+    timers.clear();
+    delete strand;
+    delete ios;
+
+    if (mForceStop)
+        return;
+
+    std::sort(mLateness.begin(), mLateness.end());
+    float64 arm_ns = arm_dur.toMicroseconds() * 1000.0 / NUM_TIMERS;
+    float64 rearm_ns = rearm_dur.toMicroseconds() * 1000.0 / NUM_TIMERS;
+    SILOG(benchmark,info,
+          label << ": " << mLateness.size() << " of " << NUM_TIMERS << " timers fired, "
+          << "arm " << arm_ns << " ns/timer, rearm " << rearm_ns << " ns/timer, "
+          << "ran for " << run_dur << ", lateness "
+          << "p50 " << percentile(mLateness, 0.5) << "us, "
+          << "p99 " << percentile(mLateness, 0.99) << "us");
+    reportResult(label + " arm", arm_ns, "ns/timer", true);
+    reportResult(label + " rearm", rearm_ns, "ns/timer", true);
+    reportResult(label + " p50 lateness", percentile(mLateness, 0.5), "us", true);
+    reportResult(label + " p99 lateness", percentile(mLateness, 0.99), "us", true);
+}
+
+void TimerWheelBenchmark::start() {
+    mForceStop = false;
+
+    if (mParam.empty() || mParam == "deadline")
+        runTimers("deadline", false);
+    if (!mForceStop && (mParam.empty() || mParam == "wheel"))
+        runTimers("wheel", true);
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void TimerWheelBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,45 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_TIMER_WHEEL_BENCHMARK_HPP_
+#define _SIRIKATA_TIMER_WHEEL_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** Compare IOTimers backed by individual deadline timers with IOTimers managed
+ *  by a TimerWheel. 100k timers are armed, all rearmed (as SST does when it
+ *  reschedules connection servicing) and then left to expire, reporting the
+ *  cost of arming and rearming and how late the timers fire. The parameter
+ *  selects "deadline" or "wheel"; by default both are run.
+ */
+class TimerWheelBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new TimerWheelBenchmark(finished_cb, _param);
+    }
+
+    TimerWheelBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    void runTimers(const String& label, bool wheel);
+    void handleTimeout(uint32 idx);
+
+    String mParam;
+    bool mForceStop;
+    std::vector<Time> mExpected;
+    std::vector<uint32> mLateness;
+}; // class TimerWheelBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_TIMER_WHEEL_BENCHMARK_HPP_
@@ -3,12 +3,15 @@
 // be found in the LICENSE file.
 
 #include "UUIDSpeedBenchmark.hpp"
+#include "BenchmarkFactory.hpp"
 #include <sirikata/core/util/UUID.hpp>
 
 #define ITERATIONS 10000
 
 namespace Sirikata {
 
+SIRIKATA_REGISTER_BENCHMARK("uuid-create", UUIDSpeedBenchmark::create);
+
 UUIDSpeedBenchmark::UUIDSpeedBenchmark(const FinishedCallback& finished_cb)
         : Benchmark(finished_cb),
           mForceStop(false)
@@ -39,6 +42,7 @@ void UUIDSpeedBenchmark::start() {
           ITERATIONS << " random UUIDs, " << dur << ": "
           << (dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/call, "
           << float(ITERATIONS)/dur.toSeconds() << " calls/s");
+    reportResult("call time", dur.toMicroseconds()*1000/double(ITERATIONS), "ns", true);
 
     notifyFinished();
 }
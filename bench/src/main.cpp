@@ -32,65 +32,115 @@
 
 #include "BenchmarkRunner.hpp"
 
-#include "TimerSpeedBenchmark.hpp"
-#include "TimerJitterBenchmark.hpp"
-#include "TimerMonotonicityBenchmark.hpp"
-#include "TCPSSTBenchmark.hpp"
-#include "UUIDSpeedBenchmark.hpp"
-
 #include <sirikata/core/util/DynamicLibrary.hpp>
+#include <boost/lexical_cast.hpp>
 
 using namespace Sirikata;
 
-typedef std::list<String> BenchmarkList;
-
-void runAll(BenchmarkRunner& runner, const BenchmarkList all_benchmarks) {
-    for(std::list<String>::const_iterator it = all_benchmarks.begin();
+void runAll(BenchmarkRunner& runner, const BenchmarkFactory::BenchmarkNameList& all_benchmarks) {
+    for(BenchmarkFactory::BenchmarkNameList::const_iterator it = all_benchmarks.begin();
         it != all_benchmarks.end();
         it++)
         runner.run(*it);
 }
 
+void usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] [all | benchmark [param]]..." << std::endl
+              << "Options:" << std::endl
+              << "  --list              list the available benchmarks" << std::endl
+              << "  --timeout=30s       time limit for each run of a benchmark" << std::endl
+              << "  --warmup=0          runs of each benchmark to discard" << std::endl
+              << "  --trials=1          runs of each benchmark to record" << std::endl
+              << "  --cpu=N             pin the benchmark thread to CPU N" << std::endl
+              << "  --json=FILE         write results as JSON" << std::endl
+              << "  --csv=FILE          write results as CSV" << std::endl
+              << "  --baseline=FILE     compare against JSON results from an earlier run" << std::endl
+              << "  --threshold=0.05    smallest relative change flagged as a regression" << std::endl;
+}
+
 int main(int argc, char** argv) {
     DynamicLibrary::Initialize();
 
-    BenchmarkFactory factory;
-    BenchmarkList all_benchmarks;
-
-// Adds a benchmark to the factory and the list
-#define ADD_BENCHMARK(name, create_cb) \
-    factory.registerConstructor(#name, create_cb); \
-    all_benchmarks.push_back(#name)
-
-    // Benchmark registrations
-    ADD_BENCHMARK(timer-speed, TimerSpeedBenchmark::create);
-    ADD_BENCHMARK(timer-jitter, TimerJitterBenchmark::create);
-    ADD_BENCHMARK(timer-monotonicity, TimerMonotonicityBenchmark::create);
-
-    ADD_BENCHMARK(ping, SSTBenchmark::create);
-
-    ADD_BENCHMARK(uuid-create, UUIDSpeedBenchmark::create);
-
-    BenchmarkRunner runner(factory, Duration::seconds(30.f));
+    BenchmarkFactory& factory = BenchmarkFactory::getSingleton();
+
+    Duration timeout = Duration::seconds(30.f);
+    uint32 warmup = 0, trials = 1;
+    int32 cpu = -1;
+    String json_file, csv_file, baseline_file;
+    float64 threshold = 0.05;
+
+    // Options are --key=value, everything else is a benchmark name,
+    // optionally followed by its parameter.
+    std::vector<String> benchmark_args;
+    try {
+        for(int32 argsi = 1; argsi < argc; argsi++) {
+            String arg = argv[argsi];
+            if (arg.substr(0, 2) != "--") {
+                benchmark_args.push_back(arg);
+                continue;
+            }
+
+            String::size_type eq = arg.find('=');
+            String key = arg.substr(2, eq == String::npos ? String::npos : eq - 2);
+            String val = (eq == String::npos) ? "" : arg.substr(eq+1);
+            if (key == "help") {
+                usage(argv[0]);
+                return 0;
+            }
+            else if (key == "list") {
+                const BenchmarkFactory::BenchmarkNameList& names = factory.benchmarks();
+                for(uint32 i = 0; i < names.size(); i++)
+                    std::cout << names[i] << std::endl;
+                return 0;
+            }
+            else if (key == "timeout") timeout = boost::lexical_cast<Duration>(val);
+            else if (key == "warmup") warmup = boost::lexical_cast<uint32>(val);
+            else if (key == "trials") trials = boost::lexical_cast<uint32>(val);
+            else if (key == "cpu") cpu = boost::lexical_cast<int32>(val);
+            else if (key == "json") json_file = val;
+            else if (key == "csv") csv_file = val;
+            else if (key == "baseline") baseline_file = val;
+            else if (key == "threshold") threshold = boost::lexical_cast<float64>(val);
+            else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch(boost::bad_lexical_cast&) {
+        std::cerr << "Invalid option value" << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
 
+    BenchmarkRunner runner(factory, timeout);
+    runner.setTrials(warmup, trials);
+    runner.setCPUAffinity(cpu);
 
-    // No arguments, defaults to all benchmarks
-    if (argc < 2) {
-        runAll(runner, all_benchmarks);
-        return 0;
-    }
+    // No benchmarks specified, defaults to all benchmarks
+    if (benchmark_args.empty())
+        runAll(runner, factory.benchmarks());
 
     // Otherwise, run each one that's specified
-    for(int32 argsi = 1; argsi < argc; argsi+=2) {
-        String arg = argv[argsi];
+    for(uint32 argsi = 0; argsi < benchmark_args.size(); argsi+=2) {
+        const String& arg = benchmark_args[argsi];
 
         if (arg == "all") {
-            runAll(runner, all_benchmarks);
+            runAll(runner, factory.benchmarks());
         }
         else {
-            runner.run(arg,argsi+1<argc?argv[argsi+1]:"");
+            runner.run(arg,argsi+1<benchmark_args.size()?benchmark_args[argsi+1]:"");
         }
     }
 
-    return 0;
+    bool success = true;
+    if (!json_file.empty())
+        success = runner.writeJSON(json_file) && success;
+    if (!csv_file.empty())
+        success = runner.writeCSV(csv_file) && success;
+    if (!baseline_file.empty())
+        success = (runner.compareBaseline(baseline_file, threshold) == 0) && success;
+
+    return success ? 0 : 1;
 }
@@ -218,7 +218,9 @@ int main (int argc, char** argv) {
     }
 
 
-    ctx->run(1);
+    // Objects may be spread across multiple strands, so run enough threads to
+    // process them in parallel.
+    ctx->run(oh->objectStrandCount());
 
     ctx->cleanup();
 
@@ -225,6 +225,11 @@ private:
 		// nUnreadable is the number of bytes to back up i after
 		// overshooting. It can be 0, 1 or 2.
 		int nUnreadable;
+		// buf[noStuffStart:noStuffEnd] is known to contain no 0xff bytes,
+		// so ensureNBits may consume it without byte stuffing checks.
+		// The range is only trusted while noStuffStart <= i.
+		int noStuffStart;
+		int noStuffEnd;
         Bytes();
 	} bytes;
 	int width;
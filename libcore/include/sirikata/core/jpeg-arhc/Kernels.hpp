@@ -0,0 +1,33 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_JPEG_ARHC_KERNELS_HPP_
+#define _SIRIKATA_JPEG_ARHC_KERNELS_HPP_
+
+#include "DecoderPlatform.hpp"
+
+namespace Sirikata {
+
+// Byte scanning kernels used by the entropy coded segment readers. Each kernel
+// has a portable scalar version and, where the compiler and CPU allow it,
+// vectorized versions. The fastest version supported by the running CPU is
+// selected once, on first use.
+
+// Returns the index of the first 0xff byte in data[0, len), or len if there is
+// none. In entropy coded data 0xff is either a stuffed byte (followed by
+// 0x00) or a marker, so every byte before the returned index can be consumed
+// without any byte stuffing checks.
+SIRIKATA_FUNCTION_EXPORT size_t FindStuffedByte(const uint8 *data, size_t len);
+
+// The scalar implementation, always available. Exposed for testing and
+// benchmarking against the dispatched version.
+SIRIKATA_FUNCTION_EXPORT size_t FindStuffedByteScalar(const uint8 *data, size_t len);
+
+// Name of the implementation FindStuffedByte dispatches to, e.g. "avx2",
+// "sse2" or "scalar".
+SIRIKATA_FUNCTION_EXPORT const char *JpegKernelName();
+
+}
+
+#endif
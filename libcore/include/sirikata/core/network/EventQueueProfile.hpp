@@ -0,0 +1,160 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_EVENT_QUEUE_PROFILE_HPP_
+#define _SIRIKATA_EVENT_QUEUE_PROFILE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/IODefs.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/util/Noncopyable.hpp>
+#include <sirikata/core/task/Time.hpp>
+#include <sirikata/core/command/Command.hpp>
+#include <boost/thread.hpp>
+
+namespace Sirikata {
+
+namespace Trace {
+class TimeSeries;
+}
+
+namespace Network {
+
+/** EventQueueProfile collects statistics about the handlers run by an
+ *  IOService or IOStrand: how many were queued and executed and, per handler
+ *  tag, histograms of how long they waited in the queue and how long they took
+ *  to run. Handlers that run longer than slowThreshold() are counted and
+ *  logged.
+ *
+ *  Unlike SIRIKATA_TRACK_EVENT_QUEUES this is always compiled in and is
+ *  switched on and off at runtime with setEnabled(). While disabled the only
+ *  cost is checking the flag when a handler is queued.
+ *
+ *  Counters are updated atomically. A handler's tag statistics are found when
+ *  it is queued, through a per-thread cache of each profile's tags, so the
+ *  lock is only taken the first time a thread queues a tag. Wrapped handlers
+ *  keep the statistics alive, so they can safely run after the queue and its
+ *  profile are destroyed.
+ */
+class SIRIKATA_EXPORT EventQueueProfile : public Noncopyable {
+  public:
+    /** Log2 histogram of durations in microseconds. Bucket i counts samples in
+     *  [2^(i-1), 2^i) us, except that bucket 0 holds samples under 1us and the
+     *  last bucket holds everything too large for the others.
+     */
+    class SIRIKATA_EXPORT Histogram {
+      public:
+        enum {
+            NumBuckets = 28
+        };
+
+        Histogram();
+
+        void sample(const Duration& dur);
+        void merge(const Histogram& other);
+        void clear();
+
+        uint64 count() const;
+        Duration mean() const;
+        /** Get the upper bound of the bucket containing the given percentile,
+         *  which should be in [0, 100].
+         */
+        Duration percentile(float64 pct) const;
+        /** Get the upper bound of the largest non-empty bucket. */
+        Duration max() const;
+
+        static uint32 bucket(const Duration& dur);
+        static Duration bucketUpperBound(uint32 bucket);
+      private:
+        AtomicValue<uint32> mBuckets[NumBuckets];
+        AtomicValue<uint64> mTotalMicroseconds;
+    };
+
+    struct TagProfile {
+        TagProfile();
+
+        Histogram wait;
+        Histogram execution;
+        AtomicValue<uint32> slow;
+    };
+
+    /** Create a profile.
+     *  \param name name of the owning queue, used when logging
+     */
+    EventQueueProfile(const String& name);
+    ~EventQueueProfile();
+
+    /** Returns true if profiling is enabled for all queues. */
+    static bool enabled() {
+        return sEnabled.read() != 0;
+    }
+    static void setEnabled(bool en);
+
+    /** Get the execution time above which handlers are reported as slow. */
+    static Duration slowThreshold() {
+        return Duration::microseconds(sSlowThresholdMicroseconds.read());
+    }
+    static void setSlowThreshold(const Duration& dur);
+
+    /** Wrap a handler about to be queued so that the time it spends queued and
+     *  running are recorded under tag. Only call this if enabled().
+     *  \param handler the handler being queued
+     *  \param tag the handler's tag, may be NULL
+     *  \param delay for timers, the timeout, which is not counted as time
+     *         spent in the queue
+     */
+    IOCallback wrap(const IOCallback& handler, const char* tag, const Duration& delay = Duration::zero());
+
+    /** Number of handlers queued while profiling was enabled. */
+    uint32 queued() const;
+    /** Number of profiled handlers that have started executing. */
+    uint32 executed() const;
+
+    /** Get the statistics for a tag, or NULL if it hasn't been queued. Mostly
+     *  useful for testing; the result is valid until this profile is
+     *  destroyed.
+     */
+    const TagProfile* tagProfile(const char* tag) const;
+
+    /** Clear histograms and slow handler counts. Queued and executed counts
+     *  are left alone so the number of handlers in the queue stays correct.
+     */
+    void reset();
+
+    /** Fill in a Command::Result with a summary of this profile. Tags are
+     *  ordered by total execution time, largest first.
+     */
+    void fillCommandResult(Command::Result& res) const;
+    /** Report a summary of this profile to a TimeSeries under the given
+     *  prefix.
+     */
+    void reportTimeSeries(Trace::TimeSeries* ts, const String& prefix) const;
+    /** Convert a queue or tag name into something usable as part of a
+     *  TimeSeries key.
+     */
+    static String timeSeriesKey(const String& name);
+
+  private:
+    typedef boost::mutex Mutex;
+    typedef boost::lock_guard<Mutex> LockGuard;
+    typedef std::tr1::unordered_map<const char*, TagProfile*> TagProfileMap;
+
+    // Everything recorded by handlers. Shared with wrapped handlers, which
+    // may outlive the profile.
+    struct Stats;
+    typedef std::tr1::shared_ptr<Stats> StatsPtr;
+
+    static void execute(const StatsPtr& stats, TagProfile* prof, const Time& queued_at, const Duration& delay, const IOCallback& cb, const char* tag);
+    TagProfile* getOrCreateTagProfile(const char* tag);
+
+    static AtomicValue<uint32> sEnabled;
+    static AtomicValue<int64> sSlowThresholdMicroseconds;
+
+    StatsPtr mStats;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_EVENT_QUEUE_PROFILE_HPP_
@@ -76,6 +76,7 @@ typedef std::tr1::function<void()> IOCallback;
 class IOService;
 class IOServiceFactory;
 class IOTimer;
+class TimerWheel;
 class IOStrand;
 class IOWork;
 
@@ -40,6 +40,7 @@
 #include <sirikata/core/trace/WindowedStats.hpp>
 #include <sirikata/core/task/Time.hpp>
 #include <sirikata/core/command/Command.hpp>
+#include <sirikata/core/network/EventQueueProfile.hpp>
 
 namespace Sirikata {
 namespace Network {
@@ -57,9 +58,6 @@ class SIRIKATA_EXPORT IOService : public Noncopyable {
     InternalIOService* mImpl;
     const String mName;
 
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
-    typedef std::tr1::function<void(const boost::system::error_code& e)> IOCallbackWithError;
-
     // Track all strands that have been allocated. This needs to be
     // thread safe.
     typedef boost::mutex Mutex;
@@ -68,6 +66,22 @@ class SIRIKATA_EXPORT IOService : public Noncopyable {
     typedef std::tr1::unordered_set<IOStrand*> StrandSet;
     StrandSet mStrands;
 
+  public:
+    typedef std::tr1::function<IOService*()> StrandPlacement;
+  private:
+    StrandPlacement mStrandPlacement;
+
+    // Runtime profile of handlers posted directly to this IOService, only
+    // recorded while EventQueueProfile::enabled()
+    EventQueueProfile mProfile;
+
+    // If enabled, manages IOTimers and timed posts instead of individual
+    // deadline timers
+    TimerWheel* mTimerWheel;
+
+#ifdef SIRIKATA_TRACK_EVENT_QUEUES
+    typedef std::tr1::function<void(const boost::system::error_code& e)> IOCallbackWithError;
+
     AtomicValue<uint32> mTimersEnqueued;
     AtomicValue<uint32> mEnqueued;
 
@@ -106,11 +120,16 @@ class SIRIKATA_EXPORT IOService : public Noncopyable {
     // a strand-wrapped handler because that doesn't have the same ordering
     // guarantees.
     IOCallback tracking_wrapper(const IOCallback& handler, const char* tag = NULL, const char* tagStat = NULL);
+#endif
 
     // Invoked by strands when they are being destroyed so we can
     // track which ones are alive.
     void destroyingStrand(IOStrand* child);
-#endif
+
+    // Queue the handler, without profiling
+    void dispatchImpl(const IOCallback& handler, const char* tag, const char* tagStat);
+    void postImpl(const IOCallback& handler, const char* tag, const char* tagStat);
+    void postImpl(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat);
 
   protected:
 
@@ -151,6 +170,24 @@ public:
     /** Creates a new IOStrand. */
     IOStrand* createStrand(const String& name);
 
+    /** Create strands requested with createStrand() on the IOService returned
+     *  by placement rather than this one. IOServicePool uses this to spread
+     *  strands over its threads. Must be set before any strands are created.
+     */
+    void setStrandPlacement(const StrandPlacement& placement);
+    /** Get the number of strands currently allocated on this IOService. */
+    uint32 numStrands() const;
+
+    /** Manage IOTimers and timed posts on this IOService with a TimerWheel
+     *  rather than a deadline timer each. This makes scheduling and
+     *  cancelling timers cheaper when there are many of them, but timers may
+     *  fire up to slack late. Only affects timers created after it is called,
+     *  so it should be called before the IOService is used.
+     */
+    void enableTimerWheel(const Duration& slack);
+    /** Get the TimerWheel for this IOService, or NULL if it isn't enabled. */
+    TimerWheel* timerWheel() const { return mTimerWheel; }
+
     /** Run at most one handler in the event queue.
      *  \returns the number of handlers executed
      */
@@ -232,6 +269,29 @@ public:
 #endif
     void commandReportStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
     static void commandReportAllStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+    /** Get the runtime profile of handlers posted directly to this
+     *  IOService. Handlers posted to its strands are profiled by the strands.
+     */
+    const EventQueueProfile& profile() const { return mProfile; }
+
+    /** Fill in a Command::Result with the runtime profiles of this IOService
+     *  and its strands.
+     */
+    void fillCommandResultWithProfile(Command::Result& res);
+    /** Report the runtime profiles of all IOServices and their strands to a
+     *  TimeSeries, with keys under the given prefix.
+     */
+    static void reportAllProfilesTimeSeries(Trace::TimeSeries* ts, const String& prefix);
+    /** Clear the runtime profiles of all IOServices and their strands. */
+    static void resetAllProfiles();
+
+    /** Handle a command to control event queue profiling. Accepts the
+     *  optional parameters "enable" (bool), "reset" (bool) and
+     *  "slow-threshold" (a Duration) and responds with the profiles of all
+     *  IOServices and their strands.
+     */
+    static void commandProfile(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
 };
 
 } // namespace Network
@@ -34,6 +34,7 @@
 
 #include "IODefs.hpp"
 #include "IOService.hpp"
+#include <sirikata/core/util/AtomicTypes.hpp>
 
 namespace Sirikata {
 
@@ -43,14 +44,66 @@ namespace Network {
 
 /** IOServicePool creates a pool of IOService threads for handling
  *  IO events.
+ *
+ *  By default all the threads run a single IOService, so any thread can run
+ *  any handler and strands migrate freely between threads. With
+ *  PerThreadServices each thread runs its own IOService instead. Strands
+ *  created with service()->createStrand() are placed on the thread with the
+ *  fewest strands and stay there, so their handlers keep running on the same
+ *  thread and don't contend with other threads' handlers for a queue. If work
+ *  stealing is enabled, a thread that runs out of work runs handlers from
+ *  other threads' queues; strands still guarantee their handlers never run
+ *  concurrently.
+ *
+ *  With PerThreadServices, threads only exit once work has been removed with
+ *  stopWork() and every thread has run out of handlers, so callers should
+ *  always use startWork() while running.
  */
 class SIRIKATA_EXPORT IOServicePool {
   public:
-    IOServicePool(const String& name, uint32 nthreads);
+    enum ThreadingModel {
+        SharedService,
+        PerThreadServices
+    };
+
+    IOServicePool(const String& name, uint32 nthreads, ThreadingModel model = SharedService);
     ~IOServicePool();
 
+    /** Parse a ThreadingModel from its option value, "shared" or
+     *  "per-thread". Returns SharedService for anything else.
+     */
+    static ThreadingModel parseThreadingModel(const String& model);
+
+    /** Pin the threads to CPUs. Thread i is pinned to cpus[i % cpus.size()],
+     *  so to keep a pool on one NUMA node list only that node's CPUs. Must be
+     *  called before run(). Only supported on Linux.
+     */
+    void setCPUAffinity(const std::vector<int32>& cpus);
+    /** Parse a comma separated list of CPUs, e.g. "0,2,4-7". */
+    static std::vector<int32> parseCPUList(const String& cpus);
+
+    /** Enable or disable work stealing between threads with
+     *  PerThreadServices. Enabled by default. Must be called before run().
+     */
+    void setWorkStealing(bool steal);
+
+    /** Enable a TimerWheel on all of the pool's IOServices. See
+     *  IOService::enableTimerWheel().
+     */
+    void enableTimerWheel(const Duration& slack);
+
     /** Run the thread pool. */
     void run();
+    /** Run the thread pool, using the calling thread as one of its threads.
+     *  Returns once that thread has exited, after which join() should be
+     *  called to wait for the rest.
+     */
+    void runIncludingCurrentThread();
+
+    /** Stop event processing in all the pool's threads, abandoning any
+     *  remaining handlers.
+     */
+    void stop();
 
     /** Reset stopped state */
     void reset();
@@ -64,18 +117,46 @@ class SIRIKATA_EXPORT IOServicePool {
     /** Remove work so the service can complete and exit. */
     void stopWork();
 
-    /** Get the IOService corresponding to the given thread.  Note that
-     *  you rarely need a specific service, so requesting the default
-     *  is sufficient.
-     *  \param thr the index of the thread to retrieve the IOService for
+    /** Get the IOService for the pool. With PerThreadServices this is the
+     *  first thread's IOService; strands created on it are spread over all
+     *  the threads.
      */
     IOService* service();
 
+    /** Get the number of threads in the pool. */
+    uint32 size() const { return (uint32)mThreads.size(); }
+
   private:
+    void startThreads(uint32 first);
+    void runThread(uint32 idx);
+    void runPerThreadService(uint32 idx);
+    // Run one handler from another thread's IOService, returning the number
+    // run
+    uint32 steal(uint32 idx);
+    // Wake an idle thread so it can steal from a busy one
+    void wakeIdleThread(uint32 busy_idx);
+    IOService* placeStrand();
+
+    const String mName;
+    const ThreadingModel mModel;
     IOService* mIO;
+    typedef std::vector<IOService*> ServiceList;
+    ServiceList mServices;
     typedef std::vector<Thread*> ThreadList;
     ThreadList mThreads;
-    IOWork* mWork;
+    typedef std::vector<IOWork*> WorkList;
+    WorkList mWork;
+
+    std::vector<int32> mCPUs;
+    bool mWorkStealing;
+    // Whether work is held. Stealing is only safe while it is since polling
+    // an IOService without work stops it.
+    AtomicValue<uint32> mWorking;
+    // Number of threads still running handlers
+    AtomicValue<uint32> mRunning;
+    AtomicValue<uint32> mStopped;
+    // Per thread, > 0 while it is blocked waiting for handlers
+    AtomicValue<int32>* mIdle;
 };
 
 } // namespace Network
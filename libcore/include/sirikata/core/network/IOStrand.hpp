@@ -38,6 +38,7 @@
 #include <sirikata/core/util/Noncopyable.hpp>
 #include <sirikata/core/trace/WindowedStats.hpp>
 #include <sirikata/core/task/Time.hpp>
+#include <sirikata/core/network/EventQueueProfile.hpp>
 #include <boost/thread.hpp>
 
 namespace Sirikata {
@@ -65,6 +66,10 @@ class SIRIKATA_EXPORT IOStrand : public Noncopyable {
     InternalIOStrand* mImpl;
     const String mName;
 
+    // Runtime profile of the handlers run in this strand, only recorded
+    // while EventQueueProfile::enabled()
+    EventQueueProfile mProfile;
+
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     // Track all strands that have been allocated. This needs to be
     // thread safe.
@@ -88,6 +93,11 @@ class SIRIKATA_EXPORT IOStrand : public Noncopyable {
     /** Construct an IOStrand associated with the given IOService. */
     IOStrand(IOService& io, const String& name);
 
+    // Queue the handler, without profiling
+    void dispatchImpl(const IOCallback& handler, const char* tag);
+    void postImpl(const IOCallback& handler, const char* tag);
+    void postImpl(const Duration& waitFor, const IOCallback& handler, const char* tag);
+
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     void decrementTimerCount(const Time& start, const Duration& timer_duration, const IOCallback& cb, const char* tag);
     void decrementCount(const Time& start, const IOCallback& cb, const char* tag);
@@ -156,6 +166,9 @@ class SIRIKATA_EXPORT IOStrand : public Noncopyable {
     template<typename CallbackType>
     WrappedHandler<CallbackType> wrap(const CallbackType& handler);
 
+    /** Get the runtime profile of handlers run in this strand. */
+    const EventQueueProfile& profile() const { return mProfile; }
+    EventQueueProfile& profile() { return mProfile; }
 
 
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
@@ -36,6 +36,7 @@
 #include <sirikata/core/network/IODefs.hpp>
 #include <sirikata/core/util/AtomicTypes.hpp>
 #include <sirikata/core/util/SerializationCheck.hpp>
+#include <sirikata/core/network/TimerWheel.hpp>
 
 namespace Sirikata {
 namespace Network {
@@ -61,9 +62,16 @@ typedef std::tr1::weak_ptr<IOTimer> IOTimerWPtr;
  *  must be stored using a shared_ptr<IOTimer> (which is available as IOTimerPtr).
  *  In order to enforce this, you cannot allocate one directly -- instead you
  *  must use the static IOTimer::create() methods.
+ *
+ *  If the IOService has a TimerWheel enabled, the timer is managed by it
+ *  instead of using its own deadline timer.
  */
 class SIRIKATA_EXPORT IOTimer : public std::tr1::enable_shared_from_this<IOTimer> {
+    // Exactly one of mTimer and mWheelEntry is used, depending on whether the
+    // IOService has a TimerWheel
     DeadlineTimer *mTimer;
+    TimerWheel* mWheel;
+    TimerWheel::Entry* mWheelEntry;
     IOStrand* mStrand;
     IOCallback mFunc;
     SerializationCheck chk;
@@ -85,6 +93,7 @@ class SIRIKATA_EXPORT IOTimer : public std::tr1::enable_shared_from_this<IOTimer
 
     class TimedOut;
 
+    void createTimer(IOService& io);
 
     /** Create a new timer, serviced by the specified IOService.
      *  \param io the IOService to service this timers events
@@ -0,0 +1,169 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_TIMER_WHEEL_HPP_
+#define _SIRIKATA_TIMER_WHEEL_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/IODefs.hpp>
+#include <sirikata/core/util/Noncopyable.hpp>
+#include <sirikata/core/task/Time.hpp>
+#include <boost/thread.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+/** TimerWheel manages a large number of timers for an IOService using a
+ *  single underlying deadline timer. Timers are kept in a hierarchical timing
+ *  wheel: time is divided into ticks of the wheel's slack and each timer is
+ *  stored in a slot for the tick it expires on, so scheduling and cancelling
+ *  are O(1) and all timers expiring in the same tick are handled together.
+ *  Timers due more than a few hundred ticks out are kept in coarser levels and
+ *  moved down as their time approaches.
+ *
+ *  Timers never fire early, but may fire up to one slack late in addition to
+ *  any delay in the event queue. Timers that expire in the same tick are
+ *  coalesced: their callbacks are posted as a single handler per IOStrand.
+ *
+ *  An IOService only uses a TimerWheel once IOService::enableTimerWheel() has
+ *  been called, after which IOTimers (and so Pollers and SST's timers) and
+ *  timed posts created on it are managed by the wheel. All methods are thread
+ *  safe.
+ */
+class SIRIKATA_EXPORT TimerWheel : public Noncopyable {
+    struct Link {
+        Link* prev;
+        Link* next;
+    };
+  public:
+    /** A timer managed by a TimerWheel. The owner must cancel it before
+     *  destroying it.
+     */
+    class SIRIKATA_EXPORT Entry : protected Link {
+      public:
+        Entry();
+        ~Entry();
+      private:
+        friend class TimerWheel;
+
+        bool scheduled() const { return prev != NULL; }
+
+        uint64 mTick;
+        Time mExpiry;
+        IOStrand* mStrand;
+        IOCallback mCallback;
+        // Allocated by the wheel for post() and freed once it expires
+        bool mOneShot;
+    };
+
+    enum {
+        Level0Bits = 8,
+        LevelBits = 6,
+        NumLevels = 4
+    };
+
+    /** Create a timer wheel.
+     *  \param ios the IOService to run expired timers' callbacks on
+     *  \param slack the resolution of the wheel; timers expiring within the
+     *         same slack are fired together
+     */
+    TimerWheel(IOService* ios, const Duration& slack);
+    ~TimerWheel();
+
+    const Duration& slack() const { return mSlack; }
+    /** Get the number of timers waiting to expire. */
+    uint32 size() const;
+
+    /** Schedule a timer to expire after timeout, rescheduling it if it is
+     *  already waiting.
+     *  \param timer the timer to schedule
+     *  \param timeout how long to wait before invoking cb
+     *  \param cb the callback to invoke on expiry
+     *  \param strand if non-NULL, the strand to invoke cb in, otherwise it is
+     *         posted directly to the IOService
+     *  \returns 1 if a pending expiry was cancelled, 0 otherwise
+     */
+    uint32 schedule(Entry* timer, const Duration& timeout, const IOCallback& cb, IOStrand* strand = NULL);
+    /** Cancel a timer.
+     *  \returns 1 if a pending expiry was cancelled, 0 if the timer wasn't
+     *  scheduled or has already expired
+     */
+    uint32 cancel(Entry* timer);
+    /** Get the time until the timer's most recently scheduled expiry, which
+     *  is negative if it has passed.
+     */
+    Duration expiresFromNow(const Entry* timer) const;
+
+    /** Invoke cb after timeout. Unlike schedule() this can't be cancelled. */
+    void post(const Duration& timeout, const IOCallback& cb, IOStrand* strand = NULL);
+
+  private:
+    typedef boost::mutex Mutex;
+    typedef boost::lock_guard<Mutex> LockGuard;
+
+    // Shared with deadline handlers, which may still be queued after the
+    // wheel is destroyed, so they can tell whether it still exists. The
+    // destructor clears wheel while holding mutex, and handlers hold it
+    // while they use the wheel.
+    struct DeadlineGuard {
+        Mutex mutex;
+        TimerWheel* wheel;
+    };
+    typedef std::tr1::shared_ptr<DeadlineGuard> DeadlineGuardPtr;
+
+    typedef std::vector<IOCallback> CallbackList;
+    typedef std::tr1::shared_ptr<CallbackList> CallbackListPtr;
+    // Callbacks of expired timers that run in the same strand, along with
+    // the handler that runs them there
+    struct Batch {
+        CallbackListPtr callbacks;
+        IOCallback handler;
+    };
+
+    static void handleDeadline(const boost::system::error_code& error, DeadlineGuardPtr guard);
+    static void runBatch(CallbackListPtr batch);
+
+    // The tick containing t, i.e. the last tick that starts at or before t
+    uint64 tickAt(const Time& t) const;
+
+    // All of the following must be called with mMutex held
+    void insert(Entry* timer);
+    void remove(Entry* timer);
+    // Move timers from a coarse level's slot into finer levels, returning the
+    // slot index
+    uint32 cascade(uint32 level, uint32 index);
+    // Get the next tick we need to wake up for
+    uint64 nextWakeTick() const;
+    void arm(uint64 tick);
+    // Callbacks of expired timers, grouped by the strand they run in. Each
+    // strand's handler is wrapped while the lock is held, since the strand
+    // is only guaranteed to exist while it has timers scheduled.
+    typedef std::map<IOStrand*, Batch> BatchMap;
+    void expire(BatchMap& batches);
+
+    IOService* mService;
+    const Duration mSlack;
+    const int64 mSlackMicroseconds;
+    const Time mStart;
+
+    mutable Mutex mMutex;
+    DeadlineGuardPtr mGuard;
+
+    // Next tick to be processed. All timers expire at or after it.
+    uint64 mNextTick;
+    uint32 mCount;
+    // Level 0 has one slot per tick, each later level has slots spanning
+    // all the slots of the previous level
+    Link mLevel0[1 << Level0Bits];
+    Link mLevels[NumLevels-1][1 << LevelBits];
+
+    DeadlineTimer* mDeadline;
+    bool mArmed;
+    uint64 mArmedTick;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_TIMER_WHEEL_HPP_
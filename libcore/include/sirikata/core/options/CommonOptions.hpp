@@ -49,6 +49,9 @@
 
 #define STATS_TRACE_FILE     "stats.trace-filename"
 #define PROFILE                    "profile"
+#define OPT_PROFILE_EVENT_QUEUES            "profile.event-queues"
+#define OPT_PROFILE_EVENT_QUEUES_SLOW       "profile.event-queues-slow"
+#define OPT_PROFILE_EVENT_QUEUES_INTERVAL   "profile.event-queues-interval"
 
 #define OPT_REGION_WEIGHT        "region-weight"
 #define OPT_REGION_WEIGHT_ARGS   "region-weight-args"
@@ -66,6 +69,12 @@
 #define OPT_COMMAND_COMMANDER           "command.commander"
 #define OPT_COMMAND_COMMANDER_OPTIONS   "command.commander-options"
 
+#define OPT_IOSERVICE_POOL              "ioservice.pool"
+#define OPT_IOSERVICE_POOL_STEAL        "ioservice.pool-steal"
+#define OPT_IOSERVICE_POOL_CPUS         "ioservice.pool-cpus"
+#define OPT_IOSERVICE_TIMER_WHEEL       "ioservice.timer-wheel"
+#define OPT_IOSERVICE_TIMER_WHEEL_SLACK "ioservice.timer-wheel-slack"
+
 namespace Sirikata {
 
 /// Report version information to the log
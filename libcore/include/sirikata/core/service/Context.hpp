@@ -55,6 +55,12 @@ namespace Command {
 class Commander;
 }
 
+class Poller;
+
+namespace Network {
+class IOServicePool;
+}
+
 /** Base class for Contexts, provides basic infrastructure such as IOServices,
  *  IOStrands, Trace, and timing information.
  */
@@ -143,6 +149,15 @@ public:
 
     void run(uint32 nthreads = 1, ExecutionThreads exthreads = IncludeOriginal);
 
+    /** Run handlers with an IOServicePool instead of threads that all run
+     *  ioService. pool->service() must be this Context's ioService. The
+     *  pool's size determines how many threads are used, so the number passed
+     *  to run() is ignored. Must be called before run().
+     */
+    void setServicePool(Network::IOServicePool* pool) {
+        mServicePool = pool;
+    }
+
     // Stop the simulation
     void shutdown();
 
@@ -160,6 +175,14 @@ public:
     }
     void setCommander(Command::Commander* c);
 
+    /** Set how often event queue profiles are reported to timeSeries while
+     *  Network::EventQueueProfile is enabled. Must be called before the
+     *  Context is started. Zero, the default, disables reporting.
+     */
+    void setEventQueueProfileReportInterval(const Duration& interval) {
+        mEventQueueProfileReportInterval = interval;
+    }
+
     const String name;
     Network::IOService* ioService;
     Network::IOStrand* mainStrand;
@@ -180,10 +203,7 @@ protected:
     // Forces quit by stopping event processing.  Should only be
     // invoked after waiting a sufficient period after an initial stop
     // request.
-    void forceQuit() {
-        SILOG(forcequit,fatal,"Fatal error: Quit forced by timeout.");
-        ioService->stop();
-    }
+    void forceQuit();
 
     void workerThread();
     void cleanupWorkerThreads();
@@ -191,6 +211,11 @@ protected:
     // Signal handling
     void handleSignal(Signal::Type stype);
 
+    // Event queue profile reporting
+    void reportEventQueueProfiles();
+    Duration mEventQueueProfileReportInterval;
+    Poller* mEventQueueProfilePoller;
+
     Trace::Trace* mTrace;
     Command::Commander* mCommander;
 
@@ -211,6 +236,7 @@ protected:
     ExecutionThreads mExecutionThreadsType;
     typedef std::vector<Thread*> ThreadList;
     ThreadList mWorkerThreads;
+    Network::IOServicePool* mServicePool;
 }; // class ObjectHostContext
 
 } // namespace Sirikata
@@ -16,6 +16,9 @@
 #include <sirikata/core/network/Address.hpp>
 
 namespace Sirikata {
+
+class ThreadContext;
+
 namespace Transfer {
 
 /*
@@ -54,6 +57,34 @@ private:
     void cache_check_callback(const SparseData* data, std::tr1::shared_ptr<RemoteFileMetadata> file,
             std::tr1::shared_ptr<Chunk> chunk, ChunkCallback callback);
 
+    // Compressed (7z/ARHC) downloads are decoded on a separate pool so they
+    // don't stall HttpManager's IO threads. Each decode borrows one of a set of
+    // long-lived ThreadContexts, which are expensive to set up and can only
+    // serve one decode at a time.
+    Network::IOServicePool* mDecodePool;
+    std::vector<ThreadContext*> mIdleDecoders;
+    boost::mutex mDecoderMutex;
+
+    ThreadContext* acquireDecoder();
+    void releaseDecoder(ThreadContext* decoder);
+
+    // Decodes data on the decode pool, then finishes the request with the
+    // decoded data, or the original data if it couldn't be decoded.
+    void decode(DenseDataPtr data, std::tr1::shared_ptr<RemoteFileMetadata> file);
+
+    // Requests for a file which is already being downloaded or decoded wait
+    // for the outstanding request instead of issuing their own.
+    typedef std::vector<ChunkCallback> ChunkCallbackList;
+    typedef std::map<Fingerprint, ChunkCallbackList> PendingRequestMap;
+    PendingRequestMap mPendingRequests;
+    boost::mutex mPendingMutex;
+
+    // Returns true if this is the first outstanding request for the file
+    bool addPendingRequest(const Fingerprint& fp, ChunkCallback callback);
+    // Stores data in the cache, if requested, and invokes all callbacks
+    // waiting for the file.
+    void finishRequest(std::tr1::shared_ptr<RemoteFileMetadata> file, DenseDataPtr data, bool add_to_cache);
+
 public:
     HttpChunkHandler();
     ~HttpChunkHandler();
@@ -69,11 +100,29 @@ public:
      */
     void request_finished(std::tr1::shared_ptr<HttpManager::HttpResponse> response,
             HttpManager::ERR_TYPE error, const boost::system::error_code& boost_error,
-            std::tr1::shared_ptr<RemoteFileMetadata> file, std::tr1::shared_ptr<Chunk> chunk,
-            ChunkCallback callback);
+            std::tr1::shared_ptr<RemoteFileMetadata> file, std::tr1::shared_ptr<Chunk> chunk);
+
+    /*
+     * Number of compressed files decoded and the total time spent decoding
+     * them, in microseconds.
+     */
+    uint32 statsChunksDecoded() { return mDecodeStats.decoded; }
+    uint64 statsDecodeMicroseconds() { return mDecodeStats.decodeMicroseconds; }
 
     static HttpChunkHandler& getSingleton();
     static void destroy();
+
+private:
+    struct DecodeStats {
+        DecodeStats()
+         : decoded(0),
+           decodeMicroseconds(0)
+        {}
+
+        AtomicValue<uint32> decoded;
+        AtomicValue<uint64> decodeMicroseconds;
+    };
+    DecodeStats mDecodeStats;
 };
 
 }
@@ -0,0 +1,34 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LIBCORE_PERCENTILE_HPP_
+#define _SIRIKATA_LIBCORE_PERCENTILE_HPP_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace Sirikata {
+
+/** Get a percentile of a set of samples by linear interpolation between the
+ *  closest ranks.
+ *  \param sorted the samples, sorted in ascending order
+ *  \param p the percentile to compute, in [0, 1]
+ *  \returns the percentile, or 0 if there are no samples
+ */
+template<typename ValType>
+float64 percentile(const std::vector<ValType>& sorted, float64 p) {
+    if (sorted.empty())
+        return 0;
+    if (sorted.size() == 1)
+        return (float64)sorted[0];
+    float64 rank = p * (sorted.size() - 1);
+    size_t lo = (size_t)floor(rank);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return (float64)sorted[lo] + ((float64)sorted[hi] - (float64)sorted[lo]) * (rank - lo);
+}
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LIBCORE_PERCENTILE_HPP_
@@ -97,6 +97,11 @@ public:
     bool operator==(const UUID &other)const {return mData == other.mData;}
     bool isNull()const{return mData==Data::null();}
     size_t hash() const;
+    /** Hash an ordered pair of UUIDs, e.g. the (source, destination) of a
+     *  flow. All 256 bits are mixed and the order matters, so (a,b) and (b,a)
+     *  hash differently.
+     */
+    static size_t hash(const UUID& first, const UUID& second);
     class Hasher{public:
         size_t operator() (const UUID&uuid) const {
             return uuid.hash();
@@ -199,19 +199,35 @@ JpegError Decoder::fill() {
         d.bytes.i = 2;
         d.bytes.j = 2;
     }
+    d.bytes.noStuffStart = 0;
+    d.bytes.noStuffEnd = 0;
     // Fill in the rest of the buffer.
     uint32E nErr = d.r->Read(d.bytes.buf + d.bytes.j, sizeof(d.bytes.buf) - d.bytes.j);
     if (!d.arhc) {
         d.extOriginalFileSize += uint32(nErr.first);
-        for (uint32 index = d.bytes.j; index < d.bytes.j + nErr.first; ++index) {
-            uint8 byt = d.bytes.buf[index];
-            uint32 MAX_EXT_END_FILE_BUFFER = 16;
-            if (d.extEndFileBuffer.size() < MAX_EXT_END_FILE_BUFFER || d.extEndEncountered) {
-                appendByte(d.extEndFileBuffer, byt);
-            } else {
-                d.extEndFileBuffer[d.extEndFileBufferCursor] = byt;
+        uint32 index = d.bytes.j;
+        uint32 end = d.bytes.j + nErr.first;
+        uint32 MAX_EXT_END_FILE_BUFFER = 16;
+        for (; index < end; ++index) {
+            if (d.extEndFileBuffer.size() >= MAX_EXT_END_FILE_BUFFER && !d.extEndEncountered) {
+                break;
+            }
+            appendByte(d.extEndFileBuffer, d.bytes.buf[index]);
+        }
+        if (index < end) {
+            // The ring buffer is full, so only the bytes which survive to the
+            // end of this read need to be written: skip over the rest and
+            // advance the cursor as if they had been written.
+            uint32 ringSize = uint32(d.extEndFileBuffer.size());
+            if (end - index > ringSize) {
+                uint32 skip = end - index - ringSize;
+                d.extEndFileBufferCursor = (d.extEndFileBufferCursor + skip) % ringSize;
+                index += skip;
+            }
+            for (; index < end; ++index) {
+                d.extEndFileBuffer[d.extEndFileBufferCursor] = d.bytes.buf[index];
                 d.extEndFileBufferCursor += 1;
-                d.extEndFileBufferCursor %= uint32(d.extEndFileBuffer.size());
+                d.extEndFileBufferCursor %= ringSize;
             }
         }
     }
@@ -38,6 +38,7 @@
 //
 
 #include <sirikata/core/jpeg-arhc/Decoder.hpp>
+#include <sirikata/core/jpeg-arhc/Kernels.hpp>
 #include <stdio.h>
 
 namespace Sirikata {
@@ -203,6 +204,33 @@ void BitByteStream::emitBits(uint16 input_bits, uint8 nBits, bool stuffZeros) {
 // the caller is the one responsible for first checking that d.bits.n < n.
 JpegError Decoder::ensureNBits(int32 n) {
     Decoder &d = *this;
+    // Fast path: if the bytes still needed are known to contain no 0xff, and
+    // readByteStuffedByte would have taken its own fast path for each of
+    // them, consume them all at once with identical results.
+    int32 need = (n - d.bits.n + 7) >> 3;
+    if (need > 0 && d.bytes.i + need + 1 <= d.bytes.j) {
+        if (d.bytes.noStuffStart > d.bytes.i || d.bytes.noStuffEnd < d.bytes.i + need) {
+            d.bytes.noStuffStart = d.bytes.i;
+            d.bytes.noStuffEnd = d.bytes.i + int(FindStuffedByte(d.bytes.buf + d.bytes.i,
+                                                                 d.bytes.j - d.bytes.i));
+        }
+        if (d.bytes.noStuffEnd >= d.bytes.i + need) {
+            uint8 *src = d.bytes.buf + d.bytes.i;
+            for (int32 k = 0; k < need; ++k) {
+                d.bits.a = (d.bits.a<<8) | (uint32)(src[k]);
+                if (d.bits.m == 0) {
+                    d.bits.m = 1 << 7;
+                } else {
+                    d.bits.m <<= 8;
+                }
+            }
+            d.bits.n += 8 * need;
+            d.appendBytesToWriteBuffer(src, need);
+            d.bytes.i += need;
+            d.bytes.nUnreadable = 1;
+            return JpegError::nil();
+        }
+    }
 	while (true) {
 		uint8E cErr = d.readByteStuffedByte();
         if (cErr.second != JpegError::nil()) {
@@ -0,0 +1,124 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/jpeg-arhc/Kernels.hpp>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JPEG_KERNELS_SSE2 1
+#endif
+
+// AVX2 is compiled per-function so the rest of the library doesn't depend on
+// it, and is only used if the CPU reports support at runtime.
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define JPEG_KERNELS_AVX2 1
+#endif
+
+namespace Sirikata {
+
+size_t FindStuffedByteScalar(const uint8 *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i] == 0xff) {
+            return i;
+        }
+    }
+    return len;
+}
+
+namespace {
+
+// Portable fallback which tests 8 bytes at a time: a byte of ~word is zero
+// exactly when the byte of word is 0xff.
+size_t FindStuffedByteSWAR(const uint8 *data, size_t len) {
+    const uint64 ones = 0x0101010101010101ULL;
+    const uint64 highs = 0x8080808080808080ULL;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64 word;
+        memcpy(&word, data + i, sizeof(word));
+        word = ~word;
+        if (((word - ones) & ~word & highs) != 0) {
+            break;
+        }
+    }
+    return i + FindStuffedByteScalar(data + i, len - i);
+}
+
+#ifdef JPEG_KERNELS_SSE2
+size_t FindStuffedByteSSE2(const uint8 *data, size_t len) {
+    const __m128i ff = _mm_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, ff));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + FindStuffedByteScalar(data + i, len - i);
+}
+#endif
+
+#ifdef JPEG_KERNELS_AVX2
+__attribute__((target("avx2")))
+size_t FindStuffedByteAVX2(const uint8 *data, size_t len) {
+    const __m256i ff = _mm256_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, ff));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + FindStuffedByteScalar(data + i, len - i);
+}
+#endif
+
+typedef size_t (*FindStuffedByteFn)(const uint8 *data, size_t len);
+
+struct KernelSelection {
+    FindStuffedByteFn findStuffedByte;
+    const char *name;
+
+    KernelSelection() {
+        findStuffedByte = &FindStuffedByteSWAR;
+        name = "swar";
+#ifdef JPEG_KERNELS_SSE2
+        findStuffedByte = &FindStuffedByteSSE2;
+        name = "sse2";
+#endif
+#ifdef JPEG_KERNELS_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            findStuffedByte = &FindStuffedByteAVX2;
+            name = "avx2";
+        }
+#endif
+    }
+};
+
+const KernelSelection &selectedKernels() {
+    static KernelSelection selection;
+    return selection;
+}
+
+// Make the selection during static initialization so the first decode
+// doesn't pay for it.
+const KernelSelection &gSelectedKernels = selectedKernels();
+
+}
+
+size_t FindStuffedByte(const uint8 *data, size_t len) {
+    return selectedKernels().findStuffedByte(data, len);
+}
+
+const char *JpegKernelName() {
+    return selectedKernels().name;
+}
+
+}
@@ -0,0 +1,314 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/network/EventQueueProfile.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/trace/TimeSeries.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+AtomicValue<uint32> EventQueueProfile::sEnabled(0);
+AtomicValue<int64> EventQueueProfile::sSlowThresholdMicroseconds(100000);
+
+EventQueueProfile::Histogram::Histogram() {
+    clear();
+}
+
+uint32 EventQueueProfile::Histogram::bucket(const Duration& dur) {
+    int64 us = dur.toMicroseconds();
+    uint32 b = 0;
+    while(us > 0 && b < NumBuckets-1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+Duration EventQueueProfile::Histogram::bucketUpperBound(uint32 bucket) {
+    return Duration::microseconds((int64)1 << bucket);
+}
+
+void EventQueueProfile::Histogram::sample(const Duration& dur) {
+    mBuckets[bucket(dur)]++;
+    int64 us = dur.toMicroseconds();
+    if (us > 0)
+        mTotalMicroseconds += (uint64)us;
+}
+
+void EventQueueProfile::Histogram::merge(const Histogram& other) {
+    for(uint32 i = 0; i < NumBuckets; i++)
+        mBuckets[i] += other.mBuckets[i].read();
+    mTotalMicroseconds += other.mTotalMicroseconds.read();
+}
+
+void EventQueueProfile::Histogram::clear() {
+    for(uint32 i = 0; i < NumBuckets; i++)
+        mBuckets[i] = 0;
+    mTotalMicroseconds = 0;
+}
+
+uint64 EventQueueProfile::Histogram::count() const {
+    uint64 total = 0;
+    for(uint32 i = 0; i < NumBuckets; i++)
+        total += mBuckets[i].read();
+    return total;
+}
+
+Duration EventQueueProfile::Histogram::mean() const {
+    uint64 n = count();
+    if (n == 0) return Duration::zero();
+    return Duration::microseconds(mTotalMicroseconds.read() / n);
+}
+
+Duration EventQueueProfile::Histogram::percentile(float64 pct) const {
+    uint64 n = count();
+    if (n == 0) return Duration::zero();
+    // Rank of the sample we're looking for, 1-based
+    uint64 rank = (uint64)(pct / 100.0 * n + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    uint64 seen = 0;
+    for(uint32 i = 0; i < NumBuckets; i++) {
+        seen += mBuckets[i].read();
+        if (seen >= rank)
+            return bucketUpperBound(i);
+    }
+    return bucketUpperBound(NumBuckets-1);
+}
+
+Duration EventQueueProfile::Histogram::max() const {
+    for(int32 i = NumBuckets-1; i >= 0; i--) {
+        if (mBuckets[i].read() > 0)
+            return bucketUpperBound(i);
+    }
+    return Duration::zero();
+}
+
+
+EventQueueProfile::TagProfile::TagProfile()
+ : slow(0)
+{
+}
+
+
+struct EventQueueProfile::Stats {
+    Stats(const String& _name, uint64 _id)
+     : name(_name),
+       id(_id),
+       queued(0),
+       executed(0)
+    {
+    }
+
+    ~Stats() {
+        for(TagProfileMap::iterator it = tags.begin(); it != tags.end(); it++)
+            delete it->second;
+        tags.clear();
+    }
+
+    const String name;
+    // Unique for the life of the process, unlike this Stats' address
+    const uint64 id;
+
+    AtomicValue<uint32> queued;
+    AtomicValue<uint32> executed;
+
+    // Protects insertion into and iteration over tags. Entries are never
+    // removed until the Stats are destroyed.
+    mutable Mutex mutex;
+    TagProfileMap tags;
+};
+
+namespace {
+// Per-thread cache of tag lookups, by Stats id then tag, so queuing a handler
+// doesn't need to lock. Entries for destroyed profiles are never looked up
+// again since ids aren't reused.
+typedef std::tr1::unordered_map<const char*, EventQueueProfile::TagProfile*> TagCache;
+typedef std::tr1::unordered_map<uint64, TagCache> ProfileTagCache;
+boost::thread_specific_ptr<ProfileTagCache> sTagCache;
+
+AtomicValue<uint64> sNextStatsID(0);
+}
+
+EventQueueProfile::EventQueueProfile(const String& name)
+ : mStats(new Stats(name, sNextStatsID++))
+{
+}
+
+EventQueueProfile::~EventQueueProfile() {
+}
+
+void EventQueueProfile::setEnabled(bool en) {
+    sEnabled = (en ? 1 : 0);
+}
+
+void EventQueueProfile::setSlowThreshold(const Duration& dur) {
+    sSlowThresholdMicroseconds = dur.toMicroseconds();
+}
+
+uint32 EventQueueProfile::queued() const {
+    return mStats->queued.read();
+}
+
+uint32 EventQueueProfile::executed() const {
+    return mStats->executed.read();
+}
+
+IOCallback EventQueueProfile::wrap(const IOCallback& handler, const char* tag, const Duration& delay) {
+    mStats->queued++;
+    // Find the tag now so the handler only needs the stats it holds on to
+    TagProfile* prof = getOrCreateTagProfile(tag);
+    return std::tr1::bind(&EventQueueProfile::execute, mStats, prof, Timer::now(), delay, handler, tag);
+}
+
+void EventQueueProfile::execute(const StatsPtr& stats, TagProfile* prof, const Time& queued_at, const Duration& delay, const IOCallback& cb, const char* tag) {
+    stats->executed++;
+    Time start = Timer::now();
+    cb();
+    Time end = Timer::now();
+
+    prof->wait.sample((start - queued_at) - delay);
+    Duration exec = end - start;
+    prof->execution.sample(exec);
+    if (exec > slowThreshold()) {
+        prof->slow++;
+        SILOG(ioservice, warning, "Slow handler '" << (tag == NULL ? "(NULL)" : tag) << "' in '" << stats->name << "' ran for " << exec);
+    }
+}
+
+EventQueueProfile::TagProfile* EventQueueProfile::getOrCreateTagProfile(const char* tag) {
+    ProfileTagCache* cache = sTagCache.get();
+    if (cache == NULL) {
+        cache = new ProfileTagCache();
+        sTagCache.reset(cache);
+    }
+    TagCache& tag_cache = (*cache)[mStats->id];
+    TagCache::iterator cached_it = tag_cache.find(tag);
+    if (cached_it != tag_cache.end())
+        return cached_it->second;
+
+    TagProfile* prof = NULL;
+    {
+        LockGuard lock(mStats->mutex);
+        TagProfileMap::iterator it = mStats->tags.find(tag);
+        if (it != mStats->tags.end()) {
+            prof = it->second;
+        }
+        else {
+            prof = new TagProfile();
+            mStats->tags[tag] = prof;
+        }
+    }
+    tag_cache[tag] = prof;
+    return prof;
+}
+
+const EventQueueProfile::TagProfile* EventQueueProfile::tagProfile(const char* tag) const {
+    LockGuard lock(mStats->mutex);
+    TagProfileMap::const_iterator it = mStats->tags.find(tag);
+    if (it == mStats->tags.end())
+        return NULL;
+    return it->second;
+}
+
+void EventQueueProfile::reset() {
+    LockGuard lock(mStats->mutex);
+    for(TagProfileMap::iterator it = mStats->tags.begin(); it != mStats->tags.end(); it++) {
+        it->second->wait.clear();
+        it->second->execution.clear();
+        it->second->slow = 0;
+    }
+}
+
+namespace {
+// Different char*'s may hold the same tag, so reports merge them by value.
+typedef std::map<String, EventQueueProfile::TagProfile> ReducedTagProfileMap;
+// Tags by total execution time, largest first
+typedef std::multimap<float64, const ReducedTagProfileMap::value_type*, std::greater<float64> > SortedTagProfiles;
+
+String tagName(const char* tag) {
+    return (tag == NULL ? String("(NULL)") : String(tag));
+}
+
+float64 totalExecutionSeconds(const EventQueueProfile::TagProfile& prof) {
+    return prof.execution.mean().toSeconds() * prof.execution.count();
+}
+}
+
+String EventQueueProfile::timeSeriesKey(const String& name) {
+    // TimeSeries keys are split on '.', so names can't contain them
+    String key = name;
+    for(String::size_type i = 0; i < key.size(); i++) {
+        if (key[i] == '.' || key[i] == ' ')
+            key[i] = '_';
+    }
+    return key;
+}
+
+void EventQueueProfile::fillCommandResult(Command::Result& res) const {
+    uint32 nqueued = queued(), nexecuted = executed();
+    res.put("name", mStats->name);
+    res.put("queued", nqueued);
+    res.put("executed", nexecuted);
+    res.put("pending", nqueued > nexecuted ? (nqueued - nexecuted) : (uint32)0);
+
+    ReducedTagProfileMap reduced;
+    {
+        LockGuard lock(mStats->mutex);
+        for(TagProfileMap::const_iterator it = mStats->tags.begin(); it != mStats->tags.end(); it++) {
+            EventQueueProfile::TagProfile& prof = reduced[tagName(it->first)];
+            prof.wait.merge(it->second->wait);
+            prof.execution.merge(it->second->execution);
+            prof.slow += it->second->slow.read();
+        }
+    }
+    SortedTagProfiles sorted;
+    for(ReducedTagProfileMap::const_iterator it = reduced.begin(); it != reduced.end(); it++)
+        sorted.insert(SortedTagProfiles::value_type(totalExecutionSeconds(it->second), &(*it)));
+
+    res.put("tags", Command::Array());
+    Command::Array& tags = res.getArray("tags");
+    for(SortedTagProfiles::const_iterator it = sorted.begin(); it != sorted.end(); it++) {
+        const TagProfile& prof = it->second->second;
+        if (prof.execution.count() == 0) continue;
+        tags.push_back(Command::Object());
+        Command::Result& tag = tags.back();
+        tag.put("tag", it->second->first);
+        tag.put("executed", (int64)prof.execution.count());
+        tag.put("slow", prof.slow.read());
+        tag.put("total", it->first);
+        tag.put("wait.mean", prof.wait.mean().toString());
+        tag.put("wait.p50", prof.wait.percentile(50).toString());
+        tag.put("wait.p99", prof.wait.percentile(99).toString());
+        tag.put("wait.max", prof.wait.max().toString());
+        tag.put("execution.mean", prof.execution.mean().toString());
+        tag.put("execution.p50", prof.execution.percentile(50).toString());
+        tag.put("execution.p99", prof.execution.percentile(99).toString());
+        tag.put("execution.max", prof.execution.max().toString());
+    }
+}
+
+void EventQueueProfile::reportTimeSeries(Trace::TimeSeries* ts, const String& prefix) const {
+    uint32 nqueued = queued(), nexecuted = executed();
+    ts->report(prefix + ".queued", nqueued);
+    ts->report(prefix + ".executed", nexecuted);
+    ts->report(prefix + ".pending", nqueued > nexecuted ? (nqueued - nexecuted) : (uint32)0);
+
+    LockGuard lock(mStats->mutex);
+    for(TagProfileMap::const_iterator it = mStats->tags.begin(); it != mStats->tags.end(); it++) {
+        const TagProfile& prof = *(it->second);
+        if (prof.execution.count() == 0) continue;
+        String tag_prefix = prefix + ".tags." + timeSeriesKey(tagName(it->first));
+        ts->report(tag_prefix + ".executed", (float64)prof.execution.count());
+        ts->report(tag_prefix + ".slow", prof.slow.read());
+        ts->report(tag_prefix + ".wait.p99", prof.wait.percentile(99).toSeconds());
+        ts->report(tag_prefix + ".execution.mean", prof.execution.mean().toSeconds());
+        ts->report(tag_prefix + ".execution.p99", prof.execution.percentile(99).toSeconds());
+    }
+}
+
+} // namespace Network
+} // namespace Sirikata
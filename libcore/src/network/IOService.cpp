@@ -34,11 +34,13 @@
 #include <sirikata/core/network/IOService.hpp>
 #include <sirikata/core/util/Time.hpp>
 #include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/TimerWheel.hpp>
 #include <boost/version.hpp>
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
 #include <sirikata/core/util/Timer.hpp>
 #include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/trace/TimeSeries.hpp>
 
 namespace Sirikata {
 namespace Network {
@@ -54,7 +56,6 @@ typedef std::tr1::shared_ptr<deadline_timer> deadline_timer_ptr;
 typedef boost::posix_time::microseconds posix_microseconds;
 using std::tr1::placeholders::_1;
 
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
 namespace {
 typedef boost::mutex AllIOServicesMutex;
 typedef boost::lock_guard<AllIOServicesMutex> AllIOServicesLockGuard;
@@ -62,11 +63,12 @@ AllIOServicesMutex gAllIOServicesMutex;
 typedef std::tr1::unordered_set<IOService*> AllIOServicesSet;
 AllIOServicesSet gAllIOServices;
 } // namespace
-#endif
 
 
 IOService::IOService(const String& name)
- : mName(name)
+ : mName(name),
+   mProfile(name),
+   mTimerWheel(NULL)
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
    ,
    mTimersEnqueued(0),
@@ -78,30 +80,41 @@ IOService::IOService(const String& name)
 {
     mImpl = new boost::asio::io_service(1);
 
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
     AllIOServicesLockGuard lock(gAllIOServicesMutex);
     gAllIOServices.insert(this);
-#endif
 }
 
 IOService::~IOService(){
+    // The wheel's deadline timer must be destroyed before the asio service
+    delete mTimerWheel;
     delete mImpl;
 
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
     AllIOServicesLockGuard lock(gAllIOServicesMutex);
     gAllIOServices.erase(this);
-#endif
 }
 
 IOStrand* IOService::createStrand(const String& name) {
-    IOStrand* res = new IOStrand(*this, name);
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
-    LockGuard lock(mMutex);
-    mStrands.insert(res);
-#endif
+    IOService* home = (mStrandPlacement ? mStrandPlacement() : this);
+    IOStrand* res = new IOStrand(*home, name);
+    LockGuard lock(home->mMutex);
+    home->mStrands.insert(res);
     return res;
 }
 
+void IOService::setStrandPlacement(const StrandPlacement& placement) {
+    mStrandPlacement = placement;
+}
+
+uint32 IOService::numStrands() const {
+    LockGuard lock(const_cast<Mutex&>(mMutex));
+    return (uint32)mStrands.size();
+}
+
+void IOService::enableTimerWheel(const Duration& slack) {
+    if (mTimerWheel != NULL) return;
+    mTimerWheel = new TimerWheel(this, slack);
+}
+
 uint32 IOService::pollOne() {
     return (uint32) mImpl->poll_one();
 }
@@ -147,6 +160,15 @@ void IOService::dispatch(
     const IOCallback& handler, const char* tag, const char* tagStat)
 {
     assert(handler);
+    if (EventQueueProfile::enabled())
+        dispatchImpl(mProfile.wrap(handler, tagStat == NULL ? tag : tagStat), tag, tagStat);
+    else
+        dispatchImpl(handler, tag, tagStat);
+}
+
+void IOService::dispatchImpl(
+    const IOCallback& handler, const char* tag, const char* tagStat)
+{
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mImpl->dispatch(
         tracking_wrapper(handler, tag, tagStat)
@@ -160,6 +182,15 @@ void IOService::post(
     const IOCallback& handler, const char* tag, const char* tagStat)
 {
     assert(handler);
+    if (EventQueueProfile::enabled())
+        postImpl(mProfile.wrap(handler, tagStat == NULL ? tag : tagStat), tag, tagStat);
+    else
+        postImpl(handler, tag, tagStat);
+}
+
+void IOService::postImpl(
+    const IOCallback& handler, const char* tag, const char* tagStat)
+{
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mImpl->post(
         tracking_wrapper(handler, tag, tagStat)
@@ -180,6 +211,13 @@ void handle_deadline_timer(const boost::system::error_code&e, const deadline_tim
 
 void IOService::post(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat) {
     assert(handler);
+    if (EventQueueProfile::enabled())
+        postImpl(waitFor, mProfile.wrap(handler, tagStat == NULL ? tag : tagStat, waitFor), tag, tagStat);
+    else
+        postImpl(waitFor, handler, tag, tagStat);
+}
+
+void IOService::postImpl(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat) {
 #if BOOST_VERSION==103900
     static bool warnOnce=true;
     if (warnOnce) {
@@ -187,6 +225,18 @@ void IOService::post(const Duration& waitFor, const IOCallback& handler, const c
         SILOG(core,error,"Using buggy version of boost (1.39.0), leaking deadline_timer to avoid crash");
     }
 #endif
+    static Duration max_post_timeout = Duration::seconds(5);
+    if (waitFor > max_post_timeout) {
+        SILOG(service, error, "Saw \"" << tag << " - " << tagStat << "\" post with timeout of " << waitFor << ". Timeouts this long are a very bad idea since they can hold up shutdown and cannot be canceled.");
+    }
+
+    // Note that these aren't counted by SIRIKATA_TRACK_EVENT_QUEUES' timer
+    // statistics
+    if (mTimerWheel != NULL) {
+        mTimerWheel->post(waitFor, handler);
+        return;
+    }
+
     deadline_timer_ptr timer(new deadline_timer(*mImpl, posix_microseconds(waitFor.toMicroseconds())));
 
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
@@ -206,11 +256,6 @@ void IOService::post(const Duration& waitFor, const IOCallback& handler, const c
 #else
     timer->async_wait(std::tr1::bind(&handle_deadline_timer, _1, timer, handler));
 #endif
-
-    static Duration max_post_timeout = Duration::seconds(5);
-    if (waitFor > max_post_timeout) {
-        SILOG(service, error, "Saw \"" << tag << " - " << tagStat << "\" post with timeout of " << waitFor << ". Timeouts this long are a very bad idea since they can hold up shutdown and cannot be canceled.");
-    }
 }
 
 
@@ -448,6 +493,78 @@ void IOService::commandReportAllStats(const Command::Command& cmd, Command::Comm
 }
 
 
+void IOService::fillCommandResultWithProfile(Command::Result& res) {
+    LockGuard lock(mMutex);
+
+    mProfile.fillCommandResult(res);
+
+    res.put("strands", Command::Array());
+    Command::Array& strands = res.getArray("strands");
+    for(StrandSet::const_iterator it = mStrands.begin(); it != mStrands.end(); it++) {
+        strands.push_back(Command::Object());
+        (*it)->profile().fillCommandResult(strands.back());
+    }
+}
+
+void IOService::reportAllProfilesTimeSeries(Trace::TimeSeries* ts, const String& prefix) {
+    AllIOServicesLockGuard lock(gAllIOServicesMutex);
+    for(AllIOServicesSet::const_iterator it = gAllIOServices.begin(); it != gAllIOServices.end(); it++) {
+        IOService* ios = *it;
+        String ios_prefix = prefix + "." + EventQueueProfile::timeSeriesKey(ios->name());
+        LockGuard ios_lock(ios->mMutex);
+        ios->mProfile.reportTimeSeries(ts, ios_prefix);
+        for(StrandSet::const_iterator strand_it = ios->mStrands.begin(); strand_it != ios->mStrands.end(); strand_it++)
+            (*strand_it)->profile().reportTimeSeries(ts, ios_prefix + ".strands." + EventQueueProfile::timeSeriesKey((*strand_it)->name()));
+    }
+}
+
+void IOService::resetAllProfiles() {
+    AllIOServicesLockGuard lock(gAllIOServicesMutex);
+    for(AllIOServicesSet::const_iterator it = gAllIOServices.begin(); it != gAllIOServices.end(); it++) {
+        IOService* ios = *it;
+        LockGuard ios_lock(ios->mMutex);
+        ios->mProfile.reset();
+        for(StrandSet::const_iterator strand_it = ios->mStrands.begin(); strand_it != ios->mStrands.end(); strand_it++)
+            (*strand_it)->profile().reset();
+    }
+}
+
+void IOService::commandProfile(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    if (cmd.contains("slow-threshold")) {
+        try {
+            EventQueueProfile::setSlowThreshold(boost::lexical_cast<Duration>(cmd.getString("slow-threshold")));
+        }
+        catch(boost::bad_lexical_cast&) {
+            result.put("error", "Ill-formatted request: slow-threshold must be a duration, e.g. 50ms.");
+            cmdr->result(cmdid, result);
+            return;
+        }
+    }
+    if (cmd.contains("enable")) {
+        // Clear out old data when turning profiling on so the results only
+        // cover the period it has been on.
+        bool enable = cmd.getBool("enable");
+        if (enable && !EventQueueProfile::enabled())
+            resetAllProfiles();
+        EventQueueProfile::setEnabled(enable);
+    }
+    if (cmd.getBool("reset", false))
+        resetAllProfiles();
+
+    result.put("enabled", EventQueueProfile::enabled());
+    result.put("slow-threshold", EventQueueProfile::slowThreshold().toString());
+
+    AllIOServicesLockGuard lock(gAllIOServicesMutex);
+    result.put("ioservices", Command::Array());
+    Command::Array& services = result.getArray("ioservices");
+    for(AllIOServicesSet::const_iterator it = gAllIOServices.begin(); it != gAllIOServices.end(); it++) {
+        services.push_back(Command::Object());
+        (*it)->fillCommandResultWithProfile(services.back());
+    }
+    cmdr->result(cmdid, result);
+}
 
 } // namespace Network
 } // namespace Sirikata
@@ -35,35 +35,132 @@
 #include <sirikata/core/network/IOService.hpp>
 #include <sirikata/core/network/IOWork.hpp>
 #include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Sirikata {
 namespace Network {
 
-IOServicePool::IOServicePool(const String& name, uint32 nthreads)
- : mIO(new IOService(name)),
+namespace {
+void Noop() {
+}
+}
+
+IOServicePool::IOServicePool(const String& name, uint32 nthreads, ThreadingModel model)
+ : mName(name),
+   mModel(model),
+   mIO(NULL),
    mThreads(nthreads, NULL),
-   mWork(NULL)
+   mWorkStealing(true),
+   mWorking(0),
+   mRunning(0),
+   mStopped(0),
+   mIdle(NULL)
 {
+    if (mModel == PerThreadServices && nthreads > 0) {
+        for(uint32 i = 0; i < nthreads; i++)
+            mServices.push_back(new IOService(i == 0 ? name : (name + " " + boost::lexical_cast<String>(i))));
+        mIO = mServices[0];
+        mIO->setStrandPlacement(std::tr1::bind(&IOServicePool::placeStrand, this));
+        mIdle = new AtomicValue<int32>[nthreads];
+        for(uint32 i = 0; i < nthreads; i++)
+            mIdle[i] = 0;
+    }
+    else {
+        mIO = new IOService(name);
+        mServices.push_back(mIO);
+    }
 }
 
 IOServicePool::~IOServicePool() {
-    if (mWork) stopWork();
+    if (!mWork.empty()) stopWork();
     for(ThreadList::iterator it = mThreads.begin(); it != mThreads.end(); it++)
         delete *it;
-    delete mIO;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        delete *it;
+    delete[] mIdle;
 }
 
-namespace {
-void runWrapper(IOService* ios) {
-    ios->run();
+IOServicePool::ThreadingModel IOServicePool::parseThreadingModel(const String& model) {
+    if (model == "per-thread")
+        return PerThreadServices;
+    if (model != "shared")
+        SILOG(ioservice, error, "Unknown IOServicePool threading model '" << model << "', using 'shared'");
+    return SharedService;
+}
+
+void IOServicePool::setCPUAffinity(const std::vector<int32>& cpus) {
+    mCPUs = cpus;
+}
+
+std::vector<int32> IOServicePool::parseCPUList(const String& cpus) {
+    std::vector<int32> result;
+    String::size_type pos = 0;
+    while(pos < cpus.size()) {
+        String::size_type comma = cpus.find(',', pos);
+        if (comma == String::npos) comma = cpus.size();
+        String item = cpus.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (item.empty()) continue;
+
+        try {
+            String::size_type dash = item.find('-');
+            if (dash == String::npos) {
+                result.push_back(boost::lexical_cast<int32>(item));
+            }
+            else {
+                int32 first = boost::lexical_cast<int32>(item.substr(0, dash));
+                int32 last = boost::lexical_cast<int32>(item.substr(dash+1));
+                for(int32 cpu = first; cpu <= last; cpu++)
+                    result.push_back(cpu);
+            }
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(ioservice, error, "Ignoring invalid CPU '" << item << "' in CPU list '" << cpus << "'");
+        }
+    }
+    return result;
+}
+
+void IOServicePool::setWorkStealing(bool steal) {
+    mWorkStealing = steal;
+}
+
+void IOServicePool::enableTimerWheel(const Duration& slack) {
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        (*it)->enableTimerWheel(slack);
 }
+
+void IOServicePool::stop() {
+    mStopped = 1;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        (*it)->stop();
 }
+
 void IOServicePool::reset() {
-    mIO->reset();
+    mStopped = 0;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        (*it)->reset();
+}
+
+void IOServicePool::startThreads(uint32 first) {
+    mRunning = (uint32)mThreads.size();
+    for(uint32 i = first; i < mThreads.size(); i++)
+        mThreads[i] = new Thread( mName + " Worker", std::tr1::bind(&IOServicePool::runThread, this, i) );
 }
+
 void IOServicePool::run() {
-    for(ThreadList::iterator it = mThreads.begin(); it != mThreads.end(); it++)
-        (*it) = new Thread( mIO->name() + " Worker", std::tr1::bind(runWrapper, mIO) );
+    startThreads(0);
+}
+
+void IOServicePool::runIncludingCurrentThread() {
+    startThreads(1);
+    runThread(0);
 }
 
 void IOServicePool::join() {
@@ -71,19 +168,29 @@ void IOServicePool::join() {
     stopWork();
 
     for(ThreadList::iterator it = mThreads.begin(); it != mThreads.end(); it++)
-        (*it)->join();
+        if (*it != NULL) (*it)->join();
 }
 
 void IOServicePool::startWork() {
-    if (mWork) return;
-    mWork = new IOWork(*mIO);
+    if (!mWork.empty()) return;
+    for(ServiceList::iterator it = mServices.begin(); it != mServices.end(); it++)
+        mWork.push_back(new IOWork(*it));
+    mWorking = 1;
 }
 
 void IOServicePool::stopWork() {
-    if (!mWork) return;
+    if (mWork.empty()) return;
+
+    mWorking = 0;
+    for(WorkList::iterator it = mWork.begin(); it != mWork.end(); it++)
+        delete *it;
+    mWork.clear();
 
-    delete mWork;
-    mWork = NULL;
+    // Idle threads need to wake up to notice they can exit
+    if (mModel == PerThreadServices) {
+        for(uint32 i = 0; i < mServices.size(); i++)
+            mServices[i]->post(&Noop, "IOServicePool::stopWork");
+    }
 }
 
 
@@ -91,5 +198,107 @@ IOService* IOServicePool::service() {
     return mIO;
 }
 
+void IOServicePool::runThread(uint32 idx) {
+    if (!mCPUs.empty()) {
+        int32 cpu = mCPUs[idx % mCPUs.size()];
+#if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            SILOG(ioservice, warning, "Couldn't pin '" << mName << "' thread " << idx << " to CPU " << cpu);
+#else
+        SILOG(ioservice, warning, "Pinning IOServicePool threads isn't supported on this platform");
+#endif
+    }
+
+    if (mModel == PerThreadServices)
+        runPerThreadService(idx);
+    else
+        mIO->run();
+}
+
+void IOServicePool::runPerThreadService(uint32 idx) {
+    IOService* own = mServices[idx];
+    bool stealing = mWorkStealing && mServices.size() > 1;
+
+    if (!stealing) {
+        own->run();
+    }
+    else {
+        // Keep running our own handlers. If there's more than one waiting,
+        // wake an idle thread to help. If we run out, try to steal, and
+        // only block if there's nothing to steal either.
+        uint32 streak = 0;
+        while(true) {
+            if (own->pollOne() > 0) {
+                if (++streak > 1)
+                    wakeIdleThread(idx);
+                continue;
+            }
+            streak = 0;
+            if (mWorking.read() && steal(idx) > 0)
+                continue;
+
+            mIdle[idx] = 1;
+            uint32 ran = own->runOne();
+            mIdle[idx] = 0;
+            if (ran == 0)
+                break;
+        }
+    }
+
+    // We're out of work, but threads that are still running may post to our
+    // strands as they finish, so keep servicing them until all are done.
+    mRunning--;
+    while(mRunning.read() > 0 && !mStopped.read()) {
+        own->reset();
+        own->poll();
+        Timer::sleep(Duration::milliseconds((int64)1));
+    }
+    if (!mStopped.read()) {
+        own->reset();
+        own->poll();
+    }
+}
+
+uint32 IOServicePool::steal(uint32 idx) {
+    uint32 nservices = (uint32)mServices.size();
+    for(uint32 i = 1; i < nservices; i++) {
+        uint32 victim = (idx + i) % nservices;
+        if (mIdle[victim].read() > 0)
+            continue;
+        if (mServices[victim]->pollOne() > 0)
+            return 1;
+    }
+    return 0;
+}
+
+void IOServicePool::wakeIdleThread(uint32 busy_idx) {
+    uint32 nservices = (uint32)mServices.size();
+    for(uint32 i = 1; i < nservices; i++) {
+        uint32 idle = (busy_idx + i) % nservices;
+        // Only one thread should get to wake each idle thread
+        if (mIdle[idle].read() > 0 && --mIdle[idle] == 0) {
+            mServices[idle]->post(&Noop, "IOServicePool::wakeIdleThread");
+            return;
+        }
+    }
+}
+
+IOService* IOServicePool::placeStrand() {
+    // Place on the thread with the fewest strands
+    IOService* best = mServices[0];
+    uint32 best_count = best->numStrands();
+    for(uint32 i = 1; i < mServices.size(); i++) {
+        uint32 count = mServices[i]->numStrands();
+        if (count < best_count) {
+            best = mServices[i];
+            best_count = count;
+        }
+    }
+    return best;
+}
+
 } // namespace Network
 } // namespace Sirikata
@@ -32,6 +32,7 @@
 
 #include <sirikata/core/util/Standard.hh>
 #include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/EventQueueProfile.hpp>
 #include <sirikata/core/network/IOService.hpp>
 #include <sirikata/core/network/Asio.hpp>
 #include <sirikata/core/util/Timer.hpp>
@@ -41,7 +42,8 @@ namespace Network {
 
 IOStrand::IOStrand(IOService& io, const String& name)
  : mService(io),
-   mName(name)
+   mName(name),
+   mProfile(name)
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
    ,
    mTimersEnqueued(0),
@@ -54,9 +56,7 @@ IOStrand::IOStrand(IOService& io, const String& name)
 }
 
 IOStrand::~IOStrand() {
-#ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mService.destroyingStrand(this);
-#endif
     delete mImpl;
 }
 
@@ -66,6 +66,29 @@ IOService& IOStrand::service() const {
 
 void IOStrand::dispatch(const IOCallback& handler, const char* tag) {
     assert(handler);
+    if (EventQueueProfile::enabled())
+        dispatchImpl(mProfile.wrap(handler, tag), tag);
+    else
+        dispatchImpl(handler, tag);
+}
+
+void IOStrand::post(const IOCallback& handler, const char* tag) {
+    assert(handler);
+    if (EventQueueProfile::enabled())
+        postImpl(mProfile.wrap(handler, tag), tag);
+    else
+        postImpl(handler, tag);
+}
+
+void IOStrand::post(const Duration& waitFor, const IOCallback& handler, const char* tag) {
+    assert(handler);
+    if (EventQueueProfile::enabled())
+        postImpl(waitFor, mProfile.wrap(handler, tag, waitFor), tag);
+    else
+        postImpl(waitFor, handler, tag);
+}
+
+void IOStrand::dispatchImpl(const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
     {
@@ -85,8 +108,7 @@ void IOStrand::dispatch(const IOCallback& handler, const char* tag) {
 #endif
 }
 
-void IOStrand::post(const IOCallback& handler, const char* tag) {
-    assert(handler);
+void IOStrand::postImpl(const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
     {
@@ -106,8 +128,7 @@ void IOStrand::post(const IOCallback& handler, const char* tag) {
 #endif
 }
 
-void IOStrand::post(const Duration& waitFor, const IOCallback& handler, const char* tag) {
-    assert(handler);
+void IOStrand::postImpl(const Duration& waitFor, const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mTimersEnqueued++;
     {
@@ -56,7 +56,18 @@ public:
         if (error == boost::asio::error::operation_aborted) {
             return; // don't care if the timer was cancelled.
         }
+        fire(sharedThis, tokenVal);
+    }
 
+    static void wheelTimedOut(IOTimerWPtr wthis, uint64 tokenVal) {
+        IOTimerPtr sharedThis (wthis.lock());
+        if (!sharedThis) {
+            return; // we've been deleted already.
+        }
+        fire(sharedThis, tokenVal);
+    }
+
+    static void fire(const IOTimerPtr& sharedThis, uint64 tokenVal) {
         if (sharedThis->mStrand != NULL) sharedThis->chk.serializedEnter();
         IOTimer*st=&*sharedThis;
 
@@ -69,39 +80,59 @@ public:
 };
 
 IOTimer::IOTimer(IOService& io)
- : mTimer(new DeadlineTimer(io)),
+ : mTimer(NULL),
+   mWheel(NULL),
+   mWheelEntry(NULL),
    mStrand(NULL),
    mFunc(),
    mCanceled(0)
 {
+    createTimer(io);
 }
 
 IOTimer::IOTimer(IOService& io, const IOCallback& cb)
- : mTimer(new DeadlineTimer(io)),
+ : mTimer(NULL),
+   mWheel(NULL),
+   mWheelEntry(NULL),
    mStrand(NULL),
    mFunc(),
    mCanceled(0)
 {
+    createTimer(io);
     setCallback(cb);
 }
 
 IOTimer::IOTimer(IOStrand* ios)
- : mTimer(new DeadlineTimer(ios->service())),
+ : mTimer(NULL),
+   mWheel(NULL),
+   mWheelEntry(NULL),
    mStrand(ios),
    mFunc(),
    mCanceled(0)
 {
+    createTimer(ios->service());
 }
 
 IOTimer::IOTimer(IOStrand* ios, const IOCallback& cb)
- : mTimer(new DeadlineTimer(ios->service())),
+ : mTimer(NULL),
+   mWheel(NULL),
+   mWheelEntry(NULL),
    mStrand(ios),
    mFunc(),
    mCanceled(0)
 {
+    createTimer(ios->service());
     setCallback(cb);
 }
 
+void IOTimer::createTimer(IOService& io) {
+    mWheel = io.timerWheel();
+    if (mWheel != NULL)
+        mWheelEntry = new TimerWheel::Entry();
+    else
+        mTimer = new DeadlineTimer(io);
+}
+
 IOTimerPtr IOTimer::create(IOService* io) {
     return IOTimerPtr(new IOTimer(*io));
 }
@@ -139,10 +170,19 @@ IOTimer::~IOTimer() {
     if (mStrand != NULL) chk.serializedEnter();
     cancel();
     delete mTimer;
+    delete mWheelEntry;
     if (mStrand != NULL) chk.serializedExit();
 }
 
 uint32 IOTimer::wait(const Duration &num_seconds) {
+    if (mWheel != NULL) {
+        // The wheel posts to the strand itself, so no wrapping is needed
+        return mWheel->schedule(
+            mWheelEntry, num_seconds,
+            std::tr1::bind(&IOTimer::TimedOut::wheelTimedOut, IOTimerWPtr(shared_from_this()), mCanceled.read()),
+            mStrand
+        );
+    }
     uint32 ncancelled = mTimer->expires_from_now(boost::posix_time::microseconds(num_seconds.toMicroseconds()));
     IOTimerWPtr weakThisPtr(this->shared_from_this());
     if (mStrand == NULL) {
@@ -182,11 +222,13 @@ void IOTimer::setCallback(const IOCallback& cb) {
 uint32 IOTimer::cancel() {
     if (mStrand != NULL) chk.serializedEnter();
     mCanceled++;
-    uint32 ncancelled = mTimer->cancel();
+    uint32 ncancelled = (mWheel != NULL ? mWheel->cancel(mWheelEntry) : mTimer->cancel());
     if (mStrand != NULL) chk.serializedExit();
     return (mStrand != NULL ? 1 : ncancelled);
 }
 Duration IOTimer::expiresFromNow() {
+    if (mWheel != NULL)
+        return mWheel->expiresFromNow(mWheelEntry);
     return Duration::microseconds(mTimer->expires_from_now().total_microseconds());
 }
 } // namespace Network
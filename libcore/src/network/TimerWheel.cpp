@@ -0,0 +1,306 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/network/TimerWheel.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/Asio.hpp>
+#include <sirikata/core/util/Timer.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+namespace {
+const uint64 Level0Mask = (1 << TimerWheel::Level0Bits) - 1;
+const uint64 LevelMask = (1 << TimerWheel::LevelBits) - 1;
+// Timers further out than this are kept in the last slot of the coarsest
+// level and cascade back into it until they're within range.
+const uint64 MaxDelta = ((uint64)1 << (TimerWheel::Level0Bits + (TimerWheel::NumLevels-1)*TimerWheel::LevelBits)) - 1;
+}
+
+TimerWheel::Entry::Entry()
+ : mTick(0),
+   mExpiry(Time::null()),
+   mStrand(NULL),
+   mOneShot(false)
+{
+    prev = NULL;
+    next = NULL;
+}
+
+TimerWheel::Entry::~Entry() {
+    assert(!scheduled());
+}
+
+
+TimerWheel::TimerWheel(IOService* ios, const Duration& slack)
+ : mService(ios),
+   mSlack(slack),
+   mSlackMicroseconds(std::max(slack.toMicroseconds(), (int64)1)),
+   mStart(Timer::now()),
+   mGuard(new DeadlineGuard()),
+   mNextTick(0),
+   mCount(0),
+   mDeadline(new DeadlineTimer(ios)),
+   mArmed(false),
+   mArmedTick(0)
+{
+    mGuard->wheel = this;
+    for(uint32 i = 0; i < (1 << Level0Bits); i++)
+        mLevel0[i].prev = mLevel0[i].next = &mLevel0[i];
+    for(uint32 level = 0; level < NumLevels-1; level++) {
+        for(uint32 i = 0; i < (1 << LevelBits); i++)
+            mLevels[level][i].prev = mLevels[level][i].next = &mLevels[level][i];
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    // A deadline that already fired may still be waiting to run, so
+    // cancelling isn't enough to keep its handler away from the wheel
+    {
+        LockGuard guard_lock(mGuard->mutex);
+        mGuard->wheel = NULL;
+    }
+
+    LockGuard lock(mMutex);
+    mDeadline->cancel();
+    delete mDeadline;
+
+    // Owners should have cancelled their timers already, but one shot timers
+    // are ours to clean up.
+    std::vector<Link*> heads;
+    for(uint32 i = 0; i < (1 << Level0Bits); i++)
+        heads.push_back(&mLevel0[i]);
+    for(uint32 level = 0; level < NumLevels-1; level++) {
+        for(uint32 i = 0; i < (1 << LevelBits); i++)
+            heads.push_back(&mLevels[level][i]);
+    }
+    for(uint32 i = 0; i < heads.size(); i++) {
+        while(heads[i]->next != heads[i]) {
+            Entry* timer = static_cast<Entry*>(heads[i]->next);
+            remove(timer);
+            if (timer->mOneShot) delete timer;
+        }
+    }
+}
+
+uint32 TimerWheel::size() const {
+    LockGuard lock(mMutex);
+    return mCount;
+}
+
+uint64 TimerWheel::tickAt(const Time& t) const {
+    int64 us = (t - mStart).toMicroseconds();
+    if (us <= 0) return 0;
+    return (uint64)us / mSlackMicroseconds;
+}
+
+void TimerWheel::insert(Entry* timer) {
+    uint64 tick = std::max(timer->mTick, mNextTick);
+    uint64 delta = tick - mNextTick;
+    Link* slot = NULL;
+    if (delta <= Level0Mask) {
+        slot = &mLevel0[tick & Level0Mask];
+    }
+    else {
+        if (delta > MaxDelta) {
+            tick = mNextTick + MaxDelta;
+            delta = MaxDelta;
+        }
+        uint32 level = 0;
+        uint32 shift = Level0Bits;
+        while(delta >> (shift + LevelBits) != 0) {
+            level++;
+            shift += LevelBits;
+        }
+        slot = &mLevels[level][(tick >> shift) & LevelMask];
+    }
+
+    timer->prev = slot->prev;
+    timer->next = slot;
+    slot->prev->next = timer;
+    slot->prev = timer;
+    mCount++;
+}
+
+void TimerWheel::remove(Entry* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+    mCount--;
+}
+
+uint32 TimerWheel::cascade(uint32 level, uint32 index) {
+    Link* head = &mLevels[level][index];
+    // Detach the list first since timers may be reinserted into the same slot
+    // if they're still out of range
+    if (head->next == head) return index;
+    Link* first = head->next;
+    head->prev->next = NULL;
+    head->prev = head->next = head;
+    while(first != NULL) {
+        Entry* timer = static_cast<Entry*>(first);
+        first = first->next;
+        mCount--;
+        insert(timer);
+    }
+    return index;
+}
+
+uint64 TimerWheel::nextWakeTick() const {
+    // We have to wake up by the next cascade to move timers down from the
+    // coarser levels, so we only need to look for timers in level 0 until
+    // then.
+    uint64 boundary = (mNextTick | Level0Mask) + 1;
+    for(uint64 tick = mNextTick; tick < boundary; tick++) {
+        const Link* slot = &mLevel0[tick & Level0Mask];
+        if (slot->next != slot)
+            return tick;
+    }
+    return boundary;
+}
+
+void TimerWheel::arm(uint64 tick) {
+    Time deadline = mStart + Duration::microseconds((int64)tick * mSlackMicroseconds);
+    Duration wait = deadline - Timer::now();
+    if (wait < Duration::zero()) wait = Duration::zero();
+    mDeadline->expires_from_now(boost::posix_time::microseconds(wait.toMicroseconds()));
+    mDeadline->async_wait(
+        boost::bind(&TimerWheel::handleDeadline, boost::asio::placeholders::error, mGuard)
+    );
+    mArmed = true;
+    mArmedTick = tick;
+}
+
+uint32 TimerWheel::schedule(Entry* timer, const Duration& timeout, const IOCallback& cb, IOStrand* strand) {
+    Time now = Timer::now();
+
+    LockGuard lock(mMutex);
+    uint32 cancelled = 0;
+    if (timer->scheduled()) {
+        remove(timer);
+        cancelled = 1;
+    }
+    // With nothing scheduled there's no need to step through the ticks that
+    // have passed since we last expired timers.
+    if (mCount == 0)
+        mNextTick = std::max(mNextTick, tickAt(now));
+
+    timer->mExpiry = now + timeout;
+    // Round up so timers never fire early
+    int64 us = (timer->mExpiry - mStart).toMicroseconds();
+    timer->mTick = (us <= 0 ? 0 : ((uint64)us + mSlackMicroseconds - 1) / mSlackMicroseconds);
+    timer->mCallback = cb;
+    timer->mStrand = strand;
+    insert(timer);
+
+    // Only timers in level 0 can be due before the next cascade
+    uint64 wake = std::min(std::max(timer->mTick, mNextTick), (mNextTick | Level0Mask) + 1);
+    if (!mArmed || wake < mArmedTick)
+        arm(wake);
+
+    return cancelled;
+}
+
+uint32 TimerWheel::cancel(Entry* timer) {
+    LockGuard lock(mMutex);
+    if (!timer->scheduled())
+        return 0;
+    remove(timer);
+    timer->mCallback = IOCallback();
+    // Don't hold up the IOService if nothing is left
+    if (mCount == 0 && mArmed) {
+        mDeadline->cancel();
+        mArmed = false;
+    }
+    return 1;
+}
+
+Duration TimerWheel::expiresFromNow(const Entry* timer) const {
+    LockGuard lock(mMutex);
+    return timer->mExpiry - Timer::now();
+}
+
+void TimerWheel::post(const Duration& timeout, const IOCallback& cb, IOStrand* strand) {
+    Entry* timer = new Entry();
+    timer->mOneShot = true;
+    schedule(timer, timeout, cb, strand);
+}
+
+void TimerWheel::expire(BatchMap& batches) {
+    uint64 now_tick = tickAt(Timer::now());
+    while(mNextTick <= now_tick) {
+        if (mCount == 0) {
+            mNextTick = now_tick + 1;
+            break;
+        }
+
+        uint32 index = (uint32)(mNextTick & Level0Mask);
+        if (index == 0) {
+            // Level 0 wrapped around, pull in the next set of timers
+            uint32 shift = Level0Bits;
+            for(uint32 level = 0; level < NumLevels-1; level++) {
+                if (cascade(level, (uint32)((mNextTick >> shift) & LevelMask)) != 0)
+                    break;
+                shift += LevelBits;
+            }
+        }
+
+        Link* head = &mLevel0[index];
+        while(head->next != head) {
+            Entry* timer = static_cast<Entry*>(head->next);
+            remove(timer);
+            Batch& batch = batches[timer->mStrand];
+            if (!batch.callbacks) {
+                batch.callbacks = CallbackListPtr(new CallbackList());
+                batch.handler = std::tr1::bind(&TimerWheel::runBatch, batch.callbacks);
+                // The wrapped handler doesn't refer to the IOStrand, so it
+                // can be posted after the lock is released even if the strand
+                // is destroyed in the meantime
+                if (timer->mStrand != NULL)
+                    batch.handler = timer->mStrand->wrap(batch.handler);
+            }
+            batch.callbacks->push_back(timer->mCallback);
+            if (timer->mOneShot)
+                delete timer;
+            else
+                timer->mCallback = IOCallback();
+        }
+        mNextTick++;
+    }
+}
+
+void TimerWheel::handleDeadline(const boost::system::error_code& error, DeadlineGuardPtr guard) {
+    LockGuard guard_lock(guard->mutex);
+    TimerWheel* wheel = guard->wheel;
+    // The wheel may be gone, either because its destructor cancelled us or
+    // because it was destroyed after we fired but before we ran
+    if (wheel == NULL || error == boost::asio::error::operation_aborted)
+        return;
+
+    BatchMap batches;
+    {
+        LockGuard lock(wheel->mMutex);
+        wheel->mArmed = false;
+        wheel->expire(batches);
+        if (wheel->mCount > 0)
+            wheel->arm(wheel->nextWakeTick());
+    }
+
+    for(BatchMap::iterator it = batches.begin(); it != batches.end(); it++)
+        wheel->mService->post(it->second.handler, "TimerWheel::runBatch");
+}
+
+void TimerWheel::runBatch(CallbackListPtr batch) {
+    for(uint32 i = 0; i < batch->size(); i++)
+        (*batch)[i]();
+}
+
+} // namespace Network
+} // namespace Sirikata
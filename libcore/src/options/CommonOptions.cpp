@@ -105,6 +105,9 @@ void InitOptions() {
 
 
         .addOption(new OptionValue(PROFILE, "false", Sirikata::OptionValueType<bool>(), "Whether to report profiling information."))
+        .addOption(new OptionValue(OPT_PROFILE_EVENT_QUEUES, "false", Sirikata::OptionValueType<bool>(), "Whether to start with event queue profiling enabled. It can also be switched at runtime with the context.profile-event-queues command."))
+        .addOption(new OptionValue(OPT_PROFILE_EVENT_QUEUES_SLOW, "100ms", Sirikata::OptionValueType<Duration>(), "Event handlers that run longer than this are logged while event queue profiling is enabled."))
+        .addOption(new OptionValue(OPT_PROFILE_EVENT_QUEUES_INTERVAL, "0s", Sirikata::OptionValueType<Duration>(), "How often to report event queue profiles to the TimeSeries while profiling is enabled. 0 disables reporting."))
 
         .addOption(new OptionValue(OPT_CDN_HOST,"open3dhub.com",Sirikata::OptionValueType<String>(), "Hostname for CDN server."))
 
@@ -119,6 +122,12 @@ void InitOptions() {
 
         .addOption(new OptionValue(OPT_COMMAND_COMMANDER, "", Sirikata::OptionValueType<String>(), "Commander service to start"))
         .addOption(new OptionValue(OPT_COMMAND_COMMANDER_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for the Commander service"))
+
+        .addOption(new OptionValue(OPT_IOSERVICE_POOL, "shared", Sirikata::OptionValueType<String>(), "How the main event processing threads are organized: 'shared' runs all threads over one event queue, 'per-thread' gives each thread its own queue and keeps strands on one thread."))
+        .addOption(new OptionValue(OPT_IOSERVICE_POOL_STEAL, "true", Sirikata::OptionValueType<bool>(), "With a per-thread pool, whether idle threads run handlers queued for other threads."))
+        .addOption(new OptionValue(OPT_IOSERVICE_POOL_CPUS, "", Sirikata::OptionValueType<String>(), "Comma separated list of CPUs, e.g. 0,2,4-7, to pin event processing threads to, in order. Empty leaves threads unpinned."))
+        .addOption(new OptionValue(OPT_IOSERVICE_TIMER_WHEEL, "false", Sirikata::OptionValueType<bool>(), "Whether to manage timers, including pollers and SST timers, with a hierarchical timer wheel instead of a deadline timer each."))
+        .addOption(new OptionValue(OPT_IOSERVICE_TIMER_WHEEL_SLACK, "1ms", Sirikata::OptionValueType<Duration>(), "Resolution of the timer wheel. Timers expiring within this much of each other fire together and may fire this much late."))
       ;
 }
 
@@ -37,6 +37,8 @@
 #include <boost/lexical_cast.hpp>
 #include <sirikata/core/service/Breakpad.hpp>
 #include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/service/Poller.hpp>
+#include <sirikata/core/network/IOServicePool.hpp>
 
 #define CTX_LOG(lvl, msg) SILOG(context, lvl, msg)
 
@@ -49,6 +51,8 @@ Context::Context(const String& name_, Network::IOService* ios, Network::IOStrand
    profiler(NULL),
    timeSeries(NULL),
    mFinishedTimer( Network::IOTimer::create(ios) ),
+   mEventQueueProfileReportInterval(Duration::zero()),
+   mEventQueueProfilePoller(NULL),
    mTrace(_trace),
    mCommander(NULL),
    mEpoch(epoch),
@@ -57,7 +61,8 @@ Context::Context(const String& name_, Network::IOService* ios, Network::IOStrand
    mKillThread(),
    mKillService(NULL),
    mKillTimer(),
-   mStopRequested(false)
+   mStopRequested(false),
+   mServicePool(NULL)
 {
     CTX_LOG(info, "Creating context");
   Breakpad::init();
@@ -66,6 +71,7 @@ Context::Context(const String& name_, Network::IOService* ios, Network::IOStrand
 
 Context::~Context() {
     CTX_LOG(info, "Destroying context");
+    delete mEventQueueProfilePoller;
     delete profiler;
 }
 
@@ -74,6 +80,16 @@ void Context::start() {
         std::tr1::bind(&Context::handleSignal, this, std::tr1::placeholders::_1)
     );
 
+    if (mEventQueueProfileReportInterval > Duration::zero()) {
+        mEventQueueProfilePoller = new Poller(
+            mainStrand,
+            std::tr1::bind(&Context::reportEventQueueProfiles, this),
+            "Context::reportEventQueueProfiles",
+            mEventQueueProfileReportInterval
+        );
+        mEventQueueProfilePoller->start();
+    }
+
     if (mSimDuration == Duration::zero())
         return;
 
@@ -93,6 +109,21 @@ void Context::run(uint32 nthreads, ExecutionThreads exthreads) {
 
     mExecutionThreadsType = exthreads;
 
+    if (mServicePool != NULL) {
+        assert(mServicePool->service() == ioService);
+        // The pool's threads exit once this work is removed in stop() and
+        // they've finished what's left.
+        mServicePool->startWork();
+        if (exthreads == IncludeOriginal) {
+            mServicePool->runIncludingCurrentThread();
+            cleanupWorkerThreads();
+        }
+        else {
+            mServicePool->run();
+        }
+        return;
+    }
+
     uint32 nworkers = (exthreads == IncludeOriginal ? nthreads-1 : nthreads);
     // Start workers
     for(uint32 i = 0; i < nworkers; i++) {
@@ -118,6 +149,11 @@ void Context::workerThread() {
 }
 
 void Context::cleanupWorkerThreads() {
+    if (mServicePool != NULL) {
+        mServicePool->join();
+        return;
+    }
+
     // Wait for workers to finish
     for(uint32 i = 0; i < mWorkerThreads.size(); i++) {
         mWorkerThreads[i]->join();
@@ -145,6 +181,10 @@ void Context::stop() {
     if (!mStopRequested.read()) {
         mStopRequested = true;
         mFinishedTimer.reset();
+        if (mEventQueueProfilePoller != NULL)
+            mEventQueueProfilePoller->stop();
+        if (mServicePool != NULL)
+            mServicePool->stopWork();
         startForceQuitTimer();
     }
 }
@@ -159,6 +199,20 @@ void Context::handleSignal(Signal::Type stype) {
     ioService->post( std::tr1::bind(&Context::shutdown, this), "Context::shutdown" );
 }
 
+void Context::forceQuit() {
+    SILOG(forcequit,fatal,"Fatal error: Quit forced by timeout.");
+    if (mServicePool != NULL)
+        mServicePool->stop();
+    else
+        ioService->stop();
+}
+
+void Context::reportEventQueueProfiles() {
+    if (timeSeries == NULL || !Network::EventQueueProfile::enabled())
+        return;
+    Network::IOService::reportAllProfilesTimeSeries(timeSeries, name + ".eventqueues");
+}
+
 void Context::cleanup() {
     Network::IOTimerPtr timer = mKillTimer;
 
@@ -208,6 +262,7 @@ void Context::setCommander(Command::Commander* c) {
         mCommander->unregisterCommand("context.shutdown");
         mCommander->unregisterCommand("context.report-stats");
         mCommander->unregisterCommand("context.report-all-stats");
+        mCommander->unregisterCommand("context.profile-event-queues");
     }
 
     mCommander = c;
@@ -226,6 +281,10 @@ void Context::setCommander(Command::Commander* c) {
             "context.report-all-stats",
             std::tr1::bind(&Network::IOService::commandReportAllStats, _1, _2, _3)
         );
+        mCommander->registerCommand(
+            "context.profile-event-queues",
+            std::tr1::bind(&Network::IOService::commandProfile, _1, _2, _3)
+        );
     }
 }
 
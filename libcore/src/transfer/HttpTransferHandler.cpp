@@ -13,6 +13,7 @@
 #include <sirikata/core/options/CommonOptions.hpp>
 #include <sirikata/core/jpeg-arhc/Compression.hpp>
 #include <sirikata/core/jpeg-arhc/Decoder.hpp>
+#include <sirikata/core/jpeg-arhc/MultiCompression.hpp>
 #include <boost/bind.hpp>
 #include <sirikata/core/transfer/HttpTransferHandler.hpp>
 #include <sirikata/core/transfer/URL.hpp>
@@ -20,9 +21,46 @@
 AUTO_SINGLETON_INSTANCE(Sirikata::Transfer::HttpNameHandler);
 AUTO_SINGLETON_INSTANCE(Sirikata::Transfer::HttpChunkHandler);
 
+// Number of compressed files that can be decoded concurrently
+#define HTTP_DECODE_THREADS 2
+// Worker threads used by each of those decodes
+#define HTTP_DECODE_WORKERS 2
+
 namespace Sirikata {
 namespace Transfer {
 
+namespace {
+
+bool isCompressed(const DenseData& data) {
+    if (data.length() == 0) return false;
+    return DecodeIs7z(data.data(), data.length()) || DecodeIsARHC(data.data(), data.length());
+}
+
+// Reads directly out of a DenseData, avoiding a copy of the compressed input
+class DenseDataReader : public DecoderReader {
+public:
+    DenseDataReader(DenseDataPtr data)
+     : mData(data),
+       mOffset(0)
+    {}
+
+    virtual std::pair<uint32, JpegError> Read(uint8* data, unsigned int size) {
+        size_t left = mData->length() - mOffset;
+        size_t nread = std::min(left, (size_t)size);
+        if (nread == 0)
+            return std::pair<uint32, JpegError>(0, JpegError::errEOF());
+        memcpy(data, mData->data() + mOffset, nread);
+        mOffset += nread;
+        return std::pair<uint32, JpegError>((uint32)nread, JpegError::nil());
+    }
+
+private:
+    DenseDataPtr mData;
+    size_t mOffset;
+};
+
+}
+
 HttpNameHandler& HttpNameHandler::getSingleton() {
     return AutoSingleton<HttpNameHandler>::getSingleton();
 }
@@ -138,9 +176,101 @@ void HttpNameHandler::request_finished(std::tr1::shared_ptr<HttpManager::HttpRes
 
 HttpChunkHandler::HttpChunkHandler()
 {
+    mDecodePool = new Network::IOServicePool("HttpChunkHandler Decode", HTTP_DECODE_THREADS);
+    mDecodePool->startWork();
+    mDecodePool->run();
 }
 
 HttpChunkHandler::~HttpChunkHandler() {
+    mDecodePool->stopWork();
+    mDecodePool->join();
+    delete mDecodePool;
+
+    for(std::vector<ThreadContext*>::iterator it = mIdleDecoders.begin(); it != mIdleDecoders.end(); it++)
+        DestroyThreadContext(*it);
+    mIdleDecoders.clear();
+}
+
+ThreadContext* HttpChunkHandler::acquireDecoder() {
+    {
+        boost::mutex::scoped_lock lock(mDecoderMutex);
+        if (!mIdleDecoders.empty()) {
+            ThreadContext* decoder = mIdleDecoders.back();
+            mIdleDecoders.pop_back();
+            return decoder;
+        }
+    }
+    // At most HTTP_DECODE_THREADS decodes run at once, so this only happens
+    // until each decode thread has created its own context.
+    return MakeThreadContext(HTTP_DECODE_WORKERS, JpegAllocator<uint8_t>());
+}
+
+void HttpChunkHandler::releaseDecoder(ThreadContext* decoder) {
+    boost::mutex::scoped_lock lock(mDecoderMutex);
+    mIdleDecoders.push_back(decoder);
+}
+
+bool HttpChunkHandler::addPendingRequest(const Fingerprint& fp, ChunkCallback callback) {
+    boost::mutex::scoped_lock lock(mPendingMutex);
+    ChunkCallbackList& waiting = mPendingRequests[fp];
+    waiting.push_back(callback);
+    return (waiting.size() == 1);
+}
+
+void HttpChunkHandler::finishRequest(std::tr1::shared_ptr<RemoteFileMetadata> file, DenseDataPtr data, bool add_to_cache) {
+    if (data && add_to_cache) {
+        SILOG(transfer, detailed, "about to call addToCache with fingerprint ID = " << file->getFingerprint().convertToHexString());
+        SharedChunkCache::getSingleton().getCache()->addToCache(file->getFingerprint(), data);
+    }
+
+    ChunkCallbackList waiting;
+    {
+        boost::mutex::scoped_lock lock(mPendingMutex);
+        PendingRequestMap::iterator it = mPendingRequests.find(file->getFingerprint());
+        if (it != mPendingRequests.end()) {
+            waiting.swap(it->second);
+            mPendingRequests.erase(it);
+        }
+    }
+    for(ChunkCallbackList::iterator it = waiting.begin(); it != waiting.end(); it++)
+        (*it)(data);
+}
+
+void HttpChunkHandler::decode(DenseDataPtr data, std::tr1::shared_ptr<RemoteFileMetadata> file) {
+    Time start = Timer::now();
+
+    bool is7z = DecodeIs7z(data->data(), data->length());
+    DenseDataReader input(data);
+    MemReadWriter output((JpegAllocator<uint8_t>()));
+    ThreadContext* decoder = acquireDecoder();
+    JpegError isDecompressOk = JpegError::nil();
+    if (is7z)
+        isDecompressOk = MultiDecompress7ZtoAny(input, output, decoder);
+    else
+        isDecompressOk = DecompressARHCtoJPEGMulti(input, output, decoder);
+    releaseDecoder(decoder);
+
+    DenseDataPtr result = data;
+    if (isDecompressOk == JpegError::nil() && !output.buffer().empty()) {
+        result = DenseDataPtr(new DenseData(Range(data->startbyte(),
+                                                  output.buffer().size(),
+                                                  Transfer::LENGTH,
+                                                  data->goesToEndOfFile()),
+                                            (const char*)&output.buffer()[0]));
+    }
+    else {
+        SILOG(transfer, warn, "Failed to decode compressed data for " << file->getURI() << ", using it as is");
+    }
+
+    mDecodeStats.decoded++;
+    mDecodeStats.decodeMicroseconds += (uint64)(Timer::now() - start).toMicroseconds();
+
+    // Deliver results from the HttpManager's threads, where callbacks have
+    // always been invoked.
+    HttpManager::getSingleton().postCallback(
+        std::tr1::bind(&HttpChunkHandler::finishRequest, this, file, result, true),
+        "HttpChunkHandler::finishRequest"
+    );
 }
 
 void HttpChunkHandler::get(std::tr1::shared_ptr<RemoteFileMetadata> file,
@@ -182,9 +312,22 @@ void HttpChunkHandler::cache_check_callback(const SparseData* data, std::tr1::sh
             std::tr1::shared_ptr<Chunk> chunk, ChunkCallback callback) {
     if (data) {
         mStats.downloaded++;
-        std::tr1::shared_ptr<const DenseData> flattened = data->flatten();
-        callback(flattened);
+        DenseDataPtr flattened = data->flatten();
+        // Name lookups cache the raw response, so the cached copy may still
+        // need to be decoded. The decoded version replaces it in the cache.
+        if (!isCompressed(*flattened)) {
+            callback(flattened);
+            return;
+        }
+        if (addPendingRequest(file->getFingerprint(), callback))
+            mDecodePool->service()->post(
+                std::tr1::bind(&HttpChunkHandler::decode, this, flattened, file),
+                "HttpChunkHandler::decode"
+            );
     } else {
+        if (!addPendingRequest(file->getFingerprint(), callback))
+            return;
+
         URL url(file->getURI());
         assert(!url.empty());
 
@@ -199,7 +342,7 @@ void HttpChunkHandler::cache_check_callback(const SparseData* data, std::tr1::sh
 
         HttpManager::getSingleton().get(
             cdn_addr, url.fullpath(),
-            std::tr1::bind(&HttpChunkHandler::request_finished, this, _1, _2, _3, file, chunk, callback),
+            std::tr1::bind(&HttpChunkHandler::request_finished, this, _1, _2, _3, file, chunk),
             headers
         );
     }
@@ -207,8 +350,7 @@ void HttpChunkHandler::cache_check_callback(const SparseData* data, std::tr1::sh
 
 void HttpChunkHandler::request_finished(std::tr1::shared_ptr<HttpManager::HttpResponse> response,
         HttpManager::ERR_TYPE error, const boost::system::error_code& boost_error,
-        std::tr1::shared_ptr<RemoteFileMetadata> file, std::tr1::shared_ptr<Chunk> chunk,
-        ChunkCallback callback) {
+        std::tr1::shared_ptr<RemoteFileMetadata> file, std::tr1::shared_ptr<Chunk> chunk) {
 
     mStats.downloaded++;
     if (response) mStats.bytesTransferred += (response->getBytesSent() + response->getBytesReceived());
@@ -218,77 +360,50 @@ void HttpChunkHandler::request_finished(std::tr1::shared_ptr<HttpManager::HttpRe
 
     if (error == Transfer::HttpManager::REQUEST_PARSING_FAILED) {
         SILOG(transfer, error, "Request parsing failed during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     } else if (error == Transfer::HttpManager::RESPONSE_PARSING_FAILED) {
         SILOG(transfer, error, "Response parsing failed during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     } else if (error == Transfer::HttpManager::BOOST_ERROR) {
         SILOG(transfer, error, "A boost error happened during an HTTP " << reqType << ". Boost error = " << boost_error.message() << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     } else if (error != HttpManager::SUCCESS) {
         SILOG(transfer, error, "An unknown error happened during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     }
 
     if (response->getHeaders().size() == 0) {
         SILOG(transfer, error, "There were no headers returned during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     }
 
 
     if (response->getStatusCode() != 200) {
         SILOG(transfer, error, "HTTP status code = " << response->getStatusCode() << " instead of 200 during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     }
 
     if (!response->getData()) {
         SILOG(transfer, error, "Body not present during an HTTP " << reqType << " (" << file->getURI() << ")");
-        callback(bad);
+        finishRequest(file, bad, false);
         return;
     }
-    bool is7z = false;
-    bool isArhc = false;
-    if (response->getData()->length()) {
-        is7z = DecodeIs7z(response->getData()->data(),
-                          response->getData()->length());
-        isArhc = DecodeIsARHC(response->getData()->data(),
-                              response->getData()->length());
+    DenseDataPtr data = response->getData();
+    if (isCompressed(*data)) {
+        mDecodePool->service()->post(
+            std::tr1::bind(&HttpChunkHandler::decode, this, data, file),
+            "HttpChunkHandler::decode"
+        );
     }
-
-    std::tr1::shared_ptr<DenseData> uncompressedFile = response->getData();
-    if (is7z || isArhc) {
-        JpegAllocator<uint8_t> alloc;
-        MemReadWriter input(alloc);
-        input.Write(response->getData()->data(), response->getData()->length());
-        MemReadWriter output(alloc);
-        JpegError isDecompressOk = JpegError::nil();
-        if (is7z) {
-            isDecompressOk = Decompress7ZtoAny(input, output, alloc);
-        }
-        if (isArhc) {
-            isDecompressOk = DecompressARHCtoJPEG(input, output, alloc);
-        }
-        if (isDecompressOk == JpegError::nil()) {
-            std::tr1::shared_ptr<DenseData> uncData(new DenseData(Range(response->getData()->startbyte(),
-                                                                        output.buffer().size(),
-                                                                        Transfer::LENGTH,
-                                                                        response->getData()->goesToEndOfFile()),
-                                                                  std::vector<uint8_t>(output.buffer().begin(),
-                                                                                    output.buffer().end())));
-            uncompressedFile = uncData;
-        }
+    else {
+        finishRequest(file, data, true);
     }
-
-    SILOG(transfer, detailed, "about to call addToCache with fingerprint ID = " << file->getFingerprint().convertToHexString());
-    SharedChunkCache::getSingleton().getCache()->addToCache(file->getFingerprint(), uncompressedFile);
-
-    callback(uncompressedFile);
     SILOG(transfer, detailed, "done http chunk handler request_finished");
 }
 
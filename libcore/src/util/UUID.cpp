@@ -129,6 +129,30 @@ size_t UUID::hash() const {
     return seed;
 }
 
+namespace {
+// 64-bit finalizer from MurmurHash3
+inline uint64 mix64(uint64 k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+}
+
+size_t UUID::hash(const UUID& first, const UUID& second) {
+    const uint64* a = (const uint64*)first.getArray().data();
+    const uint64* b = (const uint64*)second.getArray().data();
+    // Chaining the words through the mixer (rather than combining
+    // independently hashed UUIDs with xor) keeps the result order dependent.
+    uint64 h = mix64(a[0]);
+    h = mix64(h ^ a[1]);
+    h = mix64(h ^ b[0]);
+    h = mix64(h ^ b[1]);
+    return (size_t)h;
+}
+
 uint32 UUID::asUInt32() const {
     return ntohl(*((int32*)mData.data()));
 }
@@ -0,0 +1,793 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "BinaryModelSystem.hpp"
+#include <sirikata/mesh/Meshdata.hpp>
+#include <boost/static_assert.hpp>
+#include <fstream>
+#include <cmath>
+
+#define BINMESH_LOG(lvl,msg) SILOG(mesh-binary, lvl, msg)
+
+// Bulk arrays of vectors are copied directly, which requires them to be
+// tightly packed.
+BOOST_STATIC_ASSERT(sizeof(Sirikata::Vector3f) == 3*sizeof(float));
+BOOST_STATIC_ASSERT(sizeof(Sirikata::Vector4f) == 4*sizeof(float));
+
+namespace Sirikata {
+
+const uint32 BinaryModelSystem::FORMAT_VERSION = 1;
+
+namespace {
+
+// File layout:
+//   8 bytes  magic
+//   uint32   format version
+//   uint32   byte order marker, written in host order
+//   uint32   encoding flags
+//   ...      Meshdata body
+// All values are written in host byte order; files with a mismatched byte
+// order marker are rejected rather than swapped.
+const char MAGIC[8] = { 'S', 'I', 'R', 'B', 'M', 'E', 'S', 'H' };
+const uint32 BYTE_ORDER_MARKER = 0x01020304;
+
+enum EncodingFlags {
+    QUANTIZED_POSITIONS = 1,
+    QUANTIZED_NORMALS = 2,
+    DELTA_INDICES = 4
+};
+const uint32 KNOWN_FLAGS = QUANTIZED_POSITIONS | QUANTIZED_NORMALS | DELTA_INDICES;
+
+const uint32 HEADER_SIZE = sizeof(MAGIC) + 3*sizeof(uint32);
+
+class Writer {
+public:
+    Writer(std::string& out)
+     : mOut(out)
+    {}
+
+    template<typename T>
+    void pod(const T& v) {
+        raw(&v, sizeof(T));
+    }
+    void raw(const void* data, size_t len) {
+        mOut.append((const char*)data, len);
+    }
+
+    void u8(uint8 v) { pod(v); }
+    void u32(uint32 v) { pod(v); }
+    void u64(uint64 v) { pod(v); }
+    void i32(int32 v) { pod(v); }
+    void f32(float32 v) { pod(v); }
+    void f64(float64 v) { pod(v); }
+
+    void str(const String& s) {
+        u32((uint32)s.size());
+        raw(s.data(), s.size());
+    }
+    void vec3(const Vector3f& v) {
+        f32(v.x); f32(v.y); f32(v.z);
+    }
+    void vec4(const Vector4f& v) {
+        f32(v.x); f32(v.y); f32(v.z); f32(v.w);
+    }
+    void matrix(const Matrix4x4f& m) {
+        for(uint32 r = 0; r < 4; r++)
+            for(uint32 c = 0; c < 4; c++)
+                f32(m(r, c));
+    }
+    void matrices(const std::vector<Matrix4x4f>& ms) {
+        u32((uint32)ms.size());
+        for(uint32 i = 0; i < ms.size(); i++)
+            matrix(ms[i]);
+    }
+
+    template<typename T>
+    void array(const std::vector<T>& v) {
+        u32((uint32)v.size());
+        if (!v.empty())
+            raw(&v[0], v.size() * sizeof(T));
+    }
+
+    void varint(uint32 v) {
+        while(v >= 0x80) {
+            u8((uint8)(v | 0x80));
+            v >>= 7;
+        }
+        u8((uint8)v);
+    }
+
+private:
+    std::string& mOut;
+};
+
+class Reader {
+public:
+    Reader(const uint8* data, uint64 size)
+     : mPos(data),
+       mEnd(data + size),
+       mOK(true)
+    {}
+
+    bool ok() const { return mOK; }
+    bool done() const { return mPos == mEnd; }
+
+    template<typename T>
+    T pod() {
+        T v = T();
+        raw(&v, sizeof(T));
+        return v;
+    }
+    void raw(void* dest, uint64 len) {
+        if (!need(len)) return;
+        memcpy(dest, mPos, len);
+        mPos += len;
+    }
+
+    uint8 u8() { return pod<uint8>(); }
+    uint32 u32() { return pod<uint32>(); }
+    uint64 u64() { return pod<uint64>(); }
+    int32 i32() { return pod<int32>(); }
+    float32 f32() { return pod<float32>(); }
+    float64 f64() { return pod<float64>(); }
+
+    String str() {
+        uint32 len = u32();
+        if (!need(len)) return String();
+        String s((const char*)mPos, len);
+        mPos += len;
+        return s;
+    }
+    Vector3f vec3() {
+        float32 x = f32(), y = f32(), z = f32();
+        return Vector3f(x, y, z);
+    }
+    Vector4f vec4() {
+        float32 x = f32(), y = f32(), z = f32(), w = f32();
+        return Vector4f(x, y, z, w);
+    }
+    Matrix4x4f matrix() {
+        Matrix4x4f m;
+        for(uint32 r = 0; r < 4; r++)
+            for(uint32 c = 0; c < 4; c++)
+                m(r, c) = f32();
+        return m;
+    }
+    void matrices(std::vector<Matrix4x4f>* ms) {
+        uint32 count = u32();
+        if (!need((uint64)count * 16 * sizeof(float32))) return;
+        ms->resize(count);
+        for(uint32 i = 0; i < count; i++)
+            (*ms)[i] = matrix();
+    }
+
+    // Reads an array written by Writer::array with a single copy.
+    template<typename T>
+    void array(std::vector<T>* v) {
+        uint32 count = u32();
+        if (!need((uint64)count * sizeof(T))) return;
+        v->resize(count);
+        if (count > 0)
+            raw(&(*v)[0], (uint64)count * sizeof(T));
+    }
+
+    // Reads a count, failing if it can't possibly be satisfied by the
+    // remaining data given each element takes at least min_elem_size bytes.
+    uint32 count(uint32 min_elem_size) {
+        uint32 c = u32();
+        if (!need((uint64)c * min_elem_size)) return 0;
+        return c;
+    }
+
+    uint32 varint() {
+        uint32 result = 0;
+        for(uint32 shift = 0; shift < 35; shift += 7) {
+            if (!need(1)) return 0;
+            uint8 b = *mPos++;
+            result |= (uint32)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return result;
+        }
+        mOK = false;
+        return 0;
+    }
+
+private:
+    bool need(uint64 len) {
+        if (!mOK || len > (uint64)(mEnd - mPos)) {
+            mOK = false;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8* mPos;
+    const uint8* mEnd;
+    bool mOK;
+};
+
+
+// Positions are quantized to 16 bits per component relative to the bounds
+// of the positions themselves.
+void writeQuantizedPositions(Writer& w, const std::vector<Vector3f>& positions) {
+    w.u32((uint32)positions.size());
+    if (positions.empty()) return;
+
+    Vector3f pmin = positions[0], pmax = positions[0];
+    for(uint32 i = 1; i < positions.size(); i++) {
+        pmin = pmin.min(positions[i]);
+        pmax = pmax.max(positions[i]);
+    }
+    Vector3f extent = pmax - pmin;
+    Vector3f scale(extent.x / 65535.f, extent.y / 65535.f, extent.z / 65535.f);
+    w.vec3(pmin);
+    w.vec3(scale);
+
+    std::vector<uint16> quantized(positions.size() * 3);
+    for(uint32 i = 0; i < positions.size(); i++) {
+        for(uint32 c = 0; c < 3; c++) {
+            float32 q = (scale[c] > 0.f) ? (positions[i][c] - pmin[c]) / scale[c] : 0.f;
+            quantized[i*3+c] = (uint16)std::min(65535.f, std::max(0.f, q + 0.5f));
+        }
+    }
+    w.raw(&quantized[0], quantized.size() * sizeof(uint16));
+}
+
+void readQuantizedPositions(Reader& r, std::vector<Vector3f>* positions) {
+    uint32 count = r.count(3 * sizeof(uint16));
+    if (count == 0) return;
+
+    Vector3f pmin = r.vec3();
+    Vector3f scale = r.vec3();
+    std::vector<uint16> quantized(count * 3);
+    r.raw(&quantized[0], quantized.size() * sizeof(uint16));
+    if (!r.ok()) return;
+
+    positions->resize(count);
+    for(uint32 i = 0; i < count; i++) {
+        (*positions)[i] = Vector3f(
+            pmin.x + quantized[i*3+0] * scale.x,
+            pmin.y + quantized[i*3+1] * scale.y,
+            pmin.z + quantized[i*3+2] * scale.z
+        );
+    }
+}
+
+float32 signNotZero(float32 v) {
+    return (v >= 0.f) ? 1.f : -1.f;
+}
+
+int16 snorm16(float32 v) {
+    return (int16)std::floor(std::min(1.f, std::max(-1.f, v)) * 32767.f + 0.5f);
+}
+
+// Normals are stored as octahedral coordinates, two signed 16-bit values
+// per normal.
+void writeQuantizedNormals(Writer& w, const std::vector<Vector3f>& normals) {
+    w.u32((uint32)normals.size());
+    if (normals.empty()) return;
+
+    std::vector<int16> quantized(normals.size() * 2);
+    for(uint32 i = 0; i < normals.size(); i++) {
+        const Vector3f& n = normals[i];
+        float32 l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        float32 ox = 0.f, oy = 0.f;
+        if (l1 > 0.f) {
+            ox = n.x / l1;
+            oy = n.y / l1;
+            if (n.z < 0.f) {
+                float32 fx = (1.f - std::fabs(oy)) * signNotZero(ox);
+                float32 fy = (1.f - std::fabs(ox)) * signNotZero(oy);
+                ox = fx; oy = fy;
+            }
+        }
+        quantized[i*2+0] = snorm16(ox);
+        quantized[i*2+1] = snorm16(oy);
+    }
+    w.raw(&quantized[0], quantized.size() * sizeof(int16));
+}
+
+void readQuantizedNormals(Reader& r, std::vector<Vector3f>* normals) {
+    uint32 count = r.count(2 * sizeof(int16));
+    if (count == 0) return;
+
+    std::vector<int16> quantized(count * 2);
+    r.raw(&quantized[0], quantized.size() * sizeof(int16));
+    if (!r.ok()) return;
+
+    normals->resize(count);
+    for(uint32 i = 0; i < count; i++) {
+        float32 x = quantized[i*2+0] / 32767.f;
+        float32 y = quantized[i*2+1] / 32767.f;
+        float32 z = 1.f - std::fabs(x) - std::fabs(y);
+        if (z < 0.f) {
+            float32 fx = (1.f - std::fabs(y)) * signNotZero(x);
+            float32 fy = (1.f - std::fabs(x)) * signNotZero(y);
+            x = fx; y = fy;
+        }
+        Vector3f n(x, y, z);
+        float32 len = n.length();
+        (*normals)[i] = (len > 0.f) ? n / len : n;
+    }
+}
+
+// Indices within a primitive are usually close to their predecessor, so we
+// store zigzag coded deltas as varints, which takes a single byte for most
+// indices.
+void writeDeltaIndices(Writer& w, const std::vector<unsigned short>& indices) {
+    w.u32((uint32)indices.size());
+    int32 prev = 0;
+    for(uint32 i = 0; i < indices.size(); i++) {
+        int32 delta = (int32)indices[i] - prev;
+        w.varint(((uint32)delta << 1) ^ (uint32)(delta >> 31));
+        prev = indices[i];
+    }
+}
+
+void readDeltaIndices(Reader& r, std::vector<unsigned short>* indices) {
+    uint32 count = r.count(1);
+    indices->resize(count);
+    int32 prev = 0;
+    for(uint32 i = 0; i < count && r.ok(); i++) {
+        uint32 zz = r.varint();
+        int32 delta = (int32)(zz >> 1) ^ -(int32)(zz & 1);
+        prev += delta;
+        (*indices)[i] = (unsigned short)prev;
+    }
+}
+
+
+void writeSkinController(Writer& w, const Mesh::SkinController& sc) {
+    w.array(sc.joints);
+    w.matrix(sc.bindShapeMatrix);
+    w.array(sc.weightStartIndices);
+    w.array(sc.weights);
+    w.array(sc.jointIndices);
+    w.matrices(sc.inverseBindMatrices);
+}
+
+void readSkinController(Reader& r, Mesh::SkinController* sc) {
+    r.array(&sc->joints);
+    sc->bindShapeMatrix = r.matrix();
+    r.array(&sc->weightStartIndices);
+    r.array(&sc->weights);
+    r.array(&sc->jointIndices);
+    r.matrices(&sc->inverseBindMatrices);
+}
+
+void writeGeometry(Writer& w, const Mesh::SubMeshGeometry& geo, uint32 flags) {
+    w.str(geo.name);
+
+    if (flags & QUANTIZED_POSITIONS)
+        writeQuantizedPositions(w, geo.positions);
+    else
+        w.array(geo.positions);
+    if (flags & QUANTIZED_NORMALS)
+        writeQuantizedNormals(w, geo.normals);
+    else
+        w.array(geo.normals);
+    w.array(geo.tangents);
+    w.array(geo.colors);
+
+    w.u32((uint32)geo.texUVs.size());
+    for(uint32 i = 0; i < geo.texUVs.size(); i++) {
+        w.u32(geo.texUVs[i].stride);
+        w.array(geo.texUVs[i].uvs);
+    }
+
+    w.u32((uint32)geo.primitives.size());
+    for(uint32 i = 0; i < geo.primitives.size(); i++) {
+        const Mesh::SubMeshGeometry::Primitive& prim = geo.primitives[i];
+        w.u32((uint32)prim.primitiveType);
+        w.u64((uint64)prim.materialId);
+        if (flags & DELTA_INDICES)
+            writeDeltaIndices(w, prim.indices);
+        else
+            w.array(prim.indices);
+    }
+
+    w.vec3(geo.aabb.min());
+    w.vec3(geo.aabb.max());
+    w.f64(geo.radius);
+
+    w.u32((uint32)geo.skinControllers.size());
+    for(uint32 i = 0; i < geo.skinControllers.size(); i++)
+        writeSkinController(w, geo.skinControllers[i]);
+}
+
+void readGeometry(Reader& r, Mesh::SubMeshGeometry* geo, uint32 flags) {
+    geo->name = r.str();
+
+    if (flags & QUANTIZED_POSITIONS)
+        readQuantizedPositions(r, &geo->positions);
+    else
+        r.array(&geo->positions);
+    if (flags & QUANTIZED_NORMALS)
+        readQuantizedNormals(r, &geo->normals);
+    else
+        r.array(&geo->normals);
+    r.array(&geo->tangents);
+    r.array(&geo->colors);
+
+    geo->texUVs.resize(r.count(2*sizeof(uint32)));
+    for(uint32 i = 0; i < geo->texUVs.size(); i++) {
+        geo->texUVs[i].stride = r.u32();
+        r.array(&geo->texUVs[i].uvs);
+    }
+
+    geo->primitives.resize(r.count(sizeof(uint32)+sizeof(uint64)+sizeof(uint32)));
+    for(uint32 i = 0; i < geo->primitives.size(); i++) {
+        Mesh::SubMeshGeometry::Primitive& prim = geo->primitives[i];
+        prim.primitiveType = (Mesh::SubMeshGeometry::Primitive::PrimitiveType)r.u32();
+        prim.materialId = (Mesh::SubMeshGeometry::Primitive::MaterialId)r.u64();
+        if (flags & DELTA_INDICES)
+            readDeltaIndices(r, &prim.indices);
+        else
+            r.array(&prim.indices);
+    }
+
+    Vector3f bmin = r.vec3();
+    Vector3f bmax = r.vec3();
+    geo->aabb = BoundingBox3f3f(bmin, bmax);
+    geo->radius = r.f64();
+
+    geo->skinControllers.resize(r.count(sizeof(uint32)));
+    for(uint32 i = 0; i < geo->skinControllers.size(); i++)
+        readSkinController(r, &geo->skinControllers[i]);
+}
+
+void writeLight(Writer& w, const LightInfo& light) {
+    w.i32(light.mWhichFields);
+    w.vec3(light.mDiffuseColor);
+    w.vec3(light.mSpecularColor);
+    w.f32(light.mPower);
+    w.vec3(light.mAmbientColor);
+    w.vec3(light.mShadowColor);
+    w.f64(light.mLightRange);
+    w.f32(light.mConstantFalloff);
+    w.f32(light.mLinearFalloff);
+    w.f32(light.mQuadraticFalloff);
+    w.f32(light.mConeInnerRadians);
+    w.f32(light.mConeOuterRadians);
+    w.f32(light.mConeFalloff);
+    w.u32((uint32)light.mType);
+    w.u8(light.mCastsShadow ? 1 : 0);
+}
+
+void readLight(Reader& r, LightInfo* light) {
+    light->mWhichFields = r.i32();
+    light->mDiffuseColor = r.vec3();
+    light->mSpecularColor = r.vec3();
+    light->mPower = r.f32();
+    light->mAmbientColor = r.vec3();
+    light->mShadowColor = r.vec3();
+    light->mLightRange = r.f64();
+    light->mConstantFalloff = r.f32();
+    light->mLinearFalloff = r.f32();
+    light->mQuadraticFalloff = r.f32();
+    light->mConeInnerRadians = r.f32();
+    light->mConeOuterRadians = r.f32();
+    light->mConeFalloff = r.f32();
+    light->mType = (LightInfo::LightTypes)r.u32();
+    light->mCastsShadow = (r.u8() != 0);
+}
+
+void writeMaterial(Writer& w, const Mesh::MaterialEffectInfo& mat) {
+    w.u32((uint32)mat.textures.size());
+    for(uint32 i = 0; i < mat.textures.size(); i++) {
+        const Mesh::MaterialEffectInfo::Texture& tex = mat.textures[i];
+        w.str(tex.uri);
+        w.vec4(tex.color);
+        w.u64((uint64)tex.texCoord);
+        w.u32((uint32)tex.affecting);
+        w.u32((uint32)tex.samplerType);
+        w.u32((uint32)tex.minFilter);
+        w.u32((uint32)tex.magFilter);
+        w.u32((uint32)tex.wrapS);
+        w.u32((uint32)tex.wrapT);
+        w.u32((uint32)tex.wrapU);
+        w.u32(tex.maxMipLevel);
+        w.f32(tex.mipBias);
+    }
+    w.f32(mat.shininess);
+    w.f32(mat.reflectivity);
+}
+
+void readMaterial(Reader& r, Mesh::MaterialEffectInfo* mat) {
+    typedef Mesh::MaterialEffectInfo::Texture Texture;
+    mat->textures.resize(r.count(sizeof(uint32)));
+    for(uint32 i = 0; i < mat->textures.size(); i++) {
+        Texture& tex = mat->textures[i];
+        tex.uri = r.str();
+        tex.color = r.vec4();
+        tex.texCoord = (size_t)r.u64();
+        tex.affecting = (Texture::Affecting)r.u32();
+        tex.samplerType = (Texture::SamplerType)r.u32();
+        tex.minFilter = (Texture::SamplerFilter)r.u32();
+        tex.magFilter = (Texture::SamplerFilter)r.u32();
+        tex.wrapS = (Texture::WrapMode)r.u32();
+        tex.wrapT = (Texture::WrapMode)r.u32();
+        tex.wrapU = (Texture::WrapMode)r.u32();
+        tex.maxMipLevel = r.u32();
+        tex.mipBias = r.f32();
+    }
+    mat->shininess = r.f32();
+    mat->reflectivity = r.f32();
+}
+
+void writeNode(Writer& w, const Mesh::Node& node) {
+    w.u8(node.containsInstanceController ? 1 : 0);
+    w.i32(node.parent);
+    w.matrix(node.transform);
+    w.array(node.children);
+    w.array(node.instanceChildren);
+    w.u32((uint32)node.animations.size());
+    for(Mesh::Node::AnimationMap::const_iterator it = node.animations.begin(); it != node.animations.end(); it++) {
+        w.str(it->first);
+        w.array(it->second.inputs);
+        w.matrices(it->second.outputs);
+    }
+}
+
+void readNode(Reader& r, Mesh::Node* node) {
+    node->containsInstanceController = (r.u8() != 0);
+    node->parent = r.i32();
+    node->transform = r.matrix();
+    r.array(&node->children);
+    r.array(&node->instanceChildren);
+    uint32 nanims = r.count(3*sizeof(uint32));
+    for(uint32 i = 0; i < nanims && r.ok(); i++) {
+        String name = r.str();
+        Mesh::TransformationKeyFrames& frames = node->animations[name];
+        r.array(&frames.inputs);
+        r.matrices(&frames.outputs);
+    }
+}
+
+void writeProgressiveData(Writer& w, const Mesh::ProgressiveDataPtr& prog) {
+    w.u8(prog ? 1 : 0);
+    if (!prog) return;
+
+    w.raw(prog->progressiveHash.rawData().data(), SHA256::static_size);
+    w.u32(prog->numProgressiveTriangles);
+    w.u32((uint32)prog->mipmaps.size());
+    for(Mesh::ProgressiveMipmapMap::const_iterator it = prog->mipmaps.begin(); it != prog->mipmaps.end(); it++) {
+        const Mesh::ProgressiveMipmapArchive& archive = it->second;
+        w.str(it->first);
+        w.str(archive.name);
+        w.raw(archive.archiveHash.rawData().data(), SHA256::static_size);
+        w.u32((uint32)archive.mipmaps.size());
+        for(Mesh::ProgressiveMipmaps::const_iterator mit = archive.mipmaps.begin(); mit != archive.mipmaps.end(); mit++) {
+            w.u32(mit->first);
+            w.u32(mit->second.offset);
+            w.u32(mit->second.length);
+            w.u32(mit->second.width);
+            w.u32(mit->second.height);
+        }
+    }
+}
+
+SHA256 readHash(Reader& r) {
+    unsigned char digest[SHA256::static_size];
+    memset(digest, 0, SHA256::static_size);
+    r.raw(digest, SHA256::static_size);
+    return SHA256::convertFromBinary(digest);
+}
+
+void readProgressiveData(Reader& r, Mesh::ProgressiveDataPtr* prog_out) {
+    if (r.u8() == 0) return;
+
+    Mesh::ProgressiveDataPtr prog(new Mesh::ProgressiveData());
+    prog->progressiveHash = readHash(r);
+    prog->numProgressiveTriangles = r.u32();
+    uint32 narchives = r.count(2*sizeof(uint32) + SHA256::static_size);
+    for(uint32 i = 0; i < narchives && r.ok(); i++) {
+        String key = r.str();
+        Mesh::ProgressiveMipmapArchive& archive = prog->mipmaps[key];
+        archive.name = r.str();
+        archive.archiveHash = readHash(r);
+        uint32 nlevels = r.count(5*sizeof(uint32));
+        for(uint32 l = 0; l < nlevels && r.ok(); l++) {
+            uint32 level = r.u32();
+            Mesh::ProgressiveMipmapLevel& mip = archive.mipmaps[level];
+            mip.offset = r.u32();
+            mip.length = r.u32();
+            mip.width = r.u32();
+            mip.height = r.u32();
+        }
+    }
+    *prog_out = prog;
+}
+
+} // namespace
+
+
+BinaryModelSystem::BinaryModelSystem(bool quantize)
+ : mQuantize(quantize)
+{
+}
+
+BinaryModelSystem::~BinaryModelSystem () {
+}
+
+bool BinaryModelSystem::canLoad(Transfer::DenseDataPtr data) {
+    if (!data || data->length() < HEADER_SIZE) return false;
+    return (memcmp(data->begin(), MAGIC, sizeof(MAGIC)) == 0);
+}
+
+Mesh::VisualPtr BinaryModelSystem::load(const Transfer::RemoteFileMetadata& metadata, const Transfer::Fingerprint& fp, Transfer::DenseDataPtr data) {
+    if (!canLoad(data))
+        return Mesh::VisualPtr();
+
+    Mesh::MeshdataPtr mdp = parse(data->begin(), data->length());
+    if (!mdp) {
+        BINMESH_LOG(error, "Failed to load binary mesh " << metadata.getURI());
+        return Mesh::VisualPtr();
+    }
+    mdp->uri = metadata.getURI().toString();
+    mdp->hash = fp;
+    return mdp;
+}
+
+Mesh::VisualPtr BinaryModelSystem::load(Transfer::DenseDataPtr data) {
+    Transfer::RemoteFileMetadata rfm(Transfer::Fingerprint(), Transfer::URI(), 0, Transfer::ChunkList(), Transfer::FileHeaders());
+    return load(rfm, Transfer::Fingerprint(), data);
+}
+
+Mesh::MeshdataPtr BinaryModelSystem::parse(const uint8* data, uint64 size) {
+    Reader r(data, size);
+
+    char magic[sizeof(MAGIC)];
+    r.raw(magic, sizeof(MAGIC));
+    uint32 version = r.u32();
+    uint32 byte_order = r.u32();
+    uint32 flags = r.u32();
+    if (!r.ok() || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        return Mesh::MeshdataPtr();
+    if (version > FORMAT_VERSION) {
+        BINMESH_LOG(error, "Unsupported binary mesh version " << version << ", only up to " << FORMAT_VERSION << " is supported.");
+        return Mesh::MeshdataPtr();
+    }
+    if (byte_order != BYTE_ORDER_MARKER) {
+        BINMESH_LOG(error, "Binary mesh was written with a different byte order.");
+        return Mesh::MeshdataPtr();
+    }
+    if ((flags & ~KNOWN_FLAGS) != 0) {
+        BINMESH_LOG(error, "Binary mesh uses unknown encoding flags " << flags);
+        return Mesh::MeshdataPtr();
+    }
+
+    Mesh::MeshdataPtr mdp(new Mesh::Meshdata());
+
+    mdp->geometry.resize(r.count(sizeof(uint32)));
+    for(uint32 i = 0; i < mdp->geometry.size() && r.ok(); i++)
+        readGeometry(r, &mdp->geometry[i], flags);
+
+    uint32 ntextures = r.count(sizeof(uint32));
+    mdp->textures.resize(ntextures);
+    for(uint32 i = 0; i < ntextures; i++)
+        mdp->textures[i] = r.str();
+
+    mdp->lights.resize(r.count(sizeof(int32)));
+    for(uint32 i = 0; i < mdp->lights.size(); i++)
+        readLight(r, &mdp->lights[i]);
+
+    mdp->materials.resize(r.count(sizeof(uint32)));
+    for(uint32 i = 0; i < mdp->materials.size() && r.ok(); i++)
+        readMaterial(r, &mdp->materials[i]);
+
+    mdp->id = (long)r.pod<int64>();
+    mdp->hasAnimations = (r.u8() != 0);
+
+    mdp->instances.resize(r.count(3*sizeof(uint32)));
+    for(uint32 i = 0; i < mdp->instances.size() && r.ok(); i++) {
+        Mesh::GeometryInstance& inst = mdp->instances[i];
+        inst.geometryIndex = r.u32();
+        inst.parentNode = r.i32();
+        uint32 nbindings = r.count(2*sizeof(uint64));
+        for(uint32 b = 0; b < nbindings; b++) {
+            Mesh::SubMeshGeometry::Primitive::MaterialId mat_id = (Mesh::SubMeshGeometry::Primitive::MaterialId)r.u64();
+            inst.materialBindingMap[mat_id] = (size_t)r.u64();
+        }
+    }
+
+    mdp->lightInstances.resize(r.count(2*sizeof(int32)));
+    for(uint32 i = 0; i < mdp->lightInstances.size(); i++) {
+        mdp->lightInstances[i].lightIndex = r.i32();
+        mdp->lightInstances[i].parentNode = r.i32();
+    }
+
+    mdp->globalTransform = r.matrix();
+
+    mdp->nodes.resize(r.count(sizeof(uint8) + sizeof(int32)));
+    for(uint32 i = 0; i < mdp->nodes.size() && r.ok(); i++)
+        readNode(r, &mdp->nodes[i]);
+    r.array(&mdp->rootNodes);
+
+    r.matrices(&mdp->mInstanceControllerTransformList);
+    r.array(&mdp->joints);
+
+    readProgressiveData(r, &mdp->progressiveData);
+
+    if (!r.ok() || !r.done())
+        return Mesh::MeshdataPtr();
+    return mdp;
+}
+
+bool BinaryModelSystem::convertVisual(const Mesh::VisualPtr& visual, const String& format, std::ostream& vout) {
+    Mesh::MeshdataPtr meshdata(std::tr1::dynamic_pointer_cast<Mesh::Meshdata>(visual));
+    if (!meshdata) return false;
+    // format is ignored, the encoding is selected by which factory name this
+    // system was created with.
+
+    uint32 flags = mQuantize ? (QUANTIZED_POSITIONS | QUANTIZED_NORMALS | DELTA_INDICES) : 0;
+
+    std::string out;
+    Writer w(out);
+    w.raw(MAGIC, sizeof(MAGIC));
+    w.u32(FORMAT_VERSION);
+    w.u32(BYTE_ORDER_MARKER);
+    w.u32(flags);
+
+    w.u32((uint32)meshdata->geometry.size());
+    for(uint32 i = 0; i < meshdata->geometry.size(); i++)
+        writeGeometry(w, meshdata->geometry[i], flags);
+
+    w.u32((uint32)meshdata->textures.size());
+    for(uint32 i = 0; i < meshdata->textures.size(); i++)
+        w.str(meshdata->textures[i]);
+
+    w.u32((uint32)meshdata->lights.size());
+    for(uint32 i = 0; i < meshdata->lights.size(); i++)
+        writeLight(w, meshdata->lights[i]);
+
+    w.u32((uint32)meshdata->materials.size());
+    for(uint32 i = 0; i < meshdata->materials.size(); i++)
+        writeMaterial(w, meshdata->materials[i]);
+
+    w.pod<int64>((int64)meshdata->id);
+    w.u8(meshdata->hasAnimations ? 1 : 0);
+
+    w.u32((uint32)meshdata->instances.size());
+    for(uint32 i = 0; i < meshdata->instances.size(); i++) {
+        const Mesh::GeometryInstance& inst = meshdata->instances[i];
+        w.u32(inst.geometryIndex);
+        w.i32(inst.parentNode);
+        w.u32((uint32)inst.materialBindingMap.size());
+        for(Mesh::GeometryInstance::MaterialBindingMap::const_iterator it = inst.materialBindingMap.begin(); it != inst.materialBindingMap.end(); it++) {
+            w.u64((uint64)it->first);
+            w.u64((uint64)it->second);
+        }
+    }
+
+    w.u32((uint32)meshdata->lightInstances.size());
+    for(uint32 i = 0; i < meshdata->lightInstances.size(); i++) {
+        w.i32(meshdata->lightInstances[i].lightIndex);
+        w.i32(meshdata->lightInstances[i].parentNode);
+    }
+
+    w.matrix(meshdata->globalTransform);
+
+    w.u32((uint32)meshdata->nodes.size());
+    for(uint32 i = 0; i < meshdata->nodes.size(); i++)
+        writeNode(w, meshdata->nodes[i]);
+    w.array(meshdata->rootNodes);
+
+    w.matrices(meshdata->mInstanceControllerTransformList);
+    w.array(meshdata->joints);
+
+    writeProgressiveData(w, meshdata->progressiveData);
+
+    vout.write(out.data(), out.size());
+    return !vout.fail();
+}
+
+bool BinaryModelSystem::convertVisual(const Mesh::VisualPtr& visual, const String& format, const String& filename) {
+    std::ofstream fout(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!fout) return false;
+    bool converted = convertVisual(visual, format, fout);
+    fout.close();
+    return converted;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,49 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LIBMESH_BINARY_MODEL_SYSTEM_
+#define _SIRIKATA_LIBMESH_BINARY_MODEL_SYSTEM_
+
+#include <sirikata/mesh/ModelsSystem.hpp>
+#include <sirikata/mesh/Meshdata.hpp>
+
+namespace Sirikata {
+
+/** Implementation of ModelsSystem that loads and saves Meshdata in a compact,
+ *  versioned binary format. Unlike COLLADA, nothing needs to be parsed on load:
+ *  the file is a header followed by length-prefixed arrays which are copied
+ *  directly into Meshdata's vectors.
+ *
+ *  When quantization is enabled, positions are stored as 16-bit offsets within
+ *  each SubMeshGeometry's bounding box, normals are stored as 16-bit
+ *  octahedral coordinates and primitive indices are delta + varint coded. The
+ *  flags in the header describe the encoding, so any instance can load any
+ *  file.
+ */
+class BinaryModelSystem : public ModelsSystem {
+public:
+    // Format version written to new files. Bump this when the layout changes.
+    static const uint32 FORMAT_VERSION;
+
+    BinaryModelSystem(bool quantize);
+    virtual ~BinaryModelSystem ();
+
+    virtual bool canLoad(Transfer::DenseDataPtr data);
+
+    virtual Mesh::VisualPtr load(const Transfer::RemoteFileMetadata& metadata, const Transfer::Fingerprint& fp,
+        Transfer::DenseDataPtr data);
+    virtual Mesh::VisualPtr load(Transfer::DenseDataPtr data);
+
+    virtual bool convertVisual(const Mesh::VisualPtr& visual, const String& format, std::ostream& vout);
+    virtual bool convertVisual(const Mesh::VisualPtr& visual, const String& format, const String& filename);
+
+private:
+    Mesh::MeshdataPtr parse(const uint8* data, uint64 size);
+
+    bool mQuantize;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LIBMESH_BINARY_MODEL_SYSTEM_
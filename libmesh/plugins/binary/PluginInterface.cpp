@@ -0,0 +1,71 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/mesh/Platform.hpp>
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include "BinaryModelSystem.hpp"
+
+static int binary_plugin_refcount = 0;
+
+namespace {
+Sirikata::ModelsSystem* createBinaryModelSystem(const Sirikata::String & options) {
+    return new Sirikata::BinaryModelSystem(false);
+}
+Sirikata::ModelsSystem* createQuantizedBinaryModelSystem(const Sirikata::String & options) {
+    return new Sirikata::BinaryModelSystem(true);
+}
+}
+
+SIRIKATA_PLUGIN_EXPORT_C void init ()
+{
+    using namespace Sirikata;
+    if ( binary_plugin_refcount == 0 ) {
+        ModelsSystemFactory::getSingleton ().registerConstructor
+            ( "mesh-binary" , &createBinaryModelSystem, true );
+        // Saves with quantized positions/normals and compressed indices. Both
+        // names load either encoding.
+        ModelsSystemFactory::getSingleton ().registerConstructor
+            ( "mesh-binary-quantized" , &createQuantizedBinaryModelSystem, false );
+    }
+
+    ++binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int increfcount ()
+{
+    return ++binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int decrefcount ()
+{
+    assert ( binary_plugin_refcount > 0 );
+    return --binary_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C void destroy ()
+{
+    using namespace Sirikata;
+
+    if ( binary_plugin_refcount > 0 )
+    {
+        --binary_plugin_refcount;
+
+        assert ( binary_plugin_refcount == 0 );
+
+        if ( binary_plugin_refcount == 0 ) {
+            ModelsSystemFactory::getSingleton ().unregisterConstructor ( "mesh-binary" );
+            ModelsSystemFactory::getSingleton ().unregisterConstructor ( "mesh-binary-quantized" );
+        }
+    }
+}
+
+SIRIKATA_PLUGIN_EXPORT_C char const* name ()
+{
+    return "mesh-binary";
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int refcount ()
+{
+    return binary_plugin_refcount;
+}
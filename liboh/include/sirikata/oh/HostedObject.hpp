@@ -123,6 +123,9 @@ protected:
     const UUID mID;
 
     ObjectHost *mObjectHost;
+    // Strand all of this object's session events, proximity results and
+    // location updates are processed on. Assigned by the ObjectHost.
+    Network::IOStrand* mStrand;
     ObjectScript *mObjectScript;
     typedef std::map<SpaceObjectReference, PerPresenceData*> PresenceDataMap;
     PresenceDataMap mPresenceData;
@@ -173,6 +176,12 @@ public:
     ObjectHostContext* context() { return mContext; }
     const ObjectHostContext* context() const { return mContext; }
 
+    /** Get the strand this object's events are processed on. This is the
+     *  ObjectHost's main strand unless the ObjectHost is configured to spread
+     *  objects across multiple strands.
+     */
+    Network::IOStrand* strand() const { return mStrand; }
+
     /** \see ObjectHost::spaceTime */
     Time spaceTime(const SpaceID& space, const Time& t);
     /** \see ObjectHost::currentSpaceTime */
@@ -373,7 +382,16 @@ public:
 
     // Helper for constructing and sending location update
     void updateLocUpdateRequest(const SpaceID& space, const ObjectReference& oref, const TimedMotionVector3f* const loc, const TimedMotionQuaternion* const orient, const BoundingSphere3f* const bounds, const String* const mesh, const String* const phy, const String* query_data);
+    // Loc update requests are written from the main strand, with retries
+    // timed on the object's strand.
+    static void postLocUpdateRequest(const HostedObjectWPtr& weakSelf, const SpaceID& space, const ObjectReference& oref);
+    static void handleLocUpdateRequest(const HostedObjectWPtr& weakSelf, const SpaceID& space, const ObjectReference& oref);
     void sendLocUpdateRequest(const SpaceID& space, const ObjectReference& oref);
+    // Write any unsent part of the last loc update request, setting up the
+    // request substream if necessary. Returns true if everything has been
+    // written. Must be called with presenceDataMutex held.
+    bool writeLocUpdateRequests(PerPresenceData& pd, SSTStreamPtr spaceStream);
+    static void handleLocUpdateRequestStream(const HostedObjectWPtr& weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr base_stream, int err, SSTStreamPtr s);
 
 }; // class HostedObject
 
@@ -100,10 +100,18 @@ class SIRIKATA_OH_EXPORT ObjectHost
 
     SpaceSessionManagerMap mSessionManagers;
 
+    // Protects the hosted object maps and count, which HostedObjects update
+    // from their own strands.
+    typedef boost::mutex Mutex;
+    mutable Mutex mHostedObjectsMutex;
     uint32 mActiveHostedObjects;
     HostedObjectMap mHostedObjects;
     InternalIDHostedObjectMap mHostedObjectsByID;
 
+    // Strands HostedObjects are spread across. Empty if everything runs on
+    // the main strand.
+    std::vector<Network::IOStrand*> mObjectStrands;
+
     typedef std::tr1::unordered_map<String, ObjectScriptManager*> ScriptManagerMap;
     ScriptManagerMap mScriptManagers;
 
@@ -150,6 +158,17 @@ public:
 
     ObjectHostContext* context() const { return mContext; }
 
+    /** Get the strand events for the object with the given internal ID are
+     *  processed on. Each object always maps to the same strand, so all
+     *  its session events, proximity results and location updates are
+     *  processed in order and never concurrently.
+     */
+    Network::IOStrand* objectStrand(const UUID& objid) const;
+    /** Get the number of strands objects are spread across. If this is 1,
+     *  they all run on the main strand.
+     */
+    uint32 objectStrandCount() const;
+
     /** Create an object with the specified script. This version allows you to
      *  specify the unique identifier manually, so it should only be used if you
      *  need an exact ID, e.g. if you are restoring an object.
@@ -300,10 +319,32 @@ public:
     void handleObjectMigrated(const SpaceObjectReference& sporef_internalID, ServerID from, ServerID to);
     void handleObjectMessage(const SpaceObjectReference& sporef_internalID, const SpaceID& space, Sirikata::Protocol::Object::ObjectMessage* msg);
     void handleObjectDisconnected(const SpaceObjectReference& sporef_internalID, Disconnect::Code);
+    // Main strand portions of connect, send and disconnectObject
+    struct ConnectRequest {
+        HostedObjectPtr ho;
+        SpaceObjectReference sporef;
+        SpaceID space;
+        TimedMotionVector3f loc;
+        TimedMotionQuaternion orient;
+        BoundingSphere3f bnds;
+        String mesh;
+        String phy;
+        String query;
+        String query_data;
+        ConnectedCallback connected_cb;
+        MigratedCallback migrated_cb;
+        StreamCreatedCallback stream_created_cb;
+        DisconnectedCallback disconnected_cb;
+    };
+    typedef std::tr1::shared_ptr<ConnectRequest> ConnectRequestPtr;
+    bool iConnect(ConnectRequestPtr req);
+    bool iSend(const SpaceObjectReference& sporefsrc, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload);
+    void iDisconnectObject(const SpaceID& space, const ObjectReference& oref);
 
     // Wrappers so we can forward events to interested parties. For Connected
     // callback, also allows us to convert ConnectionInfo.
     void wrappedConnectedCallback(HostedObjectWPtr ho_weak, const SpaceID& space, const ObjectReference& obj, const SessionManager::ConnectionInfo& ci, ConnectedCallback cb);
+    void wrappedMigratedCallback(HostedObjectWPtr ho_weak, const SpaceID& space, const ObjectReference& obj, ServerID server, MigratedCallback cb);
     void wrappedStreamCreatedCallback(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, SessionManager::ConnectionEvent after, StreamCreatedCallback cb);
     void wrappedDisconnectedCallback(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, Disconnect::Code cause, DisconnectedCallback);
 
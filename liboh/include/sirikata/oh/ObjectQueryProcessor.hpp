@@ -96,7 +96,7 @@ class SIRIKATA_OH_EXPORT ObjectQueryProcessor :
 
   protected:
     /** Helper method for implementations which delivers proximity
-     *  results to the HostedObject.
+     *  results to the HostedObject. Must be called on the object's strand.
      *  \param ho the HostedObject requesting the update
      *  \param sporef the ID of the presence that registered the query
      *  \param update a single proximity update to apply
@@ -104,12 +104,27 @@ class SIRIKATA_OH_EXPORT ObjectQueryProcessor :
     void deliverProximityUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const Sirikata::Protocol::Prox::ProximityUpdate& update);
 
     /** Helper method for implementations which delivers location
-     *  updates to the HostedObject.
+     *  updates to the HostedObject. Must be called on the object's strand.
      *  \param ho the HostedObject requesting the update
      *  \param sporef the ID of the presence that registered the query
      *  \param lu the location update
      */
     void deliverLocationUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const LocUpdate& lu);
+
+    /** Like deliverProximityUpdate, but may be called from the main strand
+     *  for objects that are processed on another strand, in which case a copy
+     *  of the update is delivered on the object's strand.
+     */
+    void postProximityUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const Sirikata::Protocol::Prox::ProximityUpdate& update);
+    /** Like deliverLocationUpdate, but may be called from the main strand
+     *  for objects that are processed on another strand, in which case a copy
+     *  of the update is delivered on the object's strand.
+     */
+    void postLocationUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const LocUpdate& lu);
+
+  private:
+    void handlePostedProximityUpdate(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, const Sirikata::Protocol::Prox::ProximityUpdate& update);
+    void handlePostedLocationUpdate(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, const LocUpdate& lu);
 };
 
 
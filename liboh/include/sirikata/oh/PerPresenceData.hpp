@@ -44,6 +44,13 @@ public:
     // resolve differences for each component independently.
     SequencedPresencePropertiesPtr requestLoc;
     Network::IOTimerPtr rerequestTimer;
+    // Requests are written as Network::Frames to a long-lived substream of
+    // the space stream they were requested on. locRequestData holds the part
+    // of the last request that hasn't been written yet.
+    HostedObject::SSTStreamPtr locRequestBaseStream;
+    HostedObject::SSTStreamPtr locRequestStream;
+    bool locRequestStreamRequested;
+    String locRequestData;
 
     // This tracks the latest epoch we've seen *reported* from the space server,
     // i.e. what requests the server has handled.
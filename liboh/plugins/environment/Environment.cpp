@@ -24,6 +24,15 @@ EnvironmentSimulation::EnvironmentSimulation(HostedObjectPtr ho, const SpaceObje
 }
 
 void EnvironmentSimulation::start() {
+    // Scripts may start us from their object's strand, but the space stream
+    // is only safe to use from the main strand.
+    mParent->context()->mainStrand->dispatch(
+        std::tr1::bind(&EnvironmentSimulation::iStart, this),
+        "EnvironmentSimulation::start"
+    );
+}
+
+void EnvironmentSimulation::iStart() {
     ODPSST::Stream::Ptr stream = mParent->getSpaceStream(mPresence);
     if (!stream) return;
 
@@ -157,6 +166,13 @@ void EnvironmentSimulation::sendUpdate() {
     // Currently we just always serialize and send the whole thing
     std::string serialized = json::write(mEnvironment);
     ENV_LOG(insane, "Sending update: " << serialized);
+    mParent->context()->mainStrand->dispatch(
+        std::tr1::bind(&EnvironmentSimulation::writeUpdate, this, serialized),
+        "EnvironmentSimulation::writeUpdate"
+    );
+}
+
+void EnvironmentSimulation::writeUpdate(const String& serialized) {
     mRecordStream.write(MemoryReference(serialized));
 }
 
@@ -33,6 +33,10 @@ public:
     virtual boost::any invoke(std::vector<boost::any>& params);
 
 private:
+    // Main strand portions of start() and sendUpdate()
+    void iStart();
+    void writeUpdate(const String& serialized);
+
     void handleCreatedStream(int err, ODPSST::Stream::Ptr strm);
     void handleMessage(MemoryReference data);
 
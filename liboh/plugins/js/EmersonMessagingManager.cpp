@@ -7,14 +7,47 @@
 #include <sirikata/core/network/Frame.hpp>
 #include "Protocol_Frame.pbj.hpp"
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/trace/Trace.hpp>
 
 namespace Sirikata{
 namespace JS{
 
 #define EMERSON_RELIABLE_COMMUNICATION_PORT 5
 
+namespace {
+// Scripts get backpressure once this much data is waiting for a receiver
+const uint32 MaxQueuedBytes = 1024*1024;
+// Small messages are combined into writes of up to this size
+const uint32 MaxBatchBytes = 64*1024;
+// After this many consecutive failures to set up a stream or write to it,
+// queued messages are dropped
+const uint8 MaxChannelFailures = 5;
+// Channels with nothing to send for this long are dropped, closing their
+// substream
+const Duration ChannelIdleTimeout = Duration::seconds(30.0);
+}
+
+EmersonMessagingManager::MessageChannel::MessageChannel()
+ : connecting(false),
+   substreamRequested(false),
+   serviceQueued(false),
+   idleCheckQueued(false),
+   lastActive(Time::null()),
+   failures(0),
+   writeOffset(0),
+   queuedBytes(0)
+{
+}
+
+EmersonMessagingManager::MessageChannel::~MessageChannel() {
+    if (substream) substream->close(false);
+}
+
 EmersonMessagingManager::EmersonMessagingManager(ObjectHostContext* ctx)
- : mMainContext(ctx)
+ : mMainContext(ctx),
+   mIncomingExpiryScheduled(false),
+   mTimeSeriesMessagesPerWriteName(String("oh.") + boost::lexical_cast<String>(ctx->id) + ".emerson.messages_per_write"),
+   mTimeSeriesQueueDelayName(String("oh.") + boost::lexical_cast<String>(ctx->id) + ".emerson.queue_delay")
 {
 }
 
@@ -38,6 +71,13 @@ EmersonMessagingManager::~EmersonMessagingManager()
     }
 
     mStreams.clear();
+
+    for(IncomingChannelMap::iterator it = mIncomingChannels.begin(); it != mIncomingChannels.end(); it++)
+        closeIncomingChannel(it->second);
+    mIncomingChannels.clear();
+
+    Mutex::scoped_lock lock(mChannelMutex);
+    mChannels.clear();
 }
 
 void EmersonMessagingManager::presenceConnected(const SpaceObjectReference& connPresSporef)
@@ -63,6 +103,17 @@ void EmersonMessagingManager::presenceDisconnected(const SpaceObjectReference& d
     }
     allPres.erase(allPresFinder);
     clearStreams(disconnPresSporef);
+    clearChannels(disconnPresSporef);
+
+    for(IncomingChannelMap::iterator it = mIncomingChannels.begin(); it != mIncomingChannels.end(); ) {
+        if (it->first->localEndPoint().endPoint == disconnPresSporef) {
+            closeIncomingChannel(it->second);
+            mIncomingChannels.erase(it++);
+        }
+        else {
+            it++;
+        }
+    }
 }
 
 
@@ -138,6 +189,16 @@ void EmersonMessagingManager::clearStreams(const SpaceObjectReference& pres) {
         mStreams.erase(pres_it);
 }
 
+void EmersonMessagingManager::clearChannels(const SpaceObjectReference& pres) {
+    Mutex::scoped_lock lock(mChannelMutex);
+    for(ChannelMap::iterator it = mChannels.begin(); it != mChannels.end(); ) {
+        if (it->first.first == pres || it->first.second == pres)
+            mChannels.erase(it++);
+        else
+            it++;
+    }
+}
+
 //Gets executed whenever a new stream connects to presence with sporef toListenFrom.
 void EmersonMessagingManager::createScriptCommListenerStreamCB(Liveness::Token alive, const SpaceObjectReference& toListenFrom, int err, SSTStreamPtr sstStream)
 {
@@ -156,227 +217,401 @@ void EmersonMessagingManager::handleIncomingSubstream(Liveness::Token alive, int
 
     if (err != SST_IMPL_SUCCESS) return;
 
-    String* msgBuf = new String();
+    IncomingChannelPtr chan(new IncomingChannel());
+    chan->stream = streamPtr;
+    chan->lastActive = mMainContext->simTime();
+    mIncomingChannels[streamPtr] = chan;
     streamPtr->registerReadCallback(
         std::tr1::bind(&EmersonMessagingManager::handleScriptCommStreamRead, this,
-            livenessToken(), streamPtr, msgBuf, _1, _2)
+            livenessToken(), IncomingChannelWPtr(chan), _1, _2)
     );
+
+    if (!mIncomingExpiryScheduled) {
+        mIncomingExpiryScheduled = true;
+        mMainContext->mainStrand->post(
+            ChannelIdleTimeout,
+            std::tr1::bind(&EmersonMessagingManager::expireIncomingChannels, this, livenessToken()),
+            "EmersonMessagingManager::expireIncomingChannels"
+        );
+    }
 }
 
 
 //Gets executed whenever have additional data to read.
-void EmersonMessagingManager::handleScriptCommStreamRead(Liveness::Token alive, SSTStreamPtr sstptr, String* prevdata, uint8* buffer, int length)
+void EmersonMessagingManager::handleScriptCommStreamRead(Liveness::Token alive, IncomingChannelWPtr w_chan, uint8* buffer, int length)
 {
-    if (!alive) {
-        delete prevdata;
-        sstptr->registerReadCallback(0);
-        sstptr->close(false);
-        return;
-    }
+    if (!alive) return;
+    IncomingChannelPtr chan = w_chan.lock();
+    if (!chan) return;
 
-    prevdata->append((const char*)buffer, length);
+    chan->buffer.append((const char*)buffer, length);
+    chan->lastActive = mMainContext->simTime();
 
-    // We should only ever get one message per substream, so there's no need to
-    // loop and we can clean up as soon as we parse a message successfully.
-    std::string msg = Network::Frame::parse(*prevdata);
+    // Senders keep the substream open and may batch many messages into one
+    // write, so handle every complete message we have.
+    while(true) {
+        std::string msg = Network::Frame::parse(chan->buffer);
 
-    // If we don't have a full message, just wait for more
-    if (msg.empty())
-        return;
+        // If we don't have a full message, just wait for more
+        if (msg.empty())
+            return;
 
-    //otherwise, try to handle it.
-    handleScriptCommRead(sstptr->remoteEndPoint().endPoint, sstptr->localEndPoint().endPoint, msg);
+        //otherwise, try to handle it.
+        handleScriptCommRead(chan->stream->remoteEndPoint().endPoint, chan->stream->localEndPoint().endPoint, msg);
 
+        // Handling the message may have disconnected the receiver, closing
+        // the channel
+        if (mIncomingChannels.find(chan->stream) == mIncomingChannels.end())
+            return;
+    }
+}
+
+void EmersonMessagingManager::expireIncomingChannels(Liveness::Token alive) {
+    if (!alive) return;
+    mIncomingExpiryScheduled = false;
+
+    // We don't get a callback when the sender closes its end, so we check for
+    // that here too. Senders drop channels after the same idle timeout, so
+    // this normally just cleans up after them.
+    Time now = mMainContext->simTime();
+    for(IncomingChannelMap::iterator it = mIncomingChannels.begin(); it != mIncomingChannels.end(); ) {
+        IncomingChannelPtr chan = it->second;
+        if (!chan->stream->connected() || now - chan->lastActive >= ChannelIdleTimeout) {
+            closeIncomingChannel(chan);
+            mIncomingChannels.erase(it++);
+        }
+        else {
+            it++;
+        }
+    }
 
-    delete prevdata;
-    sstptr->registerReadCallback(0);
-    sstptr->close(false);
+    if (!mIncomingChannels.empty()) {
+        mIncomingExpiryScheduled = true;
+        mMainContext->mainStrand->post(
+            ChannelIdleTimeout,
+            std::tr1::bind(&EmersonMessagingManager::expireIncomingChannels, this, livenessToken()),
+            "EmersonMessagingManager::expireIncomingChannels"
+        );
+    }
+}
+
+void EmersonMessagingManager::closeIncomingChannel(const IncomingChannelPtr& chan) {
+    chan->stream->registerReadCallback(0);
+    chan->stream->close(false);
 }
 
 
 ////////////////writing functions.
 
 bool EmersonMessagingManager::sendScriptCommMessageReliable(const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const String& msg) {
-    // arbitrary default # of retries
-    return sendScriptCommMessageReliable(sender, receiver, msg, 10,5);
-}
-
-void EmersonMessagingManager::removeStream(
-    const SpaceObjectReference& sender, const SpaceObjectReference& receiver)
-{
-    if (mStreams.find(sender) != mStreams.end())
-    {
-        StreamMap& smap = mStreams[sender];
-        for(StreamMap::iterator it = smap.begin(); it != smap.end(); it++)
-            it->second->close(false);
-        mStreams.erase(sender);
-    }
-}
+    Mutex::scoped_lock lock(mChannelMutex);
 
-bool EmersonMessagingManager::sendScriptCommMessageReliable(const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const String& msg, int8 retriesSameStream,int8 retriesNewStream,bool isRetry)
-{
-    bool returner = false;
+    MessageChannelPtr& chan = mChannels[ChannelID(sender, receiver)];
+    if (!chan) chan = MessageChannelPtr(new MessageChannel());
 
-    //if we have tried to create a bunch of new streams, and that has still
-    //failed, then remove the existing stream (if it's there), and drop message.
-    if (retriesNewStream == 0)
-    {
-        JSLOG(error, "Cannot send message from sender "<< sender<<\
-              " to "<<receiver<<".  Aborting.");
-        removeStream(sender,receiver);
+    if (chan->queuedBytes + msg.size() > MaxQueuedBytes && chan->queuedBytes > 0) {
+        JSLOG(detailed, "Too much data queued for " << receiver << ", rejecting message from " << sender);
         return false;
     }
 
+    MessageChannel::QueuedMessage queued;
+    queued.frame = Network::Frame::write(msg);
+    queued.queued = mMainContext->simTime();
+    chan->queuedBytes += queued.frame.size();
+    chan->queue.push_back(queued);
+    chan->lastActive = queued.queued;
+
+    // Anything else queued before the channel is serviced is sent in the same
+    // batch
+    scheduleChannelService(*chan, sender, receiver, Duration::zero());
+    return true;
+}
 
-    if (retriesSameStream > 0)
-    {
-        // If we have a stream
-        SSTStreamPtr streamPtr = getStream(sender, receiver);
-        if (streamPtr)
-        {
-            writeMessage(
-                livenessToken(), streamPtr, msg, sender,
-                receiver, retriesSameStream,--retriesNewStream);
-            return true;
-        }
+void EmersonMessagingManager::scheduleChannelService(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const Duration& delay) {
+    if (chan.serviceQueued) return;
+    chan.serviceQueued = true;
+
+    if (delay == Duration::zero()) {
+        mMainContext->mainStrand->post(
+            std::tr1::bind(&EmersonMessagingManager::serviceChannel, this, livenessToken(), sender, receiver),
+            "EmersonMessagingManager::serviceChannel"
+        );
+    }
+    else {
+        mMainContext->mainStrand->post(
+            delay,
+            std::tr1::bind(&EmersonMessagingManager::serviceChannel, this, livenessToken(), sender, receiver),
+            "EmersonMessagingManager::serviceChannel"
+        );
     }
+}
 
+void EmersonMessagingManager::scheduleIdleCheck(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const Duration& delay) {
+    if (chan.idleCheckQueued) return;
+    chan.idleCheckQueued = true;
 
-    //what to do when the connection is created.
-    CommWriteStreamConnectedCBRetryData retryData;
-    retryData.retriesSameStream = retriesSameStream;
-    retryData.retriesNewStream = --retriesNewStream;
-    retryData.isRetry = isRetry;
+    mMainContext->mainStrand->post(
+        delay,
+        std::tr1::bind(&EmersonMessagingManager::expireIdleChannel, this, livenessToken(), sender, receiver),
+        "EmersonMessagingManager::expireIdleChannel"
+    );
+}
 
-    // Otherwise, start the process of connecting
-    // connection will overwrite existing streams if they are there.
-    returner = mMainContext->sstConnMgr()->connectStream(
-        SST::EndPoint<SpaceObjectReference>(sender,0), //local port is random
+void EmersonMessagingManager::expireIdleChannel(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver) {
+    if (!alive) return;
 
-        //send to receiver's script comm port
-        SST::EndPoint<SpaceObjectReference>(receiver,EMERSON_RELIABLE_COMMUNICATION_PORT),
+    Mutex::scoped_lock lock(mChannelMutex);
+    ChannelMap::iterator it = mChannels.find(ChannelID(sender, receiver));
+    if (it == mChannels.end()) return;
+    MessageChannel& chan = *(it->second);
+    chan.idleCheckQueued = false;
 
-        std::tr1::bind(
-            &EmersonMessagingManager::scriptCommWriteStreamConnectedCB, this,
-            livenessToken(),
-            msg, sender,receiver, _1, _2, retryData
-        )
-    );
+    // Still busy, serviceChannel checks back in once it has emptied the
+    // channel
+    if (chan.serviceQueued || chan.connecting || chan.substreamRequested ||
+        !chan.queue.empty() || !chan.writing.empty())
+        return;
 
-    return returner;
+    // We don't get a callback when the receiver closes its end, but nothing
+    // more can be written on the channel's substream once it has
+    bool closed = (chan.baseStream && !chan.baseStream->connected());
+    Duration idle = mMainContext->simTime() - chan.lastActive;
+    if (closed || idle >= ChannelIdleTimeout) {
+        mChannels.erase(it);
+        return;
+    }
+    scheduleIdleCheck(chan, sender, receiver, ChannelIdleTimeout - idle);
 }
 
-
-void EmersonMessagingManager::scriptCommWriteStreamConnectedCB(
-    Liveness::Token alive, const String& msg,
-    const SpaceObjectReference& sender,
-    const SpaceObjectReference& receiver, int err, SSTStreamPtr streamPtr,
-    CommWriteStreamConnectedCBRetryData retryData)
-{
+void EmersonMessagingManager::serviceChannel(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver) {
     if (!alive) return;
 
-    int8 retriesSameStream = retryData.retriesSameStream;
-    int8 retriesNewStream = retryData.retriesNewStream;
-    bool isRetry = retryData.isRetry;
+    SSTStreamPtr base = getStream(sender, receiver);
+    if (base && !base->connected()) {
+        removeStream(sender, receiver);
+        base.reset();
+    }
 
-    //if connection failure, just try to re-connect.
-    if (err != SST_IMPL_SUCCESS)
+    // Connecting and creating substreams are done without the lock held
+    // since their callbacks could be invoked immediately
+    bool connect = false, request_substream = false;
     {
-        if (retriesSameStream > 0)
-        {
-            sendScriptCommMessageReliable(
-                sender, receiver, msg, --retriesSameStream,
-                retriesNewStream,true);
+        Mutex::scoped_lock lock(mChannelMutex);
+        ChannelMap::iterator it = mChannels.find(ChannelID(sender, receiver));
+        if (it == mChannels.end()) return;
+        MessageChannel& chan = *(it->second);
+        chan.serviceQueued = false;
+
+        if (chan.queue.empty() && chan.writing.empty()) {
+            // Nothing left to send, but keep the channel and its substream
+            // around for the next message until it goes idle
+            scheduleIdleCheck(chan, sender, receiver, ChannelIdleTimeout);
+            return;
         }
-        return;
-    }
-    //will overwrite any existing streams if they existed before.
-    setupNewStream(streamPtr,isRetry);
 
-    writeMessage(
-        livenessToken(), streamPtr, msg, sender,
-        receiver, retriesSameStream,retriesNewStream);
-}
+        if (!base) {
+            if (!chan.connecting) {
+                chan.connecting = true;
+                connect = true;
+            }
+        }
+        else {
+            if (chan.baseStream != base) {
+                // Either our first stream or a replacement, e.g. because the
+                // other side connected to us. Anything partially written on an
+                // old substream is sent again in full.
+                if (chan.substream) chan.substream->close(false);
+                chan.substream.reset();
+                chan.substreamRequested = false;
+                chan.writeOffset = 0;
+                chan.baseStream = base;
+            }
 
-void EmersonMessagingManager::writeMessage(
-    Liveness::Token alive, SSTStreamPtr streamPtr,
-    const String& msg, const SpaceObjectReference& sender,
-    const SpaceObjectReference& receiver, int8 retriesSameStream,
-    int8 retriesNewStream)
-{
-    if (!alive) return;
+            if (!chan.substream) {
+                if (!chan.substreamRequested) {
+                    chan.substreamRequested = true;
+                    request_substream = true;
+                }
+            }
+            else if (!writeChannel(chan)) {
+                if (!channelFailed(chan, sender, receiver)) {
+                    mChannels.erase(it);
+                    return;
+                }
+                scheduleChannelService(chan, sender, receiver, Duration::milliseconds((int64)20));
+            }
+            else if (!chan.queue.empty() || !chan.writing.empty()) {
+                // The substream is full, give it a chance to drain
+                scheduleChannelService(chan, sender, receiver, Duration::milliseconds((int64)1));
+            }
+            else {
+                scheduleIdleCheck(chan, sender, receiver, ChannelIdleTimeout);
+            }
+        }
+    }
 
-    // FIXME we're not pushing data directly here because it doesn't seem like
-    // you can actually find out how much data was successfully pushed in. what
-    // if we have a very large message?
-    int retCode = streamPtr->createChildStream(
-        std::tr1::bind(&EmersonMessagingManager::writeMessageSubstream,
-            this, alive, _1, _2, msg, sender, receiver,
-            retriesSameStream,retriesNewStream),
-        NULL, 0,
-        EMERSON_RELIABLE_COMMUNICATION_PORT, EMERSON_RELIABLE_COMMUNICATION_PORT
-    );
+    if (connect) {
+        bool connecting = mMainContext->sstConnMgr()->connectStream(
+            SST::EndPoint<SpaceObjectReference>(sender,0), //local port is random
 
+            //send to receiver's script comm port
+            SST::EndPoint<SpaceObjectReference>(receiver,EMERSON_RELIABLE_COMMUNICATION_PORT),
 
-    if (retCode == -1)
-    {
-        //createChildStream failed.  close streamPtr and create a new stream to
-        //try to send the message.  (Setting the retriesSameStream to zero and
-        //isRetry to true should cause this to happen.)
-        sendScriptCommMessageReliable(
-            sender, receiver, msg, 0,--retriesNewStream,true);
+            std::tr1::bind(
+                &EmersonMessagingManager::channelConnected, this,
+                livenessToken(), sender, receiver, _1, _2
+            )
+        );
+        if (!connecting)
+            channelConnected(livenessToken(), sender, receiver, SST_IMPL_FAILURE, SSTStreamPtr());
     }
 
+    if (request_substream) {
+        int ret = base->createChildStream(
+            std::tr1::bind(&EmersonMessagingManager::channelSubstreamCreated, this,
+                livenessToken(), sender, receiver, base, _1, _2),
+            NULL, 0,
+            EMERSON_RELIABLE_COMMUNICATION_PORT, EMERSON_RELIABLE_COMMUNICATION_PORT
+        );
+        if (ret == -1)
+            channelSubstreamCreated(livenessToken(), sender, receiver, base, SST_IMPL_FAILURE, SSTStreamPtr());
+    }
 }
 
-void EmersonMessagingManager::writeMessageSubstream(
-    Liveness::Token alive, int err, SSTStreamPtr subStreamPtr,
-    const String& msg, const SpaceObjectReference& sender,
-    const SpaceObjectReference& receiver, int8 retriesSameStream,
-    int8 retriesNewStream)
-{
+void EmersonMessagingManager::channelConnected(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, int err, SSTStreamPtr streamPtr) {
     if (!alive) return;
 
-    if (err != SST_IMPL_SUCCESS)
-    {
-        // Try the whole process over, starting from scratch in case the stream
-        // changed
-        if (retriesSameStream > 0)
-        {
-            sendScriptCommMessageReliable(
-                sender, receiver, msg, --retriesSameStream,retriesNewStream,true);
+    // Save the stream so the other side can also use it, and so we pick it up
+    // when servicing the channel
+    if (err == SST_IMPL_SUCCESS)
+        setupNewStream(streamPtr);
+
+    Mutex::scoped_lock lock(mChannelMutex);
+    ChannelMap::iterator it = mChannels.find(ChannelID(sender, receiver));
+    if (it == mChannels.end()) return;
+    MessageChannel& chan = *(it->second);
+    chan.connecting = false;
+
+    if (err != SST_IMPL_SUCCESS) {
+        if (!channelFailed(chan, sender, receiver)) {
+            mChannels.erase(it);
+            return;
         }
+        scheduleChannelService(chan, sender, receiver, Duration::milliseconds((int64)20));
         return;
     }
-
-    writeData(livenessToken(), subStreamPtr, Network::Frame::write(msg), sender, receiver);
+    scheduleChannelService(chan, sender, receiver, Duration::zero());
 }
 
-void EmersonMessagingManager::writeData(Liveness::Token alive, SSTStreamPtr streamPtr, const String& msg, const SpaceObjectReference& sender, const SpaceObjectReference& receiver) {
-    if (!alive) return;
+void EmersonMessagingManager::channelSubstreamCreated(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, SSTStreamPtr baseStream, int err, SSTStreamPtr substream) {
+    if (!alive) {
+        if (substream) substream->close(false);
+        return;
+    }
 
-    int bytesWritten = streamPtr->write((uint8*) msg.data(), msg.size());
-    //errored out: log message and abort.
-    if (bytesWritten == -1)
-    {
-        JSLOG(error,"Error sending script communication message in scriptCommStreamCallback.  Not sending message.");
+    Mutex::scoped_lock lock(mChannelMutex);
+    ChannelMap::iterator it = mChannels.find(ChannelID(sender, receiver));
+    // Ignore substreams for channels that have gone away or moved on to a
+    // different stream
+    if (it == mChannels.end() || it->second->baseStream != baseStream) {
+        if (substream) substream->close(false);
         return;
     }
+    MessageChannel& chan = *(it->second);
+    chan.substreamRequested = false;
 
-    //check if full message was written.
-    if(bytesWritten < (int)msg.size())
-    {
-        //retry write infinitely
-        String restToWrite = msg.substr(bytesWritten);
-        mMainContext->mainStrand->post(
-            Duration::milliseconds((int64)20),
-            std::tr1::bind(&EmersonMessagingManager::writeData, this, livenessToken(), streamPtr, restToWrite, sender, receiver),
-            "EmersonMessagingManager::writeData"
+    if (err != SST_IMPL_SUCCESS || !substream) {
+        if (!channelFailed(chan, sender, receiver)) {
+            mChannels.erase(it);
+            return;
+        }
+        scheduleChannelService(chan, sender, receiver, Duration::milliseconds((int64)20));
+        return;
+    }
+
+    chan.substream = substream;
+    scheduleChannelService(chan, sender, receiver, Duration::zero());
+}
+
+bool EmersonMessagingManager::writeChannel(MessageChannel& chan) {
+    while(true) {
+        if (chan.writing.empty()) {
+            if (chan.queue.empty()) return true;
+
+            // Fill a new batch. Always take at least one message so large
+            // messages still get sent.
+            Time now = mMainContext->simTime();
+            uint32 count = 0;
+            Duration delay_total = Duration::zero();
+            while(!chan.queue.empty() &&
+                (chan.writing.empty() || chan.writing.size() + chan.queue.front().frame.size() <= MaxBatchBytes))
+            {
+                chan.writing.append(chan.queue.front().frame);
+                delay_total += now - chan.queue.front().queued;
+                chan.queue.pop_front();
+                count++;
+            }
+            chan.writeOffset = 0;
+
+            if (mMainContext->timeSeries != NULL) {
+                mMainContext->timeSeries->report(mTimeSeriesMessagesPerWriteName, count);
+                mMainContext->timeSeries->report(mTimeSeriesQueueDelayName, (delay_total / count).toMicroseconds() / 1000.f);
+            }
+        }
+
+        int bytes_written = chan.substream->write(
+            (const uint8*)chan.writing.data() + chan.writeOffset,
+            chan.writing.size() - chan.writeOffset
         );
-        JSLOG(detailed,"More sript data to write to stream.  Queueing future write operation.");
+        if (bytes_written < 0)
+            return false;
+
+        chan.writeOffset += bytes_written;
+        if (chan.writeOffset < chan.writing.size()) {
+            // Only some was accepted, we'll have to wait for more space
+            return true;
+        }
+
+        chan.queuedBytes -= chan.writing.size();
+        chan.writing.clear();
+        chan.writeOffset = 0;
+        chan.failures = 0;
+    }
+}
+
+bool EmersonMessagingManager::channelFailed(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver) {
+    // Start over with a new stream, resending anything that was only
+    // partially written.
+    if (chan.substream) chan.substream->close(false);
+    chan.substream.reset();
+    chan.substreamRequested = false;
+    chan.writeOffset = 0;
+    if (chan.baseStream) {
+        if (getStream(sender, receiver) == chan.baseStream)
+            removeStream(sender, receiver);
+        chan.baseStream.reset();
     }
-    else
-        streamPtr->close(false);
+
+    chan.failures++;
+    if (chan.failures < MaxChannelFailures)
+        return true;
+
+    JSLOG(error, "Cannot send messages from sender "<< sender<<\
+        " to "<<receiver<<".  Dropping queued messages.");
+    return false;
+}
+
+void EmersonMessagingManager::removeStream(
+    const SpaceObjectReference& sender, const SpaceObjectReference& receiver)
+{
+    PresenceStreamMap::iterator pres_it = mStreams.find(sender);
+    if (pres_it == mStreams.end()) return;
+
+    StreamMap& smap = pres_it->second;
+    StreamMap::iterator it = smap.find(receiver);
+    if (it == smap.end()) return;
+    it->second->close(false);
+    smap.erase(it);
 }
 
 
@@ -6,10 +6,12 @@
 #define __EMERSON_MESSAGING_MANAGER_HPP__
 
 #include <map>
+#include <deque>
 #include <sirikata/core/odp/SSTDecls.hpp>
 #include <sirikata/core/network/ObjectMessage.hpp>
 #include <string>
 #include <sstream>
+#include <boost/thread/mutex.hpp>
 #include <sirikata/core/util/Liveness.hpp>
 #include <sirikata/oh/ObjectHostContext.hpp>
 
@@ -36,11 +38,15 @@ public:
     virtual bool handleScriptCommRead(const SpaceObjectReference& src, const SpaceObjectReference& dst, const std::string& payload) = 0;
 
 
+    /** Queue a message to be sent reliably from sender to receiver. Messages
+     *  between a pair of objects are sent, in order, over a single long-lived
+     *  channel and small messages are batched into a single write.
+     *  \returns false if the message was rejected because too much data is
+     *  already waiting to be sent to receiver. The caller should back off and
+     *  try again later.
+     *  Thread safe.
+     */
     bool sendScriptCommMessageReliable(const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const String& msg);
-    bool sendScriptCommMessageReliable(
-        const SpaceObjectReference& sender, const SpaceObjectReference& receiver,
-        const String& msg, int8 retriesSameStream,int8 retriesNewStream,
-        bool isRetry=false);
 
 
     void presenceConnected(const SpaceObjectReference& connPresSporef);
@@ -61,36 +67,86 @@ private:
     //reading helpers
     void createScriptCommListenerStreamCB(Liveness::Token alive, const SpaceObjectReference& toListenFrom, int err, SSTStreamPtr sstStream);
     void handleIncomingSubstream(Liveness::Token alive, int err, SSTStreamPtr streamPtr);
-    void handleScriptCommStreamRead(Liveness::Token alive, SSTStreamPtr sstptr, String* prevdata, uint8* buffer, int length);
-
-    // Only put a few parameters in here to avoid copying lots of stuff, we only
-    // need to get < 8 parameters for bind to work on all platforms
-    struct CommWriteStreamConnectedCBRetryData {
-        int8 retriesSameStream;
-        int8 retriesNewStream;
-        bool isRetry;
-    };
-    //writing helper
-    void scriptCommWriteStreamConnectedCB(
-        Liveness::Token alive, const String& msg,
-        const SpaceObjectReference& sender, const SpaceObjectReference& receiver,
-        int err, SSTStreamPtr streamPtr, CommWriteStreamConnectedCBRetryData retryData);
-
-    // Writes a message to a *substream* of the given stream
-    void writeMessage(
-        Liveness::Token alive, SSTStreamPtr streamPtr,
-        const String& msg, const SpaceObjectReference& sender,
-        const SpaceObjectReference& receiver, int8 retriesSameStream,
-        int8 retriesNewStream);
-
-    void writeMessageSubstream(
-        Liveness::Token alive, int err, SSTStreamPtr subStreamPtr,
-        const String& msg, const SpaceObjectReference& sender,
-        const SpaceObjectReference& receiver, int8 retriesSameStream,
-        int8 retriesNewStream);
-
-    void writeData(Liveness::Token alive, SSTStreamPtr streamPtr, const String& msg, const SpaceObjectReference& sender, const SpaceObjectReference& receiver);
 
+    // A substream another object sends us messages on. The read callback
+    // only holds a weak reference, so closing the channel and dropping it
+    // from mIncomingChannels frees both the stream and the buffer.
+    struct IncomingChannel {
+        SSTStreamPtr stream;
+        // Data that doesn't make up a full message yet
+        String buffer;
+        Time lastActive;
+    };
+    typedef std::tr1::shared_ptr<IncomingChannel> IncomingChannelPtr;
+    typedef std::tr1::weak_ptr<IncomingChannel> IncomingChannelWPtr;
+    typedef std::map<SSTStreamPtr, IncomingChannelPtr> IncomingChannelMap;
+
+    void handleScriptCommStreamRead(Liveness::Token alive, IncomingChannelWPtr w_chan, uint8* buffer, int length);
+    // Close incoming channels whose stream has closed or which haven't
+    // received anything for a while
+    void expireIncomingChannels(Liveness::Token alive);
+    void closeIncomingChannel(const IncomingChannelPtr& chan);
+
+    // A channel for reliable messages from one of our presences to another
+    // object. Messages are framed and written, in batches, to a single
+    // substream of the top level stream between the two objects, which is
+    // kept open for later messages.
+    struct MessageChannel {
+        MessageChannel();
+        ~MessageChannel();
+
+        // The top level stream the substream belongs to
+        SSTStreamPtr baseStream;
+        SSTStreamPtr substream;
+        bool connecting;
+        bool substreamRequested;
+        // Whether serviceChannel is already queued for this channel
+        bool serviceQueued;
+        // Whether expireIdleChannel is already queued for this channel
+        bool idleCheckQueued;
+        // When a message was last queued on the channel
+        Time lastActive;
+        // Consecutive failures to set up a stream or write to it
+        uint8 failures;
+
+        struct QueuedMessage {
+            String frame;
+            Time queued;
+        };
+        std::deque<QueuedMessage> queue;
+        // The current batch and how much of it the substream has accepted
+        String writing;
+        uint32 writeOffset;
+        // Bytes waiting in queue and writing
+        uint32 queuedBytes;
+    };
+    typedef std::tr1::shared_ptr<MessageChannel> MessageChannelPtr;
+    typedef std::pair<SpaceObjectReference, SpaceObjectReference> ChannelID;
+    typedef std::map<ChannelID, MessageChannelPtr> ChannelMap;
+
+    // Channel helpers, all run on the main strand
+    void serviceChannel(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver);
+    void channelConnected(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, int err, SSTStreamPtr streamPtr);
+    void channelSubstreamCreated(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, SSTStreamPtr baseStream, int err, SSTStreamPtr substream);
+    // Write as much of the channel's queue as the substream will accept.
+    // Returns false if the substream failed. Must hold mChannelMutex.
+    bool writeChannel(MessageChannel& chan);
+    // Give up on the channel's current streams so the next attempt starts
+    // over. Returns false, and drops queued messages, if we've failed too many
+    // times. Must hold mChannelMutex.
+    bool channelFailed(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver);
+    // Must hold mChannelMutex.
+    void scheduleChannelService(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const Duration& delay);
+    // Check back on an empty channel after it has had time to go idle. Must
+    // hold mChannelMutex.
+    void scheduleIdleCheck(MessageChannel& chan, const SpaceObjectReference& sender, const SpaceObjectReference& receiver, const Duration& delay);
+    // Drop the channel if it's still empty and either nothing has been sent on
+    // it for a while or the receiver's stream has closed.
+    void expireIdleChannel(Liveness::Token alive, const SpaceObjectReference& sender, const SpaceObjectReference& receiver);
+    // Drop channels with pres as either the sender or the receiver
+    void clearChannels(const SpaceObjectReference& pres);
+
+    // Stop using a saved stream to a remote object, closing it
     void removeStream(
         const SpaceObjectReference& sender, const SpaceObjectReference& receiver);
 
@@ -105,6 +161,19 @@ private:
     typedef std::tr1::unordered_map<SpaceObjectReference, SSTStreamPtr, SpaceObjectReference::Hasher> StreamMap;
     typedef std::tr1::unordered_map<SpaceObjectReference, StreamMap, SpaceObjectReference::Hasher> PresenceStreamMap;
     PresenceStreamMap mStreams;
+
+    IncomingChannelMap mIncomingChannels;
+    bool mIncomingExpiryScheduled;
+
+    // Messages may be queued from any thread, so channels are protected by
+    // mChannelMutex. Everything else is only used on the main strand.
+    typedef boost::mutex Mutex;
+    Mutex mChannelMutex;
+    ChannelMap mChannels;
+
+    // Statistics for time series reporting
+    const String mTimeSeriesMessagesPerWriteName;
+    const String mTimeSeriesQueueDelayName;
 };
 
 } //end namespace js
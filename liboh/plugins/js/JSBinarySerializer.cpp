@@ -0,0 +1,537 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "JSBinarySerializer.hpp"
+#include "JSSerializer.hpp"
+#include "EmersonScript.hpp"
+#include "JSLogging.hpp"
+#include "JSObjects/JSFields.hpp"
+#include "JSObjectStructs/JSVisibleStruct.hpp"
+#include "JSObjectStructs/JSPresenceStruct.hpp"
+
+#include <cstring>
+
+namespace Sirikata {
+namespace JS {
+
+namespace {
+
+enum Tag {
+    TAG_UNDEFINED = 0,
+    TAG_NULL = 1,
+    TAG_FALSE = 2,
+    TAG_TRUE = 3,
+    // Zigzag encoded varint
+    TAG_INT32 = 4,
+    TAG_UINT32 = 5,
+    // 8 bytes, little endian
+    TAG_DOUBLE = 6,
+    // Length, then UTF-8 bytes
+    TAG_STRING = 7,
+    // Objects, arrays and functions are followed by their fields: a count,
+    // then the name and value of each field. Functions have their text
+    // before their fields.
+    TAG_OBJECT = 8,
+    TAG_ARRAY = 9,
+    TAG_FUNCTION = 10,
+    // The sender's Object.prototype
+    TAG_ROOT_OBJECT = 11,
+    // The number of an object that was already encoded
+    TAG_REFERENCE = 12,
+    // Followed by the SpaceObjectReference as a string. Presences are also
+    // encoded as visibles.
+    TAG_VISIBLE = 13,
+    TAG_SYSTEM = 14
+};
+
+} // namespace
+
+
+class JSBinarySerializer::Writer {
+public:
+    Writer()
+     : mNextID(0),
+       mRootObject(v8::Object::New()->GetPrototype())
+    {
+        mOut.reserve(256);
+        mOut.push_back((char)MAGIC);
+        mOut.push_back((char)VERSION);
+    }
+
+    String& output() { return mOut; }
+
+    void writeValue(v8::Handle<v8::Value> val) {
+        if (val->IsNull()) {
+            writeByte(TAG_NULL);
+        }
+        else if (val->IsUndefined()) {
+            writeByte(TAG_UNDEFINED);
+        }
+        else if (val->IsObject()) {
+            // Includes arrays and functions
+            v8::Handle<v8::Object> obj = val->ToObject();
+            uint32 id;
+            if (lookup(obj, &id)) {
+                writeByte(TAG_REFERENCE);
+                writeVarint(id);
+            }
+            else {
+                writeObject(obj);
+            }
+        }
+        else if (val->IsInt32()) {
+            int32 i = val->Int32Value();
+            writeByte(TAG_INT32);
+            writeVarint(((uint32)i << 1) ^ (uint32)(i >> 31));
+        }
+        else if (val->IsUint32()) {
+            writeByte(TAG_UINT32);
+            writeVarint(val->Uint32Value());
+        }
+        else if (val->IsString()) {
+            writeByte(TAG_STRING);
+            writeString(val->ToString());
+        }
+        else if (val->IsNumber()) {
+            writeByte(TAG_DOUBLE);
+            writeDouble(val->NumberValue());
+        }
+        else if (val->IsBoolean()) {
+            writeByte(val->BooleanValue() ? TAG_TRUE : TAG_FALSE);
+        }
+        else {
+            JSLOG(error, "Binary serializer can't encode value, encoding undefined instead.");
+            writeByte(TAG_UNDEFINED);
+        }
+    }
+
+private:
+    void writeByte(uint8 b) {
+        mOut.push_back((char)b);
+    }
+
+    void writeVarint(uint32 v) {
+        while(v >= 0x80) {
+            mOut.push_back((char)((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        mOut.push_back((char)v);
+    }
+
+    void writeDouble(float64 d) {
+        uint64 bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        for(int i = 0; i < 8; i++)
+            mOut.push_back((char)((bits >> (8*i)) & 0xFF));
+    }
+
+    void writeString(const char* data, uint32 len) {
+        writeVarint(len);
+        mOut.append(data, len);
+    }
+    void writeString(const String& str) {
+        writeString(str.data(), str.size());
+    }
+    void writeString(v8::Handle<v8::String> str) {
+        v8::String::Utf8Value utf8(str);
+        writeString(*utf8 == NULL ? "" : *utf8, utf8.length());
+    }
+
+    // Objects are found by identity hash, then compared directly since
+    // hashes can collide.
+    bool lookup(v8::Handle<v8::Object> obj, uint32* id) {
+        std::pair<IdentityMap::iterator, IdentityMap::iterator> range = mIDs.equal_range(obj->GetIdentityHash());
+        for(IdentityMap::iterator it = range.first; it != range.second; it++) {
+            if (it->second.first == obj) {
+                *id = it->second.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void assignID(v8::Handle<v8::Object> obj) {
+        mIDs.insert(IdentityMap::value_type(obj->GetIdentityHash(), std::make_pair(obj, mNextID)));
+        mNextID++;
+    }
+
+    // Mirrors JSSerializer::serializeObjectInternal
+    void writeObject(v8::Handle<v8::Object> obj) {
+        assignID(obj);
+
+        if (obj->InternalFieldCount() > 0) {
+            v8::Local<v8::Value> typeidVal = obj->GetInternalField(TYPEID_FIELD);
+            if (!typeidVal.IsEmpty() && !typeidVal->IsNull() && !typeidVal->IsUndefined()) {
+                v8::Local<v8::External> wrapped = v8::Local<v8::External>::Cast(typeidVal);
+                std::string* typeId = static_cast<std::string*>(wrapped->Value());
+                std::string err_msg;
+                if (typeId != NULL && *typeId == VISIBLE_TYPEID_STRING) {
+                    JSVisibleStruct* vstruct = JSVisibleStruct::decodeVisible(obj, err_msg);
+                    writeByte(TAG_VISIBLE);
+                    writeString(vstruct == NULL ? String() : vstruct->getSporef().toString());
+                }
+                else if (typeId != NULL && *typeId == PRESENCE_TYPEID_STRING) {
+                    JSPresenceStruct* pstruct = JSPresenceStruct::decodePresenceStruct(obj, err_msg);
+                    writeByte(TAG_VISIBLE);
+                    writeString(pstruct == NULL ? String() : pstruct->getSporef().toString());
+                }
+                else if (typeId != NULL && *typeId == SYSTEM_TYPEID_STRING) {
+                    writeByte(TAG_SYSTEM);
+                }
+                else {
+                    // Other native objects can't be shipped, send an empty
+                    // object in their place
+                    writeByte(TAG_OBJECT);
+                    writeVarint(0);
+                }
+                return;
+            }
+        }
+
+        if (obj->IsFunction()) {
+            writeByte(TAG_FUNCTION);
+            v8::Local<v8::String> funcText = v8::Handle<v8::Function>::Cast(obj)->ToString();
+            v8::String::Utf8Value utf8(funcText);
+            String text(*utf8 == NULL ? "" : *utf8, utf8.length());
+            writeString(text);
+            if (text == FUNCTION_CONSTRUCTOR_TEXT) {
+                writeVarint(0);
+                return;
+            }
+        }
+        else if (obj->IsArray()) {
+            writeByte(TAG_ARRAY);
+        }
+        else if (obj == mRootObject) {
+            writeByte(TAG_ROOT_OBJECT);
+        }
+        else {
+            writeByte(TAG_OBJECT);
+        }
+
+        // Collect fields first since native functions are dropped and we need
+        // the count up front
+        std::vector<String> properties = getOwnPropertyNames(v8::Local<v8::Object>::New(obj));
+        std::vector<v8::Local<v8::Value> > values;
+        values.reserve(properties.size());
+        uint32 count = 0;
+        for(uint32 i = 0; i < properties.size(); i++) {
+            v8::Local<v8::Value> prop_val;
+            if (properties[i] == JSSERIALIZER_PROTOTYPE_NAME)
+                prop_val = obj->GetPrototype();
+            else
+                prop_val = obj->Get(v8::String::New(properties[i].c_str(), properties[i].size()));
+
+            if (prop_val->IsFunction()) {
+                v8::String::Utf8Value funcText(v8::Local<v8::Function>::Cast(prop_val)->ToString());
+                String text(*funcText == NULL ? "" : *funcText, funcText.length());
+                if (text.find("{ [native code] }") != String::npos && text != FUNCTION_CONSTRUCTOR_TEXT)
+                    prop_val.Clear();
+            }
+            values.push_back(prop_val);
+            if (!prop_val.IsEmpty()) count++;
+        }
+
+        writeVarint(count);
+        for(uint32 i = 0; i < properties.size(); i++) {
+            if (values[i].IsEmpty()) continue;
+            writeString(properties[i]);
+            writeValue(values[i]);
+        }
+    }
+
+    String mOut;
+    uint32 mNextID;
+    typedef std::tr1::unordered_multimap<int, std::pair<v8::Handle<v8::Object>, uint32> > IdentityMap;
+    IdentityMap mIDs;
+    v8::Handle<v8::Value> mRootObject;
+};
+
+
+class JSBinarySerializer::Reader {
+public:
+    Reader(EmersonScript* emerScript, const String& data)
+     : mEmerScript(emerScript),
+       mPos((const uint8*)data.data() + 2),
+       mEnd((const uint8*)data.data() + data.size()),
+       mFailed(false)
+    {
+    }
+
+    bool failed() const { return mFailed; }
+    bool done() const { return mPos == mEnd; }
+
+    // depth is the number of objects the value is nested in
+    v8::Handle<v8::Value> readValue(uint32 depth) {
+        uint8 tag = readByte();
+        if (mFailed) return v8::Undefined();
+
+        switch(tag) {
+          case TAG_UNDEFINED: return v8::Undefined();
+          case TAG_NULL: return v8::Null();
+          case TAG_FALSE: return v8::False();
+          case TAG_TRUE: return v8::True();
+          case TAG_INT32:
+            {
+                uint32 v = readVarint();
+                return v8::Integer::New((int32)((v >> 1) ^ (~(v & 1) + 1)));
+            }
+          case TAG_UINT32: return v8::Integer::NewFromUnsigned(readVarint());
+          case TAG_DOUBLE: return v8::Number::New(readDouble());
+          case TAG_STRING:
+            {
+                uint32 len = readLength();
+                if (mFailed) return v8::Undefined();
+                v8::Handle<v8::String> str = v8::String::New((const char*)mPos, len);
+                mPos += len;
+                return str;
+            }
+          case TAG_OBJECT:
+          case TAG_ROOT_OBJECT:
+            {
+                v8::Handle<v8::Object> obj = v8::Object::New();
+                addObject(obj, tag == TAG_ROOT_OBJECT);
+                readFields(obj, depth);
+                return obj;
+            }
+          case TAG_ARRAY:
+            {
+                v8::Handle<v8::Object> arr = v8::Array::New();
+                addObject(arr, false);
+                readFields(arr, depth);
+                return arr;
+            }
+          case TAG_FUNCTION:
+            {
+                String text = readString();
+                if (mFailed) return v8::Undefined();
+                v8::Handle<v8::Object> func = functionValue(text);
+                addObject(func, false);
+                readFields(func, depth);
+                return func;
+            }
+          case TAG_REFERENCE:
+            {
+                uint32 id = readVarint();
+                if (mFailed || id >= mObjects.size()) {
+                    JSLOG(error, "Error deserializing reference to " << id << ". No record of that object.");
+                    mFailed = true;
+                    return v8::Undefined();
+                }
+                return mObjects[id];
+            }
+          case TAG_VISIBLE:
+            {
+                String sporef = readString();
+                if (mFailed) return v8::Undefined();
+                v8::Handle<v8::Object> vis = mEmerScript->createVisibleWeakPersistent(SpaceObjectReference(sporef), JSVisibleDataPtr());
+                addObject(vis, false);
+                return vis;
+            }
+          case TAG_SYSTEM:
+            {
+                v8::Handle<v8::Object> sys = v8::Object::New();
+                sys->Set(v8::String::New("builtin"), v8::String::New("[object system]"));
+                addObject(sys, false);
+                return sys;
+            }
+          default:
+            JSLOG(error, "Error deserializing: unknown tag " << (int)tag);
+            mFailed = true;
+            return v8::Undefined();
+        }
+    }
+
+    // Prototypes that referred to objects that were already being decoded are
+    // only set once everything has been decoded, like JSSerializer's fixups.
+    void performFixups() {
+        for(uint32 i = 0; i < mPrototypeFixups.size(); i++) {
+            uint32 id = mPrototypeFixups[i].second;
+            setPrototype(mPrototypeFixups[i].first, mObjects[id], mRootObjects[id]);
+        }
+    }
+
+private:
+    uint8 readByte() {
+        if (mPos >= mEnd) {
+            mFailed = true;
+            return 0;
+        }
+        return *mPos++;
+    }
+
+    uint32 readVarint() {
+        uint32 result = 0;
+        for(uint32 shift = 0; shift < 35; shift += 7) {
+            uint8 b = readByte();
+            if (mFailed) return 0;
+            result |= (uint32)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+                return result;
+        }
+        mFailed = true;
+        return 0;
+    }
+
+    // A varint giving the length of data that follows, which must fit in
+    // what's left
+    uint32 readLength() {
+        uint32 len = readVarint();
+        if (!mFailed && len > (uint32)(mEnd - mPos))
+            mFailed = true;
+        return mFailed ? 0 : len;
+    }
+
+    float64 readDouble() {
+        if (mEnd - mPos < 8) {
+            mFailed = true;
+            return 0;
+        }
+        uint64 bits = 0;
+        for(int i = 0; i < 8; i++)
+            bits |= (uint64)mPos[i] << (8*i);
+        mPos += 8;
+        float64 d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+
+    String readString() {
+        uint32 len = readLength();
+        if (mFailed) return String();
+        String result((const char*)mPos, len);
+        mPos += len;
+        return result;
+    }
+
+    void addObject(v8::Handle<v8::Object> obj, bool root) {
+        mObjects.push_back(obj);
+        mRootObjects.push_back(root);
+    }
+
+    v8::Handle<v8::Object> functionValue(const String& text) {
+        if (text != FUNCTION_CONSTRUCTOR_TEXT)
+            return mEmerScript->functionValue(text);
+
+        v8::Local<v8::Function> tmpFun = mEmerScript->functionValue("function(){}");
+        v8::Local<v8::String> constructorName = v8::String::New("constructor");
+        if (tmpFun->Has(constructorName) && tmpFun->Get(constructorName)->IsFunction())
+            return v8::Handle<v8::Function>::Cast(tmpFun->Get(constructorName));
+        JSLOG(error, "Error setting the constructor of an object.  Setting to dummy constructor.");
+        return tmpFun;
+    }
+
+    void setPrototype(v8::Handle<v8::Object> obj, v8::Handle<v8::Value> proto, bool protoIsRoot) {
+        if (proto.IsEmpty() || proto->IsUndefined() || proto->IsNull())
+            return;
+        if (!proto->IsObject())
+            obj->SetPrototype(proto);
+        else if (protoIsRoot)
+            obj->SetPrototype(proto);
+        else
+            JSSerializer::shallowCopyFields(obj, proto->ToObject());
+    }
+
+    // Reads the fields of obj, which is nested depth deep
+    void readFields(v8::Handle<v8::Object> obj, uint32 depth) {
+        if (depth >= JSBinarySerializer::MAX_DEPTH) {
+            JSLOG(error, "Error deserializing: objects nested more than " << (uint32)JSBinarySerializer::MAX_DEPTH << " deep.");
+            mFailed = true;
+            return;
+        }
+
+        uint32 count = readVarint();
+        for(uint32 i = 0; i < count && !mFailed; i++) {
+            uint32 len = readLength();
+            if (mFailed) return;
+            const char* name = (const char*)mPos;
+            mPos += len;
+
+            if (len == std::strlen(JSSERIALIZER_PROTOTYPE_NAME) &&
+                std::memcmp(name, JSSERIALIZER_PROTOTYPE_NAME, len) == 0)
+            {
+                // References are fixed up at the end, everything else can be
+                // set right away
+                if (mPos < mEnd && *mPos == TAG_REFERENCE) {
+                    uint32 before = mObjects.size();
+                    readByte();
+                    uint32 id = readVarint();
+                    if (mFailed || id >= before) {
+                        mFailed = true;
+                        return;
+                    }
+                    mPrototypeFixups.push_back(std::make_pair(obj, id));
+                }
+                else {
+                    // An object value is always the first one numbered while
+                    // reading it
+                    uint32 id = mObjects.size();
+                    v8::Handle<v8::Value> proto = readValue(depth + 1);
+                    setPrototype(obj, proto, id < mObjects.size() && mRootObjects[id]);
+                }
+            }
+            else {
+                v8::Handle<v8::String> key = v8::String::New(name, len);
+                v8::Handle<v8::Value> val = readValue(depth + 1);
+                if (!mFailed)
+                    obj->Set(key, val);
+            }
+        }
+    }
+
+    EmersonScript* mEmerScript;
+    const uint8* mPos;
+    const uint8* mEnd;
+    bool mFailed;
+
+    // Decoded objects, by number, and whether each is the sender's root
+    // object
+    std::vector<v8::Handle<v8::Object> > mObjects;
+    std::vector<bool> mRootObjects;
+    std::vector<std::pair<v8::Handle<v8::Object>, uint32> > mPrototypeFixups;
+};
+
+
+bool JSBinarySerializer::isBinary(const String& data) {
+    return data.size() >= 2 && (uint8)data[0] == MAGIC;
+}
+
+String JSBinarySerializer::serialize(v8::Handle<v8::Value> val) {
+    v8::HandleScope handle_scope;
+    Writer writer;
+    writer.writeValue(val);
+    return writer.output();
+}
+
+v8::Handle<v8::Value> JSBinarySerializer::deserialize(EmersonScript* emerScript, const String& data, bool& deserializeSuccessful) {
+    deserializeSuccessful = false;
+
+    //error if not in context, won't be able to create a new v8 object.
+    //should just abort here before seg faulting.
+    if (! v8::Context::InContext())
+    {
+        JSLOG(error, "Error when deserializing.  Am not inside a v8 context.  Aborting.");
+        return v8::Undefined();
+    }
+
+    if (!isBinary(data) || (uint8)data[1] != VERSION) {
+        JSLOG(error, "Error when deserializing.  Unknown binary format version.");
+        return v8::Undefined();
+    }
+
+    v8::HandleScope handle_scope;
+    Reader reader(emerScript, data);
+    v8::Handle<v8::Value> result = reader.readValue(0);
+    if (reader.failed() || !reader.done()) {
+        JSLOG(error, "Error when deserializing.  Data was truncated or corrupt.");
+        return v8::Undefined();
+    }
+    reader.performFixups();
+
+    deserializeSuccessful = true;
+    return handle_scope.Close(result);
+}
+
+} // namespace JS
+} // namespace Sirikata
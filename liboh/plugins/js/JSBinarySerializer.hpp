@@ -0,0 +1,63 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef __SIRIKATA_JS_BINARY_SERIALIZER_HPP__
+#define __SIRIKATA_JS_BINARY_SERIALIZER_HPP__
+
+#include <sirikata/oh/Platform.hpp>
+#include <v8.h>
+
+namespace Sirikata {
+namespace JS {
+
+class EmersonScript;
+
+/** Compact binary encoding of Emerson values, an alternative to the protocol
+ *  buffer based encoding in JSSerializer which produces the same values when
+ *  decoded.
+ *
+ *  Every value is a one byte tag followed by its data: varints for integers
+ *  and lengths, raw bytes for doubles and strings. Objects, arrays and
+ *  functions are numbered in the order they are first encountered and later
+ *  references to them are encoded as that number, so cycles are found with a
+ *  map from object identity rather than by marking the objects themselves.
+ *  Decoding builds V8 values directly from the buffer and, since an object is
+ *  always encoded before any reference to it, only prototypes need fixing up
+ *  afterwards.
+ *
+ *  Encoded data starts with MAGIC and a version byte. No protocol buffer can
+ *  start with MAGIC, so both formats can be accepted wherever serialized data
+ *  is received.
+ */
+class JSBinarySerializer {
+public:
+    enum {
+        MAGIC = 0xFF,
+        VERSION = 1,
+        // Deepest nesting of objects, arrays and functions that will be
+        // decoded. Data comes from remote object hosts, so this keeps
+        // malicious input from overflowing the stack. Matches protobuf's
+        // default recursion limit, which protected the old format.
+        MAX_DEPTH = 64
+    };
+
+    /** Returns true if data looks like it was produced by serialize(). */
+    static bool isBinary(const String& data);
+
+    /** Encode a value. Must be called from within a v8 context. */
+    static String serialize(v8::Handle<v8::Value> val);
+    /** Decode a value produced by serialize(). Must be called from within a v8
+     *  context.
+     */
+    static v8::Handle<v8::Value> deserialize(EmersonScript* emerScript, const String& data, bool& deserializeSuccessful);
+
+private:
+    class Writer;
+    class Reader;
+};
+
+} // namespace JS
+} // namespace Sirikata
+
+#endif //__SIRIKATA_JS_BINARY_SERIALIZER_HPP__
@@ -114,6 +114,7 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
     OptionValue* import_paths;
     OptionValue* v8_flags_opt;
     OptionValue* emer_resource_max;
+    OptionValue* serialization_format;
     InitializeClassOptions(
         "jsobjectscriptmanager",this,
         // Default value allows us to use std libs in the build tree, starting
@@ -133,6 +134,7 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
         import_paths = new OptionValue("import-paths","",OptionValueType<std::list<String> >(),"Comma separated list of paths to import files from, searched in order for the requested import."),
         v8_flags_opt = new OptionValue("v8-flags", "", OptionValueType<String>(), "Flags to pass on to v8, e.g. for profiling."),
         emer_resource_max = new OptionValue("emer-resource-max","100000000",OptionValueType<int>(),"int32: how many cycles to allow to run in one pass of event loop before throwing resource error in Emerson."),
+        serialization_format = new OptionValue("serialization-format","binary",OptionValueType<String>(),"Format to serialize messages and state in: binary or pbj. Both are always accepted, but use pbj when talking to older object hosts."),
         NULL
     );
 
@@ -143,6 +145,12 @@ JSObjectScriptManager::JSObjectScriptManager(ObjectHostContext* ctx, const Sirik
     if (!v8_flags.empty()) {
         v8::V8::SetFlagsFromString(v8_flags.c_str(), v8_flags.size());
     }
+
+    JSSerializer::Format serialization_fmt;
+    if (JSSerializer::parseFormat(serialization_format->as<String>(), &serialization_fmt))
+        JSSerializer::setDefaultFormat(serialization_fmt);
+    else
+        SILOG(js,error,"Unknown serialization format " << serialization_format->as<String>() << ", using " << (JSSerializer::defaultFormat() == JSSerializer::FORMAT_BINARY ? "binary" : "pbj"));
 }
 
 /*
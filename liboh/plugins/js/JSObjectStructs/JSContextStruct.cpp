@@ -465,8 +465,10 @@ v8::Handle<v8::Value> JSContextStruct::sendMessageNoErrorHandler(JSPresenceStruc
 
     if (! emerScript->isStopped())
     {
+        // Reliable messages are refused if too much is already queued for
+        // the receiver, let the script know so it can back off.
         if (reliable)
-            emerScript->sendScriptCommMessageReliable(jspres->getSporef(),  jspl->getSporef(),serialized_message);
+            return v8::Boolean::New(emerScript->sendScriptCommMessageReliable(jspres->getSporef(),  jspl->getSporef(),serialized_message));
         else
             emerScript->sendMessageToEntityUnreliable(jspl->getSporef(),jspres->getSporef(),serialized_message);
     }
@@ -514,6 +516,14 @@ v8::Handle<v8::Value> JSContextStruct::deserialize(const String& toDeserialize)
     v8::HandleScope handle_scope;
     CHECK_EMERSON_SCRIPT_ERROR(emerScript,deserialize,jsObjScript);
 
+    if (JSSerializer::isBinaryMessage(toDeserialize))
+    {
+        bool deserializedSuccess = false;
+        v8::Handle<v8::Value> returner = JSSerializer::deserializeBinaryMessage(emerScript, toDeserialize, deserializedSuccess);
+        if (!deserializedSuccess)
+            return v8::ThrowException( v8::Exception::Error(v8::String::New("Error could not deserialize object")));
+        return handle_scope.Close(returner);
+    }
 
     Sirikata::JS::Protocol::JSMessage js_msg;
     bool parsed = js_msg.ParseFromString(toDeserialize);
@@ -591,11 +591,19 @@ v8::Handle<v8::Value> debug_fileWrite(const v8::Arguments& args)
 v8::Handle<v8::Value> root_serialize(const v8::Arguments& args)
 {
     v8::HandleScope handle_scope;
-    if (args.Length() != 1)
-        return v8::ThrowException( v8::Exception::Error(v8::String::New("Error calling serialize.  Must pass in at least one argument to be serialized.")));
+    if ((args.Length() != 1) && (args.Length() != 2))
+        return v8::ThrowException( v8::Exception::Error(v8::String::New("Error calling serialize.  Must pass in at least one argument to be serialized, and optionally the format to use.")));
 
+    //optional second argument selects the format, mostly for comparing them
+    JSSerializer::Format fmt = JSSerializer::defaultFormat();
+    if (args.Length() == 2)
+    {
+        INLINE_STR_CONV_ERROR(args[1],serialize,2,fmtName);
+        if (!JSSerializer::parseFormat(fmtName, &fmt))
+            return v8::ThrowException( v8::Exception::Error(v8::String::New("Error calling serialize.  Format must be 'binary' or 'pbj'.")));
+    }
 
-    String stringifiedValue = JSSerializer::serializeMessage(args[0]);
+    String stringifiedValue = JSSerializer::serializeMessage(args[0], fmt);
 
     String errorMessage = "Error decoding error message when serializing object";
     JSSystemStruct* jsfake  = JSSystemStruct::decodeSystemStruct(args.This(), errorMessage);
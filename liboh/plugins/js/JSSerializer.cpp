@@ -1,6 +1,7 @@
 
 #include "JS_JSMessage.pbj.hpp"
 #include "JSSerializer.hpp"
+#include "JSBinarySerializer.hpp"
 #include <string>
 #include "JSUtil.hpp"
 #include "JSObjects/JSFields.hpp"
@@ -151,8 +152,56 @@ void JSSerializer::serializePresence(v8::Local<v8::Object> jsPresence, Sirikata:
 
 
 
-std::string JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val, int32 toStamp)
+namespace {
+JSSerializer::Format sDefaultFormat = JSSerializer::FORMAT_BINARY;
+}
+
+JSSerializer::Format JSSerializer::defaultFormat()
+{
+    return sDefaultFormat;
+}
+
+void JSSerializer::setDefaultFormat(Format fmt)
+{
+    sDefaultFormat = fmt;
+}
+
+bool JSSerializer::parseFormat(const String& name, Format* fmt_out)
+{
+    if (name == "binary")
+        *fmt_out = FORMAT_BINARY;
+    else if (name == "pbj")
+        *fmt_out = FORMAT_PBJ;
+    else
+        return false;
+    return true;
+}
+
+std::string JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val)
+{
+    return serializeMessage(v8Val, sDefaultFormat);
+}
+
+std::string JSSerializer::serializeMessage(v8::Local<v8::Value> v8Val, Format fmt)
+{
+    if (fmt == FORMAT_BINARY)
+        return JSBinarySerializer::serialize(v8Val);
+    return serializeMessagePBJ(v8Val);
+}
+
+bool JSSerializer::isBinaryMessage(const String& data)
+{
+    return JSBinarySerializer::isBinary(data);
+}
+
+v8::Handle<v8::Value> JSSerializer::deserializeBinaryMessage(EmersonScript* emerScript, const String& data, bool& deserializeSuccessful)
+{
+    return JSBinarySerializer::deserialize(emerScript, data, deserializeSuccessful);
+}
+
+std::string JSSerializer::serializeMessagePBJ(v8::Local<v8::Value> v8Val)
 {
+    int32 toStamp = 0;
     ObjectVec allObjs;
     Sirikata::JS::Protocol::JSFieldValue jsfield;
     v8::HandleScope handleScope;
@@ -52,11 +52,17 @@ typedef std::vector<LoopedObjPointer> LoopedObjPointerList;
 typedef std::map<int32, LoopedObjPointerList> FixupMap;
 typedef FixupMap::iterator FixupMapIter;
 
+// Names of the fields of obj that should be serialized, including
+// JSSERIALIZER_PROTOTYPE_NAME for its prototype
+std::vector<String> getOwnPropertyNames(v8::Local<v8::Object> obj);
+
 void debug_printSerialized(Sirikata::JS::Protocol::JSMessage jm, String prepend);
 void debug_printSerializedFieldVal(Sirikata::JS::Protocol::JSFieldValue jsfieldval, String prepend,String name);
 
 class JSSerializer
 {
+    friend class JSBinarySerializer;
+
     static void pointOtherObject(int32 int32ToPointTo,Sirikata::JS::Protocol::IJSFieldValue& jsf_value);
 
     static void annotateObject(ObjectVec& objVec, v8::Handle<v8::Object> v8Obj,int32 toStampWith);
@@ -89,11 +95,33 @@ class JSSerializer
         int32& toLoopTo);
 
 
+    static std::string serializeMessagePBJ(v8::Local<v8::Value> v8Val);
+
 public:
-    
+    // Encodings produced by serializeMessage. Both are always accepted when
+    // deserializing.
+    enum Format {
+        // Nested JSFieldValue/JSMessage protocol buffers
+        FORMAT_PBJ,
+        // See JSBinarySerializer
+        FORMAT_BINARY
+    };
+    static Format defaultFormat();
+    static void setDefaultFormat(Format fmt);
+    // Parse a format name, "pbj" or "binary", returning false if it isn't
+    // recognized
+    static bool parseFormat(const String& name, Format* fmt_out);
+
     //deprecated
     static std::string serializeObject(v8::Local<v8::Value> v8Val,int32 toStamp = 0);
-    static std::string serializeMessage(v8::Local<v8::Value> v8Val, int32 toStamp=0);
+    static std::string serializeMessage(v8::Local<v8::Value> v8Val);
+    static std::string serializeMessage(v8::Local<v8::Value> v8Val, Format fmt);
+
+    // Returns true if data was serialized with FORMAT_BINARY, in which case it
+    // must be decoded with deserializeBinaryMessage.
+    static bool isBinaryMessage(const String& data);
+    //must be called from within a v8 context
+    static v8::Handle<v8::Value> deserializeBinaryMessage(EmersonScript* emerScript, const String& data, bool& deserializeSuccessful);
 
     //both of these must be called from within a v8 context
     static v8::Handle<v8::Value> deserializeMessage( EmersonScript* emerScript, Sirikata::JS::Protocol::JSFieldValue jsfieldval,bool& deserializeSuccessful);
@@ -88,9 +88,6 @@ void JSVisibleManager::iOnCreateProxy(Liveness::Token alive, ProxyObjectPtr p)
     if (!locked) return;
 
     RMutex::scoped_lock(vmMtx);
-    p->PositionProvider::addListener(this);
-    p->MeshProvider::addListener(this);
-
     JSAggregateVisibleDataPtr data = getOrCreateVisible(p->getObjectReference());
     data->updateFrom(p);
     data->incref(data);
@@ -116,60 +113,40 @@ void JSVisibleManager::iOnDestroyProxy(Liveness::Token alive, ProxyObjectPtr p)
 void JSVisibleManager::iOnDestroyProxyWithoutLiveness(ProxyObjectPtr p)
 {
     RMutex::scoped_lock(vmMtx);
-    p->PositionProvider::removeListener(this);
-    p->MeshProvider::removeListener(this);
-
     JSAggregateVisibleDataPtr data = getOrCreateVisible(p->getObjectReference());
     data->updateFrom(p);
     data->decref();
     mTrackedObjects.erase(p);
 }
 
-void JSVisibleManager::updateLocation(ProxyObjectPtr proxy, const TimedMotionVector3f &newLocation, const TimedMotionQuaternion& newOrient, const AggregateBoundingInfo& newBounds,const SpaceObjectReference& sporef) {
-    mCtx->visManStrand->post(
-        std::tr1::bind(&JSVisibleManager::iUpdatedProxy, this, mParentLiveness->livenessToken(), proxy),
-        "JSVisibleManager::iUpdatedProxy"
-    );
-}
-
+void JSVisibleManager::onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes) {
+    // One post for the whole batch instead of one per property per proxy
+    std::vector<ProxyObjectPtr> proxies;
+    proxies.reserve(changes.size());
+    for(ProxyChangeList::const_iterator it = changes.begin(); it != changes.end(); it++)
+        proxies.push_back(it->proxy);
 
-void JSVisibleManager::onSetMesh(ProxyObjectPtr proxy, Transfer::URI const& newMesh,const SpaceObjectReference& sporef) {
     mCtx->visManStrand->post(
-        std::tr1::bind(&JSVisibleManager::iUpdatedProxy, this, mParentLiveness->livenessToken(), proxy),
-        "JSVisibleManager::iUpdatedProxy"
+        std::tr1::bind(&JSVisibleManager::iUpdatedProxies, this, mParentLiveness->livenessToken(), proxies),
+        "JSVisibleManager::iUpdatedProxies"
     );
 }
 
-void JSVisibleManager::onSetScale(ProxyObjectPtr proxy, float32 newScale ,const SpaceObjectReference& sporef) {
-    mCtx->visManStrand->post(
-        std::tr1::bind(&JSVisibleManager::iUpdatedProxy, this, mParentLiveness->livenessToken(), proxy),
-        "JSVisibleManager::iUpdatedProxy"
-    );
-}
-
-void JSVisibleManager::onSetPhysics(ProxyObjectPtr proxy, const String& newphy,const SpaceObjectReference& sporef) {
-    mCtx->visManStrand->post(
-        std::tr1::bind(&JSVisibleManager::iUpdatedProxy, this, mParentLiveness->livenessToken(), proxy),
-        "JSVisibleManager::iUpdatedProxy"
-    );
-}
-
-void JSVisibleManager::onSetIsAggregate(ProxyObjectPtr proxy, bool isAggregate, const SpaceObjectReference& sporef) {
-    mCtx->visManStrand->post(
-        std::tr1::bind(&JSVisibleManager::iUpdatedProxy, this, mParentLiveness->livenessToken(), proxy),
-        "JSVisibleManager::iUpdatedProxy"
-    );
-}
-
-void JSVisibleManager::iUpdatedProxy(Liveness::Token alive, ProxyObjectPtr p)
+void JSVisibleManager::iUpdatedProxies(Liveness::Token alive, const std::vector<ProxyObjectPtr>& proxies)
 {
     if (!alive) return;
     Liveness::Lock locked(alive);
     if (!locked) return;
 
     RMutex::scoped_lock(vmMtx);
-    JSAggregateVisibleDataPtr data = getOrCreateVisible(p->getObjectReference());
-    data->updateFrom(p);
+    for(std::vector<ProxyObjectPtr>::const_iterator it = proxies.begin(); it != proxies.end(); it++) {
+        // Like per-proxy listeners, only proxies we've been told about via
+        // onCreateProxy and haven't been destroyed yet are tracked
+        if (mTrackedObjects.find(*it) == mTrackedObjects.end())
+            continue;
+        JSAggregateVisibleDataPtr data = getOrCreateVisible((*it)->getObjectReference());
+        data->updateFrom(*it);
+    }
 }
 
 bool JSVisibleManager::isVisible(const SpaceObjectReference& sporef)
@@ -5,6 +5,7 @@
 #include <sirikata/core/util/SpaceObjectReference.hpp>
 #include <sirikata/proxyobject/ProxyObject.hpp>
 #include <sirikata/proxyobject/ProxyCreationListener.hpp>
+#include <sirikata/proxyobject/ProxyUpdateBatchListener.hpp>
 #include "JSUtil.hpp"
 #include "JSCtx.hpp"
 #include "JSVisibleData.hpp"
@@ -41,8 +42,7 @@ class JSVisibleStruct;
 class JSVisibleManager :
         public ProxyCreationListener,
         public JSVisibleDataListener,
-        public PositionListener,
-        public MeshListener
+        public ProxyUpdateBatchListener
 {
 public:
     JSVisibleManager(JSCtx* ctx, Liveness* parent_liveness);
@@ -74,17 +74,10 @@ public:
     virtual void onCreateProxy(ProxyObjectPtr p);
     virtual void onDestroyProxy(ProxyObjectPtr p);
 
-    // PositionListener
-    //  - Updates JSProxyData state
+    // ProxyUpdateBatchListener Interface
+    //  - Updates JSProxyData state for all changed proxies at once
     //  - Destruction ignored, handled by onDestroyProxy
-    virtual void updateLocation (ProxyObjectPtr proxy, const TimedMotionVector3f &newLocation, const TimedMotionQuaternion& newOrient, const AggregateBoundingInfo& newBounds,const SpaceObjectReference& sporef);
-
-    // MeshListener Interface
-    //  - Updates JSProxyData state
-    virtual void onSetMesh (ProxyObjectPtr proxy, Transfer::URI const& newMesh,const SpaceObjectReference& sporef);
-    virtual void onSetScale (ProxyObjectPtr proxy, float32 newScale ,const SpaceObjectReference& sporef);
-    virtual void onSetPhysics (ProxyObjectPtr proxy, const String& newphy,const SpaceObjectReference& sporef);
-    virtual void onSetIsAggregate(ProxyObjectPtr proxy, bool isAggregate, const SpaceObjectReference& sporef);
+    virtual void onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes);
 
     // Indicate whether this object is still visible to on of your presences or
     // not.
@@ -98,8 +91,8 @@ protected:
     void iOnDestroyProxyWithoutLiveness(ProxyObjectPtr p);
 
 
-    // Invoked when we received an update on a Proxy, making it the most up-to-date.
-    void iUpdatedProxy(Liveness::Token alive, ProxyObjectPtr p);
+    // Invoked when we received updates on Proxies, making them the most up-to-date.
+    void iUpdatedProxies(Liveness::Token alive, const std::vector<ProxyObjectPtr>& proxies);
 
 private:
 
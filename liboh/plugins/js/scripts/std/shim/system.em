@@ -730,10 +730,13 @@ PresenceEntry.prototype.proxRemovedEvent = function (visibleObj,visTo)
        @param Which presence to send from.
        @param Message object to send.
        @param Visible to send to.
+       @return false if the message was not sent because too much data
+       is already waiting to be sent to the visible. Back off and try
+       again later.
        */
       system.sendMessage = function()
       {
-          baseSystem.sendMessage.apply(baseSystem, arguments);
+          return baseSystem.sendMessage.apply(baseSystem, arguments);
       };
 
 
@@ -1045,6 +1048,9 @@ PresenceEntry.prototype.proxRemovedEvent = function (visibleObj,visTo)
       
       /** @function
        @param Object to be serialized.
+       @param {String} format (optional) 'binary' or 'pbj'.  Defaults to
+       the object host's serialization-format option.  Use 'pbj' when the
+       data will be read by an older object host.
 
        @return Returns a string representing the serialized object.
        Takes an object and serializes it to be sent over the network, producing a string.
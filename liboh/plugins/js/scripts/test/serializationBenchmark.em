@@ -0,0 +1,135 @@
+/**
+ serializationBenchmark -- Times system.serialize and system.deserialize
+ on a few representative object graphs in each serialization format and
+ prints operations per second and the size of the serialized data.
+ */
+
+var formats = ['pbj', 'binary'];
+var iterations = 200;
+
+
+function flatGraph()
+{
+    var obj = { };
+    for (var i = 0; i < 20; ++i)
+    {
+        obj['int' + i] = i * 37;
+        obj['dbl' + i] = i / 7;
+        obj['str' + i] = 'value' + i;
+        obj['bool' + i] = (i % 2 == 0);
+    }
+    return obj;
+}
+
+function treeGraph(depth, breadth)
+{
+    var obj = {'depth': depth, 'name': 'node' + depth};
+    if (depth == 0)
+        return obj;
+    obj.children = [];
+    for (var i = 0; i < breadth; ++i)
+        obj.children.push(treeGraph(depth - 1, breadth));
+    return obj;
+}
+
+function numberArrayGraph()
+{
+    var arr = [];
+    for (var i = 0; i < 1000; ++i)
+        arr.push(i * 3 - 500);
+    return arr;
+}
+
+function stringGraph()
+{
+    var arr = [];
+    var str = '';
+    for (var i = 0; i < 64; ++i)
+        str += String.fromCharCode(97 + (i % 26));
+    for (var i = 0; i < 100; ++i)
+        arr.push(str + i);
+    return arr;
+}
+
+function cyclicGraph()
+{
+    var nodes = [];
+    for (var i = 0; i < 50; ++i)
+        nodes.push({'index': i});
+    for (var i = 0; i < nodes.length; ++i)
+    {
+        nodes[i].next = nodes[(i + 1) % nodes.length];
+        nodes[i].prev = nodes[(i + nodes.length - 1) % nodes.length];
+    }
+    return {'head': nodes[0], 'all': nodes};
+}
+
+function Vec(x, y, z)
+{
+    this.x = x;
+    this.y = y;
+    this.z = z;
+}
+Vec.prototype.length = function()
+{
+    return Math.sqrt(this.x*this.x + this.y*this.y + this.z*this.z);
+};
+
+function prototypeGraph()
+{
+    var arr = [];
+    for (var i = 0; i < 50; ++i)
+        arr.push(new Vec(i, i*2, i*3));
+    arr.push(function(a, b) { return a + b; });
+    return arr;
+}
+
+
+function timeFormat(graph, format)
+{
+    var serialized = system.serialize(graph, format);
+
+    var start = new Date();
+    for (var i = 0; i < iterations; ++i)
+        system.serialize(graph, format);
+    var serializeMS = new Date() - start;
+
+    start = new Date();
+    for (var i = 0; i < iterations; ++i)
+        system.deserialize(serialized);
+    var deserializeMS = new Date() - start;
+
+    return {
+        'size': serialized.length,
+        'serialize': iterations * 1000 / Math.max(serializeMS, 1),
+        'deserialize': iterations * 1000 / Math.max(deserializeMS, 1)
+    };
+}
+
+function runBenchmark()
+{
+    var graphs = [
+        ['flat', flatGraph()],
+        ['tree', treeGraph(4, 4)],
+        ['numbers', numberArrayGraph()],
+        ['strings', stringGraph()],
+        ['cyclic', cyclicGraph()],
+        ['prototypes', prototypeGraph()]
+    ];
+
+    system.print('graph\tformat\tbytes\tser/s\tdeser/s\n');
+    for (var g in graphs)
+    {
+        for (var f in formats)
+        {
+            var res = timeFormat(graphs[g][1], formats[f]);
+            system.print(graphs[g][0] + '\t' + formats[f] + '\t' + res.size + '\t' +
+                         Math.round(res.serialize) + '\t' + Math.round(res.deserialize) + '\n');
+        }
+    }
+}
+
+system.onPresenceConnected(function() {
+    runBenchmark();
+    system.killEntity();
+});
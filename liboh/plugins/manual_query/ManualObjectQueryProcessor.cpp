@@ -245,7 +245,7 @@ void ManualObjectQueryProcessor::deliverProximityResult(const SpaceObjectReferen
     if (!ho) return;
 
     // Should already be in local time, so we can deliver directly
-    deliverProximityUpdate(ho, sporef, update);
+    postProximityUpdate(ho, sporef, update);
 }
 
 void ManualObjectQueryProcessor::deliverLocationResult(const SpaceObjectReference& sporef, const LocUpdate& lu) {
@@ -256,7 +256,7 @@ void ManualObjectQueryProcessor::deliverLocationResult(const SpaceObjectReferenc
     HostedObjectPtr ho = it->second.who.lock();
     if (!ho) return;
 
-    deliverLocationUpdate(ho, sporef, lu);
+    postLocationUpdate(ho, sporef, lu);
 }
 
 
@@ -55,6 +55,14 @@ void ServerQueryHandler::onSpaceNodeSession(const OHDP::SpaceNodeID& id, OHDPSST
             id, _1, _2
         )
     );
+    OHDPSST::ConnectionPtr conn = sn_stream->connection().lock();
+    if (conn) {
+        conn->registerReadDatagramCallback(OBJECT_PORT_LOCATION,
+            std::tr1::bind(&ServerQueryHandler::handleLocationDatagram, this,
+                id, _1, _2
+            )
+        );
+    }
 
     mParent->createdServerQuery(id);
 }
@@ -291,6 +299,25 @@ void ServerQueryHandler::handleLocationSubstream(const OHDP::SpaceNodeID& snid,
 }
 
 void ServerQueryHandler::handleLocationSubstreamRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr s, std::stringstream* prevdata, uint8* buffer, int length) {
+    // A long-lived location stream starts with a Network::Frame, whose length
+    // always has a zero high byte, where a single update would start with a
+    // Protocol::Frame.
+    if (prevdata->tellp() == 0 && length > 0 && buffer[0] == 0) {
+        delete prevdata;
+        std::tr1::shared_ptr<String> framedata(new String());
+        // Updates on the channel may use the compact encoding, which needs
+        // one decoder to see all of them
+        CompactLocUpdateDecoderPtr decoder(new CompactLocUpdateDecoder());
+        s->registerReadCallback(
+            std::tr1::bind(
+                &ServerQueryHandler::handleLocationChannelRead, this,
+                snid, s, framedata, decoder, _1, _2
+            )
+        );
+        handleLocationChannelRead(snid, s, framedata, decoder, buffer, length);
+        return;
+    }
+
     prevdata->write((const char*)buffer, length);
     if (handleLocationMessage(snid, prevdata->str())) {
         // FIXME we should be getting a callback on stream close instead of
@@ -303,17 +330,52 @@ void ServerQueryHandler::handleLocationSubstreamRead(const OHDP::SpaceNodeID& sn
     }
 }
 
+void ServerQueryHandler::handleLocationChannelRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length) {
+    prevdata->append((const char*)buffer, length);
+
+    while(true) {
+        std::string msg = Network::Frame::parse(*prevdata);
+
+        // If we don't have a full message, just wait for more
+        if (msg.empty()) return;
+
+        Sirikata::Protocol::Loc::BulkLocationUpdate contents;
+        if (!decoder->decode(msg, contents)) {
+            QPLOG(error, "Failed to decode location message");
+            continue;
+        }
+        handleBulkLocationUpdate(snid, contents);
+    }
+
+    // FIXME we should be getting a callback on stream close so we can clean up!
+}
+
+void ServerQueryHandler::handleLocationDatagram(const OHDP::SpaceNodeID& snid, uint8* buffer, int length) {
+    handleBulkLocationUpdate(snid, std::string((const char*)buffer, length));
+}
+
 bool ServerQueryHandler::handleLocationMessage(const OHDP::SpaceNodeID& snid, const std::string& payload) {
     Sirikata::Protocol::Frame frame;
     bool parse_success = frame.ParseFromString(payload);
     if (!parse_success) return false;
+    handleBulkLocationUpdate(snid, frame.payload());
+    return true;
+}
+
+void ServerQueryHandler::handleBulkLocationUpdate(const OHDP::SpaceNodeID& snid, const std::string& payload) {
     Sirikata::Protocol::Loc::BulkLocationUpdate contents;
-    contents.ParseFromString(frame.payload());
+    if (!contents.ParseFromString(payload)) {
+        QPLOG(error, "Failed to decode location message");
+        return;
+    }
+    handleBulkLocationUpdate(snid, contents);
+}
 
+void ServerQueryHandler::handleBulkLocationUpdate(const OHDP::SpaceNodeID& snid, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents) {
     ServerQueryMap::iterator serv_it = mServerQueries.find(snid);
     if (serv_it == mServerQueries.end()) {
         QPLOG(debug, "Received location message without query. Query may have recently been destroyed.");
-        return true; // Was successfully parsed, but not handled
+        return;
     }
     ServerQueryStatePtr& query_state = serv_it->second;
 
@@ -322,8 +384,6 @@ bool ServerQueryHandler::handleLocationMessage(const OHDP::SpaceNodeID& snid, co
 	LocProtocolLocUpdate tmp(update, *(query_state->sync));
         query_state->client.locUpdate(tmp);
     }
-
-    return true;
 }
 
 
@@ -8,6 +8,7 @@
 #include <sirikata/oh/ObjectHostContext.hpp>
 #include <sirikata/oh/SpaceNodeSession.hpp>
 #include <sirikata/pintoloc/ManualReplicatedClient.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 #include <sirikata/oh/OHSpaceTimeSynced.hpp>
 
 namespace Sirikata {
@@ -121,7 +122,7 @@ private:
     // Callback from creating proximity substream
     void handleCreatedProxSubstream(const OHDP::SpaceNodeID& snid, int success, OHDPSST::StreamPtr prox_stream);
     // Data read callback for prox substreams -- translate to proximity events
-    void handleProximitySubstreamRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr prox_stream, String* prevdata, uint8* buffer, int length);
+    void handleProximitySubstreamRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr prox_stream, String* prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length);
     // Handle decode proximity message
     void handleProximityMessage(const OHDP::SpaceNodeID& snid, const String& payload);
 
@@ -130,7 +131,13 @@ private:
     void handleLocationSubstream(const OHDP::SpaceNodeID& snid, int err, OHDPSST::StreamPtr s);
     // Handlers for substream read events for space-managed updates
     void handleLocationSubstreamRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
+    // Handlers for long-lived substreams carrying a series of framed updates
+    void handleLocationChannelRead(const OHDP::SpaceNodeID& snid, OHDPSST::StreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length);
+    // Handler for updates sent as datagrams
+    void handleLocationDatagram(const OHDP::SpaceNodeID& snid, uint8* buffer, int length);
     bool handleLocationMessage(const OHDP::SpaceNodeID& snid, const std::string& payload);
+    void handleBulkLocationUpdate(const OHDP::SpaceNodeID& snid, const std::string& payload);
+    void handleBulkLocationUpdate(const OHDP::SpaceNodeID& snid, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents);
 
 };
 
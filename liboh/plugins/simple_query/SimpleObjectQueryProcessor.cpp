@@ -7,10 +7,13 @@
 #include "Protocol_Prox.pbj.hpp"
 #include "Protocol_Loc.pbj.hpp"
 #include "Protocol_Frame.pbj.hpp"
+#include "Protocol_ObjectHostProx.pbj.hpp"
 #include <sirikata/pintoloc/ProtocolLocUpdate.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 #include <sirikata/proxyobject/ProxyManager.hpp>
 #include <sirikata/oh/OHSpaceTimeSynced.hpp>
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/ohdp/SST.hpp>
 
 #define SOQP_LOG(lvl, msg) SILOG(simple-object-query-processor, lvl, msg)
 
@@ -33,6 +36,7 @@ SimpleObjectQueryProcessor::~SimpleObjectQueryProcessor() {
 }
 
 void SimpleObjectQueryProcessor::start() {
+    mContext->objectHost->SpaceNodeSessionManager::addListener(static_cast<SpaceNodeSessionListener*>(this));
 }
 
 void SimpleObjectQueryProcessor::stop() {
@@ -41,13 +45,32 @@ void SimpleObjectQueryProcessor::stop() {
 
 
 void SimpleObjectQueryProcessor::handleStop() {
+    mContext->objectHost->SpaceNodeSessionManager::removeListener(static_cast<SpaceNodeSessionListener*>(this));
+    mSpaceNodeProxStreams.clear();
+
     for(ObjectStateMap::iterator it = mObjectStateMap.begin(); it != mObjectStateMap.end(); it++)
-        it->second->stop();
+        releaseObjectState(it->second);
+    mObjectStateMap.clear();
+}
+
+void SimpleObjectQueryProcessor::releaseObjectState(const ObjectStatePtr& obj_state) {
+    if (!obj_state) return;
+
+    if (obj_state->strand == mContext->mainStrand) {
+        obj_state->stop();
+        return;
+    }
+    obj_state->strand->post(
+        std::tr1::bind(&ObjectState::stop, obj_state),
+        "SimpleObjectQueryProcessor::ObjectState::stop"
+    );
 }
 
 void SimpleObjectQueryProcessor::presenceConnectedStream(HostedObjectPtr ho, const SpaceObjectReference& sporef, HostedObject::SSTStreamPtr strm) {
     // Setup tracking state for this query
-    mObjectStateMap[sporef] = ObjectStatePtr(new ObjectState(mContext, ho));;
+    ObjectStatePtr& obj_state = mObjectStateMap[sporef];
+    releaseObjectState(obj_state);
+    obj_state = ObjectStatePtr(new ObjectState(mContext, ho));
 
     // And setup listeners for new data from the server
     SILOG(ho-proxies-count, insane, "PROXIES-INFO BASE STREAM CREATED " << sporef << ", " << (mContext->simTime()-Time::null()).microseconds() << " time");
@@ -62,10 +85,21 @@ void SimpleObjectQueryProcessor::presenceConnectedStream(HostedObjectPtr ho, con
             HostedObjectWPtr(ho), sporef, _1, _2
         )
     );
+    ODPSST::ConnectionPtr conn = strm->connection().lock();
+    if (conn) {
+        conn->registerReadDatagramCallback(OBJECT_PORT_LOCATION,
+            std::tr1::bind(&SimpleObjectQueryProcessor::handleLocationDatagram, this,
+                HostedObjectWPtr(ho), sporef, _1, _2
+            )
+        );
+    }
 }
 
 void SimpleObjectQueryProcessor::presenceDisconnected(HostedObjectPtr ho, const SpaceObjectReference& sporef) {
-    mObjectStateMap.erase(sporef);
+    ObjectStateMap::iterator it = mObjectStateMap.find(sporef);
+    if (it == mObjectStateMap.end()) return;
+    releaseObjectState(it->second);
+    mObjectStateMap.erase(it);
 }
 
 // Proximity
@@ -112,50 +146,215 @@ bool SimpleObjectQueryProcessor::handleProximityMessage(HostedObjectPtr self, co
     if (!parse_success)
         return false;
 
+    for(int32 idx = 0; idx < contents.update_size(); idx++) {
+        Sirikata::Protocol::Prox::ProximityUpdate update = contents.update(idx);
+        handleProximityUpdate(self, spaceobj, update);
+    }
+
+    return true;
+}
+
+void SimpleObjectQueryProcessor::handleProximityUpdate(HostedObjectPtr self, const SpaceObjectReference& spaceobj, Sirikata::Protocol::Prox::ProximityUpdate& update) {
     ObjectStatePtr obj_state = mObjectStateMap[spaceobj];
 
+    // We need to convert times to local time
+    for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
+        update.addition(aidx).location().set_t(
+            self->getObjectHost()->localTime(spaceobj.space(), update.addition(aidx).location().t())
+        );
+    }
+
+    // The rest needs the object's proxies, so it happens on its strand
+    if (self->strand() != mContext->mainStrand) {
+        self->strand()->post(
+            std::tr1::bind(&SimpleObjectQueryProcessor::processProximityUpdate, this,
+                HostedObjectWPtr(self), obj_state, spaceobj, update
+            ),
+            "SimpleObjectQueryProcessor::processProximityUpdate"
+        );
+        return;
+    }
+    processProximityUpdate(self, obj_state, spaceobj, update);
+}
+
+void SimpleObjectQueryProcessor::processProximityUpdate(const HostedObjectWPtr& weakSelf, ObjectStatePtr obj_state, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Prox::ProximityUpdate& update) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self)
+        return;
+
     ProxyManagerPtr proxy_manager = self->getProxyManager(spaceobj.space(), spaceobj.object());
     if (!proxy_manager) {
         SOQP_LOG(warn,"Hosted Object received a message for a presence without a proxy manager.");
-        return true;
+        return;
     }
 
-    for(int32 idx = 0; idx < contents.update_size(); idx++) {
-        Sirikata::Protocol::Prox::ProximityUpdate update = contents.update(idx);
+    // To take care of tracking orphans for the HostedObject, we need to
+    // take take a pass through the results ourselves. We backup data for
+    // objects that are going to be removed before delivering the
+    // results...
+    for(int32 ridx = 0; ridx < update.removal_size(); ridx++) {
+        Sirikata::Protocol::Prox::ObjectRemoval removal = update.removal(ridx);
 
-        // We need to convert times to local time
-        for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
-            update.addition(aidx).location().set_t(
-                self->getObjectHost()->localTime(spaceobj.space(), update.addition(aidx).location().t())
-            );
-        }
+        SpaceObjectReference observed(spaceobj.space(), ObjectReference(removal.object()));
+        ProxyObjectPtr proxy_obj = proxy_manager->getProxyObject(observed);
+
+        // Somehow, it's possible we don't have a proxy for this object...
+        if (proxy_obj)
+            obj_state->orphans.addUpdateFromExisting(proxy_obj);
+    }
 
-        // To take care of tracking orphans for the HostedObject, we need to
-        // take take a pass through the results ourselves. We backup data for
-        // objects that are going to be removed before delivering the
-        // results...
-        for(int32 ridx = 0; ridx < update.removal_size(); ridx++) {
-            Sirikata::Protocol::Prox::ObjectRemoval removal = update.removal(ridx);
+    // Then deliver the results....
+    deliverProximityUpdate(self, spaceobj, update);
 
-            SpaceObjectReference observed(spaceobj.space(), ObjectReference(removal.object()));
-            ProxyObjectPtr proxy_obj = proxy_manager->getProxyObject(observed);
+    // And work through the additions, processing orphaned updates.
+    for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
+        Sirikata::Protocol::Prox::ObjectAddition addition = update.addition(aidx);
 
-            // Somehow, it's possible we don't have a proxy for this object...
-            if (proxy_obj)
-                obj_state->orphans.addUpdateFromExisting(proxy_obj);
-        }
+        SpaceObjectReference observed(spaceobj.space(), ObjectReference(addition.object()));
+
+        obj_state->orphans.invokeOrphanUpdates2(observed, this, spaceobj, self);
+    }
+}
+
+// Batched proximity results for all presences connected to one space server
+
+void SimpleObjectQueryProcessor::onSpaceNodeSession(const OHDP::SpaceNodeID& id, OHDPSST::StreamPtr sn_stream) {
+    // The space server only sends batched results over this substream if
+    // it's configured to, otherwise it just goes unused.
+    sn_stream->createChildStream(
+        std::tr1::bind(&SimpleObjectQueryProcessor::handleObjectHostProximitySubstream, this, id, _1, _2),
+        NULL, 0,
+        OBJECT_PORT_PROXIMITY, OBJECT_PORT_PROXIMITY
+    );
+}
+
+void SimpleObjectQueryProcessor::onSpaceNodeSessionEnded(const OHDP::SpaceNodeID& id) {
+    SpaceNodeStreamMap::iterator it = mSpaceNodeProxStreams.find(id);
+    if (it == mSpaceNodeProxStreams.end()) return;
+    it->second->registerReadCallback(0);
+    mSpaceNodeProxStreams.erase(it);
+}
+
+void SimpleObjectQueryProcessor::handleObjectHostProximitySubstream(const OHDP::SpaceNodeID& snid, int err, OHDPSST::StreamPtr s) {
+    if (err != SST_IMPL_SUCCESS) {
+        SOQP_LOG(detailed, "Failed to create object host proximity substream to " << snid);
+        return;
+    }
+
+    // The buffer belongs to the read callback, so it goes away when the
+    // callback is cleared at the end of the session
+    OHDPSST::StreamPtr& saved = mSpaceNodeProxStreams[snid];
+    if (saved && saved != s)
+        saved->registerReadCallback(0);
+    saved = s;
+    std::tr1::shared_ptr<String> prevdata(new String());
+    s->registerReadCallback(
+        std::tr1::bind(&SimpleObjectQueryProcessor::handleObjectHostProximitySubstreamRead, this,
+            snid, prevdata, _1, _2
+        )
+    );
+}
+
+void SimpleObjectQueryProcessor::handleObjectHostProximitySubstreamRead(const OHDP::SpaceNodeID& snid, std::tr1::shared_ptr<String> prevdata, uint8* buffer, int length) {
+    if (mContext->stopped()) {
+        SOQP_LOG(detailed,"Ignoring proximity update after system stop requested.");
+        return;
+    }
+
+    prevdata->append((const char*)buffer, length);
+
+    while(true) {
+        std::string msg = Network::Frame::parse(*prevdata);
+
+        // If we don't have a full message, just wait for more
+        if (msg.empty()) return;
+
+        // Otherwise, try to handle it
+        if (!handleObjectHostProximityMessage(snid, msg))
+            SOQP_LOG(error, "Failed to parse object host proximity results from " << snid);
+    }
+}
 
-        // Then deliver the results....
-        deliverProximityUpdate(self, spaceobj, update);
+bool SimpleObjectQueryProcessor::handleObjectHostProximityMessage(const OHDP::SpaceNodeID& snid, const std::string& payload) {
+    Sirikata::Protocol::Prox::ObjectHostProximityResults contents;
+    bool parse_success = contents.ParseFromString(payload);
+    if (!parse_success)
+        return false;
 
-        // And work through the additions, processing orphaned updates.
-        for(int32 aidx = 0; aidx < update.addition_size(); aidx++) {
-            Sirikata::Protocol::Prox::ObjectAddition addition = update.addition(aidx);
+    // Each querier's update refers to shared object descriptions by index,
+    // so we rebuild a regular ProximityUpdate for each of them and handle it
+    // just like results received on the presence's own substream.
+    for(int32 idx = 0; idx < contents.update_size(); idx++) {
+        Sirikata::Protocol::Prox::QuerierUpdate querier_update = contents.update(idx);
+
+        SpaceObjectReference spaceobj(snid.space(), ObjectReference(querier_update.querier()));
+        ObjectStateMap::iterator state_it = mObjectStateMap.find(spaceobj);
+        if (state_it == mObjectStateMap.end()) continue;
+        HostedObjectPtr self = state_it->second->ho.lock();
+        if (!self || self->stopped()) continue;
+
+        Sirikata::Protocol::Prox::ProximityUpdate update;
+
+        uint64 seqno = 0;
+        for(int32 aidx = 0; aidx < querier_update.addition_size(); aidx++) {
+            if (aidx < querier_update.addition_seqno_size())
+                seqno += querier_update.addition_seqno(aidx);
+
+            uint32 obj_idx = querier_update.addition(aidx);
+            if ((int32)obj_idx >= contents.object_size()) {
+                SOQP_LOG(error, "Object host proximity results reference an unknown object.");
+                continue;
+            }
+            Sirikata::Protocol::Prox::ObjectAddition desc = contents.object(obj_idx);
+
+            Sirikata::Protocol::Prox::IObjectAddition addition = update.add_addition();
+            addition.set_object(desc.object());
+            addition.set_seqno(seqno);
+            if (desc.has_type())
+                addition.set_type(desc.type());
+
+            Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+            motion.set_t(desc.location().t());
+            motion.set_position(desc.location().position());
+            motion.set_velocity(desc.location().velocity());
+
+            Sirikata::Protocol::ITimedMotionQuaternion orient = addition.mutable_orientation();
+            orient.set_t(desc.orientation().t());
+            orient.set_position(desc.orientation().position());
+            orient.set_velocity(desc.orientation().velocity());
+
+            Sirikata::Protocol::IAggregateBoundingInfo bounds = addition.mutable_aggregate_bounds();
+            bounds.set_center_offset(desc.aggregate_bounds().center_offset());
+            bounds.set_center_bounds_radius(desc.aggregate_bounds().center_bounds_radius());
+            bounds.set_max_object_size(desc.aggregate_bounds().max_object_size());
+
+            if (desc.has_mesh())
+                addition.set_mesh(desc.mesh());
+            if (desc.has_physics())
+                addition.set_physics(desc.physics());
+        }
 
-            SpaceObjectReference observed(spaceobj.space(), ObjectReference(addition.object()));
+        for(int32 pidx = 0; pidx < querier_update.reparent_size(); pidx++) {
+            Sirikata::Protocol::Prox::NodeReparent src = querier_update.reparent(pidx);
+            Sirikata::Protocol::Prox::INodeReparent reparent = update.add_reparent();
+            reparent.set_object(src.object());
+            reparent.set_seqno(src.seqno());
+            reparent.set_old_parent(src.old_parent());
+            reparent.set_new_parent(src.new_parent());
+            if (src.has_type())
+                reparent.set_type(src.type());
+        }
 
-            obj_state->orphans.invokeOrphanUpdates1(observed, this, spaceobj);
+        for(int32 ridx = 0; ridx < querier_update.removal_size(); ridx++) {
+            Sirikata::Protocol::Prox::ObjectRemoval src = querier_update.removal(ridx);
+            Sirikata::Protocol::Prox::IObjectRemoval removal = update.add_removal();
+            removal.set_object(src.object());
+            removal.set_seqno(src.seqno());
+            if (src.has_type())
+                removal.set_type(src.type());
         }
+
+        handleProximityUpdate(self, spaceobj, update);
     }
 
     return true;
@@ -201,6 +400,25 @@ void SimpleObjectQueryProcessor::handleLocationSubstreamRead(const HostedObjectW
         return;
     }
 
+    // A long-lived location stream starts with a Network::Frame, whose length
+    // always has a zero high byte, where a single update would start with a
+    // Protocol::Frame.
+    if (prevdata->tellp() == 0 && length > 0 && buffer[0] == 0) {
+        delete prevdata;
+        std::tr1::shared_ptr<String> framedata(new String());
+        // Updates on the channel may use the compact encoding, which needs
+        // one decoder to see all of them
+        CompactLocUpdateDecoderPtr decoder(new CompactLocUpdateDecoder());
+        s->registerReadCallback(
+            std::tr1::bind(
+                &SimpleObjectQueryProcessor::handleLocationChannelRead, this,
+                weakSelf, spaceobj, s, framedata, decoder, _1, _2
+            )
+        );
+        handleLocationChannelRead(weakSelf, spaceobj, s, framedata, decoder, buffer, length);
+        return;
+    }
+
     prevdata->write((const char*)buffer, length);
     if (handleLocationMessage(self, spaceobj, prevdata->str())) {
         // FIXME we should be getting a callback on stream close instead of
@@ -213,12 +431,82 @@ void SimpleObjectQueryProcessor::handleLocationSubstreamRead(const HostedObjectW
     }
 }
 
+void SimpleObjectQueryProcessor::handleLocationChannelRead(const HostedObjectWPtr& weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self)
+        return;
+    if (self->stopped()) {
+        SOQP_LOG(detailed,"Ignoring location update after system stop requested.");
+        return;
+    }
+
+    prevdata->append((const char*)buffer, length);
+
+    while(true) {
+        std::string msg = Network::Frame::parse(*prevdata);
+
+        // If we don't have a full message, just wait for more
+        if (msg.empty()) return;
+
+        Sirikata::Protocol::Loc::BulkLocationUpdate contents;
+        if (!decoder->decode(msg, contents)) {
+            SOQP_LOG(error,"Failed to decode location update message.");
+            continue;
+        }
+        handleBulkLocationUpdate(self, spaceobj, contents);
+    }
+
+    // FIXME we should be getting a callback on stream close so we can clean up!
+}
+
+void SimpleObjectQueryProcessor::handleLocationDatagram(const HostedObjectWPtr& weakSelf, const SpaceObjectReference& spaceobj, uint8* buffer, int length) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self)
+        return;
+    if (self->stopped()) {
+        SOQP_LOG(detailed,"Ignoring location update after system stop requested.");
+        return;
+    }
+
+    handleBulkLocationUpdate(self, spaceobj, std::string((const char*)buffer, length));
+}
+
 bool SimpleObjectQueryProcessor::handleLocationMessage(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const std::string& payload) {
     Sirikata::Protocol::Frame frame;
     bool parse_success = frame.ParseFromString(payload);
     if (!parse_success) return false;
+    handleBulkLocationUpdate(self, spaceobj, frame.payload());
+    return true;
+}
+
+void SimpleObjectQueryProcessor::handleBulkLocationUpdate(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const std::string& payload) {
     Sirikata::Protocol::Loc::BulkLocationUpdate contents;
-    contents.ParseFromString(frame.payload());
+    if (!contents.ParseFromString(payload)) {
+        SOQP_LOG(error,"Failed to decode location update message.");
+        return;
+    }
+    handleBulkLocationUpdate(self, spaceobj, contents);
+}
+
+void SimpleObjectQueryProcessor::handleBulkLocationUpdate(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents) {
+    ObjectStatePtr obj_state = mObjectStateMap[spaceobj];
+
+    if (self->strand() != mContext->mainStrand) {
+        self->strand()->post(
+            std::tr1::bind(&SimpleObjectQueryProcessor::processBulkLocationUpdate, this,
+                HostedObjectWPtr(self), obj_state, spaceobj, contents
+            ),
+            "SimpleObjectQueryProcessor::processBulkLocationUpdate"
+        );
+        return;
+    }
+    processBulkLocationUpdate(self, obj_state, spaceobj, contents);
+}
+
+void SimpleObjectQueryProcessor::processBulkLocationUpdate(const HostedObjectWPtr& weakSelf, ObjectStatePtr obj_state, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self)
+        return;
 
     // Each update is checked against the current proximity results (in this
     // implementation's case, that's just the object's ProxyObjects) and
@@ -229,10 +517,8 @@ bool SimpleObjectQueryProcessor::handleLocationMessage(const HostedObjectPtr& se
     ProxyManagerPtr proxy_manager = self->getProxyManager(spaceobj.space(), spaceobj.object());
     if (!proxy_manager) {
         SOQP_LOG(warn,"Hosted Object received a message for a presence without a proxy manager.");
-        return true;
+        return;
     }
-    // As well as looking up object state (orhpan manager) only once
-    ObjectStatePtr obj_state = mObjectStateMap[spaceobj];
 
     for(int32 idx = 0; idx < contents.update_size(); idx++) {
         Sirikata::Protocol::Loc::LocationUpdate update = contents.update(idx);
@@ -248,19 +534,13 @@ bool SimpleObjectQueryProcessor::handleLocationMessage(const HostedObjectPtr& se
             deliverLocationUpdate(self, spaceobj, llu);
         }
     }
-
-    return true;
 }
 
-void SimpleObjectQueryProcessor::onOrphanLocUpdate(const LocUpdate& update, const SpaceObjectReference& spaceobj) {
+void SimpleObjectQueryProcessor::onOrphanLocUpdate(const LocUpdate& update, const SpaceObjectReference& spaceobj, HostedObjectPtr ho) {
     // This is similar to processing a location message except that we know
     // we're ready for these updates -- the proxy will be there and we
     // definitely never have to add it as an orphan
 
-    ObjectStatePtr obj_state = mObjectStateMap[spaceobj];
-    HostedObjectPtr ho = obj_state->ho.lock();
-    if (!ho) return;
-
     ProxyManagerPtr proxy_manager = ho->getProxyManager(spaceobj.space(), spaceobj.object());
     assert(proxy_manager);
     SpaceObjectReference observed(spaceobj.space(), ObjectReference(update.object()));
@@ -6,8 +6,10 @@
 #define _SIRIKATA_OH_SIMPLE_OBJECT_QUERY_PROCESSOR_HPP_
 
 #include <sirikata/oh/ObjectQueryProcessor.hpp>
+#include <sirikata/oh/SpaceNodeSession.hpp>
 
 #include <sirikata/pintoloc/OrphanLocUpdateManager.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 
 namespace Sirikata {
 namespace OH {
@@ -17,9 +19,15 @@ namespace Simple {
  *  through, only managing the coordination with the space server. Query updates
  *  are passed directly through and it only manages listening for new result
  *  streams and parsing the results.
+ *
+ *  Results may arrive on each presence's own proximity substream or, if the
+ *  space server batches results per object host, on a proximity substream we
+ *  open to each space server. Batched results are split back into updates for
+ *  each presence.
  */
 class SimpleObjectQueryProcessor :
         public ObjectQueryProcessor,
+        public SpaceNodeSessionListener,
         OrphanLocUpdateManager::Listener
 {
 public:
@@ -36,9 +44,14 @@ public:
 
     virtual void updateQuery(HostedObjectPtr ho, const SpaceObjectReference& sporef, const String& new_query);
 
+    // SpaceNodeSessionListener Interface
+    virtual void onSpaceNodeSession(const OHDP::SpaceNodeID& id, OHDPSST::StreamPtr sn_stream);
+    virtual void onSpaceNodeSessionEnded(const OHDP::SpaceNodeID& id);
 
-    // OrphanLocUpdateManager::Listener Interface
-    virtual void onOrphanLocUpdate(const LocUpdate& lu, const SpaceObjectReference& observer);
+
+    // OrphanLocUpdateManager::Listener Interface, invoked on the object's
+    // strand
+    void onOrphanLocUpdate(const LocUpdate& lu, const SpaceObjectReference& observer, HostedObjectPtr ho);
 
 private:
     void handleStop();
@@ -47,14 +60,31 @@ private:
     void handleProximitySubstream(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, int err, SSTStreamPtr s);
     void handleProximitySubstreamRead(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr s, String* prevdata, uint8* buffer, int length);
     bool handleProximityMessage(HostedObjectPtr self, const SpaceObjectReference& spaceobj, const std::string& payload);
+    void handleProximityUpdate(HostedObjectPtr self, const SpaceObjectReference& spaceobj, Sirikata::Protocol::Prox::ProximityUpdate& update);
+    // Batched results for all our presences connected to a space server
+    void handleObjectHostProximitySubstream(const OHDP::SpaceNodeID& snid, int err, OHDPSST::StreamPtr s);
+    void handleObjectHostProximitySubstreamRead(const OHDP::SpaceNodeID& snid, std::tr1::shared_ptr<String> prevdata, uint8* buffer, int length);
+    bool handleObjectHostProximityMessage(const OHDP::SpaceNodeID& snid, const std::string& payload);
 
     // Location
     // Handlers for substreams for space-managed updates
     void handleLocationSubstream(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, int err, SSTStreamPtr s);
     // Handlers for substream read events for space-managed updates
     void handleLocationSubstreamRead(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
+    // Handlers for long-lived substreams carrying a series of framed updates
+    void handleLocationChannelRead(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length);
+    // Handler for updates sent as datagrams
+    void handleLocationDatagram(const HostedObjectWPtr &weakSelf, const SpaceObjectReference& spaceobj, uint8* buffer, int length);
     bool handleLocationMessage(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const std::string& paylod);
+    void handleBulkLocationUpdate(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const std::string& payload);
+    void handleBulkLocationUpdate(const HostedObjectPtr& self, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents);
+
 
+    struct ObjectState;
+    typedef std::tr1::shared_ptr<ObjectState> ObjectStatePtr;
+    // Orphan tracking and delivery, run on the object's strand
+    void processProximityUpdate(const HostedObjectWPtr& weakSelf, ObjectStatePtr obj_state, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Prox::ProximityUpdate& update);
+    void processBulkLocationUpdate(const HostedObjectWPtr& weakSelf, ObjectStatePtr obj_state, const SpaceObjectReference& spaceobj, const Sirikata::Protocol::Loc::BulkLocationUpdate& contents);
 
     // BaseProxCommandable
     virtual void commandProperties(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
@@ -71,11 +101,14 @@ private:
     // object. To do so, we track a bit of state for each query -- the
     // object so we can check it's ProxyManager for proxies (i.e. the
     // current query result state) and an OrphanLocUpdateManager for
-    // fixing the ordering problems.
+    // fixing the ordering problems. The map is only used on the main strand,
+    // but the orphan tracking runs on the object's strand, so ObjectStates
+    // must be stopped and released there, see releaseObjectState.
     struct ObjectState {
         ObjectState(Context* ctx, HostedObjectPtr _ho)
          : ho(_ho),
-           orphans(ctx, ctx->mainStrand, Duration::seconds(10)),
+           strand(_ho->strand()),
+           orphans(ctx, _ho->strand(), Duration::seconds(10)),
            stopped(false)
         {
             orphans.start();
@@ -92,12 +125,21 @@ private:
         }
 
         HostedObjectWPtr ho;
+        // Owned by the ObjectHost, so it outlives the HostedObject
+        Network::IOStrand* strand;
         OrphanLocUpdateManager orphans;
         bool stopped;
     };
-    typedef std::tr1::shared_ptr<ObjectState> ObjectStatePtr;
     typedef std::tr1::unordered_map<SpaceObjectReference, ObjectStatePtr, SpaceObjectReference::Hasher> ObjectStateMap;
     ObjectStateMap mObjectStateMap;
+    // Stops an ObjectState on its object's strand. The main strand's
+    // reference should be dropped after calling this so the last reference,
+    // held by the posted stop or by pending updates, goes away on that strand.
+    void releaseObjectState(const ObjectStatePtr& obj_state);
+
+    // Substreams for batched results from each space server
+    typedef std::tr1::unordered_map<OHDP::SpaceNodeID, OHDPSST::StreamPtr, OHDP::SpaceNodeID::Hasher> SpaceNodeStreamMap;
+    SpaceNodeStreamMap mSpaceNodeProxStreams;
 };
 
 } // namespace Simple
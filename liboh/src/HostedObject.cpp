@@ -48,6 +48,7 @@
 
 #include <sirikata/core/odp/Exceptions.hpp>
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/network/Frame.hpp>
 
 #include <sirikata/core/network/IOStrandImpl.hpp>
 #include <sirikata/oh/SimulationFactory.hpp>
@@ -84,6 +85,7 @@ HostedObject::HostedObject(ObjectHostContext* ctx, ObjectHost*parent, const UUID
  : mContext(ctx),
    mID(_id),
    mObjectHost(parent),
+   mStrand(parent->objectStrand(_id)),
    mObjectScript(NULL),
    destroyed(false)
 {
@@ -501,9 +503,9 @@ void HostedObject::handleConnected(const HostedObjectWPtr& weakSelf, ObjectHost*
               self->mContext, self->mDelegateODPService
            )   );
 
-    // We have to manually do what mContext->mainStrand->wrap( ... ) should be
-    // doing because it can't handle > 5 arguments.
-    self->mContext->mainStrand->post(
+    // We have to manually do what strand()->wrap( ... ) should be doing
+    // because it can't handle > 5 arguments.
+    self->strand()->post(
         std::tr1::bind(&HostedObject::handleConnectedIndirect, weakSelf, parentOH, space, obj, info, baseDatagramLayer),
         "HostedObject::handleConnectedIndirect"
     );
@@ -636,7 +638,7 @@ void HostedObject::handleDisconnected(
         return;
     }
 
-    self->mContext->mainStrand->post(
+    self->strand()->post(
         std::tr1::bind(&HostedObject::iHandleDisconnected,self.get(),
             weakSelf, spaceobj, cc),
         "HostedObject::iHandleDisconnected"
@@ -1182,15 +1184,29 @@ void HostedObject::updateLocUpdateRequest(const SpaceID& space, const ObjectRefe
         pd.rerequestTimer->cancel();
     }
 
-    sendLocUpdateRequest(space, oref);
+    postLocUpdateRequest(getWeakPtr(), space, oref);
 }
 
-
-namespace {
-void discardChildStream(int success, ODPSST::StreamPtr sptr) {
-    if (success != SST_IMPL_SUCCESS) return;
-    sptr->close(false);
+void HostedObject::postLocUpdateRequest(const HostedObjectWPtr& weakSelf, const SpaceID& space, const ObjectReference& oref) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self) return;
+    // The space streams are only safe to use from the main strand
+    self->mContext->mainStrand->dispatch(
+        std::tr1::bind(&HostedObject::handleLocUpdateRequest, weakSelf, space, oref),
+        "HostedObject::sendLocUpdateRequest"
+    );
 }
+
+void HostedObject::handleLocUpdateRequest(const HostedObjectWPtr& weakSelf, const SpaceID& space, const ObjectReference& oref) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self) return;
+    {
+        // The presence may have gone away before we got here
+        Mutex::scoped_lock locker(self->presenceDataMutex);
+        if (self->mPresenceData.find(SpaceObjectReference(space, oref)) == self->mPresenceData.end())
+            return;
+    }
+    self->sendLocUpdateRequest(space, oref);
 }
 
 
@@ -1208,6 +1224,19 @@ void HostedObject::sendLocUpdateRequest(const SpaceID& space, const ObjectRefere
         return;
     }
 
+    // Finish sending the previous request first. Anything requested in the
+    // meantime is coalesced into the next request.
+    SSTStreamPtr spaceStream = mObjectHost->getSpaceStream(space, oref);
+    if (!writeLocUpdateRequests(pd, spaceStream)) {
+        // Set up retry timer. Just rerun this method, but add no new
+        // update fields.
+        pd.rerequestTimer->wait(
+            Duration::milliseconds((int64)10),
+            std::tr1::bind(&HostedObject::postLocUpdateRequest, getWeakPtr(), space, oref)
+        );
+        return;
+    }
+
     // We can get here and have no updates because requests can get
     // coalesced if one of them needs to do an async lookup of query
     // data for a mesh. However, we'll still get invoked twice. We can
@@ -1264,29 +1293,87 @@ void HostedObject::sendLocUpdateRequest(const SpaceID& space, const ObjectRefere
 
     std::string payload = serializePBJMessage(container);
 
-
-    bool send_succeeded = false;
-    SSTStreamPtr spaceStream = mObjectHost->getSpaceStream(space, oref);
-    if (spaceStream) {
-        spaceStream->createChildStream(
-            std::tr1::bind(discardChildStream, _1, _2),
-            (void*)payload.data(), payload.size(),
-            OBJECT_PORT_LOCATION, OBJECT_PORT_LOCATION
+    pd.locRequestData = Network::Frame::write(payload);
+    pd.updateFields = PerPresenceData::LOC_FIELD_NONE;
+    // If it doesn't all fit, keep trying until the rest is written
+    if (!writeLocUpdateRequests(pd, spaceStream)) {
+        pd.rerequestTimer->wait(
+            Duration::milliseconds((int64)10),
+            std::tr1::bind(&HostedObject::postLocUpdateRequest, getWeakPtr(), space, oref)
         );
-        send_succeeded = true;
+    }
+}
+
+bool HostedObject::writeLocUpdateRequests(PerPresenceData& pd, SSTStreamPtr spaceStream) {
+    if (!spaceStream) return false;
+
+    // The request substream goes away with the space stream it was created
+    // on, e.g. when we migrate, and a partially written request is useless
+    // on a new substream. Start over, re-requesting everything.
+    if (pd.locRequestBaseStream != spaceStream) {
+        if (pd.locRequestStream)
+            pd.locRequestStream->close(false);
+        pd.locRequestStream.reset();
+        pd.locRequestStreamRequested = false;
+        pd.locRequestBaseStream = spaceStream;
+        if (!pd.locRequestData.empty()) {
+            pd.locRequestData.clear();
+            pd.updateFields |= PerPresenceData::LOC_FIELD_LOC | PerPresenceData::LOC_FIELD_ORIENTATION |
+                PerPresenceData::LOC_FIELD_BOUNDS | PerPresenceData::LOC_FIELD_MESH |
+                PerPresenceData::LOC_FIELD_PHYSICS | PerPresenceData::LOC_FIELD_QUERY_DATA;
+        }
     }
 
-    if (send_succeeded) {
-        pd.updateFields = PerPresenceData::LOC_FIELD_NONE;
+    if (!pd.locRequestStream) {
+        if (!pd.locRequestStreamRequested) {
+            pd.locRequestStreamRequested = true;
+            int ret = spaceStream->createChildStream(
+                std::tr1::bind(&HostedObject::handleLocUpdateRequestStream, getWeakPtr(), pd.id(), spaceStream, _1, _2),
+                (void*)NULL, 0,
+                OBJECT_PORT_LOCATION, OBJECT_PORT_LOCATION
+            );
+            // The callback won't be invoked, so the retry timer has to ask
+            // again
+            if (ret == -1)
+                pd.locRequestStreamRequested = false;
+        }
+        return false;
     }
-    else {
-        // Set up retry timer. Just rerun this method, but add no new
-        // update fields.
-        pd.rerequestTimer->wait(
-            Duration::milliseconds((int64)10),
-            std::tr1::bind(&HostedObject::sendLocUpdateRequest, this, space, oref)
-        );
+
+    if (pd.locRequestData.empty()) return true;
+    int bytes_written = pd.locRequestStream->write((const uint8*)pd.locRequestData.data(), pd.locRequestData.size());
+    if (bytes_written < 0) {
+        // Try again on a new substream
+        pd.locRequestBaseStream.reset();
+        return false;
+    }
+    pd.locRequestData = pd.locRequestData.substr(bytes_written);
+    return pd.locRequestData.empty();
+}
+
+void HostedObject::handleLocUpdateRequestStream(const HostedObjectWPtr& weakSelf, const SpaceObjectReference& spaceobj, SSTStreamPtr base_stream, int err, SSTStreamPtr s) {
+    HostedObjectPtr self(weakSelf.lock());
+    if (!self) {
+        if (s) s->close(false);
+        return;
+    }
+
+    Mutex::scoped_lock locker(self->presenceDataMutex);
+    PresenceDataMap::iterator pd_it = self->mPresenceData.find(spaceobj);
+    // Ignore the stream if the presence went away or we've since moved on
+    // to another space stream
+    if (pd_it == self->mPresenceData.end() || pd_it->second->locRequestBaseStream != base_stream) {
+        if (s) s->close(false);
+        return;
+    }
+    PerPresenceData& pd = *(pd_it->second);
+    if (err != SST_IMPL_SUCCESS || !s) {
+        // Let the next attempt to send request it again
+        pd.locRequestStreamRequested = false;
+        return;
     }
+    // Pending requests are picked up by the retry timer
+    pd.locRequestStream = s;
 }
 
 
@@ -67,16 +67,27 @@ ObjectHost::ObjectHost(ObjectHostContext* ctx, Network::IOService *ioServ, const
     OptionValue *protocolOptions;
     OptionValue *scriptManagers;
     OptionValue *simOptions;
+    OptionValue *strandsOption;
     InitializeClassOptions ico("objecthost",this,
                            protocolOptions=new OptionValue("protocols","",OptionValueType<std::map<std::string,std::string> >(),"passes options into protocol specific libraries like \"tcpsst:{--send-buffer-size=1440 --parallel-sockets=1},udp:{--send-buffer-size=1500}\""),
                            scriptManagers=new OptionValue("scriptManagers","simplecamera:{},js:{}",OptionValueType<std::map<std::string,std::string> >(),"Instantiates script managers with specified options like \"simplecamera:{},js:{--import-paths=/path/to/scripts}\""),
                            simOptions=new OptionValue("simOptions","ogregraphics:{}",OptionValueType<std::map<std::string,std::string> >(),"Passes initialization strings to simulations, by name"),
+                           strandsOption=new OptionValue("strands","1",OptionValueType<uint32>(),"Number of strands to spread hosted objects across. Each object is processed on one of them. With 1, all objects are processed on the main strand."),
 
                            NULL);
 
     OptionSet* oh_options = OptionSet::getOptions("objecthost",this);
     oh_options->parse(options);
     mSimOptions=simOptions->as<std::map<std::string,std::string> > ();
+
+    // With more than one strand, objects get their own strands so their
+    // proximity and location updates can be processed in parallel. Session
+    // management stays on the main strand either way.
+    uint32 nstrands = strandsOption->as<uint32>();
+    if (nstrands > 1) {
+        for(uint32 i = 0; i < nstrands; i++)
+            mObjectStrands.push_back(ioServ->createStrand("Object Host Objects " + boost::lexical_cast<String>(i)));
+    }
     {
         std::map<std::string,std::string> *options=&protocolOptions->as<std::map<std::string,std::string> > ();
         for (std::map<std::string,std::string>::iterator i=options->begin(),ie=options->end();i!=ie;++i) {
@@ -129,7 +140,10 @@ ObjectHost::~ObjectHost()
 {
     {
         HostedObjectMap objs;
-        mHostedObjects.swap(objs);
+        {
+            Mutex::scoped_lock lock(mHostedObjectsMutex);
+            mHostedObjects.swap(objs);
+        }
         for (HostedObjectMap::iterator iter = objs.begin();
                  iter != objs.end();
                  ++iter) {
@@ -137,6 +151,20 @@ ObjectHost::~ObjectHost()
         }
         objs.clear(); // The HostedObject destructor will attempt to delete from mHostedObjects
     }
+
+    for(uint32 i = 0; i < mObjectStrands.size(); i++)
+        delete mObjectStrands[i];
+    mObjectStrands.clear();
+}
+
+Network::IOStrand* ObjectHost::objectStrand(const UUID& objid) const {
+    if (mObjectStrands.empty())
+        return mContext->mainStrand;
+    return mObjectStrands[ UUID::Hasher()(objid) % mObjectStrands.size() ];
+}
+
+uint32 ObjectHost::objectStrandCount() const {
+    return mObjectStrands.empty() ? 1 : mObjectStrands.size();
 }
 
 HostedObjectPtr ObjectHost::createObject(const String& script_type, const String& script_opts, const String& script_contents) {
@@ -145,13 +173,20 @@ HostedObjectPtr ObjectHost::createObject(const String& script_type, const String
 }
 
 HostedObjectPtr ObjectHost::createObject(const UUID &uuid, const String& script_type, const String& script_opts, const String& script_contents) {
-    mActiveHostedObjects++;
-    HostedObjectPtr ho = HostedObject::construct<HostedObject>(mContext, this, uuid);
+    HostedObjectPtr ho;
+    {
+        Mutex::scoped_lock lock(mHostedObjectsMutex);
+        mActiveHostedObjects++;
+    }
+    ho = HostedObject::construct<HostedObject>(mContext, this, uuid);
 
     // Safe weak reference by internal id. This lets us use the internal ID to
     // uniquely reference the object and look it up, e.g. for external commands
-    assert(mHostedObjectsByID.find(uuid) == mHostedObjectsByID.end());
-    mHostedObjectsByID[uuid] = ho;
+    {
+        Mutex::scoped_lock lock(mHostedObjectsMutex);
+        assert(mHostedObjectsByID.find(uuid) == mHostedObjectsByID.end());
+        mHostedObjectsByID[uuid] = ho;
+    }
 
     ho->start();
     // NOTE: This condition has been carefully thought through. Since you can
@@ -207,6 +242,20 @@ void ObjectHost::handleObjectDisconnected(const SpaceObjectReference& sporef_obj
 //use this function to request the object host to send a disconnect message
 //to space for object
 void ObjectHost::disconnectObject(const SpaceID& space, const ObjectReference& oref)
+{
+    // Objects on their own strands request disconnection from there, but
+    // SessionManagers are only used from the main strand.
+    if (!mObjectStrands.empty()) {
+        mContext->mainStrand->dispatch(
+            std::tr1::bind(&ObjectHost::iDisconnectObject, this, space, oref),
+            "ObjectHost::disconnectObject"
+        );
+        return;
+    }
+    iDisconnectObject(space, oref);
+}
+
+void ObjectHost::iDisconnectObject(const SpaceID& space, const ObjectReference& oref)
 {
     SpaceSessionManagerMap::iterator iter = mSessionManagers.find(space);
     if (iter == mSessionManagers.end())
@@ -245,18 +294,53 @@ bool ObjectHost::connect(
     DisconnectedCallback disconnected_cb
 )
 {
+    {
+        Mutex::scoped_lock lock(mHostedObjectsMutex);
+        if (mHostedObjects.find(sporef)!=mHostedObjects.end())
+            return false;
+    }
+
+    ConnectRequestPtr req(new ConnectRequest);
+    req->ho = ho;
+    req->sporef = sporef;
+    req->space = space;
+    req->loc = loc;
+    req->orient = orient;
+    req->bnds = bnds;
+    req->mesh = mesh;
+    req->phy = phy;
+    req->query = query;
+    req->query_data = query_data;
+    req->connected_cb = connected_cb;
+    req->migrated_cb = migrated_cb;
+    req->stream_created_cb = stream_created_cb;
+    req->disconnected_cb = disconnected_cb;
+
+    // Like disconnectObject, objects on their own strands have to hand the
+    // request off to the main strand. The object isn't registered yet, so
+    // the check above is the best answer we can give them.
+    if (!mObjectStrands.empty()) {
+        mContext->mainStrand->dispatch(
+            std::tr1::bind(&ObjectHost::iConnect, this, req),
+            "ObjectHost::connect"
+        );
+        return true;
+    }
+    return iConnect(req);
+}
+
+bool ObjectHost::iConnect(ConnectRequestPtr req) {
     Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
-    if (mHostedObjects.find(sporef)!=mHostedObjects.end())
-        return false;
-    SessionManager *sm = mSessionManagers[space];
 
-    String filtered_query = mQueryProcessor->connectRequest(ho, sporef, query);
+    SessionManager *sm = mSessionManagers[req->space];
+
+    String filtered_query = mQueryProcessor->connectRequest(req->ho, req->sporef, req->query);
     return sm->connect(
-        sporef, loc, orient, bnds, mesh, phy, filtered_query, query_data,
-        std::tr1::bind(&ObjectHost::wrappedConnectedCallback, this, HostedObjectWPtr(ho), _1, _2, _3, connected_cb),
-        migrated_cb,
-        std::tr1::bind(&ObjectHost::wrappedStreamCreatedCallback, this, HostedObjectWPtr(ho), _1, _2, stream_created_cb),
-        std::tr1::bind(&ObjectHost::wrappedDisconnectedCallback, this, HostedObjectWPtr(ho), _1, _2, disconnected_cb)
+        req->sporef, req->loc, req->orient, req->bnds, req->mesh, req->phy, filtered_query, req->query_data,
+        std::tr1::bind(&ObjectHost::wrappedConnectedCallback, this, HostedObjectWPtr(req->ho), _1, _2, _3, req->connected_cb),
+        std::tr1::bind(&ObjectHost::wrappedMigratedCallback, this, HostedObjectWPtr(req->ho), _1, _2, _3, req->migrated_cb),
+        std::tr1::bind(&ObjectHost::wrappedStreamCreatedCallback, this, HostedObjectWPtr(req->ho), _1, _2, req->stream_created_cb),
+        std::tr1::bind(&ObjectHost::wrappedDisconnectedCallback, this, HostedObjectWPtr(req->ho), _1, _2, req->disconnected_cb)
     );
 }
 
@@ -278,6 +362,16 @@ void ObjectHost::wrappedConnectedCallback(HostedObjectWPtr ho_weak, const SpaceI
     cb(space, obj, info);
 }
 
+void ObjectHost::wrappedMigratedCallback(HostedObjectWPtr ho_weak, const SpaceID& space, const ObjectReference& obj, ServerID server, MigratedCallback cb) {
+    // Migration resets the object's proxies, so it has to be handled on the
+    // object's strand.
+    HostedObjectPtr ho(ho_weak.lock());
+    if (ho && ho->strand() != mContext->mainStrand)
+        ho->strand()->post(std::tr1::bind(cb, space, obj, server), "ObjectHost::wrappedMigratedCallback");
+    else
+        cb(space, obj, server);
+}
+
 void ObjectHost::wrappedStreamCreatedCallback(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, SessionManager::ConnectionEvent after, StreamCreatedCallback cb) {
     if (mQueryProcessor != NULL) {
         HostedObjectPtr ho(ho_weak);
@@ -288,7 +382,13 @@ void ObjectHost::wrappedStreamCreatedCallback(HostedObjectWPtr ho_weak, const Sp
             mQueryProcessor->presenceConnectedStream(ho, sporef, strm);
         }
     }
-    cb(sporef, after);
+
+    // Listeners are notified of the new stream on the object's strand
+    HostedObjectPtr target(ho_weak.lock());
+    if (target && target->strand() != mContext->mainStrand)
+        target->strand()->post(std::tr1::bind(cb, sporef, after), "ObjectHost::wrappedStreamCreatedCallback");
+    else
+        cb(sporef, after);
 }
 
 void ObjectHost::wrappedDisconnectedCallback(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, Disconnect::Code cause, DisconnectedCallback cb) {
@@ -341,19 +441,31 @@ Time ObjectHost::currentLocalTime() const {
 
 
 bool ObjectHost::send(SpaceObjectReference& sporef_src, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, MemoryReference payload) {
-    Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
-
     std::string payload_str( (char*)payload.begin(), (char*)payload.end() );
     return send(sporef_src, space, src_port, dest, dest_port, payload_str);
 }
 
 bool ObjectHost::send(SpaceObjectReference& sporef_src, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload) {
+    // Sends are best effort, so from object strands we just queue it up on
+    // the main strand and report success.
+    if (!mObjectStrands.empty()) {
+        mContext->mainStrand->dispatch(
+            std::tr1::bind(&ObjectHost::iSend, this, sporef_src, space, src_port, dest, dest_port, payload),
+            "ObjectHost::send"
+        );
+        return true;
+    }
+    return iSend(sporef_src, space, src_port, dest, dest_port, payload);
+}
+
+bool ObjectHost::iSend(const SpaceObjectReference& sporef_src, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload) {
     Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
     return mSessionManagers[space]->send(sporef_src, src_port, dest, dest_port, payload);
 }
 
 void ObjectHost::registerHostedObject(const SpaceObjectReference &sporef_uuid, const HostedObjectPtr& obj)
 {
+    Mutex::scoped_lock lock(mHostedObjectsMutex);
     HostedObjectMap::iterator iter = mHostedObjects.find(sporef_uuid);
     if (iter != mHostedObjects.end()) {
         SILOG(oh,error,"Two objects having the same internal name in the mHostedObjects map on connect"<<sporef_uuid.toString());
@@ -362,9 +474,13 @@ void ObjectHost::registerHostedObject(const SpaceObjectReference &sporef_uuid, c
 }
 void ObjectHost::unregisterHostedObject(const SpaceObjectReference& sporef_uuid, HostedObject* key_obj)
 {
+    // Keep the object alive until we've released the lock since its
+    // destructor calls back into hostedObjectDestroyed
+    HostedObjectPtr obj;
+    Mutex::scoped_lock lock(mHostedObjectsMutex);
     HostedObjectMap::iterator iter = mHostedObjects.find(sporef_uuid);
     if (iter != mHostedObjects.end()) {
-        HostedObjectPtr obj (iter->second);
+        obj = iter->second;
         // The NULL case covers the possibility that the connection finishes
         // after the HostedObject requests destruction and stops paying
         // attention to connection events
@@ -376,6 +492,7 @@ void ObjectHost::unregisterHostedObject(const SpaceObjectReference& sporef_uuid,
 }
 
 void ObjectHost::hostedObjectDestroyed(const UUID& objid) {
+    Mutex::scoped_lock lock(mHostedObjectsMutex);
     // Remove our weak reference to the object
     assert(mHostedObjectsByID.find(objid) != mHostedObjectsByID.end());
     mHostedObjectsByID.erase(objid);
@@ -393,6 +510,7 @@ void ObjectHost::hostedObjectDestroyed(const UUID& objid) {
 
 
 HostedObjectPtr ObjectHost::getHostedObject(const SpaceObjectReference& sporef) const {
+    Mutex::scoped_lock lock(mHostedObjectsMutex);
     HostedObjectMap::const_iterator iter = mHostedObjects.find(sporef);
     if (iter != mHostedObjects.end()) {
         return iter->second;
@@ -401,6 +519,7 @@ HostedObjectPtr ObjectHost::getHostedObject(const SpaceObjectReference& sporef)
 }
 
 HostedObjectPtr ObjectHost::getHostedObject(const UUID& internal_id) const {
+    Mutex::scoped_lock lock(mHostedObjectsMutex);
     InternalIDHostedObjectMap::const_iterator iter = mHostedObjectsByID.find(internal_id);
     if (iter == mHostedObjectsByID.end()) return HostedObjectPtr();
     HostedObjectPtr ho = iter->second.lock();
@@ -424,8 +543,14 @@ void ObjectHost::stop() {
         sm->stop();
     }
 
-    for(InternalIDHostedObjectMap::const_iterator it = mHostedObjectsByID.begin(); it != mHostedObjectsByID.end(); it++) {
-        HostedObjectPtr ho = it->second.lock();
+    std::vector<HostedObjectWPtr> objs;
+    {
+        Mutex::scoped_lock lock(mHostedObjectsMutex);
+        for(InternalIDHostedObjectMap::const_iterator it = mHostedObjectsByID.begin(); it != mHostedObjectsByID.end(); it++)
+            objs.push_back(it->second);
+    }
+    for(std::vector<HostedObjectWPtr>::iterator it = objs.begin(); it != objs.end(); it++) {
+        HostedObjectPtr ho = it->lock();
         if (ho) ho->stop();
     }
 }
@@ -485,8 +610,17 @@ void ObjectHost::commandListObjects(const Command::Command& cmd, Command::Comman
 
     Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
 
-    for(InternalIDHostedObjectMap::const_iterator it = mHostedObjectsByID.begin(); it != mHostedObjectsByID.end(); it++) {
-        HostedObjectPtr ho = it->second.lock();
+    // Only copy the weak references while holding the lock. The objects run
+    // on other strands, so ours may end up being the last strong reference
+    // and the HostedObject destructor locks mHostedObjectsMutex.
+    std::vector<HostedObjectWPtr> objs;
+    {
+        Mutex::scoped_lock lock(mHostedObjectsMutex);
+        for(InternalIDHostedObjectMap::const_iterator it = mHostedObjectsByID.begin(); it != mHostedObjectsByID.end(); it++)
+            objs.push_back(it->second);
+    }
+    for(std::vector<HostedObjectWPtr>::iterator it = objs.begin(); it != objs.end(); it++) {
+        HostedObjectPtr ho = it->lock();
         if (ho) objects_ary.push_back( ho->id().toString() );
     }
     cmdr->result(cmdid, result);
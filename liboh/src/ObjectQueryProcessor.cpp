@@ -3,7 +3,9 @@
 // be found in the LICENSE file.
 
 #include <sirikata/oh/ObjectQueryProcessor.hpp>
+#include <sirikata/pintoloc/CopyableLocUpdate.hpp>
 #include "Protocol_Loc.pbj.hpp"
+#include "Protocol_Prox.pbj.hpp"
 
 AUTO_SINGLETON_INSTANCE(Sirikata::OH::ObjectQueryProcessorFactory);
 
@@ -44,6 +46,40 @@ void ObjectQueryProcessor::deliverLocationUpdate(HostedObjectPtr ho, const Space
     ho->handleLocationUpdate(sporef, lu);
 }
 
+void ObjectQueryProcessor::postProximityUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const Sirikata::Protocol::Prox::ProximityUpdate& update) {
+    if (ho->strand() == ho->context()->mainStrand) {
+        deliverProximityUpdate(ho, sporef, update);
+        return;
+    }
+    ho->strand()->post(
+        std::tr1::bind(&ObjectQueryProcessor::handlePostedProximityUpdate, this, HostedObjectWPtr(ho), sporef, update),
+        "ObjectQueryProcessor::handlePostedProximityUpdate"
+    );
+}
+
+void ObjectQueryProcessor::postLocationUpdate(HostedObjectPtr ho, const SpaceObjectReference& sporef, const LocUpdate& lu) {
+    if (ho->strand() == ho->context()->mainStrand) {
+        deliverLocationUpdate(ho, sporef, lu);
+        return;
+    }
+    ho->strand()->post(
+        std::tr1::bind(&ObjectQueryProcessor::handlePostedLocationUpdate, this, HostedObjectWPtr(ho), sporef, CopyableLocUpdate(lu)),
+        "ObjectQueryProcessor::handlePostedLocationUpdate"
+    );
+}
+
+void ObjectQueryProcessor::handlePostedProximityUpdate(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, const Sirikata::Protocol::Prox::ProximityUpdate& update) {
+    HostedObjectPtr ho(ho_weak.lock());
+    if (!ho) return;
+    deliverProximityUpdate(ho, sporef, update);
+}
+
+void ObjectQueryProcessor::handlePostedLocationUpdate(HostedObjectWPtr ho_weak, const SpaceObjectReference& sporef, const LocUpdate& lu) {
+    HostedObjectPtr ho(ho_weak.lock());
+    if (!ho) return;
+    deliverLocationUpdate(ho, sporef, lu);
+}
+
 
 ObjectQueryProcessorFactory& ObjectQueryProcessorFactory::getSingleton() {
     return AutoSingleton<ObjectQueryProcessorFactory>::getSingleton();
@@ -20,13 +20,14 @@ PerPresenceData::PerPresenceData(HostedObjectPtr _parent, const SpaceID& _space,
      : parent(_parent),
        space(_space),
        object(_oref),
-       proxyManager(ProxyManager::construct( _parent, SpaceObjectReference(_space, _oref) )),
+       proxyManager(ProxyManager::construct( _parent, SpaceObjectReference(_space, _oref), _parent->strand() )),
        query(_query),
        mSSTDatagramLayers(layer),
        updateFields(LOC_FIELD_NONE),
        requestEpoch(1),
        requestLoc( new SequencedPresenceProperties() ),
-       rerequestTimer( Network::IOTimer::create(_parent->context()->ioService) ),
+       rerequestTimer( Network::IOTimer::create(_parent->strand()) ),
+       locRequestStreamRequested(false),
        latestReportedEpoch(0)
     {
     }
@@ -40,6 +41,8 @@ PerPresenceData::~PerPresenceData() {
     proxyManager->destroy();
 
     rerequestTimer->cancel();
+    if (locRequestStream)
+        locRequestStream->close(false);
 }
 
     ProxyManagerPtr PerPresenceData::getProxyManager()
@@ -0,0 +1,157 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LIBPINTOLOC_COMPACT_LOC_UPDATE_HPP_
+#define _SIRIKATA_LIBPINTOLOC_COMPACT_LOC_UPDATE_HPP_
+
+#include <sirikata/pintoloc/Platform.hpp>
+#include <sirikata/core/util/Noncopyable.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <sirikata/core/util/MotionVector.hpp>
+#include <sirikata/core/util/MotionQuaternion.hpp>
+#include <sirikata/core/util/AggregateBoundingInfo.hpp>
+
+namespace Sirikata {
+
+namespace Protocol {
+namespace Loc {
+class BulkLocationUpdate;
+}
+}
+
+/** Encodes BulkLocationUpdates sent to a single subscriber over a reliable,
+ *  ordered channel much more compactly than the protocol buffer encoding, by
+ *  keeping state about what has already been sent over the channel:
+ *
+ *  - Objects are numbered the first time they're sent and afterwards
+ *    referred to by number instead of by UUID.
+ *  - Only properties that changed since the last update sent for an object
+ *    are included, with a bitmap of the properties that are present.
+ *  - Positions and velocities are quantized and sent as the difference from
+ *    the last values sent for the object. Positions are relative to an origin
+ *    chosen when the channel starts, the first position sent over it.
+ *  - Orientations use the "smallest three" encoding: the largest component
+ *    is dropped and the other three are sent as 16 bit integers.
+ *  - Mesh and physics strings are interned, so repeated strings are sent as
+ *    an index into a table built up on both sides.
+ *  - Objects the subscriber is no longer interested in are dropped with
+ *    removeObject(). The removal is sent with the next message so both sides
+ *    free the object's state and reuse its number at the same point.
+ *
+ *  Because unchanged properties are left out, the decoder must see every
+ *  message, in order, so this can't be used with datagrams or separate
+ *  substreams per message. Encoded data starts with MAGIC, which no
+ *  BulkLocationUpdate can start with, so receivers can accept both formats.
+ */
+class SIRIKATA_LIBPINTOLOC_EXPORT CompactLocUpdateEncoder : Noncopyable {
+public:
+    enum {
+        MAGIC = 0xFF,
+        VERSION = 2
+    };
+
+    /** Create an encoder.
+     *  \param position_precision quantization step for positions, in meters
+     *  \param velocity_precision quantization step for velocities, in m/s
+     */
+    CompactLocUpdateEncoder(float32 position_precision, float32 velocity_precision);
+
+    String encode(const Sirikata::Protocol::Loc::BulkLocationUpdate& blu);
+
+    /** Forget everything sent for an object, e.g. when the subscription to it
+     *  ends. If it is sent again later it is sent as a new object.
+     */
+    void removeObject(const UUID& id);
+
+    /** Get the number of objects state is being kept for. */
+    uint32 objectCount() const;
+
+private:
+    struct ObjectState {
+        ObjectState();
+
+        // Properties that have been sent at least once
+        uint8 sent;
+        Time locationTime;
+        int64 position[3];
+        int64 velocity[3];
+        Time orientationTime;
+        Quaternion orientation;
+        Quaternion orientationVelocity;
+        AggregateBoundingInfo bounds;
+        String mesh;
+        String physics;
+        String queryData;
+    };
+
+    void writeString(String& out, const String& str);
+
+    const float32 mPositionPrecision;
+    const float32 mVelocityPrecision;
+    bool mStarted;
+    Vector3f mOrigin;
+    uint64 mLastSeqno;
+    Time mLastTime;
+
+    typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> ObjectIndexMap;
+    ObjectIndexMap mObjectIndices;
+    std::vector<ObjectState> mObjects;
+    // Removed objects' numbers, waiting to be sent and then free for reuse
+    std::vector<uint32> mRemovedIndices;
+    std::vector<uint32> mFreeIndices;
+    typedef std::tr1::unordered_map<String, uint32> StringIndexMap;
+    StringIndexMap mStringIndices;
+};
+
+/** Decodes data produced by a CompactLocUpdateEncoder. One decoder must be
+ *  used for all the data received over a channel.
+ */
+class SIRIKATA_LIBPINTOLOC_EXPORT CompactLocUpdateDecoder : Noncopyable {
+public:
+    CompactLocUpdateDecoder();
+
+    /** Returns true if data looks like it was produced by a
+     *  CompactLocUpdateEncoder.
+     */
+    static bool isCompact(const String& data);
+
+    /** Decode data into a BulkLocationUpdate. Data that isn't compact is
+     *  parsed as a regular BulkLocationUpdate. Returns false if the data
+     *  couldn't be decoded.
+     */
+    bool decode(const String& data, Sirikata::Protocol::Loc::BulkLocationUpdate& blu);
+
+    /** Get the number of objects state is being kept for. Objects are dropped
+     *  when the encoder says they have been removed.
+     */
+    uint32 objectCount() const;
+
+private:
+    struct ObjectState {
+        ObjectState();
+
+        UUID id;
+        int64 position[3];
+        int64 velocity[3];
+    };
+
+    class Reader;
+    bool readString(Reader& reader, String& out);
+
+    bool mStarted;
+    Vector3f mOrigin;
+    float32 mPositionPrecision;
+    float32 mVelocityPrecision;
+    uint64 mLastSeqno;
+    Time mLastTime;
+
+    std::vector<ObjectState> mObjects;
+    std::vector<uint32> mFreeIndices;
+    std::vector<String> mStrings;
+};
+typedef std::tr1::shared_ptr<CompactLocUpdateDecoder> CompactLocUpdateDecoderPtr;
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LIBPINTOLOC_COMPACT_LOC_UPDATE_HPP_
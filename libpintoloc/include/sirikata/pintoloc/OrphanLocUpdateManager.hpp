@@ -18,6 +18,8 @@
 #include <sirikata/core/util/PresenceProperties.hpp>
 #include <sirikata/pintoloc/PresencePropertiesLocUpdate.hpp>
 
+#include <deque>
+
 namespace Sirikata {
 
 namespace Protocol {
@@ -83,80 +85,188 @@ public:
     // optional extra params passed through to the callback.
     template<typename ListenerType, typename ExtraParamType1>
     void invokeOrphanUpdates1(const SpaceObjectReference& proximateID, ListenerType* listener, ExtraParamType1 extra1) {
-        ObjectUpdateMap::iterator it = mUpdates.find(proximateID);
-        if (it == mUpdates.end()) return;
-
-        const UpdateInfoList& info_list = it->second;
-        for(UpdateInfoList::const_iterator info_it = info_list.begin(); info_it != info_list.end(); info_it++) {
-            if ((*info_it)->value != NULL) {
-                listener->onOrphanLocUpdate( *((*info_it)->value), extra1 );
-            }
-            else if ((*info_it)->opd != NULL) {
-                PresencePropertiesLocUpdate plu( (*info_it)->object.object(), *((*info_it)->opd) );
-                listener->onOrphanLocUpdate( plu, extra1 );
-            }
-        }
-
         // Once we've notified of these we can get rid of them -- if they
         // need the info again they should re-register it with
         // addUpdateFromExisting before cleaning up the object.
-        mUpdates.erase(it);
+        uint32 idx = takeUpdates(proximateID);
+        while(idx != NO_RECORD) {
+            const UpdateRecord& rec = mRecords[idx];
+            if (rec.fromExisting) {
+                PresencePropertiesLocUpdate plu( rec.object.object(), rec.props );
+                listener->onOrphanLocUpdate( plu, extra1 );
+            }
+            else {
+                RecordLocUpdate lu(rec);
+                listener->onOrphanLocUpdate( lu, extra1 );
+            }
+            idx = releaseRecord(idx);
+        }
     }
     template<typename ListenerType, typename ExtraParamType1, typename ExtraParamType2>
     void invokeOrphanUpdates2(const SpaceObjectReference& proximateID, ListenerType* listener, ExtraParamType1 extra1, ExtraParamType2 extra2) {
-        ObjectUpdateMap::iterator it = mUpdates.find(proximateID);
-        if (it == mUpdates.end()) return;
-
-        const UpdateInfoList& info_list = it->second;
-        for(UpdateInfoList::const_iterator info_it = info_list.begin(); info_it != info_list.end(); info_it++) {
-            if ((*info_it)->value != NULL) {
-                listener->onOrphanLocUpdate( *((*info_it)->value), extra1, extra2 );
-            }
-            else if ((*info_it)->opd != NULL) {
-                PresencePropertiesLocUpdate plu( (*info_it)->object.object(), *((*info_it)->opd) );
+        uint32 idx = takeUpdates(proximateID);
+        while(idx != NO_RECORD) {
+            const UpdateRecord& rec = mRecords[idx];
+            if (rec.fromExisting) {
+                PresencePropertiesLocUpdate plu( rec.object.object(), rec.props );
                 listener->onOrphanLocUpdate( plu, extra1, extra2 );
             }
+            else {
+                RecordLocUpdate lu(rec);
+                listener->onOrphanLocUpdate( lu, extra1, extra2 );
+            }
+            idx = releaseRecord(idx);
         }
-
-        // Once we've notified of these we can get rid of them -- if they
-        // need the info again they should re-register it with
-        // addUpdateFromExisting before cleaning up the object.
-        mUpdates.erase(it);
     }
 
     bool empty() const {
         return mUpdates.empty();
     }
 
+    /** Get the number of updates currently being saved. */
+    uint32 size() const {
+        return (uint32)(mRecords.size() - mFreeRecords.size());
+    }
+
+    /** Discard all updates that expired before the given time. This is
+     *  invoked periodically by the poller using the current time.
+     */
+    void expire(const Time& t);
+
 private:
     virtual void poll();
 
-    struct UpdateInfo {
-        UpdateInfo(const SpaceObjectReference& obj, LocUpdate* _v, const Time& t)
-         : object(obj), value(_v), opd(NULL), expiresAt(t)
-        {}
-        UpdateInfo(const SpaceObjectReference& obj, SequencedPresenceProperties* _v, const Time& t)
-         : object(obj), value(NULL), opd(_v), expiresAt(t)
-        {}
-        ~UpdateInfo();
+    enum {
+        NO_RECORD = 0xFFFFFFFF,
+        // The timing wheel spans a few timeouts, with this many slots per
+        // timeout
+        WHEEL_SLOTS_PER_TIMEOUT = 8,
+        WHEEL_SLOTS = 4 * WHEEL_SLOTS_PER_TIMEOUT
+    };
 
-        SpaceObjectReference object;
-        //Either value or opd will be non-null.  Never both.
-        LocUpdate* value;
-        SequencedPresenceProperties* opd;
+    // Saved updates are kept in a pool and reused instead of being allocated
+    // individually. The records for each object form a doubly linked list,
+    // oldest first.
+    struct UpdateRecord {
+        UpdateRecord();
 
+        SpaceObjectReference object;
         Time expiresAt;
+        // Incremented each time the record is released, so stale references
+        // to it in the timing wheel can be ignored.
+        uint32 generation;
+        uint32 prev;
+        uint32 next;
+
+        // Whether this is a complete backup of an object's properties from
+        // addUpdateFromExisting rather than an update
+        bool fromExisting;
+        // For updates, bitmask of the SequencedPresenceProperties parts that
+        // are set
+        uint8 parts;
+        bool hasEpoch;
+        uint64 epoch;
+        SequencedPresenceProperties props;
+        std::vector<ProxIndexID> indexIDs;
+        uint64 indexIDsSeqno;
+    };
+    // std::deque so references to records stay valid while listeners add
+    // more of them
+    typedef std::deque<UpdateRecord> UpdateRecordPool;
+
+    // Exposes a saved update as a LocUpdate
+    class RecordLocUpdate : public LocUpdate {
+    public:
+        RecordLocUpdate(const UpdateRecord& rec) : mRecord(rec) {}
+        virtual ~RecordLocUpdate() {}
+
+        virtual ObjectReference object() const { return mRecord.object.object(); }
+
+        virtual bool has_epoch() const { return mRecord.hasEpoch; }
+        virtual uint64 epoch() const { return mRecord.epoch; }
+
+        virtual bool has_parent() const { return hasPart(SequencedPresenceProperties::LOC_PARENT_PART); }
+        virtual ObjectReference parent() const { return ObjectReference(mRecord.props.parent()); }
+        virtual uint64 parent_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_PARENT_PART); }
+
+        virtual bool has_location() const { return hasPart(SequencedPresenceProperties::LOC_POS_PART); }
+        virtual TimedMotionVector3f location() const { return mRecord.props.location(); }
+        virtual uint64 location_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_POS_PART); }
+
+        virtual bool has_orientation() const { return hasPart(SequencedPresenceProperties::LOC_ORIENT_PART); }
+        virtual TimedMotionQuaternion orientation() const { return mRecord.props.orientation(); }
+        virtual uint64 orientation_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_ORIENT_PART); }
+
+        virtual bool has_bounds() const { return hasPart(SequencedPresenceProperties::LOC_BOUNDS_PART); }
+        virtual AggregateBoundingInfo bounds() const { return mRecord.props.bounds(); }
+        virtual uint64 bounds_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_BOUNDS_PART); }
+
+        virtual bool has_mesh() const { return hasPart(SequencedPresenceProperties::LOC_MESH_PART); }
+        virtual String mesh() const { return mRecord.props.mesh().toString(); }
+        virtual uint64 mesh_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_MESH_PART); }
+
+        virtual bool has_physics() const { return hasPart(SequencedPresenceProperties::LOC_PHYSICS_PART); }
+        virtual String physics() const { return mRecord.props.physics(); }
+        virtual uint64 physics_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_PHYSICS_PART); }
+
+        virtual bool has_query_data() const { return hasPart(SequencedPresenceProperties::LOC_QUERY_DATA_PART); }
+        virtual String query_data() const { return mRecord.props.queryData(); }
+        virtual uint64 query_data_seqno() const { return mRecord.props.getUpdateSeqNo(SequencedPresenceProperties::LOC_QUERY_DATA_PART); }
+
+        virtual uint32 index_id_size() const { return mRecord.indexIDs.size(); }
+        virtual ProxIndexID index_id(int32 idx) const { return mRecord.indexIDs[idx]; }
+        virtual uint64 index_id_seqno() const { return mRecord.indexIDsSeqno; }
+
     private:
-        UpdateInfo();
+        RecordLocUpdate();
+
+        bool hasPart(SequencedPresenceProperties::LOC_PARTS part) const {
+            return (mRecord.parts & (1 << part)) != 0;
+        }
+
+        const UpdateRecord& mRecord;
+    };
+
+    struct RecordList {
+        RecordList() : head(NO_RECORD), tail(NO_RECORD) {}
+        uint32 head;
+        uint32 tail;
+    };
+    typedef std::tr1::unordered_map<SpaceObjectReference, RecordList, SpaceObjectReference::Hasher> ObjectUpdateMap;
+
+    struct WheelEntry {
+        WheelEntry(uint32 rec, uint32 gen) : record(rec), generation(gen) {}
+        uint32 record;
+        uint32 generation;
     };
-    typedef std::tr1::shared_ptr<UpdateInfo> UpdateInfoPtr;
-    typedef std::vector<UpdateInfoPtr> UpdateInfoList;
+    typedef std::vector<WheelEntry> WheelSlot;
 
-    typedef std::tr1::unordered_map<SpaceObjectReference, UpdateInfoList, SpaceObjectReference::Hasher> ObjectUpdateMap;
+    // Get a record for a new update to observed, adding it to the object's
+    // list and the timing wheel
+    uint32 allocateRecord(const SpaceObjectReference& observed);
+    // Remove all of an object's records from tracking, returning the first
+    // one. They must each be passed to releaseRecord.
+    uint32 takeUpdates(const SpaceObjectReference& observed);
+    // Return a record to the pool, returning the next record in its list
+    uint32 releaseRecord(uint32 idx);
+    // Remove a record from its object's list
+    void unlinkRecord(uint32 idx);
+
+    uint64 wheelTick(const Time& t) const;
 
     Context* mContext;
     Duration mTimeout;
     ObjectUpdateMap mUpdates;
+
+    UpdateRecordPool mRecords;
+    std::vector<uint32> mFreeRecords;
+
+    // Records are bucketed by expiration time, so expiring them only needs
+    // to look at the buckets that have passed, not at every saved update
+    std::vector<WheelSlot> mWheel;
+    int64 mWheelSlotWidth;
+    // The next tick of the wheel that hasn't been expired yet
+    uint64 mNextTick;
 }; // class OrphanLocUpdateManager
 
 typedef std::tr1::shared_ptr<OrphanLocUpdateManager> OrphanLocUpdateManagerPtr;
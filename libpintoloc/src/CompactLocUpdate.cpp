@@ -0,0 +1,687 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
+#include "Protocol_Loc.pbj.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Sirikata {
+
+namespace {
+
+// Message flags
+enum {
+    // The channel's reference frame follows: origin and quantization steps
+    MESSAGE_FRAME = 0x01,
+    // A list of the numbers of objects to forget follows
+    MESSAGE_REMOVALS = 0x02
+};
+
+// Per update property bitmap
+enum {
+    FIELD_NEW_OBJECT = 0x01,
+    FIELD_LOCATION = 0x02,
+    FIELD_ORIENTATION = 0x04,
+    FIELD_BOUNDS = 0x08,
+    FIELD_MESH = 0x10,
+    FIELD_PHYSICS = 0x20,
+    FIELD_EPOCH = 0x40,
+    // A second bitmap byte follows
+    FIELD_EXTRA = 0x80
+};
+enum {
+    EXTRA_PARENT = 0x01,
+    EXTRA_INDEX_IDS = 0x02,
+    EXTRA_QUERY_DATA = 0x04
+};
+
+// Quaternion encodings. Values in between are the smallest three encoding,
+// QUAT_LARGEST + the index of the dropped component.
+enum {
+    QUAT_IDENTITY = 0,
+    QUAT_LARGEST = 1,
+    QUAT_RAW = 5
+};
+
+// String encodings. Larger values are STRING_INTERNED + an index into the
+// table of previously interned strings.
+enum {
+    STRING_LITERAL = 0,
+    STRING_NEW = 1,
+    STRING_INTERNED = 2
+};
+
+// Bounds the memory used by each side of the channel for interned strings.
+const uint32 MAX_INTERNED_STRINGS = 4096;
+
+// Components of a unit quaternion other than the largest are in
+// [-1/sqrt(2), 1/sqrt(2)]
+const float32 SMALLEST_THREE_RANGE = 0.70710678f;
+const float32 SMALLEST_THREE_SCALE = 32767.f;
+
+uint64 zigzag(int64 v) {
+    return ((uint64)v << 1) ^ (uint64)(v >> 63);
+}
+
+int64 unzigzag(uint64 v) {
+    return (int64)(v >> 1) ^ -(int64)(v & 1);
+}
+
+void writeVarint(String& out, uint64 v) {
+    while(v >= 0x80) {
+        out.push_back((char)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+void writeSigned(String& out, int64 v) {
+    writeVarint(out, zigzag(v));
+}
+
+void writeFloat(String& out, float32 v) {
+    uint32 bits;
+    memcpy(&bits, &v, sizeof(bits));
+    for(uint32 i = 0; i < 4; i++)
+        out.push_back((char)((bits >> (8*i)) & 0xFF));
+}
+
+void writeUUID(String& out, const UUID& id) {
+    out.append((const char*)id.getArray().begin(), (size_t)UUID::static_size);
+}
+
+void writeQuaternion(String& out, const Quaternion& q) {
+    if (q.x == 0.f && q.y == 0.f && q.z == 0.f && q.w == 1.f) {
+        out.push_back((char)QUAT_IDENTITY);
+        return;
+    }
+
+    float32 comps[4] = { q.x, q.y, q.z, q.w };
+    float32 len2 = comps[0]*comps[0] + comps[1]*comps[1] + comps[2]*comps[2] + comps[3]*comps[3];
+    // Smallest three only works for unit quaternions
+    if (std::fabs(len2 - 1.f) > 1e-3f) {
+        out.push_back((char)QUAT_RAW);
+        for(uint32 i = 0; i < 4; i++)
+            writeFloat(out, comps[i]);
+        return;
+    }
+
+    uint32 largest = 0;
+    for(uint32 i = 1; i < 4; i++)
+        if (std::fabs(comps[i]) > std::fabs(comps[largest])) largest = i;
+    // q and -q are the same rotation, so we can always make the dropped
+    // component positive
+    float32 sign = (comps[largest] < 0.f) ? -1.f : 1.f;
+
+    out.push_back((char)(QUAT_LARGEST + largest));
+    for(uint32 i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float32 scaled = sign * comps[i] / SMALLEST_THREE_RANGE * SMALLEST_THREE_SCALE;
+        scaled = std::max(-SMALLEST_THREE_SCALE, std::min(SMALLEST_THREE_SCALE, scaled));
+        int16 val = (int16)std::floor(scaled + 0.5f);
+        out.push_back((char)(val & 0xFF));
+        out.push_back((char)((val >> 8) & 0xFF));
+    }
+}
+
+int64 quantize(float32 v, float32 precision) {
+    return (int64)std::floor((float64)v / precision + 0.5);
+}
+
+bool sameQuaternion(const Quaternion& a, const Quaternion& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+bool sameBounds(const AggregateBoundingInfo& a, const AggregateBoundingInfo& b) {
+    return a.centerOffset == b.centerOffset &&
+        a.centerBoundsRadius == b.centerBoundsRadius &&
+        a.maxObjectRadius == b.maxObjectRadius;
+}
+
+} // namespace
+
+
+
+CompactLocUpdateEncoder::ObjectState::ObjectState()
+ : sent(0)
+{
+    for(uint32 i = 0; i < 3; i++)
+        position[i] = velocity[i] = 0;
+}
+
+CompactLocUpdateEncoder::CompactLocUpdateEncoder(float32 position_precision, float32 velocity_precision)
+ : mPositionPrecision(position_precision),
+   mVelocityPrecision(velocity_precision),
+   mStarted(false),
+   mOrigin(0, 0, 0),
+   mLastSeqno(0),
+   mLastTime(Time::null())
+{
+}
+
+void CompactLocUpdateEncoder::writeString(String& out, const String& str) {
+    StringIndexMap::iterator it = mStringIndices.find(str);
+    if (it != mStringIndices.end()) {
+        writeVarint(out, STRING_INTERNED + it->second);
+        return;
+    }
+
+    if (mStringIndices.size() < MAX_INTERNED_STRINGS) {
+        uint32 idx = mStringIndices.size();
+        mStringIndices[str] = idx;
+        writeVarint(out, STRING_NEW);
+    }
+    else {
+        writeVarint(out, STRING_LITERAL);
+    }
+    writeVarint(out, str.size());
+    out.append(str);
+}
+
+String CompactLocUpdateEncoder::encode(const Sirikata::Protocol::Loc::BulkLocationUpdate& blu) {
+    String out;
+    out.push_back((char)MAGIC);
+    out.push_back((char)VERSION);
+
+    uint8 flags = 0;
+    if (!mStarted)
+        flags |= MESSAGE_FRAME;
+    if (!mRemovedIndices.empty())
+        flags |= MESSAGE_REMOVALS;
+    out.push_back((char)flags);
+
+    if (flags & MESSAGE_FRAME) {
+        mStarted = true;
+        if (blu.update_size() > 0 && blu.update(0).has_location())
+            mOrigin = blu.update(0).location().position();
+        writeFloat(out, mOrigin.x);
+        writeFloat(out, mOrigin.y);
+        writeFloat(out, mOrigin.z);
+        writeFloat(out, mPositionPrecision);
+        writeFloat(out, mVelocityPrecision);
+    }
+
+    // Removals come before the updates so objects in this message can
+    // reuse the numbers
+    if (flags & MESSAGE_REMOVALS) {
+        writeVarint(out, mRemovedIndices.size());
+        for(uint32 i = 0; i < mRemovedIndices.size(); i++) {
+            writeVarint(out, mRemovedIndices[i]);
+            mFreeIndices.push_back(mRemovedIndices[i]);
+        }
+        mRemovedIndices.clear();
+    }
+
+    writeVarint(out, blu.update_size());
+    for(int32 idx = 0; idx < blu.update_size(); idx++) {
+        Sirikata::Protocol::Loc::LocationUpdate update = blu.update(idx);
+
+        uint8 fields = 0, extra = 0;
+        ObjectIndexMap::iterator obj_it = mObjectIndices.find(update.object());
+        if (obj_it == mObjectIndices.end()) {
+            uint32 new_idx = mObjects.size();
+            if (!mFreeIndices.empty()) {
+                new_idx = mFreeIndices.back();
+                mFreeIndices.pop_back();
+            }
+            else {
+                mObjects.push_back(ObjectState());
+            }
+            obj_it = mObjectIndices.insert( ObjectIndexMap::value_type(update.object(), new_idx) ).first;
+            fields |= FIELD_NEW_OBJECT;
+        }
+        ObjectState& state = mObjects[obj_it->second];
+
+        // Figure out what changed since the last update for this object
+        int64 position[3], velocity[3];
+        if (update.has_location()) {
+            Vector3f pos = update.location().position() - mOrigin;
+            Vector3f vel = update.location().velocity();
+            position[0] = quantize(pos.x, mPositionPrecision);
+            position[1] = quantize(pos.y, mPositionPrecision);
+            position[2] = quantize(pos.z, mPositionPrecision);
+            velocity[0] = quantize(vel.x, mVelocityPrecision);
+            velocity[1] = quantize(vel.y, mVelocityPrecision);
+            velocity[2] = quantize(vel.z, mVelocityPrecision);
+            bool changed = !(state.sent & FIELD_LOCATION) || update.location().t() != state.locationTime;
+            for(uint32 i = 0; i < 3; i++)
+                changed = changed || position[i] != state.position[i] || velocity[i] != state.velocity[i];
+            if (changed) fields |= FIELD_LOCATION;
+        }
+        if (update.has_orientation() &&
+            (!(state.sent & FIELD_ORIENTATION) ||
+                update.orientation().t() != state.orientationTime ||
+                !sameQuaternion(update.orientation().position(), state.orientation) ||
+                !sameQuaternion(update.orientation().velocity(), state.orientationVelocity)))
+            fields |= FIELD_ORIENTATION;
+        AggregateBoundingInfo bounds;
+        if (update.has_aggregate_bounds()) {
+            bounds = AggregateBoundingInfo(
+                update.aggregate_bounds().has_center_offset() ? update.aggregate_bounds().center_offset() : Vector3f(0,0,0),
+                update.aggregate_bounds().has_center_bounds_radius() ? update.aggregate_bounds().center_bounds_radius() : 0.f,
+                update.aggregate_bounds().has_max_object_size() ? update.aggregate_bounds().max_object_size() : 0.f
+            );
+            if (!(state.sent & FIELD_BOUNDS) || !sameBounds(bounds, state.bounds))
+                fields |= FIELD_BOUNDS;
+        }
+        if (update.has_mesh() && (!(state.sent & FIELD_MESH) || update.mesh() != state.mesh))
+            fields |= FIELD_MESH;
+        if (update.has_physics() && (!(state.sent & FIELD_PHYSICS) || update.physics() != state.physics))
+            fields |= FIELD_PHYSICS;
+        if (update.has_epoch())
+            fields |= FIELD_EPOCH;
+        if (update.has_parent())
+            extra |= EXTRA_PARENT;
+        if (update.index_id_size() > 0)
+            extra |= EXTRA_INDEX_IDS;
+        if (update.has_query_data() && (!(state.sent & FIELD_EXTRA) || update.query_data() != state.queryData))
+            extra |= EXTRA_QUERY_DATA;
+        if (extra != 0)
+            fields |= FIELD_EXTRA;
+
+        out.push_back((char)fields);
+        if (fields & FIELD_EXTRA)
+            out.push_back((char)extra);
+
+        if (fields & FIELD_NEW_OBJECT)
+            writeUUID(out, update.object());
+        else
+            writeVarint(out, obj_it->second);
+
+        uint64 seqno = update.has_seqno() ? update.seqno() : 0;
+        writeSigned(out, (int64)(seqno - mLastSeqno));
+        mLastSeqno = seqno;
+
+        if (fields & FIELD_EPOCH)
+            writeVarint(out, update.epoch());
+        if (extra & EXTRA_PARENT)
+            writeUUID(out, update.parent());
+
+        if (fields & FIELD_LOCATION) {
+            Time t = update.location().t();
+            writeSigned(out, (int64)(t.raw() - mLastTime.raw()));
+            mLastTime = t;
+            for(uint32 i = 0; i < 3; i++)
+                writeSigned(out, position[i] - state.position[i]);
+            for(uint32 i = 0; i < 3; i++)
+                writeSigned(out, velocity[i] - state.velocity[i]);
+
+            state.locationTime = t;
+            for(uint32 i = 0; i < 3; i++) {
+                state.position[i] = position[i];
+                state.velocity[i] = velocity[i];
+            }
+            state.sent |= FIELD_LOCATION;
+        }
+
+        if (fields & FIELD_ORIENTATION) {
+            Time t = update.orientation().t();
+            writeSigned(out, (int64)(t.raw() - mLastTime.raw()));
+            mLastTime = t;
+            writeQuaternion(out, update.orientation().position());
+            writeQuaternion(out, update.orientation().velocity());
+
+            state.orientationTime = t;
+            state.orientation = update.orientation().position();
+            state.orientationVelocity = update.orientation().velocity();
+            state.sent |= FIELD_ORIENTATION;
+        }
+
+        if (fields & FIELD_BOUNDS) {
+            writeFloat(out, bounds.centerOffset.x);
+            writeFloat(out, bounds.centerOffset.y);
+            writeFloat(out, bounds.centerOffset.z);
+            writeFloat(out, bounds.centerBoundsRadius);
+            writeFloat(out, bounds.maxObjectRadius);
+            state.bounds = bounds;
+            state.sent |= FIELD_BOUNDS;
+        }
+
+        if (fields & FIELD_MESH) {
+            state.mesh = update.mesh();
+            writeString(out, state.mesh);
+            state.sent |= FIELD_MESH;
+        }
+        if (fields & FIELD_PHYSICS) {
+            state.physics = update.physics();
+            writeString(out, state.physics);
+            state.sent |= FIELD_PHYSICS;
+        }
+
+        if (extra & EXTRA_INDEX_IDS) {
+            writeVarint(out, update.index_id_size());
+            for(int32 i = 0; i < update.index_id_size(); i++)
+                writeVarint(out, update.index_id(i));
+        }
+        if (extra & EXTRA_QUERY_DATA) {
+            // Query data is rarely repeated, so it isn't interned
+            state.queryData = update.query_data();
+            writeVarint(out, state.queryData.size());
+            out.append(state.queryData);
+            state.sent |= FIELD_EXTRA;
+        }
+    }
+
+    return out;
+}
+
+void CompactLocUpdateEncoder::removeObject(const UUID& id) {
+    ObjectIndexMap::iterator obj_it = mObjectIndices.find(id);
+    if (obj_it == mObjectIndices.end()) return;
+    mObjects[obj_it->second] = ObjectState();
+    mRemovedIndices.push_back(obj_it->second);
+    mObjectIndices.erase(obj_it);
+}
+
+uint32 CompactLocUpdateEncoder::objectCount() const {
+    return mObjectIndices.size();
+}
+
+
+
+class CompactLocUpdateDecoder::Reader {
+public:
+    Reader(const String& data)
+     : mData(data),
+       mPos(0)
+    {}
+
+    bool done() const { return mPos >= mData.size(); }
+
+    bool readByte(uint8& v) {
+        if (mPos >= mData.size()) return false;
+        v = (uint8)mData[mPos++];
+        return true;
+    }
+
+    bool readVarint(uint64& v) {
+        v = 0;
+        for(uint32 shift = 0; shift < 64; shift += 7) {
+            uint8 b;
+            if (!readByte(b)) return false;
+            v |= (uint64)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    bool readSigned(int64& v) {
+        uint64 raw;
+        if (!readVarint(raw)) return false;
+        v = unzigzag(raw);
+        return true;
+    }
+
+    bool readFloat(float32& v) {
+        if (mData.size() - mPos < 4) return false;
+        uint32 bits = 0;
+        for(uint32 i = 0; i < 4; i++)
+            bits |= (uint32)(uint8)mData[mPos++] << (8*i);
+        memcpy(&v, &bits, sizeof(v));
+        return true;
+    }
+
+    bool readBytes(String& v, uint64 len) {
+        if (mData.size() - mPos < len) return false;
+        v = mData.substr(mPos, (size_t)len);
+        mPos += (size_t)len;
+        return true;
+    }
+
+    bool readUUID(UUID& v) {
+        if (mData.size() - mPos < UUID::static_size) return false;
+        v = UUID((const byte*)mData.data() + mPos, UUID::static_size);
+        mPos += UUID::static_size;
+        return true;
+    }
+
+    bool readQuaternion(Quaternion& q) {
+        uint8 kind;
+        if (!readByte(kind)) return false;
+        if (kind == QUAT_IDENTITY) {
+            q = Quaternion::identity();
+            return true;
+        }
+        float32 comps[4];
+        if (kind == QUAT_RAW) {
+            for(uint32 i = 0; i < 4; i++)
+                if (!readFloat(comps[i])) return false;
+        }
+        else if (kind >= QUAT_LARGEST && kind < QUAT_LARGEST + 4) {
+            uint32 largest = kind - QUAT_LARGEST;
+            float32 sum2 = 0.f;
+            for(uint32 i = 0; i < 4; i++) {
+                if (i == largest) continue;
+                uint8 lo, hi;
+                if (!readByte(lo) || !readByte(hi)) return false;
+                int16 val = (int16)((uint16)lo | ((uint16)hi << 8));
+                comps[i] = (float32)val / SMALLEST_THREE_SCALE * SMALLEST_THREE_RANGE;
+                sum2 += comps[i]*comps[i];
+            }
+            comps[largest] = std::sqrt(std::max(0.f, 1.f - sum2));
+        }
+        else {
+            return false;
+        }
+        q = Quaternion(comps[0], comps[1], comps[2], comps[3], Quaternion::XYZW());
+        return true;
+    }
+
+private:
+    const String& mData;
+    size_t mPos;
+};
+
+
+CompactLocUpdateDecoder::ObjectState::ObjectState() {
+    for(uint32 i = 0; i < 3; i++)
+        position[i] = velocity[i] = 0;
+}
+
+CompactLocUpdateDecoder::CompactLocUpdateDecoder()
+ : mStarted(false),
+   mOrigin(0, 0, 0),
+   mPositionPrecision(1.f),
+   mVelocityPrecision(1.f),
+   mLastSeqno(0),
+   mLastTime(Time::null())
+{
+}
+
+bool CompactLocUpdateDecoder::isCompact(const String& data) {
+    // The first byte of a BulkLocationUpdate is a field tag, and 0xFF would
+    // be an invalid wire type
+    return (data.size() >= 2 && (uint8)data[0] == CompactLocUpdateEncoder::MAGIC);
+}
+
+bool CompactLocUpdateDecoder::readString(Reader& reader, String& out) {
+    uint64 kind;
+    if (!reader.readVarint(kind)) return false;
+    if (kind >= STRING_INTERNED) {
+        uint64 idx = kind - STRING_INTERNED;
+        if (idx >= mStrings.size()) return false;
+        out = mStrings[(size_t)idx];
+        return true;
+    }
+
+    uint64 len;
+    if (!reader.readVarint(len) || !reader.readBytes(out, len)) return false;
+    if (kind == STRING_NEW)
+        mStrings.push_back(out);
+    return true;
+}
+
+bool CompactLocUpdateDecoder::decode(const String& data, Sirikata::Protocol::Loc::BulkLocationUpdate& blu) {
+    if (!isCompact(data))
+        return blu.ParseFromString(data);
+
+    Reader reader(data);
+    uint8 magic, version, flags;
+    if (!reader.readByte(magic) || !reader.readByte(version) || !reader.readByte(flags))
+        return false;
+    if (version != CompactLocUpdateEncoder::VERSION)
+        return false;
+
+    if (flags & MESSAGE_FRAME) {
+        if (!reader.readFloat(mOrigin.x) || !reader.readFloat(mOrigin.y) || !reader.readFloat(mOrigin.z) ||
+            !reader.readFloat(mPositionPrecision) || !reader.readFloat(mVelocityPrecision))
+            return false;
+        mStarted = true;
+    }
+    // Without the frame we can't make sense of anything, we must have missed
+    // the start of the channel
+    if (!mStarted)
+        return false;
+
+    if (flags & MESSAGE_REMOVALS) {
+        uint64 num_removed;
+        if (!reader.readVarint(num_removed)) return false;
+        for(uint64 i = 0; i < num_removed; i++) {
+            uint64 removed_idx;
+            if (!reader.readVarint(removed_idx) || removed_idx >= mObjects.size()) return false;
+            mObjects[(size_t)removed_idx] = ObjectState();
+            mFreeIndices.push_back((uint32)removed_idx);
+        }
+    }
+
+    uint64 count;
+    if (!reader.readVarint(count)) return false;
+    for(uint64 idx = 0; idx < count; idx++) {
+        uint8 fields, extra = 0;
+        if (!reader.readByte(fields)) return false;
+        if ((fields & FIELD_EXTRA) && !reader.readByte(extra)) return false;
+
+        uint32 obj_idx;
+        if (fields & FIELD_NEW_OBJECT) {
+            UUID id;
+            if (!reader.readUUID(id)) return false;
+            if (!mFreeIndices.empty()) {
+                obj_idx = mFreeIndices.back();
+                mFreeIndices.pop_back();
+            }
+            else {
+                obj_idx = mObjects.size();
+                mObjects.push_back(ObjectState());
+            }
+            mObjects[obj_idx].id = id;
+        }
+        else {
+            uint64 raw_idx;
+            if (!reader.readVarint(raw_idx) || raw_idx >= mObjects.size()) return false;
+            obj_idx = (uint32)raw_idx;
+        }
+        ObjectState& state = mObjects[obj_idx];
+
+        Sirikata::Protocol::Loc::ILocationUpdate update = blu.add_update();
+        update.set_object(state.id);
+
+        int64 seqno_delta;
+        if (!reader.readSigned(seqno_delta)) return false;
+        mLastSeqno += seqno_delta;
+        update.set_seqno(mLastSeqno);
+
+        if (fields & FIELD_EPOCH) {
+            uint64 epoch;
+            if (!reader.readVarint(epoch)) return false;
+            update.set_epoch(epoch);
+        }
+        if (extra & EXTRA_PARENT) {
+            UUID parent;
+            if (!reader.readUUID(parent)) return false;
+            update.set_parent(parent);
+        }
+
+        if (fields & FIELD_LOCATION) {
+            int64 dt;
+            if (!reader.readSigned(dt)) return false;
+            mLastTime = Time(mLastTime.raw() + dt);
+            for(uint32 i = 0; i < 3; i++) {
+                int64 delta;
+                if (!reader.readSigned(delta)) return false;
+                state.position[i] += delta;
+            }
+            for(uint32 i = 0; i < 3; i++) {
+                int64 delta;
+                if (!reader.readSigned(delta)) return false;
+                state.velocity[i] += delta;
+            }
+
+            Sirikata::Protocol::ITimedMotionVector location = update.mutable_location();
+            location.set_t(mLastTime);
+            location.set_position(mOrigin + Vector3f(
+                    (float32)(state.position[0] * (float64)mPositionPrecision),
+                    (float32)(state.position[1] * (float64)mPositionPrecision),
+                    (float32)(state.position[2] * (float64)mPositionPrecision)
+                ));
+            location.set_velocity(Vector3f(
+                    (float32)(state.velocity[0] * (float64)mVelocityPrecision),
+                    (float32)(state.velocity[1] * (float64)mVelocityPrecision),
+                    (float32)(state.velocity[2] * (float64)mVelocityPrecision)
+                ));
+        }
+
+        if (fields & FIELD_ORIENTATION) {
+            int64 dt;
+            Quaternion orient, orient_vel;
+            if (!reader.readSigned(dt) || !reader.readQuaternion(orient) || !reader.readQuaternion(orient_vel))
+                return false;
+            mLastTime = Time(mLastTime.raw() + dt);
+
+            Sirikata::Protocol::ITimedMotionQuaternion orientation = update.mutable_orientation();
+            orientation.set_t(mLastTime);
+            orientation.set_position(orient);
+            orientation.set_velocity(orient_vel);
+        }
+
+        if (fields & FIELD_BOUNDS) {
+            Vector3f offset;
+            float32 center_rad, max_size;
+            if (!reader.readFloat(offset.x) || !reader.readFloat(offset.y) || !reader.readFloat(offset.z) ||
+                !reader.readFloat(center_rad) || !reader.readFloat(max_size))
+                return false;
+
+            Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = update.mutable_aggregate_bounds();
+            msg_bounds.set_center_offset(offset);
+            msg_bounds.set_center_bounds_radius(center_rad);
+            msg_bounds.set_max_object_size(max_size);
+        }
+
+        if (fields & FIELD_MESH) {
+            String mesh;
+            if (!readString(reader, mesh)) return false;
+            update.set_mesh(mesh);
+        }
+        if (fields & FIELD_PHYSICS) {
+            String physics;
+            if (!readString(reader, physics)) return false;
+            update.set_physics(physics);
+        }
+
+        if (extra & EXTRA_INDEX_IDS) {
+            uint64 num_ids;
+            if (!reader.readVarint(num_ids)) return false;
+            for(uint64 i = 0; i < num_ids; i++) {
+                uint64 index_id;
+                if (!reader.readVarint(index_id)) return false;
+                update.add_index_id((uint32)index_id);
+            }
+        }
+        if (extra & EXTRA_QUERY_DATA) {
+            uint64 len;
+            String query_data;
+            if (!reader.readVarint(len) || !reader.readBytes(query_data, len)) return false;
+            update.set_query_data(query_data);
+        }
+    }
+
+    return reader.done();
+}
+
+uint32 CompactLocUpdateDecoder::objectCount() const {
+    return mObjects.size() - mFreeIndices.size();
+}
+
+} // namespace Sirikata
@@ -6,41 +6,167 @@
 #include <sirikata/core/service/Context.hpp>
 #include "Protocol_Loc.pbj.hpp"
 #include <sirikata/proxyobject/ProxyObject.hpp>
-#include <sirikata/pintoloc/CopyableLocUpdate.hpp>
 
 namespace Sirikata {
 
-OrphanLocUpdateManager::UpdateInfo::~UpdateInfo() {
-    if (value != NULL)
-        delete value;
-    if (opd != NULL)
-        delete opd;
+OrphanLocUpdateManager::UpdateRecord::UpdateRecord()
+ : object(SpaceObjectReference::null()),
+   expiresAt(Time::null()),
+   generation(0),
+   prev(NO_RECORD),
+   next(NO_RECORD),
+   fromExisting(false),
+   parts(0),
+   hasEpoch(false),
+   epoch(0),
+   indexIDsSeqno(0)
+{
 }
 
 OrphanLocUpdateManager::OrphanLocUpdateManager(Context* ctx, Network::IOStrand* strand, const Duration& timeout)
  : PollingService(strand, "OrphanLocUpdateManager Poll", timeout, ctx, "OrphanLocUpdateManager"),
    mContext(ctx),
-   mTimeout(timeout)
+   mTimeout(timeout),
+   mWheel(WHEEL_SLOTS),
+   mWheelSlotWidth(std::max(timeout.toMicro() / WHEEL_SLOTS_PER_TIMEOUT, (int64)1000)),
+   mNextTick(0)
 {
+    // Start the wheel at the current time so the first expire() doesn't have
+    // to walk from time 0
+    mNextTick = wheelTick(mContext->simTime());
+}
+
+uint64 OrphanLocUpdateManager::wheelTick(const Time& t) const {
+    int64 us = (t - Time::null()).toMicro();
+    if (us < 0) return 0;
+    return (uint64)(us / mWheelSlotWidth);
+}
+
+uint32 OrphanLocUpdateManager::allocateRecord(const SpaceObjectReference& observed) {
+    uint32 idx;
+    if (!mFreeRecords.empty()) {
+        idx = mFreeRecords.back();
+        mFreeRecords.pop_back();
+    }
+    else {
+        idx = mRecords.size();
+        mRecords.push_back(UpdateRecord());
+    }
+
+    UpdateRecord& rec = mRecords[idx];
+    rec.object = observed;
+    rec.expiresAt = mContext->simTime() + mTimeout;
+
+    // Append to the object's list, keeping them in the order they were added
+    RecordList& records = mUpdates[observed];
+    rec.prev = records.tail;
+    rec.next = NO_RECORD;
+    if (records.tail != NO_RECORD)
+        mRecords[records.tail].next = idx;
+    else
+        records.head = idx;
+    records.tail = idx;
+
+    // Slots that have already been expired won't be looked at again until the
+    // wheel comes back around, so never insert behind the current position
+    uint64 tick = std::max(wheelTick(rec.expiresAt), mNextTick);
+    mWheel[tick % WHEEL_SLOTS].push_back(WheelEntry(idx, rec.generation));
+
+    return idx;
+}
+
+uint32 OrphanLocUpdateManager::takeUpdates(const SpaceObjectReference& observed) {
+    ObjectUpdateMap::iterator it = mUpdates.find(observed);
+    if (it == mUpdates.end()) return NO_RECORD;
+    uint32 head = it->second.head;
+    mUpdates.erase(it);
+    return head;
+}
+
+uint32 OrphanLocUpdateManager::releaseRecord(uint32 idx) {
+    UpdateRecord& rec = mRecords[idx];
+    uint32 next = rec.next;
+    rec.prev = NO_RECORD;
+    rec.next = NO_RECORD;
+    // Invalidates any entries for this record left in the wheel
+    rec.generation++;
+    mFreeRecords.push_back(idx);
+    return next;
+}
+
+void OrphanLocUpdateManager::unlinkRecord(uint32 idx) {
+    UpdateRecord& rec = mRecords[idx];
+    ObjectUpdateMap::iterator it = mUpdates.find(rec.object);
+    assert(it != mUpdates.end());
+    RecordList& records = it->second;
+
+    if (rec.prev != NO_RECORD)
+        mRecords[rec.prev].next = rec.next;
+    else
+        records.head = rec.next;
+    if (rec.next != NO_RECORD)
+        mRecords[rec.next].prev = rec.prev;
+    else
+        records.tail = rec.prev;
 
+    if (records.head == NO_RECORD)
+        mUpdates.erase(it);
 }
 
 void OrphanLocUpdateManager::addOrphanUpdate(const SpaceObjectReference& observed, const LocUpdate& update) {
     assert( ObjectReference(update.object()) == observed.object() );
-    UpdateInfoList& info_list = mUpdates[observed];
-    info_list.push_back(
-        UpdateInfoPtr(new UpdateInfo(observed, new CopyableLocUpdate(update), mContext->simTime() + mTimeout))
-    );
+
+    UpdateRecord& rec = mRecords[allocateRecord(observed)];
+    rec.fromExisting = false;
+    rec.hasEpoch = update.has_epoch();
+    rec.epoch = update.has_epoch() ? update.epoch() : 0;
+
+    // Only the parts in the update are filled in, the rest of props may have
+    // stale data from a previous use of this record
+    rec.props.reset();
+    rec.parts = 0;
+    if (update.has_parent()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_PARENT_PART);
+        rec.props.setParent(update.parent(), update.parent_seqno());
+    }
+    if (update.has_location()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_POS_PART);
+        rec.props.setLocation(update.location(), update.location_seqno());
+    }
+    if (update.has_orientation()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_ORIENT_PART);
+        rec.props.setOrientation(update.orientation(), update.orientation_seqno());
+    }
+    if (update.has_bounds()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_BOUNDS_PART);
+        rec.props.setBounds(update.bounds(), update.bounds_seqno());
+    }
+    if (update.has_mesh()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_MESH_PART);
+        rec.props.setMesh(Transfer::URI(update.mesh()), update.mesh_seqno());
+    }
+    if (update.has_physics()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_PHYSICS_PART);
+        rec.props.setPhysics(update.physics(), update.physics_seqno());
+    }
+    if (update.has_query_data()) {
+        rec.parts |= (1 << SequencedPresenceProperties::LOC_QUERY_DATA_PART);
+        rec.props.setQueryData(update.query_data(), update.query_data_seqno());
+    }
+
+    rec.indexIDs.clear();
+    for(uint32 i = 0; i < update.index_id_size(); i++)
+        rec.indexIDs.push_back(update.index_id(i));
+    rec.indexIDsSeqno = update.index_id_seqno();
 }
 
 void OrphanLocUpdateManager::addUpdateFromExisting(
     const SpaceObjectReference& observed,
     const SequencedPresenceProperties& props
 ) {
-    UpdateInfoList& info_list = mUpdates[observed];
-
-    SequencedPresenceProperties* opd = new SequencedPresenceProperties(props);
-    info_list.push_back( UpdateInfoPtr(new UpdateInfo(observed, opd, mContext->simTime() + mTimeout)) );
+    UpdateRecord& rec = mRecords[allocateRecord(observed)];
+    rec.fromExisting = true;
+    rec.props = props;
 }
 
 void OrphanLocUpdateManager::addUpdateFromExisting(ProxyObjectPtr proxyPtr) {
@@ -51,20 +177,42 @@ void OrphanLocUpdateManager::addUpdateFromExisting(ProxyObjectPtr proxyPtr) {
 }
 
 void OrphanLocUpdateManager::poll() {
-    Time now = mContext->simTime();
-    // Scan through all updates looking for outdated ones
-    for(ObjectUpdateMap::iterator it = mUpdates.begin(); it != mUpdates.end(); ) {
-        UpdateInfoList& info_list = it->second;
-        while(!info_list.empty() && (*info_list.begin())->expiresAt < now) {
-            info_list.erase(info_list.begin());
-        }
+    expire(mContext->simTime());
+}
 
-        ObjectUpdateMap::iterator next_it = it;
-        next_it++;
-        if (info_list.empty())
-            mUpdates.erase(it);
-        it = next_it;
+void OrphanLocUpdateManager::expire(const Time& t) {
+    uint64 now_tick = wheelTick(t);
+    if (now_tick < mNextTick) return;
+
+    // Each slot only needs to be visited once even if we've fallen more than a
+    // full rotation behind
+    uint64 end_tick = now_tick + 1;
+    if (end_tick - mNextTick > WHEEL_SLOTS)
+        mNextTick = end_tick - WHEEL_SLOTS;
+
+    WheelSlot keep;
+    for(; mNextTick < end_tick; mNextTick++) {
+        WheelSlot& slot = mWheel[mNextTick % WHEEL_SLOTS];
+        keep.clear();
+        for(WheelSlot::iterator it = slot.begin(); it != slot.end(); it++) {
+            UpdateRecord& rec = mRecords[it->record];
+            // Already invoked or expired, and possibly reused
+            if (rec.generation != it->generation) continue;
+
+            if (rec.expiresAt < t) {
+                unlinkRecord(it->record);
+                releaseRecord(it->record);
+            }
+            else {
+                // Either expires later in the current tick or belongs to a
+                // later rotation of the wheel
+                keep.push_back(*it);
+            }
+        }
+        slot.swap(keep);
     }
+    // Entries still in the current slot need to be checked again next time
+    mNextTick = now_tick;
 }
 
 } // namespace Sirikata
@@ -37,12 +37,17 @@
 
 #include <sirikata/proxyobject/Defs.hpp>
 #include "ProxyCreationListener.hpp"
+#include <sirikata/proxyobject/ProxyUpdateBatchListener.hpp>
 #include <sirikata/core/util/PresenceProperties.hpp>
 
 #include <sirikata/core/util/SerializationCheck.hpp>
 
 namespace Sirikata {
 
+namespace Network {
+class IOStrand;
+}
+
 /** An interface for a class that keeps track of proxy object references. */
 class SIRIKATA_PROXYOBJECT_EXPORT ProxyManager
     : public SelfWeakPtr<ProxyManager>,
@@ -53,7 +58,15 @@ class SIRIKATA_PROXYOBJECT_EXPORT ProxyManager
 public:
     typedef std::vector<SpaceObjectReference> ObjectReferenceList;
 
-    static ProxyManagerPtr construct(VWObjectPtr parent, const SpaceObjectReference& _id);
+    /** Create a ProxyManager.
+     *  \param parent the object that owns the presence
+     *  \param _id the presence this ProxyManager tracks proxies for
+     *  \param strand strand proxy updates are processed on. Batches for
+     *         ProxyUpdateBatchListeners are flushed by posting to it; if it is
+     *         NULL they are only delivered by explicit calls to
+     *         flushUpdates().
+     */
+    static ProxyManagerPtr construct(VWObjectPtr parent, const SpaceObjectReference& _id, Network::IOStrand* strand = NULL);
     virtual ~ProxyManager();
 
     const SpaceObjectReference& id() const { return mID; }
@@ -92,10 +105,18 @@ public:
     /// sequence number.
     void resetAllProxies();
 
+    /// Add a listener for batched proxy updates. Collecting changes only
+    /// happens while there are batch listeners.
+    void addBatchListener(ProxyUpdateBatchListener* listener);
+    void removeBatchListener(ProxyUpdateBatchListener* listener);
+    /// Deliver changes collected since the last batch to batch listeners now
+    /// instead of waiting for the posted flush.
+    void flushUpdates();
+
 private:
     friend class ProxyObject;
 
-    ProxyManager(VWObjectPtr parent, const SpaceObjectReference& _id);
+    ProxyManager(VWObjectPtr parent, const SpaceObjectReference& _id, Network::IOStrand* strand);
 
     // These track the *entire* lifetime of ProxyObjects. This allows
     // clients of ProxyManager to hold onto ProxyObjects beyond when
@@ -106,23 +127,55 @@ private:
     // updates (so that, if the object is removed and the re-added to
     // the result set, clients holding references from the first
     // addition will continue to receive updates).
-    void proxyDeleted(const ObjectReference& id);
+    void proxyDeleted(uint32 index, ProxyObject* proxy);
+    // Invoked by ProxyObjects when one of their properties changes
+    void proxyUpdated(uint32 index, uint32 parts);
+
+    static void handleFlushUpdates(ProxyManagerWPtr weak_self);
 
     // Parent HostedObject
     VWObjectPtr mParent;
     // Presence identifier that runs this ProxyManager
     SpaceObjectReference mID;
-
+    Network::IOStrand* mStrand;
+
+    // Proxies are tracked in a flat array of slots, reused through a free
+    // list, so each ProxyObject can refer to its entry by index instead of
+    // looking it up by ID for every update and on destruction. The map only
+    // serves lookups by ID.
+    enum {
+        NO_SLOT = 0xFFFFFFFF
+    };
     struct ProxyData {
-        ProxyData(ProxyObjectPtr p)
-         : ptr(p), wptr(p)
+        ProxyData()
+         : raw(NULL), dirty(0), nextFree(NO_SLOT)
         {}
 
         ProxyObjectPtr ptr;
         ProxyObjectWPtr wptr;
+        // Identifies the ProxyObject using the slot, even while it is being
+        // destroyed and wptr can't be locked. NULL if the slot is free.
+        ProxyObject* raw;
+        ObjectReference id;
+        // Parts changed since the last batch was delivered
+        uint32 dirty;
+        uint32 nextFree;
     };
-    typedef std::tr1::unordered_map<ObjectReference, ProxyData, ObjectReference::Hasher> ProxyMap;
-    ProxyMap mProxyMap;
+    typedef std::vector<ProxyData> ProxySlots;
+    ProxySlots mProxySlots;
+    uint32 mFreeSlot;
+    typedef std::tr1::unordered_map<ObjectReference, uint32, ObjectReference::Hasher> ProxyIndexMap;
+    ProxyIndexMap mProxyIndex;
+
+    uint32 allocateSlot();
+    void freeSlot(uint32 index);
+
+    typedef std::vector<ProxyUpdateBatchListener*> BatchListenerList;
+    BatchListenerList mBatchListeners;
+    // Slots with changes not yet delivered to batch listeners. May contain
+    // duplicates or freed slots, only those with dirty set are reported.
+    std::vector<uint32> mDirtySlots;
+    bool mFlushPosted;
 
     // We explicitly track when we add/remove active proxies because computing
     // this when you have a large number of aggregates is expensive (requires
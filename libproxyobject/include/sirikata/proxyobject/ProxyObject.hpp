@@ -121,9 +121,13 @@ public:
     typedef TimedWeightedExtrapolator<Location,UpdateNeeded> Extrapolator;
 
 private:
+    friend class ProxyManager;
+
     bool mValid;
     const SpaceObjectReference mID;
     ProxyManagerPtr mParent;
+    // Slot in mParent's proxy storage, assigned by ProxyManager
+    uint32 mProxyIndex;
 
 public:
     /** Constructs a new ProxyObject. After constructing this object, it
@@ -0,0 +1,46 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_PROXY_UPDATE_BATCH_LISTENER_HPP_
+#define _SIRIKATA_PROXY_UPDATE_BATCH_LISTENER_HPP_
+
+#include <sirikata/proxyobject/Platform.hpp>
+#include <sirikata/proxyobject/Defs.hpp>
+
+namespace Sirikata {
+
+/** Listens for changes to all the ProxyObjects of a ProxyManager at once.
+ *  Instead of a PositionListener/MeshListener call per property per proxy,
+ *  changes are collected while updates are processed and delivered once per
+ *  pass through the ProxyManager's strand, with each changed proxy listed
+ *  once no matter how many of its properties changed or how often.
+ *
+ *  Register with ProxyManager::addBatchListener. Creation and destruction are
+ *  still reported through ProxyCreationListener.
+ */
+class SIRIKATA_PROXYOBJECT_EXPORT ProxyUpdateBatchListener {
+public:
+    struct ProxyChange {
+        ProxyChange(const ProxyObjectPtr& p, uint32 _parts)
+         : proxy(p), parts(_parts)
+        {}
+
+        ProxyObjectPtr proxy;
+        // Bitmask of the properties that changed, with bit
+        // (1 << SequencedPresenceProperties::LOC_*_PART) set for each.
+        uint32 parts;
+    };
+    typedef std::vector<ProxyChange> ProxyChangeList;
+
+    virtual ~ProxyUpdateBatchListener() {}
+
+    /** Invoked with every active proxy owned by pm whose properties changed
+     *  since the last batch.
+     */
+    virtual void onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes) = 0;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_PROXY_UPDATE_BATCH_LISTENER_HPP_
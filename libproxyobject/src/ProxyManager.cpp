@@ -34,6 +34,7 @@
 #include <sirikata/core/util/SpaceObjectReference.hpp>
 #include <sirikata/proxyobject/ProxyManager.hpp>
 #include <sirikata/proxyobject/ProxyObject.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
 
 // Helper for checking serialization of data access to a ProxyManager. These
 // don't necessarily cover all conflicts or uses, they just cover many parts of
@@ -44,14 +45,17 @@
 
 namespace Sirikata {
 
-ProxyManagerPtr ProxyManager::construct(VWObjectPtr parent, const SpaceObjectReference& _id) {
-    ProxyManagerPtr res(SelfWeakPtr<ProxyManager>::internalConstruct(new ProxyManager(parent, _id)));
+ProxyManagerPtr ProxyManager::construct(VWObjectPtr parent, const SpaceObjectReference& _id, Network::IOStrand* strand) {
+    ProxyManagerPtr res(SelfWeakPtr<ProxyManager>::internalConstruct(new ProxyManager(parent, _id, strand)));
     return res;
 }
 
-ProxyManager::ProxyManager(VWObjectPtr parent, const SpaceObjectReference& _id)
+ProxyManager::ProxyManager(VWObjectPtr parent, const SpaceObjectReference& _id, Network::IOStrand* strand)
  : mParent(parent),
    mID(_id),
+   mStrand(strand),
+   mFreeSlot(NO_SLOT),
+   mFlushPosted(false),
    mActiveCount(0)
 {}
 
@@ -65,15 +69,45 @@ void ProxyManager::initialize() {
 void ProxyManager::destroy() {
     PROXYMAN_SERIALIZED();
 
-    for (ProxyMap::iterator iter = mProxyMap.begin();
-         iter != mProxyMap.end();
-         ++iter) {
-        if (iter->second.ptr) {
-            iter->second.ptr->destroy();
-            notify(&ProxyCreationListener::onDestroyProxy,iter->second.ptr);
+    // Listeners may create proxies, growing mProxySlots, so don't hold
+    // references into it across notifications.
+    for (uint32 i = 0; i < mProxySlots.size(); i++) {
+        ProxyObjectPtr proxy = mProxySlots[i].ptr;
+        if (proxy) {
+            proxy->destroy();
+            notify(&ProxyCreationListener::onDestroyProxy,proxy);
         }
     }
-    mProxyMap.clear();
+
+    // Dropping the strong references may destroy proxies, which calls back
+    // into proxyDeleted, so clear everything out before they go away.
+    ProxySlots slots;
+    slots.swap(mProxySlots);
+    mProxyIndex.clear();
+    mFreeSlot = NO_SLOT;
+    mDirtySlots.clear();
+    mActiveCount = 0;
+}
+
+uint32 ProxyManager::allocateSlot() {
+    if (mFreeSlot != NO_SLOT) {
+        uint32 index = mFreeSlot;
+        mFreeSlot = mProxySlots[index].nextFree;
+        mProxySlots[index].nextFree = NO_SLOT;
+        return index;
+    }
+    mProxySlots.push_back(ProxyData());
+    return mProxySlots.size() - 1;
+}
+
+void ProxyManager::freeSlot(uint32 index) {
+    ProxyData& data = mProxySlots[index];
+    data.raw = NULL;
+    data.ptr.reset();
+    data.wptr.reset();
+    data.dirty = 0;
+    data.nextFree = mFreeSlot;
+    mFreeSlot = index;
 }
 
 ProxyObjectPtr ProxyManager::createObject(
@@ -88,22 +122,24 @@ ProxyObjectPtr ProxyManager::createObject(
     // Try to reuse an existing object, even if we only have a valid
     // weak pointer to it.
     assert(id.space() == mID.space());
-    ProxyMap::iterator iter = mProxyMap.find(id.object());
-    if (iter != mProxyMap.end()) {
+    ProxyIndexMap::iterator iter = mProxyIndex.find(id.object());
+    if (iter != mProxyIndex.end()) {
+        ProxyData& data = mProxySlots[iter->second];
         // From strong ref
-        newObj = iter->second.ptr;
+        newObj = data.ptr;
         if (!newObj) {
             // From weak ref
-            newObj = iter->second.wptr.lock();
+            newObj = data.wptr.lock();
 
             // And either update the strong ref or clear out the entry
             // if its not even valid anymore.
             if (newObj) {
-                iter->second.ptr = newObj;
+                data.ptr = newObj;
                 mActiveCount++;
             }
             else {
-                mProxyMap.erase(iter);
+                freeSlot(iter->second);
+                mProxyIndex.erase(iter);
             }
         }
     }
@@ -112,13 +148,14 @@ ProxyObjectPtr ProxyManager::createObject(
     // new one.
     if (!newObj) {
         newObj = ProxyObject::construct(getSharedPtr(), id);
-        std::pair<ProxyMap::iterator, bool> result = mProxyMap.insert(
-            ProxyMap::value_type(
-                newObj->getObjectReference().object(),
-                ProxyData(newObj)
-            )
-        );
-        iter = result.first;
+        uint32 index = allocateSlot();
+        ProxyData& data = mProxySlots[index];
+        data.ptr = newObj;
+        data.wptr = newObj;
+        data.raw = newObj.get();
+        data.id = id.object();
+        newObj->mProxyIndex = index;
+        mProxyIndex[id.object()] = index;
         mActiveCount++;
     }
 
@@ -165,44 +202,44 @@ ProxyObjectPtr ProxyManager::createObject(
 void ProxyManager::destroyObject(const ProxyObjectPtr &delObj) {
     PROXYMAN_SERIALIZED();
 
-    ProxyMap::iterator iter = mProxyMap.find(delObj->getObjectReference().object());
-    if (iter != mProxyMap.end()) {
-        iter->second.ptr->destroy();
-        notify(&ProxyCreationListener::onDestroyProxy,iter->second.ptr);
-        // Here we only erase the strong reference, keeping the weak one so we
-        // can recover it if its still in use and we get a re-addition. Be
-        // careful not to use the iterator after this since this may trigger
-        // destruction of the object which will call proxyDeleted and invalidate
-        // it!
-        iter->second.ptr.reset();
-        mActiveCount--;
-    }
+    uint32 index = delObj->mProxyIndex;
+    if (index >= mProxySlots.size() || mProxySlots[index].raw != delObj.get())
+        return;
+    ProxyObjectPtr proxy = mProxySlots[index].ptr;
+    if (!proxy) return;
+
+    proxy->destroy();
+    notify(&ProxyCreationListener::onDestroyProxy,proxy);
+    // Here we only erase the strong reference, keeping the weak one so we
+    // can recover it if its still in use and we get a re-addition. The
+    // listeners may have added slots, so look it up again.
+    mProxySlots[index].ptr.reset();
+    mActiveCount--;
 }
 
-void ProxyManager::proxyDeleted(const ObjectReference& id) {
+void ProxyManager::proxyDeleted(uint32 index, ProxyObject* proxy) {
     PROXYMAN_SERIALIZED();
 
-    ProxyMap::iterator iter = mProxyMap.find(id);
-    // It should either be in here, or we should be empty after a call
-    // to destroy().
-    assert(iter != mProxyMap.end() || mProxyMap.empty());
-    if (iter == mProxyMap.end()) {
-        assert(mProxyMap.empty());
+    // The slot is gone if we were cleared out by destroy(), and may have been
+    // freed and reused if the proxy was replaced while it was being
+    // destroyed.
+    if (index >= mProxySlots.size() || mProxySlots[index].raw != proxy)
         return;
-    }
 
     // We'd like to
-    //assert(!(iter->second.ptr));
+    //assert(!(mProxySlots[index].ptr));
     // but it's actually not safe. It works fine normally, but the way
-    //ProxyManager::destroy has to work, calling clear(), makes it not
-    //safe. Since that just calls destructors, apparently the shared_ptr still
-    //appears valid even if hitting the destructor made it run out of
-    //references. Calling reset() explicitly has the correct behavior, but using
-    //the destructor does not.
+    //ProxyManager::destroy has to work makes it not safe. Since that just
+    //calls destructors, apparently the shared_ptr still appears valid even if
+    //hitting the destructor made it run out of references. Calling reset()
+    //explicitly has the correct behavior, but using the destructor does not.
 
     // This is where it's actually safe to erase because everything has lost
     // references to it.
-    mProxyMap.erase(iter);
+    ProxyIndexMap::iterator iter = mProxyIndex.find(mProxySlots[index].id);
+    if (iter != mProxyIndex.end() && iter->second == index)
+        mProxyIndex.erase(iter);
+    freeSlot(index);
 }
 
 ProxyObjectPtr ProxyManager::getProxyObject(const SpaceObjectReference &id) const {
@@ -210,9 +247,9 @@ ProxyObjectPtr ProxyManager::getProxyObject(const SpaceObjectReference &id) cons
 
     assert(id.space() == mID.space());
 
-    ProxyMap::const_iterator iter = mProxyMap.find(id.object());
-    if (iter != mProxyMap.end())
-        return (*iter).second.ptr;
+    ProxyIndexMap::const_iterator iter = mProxyIndex.find(id.object());
+    if (iter != mProxyIndex.end())
+        return mProxySlots[iter->second].ptr;
 
     return ProxyObjectPtr();
 }
@@ -225,36 +262,117 @@ void ProxyManager::getAllObjectReferences(std::vector<SpaceObjectReference>& all
 {
     PROXYMAN_SERIALIZED();
 
-    ProxyMap::const_iterator iter;
-
     SpaceID space = mID.space();
-    for (iter = mProxyMap.begin(); iter != mProxyMap.end(); ++iter) {
-        if (iter->second.ptr)
-            allObjReferences.push_back(SpaceObjectReference(space, iter->first));
+    for (ProxySlots::const_iterator iter = mProxySlots.begin(); iter != mProxySlots.end(); ++iter) {
+        if (iter->ptr)
+            allObjReferences.push_back(SpaceObjectReference(space, iter->id));
     }
 }
 
 void ProxyManager::resetAllProxies() {
     PROXYMAN_SERIALIZED();
 
-    for (ProxyMap::const_iterator iter = mProxyMap.begin(); iter != mProxyMap.end(); ++iter) {
+    for (ProxySlots::const_iterator iter = mProxySlots.begin(); iter != mProxySlots.end(); ++iter) {
         // Just try locking the weak pointer, if that doesn't work nothing
         // will. Note that we want to catch *everything*, even ones we don't
         // keep a strong ref to. This ensures that we if we reuse a proxy later
         // via the weak reference, we won't forget to reset it. Since resetting
         // only affects seqnos, this shouldn't have any adverse affects on those
         // still holding a reference.
-        ProxyObjectPtr proxy = iter->second.wptr.lock();
+        ProxyObjectPtr proxy = iter->wptr.lock();
         if (proxy) proxy->reset();
     }
 }
 
 int32 ProxyManager::size() {
-    return mProxyMap.size();
+    return mProxyIndex.size();
 }
 
 int32 ProxyManager::activeSize() {
     return mActiveCount;
 }
 
+void ProxyManager::addBatchListener(ProxyUpdateBatchListener* listener) {
+    PROXYMAN_SERIALIZED();
+
+    if (std::find(mBatchListeners.begin(), mBatchListeners.end(), listener) == mBatchListeners.end())
+        mBatchListeners.push_back(listener);
+}
+
+void ProxyManager::removeBatchListener(ProxyUpdateBatchListener* listener) {
+    PROXYMAN_SERIALIZED();
+
+    BatchListenerList::iterator it = std::find(mBatchListeners.begin(), mBatchListeners.end(), listener);
+    if (it != mBatchListeners.end())
+        mBatchListeners.erase(it);
+
+    // Nobody left to collect changes for
+    if (mBatchListeners.empty()) {
+        for(uint32 i = 0; i < mDirtySlots.size(); i++) {
+            if (mDirtySlots[i] < mProxySlots.size())
+                mProxySlots[mDirtySlots[i]].dirty = 0;
+        }
+        mDirtySlots.clear();
+    }
+}
+
+void ProxyManager::proxyUpdated(uint32 index, uint32 parts) {
+    PROXYMAN_SERIALIZED();
+
+    if (mBatchListeners.empty() || index >= mProxySlots.size())
+        return;
+
+    ProxyData& data = mProxySlots[index];
+    if (data.dirty == 0)
+        mDirtySlots.push_back(index);
+    data.dirty |= parts;
+
+    // Everything that changes before the strand gets to this goes out in
+    // the same batch
+    if (mStrand != NULL && !mFlushPosted) {
+        mFlushPosted = true;
+        mStrand->post(
+            std::tr1::bind(&ProxyManager::handleFlushUpdates, getWeakPtr()),
+            "ProxyManager::handleFlushUpdates"
+        );
+    }
+}
+
+void ProxyManager::handleFlushUpdates(ProxyManagerWPtr weak_self) {
+    ProxyManagerPtr self = weak_self.lock();
+    if (!self) return;
+
+    self->mFlushPosted = false;
+    self->flushUpdates();
+}
+
+void ProxyManager::flushUpdates() {
+    PROXYMAN_SERIALIZED();
+
+    if (mDirtySlots.empty()) return;
+
+    ProxyUpdateBatchListener::ProxyChangeList changes;
+    changes.reserve(mDirtySlots.size());
+    for(uint32 i = 0; i < mDirtySlots.size(); i++) {
+        uint32 index = mDirtySlots[i];
+        if (index >= mProxySlots.size()) continue;
+        ProxyData& data = mProxySlots[index];
+        if (data.dirty == 0) continue;
+        // Proxies destroyed since they changed aren't reported
+        if (data.ptr)
+            changes.push_back(ProxyUpdateBatchListener::ProxyChange(data.ptr, data.dirty));
+        data.dirty = 0;
+    }
+    mDirtySlots.clear();
+
+    if (changes.empty()) return;
+
+    ProxyManagerPtr self = getSharedPtr();
+    for (int32 i = (int32)mBatchListeners.size()-1;
+         i >= 0 && i < (int32)mBatchListeners.size();
+         --i) {
+        mBatchListeners[i]->onProxiesUpdated(self, changes);
+    }
+}
+
 }
@@ -59,7 +59,8 @@ ProxyObject::ProxyObject(ProxyManagerPtr man, const SpaceObjectReference& id)
      MeshProvider (),
      mValid(true),
      mID(id),
-     mParent(man)
+     mParent(man),
+     mProxyIndex(ProxyManager::NO_SLOT)
 {
     assert(mParent);
 
@@ -69,7 +70,7 @@ ProxyObject::ProxyObject(ProxyManagerPtr man, const SpaceObjectReference& id)
 
 
 ProxyObject::~ProxyObject() {
-    mParent->proxyDeleted(mID.object());
+    mParent->proxyDeleted(mProxyIndex, this);
 }
 
 void ProxyObject::reset() {
@@ -216,6 +217,7 @@ void ProxyObject::setLocation(const TimedMotionVector3f& reqloc, uint64 seqno) {
         ProxyObjectPtr ptr = getSharedPtr();
         assert(ptr);
         PositionProvider::notify(&PositionListener::updateLocation, ptr, mLoc, mOrientation, mBounds, mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_POS_PART);
     }
 }
 
@@ -225,6 +227,7 @@ void ProxyObject::setOrientation(const TimedMotionQuaternion& reqorient, uint64
         ProxyObjectPtr ptr = getSharedPtr();
         assert(ptr);
         PositionProvider::notify(&PositionListener::updateLocation, ptr, mLoc, mOrientation, mBounds, mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_ORIENT_PART);
     }
 }
 
@@ -235,6 +238,7 @@ void ProxyObject::setBounds(const AggregateBoundingInfo& bnds, uint64 seqno) {
         assert(ptr);
         PositionProvider::notify(&PositionListener::updateLocation, ptr, mLoc, mOrientation, mBounds, mID);
         MeshProvider::notify (&MeshListener::onSetScale, ptr, mBounds.fullRadius(), mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_BOUNDS_PART);
     }
 }
 
@@ -245,6 +249,7 @@ void ProxyObject::setMesh (Transfer::URI const& mesh, uint64 seqno) {
         ProxyObjectPtr ptr = getSharedPtr();
         assert(ptr);
         if (ptr) MeshProvider::notify ( &MeshListener::onSetMesh, ptr, mesh, mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_MESH_PART);
     }
 }
 
@@ -254,6 +259,7 @@ void ProxyObject::setPhysics (const String& rhs, uint64 seqno) {
         ProxyObjectPtr ptr = getSharedPtr();
         assert(ptr);
         if (ptr) MeshProvider::notify ( &MeshListener::onSetPhysics, ptr, rhs, mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_PHYSICS_PART);
     }
 }
 
@@ -263,6 +269,7 @@ void ProxyObject::setIsAggregate(bool isAggregate, uint64 seqno) {
         ProxyObjectPtr ptr = getSharedPtr();
         assert(ptr);
         if (ptr) MeshProvider::notify ( &MeshListener::onSetIsAggregate, ptr, isAggregate, mID);
+        mParent->proxyUpdated(mProxyIndex, 1 << LOC_IS_AGG_PART);
     }
 }
 
@@ -56,6 +56,29 @@ public:
      *  provide the result, including failure due to timeout.
      */
     virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb) = 0;
+
+    struct Request {
+        Request(const UUID& _obj_id, const String& _auth, const Callback& _cb)
+         : obj_id(_obj_id), auth(_auth), cb(_cb)
+        {}
+
+        UUID obj_id;
+        String auth;
+        Callback cb;
+    };
+    typedef std::vector<Request> RequestBatch;
+
+    /** Authenticate a batch of requests, e.g. a burst of connections from an
+     *  object host that just reconnected. Each request's callback is invoked
+     *  exactly as it would be by authenticate(). The default implementation
+     *  just authenticates each request individually; implementations that can
+     *  amortize work across requests (a single prepared statement or
+     *  transaction) should override it.
+     */
+    virtual void authenticateBatch(const RequestBatch& reqs) {
+        for(RequestBatch::const_iterator it = reqs.begin(); it != reqs.end(); it++)
+            authenticate(it->obj_id, MemoryReference(it->auth), it->cb);
+    }
 };
 
 class SIRIKATA_SPACE_EXPORT AuthenticatorFactory
@@ -33,6 +33,17 @@ class LocationServiceListener;
 class LocationUpdatePolicy;
 class LocationService;
 
+/** A new location and orientation for a local object. Used to deliver many
+ *  updates at once, see LocationServiceListener::localLocationsUpdated.
+ */
+struct LocalLocationUpdate {
+    UUID uuid;
+    bool agg;
+    TimedMotionVector3f location;
+    TimedMotionQuaternion orientation;
+};
+typedef std::vector<LocalLocationUpdate> LocalLocationUpdateList;
+
 /** Interface for objects that need to listen for location updates. */
 class SIRIKATA_SPACE_EXPORT LocationServiceListener {
 public:
@@ -51,6 +62,12 @@ public:
     virtual void localMeshUpdated(const UUID& uuid, bool agg, const String& newval) {}
     virtual void localPhysicsUpdated(const UUID& uuid, bool agg, const String& newval) {}
     virtual void localQueryDataUpdated(const UUID& uuid, bool agg, const String& newval) {}
+    /** Location and orientation updates for a number of objects at once, e.g.
+     *  all the objects moved by one step of a physics simulation. The default
+     *  implementation calls localLocationUpdated and localOrientationUpdated
+     *  for each; override it if handling them together is cheaper.
+     */
+    virtual void localLocationsUpdated(const LocalLocationUpdateList& updates);
 
     virtual void replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& query_data) {}
     virtual RemovalStatus replicaObjectRemoved(const UUID& uuid)=0;//{return IMMEDIATE;}
@@ -310,6 +327,7 @@ protected:
     void notifyLocalMeshUpdated(const UUID& uuid, bool agg, const String& newval) const;
     void notifyLocalPhysicsUpdated(const UUID& uuid, bool agg, const String& newval) const;
     void notifyLocalQueryDataUpdated(const UUID& uuid, bool agg, const String& newval) const;
+    void notifyLocalLocationsUpdated(const LocalLocationUpdateList& updates) const;
 
     void notifyReplicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& query_data) const;
     void notifyReplicaObjectRemoved(const UUID& uuid) const;
@@ -327,6 +345,9 @@ protected:
     void handleLocationUpdateSubstream(const UUID& source, int err, SSTStreamPtr s);
     void handleLocationUpdateSubstreamRead(const UUID& source, SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
     void tryHandleLocationUpdate(const UUID& source, SSTStreamPtr s, const String& payload, std::stringstream* prevdata);
+    // Long-lived request streams carry a series of framed requests
+    void handleLocationUpdateChannelRead(const UUID& source, SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, uint8* buffer, int length);
+    void handleLocationUpdateDatagram(const UUID& source, uint8* buffer, int length);
 
     SpaceContext* mContext;
 private:
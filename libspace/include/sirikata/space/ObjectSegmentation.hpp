@@ -169,6 +169,15 @@ public:
     virtual OSegEntry cacheLookup(const UUID& obj_id) = 0;
     virtual void migrateObject(const UUID& obj_id, const OSegEntry& new_server_id) = 0;
     virtual void addNewObject(const UUID& obj_id, float radius) = 0;
+    typedef std::vector< std::pair<UUID, float> > NewObjectList;
+    /** Add a batch of new objects, each with the same semantics (and
+     *  OSegWriteListener notification) as addNewObject. Implementations
+     *  backed by a remote store should override this to pipeline the writes.
+     */
+    virtual void addNewObjects(const NewObjectList& objs) {
+        for(NewObjectList::const_iterator it = objs.begin(); it != objs.end(); it++)
+            addNewObject(it->first, it->second);
+    }
     virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool) = 0;
     virtual void removeObject(const UUID& obj_id) = 0;
     virtual bool clearToMigrate(const UUID& obj_id) = 0;
@@ -35,6 +35,7 @@
 
 #include <sirikata/space/Platform.hpp>
 #include <sirikata/core/odp/SSTDecls.hpp>
+#include <sirikata/core/ohdp/Defs.hpp>
 #include <sirikata/core/util/ListenerProvider.hpp>
 #include <sirikata/space/SpaceContext.hpp>
 
@@ -52,14 +53,17 @@ class SIRIKATA_SPACE_EXPORT ObjectSession {
   public:
     typedef ODPSST::StreamPtr SSTStreamPtr;
 
-    ObjectSession(const ObjectReference& objid)
+    ObjectSession(const ObjectReference& objid, const OHDP::NodeID& oh)
         : mID(objid),
+        mObjectHost(oh),
         mSSTStream(), // set later by ObjectSessionManager
         mSeqNo(new SeqNo())
     {}
     ~ObjectSession();
 
     const ObjectReference& id() const { return mID; }
+    // The object host the object is connected through
+    const OHDP::NodeID& objectHost() const { return mObjectHost; }
 
     SSTStreamPtr getStream() const { return mSSTStream; }
 
@@ -69,6 +73,7 @@ class SIRIKATA_SPACE_EXPORT ObjectSession {
     friend class ObjectSessionManager;
 
     ObjectReference mID;
+    OHDP::NodeID mObjectHost;
     SSTStreamPtr mSSTStream;
     // We still use SeqNoPtrs to deal with thread safety -- the seqno
     // is own
@@ -54,6 +54,7 @@
 #include <prox/base/ZernikeDescriptor.hpp>
 
 #include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/util/Sha256.hpp>
 
 #include <boost/filesystem.hpp>
 
@@ -79,6 +80,61 @@ using namespace Sirikata::Mesh;
 
 namespace Sirikata {
 
+namespace {
+
+// Approximate in-memory footprint of a mesh, dominated by its vertex and index
+// data. Used to bound the caches of meshes.
+uint64 estimateMeshdataBytes(const MeshdataPtr& m) {
+  if (!m) return 0;
+
+  uint64 bytes = sizeof(Meshdata);
+  for (uint32 i = 0; i < m->geometry.size(); i++) {
+    const SubMeshGeometry& smg = m->geometry[i];
+    bytes += sizeof(SubMeshGeometry);
+    bytes += (smg.positions.size() + smg.normals.size() + smg.tangents.size()) * sizeof(Vector3f);
+    bytes += smg.colors.size() * sizeof(Vector4f);
+    for (uint32 j = 0; j < smg.texUVs.size(); j++)
+      bytes += smg.texUVs[j].uvs.size() * sizeof(float);
+    for (uint32 j = 0; j < smg.primitives.size(); j++)
+      bytes += smg.primitives[j].indices.size() * sizeof(unsigned short);
+  }
+  bytes += m->instances.size() * sizeof(GeometryInstance);
+  bytes += m->nodes.size() * sizeof(Node);
+  return bytes;
+}
+
+// Digest of the parts of a mesh that affect the aggregate generated from it.
+String meshContentDigest(const MeshdataPtr& m) {
+  SHA256Context ctx;
+  for (uint32 i = 0; i < m->geometry.size(); i++) {
+    const SubMeshGeometry& smg = m->geometry[i];
+    if (!smg.positions.empty())
+      ctx.update(&smg.positions[0], smg.positions.size() * sizeof(Vector3f));
+    if (!smg.normals.empty())
+      ctx.update(&smg.normals[0], smg.normals.size() * sizeof(Vector3f));
+    for (uint32 j = 0; j < smg.texUVs.size(); j++) {
+      if (!smg.texUVs[j].uvs.empty())
+        ctx.update(&smg.texUVs[j].uvs[0], smg.texUVs[j].uvs.size() * sizeof(float));
+    }
+    for (uint32 j = 0; j < smg.primitives.size(); j++) {
+      const SubMeshGeometry::Primitive& prim = smg.primitives[j];
+      if (!prim.indices.empty())
+        ctx.update(&prim.indices[0], prim.indices.size() * sizeof(unsigned short));
+      ctx.update(&prim.materialId, sizeof(prim.materialId));
+    }
+  }
+  for (uint32 i = 0; i < m->textures.size(); i++)
+    ctx.update(m->textures[i]);
+  for (uint32 i = 0; i < m->instances.size(); i++)
+    ctx.update(&m->instances[i].geometryIndex, sizeof(m->instances[i].geometryIndex));
+  for (uint32 i = 0; i < m->nodes.size(); i++)
+    ctx.update(&m->nodes[i].transform, sizeof(m->nodes[i].transform));
+  ctx.update(&m->globalTransform, sizeof(m->globalTransform));
+  return ctx.get().toString();
+}
+
+} // namespace
+
 uint32 countFaces(MeshdataPtr agg_mesh) {
   //Find the list of instances associated with each submesh
   uint32 geoinst_idx;
@@ -523,10 +579,18 @@ MeshAggregateManager::MeshAggregateManager(LocationService* loc, Transfer::OAuth
     mAggregateCumulativeGenerationTime(Duration::zero()),
     mAggregateCumulativeUploadTime(Duration::zero()),
     mAggregateCumulativeDataSize(0),
+    mStageDownloadTime(Duration::zero()),
+    mStageSimplifyTime(Duration::zero()),
+    mStageAtlasTime(Duration::zero()),
+    mStageSerializeTime(Duration::zero()),
     mErrorSum(0.0),
     mErrorSequenceNumber(0),
     mSizeSum(0), noMoreGeneration(false),
-    mCurrentInsertionNumber(0)
+    mCurrentInsertionNumber(0),
+    mMeshStoreBytes(0),
+    mGeneratedMeshCacheBytes(0),
+    mGeneratedMeshCacheHits(0),
+    mGeneratedMeshCacheMisses(0)
 {
     String local_path = GetOptionValue<String>(OPT_AGGMGR_LOCAL_PATH);
     String local_url_prefix = GetOptionValue<String>(OPT_AGGMGR_LOCAL_URL_PREFIX);
@@ -534,6 +598,8 @@ MeshAggregateManager::MeshAggregateManager(LocationService* loc, Transfer::OAuth
     uint16 n_upload_threads = GetOptionValue<uint16>(OPT_AGGMGR_UPLOAD_THREADS);
     bool skip_gen = GetOptionValue<bool>(OPT_AGGMGR_SKIP_GENERATE);
     bool skip_upload = GetOptionValue<bool>(OPT_AGGMGR_SKIP_UPLOAD);
+    mMeshStoreMaxBytes = (uint64)GetOptionValue<uint32>(OPT_AGGMGR_MESH_STORE_SIZE) * 1024 * 1024;
+    mGeneratedMeshCacheMaxBytes = (uint64)GetOptionValue<uint32>(OPT_AGGMGR_GENERATED_CACHE_SIZE) * 1024 * 1024;
     mLocalPath = local_path;
     mLocalURLPrefix = local_url_prefix;
     mNumGenerationThreads = std::min(n_gen_threads, (uint16)MAX_NUM_GENERATION_THREADS);
@@ -1546,6 +1612,11 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
   std::tr1::unordered_map<String, MeshdataPtr> textureToModelMap;
   std::map<int, BoundingBox3f> instanceToBBoxMap;
 
+  // Accumulates the content and placement of each child so we can look for
+  // an already generated version of this aggregate.
+  SHA256Context generatedMeshKeyContext;
+  std::tr1::unordered_map<String, String> meshContentDigests;
+
   for (uint32 i= 0; i < children.size(); i++) {
     UUID child_uuid = children[i]->mUUID;
     boost::mutex::scoped_lock lock(mAggregateObjectsMutex);
@@ -1704,6 +1775,15 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
     float64 locationZ = location.z;
     Quaternion orientation = currentLocMap[child_uuid]->currentOrientation();
 
+    if (meshContentDigests.find(meshName) == meshContentDigests.end())
+      meshContentDigests[meshName] = meshContentDigest(m);
+    generatedMeshKeyContext.update(meshContentDigests[meshName]);
+    float64 relativeLocation[3] = { locationX - posX, locationY - posY, locationZ - posZ };
+    generatedMeshKeyContext.update(relativeLocation, sizeof(relativeLocation));
+    generatedMeshKeyContext.update(&orientation, sizeof(orientation));
+    generatedMeshKeyContext.update(&scalingfactor, sizeof(scalingfactor));
+    generatedMeshKeyContext.update(&replacementAlignmentTransforms[i], sizeof(Matrix4x4f));
+
     // Reuse geoinst_it and geoinst_idx from earlier, but with a new iterator.
     Meshdata::GeometryInstanceIterator geoinst_it = m->getGeometryInstanceIterator();
     Matrix4x4f orig_geo_inst_xform;
@@ -1896,7 +1976,17 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
   //become too large!
 
   int NUM_SIMPLIFIED_FACES=1500;
-  if (countFaces(agg_mesh) > NUM_SIMPLIFIED_FACES) {
+  generatedMeshKeyContext.update(&NUM_SIMPLIFIED_FACES, sizeof(NUM_SIMPLIFIED_FACES));
+  String generatedMeshKey = generatedMeshKeyContext.get().toString();
+  aggObject->mGeneratedMeshKey = generatedMeshKey;
+
+  GeneratedMeshPtr generatedMesh = getGeneratedMesh(generatedMeshKey);
+  Time simplifyStartTime = Timer::now();
+  if (generatedMesh) {
+    // Uploading modifies the mesh, so work on a copy of the cached version
+    agg_mesh = MeshdataPtr(new Meshdata(*generatedMesh->simplified));
+  }
+  else if (countFaces(agg_mesh) > NUM_SIMPLIFIED_FACES) {
     if (averageVertices <= 40) {
       std::vector<String> names_and_args;
       names_and_args.push_back("squash-instanced-geometry"); names_and_args.push_back("");
@@ -1913,6 +2003,10 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
     //Simplify the mesh...
     mMeshSimplifier.simplify(agg_mesh, NUM_SIMPLIFIED_FACES, instanceToBBoxMap);
   }
+  if (!generatedMesh) {
+    addStageTime(mStageSimplifyTime, Timer::now() - simplifyStartTime);
+    addGeneratedMesh(generatedMeshKey, agg_mesh);
+  }
 
   AGG_LOG(insane, agg_mesh->nodes.size() << " -- " << agg_mesh->rootNodes.size() << " nodes");
 
@@ -1939,7 +2033,18 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
     boost::mutex::scoped_lock dirtyAggregatesLock(mDirtyAggregatesMutex);
     mUploadingObjects.insert(uuid);
   }
-  if (agg_mesh->textures.size() > 0 && mAtlasingNeeded && doAtlasing) {
+  if (generatedMesh && generatedMesh->atlased) {
+    // Atlasing for identical inputs was already done, skip downloading the
+    // textures and building the atlas again.
+    mUploadStrands[rand() % mNumUploadThreads]->post(
+        std::tr1::bind(&MeshAggregateManager::uploadAggregateMesh, this,
+                       MeshdataPtr(new Meshdata(*generatedMesh->atlased)), generatedMesh->atlasName,
+                       generatedMesh->atlasBuffer, generatedMesh->atlasLength, aggObject, textureSet, 0, Time::null()),
+        "MeshAggregateManager::uploadAggregateMesh"
+    );
+  }
+  else if (agg_mesh->textures.size() > 0 && mAtlasingNeeded && doAtlasing) {
+    aggObject->mAtlasStartTime = Timer::now();
     startDownloadsForAtlasing(uuid, agg_mesh, aggObject, localMeshName, textureSet, textureToModelMap);
   }
   else {
@@ -1962,12 +2067,6 @@ uint32 MeshAggregateManager::generateAggregateMeshAsync(const UUID uuid, Time po
   }
   delete [] meshURIs;
 
-  if (aggObject->mTreeLevel == 0) {
-    boost::mutex::scoped_lock meshStoreLock(mMeshStoreMutex);
-
-    mMeshStore.clear();
-  }
-
 
   return GEN_SUCCESS;
 }
@@ -2224,6 +2323,8 @@ void MeshAggregateManager::textureChunkFinished(String texname, Transfer::Finger
       atlas.read(buffer.get(), length);
       atlas.close();
 
+      addStageTime(mStageAtlasTime, Timer::now() - aggObj->mAtlasStartTime);
+
       //make the texture path relative instead of an absolute filename.
       for (uint32 i = 0; i <  agg_mesh->textures.size(); i++) {
         String url = agg_mesh->textures[i];
@@ -2245,6 +2346,8 @@ void MeshAggregateManager::textureChunkFinished(String texname, Transfer::Finger
 						     "/tmp/sirikata/"+uuid+".dir/"+uuid+".dae");
       }
 
+      addGeneratedMeshAtlas(aggObj->mGeneratedMeshKey, m, file_name+".atlas.png", buffer, length);
+
       mUploadStrands[rand() % mNumUploadThreads]->post(
           std::tr1::bind(&MeshAggregateManager::uploadAggregateMesh, this, m, file_name+".atlas.png", buffer, length, aggObj, textureSet, 0, Time::null()),
           "MeshAggregateManager::uploadAggregateMesh"
@@ -2359,11 +2462,13 @@ void MeshAggregateManager::uploadAggregateMesh(Mesh::MeshdataPtr agg_mesh,
   std::string serialized = "";
   {
     boost::mutex::scoped_lock modelSystemLock(mModelsSystemMutex);
+    Time serializeStartTime = Timer::now();
     std::stringstream model_ostream(std::ofstream::out | std::ofstream::binary);
 
     bool converted = mModelsSystem->convertVisual( agg_mesh, "colladamodels", model_ostream);
 
     serialized = model_ostream.str();
+    addStageTime(mStageSerializeTime, Timer::now() - serializeStartTime);
 
     mAggregateCumulativeDataSize += serialized.size();
     aggObject->mSerializedSize = atlas_length + serialized.size();
@@ -2779,6 +2884,7 @@ void MeshAggregateManager::chunkFinished(Time t, const UUID uuid, const UUID chi
 
 
 	addToInMemoryCache(request->getURI().toString(), m);
+        addStageTime(mStageDownloadTime, Timer::now() - t);
 
 	AGG_LOG(detailed, "Stored mesh in mesh store for: " <<  request->getURI().toString() << "\n");
     }
@@ -2797,41 +2903,52 @@ void MeshAggregateManager::addToInMemoryCache(const String& meshName, const Mesh
   AGG_LOG(insane, mMeshStore.size() << " : mMeshStore.size()");
   boost::mutex::scoped_lock meshStoreLock(mMeshStoreMutex);
 
-  int MESHSTORESIZE=2000;
-  //Store the mesh but keep the meshstore's size under control.
-  if (   mMeshStore.size() > MESHSTORESIZE )
-  {
-    int countMeshes = 0;
-    std::tr1::unordered_map<String, Mesh::MeshdataPtr>::iterator it = mMeshStore.begin();
-    for (; it != mMeshStore.end() && countMeshes <= MESHSTORESIZE; it++) {
-      if (it->second) {
-        countMeshes++;
-      }
-    }
+  // Replacing an existing entry, remove its accounting first.
+  if (mMeshStoreSizes.find(meshName) != mMeshStoreSizes.end()) {
+    mMeshStoreBytes -= mMeshStoreSizes[meshName];
+    mMeshStoreSizes.erase(meshName);
+  }
+  if (mMeshStoreOrderingReverse.find(meshName) != mMeshStoreOrderingReverse.end()) {
+    mMeshStoreOrdering.erase(mMeshStoreOrderingReverse[meshName]);
+    mMeshStoreOrderingReverse.erase(meshName);
+  }
 
-    if (countMeshes > MESHSTORESIZE) {
-      mMeshStoreOrderingReverse.erase(mMeshStoreOrdering.begin()->second);
-      mMeshStore.erase(mMeshStoreOrdering.begin()->second);
-      AGG_LOG(insane, "Erasing from meshstore: " <<mMeshStoreOrdering.begin()->second
-                << " " << mMeshStoreOrdering.begin()->first
-                << mCurrentInsertionNumber   );
+  uint64 meshBytes = estimateMeshdataBytes(mdptr);
 
-      mMeshDescriptors.erase(mMeshStoreOrdering.begin()->second);
-      mMeshStoreOrdering.erase(mMeshStoreOrdering.begin());
-    }
+  //Store the mesh but keep the meshstore's size under control.
+  uint32 MESHSTORESIZE=2000;
+  while (!mMeshStoreOrdering.empty() &&
+         (mMeshStoreOrdering.size() >= MESHSTORESIZE || mMeshStoreBytes + meshBytes > mMeshStoreMaxBytes))
+  {
+    evictFromInMemoryCache();
   }
 
   AGG_LOG(info, "Inserting to meshstore: " << meshName);
   mCurrentInsertionNumber++;
   mMeshStore[meshName] = mdptr;
-
-  if (mMeshStoreOrderingReverse.find(meshName) != mMeshStoreOrderingReverse.end())
-    mMeshStoreOrdering.erase(mMeshStoreOrderingReverse[meshName]);
+  mMeshStoreSizes[meshName] = meshBytes;
+  mMeshStoreBytes += meshBytes;
 
   mMeshStoreOrdering[mCurrentInsertionNumber]=meshName;
   mMeshStoreOrderingReverse[meshName] = mCurrentInsertionNumber;
 }
 
+void MeshAggregateManager::evictFromInMemoryCache() {
+  assert(mMeshStoreMutex.try_lock() == false);
+
+  String evictName = mMeshStoreOrdering.begin()->second;
+  AGG_LOG(insane, "Erasing from meshstore: " << evictName
+            << " " << mMeshStoreOrdering.begin()->first
+            << mCurrentInsertionNumber   );
+
+  mMeshStoreOrdering.erase(mMeshStoreOrdering.begin());
+  mMeshStoreOrderingReverse.erase(evictName);
+  mMeshStore.erase(evictName);
+  mMeshDescriptors.erase(evictName);
+  mMeshStoreBytes -= mMeshStoreSizes[evictName];
+  mMeshStoreSizes.erase(evictName);
+}
+
 MeshdataPtr MeshAggregateManager::getMeshFromStore(const String& meshName) {
   assert(mMeshStoreMutex.try_lock() == false);
 
@@ -2850,6 +2967,82 @@ MeshdataPtr MeshAggregateManager::getMeshFromStore(const String& meshName) {
   return MeshdataPtr();
 }
 
+MeshAggregateManager::GeneratedMeshPtr MeshAggregateManager::getGeneratedMesh(const String& key) {
+  boost::mutex::scoped_lock lock(mGeneratedMeshCacheMutex);
+
+  GeneratedMeshCache::iterator it = mGeneratedMeshCache.find(key);
+  if (it == mGeneratedMeshCache.end()) {
+    mGeneratedMeshCacheMisses++;
+    return GeneratedMeshPtr();
+  }
+
+  mGeneratedMeshCacheHits++;
+  // Move to the most recently used position
+  mGeneratedMeshLRU.splice(mGeneratedMeshLRU.end(), mGeneratedMeshLRU, it->second.second);
+  return it->second.first;
+}
+
+void MeshAggregateManager::addGeneratedMesh(const String& key, MeshdataPtr simplified) {
+  GeneratedMeshPtr entry(new GeneratedMesh());
+  // The caller continues to modify the mesh, so keep our own copy
+  entry->simplified = MeshdataPtr(new Meshdata(*simplified));
+  entry->bytes = estimateMeshdataBytes(entry->simplified);
+
+  boost::mutex::scoped_lock lock(mGeneratedMeshCacheMutex);
+
+  if (mGeneratedMeshCache.find(key) != mGeneratedMeshCache.end())
+    return;
+  if (entry->bytes > mGeneratedMeshCacheMaxBytes)
+    return;
+
+  while (!mGeneratedMeshLRU.empty() &&
+         mGeneratedMeshCacheBytes + entry->bytes > mGeneratedMeshCacheMaxBytes)
+  {
+    GeneratedMeshCache::iterator evict_it = mGeneratedMeshCache.find(mGeneratedMeshLRU.front());
+    mGeneratedMeshCacheBytes -= evict_it->second.first->bytes;
+    mGeneratedMeshCache.erase(evict_it);
+    mGeneratedMeshLRU.pop_front();
+  }
+
+  mGeneratedMeshCacheBytes += entry->bytes;
+  GeneratedMeshLRU::iterator lru_it = mGeneratedMeshLRU.insert(mGeneratedMeshLRU.end(), key);
+  mGeneratedMeshCache[key] = std::make_pair(entry, lru_it);
+}
+
+void MeshAggregateManager::addGeneratedMeshAtlas(const String& key, MeshdataPtr atlased, const String& atlas_name,
+                                                 std::tr1::shared_ptr<char> atlas_buffer, uint32 atlas_length)
+{
+  MeshdataPtr atlasedCopy(new Meshdata(*atlased));
+  uint64 atlasBytes = estimateMeshdataBytes(atlasedCopy) + atlas_length;
+
+  boost::mutex::scoped_lock lock(mGeneratedMeshCacheMutex);
+
+  // The simplified mesh may have been evicted while we were atlasing, in which
+  // case we don't bother keeping just the atlas.
+  GeneratedMeshCache::iterator it = mGeneratedMeshCache.find(key);
+  if (it == mGeneratedMeshCache.end()) return;
+
+  GeneratedMeshPtr entry = it->second.first;
+  if (entry->atlased) return;
+
+  // Entries are immutable once handed out, so replace it instead of
+  // modifying it in place.
+  GeneratedMeshPtr updated(new GeneratedMesh(*entry));
+  updated->atlased = atlasedCopy;
+  updated->atlasName = atlas_name;
+  updated->atlasBuffer = atlas_buffer;
+  updated->atlasLength = atlas_length;
+  updated->bytes += atlasBytes;
+  it->second.first = updated;
+  mGeneratedMeshCacheBytes += atlasBytes;
+  // We may end up over budget; the next insertion will evict to make room.
+}
+
+void MeshAggregateManager::addStageTime(Duration& stage, const Duration& dur) {
+  boost::mutex::scoped_lock statsLock(mStatsMutex);
+  stage += dur;
+}
+
 void MeshAggregateManager::addLeavesUpTree(UUID leaf_uuid, UUID uuid) {
   if (uuid == UUID::null()) return;
   if (mAggregateObjects.find(uuid) == mAggregateObjects.end()) return;
@@ -3198,6 +3391,19 @@ void MeshAggregateManager::localLocationUpdated(const UUID& uuid, bool agg, cons
   locinfo->currentPosition(newval.position());
 }
 
+void MeshAggregateManager::localLocationsUpdated(const LocalLocationUpdateList& updates) {
+  // Take the lock once for the whole batch
+  boost::mutex::scoped_lock lock(mLocCacheMutex);
+
+  for(LocalLocationUpdateList::const_iterator it = updates.begin(); it != updates.end(); it++) {
+    std::tr1::shared_ptr<LocationInfo> locinfo = mLocationServiceCache.getLocationInfo(it->uuid);
+    if (!locinfo) continue;
+
+    locinfo->currentPosition(it->location.position());
+    locinfo->currentOrientation(it->orientation.position());
+  }
+}
+
 void MeshAggregateManager::localOrientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval) {
   boost::mutex::scoped_lock lock(mLocCacheMutex);
 
@@ -3448,7 +3654,27 @@ void MeshAggregateManager::commandStats(const Command::Command& cmd, Command::Co
     result.put("stats.cumulative_upload_time", mAggregateCumulativeUploadTime.toString());
     result.put("stats.cumulative_upload_time_seconds", mAggregateCumulativeUploadTime.toSeconds());
     result.put("stats.cumulative_size", mAggregateCumulativeDataSize);
+
+    result.put("stats.stages.download_seconds", mStageDownloadTime.toSeconds());
+    result.put("stats.stages.simplify_seconds", mStageSimplifyTime.toSeconds());
+    result.put("stats.stages.atlas_seconds", mStageAtlasTime.toSeconds());
+    result.put("stats.stages.serialize_seconds", mStageSerializeTime.toSeconds());
+    result.put("stats.stages.upload_seconds", mAggregateCumulativeUploadTime.toSeconds());
+  }
+
+  {
+    boost::mutex::scoped_lock meshStoreLock(mMeshStoreMutex);
+    result.put("stats.mesh_store.count", mMeshStoreOrdering.size());
+    result.put("stats.mesh_store.bytes", mMeshStoreBytes);
+  }
+
+  {
+    boost::mutex::scoped_lock generatedCacheLock(mGeneratedMeshCacheMutex);
+    result.put("stats.generated_cache.count", mGeneratedMeshCache.size());
+    result.put("stats.generated_cache.bytes", mGeneratedMeshCacheBytes);
   }
+  result.put("stats.generated_cache.hits", mGeneratedMeshCacheHits.read());
+  result.put("stats.generated_cache.misses", mGeneratedMeshCacheMisses.read());
 
   {
     // We might be in the wrong thread (mDirtyAggregateObjects should only be
@@ -180,6 +180,7 @@ private:
   virtual LocationServiceListener::RemovalStatus localObjectRemoved(const UUID& uuid, bool agg, const LocationServiceListener::RemovalCallback& callback) ;
   virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval);
   virtual void localOrientationUpdated(const UUID& uuid, bool agg, const TimedMotionQuaternion& newval);
+  virtual void localLocationsUpdated(const LocalLocationUpdateList& updates);
   virtual void localBoundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval) ;
   virtual void localMeshUpdated(const UUID& uuid, bool agg, const String& newval) ;
   virtual void replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient,
@@ -276,7 +277,8 @@ private:
       geometricError(0), mSerializedSize(0),
       cdnBaseName(),
       mAtlasPath(""),
-      refreshTTL(Time::null())
+      refreshTTL(Time::null()),
+      mAtlasStartTime(Time::null())
     {
       mParentUUIDs.insert(parentUUID);
       generatedLastRound = false;
@@ -299,6 +301,10 @@ private:
     // Time at which we should try to refresh the TTL, should be set
     // a bit less than the actual timeout.
     Time refreshTTL;
+    // Key into the generated mesh cache for the most recent generation
+    // of this aggregate, used to record the atlasing results.
+    String mGeneratedMeshKey;
+    Time mAtlasStartTime;
 
   };
 
@@ -323,12 +329,17 @@ private:
   boost::mutex mObjectsByPriorityLocks[MAX_NUM_GENERATION_THREADS];
   std::map<float, std::deque<AggregateObjectPtr > > mObjectsByPriority[MAX_NUM_GENERATION_THREADS];
 
-  //Variables related to downloading and in-memory caching meshes
+  //Variables related to downloading and in-memory caching meshes. The store
+  //is an LRU bounded by both the number of meshes and their (estimated)
+  //in-memory size.
   boost::mutex mMeshStoreMutex;
   std::tr1::unordered_map<String, Mesh::MeshdataPtr> mMeshStore;
   std::map<int, String> mMeshStoreOrdering;
   std::tr1::unordered_map<String, int> mMeshStoreOrderingReverse;
   int mCurrentInsertionNumber;
+  std::tr1::unordered_map<String, uint64> mMeshStoreSizes;
+  uint64 mMeshStoreBytes;
+  uint64 mMeshStoreMaxBytes;
 
   std::tr1::unordered_map<String, Prox::ZernikeDescriptor> mMeshDescriptors;
   std::tr1::shared_ptr<Transfer::TransferPool> mTransferPool;
@@ -344,6 +355,40 @@ private:
 
   void addToInMemoryCache(const String& meshName, const Mesh::MeshdataPtr mdptr);
   Mesh::MeshdataPtr getMeshFromStore(const String& name);
+  // Removes the least recently used entry. Requires mMeshStoreMutex.
+  void evictFromInMemoryCache();
+
+  // Content-addressed cache of generated aggregates, keyed by a digest of
+  // the child meshes, their placement and the simplification budget. If an
+  // aggregate is regenerated without any effective change to its inputs
+  // (or another aggregate has identical inputs), the simplified mesh and
+  // atlas are reused instead of being recomputed.
+  struct GeneratedMesh {
+      GeneratedMesh() : atlasLength(0), bytes(0) {}
+
+      Mesh::MeshdataPtr simplified;
+      // Set once atlasing for this mesh has completed.
+      Mesh::MeshdataPtr atlased;
+      String atlasName;
+      std::tr1::shared_ptr<char> atlasBuffer;
+      uint32 atlasLength;
+      uint64 bytes;
+  };
+  typedef std::tr1::shared_ptr<GeneratedMesh> GeneratedMeshPtr;
+  boost::mutex mGeneratedMeshCacheMutex;
+  typedef std::list<String> GeneratedMeshLRU;
+  GeneratedMeshLRU mGeneratedMeshLRU;
+  typedef std::tr1::unordered_map<String, std::pair<GeneratedMeshPtr, GeneratedMeshLRU::iterator> > GeneratedMeshCache;
+  GeneratedMeshCache mGeneratedMeshCache;
+  uint64 mGeneratedMeshCacheBytes;
+  uint64 mGeneratedMeshCacheMaxBytes;
+  AtomicValue<uint32> mGeneratedMeshCacheHits;
+  AtomicValue<uint32> mGeneratedMeshCacheMisses;
+
+  GeneratedMeshPtr getGeneratedMesh(const String& key);
+  void addGeneratedMesh(const String& key, Mesh::MeshdataPtr simplified);
+  void addGeneratedMeshAtlas(const String& key, Mesh::MeshdataPtr atlased, const String& atlas_name,
+                             std::tr1::shared_ptr<char> atlas_buffer, uint32 atlas_length);
 
 
   //CDN upload-related variables
@@ -393,6 +438,15 @@ private:
   Duration mAggregateCumulativeUploadTime;
   // And their size after being serialized.
   uint64 mAggregateCumulativeDataSize;
+  // Breakdown of cumulative time (across all threads) by pipeline
+  // stage. Download covers child meshes and atlas includes downloading the
+  // textures to atlas. Upload is mAggregateCumulativeUploadTime, which
+  // includes serialization.
+  Duration mStageDownloadTime;
+  Duration mStageSimplifyTime;
+  Duration mStageAtlasTime;
+  Duration mStageSerializeTime;
+  void addStageTime(Duration& stage, const Duration& dur);
 
   //Various utility functions
   bool findChild(std::vector<AggregateObjectPtr>& v, const UUID& uuid) ;
@@ -11,5 +11,7 @@
 #define OPT_AGGMGR_UPLOAD_THREADS    "aggmgr.upload-threads"
 #define OPT_AGGMGR_SKIP_GENERATE     "aggmgr.skip-generate"
 #define OPT_AGGMGR_SKIP_UPLOAD       "aggmgr.skip-upload"
+#define OPT_AGGMGR_MESH_STORE_SIZE   "aggmgr.mesh-store-size"
+#define OPT_AGGMGR_GENERATED_CACHE_SIZE "aggmgr.generated-cache-size"
 
 #endif //_SIRIKATA_SPACE_MESH_OPTIONS_HPP_
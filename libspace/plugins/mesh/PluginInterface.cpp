@@ -21,6 +21,8 @@ static void InitPluginOptions() {
         .addOption(new OptionValue(OPT_AGGMGR_UPLOAD_THREADS, "8", Sirikata::OptionValueType<uint16>(), "Number of AggregateManager mesh upload threads"))
         .addOption(new OptionValue(OPT_AGGMGR_SKIP_GENERATE, "false", Sirikata::OptionValueType<bool>(), "If true, skips generating but pretends it was always successful. Useful for testing without the overhead of generating aggregates."))
         .addOption(new OptionValue(OPT_AGGMGR_SKIP_UPLOAD, "false", Sirikata::OptionValueType<bool>(), "If true, skips uploading but pretends it was always successful. Useful for testing without pushing data to the CDN."))
+        .addOption(new OptionValue(OPT_AGGMGR_MESH_STORE_SIZE, "1024", Sirikata::OptionValueType<uint32>(), "Maximum size, in MB, of downloaded and generated meshes kept in memory for generating aggregates"))
+        .addOption(new OptionValue(OPT_AGGMGR_GENERATED_CACHE_SIZE, "256", Sirikata::OptionValueType<uint32>(), "Maximum size, in MB, of the cache of simplified and atlased aggregates reused when an aggregate's inputs haven't changed"))
         ;
 }
 
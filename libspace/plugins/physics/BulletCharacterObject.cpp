@@ -46,7 +46,7 @@ float32 BulletCharacterObject::mass() {
     return 0.f;
 }
 
-void BulletCharacterObject::load(Mesh::MeshdataPtr mesh) {
+void BulletCharacterObject::load(MeshCollisionShapePtr meshShape) {
     LocationInfo& locinfo = mParent->info(mID);
 
     Vector3f objPosition = mParent->currentPosition(mID);
@@ -62,7 +62,7 @@ void BulletCharacterObject::load(Mesh::MeshdataPtr mesh) {
 
     // Currently only support spheres, TODO(ewencp) we might want to support
     // capsules instead.
-    mCollisionShape = computeCollisionShape(mID, mBBox, BULLET_OBJECT_TREATMENT_CHARACTER, Mesh::MeshdataPtr());
+    mCollisionShape = computeCollisionShape(mID, mBBox, MeshCollisionShapePtr());
     mGhostObject->setCollisionShape(mCollisionShape);
     mGhostObject->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
 
@@ -153,15 +153,17 @@ void BulletCharacterObject::postTick(const Time& t) {
         (axis1.dot(axis2) < 0.9) || (fabs(angle1-angle2) > 3.14159/180);
 
     if (pos_diff > 0.001 || orient_changed) {
-        mParent->setLocation(mID, newLocation);
-        mParent->setOrientation(mID, newOrientation);
-        mParent->addUpdate(mID);
+        mParent->physicsUpdated(mID, newLocation, newOrientation);
     }
 }
 
 void BulletCharacterObject::deactivationTick(const Time& t) {
-    if (mGhostObject != NULL && !mGhostObject->isActive())
-        mParent->updateObjectFromDeactivation(mID);
+    if (mGhostObject != NULL && !mGhostObject->isActive()) {
+        btTransform xform = mGhostObject->getWorldTransform();
+        btVector3 pos = xform.getOrigin();
+        btQuaternion rot = xform.getRotation();
+        mParent->updateObjectFromDeactivation(mID, Vector3f(pos.x(), pos.y(), pos.z()), Quaternion(rot.x(), rot.y(), rot.z(), rot.w()));
+    }
 }
 
 bool BulletCharacterObject::applyRequestedLocation(const TimedMotionVector3f& loc, uint64 epoch) {
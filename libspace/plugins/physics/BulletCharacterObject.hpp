@@ -28,7 +28,7 @@ public:
     virtual bulletObjBBox bbox();
     virtual float32 mass();
 
-    virtual void load(Mesh::MeshdataPtr mesh);
+    virtual void load(MeshCollisionShapePtr meshShape);
     virtual void unload();
     virtual void preTick(const Time& t);
     virtual void postTick(const Time& t);
@@ -30,11 +30,13 @@ public:
     virtual bulletObjBBox bbox() = 0;
     virtual float32 mass() = 0;
 
-    /** After the mesh has been downloaded and parsed (or immediately if no mesh
-     *  is required), this loads the object into the simulation. This should
-     *  setup any Bullet state and start the physical simulation on the object.
+    /** After the collision data for the mesh is available (or immediately if
+     *  no mesh is required), this loads the object into the simulation. This
+     *  should setup any Bullet state and start the physical simulation on the
+     *  object. meshShape may be empty if no mesh was needed or it couldn't be
+     *  loaded.
      */
-    virtual void load(Mesh::MeshdataPtr mesh) = 0;
+    virtual void load(MeshCollisionShapePtr meshShape) = 0;
 
     /** Unload the object from the simulation.
      */
@@ -91,8 +93,9 @@ public:
 
 protected:
 
-    // Helper for computing the collision
-    btCollisionShape* computeCollisionShape(const UUID& id, bulletObjBBox shape_type, bulletObjTreatment treatment, Mesh::MeshdataPtr retrievedMesh);
+    // Helper for computing the collision shape. If meshShape is used, it must
+    // be kept alive as long as the returned shape.
+    btCollisionShape* computeCollisionShape(const UUID& id, bulletObjBBox shape_type, MeshCollisionShapePtr meshShape);
 
     BulletPhysicsService* mParent;
 }; // class BulletObject
@@ -35,11 +35,13 @@
 #include "BulletRigidBodyObject.hpp"
 #include "BulletCharacterObject.hpp"
 #include <sirikata/core/trace/Trace.hpp>
+#include <sirikata/core/util/Timer.hpp>
 #include <sirikata/mesh/CompositeFilter.hpp>
 
 #include "Protocol_Loc.pbj.hpp"
 
 #include <json_spirit/json_spirit.h>
+#include <boost/lexical_cast.hpp>
 
 #include <sirikata/core/transfer/AggregatedTransferPool.hpp>
 #include <sirikata/core/network/IOStrandImpl.hpp>
@@ -53,9 +55,23 @@ void bulletPhysicsInternalTickCallback(btDynamicsWorld *world, btScalar timeStep
 }
 }
 
-BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy)
+BulletPhysicsService::BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy, const Duration& fixed_step, uint32 max_substeps, float32 update_epsilon, float32 orientation_epsilon)
  : LocationService(ctx, update_policy),
    mUpdateIteration(0),
+   mFixedStep(fixed_step),
+   mMaxSubSteps(std::max<uint32>(max_substeps, 1)),
+   mUpdateEpsilon(update_epsilon),
+   mOrientationEpsilon(orientation_epsilon),
+   mUpdatesPublished(0),
+   mUpdatesSuppressed(0),
+   mTimeSeriesStepName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.physics_step_ms"),
+   mStepTimeTotal(Duration::zero()),
+   mStepTimeMax(Duration::zero()),
+   mStepCount(0),
+   mInternalStepCount(0),
+   mTimeSeriesReadyName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.physics_ready_ms"),
+   mReadyTimeTotal(Duration::zero()),
+   mReadyCount(0),
    mParsingStrand( ctx->ioService->createStrand("BulletPhysicsService Parsing") )
 {
 
@@ -133,46 +149,59 @@ void BulletPhysicsService::service() {
     Time now = mContext->simTime();
     Duration delTime = now - mLastTime;
     mLastTime = now;
-    float simForwardTime = delTime.toMilliseconds() / 1000.0f;
 
     // Pre tick
-    for(UUIDSet::iterator id_it = mTickObjects.begin(); id_it != mTickObjects.end(); id_it++) {
-        const UUID& locobj = *id_it;
-        LocationInfo& locinfo = mLocations[locobj];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->preTick(now);
-    }
-    // Step simulation
-    mDynamicsWorld->stepSimulation(simForwardTime);
+    for(size_t i = 0; i < mTickObjects.size(); i++)
+        mTickObjects[i]->preTick(now);
+    // Step simulation. Bullet keeps the leftover time that doesn't make up a
+    // full fixed step and uses it to interpolate the transforms it hands to
+    // motion states, so results don't depend on how often we're serviced.
+    Time step_start = Timer::now();
+    int substeps = mDynamicsWorld->stepSimulation(
+        (btScalar)delTime.toSeconds(), (int)mMaxSubSteps, (btScalar)mFixedStep.toSeconds()
+    );
+    Duration step_time = Timer::now() - step_start;
+    mStepTimeTotal += step_time;
+    if (step_time > mStepTimeMax) mStepTimeMax = step_time;
+    mStepCount++;
+    mInternalStepCount += substeps;
     // Post tick
-    for(UUIDSet::iterator id_it = mTickObjects.begin(); id_it != mTickObjects.end(); id_it++) {
-        const UUID& locobj = *id_it;
-        LocationInfo& locinfo = mLocations[locobj];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->postTick(now);
-    }
+    for(size_t i = 0; i < mTickObjects.size(); i++)
+        mTickObjects[i]->postTick(now);
 
     // Check for deactivated objects. Unfortunately there isn't a way to get
     // this information from bullet at the time deactivation, so we need to poll
     // for it
     static Duration deactivation_check_interval(Duration::seconds(1));
     if (now - mLastDeactivationTime > deactivation_check_interval) {
-        for(UUIDSet::iterator id_it = mDeactivateableObjects.begin(); id_it != mDeactivateableObjects.end(); id_it++) {
-            const UUID& locobj = *id_it;
-            LocationInfo& locinfo = mLocations[locobj];
-            assert(locinfo.simObject != NULL);
-            locinfo.simObject->deactivationTick(now);
-        }
+        for(size_t i = 0; i < mDeactivateableObjects.size(); i++)
+            mDeactivateableObjects[i]->deactivationTick(now);
         mLastDeactivationTime = now;
+
+        if (mStepCount > 0) {
+            mContext->timeSeries->report(
+                mTimeSeriesStepName,
+                (mStepTimeTotal / (uint64)mStepCount).toSeconds() * 1000.0
+            );
+            BULLETLOG(insane, "Stepped " << mStepCount << " times (" << mInternalStepCount << " internal steps), mean " << (mStepTimeTotal / (uint64)mStepCount) << ", max " << mStepTimeMax);
+        }
+        mStepTimeTotal = Duration::zero();
+        mStepTimeMax = Duration::zero();
+        mStepCount = 0;
+        mInternalStepCount = 0;
+
+        if (mReadyCount > 0) {
+            mContext->timeSeries->report(
+                mTimeSeriesReadyName,
+                (mReadyTimeTotal / (uint64)mReadyCount).toSeconds() * 1000.0
+            );
+        }
+        mReadyTimeTotal = Duration::zero();
+        mReadyCount = 0;
     }
 
     // Process location updates
-    for(UUIDSet::iterator i = physicsUpdates.begin(); i != physicsUpdates.end(); i++) {
-        LocationMap::iterator it = mLocations.find(*i);
-        if(it != mLocations.end())
-            notifyLocalLocationUpdated(*i, it->second.aggregate, it->second.props.location() );
-    }
-    physicsUpdates.clear();
+    publishPhysicsUpdates();
 
     // See note at declaration of mUpdateIteration. The fastest possible update
     // rate depends on this constant (10) and the LocationService target tick
@@ -185,17 +214,14 @@ uint64 BulletPhysicsService::epoch(const UUID& uuid) {
     LocationMap::iterator it = mLocations.find(uuid);
     assert(it != mLocations.end());
 
-    LocationInfo locinfo = it->second;
-    return locinfo.props.maxSeqNo();
+    return it->second.props.maxSeqNo();
 }
 
 TimedMotionVector3f BulletPhysicsService::location(const UUID& uuid) {
     LocationMap::iterator it = mLocations.find(uuid);
     assert(it != mLocations.end());
 
-
-    LocationInfo locinfo = it->second;
-    return locinfo.props.location();
+    return it->second.props.location();
 }
 
 Vector3f BulletPhysicsService::currentPosition(const UUID& uuid) {
@@ -208,8 +234,7 @@ TimedMotionQuaternion BulletPhysicsService::orientation(const UUID& uuid) {
     LocationMap::iterator it = mLocations.find(uuid);
     assert(it != mLocations.end());
 
-    LocationInfo locinfo = it->second;
-    return locinfo.props.orientation();
+    return it->second.props.orientation();
 }
 
 Quaternion BulletPhysicsService::currentOrientation(const UUID& uuid) {
@@ -221,8 +246,7 @@ AggregateBoundingInfo BulletPhysicsService::bounds(const UUID& uuid) {
     LocationMap::iterator it = mLocations.find(uuid);
     assert(it != mLocations.end());
 
-    LocationInfo locinfo = it->second;
-    return locinfo.props.bounds();
+    return it->second.props.bounds();
 }
 
 const String& BulletPhysicsService::mesh(const UUID& uuid) {
@@ -294,29 +318,54 @@ void BulletPhysicsService::setOrientation(const UUID& uuid, const TimedMotionQua
     notifyLocalOrientationUpdated( uuid, locinfo.aggregate, neworient );
 }
 
-void BulletPhysicsService::getMesh(const Transfer::URI meshURI, const UUID uuid, MeshdataParsedCallback cb) {
-    Transfer::ResourceDownloadTaskPtr dl = Transfer::ResourceDownloadTask::construct(
-        Transfer::URI(meshURI), mTransferPool, 1.0,
+void BulletPhysicsService::getCollisionShape(const Transfer::URI& meshURI, bulletObjBBox shape_type, bool convex, CollisionShapeCallback cb) {
+    CollisionShapeCache::Key key(meshURI.toString(), shape_type, convex);
+
+    MeshCollisionShapePtr shape = mShapeCache.get(key);
+    if (shape) {
+        cb(shape);
+        return;
+    }
+
+    // Someone else is already waiting on this shape
+    PendingShapeMap::iterator pending_it = mPendingShapes.find(key);
+    if (pending_it != mPendingShapes.end()) {
+        pending_it->second.push_back(cb);
+        return;
+    }
+    mPendingShapes[key].push_back(cb);
+
+    // Or at least on the same mesh
+    MeshDownloadMap::iterator dl_it = mMeshDownloads.find(meshURI);
+    if (dl_it != mMeshDownloads.end()) {
+        dl_it->second.shapes.push_back(key);
+        return;
+    }
+
+    MeshDownload& download = mMeshDownloads[meshURI];
+    download.shapes.push_back(key);
+    download.task = Transfer::ResourceDownloadTask::construct(
+        meshURI, mTransferPool, 1.0,
         // Ideally parsing wouldn't need to be serialized, but something about
         // getting callbacks from multiple threads and parsing simultaneously is
         // causing a crash
         mParsingStrand->wrap(
-            std::tr1::bind(&BulletPhysicsService::getMeshCallback, this, _1, _2, _3, cb)
+            std::tr1::bind(&BulletPhysicsService::getMeshCallback, this, _1, _2, _3, meshURI)
         )
     );
-    mMeshDownloads[uuid] = dl;
-    dl->start();
+    download.task->start();
 }
 
-void BulletPhysicsService::getMeshCallback(Transfer::ResourceDownloadTaskPtr taskptr, Transfer::TransferRequestPtr request, Transfer::DenseDataPtr response, MeshdataParsedCallback cb) {
+void BulletPhysicsService::getMeshCallback(Transfer::ResourceDownloadTaskPtr taskptr, Transfer::TransferRequestPtr request, Transfer::DenseDataPtr response, Transfer::URI meshURI) {
     // This callback can come in on a separate thread (e.g. from a tranfer
     // thread) so make sure we get it back on the main thread.
+    MeshdataPtr mesh;
     if (request && response) {
         Transfer::ChunkRequestPtr chunkreq = std::tr1::static_pointer_cast<Transfer::ChunkRequest>(request);
 
         VisualPtr vis = mModelsSystem->load(chunkreq->getMetadata(), chunkreq->getMetadata().getFingerprint(), response);
         // FIXME support more than Meshdata
-        MeshdataPtr mesh( std::tr1::dynamic_pointer_cast<Meshdata>(vis) );
+        mesh = std::tr1::dynamic_pointer_cast<Meshdata>(vis);
         if (mesh && mModelFilter) {
             Mesh::MutableFilterDataPtr input_data(new Mesh::FilterData);
             input_data->push_back(mesh);
@@ -324,13 +373,61 @@ void BulletPhysicsService::getMeshCallback(Transfer::ResourceDownloadTaskPtr tas
             assert(output_data->single());
             mesh = std::tr1::dynamic_pointer_cast<Meshdata>(output_data->get());
         }
-        mContext->mainStrand->post(std::tr1::bind(cb, mesh), "BulletPhysicsService::getMeshCallback");
     }
-    else {
-        mContext->mainStrand->post(std::tr1::bind(cb, MeshdataPtr()), "BulletPhysicsService::getMeshCallback");
+    mContext->mainStrand->post(
+        std::tr1::bind(&BulletPhysicsService::handleMeshParsed, this, meshURI, mesh),
+        "BulletPhysicsService::handleMeshParsed"
+    );
+}
+
+void BulletPhysicsService::handleMeshParsed(const Transfer::URI& meshURI, MeshdataPtr mesh) {
+    MeshDownloadMap::iterator dl_it = mMeshDownloads.find(meshURI);
+    assert(dl_it != mMeshDownloads.end());
+    std::vector<CollisionShapeCache::Key> shapes;
+    shapes.swap(dl_it->second.shapes);
+    mMeshDownloads.erase(dl_it);
+
+    for(uint32 i = 0; i < shapes.size(); i++) {
+        // Without a mesh, waiting objects fall back to spheres. Failures aren't
+        // cached so the next object using the mesh tries again.
+        if (!mesh) {
+            dispatchCollisionShape(shapes[i], MeshCollisionShapePtr());
+            continue;
+        }
+        // Building can be expensive, especially convex hulls, so keep it off
+        // the main strand
+        mParsingStrand->post(
+            std::tr1::bind(&BulletPhysicsService::buildCollisionShape, this, shapes[i], mesh),
+            "BulletPhysicsService::buildCollisionShape"
+        );
     }
 }
 
+void BulletPhysicsService::buildCollisionShape(const CollisionShapeCache::Key& key, MeshdataPtr mesh) {
+    MeshCollisionShape* shape = MeshCollisionShape::build(key.shape_type, key.convex, mesh);
+    mContext->mainStrand->post(
+        std::tr1::bind(&BulletPhysicsService::handleCollisionShapeBuilt, this, key, shape),
+        "BulletPhysicsService::handleCollisionShapeBuilt"
+    );
+}
+
+void BulletPhysicsService::handleCollisionShapeBuilt(const CollisionShapeCache::Key& key, MeshCollisionShape* shape) {
+    MeshCollisionShapePtr shape_ptr(shape);
+    mShapeCache.insert(key, shape_ptr);
+    dispatchCollisionShape(key, shape_ptr);
+}
+
+void BulletPhysicsService::dispatchCollisionShape(const CollisionShapeCache::Key& key, MeshCollisionShapePtr shape) {
+    PendingShapeMap::iterator pending_it = mPendingShapes.find(key);
+    assert(pending_it != mPendingShapes.end());
+    std::vector<CollisionShapeCallback> callbacks;
+    callbacks.swap(pending_it->second);
+    mPendingShapes.erase(pending_it);
+
+    for(uint32 i = 0; i < callbacks.size(); i++)
+        callbacks[i](shape);
+}
+
   void BulletPhysicsService::addLocalObject(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bnds, const String& msh, const String& phy, const String& query_data) {
     LocationMap::iterator it = mLocations.find(uuid);
 
@@ -430,19 +527,21 @@ void BulletPhysicsService::updatePhysicsWorld(const UUID& uuid) {
     }
 
     // We may need the mesh in order to continue. We need it only if:
-    // treatment != ignore (see above check) && bounds != sphere.
-    if (locinfo.simObject->bbox() == BULLET_OBJECT_BOUNDS_SPHERE) {
+    // treatment != ignore (see above check) && bounds != sphere. Characters
+    // currently always use spheres.
+    if (locinfo.simObject->bbox() == BULLET_OBJECT_BOUNDS_SPHERE ||
+        objTreatment == BULLET_OBJECT_TREATMENT_CHARACTER) {
         // Invoke directly since we have all the data we need
-        updatePhysicsWorldWithMesh(uuid, MeshdataPtr());
+        updatePhysicsWorldWithShape(uuid, Timer::now(), MeshCollisionShapePtr());
     }
     else {
-        getMesh(msh, uuid,
-            std::tr1::bind(&BulletPhysicsService::updatePhysicsWorldWithMesh, this, uuid, _1)
+        getCollisionShape(msh, objBBox, objTreatment != BULLET_OBJECT_TREATMENT_STATIC,
+            std::tr1::bind(&BulletPhysicsService::updatePhysicsWorldWithShape, this, uuid, Timer::now(), _1)
         );
     }
 }
 
-void BulletPhysicsService::updatePhysicsWorldWithMesh(const UUID& uuid, MeshdataPtr retrievedMesh) {
+void BulletPhysicsService::updatePhysicsWorldWithShape(const UUID& uuid, const Time& requested, MeshCollisionShapePtr meshShape) {
     LocationMap::iterator it = mLocations.find(uuid);
     // It's possible it has already disconnected. TODO(ewencp) we
     // should clear the download instead of waiting for it to finish,
@@ -454,8 +553,13 @@ void BulletPhysicsService::updatePhysicsWorldWithMesh(const UUID& uuid, Meshdata
     if (it == mLocations.end()) return;
 
     LocationInfo& locinfo = it->second;
+    // Or its physics settings may have been changed to ignore it
+    if (locinfo.simObject == NULL) return;
+
+    locinfo.simObject->load(meshShape);
 
-    locinfo.simObject->load(retrievedMesh);
+    mReadyTimeTotal += Timer::now() - requested;
+    mReadyCount++;
 }
 
 // Helper for cleaning up a LocationInfo before removing it
@@ -497,74 +601,143 @@ const LocationInfo& BulletPhysicsService::info(const UUID& uuid) const {
     return mLocations.find(uuid)->second;
 }
 
+void BulletPhysicsService::TickList::add(const UUID& uuid, BulletObject* obj) {
+    assert(obj != NULL);
+    IndexMap::iterator it = mIndices.find(uuid);
+    if (it != mIndices.end()) {
+        mObjects[it->second] = obj;
+        return;
+    }
+    mIndices[uuid] = mObjects.size();
+    mObjects.push_back(obj);
+    mIDs.push_back(uuid);
+}
+
+void BulletPhysicsService::TickList::remove(const UUID& uuid) {
+    IndexMap::iterator it = mIndices.find(uuid);
+    if (it == mIndices.end())
+        return;
+    // Swap the last entry into the hole to keep the list dense
+    size_t idx = it->second;
+    mIndices.erase(it);
+    size_t last = mObjects.size() - 1;
+    if (idx != last) {
+        mObjects[idx] = mObjects[last];
+        mIDs[idx] = mIDs[last];
+        mIndices[mIDs[idx]] = idx;
+    }
+    mObjects.pop_back();
+    mIDs.pop_back();
+}
+
 void BulletPhysicsService::addTickObject(const UUID& uuid) {
-    mTickObjects.insert(uuid);
+    mTickObjects.add(uuid, info(uuid).simObject);
 }
 void BulletPhysicsService::removeTickObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mTickObjects.find(uuid);
-    if (dynamic_obj_it != mTickObjects.end())
-        mTickObjects.erase(dynamic_obj_it);
+    mTickObjects.remove(uuid);
 }
 
 void BulletPhysicsService::addInternalTickObject(const UUID& uuid) {
-    mInternalTickObjects.insert(uuid);
+    mInternalTickObjects.add(uuid, info(uuid).simObject);
 }
 void BulletPhysicsService::removeInternalTickObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mInternalTickObjects.find(uuid);
-    if (dynamic_obj_it != mInternalTickObjects.end())
-        mInternalTickObjects.erase(dynamic_obj_it);
+    mInternalTickObjects.remove(uuid);
 }
 
 void BulletPhysicsService::addDeactivateableObject(const UUID& uuid) {
-    mDeactivateableObjects.insert(uuid);
+    mDeactivateableObjects.add(uuid, info(uuid).simObject);
 }
 void BulletPhysicsService::removeDeactivateableObject(const UUID& uuid) {
-    UUIDSet::iterator dynamic_obj_it = mDeactivateableObjects.find(uuid);
-    if (dynamic_obj_it != mDeactivateableObjects.end())
-        mDeactivateableObjects.erase(dynamic_obj_it);
+    mDeactivateableObjects.remove(uuid);
 }
 
 
-void BulletPhysicsService::addUpdate(const UUID& uuid) {
-    physicsUpdates.insert(uuid);
+void BulletPhysicsService::physicsUpdated(const UUID& uuid, const TimedMotionVector3f& newloc, const TimedMotionQuaternion& neworient, bool force) {
+    // Bullet may report an object several times per tick (once per internal
+    // step); only the last one matters, but a forced update stays forced.
+    PhysicsUpdate& update = mPhysicsUpdates[uuid];
+    update.location = newloc;
+    update.orientation = neworient;
+    update.force = update.force || force;
 }
 
-void BulletPhysicsService::updateObjectFromDeactivation(const UUID& uuid) {
+void BulletPhysicsService::updateObjectFromDeactivation(const UUID& uuid, const Vector3f& pos, const Quaternion& orient) {
     if (isFixed(uuid)) return;
     if (location(uuid).velocity() == Vector3f(0.f, 0.f, 0.f) &&
         orientation(uuid).velocity() == Quaternion::identity())
         return;
 
+    // Use the position the simulation actually stopped at rather than our
+    // extrapolation -- with dead reckoning the last published location may
+    // be a little off.
     Time t = context()->simTime();
     TimedMotionVector3f newLocation(
         t,
         MotionVector3f(
-            currentPosition(uuid),
+            pos,
             Vector3f(0.f, 0.f, 0.f)
         )
     );
-    setLocation(uuid, newLocation);
     BULLETLOG(insane, "Updating " << uuid.toString() << " to stopped.");
 
     TimedMotionQuaternion newOrientation(
         t,
         MotionQuaternion(
-            currentOrientation(uuid),
+            orient,
             Quaternion::identity()
         )
     );
-    setOrientation(uuid, newOrientation);
 
-    physicsUpdates.insert(uuid);
+    physicsUpdated(uuid, newLocation, newOrientation, true);
+}
+
+void BulletPhysicsService::publishPhysicsUpdates() {
+    mPhysicsUpdateBatch.clear();
+    for(PhysicsUpdateMap::iterator up_it = mPhysicsUpdates.begin(); up_it != mPhysicsUpdates.end(); up_it++) {
+        LocationMap::iterator it = mLocations.find(up_it->first);
+        if (it == mLocations.end()) continue;
+        LocationInfo& locinfo = it->second;
+        const PhysicsUpdate& update = up_it->second;
+
+        if (!update.force) {
+            // Compare against what everyone extrapolates from the last update
+            // we published
+            Time t = update.location.updateTime();
+            float32 pos_error = (locinfo.props.location().position(t) - update.location.position()).length();
+            Quaternion old_orient = locinfo.props.orientation().position(t);
+            Quaternion new_orient = update.orientation.position();
+            float32 orient_dot = fabs(
+                old_orient.x*new_orient.x + old_orient.y*new_orient.y +
+                old_orient.z*new_orient.z + old_orient.w*new_orient.w
+            );
+            float32 orient_error = 2.f * acos(std::min(orient_dot, 1.f));
+            if (pos_error <= mUpdateEpsilon && orient_error <= mOrientationEpsilon) {
+                mUpdatesSuppressed++;
+                continue;
+            }
+        }
+
+        // Note non-epoch (seqno) version because this isn't due to a request.
+        locinfo.props.setLocation(update.location);
+        locinfo.props.setOrientation(update.orientation);
+
+        mPhysicsUpdateBatch.push_back(LocalLocationUpdate());
+        LocalLocationUpdate& out = mPhysicsUpdateBatch.back();
+        out.uuid = up_it->first;
+        out.agg = locinfo.aggregate;
+        out.location = update.location;
+        out.orientation = update.orientation;
+    }
+    mPhysicsUpdates.clear();
+
+    mUpdatesPublished += mPhysicsUpdateBatch.size();
+    notifyLocalLocationsUpdated(mPhysicsUpdateBatch);
 }
 
 void BulletPhysicsService::internalTickCallback() {
     Time t = mContext->simTime();
-    for(UUIDSet::iterator id_it = mInternalTickObjects.begin(); id_it != mInternalTickObjects.end(); id_it++) {
-        LocationInfo& locinfo = mLocations[*id_it];
-        assert(locinfo.simObject != NULL);
-        locinfo.simObject->internalTick(t);
-    }
+    for(size_t i = 0; i < mInternalTickObjects.size(); i++)
+        mInternalTickObjects[i]->internalTick(t);
 }
 
 void BulletPhysicsService::addLocalAggregateObject(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bnds, const String& msh, const String& phy, const String& query_data) {
@@ -979,6 +1152,19 @@ void BulletPhysicsService::commandProperties(const Command::Command& cmd, Comman
     result.put("objects.local_count", local_count);
     result.put("objects.aggregate_count", aggregate_count);
     result.put("objects.local_aggregate_count", local_aggregate_count);
+    result.put("physics.fixed_step", mFixedStep.toSeconds());
+    result.put("physics.max_substeps", mMaxSubSteps);
+    result.put("physics.tick_objects", mTickObjects.size());
+    result.put("physics.internal_tick_objects", mInternalTickObjects.size());
+    result.put("physics.updates.published", mUpdatesPublished);
+    result.put("physics.updates.suppressed", mUpdatesSuppressed);
+    result.put("physics.shape_cache.entries", mShapeCache.entries());
+    result.put("physics.shape_cache.hits", mShapeCache.hits());
+    result.put("physics.shape_cache.misses", mShapeCache.misses());
+    result.put("physics.shape_cache.bytes", mShapeCache.size());
+    result.put("physics.shape_cache.bytes_saved", mShapeCache.sizeSaved());
+    result.put("physics.shape_cache.pending", mPendingShapes.size());
+    result.put("physics.mesh_downloads", mMeshDownloads.size());
 
     cmdr->result(cmdid, result);
 }
@@ -45,6 +45,9 @@
 #include <sirikata/mesh/Meshdata.hpp>
 
 #include "Defs.hpp"
+#include "CollisionShapeCache.hpp"
+
+#include <vector>
 
 namespace Sirikata {
 
@@ -54,7 +57,17 @@ using namespace Mesh;
  */
 class BulletPhysicsService : public LocationService {
 public:
-    BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy);
+    /** Create a physics service. The simulation is advanced in fixed
+     *  increments of fixed_step, with at most max_substeps of them per call
+     *  to service(); time beyond that is dropped so a slow frame can't spiral
+     *  into ever longer ones.
+     *
+     *  Motion computed by the simulation is only published when it differs
+     *  from what listeners would extrapolate from the last published
+     *  location by more than update_epsilon (distance), or orientation by
+     *  more than orientation_epsilon (radians).
+     */
+    BulletPhysicsService(SpaceContext* ctx, LocationUpdatePolicy* update_policy, const Duration& fixed_step, uint32 max_substeps, float32 update_epsilon, float32 orientation_epsilon);
     virtual ~BulletPhysicsService();
 
     virtual bool contains(const UUID& uuid) const;
@@ -111,12 +124,18 @@ public:
     virtual void commandObjectProperties(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
 
 
-    typedef std::tr1::function<void(MeshdataPtr)> MeshdataParsedCallback;
-    void getMesh(const Transfer::URI meshURI, const UUID uuid, MeshdataParsedCallback cb);
+    typedef std::tr1::function<void(MeshCollisionShapePtr)> CollisionShapeCallback;
+    /** Get the collision data for a mesh. If another object is already using
+     *  the same mesh and kind of shape, it's shared; otherwise the mesh is
+     *  downloaded (once, no matter how many objects are waiting on it) and
+     *  the shape is built off the main strand. The callback is invoked on the
+     *  main strand, with an empty pointer if the mesh couldn't be loaded.
+     */
+    void getCollisionShape(const Transfer::URI& meshURI, bulletObjBBox shape_type, bool convex, CollisionShapeCallback cb);
     // The last two get set in this callback, indicating that the
     // transfer finished (whether or not it was successful) and the
     // resulting data.
-    void getMeshCallback(Transfer::ResourceDownloadTaskPtr taskptr, Transfer::TransferRequestPtr request, Transfer::DenseDataPtr response, MeshdataParsedCallback cb);
+    void getMeshCallback(Transfer::ResourceDownloadTaskPtr taskptr, Transfer::TransferRequestPtr request, Transfer::DenseDataPtr response, Transfer::URI meshURI);
 
     LocationInfo& info(const UUID& uuid);
     const LocationInfo& info(const UUID& uuid) const;
@@ -136,10 +155,14 @@ public:
     void addDeactivateableObject(const UUID& uuid);
     void removeDeactivateableObject(const UUID& uuid);
 
-    // Add an update for this object, i.e. it was detected that it moved
-    void addUpdate(const UUID& uuid);
+    // Record motion for this object computed by the simulation. Updates are
+    // collected and published together at the end of the tick; if force is
+    // false, only if they differ enough from the last published values.
+    void physicsUpdated(const UUID& uuid, const TimedMotionVector3f& newloc, const TimedMotionQuaternion& neworient, bool force = false);
 
-    void updateObjectFromDeactivation(const UUID& uuid);
+    // The simulation put the object to sleep at the given position and
+    // orientation, so publish it as stopped there.
+    void updateObjectFromDeactivation(const UUID& uuid, const Vector3f& pos, const Quaternion& orient);
 
     // Callback invoked each time bullet performs an internal tick
     // (may be finer granularity than we request).
@@ -149,17 +172,45 @@ protected:
     LocationMap mLocations;
 
     typedef std::tr1::unordered_set<UUID, UUID::Hasher> UUIDSet;
+
+    // A dense list of simulation objects that want a callback. Ticks walk the
+    // array directly instead of looking each object up in mLocations, which
+    // matters for internal ticks since Bullet may run several per service().
+    class TickList {
+    public:
+        void add(const UUID& uuid, BulletObject* obj);
+        void remove(const UUID& uuid);
+
+        size_t size() const { return mObjects.size(); }
+        BulletObject* operator[](size_t idx) const { return mObjects[idx]; }
+    private:
+        typedef std::tr1::unordered_map<UUID, size_t, UUID::Hasher> IndexMap;
+        std::vector<BulletObject*> mObjects;
+        std::vector<UUID> mIDs;
+        IndexMap mIndices;
+    };
+
     // Which objects have dynamic physical simulation and need to be
     // sanity checked at each tick.
-    UUIDSet mTickObjects;
+    TickList mTickObjects;
     // Which objects have dynamic physical simulation and need to be
-    // sanity checked at each tick.
-    UUIDSet mInternalTickObjects;
+    // sanity checked at each internal tick.
+    TickList mInternalTickObjects;
     // Objects that need to be checked for deactivation
-    UUIDSet mDeactivateableObjects;
+    TickList mDeactivateableObjects;
     // Objects which have outstanding updates to location information
     // from the physics engine.
-    UUIDSet physicsUpdates;
+    struct PhysicsUpdate {
+        PhysicsUpdate() : force(false) {}
+
+        TimedMotionVector3f location;
+        TimedMotionQuaternion orientation;
+        bool force;
+    };
+    typedef std::tr1::unordered_map<UUID, PhysicsUpdate, UUID::Hasher> PhysicsUpdateMap;
+    PhysicsUpdateMap mPhysicsUpdates;
+    // Reused for each batch to avoid reallocating
+    LocalLocationUpdateList mPhysicsUpdateBatch;
     // TODO(ewencp) This is kind of a hack. If we generate updates too quickly
     // we can overwhelm the client and the networking, making it hard for more
     // recent updates to get out. This is common for bullet since it is
@@ -168,15 +219,36 @@ protected:
     // for updates to reach the OH.
     uint32 mUpdateIteration;
 
-    typedef std::tr1::unordered_map<UUID, Transfer::ResourceDownloadTaskPtr, UUID::Hasher> MeshDownloadMap;
+    // Mesh downloads in progress and the shapes waiting for each of them
+    struct MeshDownload {
+        Transfer::ResourceDownloadTaskPtr task;
+        std::vector<CollisionShapeCache::Key> shapes;
+    };
+    typedef std::map<Transfer::URI, MeshDownload> MeshDownloadMap;
     MeshDownloadMap mMeshDownloads;
+    // Shapes being downloaded or built and the callbacks waiting for them
+    typedef std::map<CollisionShapeCache::Key, std::vector<CollisionShapeCallback> > PendingShapeMap;
+    PendingShapeMap mPendingShapes;
+    CollisionShapeCache mShapeCache;
 
 private:
 
+    // Check outstanding physics updates against their dead reckoning
+    // thresholds and publish the ones that pass as one batch.
+    void publishPhysicsUpdates();
+
     void updatePhysicsWorld(const UUID& uuid);
-    // This continues the work of updatePhysicsWorld once the mesh has
-    // been retrieved.
-    void updatePhysicsWorldWithMesh(const UUID& uuid, MeshdataPtr retrievedMesh);
+    // This continues the work of updatePhysicsWorld once the collision shape
+    // for the mesh is available.
+    void updatePhysicsWorldWithShape(const UUID& uuid, const Time& requested, MeshCollisionShapePtr meshShape);
+
+    // Steps in getting a collision shape. The mesh is parsed on the parsing
+    // strand, shapes are built on the parsing strand, and the results are
+    // handled on the main strand.
+    void handleMeshParsed(const Transfer::URI& meshURI, MeshdataPtr mesh);
+    void buildCollisionShape(const CollisionShapeCache::Key& key, MeshdataPtr mesh);
+    void handleCollisionShapeBuilt(const CollisionShapeCache::Key& key, MeshCollisionShape* shape);
+    void dispatchCollisionShape(const CollisionShapeCache::Key& key, MeshCollisionShapePtr shape);
 
     // Helper for cleaning up a LocationInfo before removing it
     void cleanupLocationInfo(LocationInfo& locinfo);
@@ -193,6 +265,28 @@ private:
     // Track last time we checked deactivation state
     Time mLastDeactivationTime;
 
+    // Size of each internal simulation step and the most we'll take in one
+    // service() call. Bullet accumulates the remainder and interpolates
+    // motion states between steps.
+    const Duration mFixedStep;
+    const uint32 mMaxSubSteps;
+    // Dead reckoning thresholds for publishing updates
+    const float32 mUpdateEpsilon;
+    const float32 mOrientationEpsilon;
+    uint64 mUpdatesPublished;
+    uint64 mUpdatesSuppressed;
+
+    // Stats on stepping cost, reported along with the deactivation check
+    const String mTimeSeriesStepName;
+    Duration mStepTimeTotal;
+    Duration mStepTimeMax;
+    uint32 mStepCount;
+    uint32 mInternalStepCount;
+    // And on how long it takes objects to get into the simulation
+    const String mTimeSeriesReadyName;
+    Duration mReadyTimeTotal;
+    uint32 mReadyCount;
+
     //load meshes to create appropriate bounding volumes
     ModelsSystem* mModelsSystem;
     Mesh::Filter* mModelFilter;
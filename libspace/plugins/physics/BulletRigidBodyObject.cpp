@@ -73,8 +73,9 @@ BulletRigidBodyObject::~BulletRigidBodyObject() {
     removeRigidBody();
 }
 
-void BulletRigidBodyObject::load(MeshdataPtr retrievedMesh) {
-    mObjShape = computeCollisionShape(mID, mBBox, mTreatment, retrievedMesh);
+void BulletRigidBodyObject::load(MeshCollisionShapePtr meshShape) {
+    mMeshShape = meshShape;
+    mObjShape = computeCollisionShape(mID, mBBox, mMeshShape);
     assert(mObjShape != NULL);
     addRigidBody();
 }
@@ -137,6 +138,7 @@ void BulletRigidBodyObject::removeRigidBody() {
 
         delete mObjShape;
         mObjShape = NULL;
+        mMeshShape.reset();
         delete mObjMotionState;
         mObjMotionState = NULL;
         delete mObjRigidBody;
@@ -159,12 +161,9 @@ void BulletRigidBodyObject::updateBulletFromObject(btTransform& worldTrans) {
 void BulletRigidBodyObject::updateObjectFromBullet(const btTransform& worldTrans) {
     assert(mFixed == false);
 
-    LocationInfo& locinfo = mParent->info(mID);
-
     btVector3 pos = worldTrans.getOrigin();
     btVector3 vel = mObjRigidBody->getLinearVelocity();
     TimedMotionVector3f newLocation(mParent->context()->simTime(), MotionVector3f(Vector3f(pos.x(), pos.y(), pos.z()), Vector3f(vel.x(), vel.y(), vel.z())));
-    mParent->setLocation(mID, newLocation);
     BULLETLOG(insane, "Updating " << mID << " to velocity " << vel.x() << " " << vel.y() << " " << vel.z());
     btQuaternion rot = worldTrans.getRotation();
     btVector3 angvel = mObjRigidBody->getAngularVelocity();
@@ -177,9 +176,7 @@ void BulletRigidBodyObject::updateObjectFromBullet(const btTransform& worldTrans
             Quaternion(angvel_siri, angvel_angle)
         )
     );
-    mParent->setOrientation(mID, newOrientation);
-
-    mParent->addUpdate(mID);
+    mParent->physicsUpdated(mID, newLocation, newOrientation);
 }
 
 
@@ -208,8 +205,12 @@ void BulletRigidBodyObject::internalTick(const Time& t) {
 }
 
 void BulletRigidBodyObject::deactivationTick(const Time& t) {
-    if (mObjRigidBody != NULL && !mObjRigidBody->isActive())
-        mParent->updateObjectFromDeactivation(mID);
+    if (mObjRigidBody != NULL && !mObjRigidBody->isActive()) {
+        btTransform xform = mObjRigidBody->getWorldTransform();
+        btVector3 pos = xform.getOrigin();
+        btQuaternion rot = xform.getRotation();
+        mParent->updateObjectFromDeactivation(mID, Vector3f(pos.x(), pos.y(), pos.z()), Quaternion(rot.x(), rot.y(), rot.z(), rot.w()));
+    }
 }
 
 
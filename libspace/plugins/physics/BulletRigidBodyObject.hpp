@@ -25,7 +25,7 @@ public:
     virtual bulletObjBBox bbox() { return mBBox; }
     virtual float32 mass() { return mMass; }
 
-    virtual void load(Mesh::MeshdataPtr mesh);
+    virtual void load(MeshCollisionShapePtr meshShape);
     virtual void unload();
     virtual void internalTick(const Time& t);
     virtual void deactivationTick(const Time& t);
@@ -53,6 +53,8 @@ private:
     float32 mMass;
     // And then some implementation data:
     btCollisionShape* mObjShape;
+    // Shared data mObjShape may be built on, see computeCollisionShape
+    MeshCollisionShapePtr mMeshShape;
     SirikataMotionState* mObjMotionState;
     btRigidBody* mObjRigidBody;
 
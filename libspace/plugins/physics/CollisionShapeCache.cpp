@@ -0,0 +1,241 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "CollisionShapeCache.hpp"
+
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
+
+#include <sirikata/mesh/Bounds.hpp>
+
+namespace Sirikata {
+
+using namespace Mesh;
+
+MeshCollisionShape::MeshCollisionShape(bulletObjBBox shape_type)
+ : mShapeType(shape_type),
+   mHalfExtents(0, 0, 0),
+   mTriangles(NULL),
+   mBvh(NULL)
+{
+}
+
+MeshCollisionShape::~MeshCollisionShape() {
+    delete mBvh;
+    delete mTriangles;
+}
+
+MeshCollisionShape* MeshCollisionShape::build(bulletObjBBox shape_type, bool convex, MeshdataPtr retrievedMesh) {
+    assert(shape_type != BULLET_OBJECT_BOUNDS_SPHERE);
+    assert(retrievedMesh);
+
+    MeshCollisionShape* result = new MeshCollisionShape(shape_type);
+
+    /***Let's now find the bounding box for the entire object, which is needed for re-scaling purposes.
+	* Supposedly the system scales every mesh down to a unit sphere and then scales up by the scale factor
+	* from the scene file. We try to emulate this behavior here, but this should really be on the CDN side
+	* (we retrieve the precomputed bounding box as well as the mesh) ***/
+    BoundingBox3f3f bbox;
+    double mesh_rad;
+    ComputeBounds(retrievedMesh, &bbox, &mesh_rad);
+
+    BULLETLOG(detailed, "bbox: " << bbox);
+    Vector3f diff = bbox.max() - bbox.min();
+
+    if (shape_type == BULLET_OBJECT_BOUNDS_ENTIRE_OBJECT) {
+        result->mHalfExtents = btVector3(
+            fabs(diff.x/2) / mesh_rad, fabs(diff.y/2) / mesh_rad, fabs(diff.z/2) / mesh_rad
+        );
+        return result;
+    }
+
+    // The rest of the modes require working with the actual mesh. Currently
+    // there are two options. If the object is static, we can use the full mesh
+    // (a BVH). If it's dynamic, we need to simplify to a convex hull.
+    //
+    // We *can't* collide to btBvhTriangleMeshShapes, which is why we need to
+    // use convex hulls. For bullet that would be too expensive.
+    assert(shape_type == BULLET_OBJECT_BOUNDS_PER_TRIANGLE);
+
+    // The raw mesh data is scaled down to unit size. Objects scale it back up
+    // to their requested size when they instantiate the shape.
+    Matrix4x4f scale_to_unit = Matrix4x4f::scale(1.f/mesh_rad);
+    Meshdata::GeometryInstanceIterator geoIter = retrievedMesh->getGeometryInstanceIterator();
+    //we need to pass the triangles to Bullet
+    btTriangleMesh * meshToConstruct = new btTriangleMesh(false, false);
+    //loop through the instances, applying the transformations to vertices and
+    //adding them to the Bullet mesh
+    uint32 indexInstance;
+    Matrix4x4f transformInstance;
+    while(geoIter.next(&indexInstance, &transformInstance)) {
+        // Note: Scale to unit *after* transforming the
+        // instanced geometry to its location --
+        // scale_to_unit is applied to the mesh as a whole!
+        transformInstance = scale_to_unit * transformInstance;
+        GeometryInstance* geoInst = &(retrievedMesh->instances[indexInstance]);
+
+        unsigned int geoIndx = geoInst->geometryIndex;
+        SubMeshGeometry* subGeom = &(retrievedMesh->geometry[geoIndx]);
+        std::vector<Vector3f> gVertices;
+        gVertices.reserve(subGeom->positions.size());
+        for(unsigned int j=0; j < subGeom->positions.size(); j++)
+            gVertices.push_back(transformInstance * subGeom->positions[j]);
+
+        for(unsigned int i = 0; i < subGeom->primitives.size(); i++) {
+            const std::vector<unsigned short>& gIndices = subGeom->primitives[i].indices;
+            // Note the condition on the loop. Sometimes we get lists with weird
+            // setups, e.g. only 2 indices, so we need to make sure all 3 indices
+            // we'll use are in range.
+            for(unsigned int j=0; j+2 < gIndices.size(); j+=3) {
+                meshToConstruct->addTriangle(
+                    btVector3( gVertices[gIndices[j]].x, gVertices[gIndices[j]].y, gVertices[gIndices[j]].z ),
+                    btVector3( gVertices[gIndices[j+1]].x, gVertices[gIndices[j+1]].y, gVertices[gIndices[j+1]].z ),
+                    btVector3( gVertices[gIndices[j+2]].x, gVertices[gIndices[j+2]].y, gVertices[gIndices[j+2]].z )
+                );
+            }
+        }
+    }
+    BULLETLOG(detailed, "total bounds: " << bbox);
+    BULLETLOG(detailed, "bounds radius: " << mesh_rad);
+    BULLETLOG(detailed, "Num of triangles in mesh: " << meshToConstruct->getNumTriangles());
+
+    if (!convex) {
+        result->mTriangles = meshToConstruct;
+        result->mBvh = new btBvhTriangleMeshShape(meshToConstruct, true);
+        return result;
+    }
+
+    btConvexShape* tmpConvexShape = new btConvexTriangleMeshShape(meshToConstruct);
+
+    BULLETLOG(detailed, "Building simplified convex hull for dynamic per-triangle collisions");
+    BULLETLOG(detailed, " original numTriangles = " << meshToConstruct->getNumTriangles());
+
+    //create a hull approximation
+    btShapeHull* hull = new btShapeHull(tmpConvexShape);
+    btScalar margin = tmpConvexShape->getMargin();
+    hull->buildHull(margin);
+
+    BULLETLOG(detailed, " new numTriangles = " << hull->numTriangles());
+    BULLETLOG(detailed, " new numVertices = " << hull->numVertices());
+
+    result->mHullPoints.assign(hull->getVertexPointer(), hull->getVertexPointer() + hull->numVertices());
+
+    delete hull;
+    delete tmpConvexShape;
+    delete meshToConstruct;
+
+    return result;
+}
+
+btCollisionShape* MeshCollisionShape::instantiate(float32 radius) const {
+    btVector3 scale(radius, radius, radius);
+    switch(mShapeType) {
+      case BULLET_OBJECT_BOUNDS_ENTIRE_OBJECT:
+        BULLETLOG(detailed, "bbox half extents: " << mHalfExtents.x()*radius << ", " << mHalfExtents.y()*radius << ", " << mHalfExtents.z()*radius);
+        return new btBoxShape(mHalfExtents * radius);
+      case BULLET_OBJECT_BOUNDS_PER_TRIANGLE:
+        if (mBvh != NULL)
+            return new btScaledBvhTriangleMeshShape(mBvh, scale);
+        else {
+            btConvexHullShape* shape = new btConvexHullShape(
+                mHullPoints.empty() ? NULL : &(mHullPoints[0].x()), mHullPoints.size(), sizeof(btVector3)
+            );
+            shape->setLocalScaling(scale);
+            return shape;
+        }
+      default:
+        assert(false && "Unhandled bounds type when instantiating collision shape");
+        return NULL;
+    }
+}
+
+size_t MeshCollisionShape::size() const {
+    size_t result = sizeof(MeshCollisionShape);
+    if (mTriangles != NULL) {
+        // Non-indexed vertices, 16-bit indices and roughly two BVH nodes per
+        // triangle
+        result += mTriangles->getNumTriangles() *
+            (3 * 3 * sizeof(btScalar) + 3 * sizeof(unsigned short) + 2 * sizeof(btQuantizedBvhNode));
+    }
+    result += mHullPoints.size() * sizeof(btVector3);
+    return result;
+}
+
+
+
+CollisionShapeCache::Key::Key(const String& _mesh, bulletObjBBox _shape_type, bool _convex)
+ : mesh(_mesh),
+   shape_type(_shape_type),
+   // Only per-triangle shapes differ between static and dynamic objects
+   convex(_shape_type == BULLET_OBJECT_BOUNDS_PER_TRIANGLE && _convex)
+{
+}
+
+bool CollisionShapeCache::Key::operator<(const Key& rhs) const {
+    if (shape_type != rhs.shape_type) return shape_type < rhs.shape_type;
+    if (convex != rhs.convex) return convex < rhs.convex;
+    return mesh < rhs.mesh;
+}
+
+CollisionShapeCache::CollisionShapeCache()
+ : mHits(0),
+   mMisses(0),
+   mInsertsSinceCollect(0)
+{
+}
+
+MeshCollisionShapePtr CollisionShapeCache::get(const Key& key) {
+    ShapeMap::iterator it = mShapes.find(key);
+    MeshCollisionShapePtr result;
+    if (it != mShapes.end())
+        result = it->second.lock();
+    if (result)
+        mHits++;
+    else
+        mMisses++;
+    return result;
+}
+
+void CollisionShapeCache::insert(const Key& key, MeshCollisionShapePtr shape) {
+    mShapes[key] = shape;
+    if (++mInsertsSinceCollect >= 64)
+        collect();
+}
+
+void CollisionShapeCache::collect() {
+    mInsertsSinceCollect = 0;
+    for(ShapeMap::iterator it = mShapes.begin(); it != mShapes.end(); ) {
+        if (it->second.expired())
+            mShapes.erase(it++);
+        else
+            it++;
+    }
+}
+
+uint32 CollisionShapeCache::entries() {
+    collect();
+    return mShapes.size();
+}
+
+size_t CollisionShapeCache::size() {
+    size_t result = 0;
+    for(ShapeMap::iterator it = mShapes.begin(); it != mShapes.end(); it++) {
+        MeshCollisionShapePtr shape = it->second.lock();
+        if (shape) result += shape->size();
+    }
+    return result;
+}
+
+size_t CollisionShapeCache::sizeSaved() {
+    size_t result = 0;
+    for(ShapeMap::iterator it = mShapes.begin(); it != mShapes.end(); it++) {
+        MeshCollisionShapePtr shape = it->second.lock();
+        // One reference is ours
+        if (shape && shape.use_count() > 2)
+            result += shape->size() * (shape.use_count() - 2);
+    }
+    return result;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,104 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_BULLET_PHYSICS_COLLISION_SHAPE_CACHE_HPP_
+#define _SIRIKATA_BULLET_PHYSICS_COLLISION_SHAPE_CACHE_HPP_
+
+#include "Defs.hpp"
+#include "btBulletDynamicsCommon.h"
+
+namespace Sirikata {
+
+/** Collision data computed from a mesh at unit scale. Building it is the
+ *  expensive part of setting up a mesh based shape (walking the mesh, building
+ *  a BVH or convex hull), so one is shared by every object using the same
+ *  mesh with the same kind of shape, and each object only instantiates a
+ *  cheap, scaled shape on top of it.
+ *
+ *  Building only touches the mesh, so it can be done off the main strand.
+ *  Everything else should happen on the main strand.
+ */
+class MeshCollisionShape {
+public:
+    /** Build the shared data for the given kind of shape. convex selects a
+     *  convex hull instead of a BVH for per-triangle shapes (dynamic objects
+     *  can't use BVHs) and is ignored otherwise. Never returns NULL.
+     */
+    static MeshCollisionShape* build(bulletObjBBox shape_type, bool convex, Mesh::MeshdataPtr mesh);
+
+    ~MeshCollisionShape();
+
+    /** Create a shape for an object with the given bounds radius. The caller
+     *  owns the result, but must also hold on to this MeshCollisionShape for
+     *  as long as the result is in use since it may refer to our data.
+     */
+    btCollisionShape* instantiate(float32 radius) const;
+
+    /// Approximate memory used by the shared data.
+    size_t size() const;
+
+private:
+    MeshCollisionShape(bulletObjBBox shape_type);
+
+    bulletObjBBox mShapeType;
+    // BULLET_OBJECT_BOUNDS_ENTIRE_OBJECT
+    btVector3 mHalfExtents;
+    // BULLET_OBJECT_BOUNDS_PER_TRIANGLE, static
+    btTriangleMesh* mTriangles;
+    btBvhTriangleMeshShape* mBvh;
+    // BULLET_OBJECT_BOUNDS_PER_TRIANGLE, dynamic
+    std::vector<btVector3> mHullPoints;
+}; // class MeshCollisionShape
+
+
+/** Tracks the MeshCollisionShapes that are currently in use so new objects
+ *  with the same mesh can share them. Entries are keyed by mesh URI and kind
+ *  of shape -- scale is applied per object, so it isn't part of the key. The
+ *  cache only holds weak references; a shape is freed once the last object
+ *  using it is unloaded.
+ */
+class CollisionShapeCache {
+public:
+    struct Key {
+        Key(const String& _mesh, bulletObjBBox _shape_type, bool _convex);
+
+        String mesh;
+        bulletObjBBox shape_type;
+        bool convex;
+
+        bool operator<(const Key& rhs) const;
+    };
+
+    CollisionShapeCache();
+
+    /// Get a live shape for the key, or an empty pointer if there isn't one.
+    MeshCollisionShapePtr get(const Key& key);
+    void insert(const Key& key, MeshCollisionShapePtr shape);
+
+    // Stats
+    uint32 entries();
+    uint64 hits() const { return mHits; }
+    uint64 misses() const { return mMisses; }
+    /// Memory used by live shapes.
+    size_t size();
+    /// Memory that would have been used if each object had built its own copy
+    /// of its shape, minus what's actually used.
+    size_t sizeSaved();
+
+private:
+    void collect();
+
+    typedef std::tr1::weak_ptr<MeshCollisionShape> MeshCollisionShapeWPtr;
+    typedef std::map<Key, MeshCollisionShapeWPtr> ShapeMap;
+    ShapeMap mShapes;
+
+    uint64 mHits;
+    uint64 mMisses;
+    // Expired entries are swept out every so many inserts.
+    uint32 mInsertsSinceCollect;
+}; // class CollisionShapeCache
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_BULLET_PHYSICS_COLLISION_SHAPE_CACHE_HPP_
@@ -18,6 +18,8 @@ namespace Sirikata {
 class SirikataMotionState;
 class BulletObject;
 class BulletPhysicsService;
+class MeshCollisionShape;
+typedef std::tr1::shared_ptr<MeshCollisionShape> MeshCollisionShapePtr;
 
 //FIXME Enums for manual treatment of objects and bboxes
 //IGNORE = Bullet shouldn't know about this object
@@ -32,6 +32,7 @@
 
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/space/LocationService.hpp>
+#include <sirikata/core/options/Options.hpp>
 
 #include "BulletPhysicsService.hpp"
 //#include "AlwaysLocationUpdatePolicy.hpp"
@@ -42,10 +43,23 @@ namespace Sirikata {
 
 static void InitPluginOptions() {
     //InitAlwaysLocationUpdatePolicyOptions();
+    Sirikata::InitializeClassOptions ico("space_bulletphysics", NULL,
+        new OptionValue("fixed-step", "16666us", Sirikata::OptionValueType<Duration>(), "Size of each internal physics simulation step. The simulation always advances in steps of this size, interpolating between them."),
+        new OptionValue("max-substeps", "10", Sirikata::OptionValueType<uint32>(), "Maximum number of internal steps to take per location service tick. If the server falls further behind than this, the extra time is dropped."),
+        new OptionValue("update-epsilon", "0.01", Sirikata::OptionValueType<float32>(), "Simulated motion is only published when the position differs from the one extrapolated from the last update by more than this distance (or the orientation changes enough). 0 publishes every change."),
+        new OptionValue("orientation-epsilon", "0.01", Sirikata::OptionValueType<float32>(), "Like update-epsilon, but for orientation, in radians."),
+        NULL);
 }
 
 static LocationService* createStandardLoc(SpaceContext* ctx, LocationUpdatePolicy* update_policy, const String& args) {
-    return new BulletPhysicsService(ctx, update_policy);
+    OptionSet* optionsSet = OptionSet::getOptions("space_bulletphysics", NULL);
+    optionsSet->parse(args);
+
+    Duration fixed_step = optionsSet->referenceOption("fixed-step")->as<Duration>();
+    uint32 max_substeps = optionsSet->referenceOption("max-substeps")->as<uint32>();
+    float32 update_epsilon = optionsSet->referenceOption("update-epsilon")->as<float32>();
+    float32 orientation_epsilon = optionsSet->referenceOption("orientation-epsilon")->as<float32>();
+    return new BulletPhysicsService(ctx, update_policy, fixed_step, max_substeps, update_epsilon, orientation_epsilon);
 }
 
 //static LocationUpdatePolicy* createAlwaysPolicy(const String& args) {
@@ -294,6 +294,17 @@ void CBRLocationServiceCache::localQueryDataUpdated(const UUID& uuid, bool agg,
     queryDataUpdated(uuid, agg, newval);
 }
 
+void CBRLocationServiceCache::localLocationsUpdated(const LocalLocationUpdateList& updates) {
+    // One post for the whole batch instead of two per object
+    mStrand->post(
+        std::tr1::bind(
+            &CBRLocationServiceCache::processLocationsUpdated, this,
+            updates
+        ),
+        "CBRLocationServiceCache::processLocationsUpdated"
+    );
+}
+
 void CBRLocationServiceCache::replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& phy, const String& query_data) {
     if (mWithReplicas)
       objectAdded(uuid, false, false, loc, orient, bounds, mesh, phy, query_data);
@@ -507,6 +518,34 @@ void CBRLocationServiceCache::processOrientationUpdated(const ObjectReference& u
     it->second.orientation = newval;
 }
 
+void CBRLocationServiceCache::processLocationsUpdated(const LocalLocationUpdateList& updates) {
+    // Apply everything under one lock, remembering old locations for the
+    // listeners
+    std::vector<TimedMotionVector3f> oldvals(updates.size());
+    std::vector<bool> found(updates.size(), false);
+    {
+        Lock lck(mDataMutex);
+
+        for(uint32 i = 0; i < updates.size(); i++) {
+            ObjectDataMap::iterator it = mObjects.find(ObjectReference(updates[i].uuid));
+            if (it == mObjects.end()) continue;
+
+            found[i] = true;
+            oldvals[i] = it->second.location;
+            it->second.location = updates[i].location;
+            it->second.orientation = updates[i].orientation;
+        }
+    }
+
+    Lock lck(mListenerMutex);
+    for(uint32 i = 0; i < updates.size(); i++) {
+        if (!found[i] || updates[i].agg) continue;
+        ObjectReference uuid(updates[i].uuid);
+        for(ListenerSet::iterator it = mListeners.begin(); it != mListeners.end(); it++)
+            (*it)->locationPositionUpdated(uuid, oldvals[i], updates[i].location);
+    }
+}
+
 void CBRLocationServiceCache::boundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval) {
     mStrand->post(
         std::tr1::bind(
@@ -116,6 +116,7 @@ public:
     virtual void localMeshUpdated(const UUID& uuid, bool agg, const String& newval);
     virtual void localPhysicsUpdated(const UUID& uuid, bool agg, const String& newval);
     virtual void localQueryDataUpdated(const UUID& uuid, bool agg, const String& newval);
+    virtual void localLocationsUpdated(const LocalLocationUpdateList& updates);
     virtual void replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& query_data);
     virtual LocationServiceListener::RemovalStatus replicaObjectRemoved(const UUID& uuid);
     virtual void replicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval);
@@ -167,6 +168,7 @@ private:
     void processObjectRemoved(const ObjectReference& uuid, bool agg, bool trigger_removal_event, std::tr1::function<void()>&callback);
     void processLocationUpdated(const ObjectReference& uuid, bool agg, const TimedMotionVector3f& newval);
     void processOrientationUpdated(const ObjectReference& uuid, bool agg, const TimedMotionQuaternion& newval);
+    void processLocationsUpdated(const LocalLocationUpdateList& updates);
     void processBoundsUpdated(const ObjectReference& uuid, bool agg, const AggregateBoundingInfo& newval);
     void processMeshUpdated(const ObjectReference& uuid, bool agg, const String& newval);
     void processPhysicsUpdated(const ObjectReference& uuid, bool agg, const String& newval);
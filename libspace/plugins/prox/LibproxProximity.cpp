@@ -39,6 +39,8 @@
 #include <sirikata/pintoloc/QueryHandlerFactory.hpp>
 
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/ohdp/SST.hpp>
+#include <sirikata/core/util/Timer.hpp>
 
 #include "Protocol_Prox.pbj.hpp"
 #include "Protocol_ServerProx.pbj.hpp"
@@ -84,6 +86,7 @@ LibproxProximity::LibproxProximity(SpaceContext* ctx, LocationService* locservic
    mDistanceQueryDistance(0.f),
    mMinObjectQueryAngle(SolidAngle::Max),
    mMaxMaxCount(1),
+   mObjectHostResultsEnabled(GetOptionValue<bool>(OPT_PROX_OBJECT_HOST_RESULTS)),
    mServerQueries(),
    mServerDistance(false),
    mServerHandlerPoller(mProxStrand, std::tr1::bind(&LibproxProximity::tickQueryHandler, this, mServerQueryHandler), "LibproxProximity ServerHandler Poll", Duration::milliseconds((int64)100)),
@@ -92,7 +95,8 @@ LibproxProximity::LibproxProximity(SpaceContext* ctx, LocationService* locservic
    mObjectDistance(false),
    mObjectHandlerPoller(mProxStrand, std::tr1::bind(&LibproxProximity::tickQueryHandler, this, mObjectQueryHandler), "LibproxProximity ObjectHandler Poll", Duration::milliseconds((int64)100)),
    mStaticRebuilderPoller(mProxStrand, std::tr1::bind(&LibproxProximity::rebuildHandler, this, OBJECT_CLASS_STATIC), "LibproxProximity Static Rebuilder Poll", Duration::seconds(172800.f)),
-   mDynamicRebuilderPoller(mProxStrand, std::tr1::bind(&LibproxProximity::rebuildHandler, this, OBJECT_CLASS_DYNAMIC), "LibproxProximity Dynamic Rebuilder Poll", Duration::seconds(172800.f))
+   mDynamicRebuilderPoller(mProxStrand, std::tr1::bind(&LibproxProximity::rebuildHandler, this, OBJECT_CLASS_DYNAMIC), "LibproxProximity Dynamic Rebuilder Poll", Duration::seconds(172800.f)),
+   mObjectHostResultsFlushScheduled(false)
 {
     using std::tr1::placeholders::_1;
     using std::tr1::placeholders::_2;
@@ -149,6 +153,8 @@ LibproxProximity::~LibproxProximity() {
         delete mObjectQueryHandler[i].handler;
         delete mServerQueryHandler[i].handler;
     }
+    for(ObjectHostResultsMap::iterator it = mObjectHostResultBatches.begin(); it != mObjectHostResultBatches.end(); it++)
+        delete it->second;
 }
 
 
@@ -246,6 +252,42 @@ void LibproxProximity::sessionClosed(ObjectSession* session) {
 }
 
 
+// ObjectHostSessionListener Interface
+
+void LibproxProximity::onObjectHostSession(const OHDP::NodeID& id, ObjectHostSessionPtr oh_sess) {
+    using std::tr1::placeholders::_1;
+    using std::tr1::placeholders::_2;
+
+    if (!mObjectHostResultsEnabled) return;
+
+    // Object hosts that can handle batched results for their objects open a
+    // proximity substream. We only ever send on it.
+    oh_sess->stream()->listenSubstream(
+        OBJECT_PORT_PROXIMITY,
+        std::tr1::bind(&LibproxProximity::handleObjectHostSubstream, this, _1, _2)
+    );
+}
+
+void LibproxProximity::handleObjectHostSubstream(int success, OHDPSST::Stream::Ptr substream) {
+    if (success != SST_IMPL_SUCCESS) return;
+
+    OHDP::NodeID node = substream->remoteEndPoint().endPoint.node();
+    // Only one substream per session, ignore any extras
+    if (mObjectHostProxStreams.find(node) != mObjectHostProxStreams.end()) return;
+
+    PROXLOG(detailed, "Sending batched object query results to object host " << node);
+    addObjectHostProxStreamInfo(substream);
+}
+
+void LibproxProximity::onObjectHostSessionEnded(const OHDP::NodeID& id) {
+    ObjectHostProxStreamMap::iterator prox_stream_it = mObjectHostProxStreams.find(id);
+    if (prox_stream_it != mObjectHostProxStreams.end()) {
+        prox_stream_it->second->disable();
+        mObjectHostProxStreams.erase(prox_stream_it);
+    }
+}
+
+
 void LibproxProximity::handleObjectProximityMessage(const UUID& objid, void* buffer, uint32 length) {
     Sirikata::Protocol::Prox::QueryRequest prox_update;
     bool parse_success = prox_update.ParseFromString( String((char*) buffer, length) );
@@ -566,11 +608,18 @@ void LibproxProximity::addQuery(UUID obj, const String& params) {
 }
 
 void LibproxProximity::updateQuery(UUID obj, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, SolidAngle sa, uint32 max_results) {
-    SeqNoPtr obj_seqno = mContext->objectSessionManager()->getSession(ObjectReference(obj))->getSeqNoPtr();
+    ObjectSession* session = mContext->objectSessionManager()->getSession(ObjectReference(obj));
+    SeqNoPtr obj_seqno = session->getSeqNoPtr();
+    // Results are batched if the object host asked for them. This is only
+    // used by the prox thread when the query is created, so each query sticks
+    // with one way of getting results.
+    OHDP::NodeID obj_oh = OHDP::NodeID::null();
+    if (mObjectHostProxStreams.find(session->objectHost()) != mObjectHostProxStreams.end())
+        obj_oh = session->objectHost();
 
     // Update the prox thread
     mProxStrand->post(
-        std::tr1::bind(&LibproxProximity::handleUpdateObjectQuery, this, obj, loc, bounds, sa, max_results, obj_seqno),
+        std::tr1::bind(&LibproxProximity::handleUpdateObjectQuery, this, obj, loc, bounds, sa, max_results, obj_seqno, obj_oh),
         "LibproxProximity::handleUpdateObjectQuery"
     );
 
@@ -675,6 +724,16 @@ void LibproxProximity::poll() {
         delete msg_front;
         mObjectResultsToSend.pop_front();
     }
+
+    // And batched results for object hosts. If the object host has
+    // disconnected, so have its objects and the results can be dropped.
+    std::deque<ObjectHostResult> oh_results;
+    mObjectHostResults.swap(oh_results);
+    for(std::deque<ObjectHostResult>::iterator it = oh_results.begin(); it != oh_results.end(); it++) {
+        if (mObjectHostProxStreams.find(it->first) != mObjectHostProxStreams.end())
+            sendObjectHostResult(it->first, it->second);
+        delete it->second;
+    }
 }
 
 
@@ -1154,6 +1213,15 @@ void LibproxProximity::generateObjectQueryEvents(Query* query, bool do_first) {
         mObjectQueriesFirstIteration.erase(query);
     }
 
+    Time encode_start = Timer::now();
+
+    QuerierObjectHostMap::iterator oh_it = mQuerierObjectHosts.find(query_id);
+    if (oh_it != mQuerierObjectHosts.end()) {
+        addObjectHostQueryEvents(oh_it->second, query_id, seqNoPtr, evts);
+        mStats.objectResultsTime += (Timer::now() - encode_start).toMicroseconds();
+        return;
+    }
+
     while(!evts.empty()) {
         Sirikata::Protocol::Prox::ProximityResults prox_results;
         prox_results.set_t(mContext->simTime());
@@ -1172,45 +1240,13 @@ void LibproxProximity::generateObjectQueryEvents(Query* query, bool do_first) {
                 mLocService->subscribe(query_id, objid);
 
                 Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
-                addition.set_object( objid );
+                describeObject(addition, oobjid);
 
                 //query_id contains the uuid of the object that is receiving
                 //the proximity message that obj_id has been added.
                 uint64 seqNo = (*seqNoPtr)++;
                 addition.set_seqno (seqNo);
-
-                if (mLocCache->isAggregate(oobjid)) {
-                    addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Aggregate);
-                }
-                else {
-                    addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Object);
-                }
-
-                Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
-                TimedMotionVector3f loc = mLocCache->location(oobjid);
-                motion.set_t(loc.updateTime());
-                motion.set_position(loc.position());
-                motion.set_velocity(loc.velocity());
-
-                TimedMotionQuaternion orient = mLocCache->orientation(oobjid);
-                Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
-                msg_orient.set_t(orient.updateTime());
-                msg_orient.set_position(orient.position());
-                msg_orient.set_velocity(orient.velocity());
-
-                Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
-                AggregateBoundingInfo bnds = mLocCache->bounds(oobjid);
-                msg_bounds.set_center_offset(bnds.centerOffset);
-                msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
-                msg_bounds.set_max_object_size(bnds.maxObjectRadius);
-
-                String mesh = mLocCache->mesh(oobjid).toString();
-                if (mesh.size() > 0)
-                    addition.set_mesh(mesh);
-                const String& phy = mLocCache->physics(oobjid);
-                if (phy.size() > 0)
-                    addition.set_physics(phy);
-                // Do not include query_data for results going to objects
+                mStats.objectDescriptions++;
             }
             for(uint32 pidx = 0; pidx < evt.reparents().size(); pidx++) {
                 Sirikata::Protocol::Prox::INodeReparent reparent = event_results.add_reparent();
@@ -1254,6 +1290,143 @@ void LibproxProximity::generateObjectQueryEvents(Query* query, bool do_first) {
         );
         mObjectResults.push(obj_msg);
     }
+
+    mStats.objectResultsTime += (Timer::now() - encode_start).toMicroseconds();
+}
+
+void LibproxProximity::describeObject(Sirikata::Protocol::Prox::IObjectAddition addition, const ObjectReference& oobjid) {
+    addition.set_object( oobjid.getAsUUID() );
+
+    if (mLocCache->isAggregate(oobjid)) {
+        addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Aggregate);
+    }
+    else {
+        addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Object);
+    }
+
+    Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+    TimedMotionVector3f loc = mLocCache->location(oobjid);
+    motion.set_t(loc.updateTime());
+    motion.set_position(loc.position());
+    motion.set_velocity(loc.velocity());
+
+    TimedMotionQuaternion orient = mLocCache->orientation(oobjid);
+    Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+    msg_orient.set_t(orient.updateTime());
+    msg_orient.set_position(orient.position());
+    msg_orient.set_velocity(orient.velocity());
+
+    Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
+    AggregateBoundingInfo bnds = mLocCache->bounds(oobjid);
+    msg_bounds.set_center_offset(bnds.centerOffset);
+    msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
+    msg_bounds.set_max_object_size(bnds.maxObjectRadius);
+
+    String mesh = mLocCache->mesh(oobjid).toString();
+    if (mesh.size() > 0)
+        addition.set_mesh(mesh);
+    const String& phy = mLocCache->physics(oobjid);
+    if (phy.size() > 0)
+        addition.set_physics(phy);
+    // Do not include query_data for results going to objects
+}
+
+void LibproxProximity::addObjectHostQueryEvents(const OHDP::NodeID& oh, const UUID& query_id, SeqNoPtr seqNoPtr, QueryEventList& evts) {
+    ObjectHostResults*& results = mObjectHostResultBatches[oh];
+    if (results == NULL) {
+        results = new ObjectHostResults();
+        results->msg.set_t(mContext->simTime());
+    }
+
+    // Everything generated during this tick goes into the same batch, so
+    // just make sure we send it once the tick finishes.
+    if (!mObjectHostResultsFlushScheduled) {
+        mObjectHostResultsFlushScheduled = true;
+        mProxStrand->post(
+            std::tr1::bind(&LibproxProximity::flushObjectHostResults, this),
+            "LibproxProximity::flushObjectHostResults"
+        );
+    }
+
+    while(!evts.empty()) {
+        const QueryEvent& evt = evts.front();
+        Sirikata::Protocol::Prox::IQuerierUpdate update = results->msg.add_update();
+        update.set_querier(query_id);
+
+        uint64 last_seqno = 0;
+        for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
+            ObjectReference oobjid = evt.additions()[aidx].id();
+            UUID objid = oobjid.getAsUUID();
+            assert(mLocCache->tracking(oobjid));
+
+            mLocService->subscribe(query_id, objid);
+
+            // Each object is only described once per batch
+            std::tr1::unordered_map<UUID, uint32, UUID::Hasher>::iterator obj_it = results->objects.find(objid);
+            if (obj_it == results->objects.end()) {
+                obj_it = results->objects.insert( std::make_pair(objid, (uint32)results->msg.object_size()) ).first;
+                Sirikata::Protocol::Prox::IObjectAddition addition = results->msg.add_object();
+                describeObject(addition, oobjid);
+                addition.set_seqno(0);
+                mStats.objectDescriptions++;
+            }
+            else {
+                mStats.objectDescriptionsShared++;
+            }
+            update.add_addition(obj_it->second);
+
+            uint64 seqNo = (*seqNoPtr)++;
+            update.add_addition_seqno(aidx == 0 ? seqNo : seqNo - last_seqno);
+            last_seqno = seqNo;
+        }
+        for(uint32 pidx = 0; pidx < evt.reparents().size(); pidx++) {
+            Sirikata::Protocol::Prox::INodeReparent reparent = update.add_reparent();
+            reparent.set_object( evt.reparents()[pidx].id().getAsUUID() );
+            uint64 seqNo = (*seqNoPtr)++;
+            reparent.set_seqno (seqNo);
+            reparent.set_old_parent(evt.reparents()[pidx].oldParent().getAsUUID());
+            reparent.set_new_parent(evt.reparents()[pidx].newParent().getAsUUID());
+            reparent.set_type(
+                (evt.reparents()[pidx].type() == QueryEvent::Normal) ?
+                Sirikata::Protocol::Prox::NodeReparent::Object :
+                Sirikata::Protocol::Prox::NodeReparent::Aggregate
+            );
+        }
+        for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
+            ObjectReference oobjid = evt.removals()[ridx].id();
+            UUID objid = oobjid.getAsUUID();
+            mLocService->unsubscribe(query_id, objid);
+
+            Sirikata::Protocol::Prox::IObjectRemoval removal = update.add_removal();
+            removal.set_object( objid );
+            uint64 seqNo = (*seqNoPtr)++;
+            removal.set_seqno (seqNo);
+            removal.set_type(
+                (evt.removals()[ridx].permanent() == QueryEvent::Permanent)
+                ? Sirikata::Protocol::Prox::ObjectRemoval::Permanent
+                : Sirikata::Protocol::Prox::ObjectRemoval::Transient
+            );
+        }
+        evts.pop_front();
+    }
+}
+
+void LibproxProximity::flushObjectHostResults() {
+    mObjectHostResultsFlushScheduled = false;
+
+    Time encode_start = Timer::now();
+    for(ObjectHostResultsMap::iterator it = mObjectHostResultBatches.begin(); it != mObjectHostResultBatches.end(); it++) {
+        Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
+            mContext->id(),
+            UUID::null(), OBJECT_PORT_PROXIMITY,
+            UUID::null(), OBJECT_PORT_PROXIMITY,
+            serializePBJMessage(it->second->msg)
+        );
+        mObjectHostResults.push(ObjectHostResult(it->first, obj_msg));
+        delete it->second;
+    }
+    mObjectHostResultBatches.clear();
+    mStats.objectResultsTime += (Timer::now() - encode_start).toMicroseconds();
 }
 
 
@@ -1387,7 +1560,7 @@ void LibproxProximity::handleDisconnectedServer(ServerID sid) {
         mLocService->removeReplicaObject(t, *it);
 }
 
-void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno) {
+void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno, const OHDP::NodeID& oh) {
     BoundingSphere3f region(bounds.center(), 0);
     float ms = bounds.radius();
 
@@ -1404,6 +1577,8 @@ void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMo
         if (!explicit_query_params_update) return;
 
         mObjectSeqNos.insert( ObjectSeqNoInfoMap::value_type(object, seqno) );
+        if (oh != OHDP::NodeID::null())
+            mQuerierObjectHosts[object] = oh;
     }
 
     // Log, but only if this isn't just due to object movement
@@ -1471,6 +1646,7 @@ void LibproxProximity::handleRemoveObjectQuery(const UUID& object, bool notify_m
 
     // Clear out sequence numbers
     eraseSeqNoInfo(object);
+    mQuerierObjectHosts.erase(object);
 
     // Optionally let the main thread know to clear its communication state
     if (notify_main_thread) {
@@ -40,6 +40,8 @@
 
 #include <sirikata/core/queue/ThreadSafeQueue.hpp>
 
+#include "Protocol_ObjectHostProx.pbj.hpp"
+
 namespace Sirikata {
 
 class ProximityInputEvent;
@@ -70,6 +72,10 @@ public:
     virtual void newSession(ObjectSession* session);
     virtual void sessionClosed(ObjectSession* session);
 
+    // ObjectHostSessionListener Interface
+    virtual void onObjectHostSession(const OHDP::NodeID& id, ObjectHostSessionPtr oh_sess);
+    virtual void onObjectHostSessionEnded(const OHDP::NodeID& id);
+
     // Objects
     virtual void addQuery(UUID obj, SolidAngle sa, uint32 max_results);
     virtual void addQuery(UUID obj, const String& params);
@@ -117,6 +123,9 @@ private:
     typedef std::tr1::unordered_set<ServerID> ServerSet;
 
     void handleObjectProximityMessage(const UUID& objid, void* buffer, uint32 length);
+    // Object hosts open a proximity substream to request batched results for
+    // their objects, see OPT_PROX_OBJECT_HOST_RESULTS
+    void handleObjectHostSubstream(int success, OHDPSST::Stream::Ptr substream);
 
     // BOTH Threads - uses thread safe data
 
@@ -162,13 +171,19 @@ private:
     virtual void handleConnectedServer(ServerID server);
     virtual void handleDisconnectedServer(ServerID server);
 
-    void handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno);
+    void handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno, const OHDP::NodeID& oh);
     void handleRemoveObjectQuery(const UUID& object, bool notify_main_thread, const std::tr1::function<void()>&callback);
     void handleDisconnectedObject(const UUID& object);
 
     // Generate query events based on results collected from query handlers
     void generateServerQueryEvents(Query* query);
     void generateObjectQueryEvents(Query* query, bool do_first=false);
+    // Fill in the description of an object for an addition
+    void describeObject(Sirikata::Protocol::Prox::IObjectAddition addition, const ObjectReference& objid);
+    // Add events for a querier to its object host's batch of results
+    void addObjectHostQueryEvents(const OHDP::NodeID& oh, const UUID& query_id, SeqNoPtr seqNoPtr, QueryEventList& evts);
+    // Ship all the batches of results collected since the last flush
+    void flushObjectHostResults();
 
     // Decides whether a query handler should handle a particular object.
     bool handlerShouldHandleObject(bool is_static_handler, bool is_global_handler, const ObjectReference& obj_id, bool local, bool aggregate, const TimedMotionVector3f& pos, const BoundingSphere3f& region, float maxSize);
@@ -242,6 +257,9 @@ private:
     std::deque<Message*> mServerResultsToSend; // server query results waiting to be sent
     std::deque<Sirikata::Protocol::Object::ObjectMessage*> mObjectResultsToSend; // object query results waiting to be sent
 
+    // Whether object hosts may request batched results for their objects
+    bool mObjectHostResultsEnabled;
+
 
 
     // PROX Thread - Should only be accessed in methods used by the prox thread
@@ -303,10 +321,27 @@ private:
     typedef std::tr1::unordered_map<UUID, SeqNoPtr, UUID::Hasher> ObjectSeqNoInfoMap;
     ObjectSeqNoInfoMap mObjectSeqNos;
 
+    // Object hosts of queriers whose results are batched per object host
+    typedef std::tr1::unordered_map<UUID, OHDP::NodeID, UUID::Hasher> QuerierObjectHostMap;
+    QuerierObjectHostMap mQuerierObjectHosts;
+    // Batched results for each object host, collected until the end of the
+    // current tick so every querier on the object host shares the same object
+    // descriptions.
+    struct ObjectHostResults {
+        Sirikata::Protocol::Prox::ObjectHostProximityResults msg;
+        // Index of each object's description in msg
+        std::tr1::unordered_map<UUID, uint32, UUID::Hasher> objects;
+    };
+    typedef std::tr1::unordered_map<OHDP::NodeID, ObjectHostResults*, OHDP::NodeID::Hasher> ObjectHostResultsMap;
+    ObjectHostResultsMap mObjectHostResultBatches;
+    bool mObjectHostResultsFlushScheduled;
+
 
     // Threads: Thread-safe data used for exchange between threads
     Sirikata::ThreadSafeQueue<Message*> mServerResults; // server query results that need to be sent
     Sirikata::ThreadSafeQueue<Sirikata::Protocol::Object::ObjectMessage*> mObjectResults; // object query results that need to be sent
+    typedef std::pair<OHDP::NodeID, Sirikata::Protocol::Object::ObjectMessage*> ObjectHostResult;
+    Sirikata::ThreadSafeQueue<ObjectHostResult> mObjectHostResults; // batched object query results that need to be sent
 
 }; //class LibproxProximity
 
@@ -746,6 +746,10 @@ void LibproxProximityBase::commandStats(const Command::Command& cmd, Command::Co
     result.put("stats.space.received.bytes", mStats.spaceReceivedBytes.read());
     result.put("stats.space.received.messages", mStats.spaceReceivedMessages.read());
 
+    result.put("stats.object.results.time_us", mStats.objectResultsTime.read());
+    result.put("stats.object.results.descriptions", mStats.objectDescriptions.read());
+    result.put("stats.object.results.shared_descriptions", mStats.objectDescriptionsShared.read());
+
     cmdr->result(cmdid, result);
 }
 
@@ -78,7 +78,10 @@ protected:
            spaceSentBytes(0),
            spaceSentMessages(0),
            spaceReceivedBytes(0),
-           spaceReceivedMessages(0)
+           spaceReceivedMessages(0),
+           objectResultsTime(0),
+           objectDescriptions(0),
+           objectDescriptionsShared(0)
         {}
 
         // Total number of bytes sent to objects
@@ -107,6 +110,14 @@ protected:
         AtomicValue<uint32> spaceReceivedBytes;
         // Total messages received from other space servers
         AtomicValue<uint32> spaceReceivedMessages;
+
+        // Time spent encoding results for object queries, in microseconds
+        AtomicValue<uint64> objectResultsTime;
+        // Descriptions of added objects encoded in results for object queries
+        AtomicValue<uint32> objectDescriptions;
+        // Additions that reused a description already in an object host's
+        // batch of results instead of encoding a new one
+        AtomicValue<uint32> objectDescriptionsShared;
     };
     Stats mStats;
 
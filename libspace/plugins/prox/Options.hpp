@@ -11,6 +11,7 @@
 #define PROX_MAX_PER_RESULT        "prox.max-per-result"
 #define OPT_PROX_SPLIT_DYNAMIC     "prox.split-dynamic"
 #define OPT_PROX_COALESCE_FIRST    "prox.coalesce-first"
+#define OPT_PROX_OBJECT_HOST_RESULTS "prox.object-host-results"
 
 #define OPT_PROX_SERVER_QUERY_HANDLER_TYPE         "prox.server.handler"
 #define OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS      "prox.server.handler-options"
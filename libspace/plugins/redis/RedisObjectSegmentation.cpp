@@ -656,6 +656,17 @@ void RedisObjectSegmentation::addNewObject(const UUID& obj_id, float radius) {
     }
 }
 
+void RedisObjectSegmentation::addNewObjects(const NewObjectList& objs) {
+    if (mStopping) return;
+
+    // Holding the (recursive) lock across the whole batch keeps the write
+    // handler from flushing partway through, so hiredis buffers every command
+    // and sends them as one pipelined write.
+    Lock lck(mMutex);
+    for(NewObjectList::const_iterator it = objs.begin(); it != objs.end(); it++)
+        addNewObject(it->first, it->second);
+}
+
 void RedisObjectSegmentation::finishWriteNewObject(const UUID& obj_id, OSegWriteListener::OSegAddNewStatus status)
 {
     REDISOSEG_LOG(detailed, "Finished writing OSEG entry for object "\
@@ -57,6 +57,7 @@ public:
     virtual OSegEntry lookup(const UUID& obj_id);
 
     virtual void addNewObject(const UUID& obj_id, float radius);
+    virtual void addNewObjects(const NewObjectList& objs);
     virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool);
     virtual void removeObject(const UUID& obj_id);
 
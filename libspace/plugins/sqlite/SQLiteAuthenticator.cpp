@@ -123,6 +123,95 @@ void SQLiteAuthenticator::respond(Callback cb, bool result) {
     );
 }
 
+void SQLiteAuthenticator::respondBatch(const ResponseList& responses) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&SQLiteAuthenticator::dispatchResponses, responses),
+        "SQLiteAuthenticator::respondBatch"
+    );
+}
+
+void SQLiteAuthenticator::dispatchResponses(const ResponseList& responses) {
+    for(ResponseList::const_iterator it = responses.begin(); it != responses.end(); it++)
+        it->first(it->second);
+}
+
+bool SQLiteAuthenticator::stepTicketStatement(sqlite3_stmt* stmt, const String& ticket) {
+    bool found_row = false;
+
+    int rc = sqlite3_bind_text(stmt, 1, ticket.data(), (int)ticket.size(), SQLITE_TRANSIENT);
+    checkSQLiteError(rc, "Error binding key name to batched statement");
+    if (rc == SQLITE_OK) {
+        int step_rc = sqlite3_step(stmt);
+        while(step_rc == SQLITE_ROW) {
+            found_row = true;
+            step_rc = sqlite3_step(stmt);
+        }
+    }
+
+    // Always reset so the statement can be reused for the next ticket
+    rc = sqlite3_reset(stmt);
+    checkSQLiteError(rc, "Error resetting batched statement");
+    sqlite3_clear_bindings(stmt);
+
+    return found_row;
+}
+
+void SQLiteAuthenticator::authenticateBatch(const RequestBatch& reqs) {
+    ResponseList responses;
+    responses.reserve(reqs.size());
+
+    if (!mDB) {
+        for(RequestBatch::const_iterator it = reqs.begin(); it != reqs.end(); it++)
+            responses.push_back(std::make_pair(it->cb, false));
+        respondBatch(responses);
+        return;
+    }
+
+    int rc;
+    char* remain;
+    sqlite3_stmt* select_stmt = NULL;
+    sqlite3_stmt* delete_stmt = NULL;
+    rc = sqlite3_prepare_v2(mDB->db(), mDBGetSessionStmt.c_str(), -1, &select_stmt, (const char**)&remain);
+    bool prepared = !checkSQLiteError(rc, "Error preparing batched value query statement");
+    if (prepared) {
+        rc = sqlite3_prepare_v2(mDB->db(), mDBDeleteSessionStmt.c_str(), -1, &delete_stmt, (const char**)&remain);
+        prepared = !checkSQLiteError(rc, "Error preparing batched delete statement");
+    }
+
+    // One transaction for the whole batch so the deletes don't each pay for a
+    // journal sync.
+    bool in_transaction = false;
+    if (prepared) {
+        rc = sqlite3_exec(mDB->db(), "BEGIN TRANSACTION", NULL, NULL, NULL);
+        in_transaction = !checkSQLiteError(rc, "Error beginning batch transaction");
+    }
+
+    for(RequestBatch::const_iterator it = reqs.begin(); it != reqs.end(); it++) {
+        bool found_ticket = false;
+        if (prepared) {
+            found_ticket = stepTicketStatement(select_stmt, it->auth);
+            if (found_ticket) stepTicketStatement(delete_stmt, it->auth);
+        }
+        responses.push_back(std::make_pair(it->cb, found_ticket));
+    }
+
+    if (in_transaction) {
+        rc = sqlite3_exec(mDB->db(), "COMMIT TRANSACTION", NULL, NULL, NULL);
+        checkSQLiteError(rc, "Error committing batch transaction");
+    }
+
+    if (select_stmt != NULL) {
+        rc = sqlite3_finalize(select_stmt);
+        checkSQLiteError(rc, "Error finalizing batched value query statement");
+    }
+    if (delete_stmt != NULL) {
+        rc = sqlite3_finalize(delete_stmt);
+        checkSQLiteError(rc, "Error finalizing batched delete statement");
+    }
+
+    respondBatch(responses);
+}
+
 void SQLiteAuthenticator::authenticate(const UUID& obj_id, MemoryReference auth, Callback cb) {
     if (!mDB) {
         respond(cb, false);
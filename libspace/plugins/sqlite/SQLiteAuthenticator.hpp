@@ -47,6 +47,10 @@ public:
     virtual void stop();
 
     virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb);
+    // Checks the whole batch inside one transaction, reusing a single prepared
+    // select and delete statement, and delivers all results in one post to
+    // the main strand.
+    virtual void authenticateBatch(const RequestBatch& reqs);
 
 private:
     // Helper that checks and logs errors, then returns bool indicating
@@ -57,8 +61,14 @@ private:
     bool checkTicket(const String& ticket);
     // Delete a ticket from the db
     void deleteTicket(const String& ticket);
+    // Run a ticket through an already prepared statement, resetting it for
+    // the next use. Returns whether any rows were produced.
+    bool stepTicketStatement(sqlite3_stmt* stmt, const String& ticket);
     // Generate the response to the auth request
     void respond(Callback cb, bool result);
+    typedef std::vector< std::pair<Callback, bool> > ResponseList;
+    void respondBatch(const ResponseList& responses);
+    static void dispatchResponses(const ResponseList& responses);
 
     SpaceContext* mContext;
     String mDBFile;
@@ -37,13 +37,25 @@
 
 #include <sirikata/core/odp/SST.hpp>
 #include <sirikata/core/ohdp/SST.hpp>
+#include <sirikata/core/network/Frame.hpp>
 #include "Protocol_Frame.pbj.hpp"
 
 namespace Sirikata {
 
+namespace {
+// Attempts at opening a long-lived loc substream before we give up on it, and
+// the delay before the first retry, which doubles after each failure
+const uint8 MaxLocSubstreamAttempts = 5;
+const int64 LocSubstreamRetryMilliseconds = 50;
+}
+
 void InitAlwaysLocationUpdatePolicyOptions() {
     Sirikata::InitializeClassOptions ico(ALWAYS_POLICY_OPTIONS, NULL,
         new OptionValue(LOC_MAX_PER_RESULT, "5", Sirikata::OptionValueType<uint32>(), "Maximum number of loc updates to report in each result message."),
+        new OptionValue(LOC_CHANNEL, "stream", Sirikata::OptionValueType<String>(), "How loc updates are sent to objects and object hosts: 'stream' for one long-lived substream per subscriber, 'datagram' for unreliable datagrams where lost updates are superseded by later ones, or 'substream' for a new substream per message, as required by older clients."),
+        new OptionValue(LOC_ENCODING, "pbj", Sirikata::OptionValueType<String>(), "How loc updates are encoded when using the 'stream' channel: 'pbj' for plain BulkLocationUpdates or 'compact' for a stateful encoding that only sends changed properties, with quantized positions and velocities."),
+        new OptionValue(LOC_POSITION_PRECISION, "0.001", Sirikata::OptionValueType<float32>(), "Quantization step for positions in the compact encoding, in meters."),
+        new OptionValue(LOC_VELOCITY_PRECISION, "0.001", Sirikata::OptionValueType<float32>(), "Quantization step for velocities in the compact encoding, in meters per second."),
         NULL);
 }
 
@@ -68,6 +80,30 @@ AlwaysLocationUpdatePolicy::AlwaysLocationUpdatePolicy(SpaceContext* ctx, const
 {
     OptionSet* optionsSet = OptionSet::getOptions(ALWAYS_POLICY_OPTIONS,NULL);
     optionsSet->parse(args);
+
+    String channel = GetOptionValue<String>(ALWAYS_POLICY_OPTIONS, LOC_CHANNEL);
+    if (channel == "datagram")
+        mChannelMode = ChannelDatagram;
+    else if (channel == "substream")
+        mChannelMode = ChannelSubstream;
+    else {
+        if (channel != "stream")
+            SILOG(always_loc,error,"Unknown loc update channel " << channel << ", using stream.");
+        mChannelMode = ChannelStream;
+    }
+
+    String encoding = GetOptionValue<String>(ALWAYS_POLICY_OPTIONS, LOC_ENCODING);
+    mCompactEncoding = (encoding == "compact");
+    if (!mCompactEncoding && encoding != "pbj")
+        SILOG(always_loc,error,"Unknown loc update encoding " << encoding << ", using pbj.");
+    // The compact encoding leaves out anything the receiver has already seen,
+    // so it needs every message to arrive, in order.
+    if (mCompactEncoding && mChannelMode != ChannelStream) {
+        SILOG(always_loc,error,"The compact loc update encoding requires the stream channel, using pbj.");
+        mCompactEncoding = false;
+    }
+    mPositionPrecision = GetOptionValue<float32>(ALWAYS_POLICY_OPTIONS, LOC_POSITION_PRECISION);
+    mVelocityPrecision = GetOptionValue<float32>(ALWAYS_POLICY_OPTIONS, LOC_VELOCITY_PRECISION);
 }
 
 AlwaysLocationUpdatePolicy::~AlwaysLocationUpdatePolicy() {
@@ -378,8 +414,6 @@ bool AlwaysLocationUpdatePolicy::isSelfSubscriber(const ServerID& sid, const UUI
 
 bool AlwaysLocationUpdatePolicy::trySend(const UUID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount)
 {
-    std::string bluMsg = serializePBJMessage(blu);
-
     ObjectSession* session = mLocService->context()->objectSessionManager()->getSession(ObjectReference(dest));
     if (session == NULL) {
         //mObjectSubscriptions.decrementOutstandingMessageCount(dest);
@@ -391,6 +425,13 @@ bool AlwaysLocationUpdatePolicy::trySend(const UUID& dest, const Sirikata::Proto
         return false;
     }
 
+    if (mChannelMode == ChannelStream)
+        return sendOnStream(mObjectLocStreams, dest, locServiceStream, blu, numOutstandingMessageCount);
+
+    std::string bluMsg = serializePBJMessage(blu);
+    if (mChannelMode == ChannelDatagram)
+        return sendDatagram(locServiceStream, bluMsg);
+
     Sirikata::Protocol::Frame msg_frame;
     msg_frame.set_payload(bluMsg);
     std::string* framed_loc_msg = new std::string(serializePBJMessage(msg_frame));
@@ -400,8 +441,6 @@ bool AlwaysLocationUpdatePolicy::trySend(const UUID& dest, const Sirikata::Proto
 
 bool AlwaysLocationUpdatePolicy::trySend(const OHDP::NodeID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount)
 {
-    std::string bluMsg = serializePBJMessage(blu);
-
     ObjectHostSessionPtr session = mLocService->context()->ohSessionManager()->getSession(dest);
     if (!session) {
         //mOHSubscriptions.decrementOutstandingMessageCount(dest);
@@ -413,6 +452,13 @@ bool AlwaysLocationUpdatePolicy::trySend(const OHDP::NodeID& dest, const Sirikat
         return false;
     }
 
+    if (mChannelMode == ChannelStream)
+        return sendOnStream(mOHLocStreams, dest, locServiceStream, blu, numOutstandingMessageCount);
+
+    std::string bluMsg = serializePBJMessage(blu);
+    if (mChannelMode == ChannelDatagram)
+        return sendDatagram(locServiceStream, bluMsg);
+
     Sirikata::Protocol::Frame msg_frame;
     msg_frame.set_payload(bluMsg);
     std::string* framed_loc_msg = new std::string(serializePBJMessage(msg_frame));
@@ -439,6 +485,201 @@ bool AlwaysLocationUpdatePolicy::trySend(const ServerID& dest, const Sirikata::P
 
 
 
+template<typename StreamMapType>
+bool AlwaysLocationUpdatePolicy::sendOnStream(StreamMapType& streams, const typename StreamMapType::key_type& dest, typename StreamMapType::mapped_type::element_type::StreamTypePtr base_stream, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount) {
+    typedef typename StreamMapType::mapped_type::element_type StreamInfo;
+    typedef typename StreamMapType::mapped_type StreamInfoPtr;
+
+    // If the subscriber reconnected, the old substream went away with its old
+    // session and we need to start over
+    typename StreamMapType::iterator stream_it = streams.find(dest);
+    if (stream_it != streams.end() && stream_it->second->base_stream != base_stream) {
+        streams.erase(stream_it);
+        stream_it = streams.end();
+    }
+    if (stream_it == streams.end()) {
+        stream_it = streams.insert( typename StreamMapType::value_type(dest, StreamInfoPtr(new StreamInfo(base_stream))) ).first;
+        stream_it->second->writecb = std::tr1::bind(
+            &StreamInfo::writeSomeUpdates, mLocService->context(), typename StreamInfo::WPtr(stream_it->second)
+        );
+        // A new substream means a new decoder on the other end, so the
+        // encoder starts from scratch too
+        if (mCompactEncoding)
+            stream_it->second->encoder.reset(new CompactLocUpdateEncoder(mPositionPrecision, mVelocityPrecision));
+    }
+    StreamInfoPtr loc_stream = stream_it->second;
+    // Leave updates to coalesce in outstandingUpdates until the subscriber is
+    // removed or comes back on a new session
+    if (loc_stream->failed)
+        return false;
+
+    if (!loc_stream->iostream_requested)
+        StreamInfo::requestLocSubstream(mLocService->context(), loc_stream);
+
+    std::string msg = loc_stream->encoder ? loc_stream->encoder->encode(blu) : serializePBJMessage(blu);
+    loc_stream->outstanding.push( std::make_pair(Network::Frame::write(msg), numOutstandingMessageCount) );
+
+    if (!loc_stream->writing)
+        StreamInfo::writeSomeUpdates(mLocService->context(), loc_stream);
+    return true;
+}
+
+template<typename StreamTypePtr>
+bool AlwaysLocationUpdatePolicy::sendDatagram(StreamTypePtr base_stream, const std::string& msg) {
+    typename StreamTypePtr::element_type::ConnectionPtr conn = base_stream->connection().lock();
+    if (!conn) return false;
+    // Datagrams are self-delimiting, so the update goes out as is
+    return conn->datagram(
+        (void*)msg.data(), msg.size(),
+        OBJECT_PORT_LOCATION, OBJECT_PORT_LOCATION,
+        NULL
+    );
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::writeSomeUpdates(const Context* ctx, WPtr w_loc_stream) {
+    static Duration retry_rate = Duration::milliseconds((int64)1);
+
+    Ptr loc_stream = w_loc_stream.lock();
+    if (!loc_stream) return;
+
+    loc_stream->writing = true;
+
+    if (!loc_stream->iostream) {
+        // Still waiting on the substream, locSubstreamCallback will call us
+        // when it gets it.
+        loc_stream->writing = false;
+        return;
+    }
+
+    while(!loc_stream->outstanding.empty()) {
+        std::string& framed_loc_msg = loc_stream->outstanding.front().first;
+        int bytes_written = loc_stream->iostream->write((const uint8*)framed_loc_msg.data(), framed_loc_msg.size());
+        if (bytes_written < 0) {
+            // The stream is going away with its session, so nothing queued
+            // will ever make it out. Drop it, which also releases the
+            // subscribers' outstanding message counts, and stop retrying.
+            SILOG(always_loc,detailed,"Location update substream failed, dropping " << loc_stream->outstanding.size() << " queued updates");
+            loc_stream->fail();
+            return;
+        }
+        else if (bytes_written < (int)framed_loc_msg.size()) {
+            framed_loc_msg = framed_loc_msg.substr(bytes_written);
+            break;
+        }
+        else {
+            loc_stream->outstanding.pop();
+        }
+    }
+
+    if (loc_stream->outstanding.empty())
+        loc_stream->writing = false;
+    else
+        ctx->mainStrand->post(
+            retry_rate, loc_stream->writecb,
+            "AlwaysLocationUpdatePolicy::LocStreamInfo::writeSomeUpdates"
+        );
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::fail() {
+    failed = true;
+    outstanding = std::queue< std::pair<std::string, SubscriberInfoPtr> >();
+    writing = false;
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::requestLocSubstream(const Context* ctx, Ptr loc_stream) {
+    loc_stream->iostream_requested = true;
+    int ret = loc_stream->base_stream->createChildStream(
+        ctx->mainStrand->wrap(
+            std::tr1::bind(&LocStreamInfo::locSubstreamCallback, ctx, _1, _2, WPtr(loc_stream))
+        ),
+        (void*)NULL, 0,
+        OBJECT_PORT_LOCATION, OBJECT_PORT_LOCATION
+    );
+    if (ret == -1)
+        locSubstreamFailed(ctx, loc_stream);
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::retryLocSubstream(const Context* ctx, WPtr w_loc_stream) {
+    Ptr loc_stream = w_loc_stream.lock();
+    if (!loc_stream) return;
+    requestLocSubstream(ctx, loc_stream);
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::locSubstreamCallback(const Context* ctx, int x, StreamTypePtr substream, WPtr w_loc_stream) {
+    // If the subscriber went away, so did our interest in the stream
+    Ptr loc_stream = w_loc_stream.lock();
+    if (!loc_stream) {
+        if (substream) substream->close(false);
+        return;
+    }
+
+    if (!substream) {
+        locSubstreamFailed(ctx, loc_stream);
+        return;
+    }
+
+    loc_stream->substream_failures = 0;
+    loc_stream->iostream = substream;
+    assert(!loc_stream->writing);
+    writeSomeUpdates(ctx, loc_stream);
+}
+
+template<typename StreamType>
+void AlwaysLocationUpdatePolicy::LocStreamInfo<StreamType>::locSubstreamFailed(const Context* ctx, Ptr loc_stream) {
+    loc_stream->substream_failures++;
+    if (loc_stream->substream_failures >= MaxLocSubstreamAttempts) {
+        SILOG(always_loc,error,"Failed multiple times to open loc update substream, dropping " << loc_stream->outstanding.size() << " queued updates.");
+        loc_stream->iostream_requested = false;
+        loc_stream->fail();
+        return;
+    }
+
+    // iostream_requested stays set while we wait so sendOnStream doesn't
+    // start another attempt in the meantime
+    SILOG(always_loc,warn,"Error opening loc update substream, retrying...");
+    Duration backoff = Duration::milliseconds(LocSubstreamRetryMilliseconds << (loc_stream->substream_failures - 1));
+    ctx->mainStrand->post(
+        backoff,
+        std::tr1::bind(&LocStreamInfo::retryLocSubstream, ctx, WPtr(loc_stream)),
+        "AlwaysLocationUpdatePolicy::LocStreamInfo::retryLocSubstream"
+    );
+}
+
+void AlwaysLocationUpdatePolicy::objectUnsubscribed(const UUID& dest, const UUID& observed) {
+    ObjectLocStreamMap::iterator stream_it = mObjectLocStreams.find(dest);
+    if (stream_it != mObjectLocStreams.end() && stream_it->second->encoder)
+        stream_it->second->encoder->removeObject(observed);
+}
+
+void AlwaysLocationUpdatePolicy::objectUnsubscribed(const OHDP::NodeID& dest, const UUID& observed) {
+    OHLocStreamMap::iterator stream_it = mOHLocStreams.find(dest);
+    if (stream_it != mOHLocStreams.end() && stream_it->second->encoder)
+        stream_it->second->encoder->removeObject(observed);
+}
+
+void AlwaysLocationUpdatePolicy::objectUnsubscribed(const ServerID& dest, const UUID& observed) {
+    // Updates to servers aren't compact encoded
+}
+
+void AlwaysLocationUpdatePolicy::subscriberRemoved(const UUID& dest) {
+    mObjectLocStreams.erase(dest);
+}
+
+void AlwaysLocationUpdatePolicy::subscriberRemoved(const OHDP::NodeID& dest) {
+    mOHLocStreams.erase(dest);
+}
+
+void AlwaysLocationUpdatePolicy::subscriberRemoved(const ServerID& dest) {
+    // Servers don't have streams to clean up
+}
+
+
+
 // Factored out since we need different implementations for the three
 // types of subscribers
 SeqNoPtr AlwaysLocationUpdatePolicy::getSeqnoPtr(const ServerID& remote, SeqNoPtr existing) {
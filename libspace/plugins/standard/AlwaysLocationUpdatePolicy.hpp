@@ -36,10 +36,15 @@
 #include <sirikata/space/LocationService.hpp>
 #include <sirikata/core/options/CommonOptions.hpp>
 
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 #include "Protocol_Loc.pbj.hpp"
 
 #define ALWAYS_POLICY_OPTIONS      "always_location_update_policy"
 #define LOC_MAX_PER_RESULT         "loc.max-per-result"
+#define LOC_CHANNEL                "loc.channel"
+#define LOC_ENCODING               "loc.encoding"
+#define LOC_POSITION_PRECISION     "loc.position-precision"
+#define LOC_VELOCITY_PRECISION     "loc.velocity-precision"
 
 namespace Sirikata {
 
@@ -159,6 +164,85 @@ private:
         return sub_info.use_count()-1;
     }
 
+    // How updates get to objects and object hosts
+    enum ChannelMode {
+        // One long-lived substream per subscriber, carrying a series of
+        // Network::Frames
+        ChannelStream,
+        // Unreliable datagrams. Lost updates aren't resent, a later update for
+        // the same object supersedes them.
+        ChannelDatagram,
+        // A new substream for every message, for older clients
+        ChannelSubstream
+    };
+    ChannelMode mChannelMode;
+    // Whether to use the compact encoding for updates in ChannelStream mode,
+    // and its quantization steps
+    bool mCompactEncoding;
+    float32 mPositionPrecision;
+    float32 mVelocityPrecision;
+
+    // LocStreamInfo manages the long-lived substream updates are written to
+    // in ChannelStream mode. Only used from the main strand.
+    template<typename StreamType>
+    struct LocStreamInfo {
+        typedef std::tr1::shared_ptr<StreamType> StreamTypePtr;
+        typedef std::tr1::shared_ptr<LocStreamInfo> Ptr;
+        typedef std::tr1::weak_ptr<LocStreamInfo> WPtr;
+
+        LocStreamInfo(StreamTypePtr base)
+         : base_stream(base), iostream_requested(false), substream_failures(0), writing(false), failed(false) {}
+        ~LocStreamInfo() {
+            if (iostream)
+                iostream->close(false);
+        }
+
+        // The session's stream the substream is a child of. If the session's
+        // stream changes we need a new substream.
+        StreamTypePtr base_stream;
+        // The substream we write to and whether we've requested it yet
+        StreamTypePtr iostream;
+        bool iostream_requested;
+        // Consecutive failed attempts to open the substream
+        uint8 substream_failures;
+
+        // Framed messages waiting to be written. Each holds a reference to
+        // the subscriber's info until it has been written so a backed up
+        // stream counts against the outstanding message limits, leaving
+        // updates to coalesce in outstandingUpdates instead.
+        std::queue< std::pair<std::string, SubscriberInfoPtr> > outstanding;
+        // If writing is currently in progress
+        bool writing;
+        // Set once the substream reports an error or can't be opened.
+        // Nothing more is written to it, the session's stream is going away
+        // with it.
+        bool failed;
+        // Encoder for the compact format, which tracks what has been sent on
+        // this substream. NULL if updates are sent as plain
+        // BulkLocationUpdates.
+        std::tr1::shared_ptr<CompactLocUpdateEncoder> encoder;
+        // Stored callback for writing
+        std::tr1::function<void()> writecb;
+
+        // Give up on the stream, dropping anything queued, which also
+        // releases the subscribers' outstanding message counts
+        void fail();
+
+        static void writeSomeUpdates(const Context* ctx, WPtr w_loc_stream);
+        static void requestLocSubstream(const Context* ctx, Ptr loc_stream);
+        static void retryLocSubstream(const Context* ctx, WPtr w_loc_stream);
+        static void locSubstreamCallback(const Context* ctx, int x, StreamTypePtr substream, WPtr w_loc_stream);
+        // Back off and request the substream again, or give up after too
+        // many attempts
+        static void locSubstreamFailed(const Context* ctx, Ptr loc_stream);
+    };
+    typedef LocStreamInfo<ODPSST::Stream> ObjectLocStreamInfo;
+    typedef std::tr1::unordered_map<UUID, ObjectLocStreamInfo::Ptr, UUID::Hasher> ObjectLocStreamMap;
+    ObjectLocStreamMap mObjectLocStreams;
+    typedef LocStreamInfo<OHDPSST::Stream> OHLocStreamInfo;
+    typedef std::tr1::unordered_map<OHDP::NodeID, OHLocStreamInfo::Ptr, OHDP::NodeID::Hasher> OHLocStreamMap;
+    OHLocStreamMap mOHLocStreams;
+
     template<typename SubscriberType>
     struct SubscriberIndex {
         AlwaysLocationUpdatePolicy* parent;
@@ -527,6 +611,13 @@ private:
                         // can only have 1 subscription to it
                         sub_it->second->objectIndexes.erase(indexes_it);
                     }
+                    // Once the subscriber isn't tracking the object at all,
+                    // drop any update still waiting for it and anything kept
+                    // about what it was sent
+                    if (sub_it->second->objectIndexes.find(uuid) == sub_it->second->objectIndexes.end()) {
+                        sub_it->second->outstandingUpdates.erase(uuid);
+                        parent->objectUnsubscribed(remote, uuid);
+                    }
                 }
             }
 
@@ -559,6 +650,7 @@ private:
                     SubscriberSet* subs = obj_it->second;
                     subs->erase(remote);
                 }
+                parent->objectUnsubscribed(remote, uuid);
             }
             // And then actually clear out the list of subscriptions
             subs->objectIndexes.clear();
@@ -777,8 +869,10 @@ private:
                 }
             }
 
-            for(typename std::list<SubscriberType>::iterator it = to_delete.begin(); it != to_delete.end(); it++)
+            for(typename std::list<SubscriberType>::iterator it = to_delete.begin(); it != to_delete.end(); it++) {
                 mSubscriptions.erase(*it);
+                parent->subscriberRemoved(*it);
+            }
         }
 
     };
@@ -800,6 +894,22 @@ private:
     bool trySend(const OHDP::NodeID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
     bool trySend(const ServerID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
 
+    // Helpers for the ChannelStream and ChannelDatagram modes of trySend
+    template<typename StreamMapType>
+    bool sendOnStream(StreamMapType& streams, const typename StreamMapType::key_type& dest, typename StreamMapType::mapped_type::element_type::StreamTypePtr base_stream, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
+    template<typename StreamTypePtr>
+    bool sendDatagram(StreamTypePtr base_stream, const std::string& msg);
+
+    // Clean up per-object channel state after a subscriber stops tracking an
+    // object
+    void objectUnsubscribed(const UUID& dest, const UUID& observed);
+    void objectUnsubscribed(const OHDP::NodeID& dest, const UUID& observed);
+    void objectUnsubscribed(const ServerID& dest, const UUID& observed);
+
+    // Clean up after a subscriber that has no subscriptions left
+    void subscriberRemoved(const UUID& dest);
+    void subscriberRemoved(const OHDP::NodeID& dest);
+    void subscriberRemoved(const ServerID& dest);
 
 
     SeqNoPtr getSeqnoPtr(const ServerID& remote, SeqNoPtr existing);
@@ -6,6 +6,7 @@
 #include <sirikata/core/command/Commander.hpp>
 #include <sirikata/core/network/IOStrandImpl.hpp>
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/network/Frame.hpp>
 
 AUTO_SINGLETON_INSTANCE(Sirikata::LocationUpdatePolicyFactory);
 AUTO_SINGLETON_INSTANCE(Sirikata::LocationServiceFactory);
@@ -15,6 +16,13 @@ namespace Sirikata {
 LocationServiceListener::~LocationServiceListener() {
 }
 
+void LocationServiceListener::localLocationsUpdated(const LocalLocationUpdateList& updates) {
+    for(LocalLocationUpdateList::const_iterator it = updates.begin(); it != updates.end(); it++) {
+        localLocationUpdated(it->uuid, it->agg, it->location);
+        localOrientationUpdated(it->uuid, it->agg, it->orientation);
+    }
+}
+
 
 
 LocationUpdatePolicyFactory& LocationUpdatePolicyFactory::getSingleton() {
@@ -112,7 +120,13 @@ void LocationService::newSession(ObjectSession* session) {
             std::tr1::placeholders::_1,std::tr1::placeholders::_2
         )
     );
-
+    conn->registerReadDatagramCallback(OBJECT_PORT_LOCATION,
+        std::tr1::bind(
+            &LocationService::handleLocationUpdateDatagram, this,
+            sourceObject.object().getAsUUID(),
+            std::tr1::placeholders::_1,std::tr1::placeholders::_2
+        )
+    );
 }
 
 void LocationService::handleLocationUpdateSubstream(const UUID& source, int err, SSTStreamPtr s) {
@@ -126,6 +140,23 @@ void LocationService::handleLocationUpdateSubstream(const UUID& source, int err,
 }
 
 void LocationService::handleLocationUpdateSubstreamRead(const UUID& source, SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length) {
+    // A long-lived request stream starts with a Network::Frame, whose length
+    // always has a zero high byte, where a single request is a bare
+    // Protocol::Loc::Container.
+    if (prevdata->tellp() == 0 && length > 0 && buffer[0] == 0) {
+        delete prevdata;
+        std::tr1::shared_ptr<String> framedata(new String());
+        s->registerReadCallback(
+            std::tr1::bind(
+                &LocationService::handleLocationUpdateChannelRead, this,
+                source, s, framedata,
+                std::tr1::placeholders::_1,std::tr1::placeholders::_2
+            )
+        );
+        handleLocationUpdateChannelRead(source, s, framedata, buffer, length);
+        return;
+    }
+
     prevdata->write((const char*)buffer, length);
     String payload(prevdata->str());
 #ifdef SIRIKATA_SPACE_DELAY_APPLY_LOC_UPDATE
@@ -154,6 +185,21 @@ void LocationService::tryHandleLocationUpdate(const UUID& source, SSTStreamPtr s
     }
 }
 
+void LocationService::handleLocationUpdateChannelRead(const UUID& source, SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, uint8* buffer, int length) {
+    prevdata->append((const char*)buffer, length);
+    while(true) {
+        String msg = Network::Frame::parse(*prevdata);
+        // If we don't have a full request, just wait for more
+        if (msg.empty()) return;
+        if (!locationUpdate(source, (void*)msg.data(), msg.size()))
+            SILOG(loc,error,"Couldn't parse location update request from " << source.toString());
+    }
+}
+
+void LocationService::handleLocationUpdateDatagram(const UUID& source, uint8* buffer, int length) {
+    locationUpdate(source, (void*)buffer, length);
+}
+
 void LocationService::start() {
     PollingService::start();
     mUpdatePolicy->start();
@@ -346,6 +392,28 @@ void LocationService::notifyLocalQueryDataUpdated(const UUID& uuid, bool agg, co
             it->listener->localQueryDataUpdated(uuid, agg, newval);
 }
 
+void LocationService::notifyLocalLocationsUpdated(const LocalLocationUpdateList& updates) const {
+    if (updates.empty()) return;
+
+    // Listeners that don't want aggregates get a filtered copy, built only if
+    // there's something to filter out
+    bool has_aggs = false;
+    for(LocalLocationUpdateList::const_iterator it = updates.begin(); it != updates.end() && !has_aggs; it++)
+        has_aggs = it->agg;
+    LocalLocationUpdateList non_agg_updates;
+    if (has_aggs) {
+        for(LocalLocationUpdateList::const_iterator it = updates.begin(); it != updates.end(); it++)
+            if (!it->agg) non_agg_updates.push_back(*it);
+    }
+
+    for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++) {
+        if (!has_aggs || it->wantAggregates)
+            it->listener->localLocationsUpdated(updates);
+        else if (!non_agg_updates.empty())
+            it->listener->localLocationsUpdated(non_agg_updates);
+    }
+}
+
 
 void LocationService::notifyReplicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& query_data) const {
     for(ListenerList::const_iterator it = mListeners.begin(); it != mListeners.end(); it++)
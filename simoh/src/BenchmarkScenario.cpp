@@ -0,0 +1,227 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "BenchmarkScenario.hpp"
+#include "ScenarioFactory.hpp"
+#include "SimObjectHost.hpp"
+#include "Object.hpp"
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/util/Percentile.hpp>
+#include "Options.hpp"
+#include "ConnectedObjectTracker.hpp"
+#include <json_spirit/json_spirit.h>
+#include <fstream>
+
+namespace Sirikata {
+
+namespace {
+
+namespace json = json_spirit;
+
+// Summarize samples with their mean, percentiles and max. Sorts the samples in
+// place.
+json::Value summarize(std::vector<float64>& samples) {
+    std::sort(samples.begin(), samples.end());
+    float64 total = 0;
+    for(uint32 i = 0; i < samples.size(); i++)
+        total += samples[i];
+
+    json::Value result = json::Object();
+    result.put("count", (int64)samples.size());
+    result.put("mean", samples.empty() ? 0.0 : total / samples.size());
+    result.put("p50", percentile(samples, 0.5));
+    result.put("p90", percentile(samples, 0.9));
+    result.put("p99", percentile(samples, 0.99));
+    result.put("max", samples.empty() ? 0.0 : samples.back());
+    return result;
+}
+
+}
+
+void BSInitOptions(BenchmarkScenario *thus) {
+    Sirikata::InitializeClassOptions ico("BenchmarkScenario",thus,
+        new OptionValue("num-pings-per-second","1000",Sirikata::OptionValueType<double>(),"Number of pings sent between connected objects per simulation second"),
+        new OptionValue("ping-size","64",Sirikata::OptionValueType<uint32>(),"Size of ping payloads."),
+        new OptionValue("warmup","5s",Sirikata::OptionValueType<Duration>(),"Time after the connect phase before pings are measured."),
+        new OptionValue("report-file","",Sirikata::OptionValueType<String>(),"File to write the results to as JSON. If empty, they are only logged."),
+        NULL);
+}
+
+BenchmarkScenario::BenchmarkScenario(const String &options)
+ : mContext(NULL),
+   mObjectTracker(NULL),
+   mPingPoller(NULL),
+   mStartTime(Time::epoch()),
+   mMeasureStartTime(Time::epoch()),
+   mNumTotalPings(0),
+   mConnected(0),
+   mPingsSent(0),
+   mPingsReceived(0),
+   mLocUpdatesReceived(0)
+{
+    BSInitOptions(this);
+    OptionSet* optionsSet = OptionSet::getOptions("BenchmarkScenario",this);
+    optionsSet->parse(options);
+
+    mNumPingsPerSecond = optionsSet->referenceOption("num-pings-per-second")->as<double>();
+    mPingPayloadSize = optionsSet->referenceOption("ping-size")->as<uint32>();
+    mWarmup = optionsSet->referenceOption("warmup")->as<Duration>();
+    mReportFile = optionsSet->referenceOption("report-file")->as<String>();
+}
+
+BenchmarkScenario::~BenchmarkScenario() {
+    if (mContext != NULL) {
+        mContext->objectHost->removeListener(this);
+        mContext->objectHost->unregisterService(OBJECT_PORT_PING);
+    }
+    delete mPingPoller;
+    delete mObjectTracker;
+}
+
+BenchmarkScenario* BenchmarkScenario::create(const String& options) {
+    return new BenchmarkScenario(options);
+}
+
+void BenchmarkScenario::addConstructorToFactory(ScenarioFactory* thus) {
+    thus->registerConstructor("benchmark",&BenchmarkScenario::create);
+}
+
+void BenchmarkScenario::initialize(ObjectHostContext* ctx) {
+    using std::tr1::placeholders::_1;
+
+    mContext = ctx;
+    mObjectTracker = new ConnectedObjectTracker(mContext->objectHost);
+    mContext->objectHost->addListener(this);
+    mContext->objectHost->registerService(OBJECT_PORT_PING, std::tr1::bind(&BenchmarkScenario::pingReturn, this, _1));
+
+    mPingPoller = new Poller(
+        ctx->mainStrand,
+        std::tr1::bind(&BenchmarkScenario::sendPings, this),
+        "BenchmarkScenario Ping Poller",
+        mNumPingsPerSecond > 1000 ? // Amortize the scheduling cost
+        Duration::seconds(10.0/mNumPingsPerSecond) :
+        Duration::seconds(1.0/mNumPingsPerSecond)
+    );
+}
+
+void BenchmarkScenario::start() {
+    mStartTime = mContext->simTime();
+    mMeasureStartTime = mStartTime + GetOptionValue<Duration>(OBJECT_CONNECT_PHASE) + mWarmup;
+    mPingPoller->start();
+}
+
+void BenchmarkScenario::stop() {
+    mPingPoller->stop();
+    report();
+}
+
+void BenchmarkScenario::objectHostConnectedObject(ObjectHost* oh, Object* obj, const ServerID& server) {
+    boost::mutex::scoped_lock lock(mStatsMutex);
+    mConnected++;
+    mAwaitingProx[obj->uuid()] = mContext->simTime();
+}
+
+void BenchmarkScenario::objectHostProximityResults(ObjectHost* oh, Object* obj) {
+    boost::mutex::scoped_lock lock(mStatsMutex);
+    ConnectTimeMap::iterator it = mAwaitingProx.find(obj->uuid());
+    if (it == mAwaitingProx.end())
+        return;
+    mProxLatencies.push_back( (mContext->simTime() - it->second).toSeconds() * 1000.0 );
+    mAwaitingProx.erase(it);
+}
+
+void BenchmarkScenario::objectHostLocationUpdates(ObjectHost* oh, Object* obj, uint32 count) {
+    if (mContext->simTime() < mMeasureStartTime)
+        return;
+    boost::mutex::scoped_lock lock(mStatsMutex);
+    mLocUpdatesReceived += count;
+}
+
+void BenchmarkScenario::sendPings() {
+    // Like PingDelugeScenario, limit the number per round so we don't block
+    // the main strand for too long when we fall behind.
+    static const int64 kMaxPingsPerRound = 40;
+
+    Time t = mContext->simTime();
+    int64 how_many = (int64)((t - mStartTime).toSeconds() * mNumPingsPerSecond);
+    int64 limit = std::min(how_many - mNumTotalPings, kMaxPingsPerRound);
+    int64 i;
+    for (i = 0; i < limit; ++i) {
+        Object* objA = mObjectTracker->randomObject();
+        Object* objB = mObjectTracker->randomObject();
+        if (!objA || !objB)
+            break;
+        float dist = (objA->location().position(t) - objB->location().position(t)).length();
+        if (!mContext->objectHost->ping(t, objA->uuid(), objB->uuid(), dist, mPingPayloadSize))
+            break;
+    }
+    // Pings we couldn't send because nothing is connected yet aren't owed
+    // later
+    if (i < limit && mObjectTracker->randomObject() == NULL)
+        mNumTotalPings = how_many;
+    else
+        mNumTotalPings += i;
+
+    if (t >= mMeasureStartTime) {
+        boost::mutex::scoped_lock lock(mStatsMutex);
+        mPingsSent += i;
+    }
+}
+
+void BenchmarkScenario::pingReturn(const Sirikata::Protocol::Object::ObjectMessage& msg) {
+    Sirikata::Protocol::Object::Ping ping_msg;
+    if (!ping_msg.ParseFromString(msg.payload()))
+        return;
+    if (ping_msg.ping() < mMeasureStartTime)
+        return;
+
+    Duration latency = mContext->simTime() - ping_msg.ping();
+    boost::mutex::scoped_lock lock(mStatsMutex);
+    mPingsReceived++;
+    mPingLatencies.push_back(latency.toSeconds() * 1000.0);
+}
+
+void BenchmarkScenario::report() {
+    boost::mutex::scoped_lock lock(mStatsMutex);
+
+    float64 measured = (mContext->simTime() - mMeasureStartTime).toSeconds();
+    if (measured <= 0) {
+        SILOG(oh,error,"Benchmark: stopped before the warmup finished, nothing was measured");
+        return;
+    }
+
+    json::Value result = json::Object();
+    result.put("duration", measured);
+    result.put("objects.connected", (int64)mConnected);
+    result.put("pings.sent", (int64)mPingsSent);
+    result.put("pings.received", (int64)mPingsReceived);
+    result.put("pings.rate", mPingsReceived / measured);
+    result.put("pings.latency", summarize(mPingLatencies));
+    result.put("prox.first_result", summarize(mProxLatencies));
+    result.put("prox.waiting", (int64)mAwaitingProx.size());
+    result.put("loc.received", (int64)mLocUpdatesReceived);
+    result.put("loc.rate", mLocUpdatesReceived / measured);
+
+    SILOG(oh,info,
+        "Benchmark: " << mPingsReceived << "/" << mPingsSent << " pings delivered, " <<
+        (mPingsReceived / measured) << " pings/s, latency " <<
+        "p50 " << result.getReal("pings.latency.p50") << "ms " <<
+        "p99 " << result.getReal("pings.latency.p99") << "ms, first prox result " <<
+        "p50 " << result.getReal("prox.first_result.p50") << "ms " <<
+        "p99 " << result.getReal("prox.first_result.p99") << "ms, " <<
+        (mLocUpdatesReceived / measured) << " loc updates/s"
+    );
+
+    if (mReportFile.empty())
+        return;
+    std::ofstream fp(mReportFile.c_str());
+    if (!fp) {
+        SILOG(oh,error,"Benchmark: couldn't open " << mReportFile << " for writing");
+        return;
+    }
+    fp << json::write(result);
+}
+
+} // namespace Sirikata
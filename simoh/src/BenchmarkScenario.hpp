@@ -0,0 +1,80 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _BENCHMARK_SCENARIO_HPP_
+#define _BENCHMARK_SCENARIO_HPP_
+
+#include "Scenario.hpp"
+#include "ObjectHostListener.hpp"
+#include <sirikata/core/service/Poller.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+class ScenarioFactory;
+class ConnectedObjectTracker;
+
+/** Generates a steady stream of pings between random connected objects and
+ *  measures what the space server does with them, for end-to-end benchmark
+ *  runs (see tools/space/test_deploy/loopback_bench.py). After the connect
+ *  phase and a warmup period it records:
+ *   - pings sent and delivered, and the delivery rate
+ *   - the end-to-end latency of each delivered ping
+ *   - for objects with queries, the time from connecting to the first
+ *     proximity result
+ *   - the number and rate of location updates received
+ *  When the scenario stops these are logged and, if report-file is set,
+ *  written to it as JSON.
+ */
+class BenchmarkScenario : public Scenario, public ObjectHostListener {
+    ObjectHostContext* mContext;
+    ConnectedObjectTracker* mObjectTracker;
+
+    double mNumPingsPerSecond;
+    uint32 mPingPayloadSize;
+    Duration mWarmup;
+    String mReportFile;
+
+    Poller* mPingPoller;
+
+    Time mStartTime;
+    // Only pings sent after this are counted
+    Time mMeasureStartTime;
+    int64 mNumTotalPings;
+
+    // Connections and proximity results arrive outside the main strand, so
+    // all the stats are protected by this.
+    boost::mutex mStatsMutex;
+    uint32 mConnected;
+    uint64 mPingsSent;
+    uint64 mPingsReceived;
+    std::vector<float64> mPingLatencies;
+    typedef std::tr1::unordered_map<UUID, Time, UUID::Hasher> ConnectTimeMap;
+    // Objects that have connected but haven't received proximity results yet
+    ConnectTimeMap mAwaitingProx;
+    std::vector<float64> mProxLatencies;
+    uint64 mLocUpdatesReceived;
+
+    void sendPings();
+    void pingReturn(const Sirikata::Protocol::Object::ObjectMessage& msg);
+    void report();
+
+    // ObjectHostListener Interface
+    virtual void objectHostConnectedObject(ObjectHost* oh, Object* obj, const ServerID& server);
+    virtual void objectHostProximityResults(ObjectHost* oh, Object* obj);
+    virtual void objectHostLocationUpdates(ObjectHost* oh, Object* obj, uint32 count);
+
+    static BenchmarkScenario* create(const String& options);
+public:
+    BenchmarkScenario(const String& options);
+    ~BenchmarkScenario();
+    virtual void initialize(ObjectHostContext*);
+    void start();
+    void stop();
+    static void addConstructorToFactory(ScenarioFactory*);
+};
+
+} // namespace Sirikata
+
+#endif //_BENCHMARK_SCENARIO_HPP_
@@ -0,0 +1,171 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ConnectStormScenario.hpp"
+#include "ScenarioFactory.hpp"
+#include "SimObjectHost.hpp"
+#include "Object.hpp"
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include "Options.hpp"
+#include "ConnectedObjectTracker.hpp"
+
+namespace Sirikata {
+
+void CSSInitOptions(ConnectStormScenario *thus) {
+    Sirikata::InitializeClassOptions ico("ConnectStormScenario",thus,
+        new OptionValue("num-pings-per-second","1000",Sirikata::OptionValueType<double>(),"Number of pings sent between connected objects per simulation second"),
+        new OptionValue("ping-size","64",Sirikata::OptionValueType<uint32>(),"Size of ping payloads."),
+        new OptionValue("expected-objects","0",Sirikata::OptionValueType<uint32>(),"Number of objects expected to connect. When all have, the time it took is reported. 0 disables this."),
+        new OptionValue("report-interval","1s",Sirikata::OptionValueType<Duration>(),"How often to report connection rate and ping latency."),
+        NULL);
+}
+
+ConnectStormScenario::ConnectStormScenario(const String &options)
+ : mContext(NULL),
+   mObjectTracker(NULL),
+   mPingPoller(NULL),
+   mReportPoller(NULL),
+   mStartTime(Time::epoch()),
+   mNumTotalPings(0),
+   mConnected(0),
+   mConnectedSinceReport(0),
+   mAllConnectedReported(false),
+   mPingsReturned(0),
+   mPingLatencyTotal(Duration::zero()),
+   mPingLatencyMax(Duration::zero())
+{
+    CSSInitOptions(this);
+    OptionSet* optionsSet = OptionSet::getOptions("ConnectStormScenario",this);
+    optionsSet->parse(options);
+
+    mNumPingsPerSecond = optionsSet->referenceOption("num-pings-per-second")->as<double>();
+    mPingPayloadSize = optionsSet->referenceOption("ping-size")->as<uint32>();
+    mExpectedObjects = optionsSet->referenceOption("expected-objects")->as<uint32>();
+    mReportInterval = optionsSet->referenceOption("report-interval")->as<Duration>();
+}
+
+ConnectStormScenario::~ConnectStormScenario() {
+    if (mContext != NULL) {
+        mContext->objectHost->removeListener(this);
+        mContext->objectHost->unregisterService(OBJECT_PORT_PING);
+    }
+    delete mPingPoller;
+    delete mReportPoller;
+    delete mObjectTracker;
+}
+
+ConnectStormScenario* ConnectStormScenario::create(const String& options) {
+    return new ConnectStormScenario(options);
+}
+
+void ConnectStormScenario::addConstructorToFactory(ScenarioFactory* thus) {
+    thus->registerConstructor("connectstorm",&ConnectStormScenario::create);
+}
+
+void ConnectStormScenario::initialize(ObjectHostContext* ctx) {
+    using std::tr1::placeholders::_1;
+
+    mContext = ctx;
+    mObjectTracker = new ConnectedObjectTracker(mContext->objectHost);
+    mContext->objectHost->addListener(this);
+    mContext->objectHost->registerService(OBJECT_PORT_PING, std::tr1::bind(&ConnectStormScenario::pingReturn, this, _1));
+
+    mPingPoller = new Poller(
+        ctx->mainStrand,
+        std::tr1::bind(&ConnectStormScenario::sendPings, this),
+        "ConnectStormScenario Ping Poller",
+        mNumPingsPerSecond > 1000 ? // Amortize the scheduling cost
+        Duration::seconds(10.0/mNumPingsPerSecond) :
+        Duration::seconds(1.0/mNumPingsPerSecond)
+    );
+    mReportPoller = new Poller(
+        ctx->mainStrand,
+        std::tr1::bind(&ConnectStormScenario::report, this),
+        "ConnectStormScenario Report Poller",
+        mReportInterval
+    );
+}
+
+void ConnectStormScenario::start() {
+    mStartTime = mContext->simTime();
+    mPingPoller->start();
+    mReportPoller->start();
+}
+
+void ConnectStormScenario::stop() {
+    mPingPoller->stop();
+    mReportPoller->stop();
+    report();
+}
+
+void ConnectStormScenario::objectHostConnectedObject(ObjectHost* oh, Object* obj, const ServerID& server) {
+    mConnected++;
+    mConnectedSinceReport++;
+}
+
+void ConnectStormScenario::sendPings() {
+    // Like PingDelugeScenario, limit the number per round so we don't block
+    // the main strand for too long when we fall behind.
+    static const int64 kMaxPingsPerRound = 40;
+
+    Time t = mContext->simTime();
+    int64 how_many = (int64)((t - mStartTime).toSeconds() * mNumPingsPerSecond);
+    int64 limit = std::min(how_many - mNumTotalPings, kMaxPingsPerRound);
+    int64 i;
+    for (i = 0; i < limit; ++i) {
+        Object* objA = mObjectTracker->randomObject();
+        Object* objB = mObjectTracker->randomObject();
+        if (!objA || !objB)
+            break;
+        float dist = (objA->location().position(t) - objB->location().position(t)).length();
+        if (!mContext->objectHost->ping(t, objA->uuid(), objB->uuid(), dist, mPingPayloadSize))
+            break;
+    }
+    // Pings we couldn't send because nothing is connected yet aren't owed
+    // later
+    if (i < limit && mObjectTracker->randomObject() == NULL)
+        mNumTotalPings = how_many;
+    else
+        mNumTotalPings += i;
+}
+
+void ConnectStormScenario::pingReturn(const Sirikata::Protocol::Object::ObjectMessage& msg) {
+    Sirikata::Protocol::Object::Ping ping_msg;
+    if (!ping_msg.ParseFromString(msg.payload()))
+        return;
+
+    Duration latency = mContext->simTime() - ping_msg.ping();
+    mPingsReturned++;
+    mPingLatencyTotal += latency;
+    if (latency > mPingLatencyMax)
+        mPingLatencyMax = latency;
+}
+
+void ConnectStormScenario::report() {
+    uint32 connected = mConnected.read();
+    uint32 recent = mConnectedSinceReport.read();
+    mConnectedSinceReport -= recent;
+
+    SILOG(oh,info,
+        "ConnectStorm: " << connected << " connected, " <<
+        (recent / mReportInterval.toSeconds()) << " connects/s, " <<
+        mPingsReturned << " pings returned, mean latency " <<
+        (mPingsReturned > 0 ? (mPingLatencyTotal / mPingsReturned) : Duration::zero()) <<
+        ", max latency " << mPingLatencyMax
+    );
+    mPingsReturned = 0;
+    mPingLatencyTotal = Duration::zero();
+    mPingLatencyMax = Duration::zero();
+
+    if (mExpectedObjects > 0 && connected >= mExpectedObjects && !mAllConnectedReported) {
+        SILOG(oh,info,
+            "ConnectStorm: all " << mExpectedObjects << " objects connected within " <<
+            (mContext->simTime() - mStartTime)
+        );
+        mAllConnectedReported = true;
+    }
+}
+
+} // namespace Sirikata
@@ -0,0 +1,72 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _CONNECT_STORM_SCENARIO_HPP_
+#define _CONNECT_STORM_SCENARIO_HPP_
+
+#include "Scenario.hpp"
+#include "ObjectHostListener.hpp"
+#include <sirikata/core/service/Poller.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+
+namespace Sirikata {
+
+class ScenarioFactory;
+class ConnectedObjectTracker;
+
+/** Measures how the space server copes with a burst of connections while it
+ *  is also routing traffic. Run with --object.connect=0s so all objects try
+ *  to connect at once, and compare runs with different --server-shards
+ *  settings on the space server.
+ *
+ *  Every report interval this logs the connection rate, and once the
+ *  expected number of objects is connected, how long that took. Meanwhile it
+ *  sends pings between random connected objects and reports their mean and
+ *  max latency, which reflects routing delay in the space server.
+ */
+class ConnectStormScenario : public Scenario, public ObjectHostListener {
+    ObjectHostContext* mContext;
+    ConnectedObjectTracker* mObjectTracker;
+
+    double mNumPingsPerSecond;
+    uint32 mPingPayloadSize;
+    uint32 mExpectedObjects;
+    Duration mReportInterval;
+
+    Poller* mPingPoller;
+    Poller* mReportPoller;
+
+    Time mStartTime;
+    int64 mNumTotalPings;
+
+    // Connections happen outside the main strand, everything else happens on
+    // it.
+    AtomicValue<uint32> mConnected;
+    AtomicValue<uint32> mConnectedSinceReport;
+    bool mAllConnectedReported;
+
+    uint64 mPingsReturned;
+    Duration mPingLatencyTotal;
+    Duration mPingLatencyMax;
+
+    void sendPings();
+    void report();
+    void pingReturn(const Sirikata::Protocol::Object::ObjectMessage& msg);
+
+    // ObjectHostListener Interface
+    virtual void objectHostConnectedObject(ObjectHost* oh, Object* obj, const ServerID& server);
+
+    static ConnectStormScenario* create(const String& options);
+public:
+    ConnectStormScenario(const String& options);
+    ~ConnectStormScenario();
+    virtual void initialize(ObjectHostContext*);
+    void start();
+    void stop();
+    static void addConstructorToFactory(ScenarioFactory*);
+};
+
+} // namespace Sirikata
+
+#endif //_CONNECT_STORM_SCENARIO_HPP_
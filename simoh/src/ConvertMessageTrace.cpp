@@ -0,0 +1,89 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/network/ObjectMessage.hpp>
+#include "MessageTrace.hpp"
+
+#define CONVERT_LOG(lvl, msg) SILOG(convertmsgtrace, lvl, msg)
+
+using namespace Sirikata;
+
+// Converts the ASCII traces LoadPacketTrace used to read, one
+//   <source uuid><separator><destination uuid>
+// per line, into the binary format. They don't record times or sizes, so
+// messages are spaced evenly at the given rate and all get the same size.
+
+void InitConvertOptions() {
+    InitializeClassOptions::module(SIRIKATA_OPTIONS_MODULE)
+        .addOption(new OptionValue("in","messagetrace",Sirikata::OptionValueType<String>(),"ASCII message trace to convert"))
+        .addOption(new OptionValue("out","messagetrace.bin",Sirikata::OptionValueType<String>(),"Binary message trace to write"))
+        .addOption(new OptionValue("rate","1000",Sirikata::OptionValueType<double>(),"Messages per second to space the converted messages at"))
+        .addOption(new OptionValue("size","30",Sirikata::OptionValueType<uint32>(),"Payload size to record for each message"))
+        ;
+}
+
+enum {UUIDLEN = 36};
+
+int main(int argc, char** argv) {
+    InitOptions();
+    InitConvertOptions();
+    ParseOptions(argc, argv);
+
+    String in_file = GetOptionValue<String>("in");
+    String out_file = GetOptionValue<String>("out");
+    double rate = GetOptionValue<double>("rate");
+    uint32 size = GetOptionValue<uint32>("size");
+    if (rate <= 0) {
+        CONVERT_LOG(fatal, "Rate must be positive");
+        return -1;
+    }
+
+    FILE* fp = fopen(in_file.c_str(), "rb");
+    if (fp == NULL) {
+        CONVERT_LOG(fatal, "Unable to open file " << in_file);
+        return -1;
+    }
+    MessageTraceWriter writer;
+    if (!writer.open(out_file)) {
+        fclose(fp);
+        return -1;
+    }
+
+    MessageTraceRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.size = size;
+    rec.sourcePort = OBJECT_PORT_PING;
+    rec.destPort = OBJECT_PORT_PING;
+
+    char line[1025];
+    line[1024] = '\0';
+    uint64 skipped = 0;
+    while (fgets(line, 1024, fp)) {
+        if (strlen(line) < UUIDLEN*2+1) continue;
+        try {
+            UUID s(String(line, UUIDLEN), UUID::HumanReadable());
+            UUID d(String(line+UUIDLEN+1, UUIDLEN), UUID::HumanReadable());
+            memcpy(rec.source, s.getArray().data(), UUID::static_size);
+            memcpy(rec.dest, d.getArray().data(), UUID::static_size);
+        }
+        catch(std::exception&) {
+            skipped++;
+            continue;
+        }
+        rec.time = (int64)(writer.size() * 1000000.0 / rate);
+        writer.write(rec);
+    }
+    fclose(fp);
+
+    uint64 count = writer.size();
+    if (!writer.close()) {
+        CONVERT_LOG(fatal, "Error writing " << out_file);
+        return -1;
+    }
+    CONVERT_LOG(info, "Converted " << count << " messages from " << in_file << " to " << out_file << ", skipped " << skipped << " invalid lines");
+    return 0;
+}
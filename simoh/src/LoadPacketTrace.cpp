@@ -38,6 +38,7 @@
 #include <sirikata/core/options/CommonOptions.hpp>
 #include "Options.hpp"
 #include "ConnectedObjectTracker.hpp"
+#include "MessageTrace.hpp"
 
 namespace Sirikata {
 void DPSInitOptions(LoadPacketTrace *thus) {
@@ -50,7 +51,12 @@ void DPSInitOptions(LoadPacketTrace *thus) {
         new OptionValue("flood-server","4",Sirikata::OptionValueType<uint32>(),"The index of the server to flood.  Defaults to 1 so it will work with all layouts. To flood all servers, specify 0."),
         new OptionValue("source-flood-server","false",Sirikata::OptionValueType<bool>(),"This makes the flood server the source of all the packets rather than the destination, so that we can validate that egress routing gets proper fairness."),
         new OptionValue("local","false",Sirikata::OptionValueType<bool>(),"If true, generated traffic will all be local, i.e. will all originate at the flood-server.  Otherwise, it will always originate from other servers."),
-        new OptionValue("tracefile","messagetrace",Sirikata::OptionValueType<String>(),"File that will store the traces in ascii with the source then destination object UUIDs separated by one character and ending with a newline of some sort"),
+        new OptionValue("tracefile","messagetrace",Sirikata::OptionValueType<String>(),"File that will store the traces in ascii with the source then destination object UUIDs separated by one character and ending with a newline of some sort, or a binary message trace as written by convertmsgtrace"),
+        new OptionValue("max-pings-per-round","40",Sirikata::OptionValueType<int64>(),"Maximum number of pings sent each time the ping poller runs"),
+        new OptionValue("replay-rate","1",Sirikata::OptionValueType<double>(),"For binary traces, speedup applied to the recorded message times, e.g. 2 replays twice as fast. 0 ignores the recorded times and sends num-pings-per-second, which should otherwise be at least the peak replay rate since it sizes the queue of pending messages."),
+        new OptionValue("replay-loop","true",Sirikata::OptionValueType<bool>(),"For binary traces, start over from the beginning when the end of the trace is reached"),
+        new OptionValue("replay-partitions","1",Sirikata::OptionValueType<uint32>(),"For binary traces, split messages by source object into this many partitions, so the trace can be replayed by multiple instances together"),
+        new OptionValue("replay-partition","0",Sirikata::OptionValueType<uint32>(),"For binary traces, the partition this instance replays"),
         NULL);
 }
 enum {UUIDLEN =36};
@@ -110,6 +116,14 @@ LoadPacketTrace::LoadPacketTrace(const String &options)
     mContext=NULL;
     mObjectTracker = NULL;
     mPingID=0;
+    mPacketTraceIndex=0;
+    mReplayTrace=NULL;
+    mReplayIndex=0;
+    mReplayLoopOffset=0;
+    mHasPendingPing=false;
+    mReplaySkipped=0;
+    mReplayDriftTotal=0;
+    mReplayDriftMax=0;
     DPSInitOptions(this);
     OptionSet* optionsSet = OptionSet::getOptions("LoadPacketTrace",this);
     optionsSet->parse(options);
@@ -121,6 +135,10 @@ LoadPacketTrace::LoadPacketTrace(const String &options)
     mSourceFloodServer = optionsSet->referenceOption("source-flood-server")->as<bool>();
     mNumObjectsPerServer=optionsSet->referenceOption("num-objects-per-server")->as<uint32>();
     mLocalTraffic = optionsSet->referenceOption("local")->as<bool>();
+    mReplayRate = optionsSet->referenceOption("replay-rate")->as<double>();
+    mReplayLoop = optionsSet->referenceOption("replay-loop")->as<bool>();
+    mReplayPartitions = std::max(optionsSet->referenceOption("replay-partitions")->as<uint32>(), (uint32)1);
+    mReplayPartition = optionsSet->referenceOption("replay-partition")->as<uint32>();
     mNumGeneratedPings = 0;
     mGeneratePingsStrand = NULL;
     mGeneratePingPoller = NULL;
@@ -134,7 +152,7 @@ LoadPacketTrace::LoadPacketTrace(const String &options)
     // on pings.  This allows us to burst to catch up when there is time (and
     // amortize the constant overhead of doing 1 round), but if
     // there is other work to be done we won't make our target rate.
-    mMaxPingsPerRound = 40;
+    mMaxPingsPerRound = optionsSet->referenceOption("max-pings-per-round")->as<int64>();
     // Do we want to vary this based on mNumPingsPerSecond? 20 is a decent
     // burst, but at 10k/s can take 2ms (we're seeing about 100us/ping
     // currently), which is potentially a long delay for other things in this
@@ -146,6 +164,12 @@ LoadPacketTrace::~LoadPacketTrace(){
     SILOG(loadpackettrace,fatal,
         "LoadPacketTrace: Generated: " << mNumGeneratedPings <<
         " Sent: " << mNumTotalPings);
+    if (mReplayTrace != NULL) {
+        reportReplay();
+        delete mReplayTrace;
+    }
+    if (mHasPendingPing)
+        delete mPendingPing.ping;
     delete mPings;
     delete mPingPoller;
     delete mPingProfiler;
@@ -165,15 +189,32 @@ void LoadPacketTrace::initialize(ObjectHostContext*ctx) {
     mContext=ctx;
     mObjectTracker = new ConnectedObjectTracker(mContext->objectHost);
 
+    if (MessageTraceReader::isMessageTrace(mPacketTraceFileName)) {
+        mReplayTrace = new MessageTraceReader();
+        if (!mReplayTrace->open(mPacketTraceFileName) || mReplayTrace->size() == 0) {
+            SILOG(loadpackettrace,error,"Unable to replay message trace " << mPacketTraceFileName << ", falling back to generated pairs");
+            delete mReplayTrace;
+            mReplayTrace = NULL;
+        }
+        else {
+            SILOG(loadpackettrace,info,"Replaying " << mReplayTrace->size() << " messages spanning " << mReplayTrace->duration()/1000000.0 << "s from " << mPacketTraceFileName);
+        }
+    }
+    // Replayed messages are sent at their own times, so just check for work
+    // often enough to keep the drift from the schedule low
+    Duration poll_period =
+        mReplayTrace != NULL && mReplayRate > 0 ? Duration::milliseconds((int64)1) :
+        mNumPingsPerSecond > 1000 ? // Try to amortize out some of the
+                                    // scheduling cost
+        Duration::seconds(10.0/mNumPingsPerSecond) :
+        Duration::seconds(1.0/mNumPingsPerSecond);
+
     mPingProfiler = mContext->profiler->addStage("Object Host Send Pings");
     mPingPoller = new Poller(
         ctx->mainStrand,
         std::tr1::bind(&LoadPacketTrace::sendPings, this),
         "LoadPacketTrace Ping Poller",
-        mNumPingsPerSecond > 1000 ? // Try to amortize out some of the
-                                    // scheduling cost
-        Duration::seconds(10.0/mNumPingsPerSecond) :
-        Duration::seconds(1.0/mNumPingsPerSecond)
+        poll_period
     );
 
     mGeneratePingProfiler = mContext->profiler->addStage("Object Host Generate Pings");
@@ -182,10 +223,7 @@ void LoadPacketTrace::initialize(ObjectHostContext*ctx) {
         mGeneratePingsStrand,
         std::tr1::bind(&LoadPacketTrace::generatePings, this),
         "LoadPacketTrace Generate Ping Poller",
-        mNumPingsPerSecond > 1000 ? // Try to amortize out some of the
-                                    // scheduling cost
-        Duration::seconds(10.0/mNumPingsPerSecond) :
-        Duration::seconds(1.0/mNumPingsPerSecond)
+        poll_period
     );
 }
 
@@ -235,6 +273,12 @@ bool LoadPacketTrace::generateOnePing(const Time& t, PingInfo* result) {
 void LoadPacketTrace::generatePings() {
     mGeneratePingProfiler->started();
 
+    if (mReplayTrace != NULL) {
+        generateReplayPings();
+        mGeneratePingProfiler->finished();
+        return;
+    }
+
     Time t=mContext->simTime();
     int64 howManyPings=((t-mStartTime).toSeconds()+0.25)*mNumPingsPerSecond;
 
@@ -258,6 +302,12 @@ void LoadPacketTrace::generatePings() {
 void LoadPacketTrace::sendPings() {
     mPingProfiler->started();
 
+    if (mReplayTrace != NULL) {
+        sendReplayPings();
+        mPingProfiler->finished();
+        return;
+    }
+
     Time newTime=mContext->simTime();
     int64 howManyPings = (newTime-mStartTime).toSeconds()*mNumPingsPerSecond;
 
@@ -290,4 +340,122 @@ void LoadPacketTrace::sendPings() {
 
 }
 
+
+Time LoadPacketTrace::replaySchedule(const MessageTraceRecord& rec) const {
+    // Without a rate, ignore the recorded times and just space the messages
+    // evenly
+    if (mReplayRate <= 0)
+        return mStartTime + Duration::seconds(mNumGeneratedPings / mNumPingsPerSecond);
+
+    int64 offset = rec.time - mReplayTrace->record(0).time + mReplayLoopOffset;
+    return mStartTime + Duration::microseconds((int64)(offset / mReplayRate));
+}
+
+void LoadPacketTrace::generateReplayPings() {
+    // Generate everything due in the next quarter second, the same lead the
+    // generated pairs get
+    Time horizon = mContext->simTime() + Duration::milliseconds((int64)250);
+
+    // Bound the work done in one round in case most of the trace is skipped
+    uint32 examined = 0;
+    while(examined < 10000) {
+        if (mReplayIndex >= mReplayTrace->size()) {
+            if (!mReplayLoop) break;
+            mReplayIndex = 0;
+            mReplayLoopOffset += mReplayTrace->duration() + 1;
+        }
+
+        const MessageTraceRecord& rec = mReplayTrace->record(mReplayIndex);
+        Time scheduled = replaySchedule(rec);
+        if (scheduled > horizon) break;
+        examined++;
+
+        UUID src = rec.sourceID(), dest = rec.destID();
+        if (mReplayPartitions > 1 && src.hash() % mReplayPartitions != mReplayPartition) {
+            mReplayIndex++;
+            continue;
+        }
+        // Messages from or to objects that aren't connected are dropped
+        Object* ss = mObjectTracker->getObject(src);
+        Object* dd = mObjectTracker->getObject(dest);
+        if (!(ss && dd && ss->connected() && dd->connected())) {
+            mReplaySkipped++;
+            mReplayIndex++;
+            continue;
+        }
+
+        PingInfo result;
+        if (!mPings->probablyCanPush(result))
+            break;
+        result.objA = src;
+        result.objB = dest;
+        result.dist = (float)mReplayIndex;
+        result.scheduled = scheduled;
+        result.srcPort = rec.sourcePort;
+        result.destPort = rec.destPort;
+        result.ping = new Sirikata::Protocol::Object::Ping();
+        mContext->objectHost->fillPing(result.dist, rec.size > 0 ? rec.size : mPingPayloadSize, result.ping);
+        if (!mPings->push(result, false)) {
+            delete result.ping;
+            break;
+        }
+
+        if (mNumGeneratedPings == 0)
+            mReplayFirstScheduled = scheduled;
+        mReplayLastScheduled = scheduled;
+        mReplayIndex++;
+        mNumGeneratedPings++;
+    }
+}
+
+void LoadPacketTrace::sendReplayPings() {
+    Time newTime = mContext->simTime();
+
+    int64 i;
+    for (i = 0; i < mMaxPingsPerRound; ++i) {
+        if (!mHasPendingPing) {
+            if (!mPings->pop(mPendingPing)) {
+                OH_LOG(insane,"Ping queue underflowed.");
+                break;
+            }
+            mHasPendingPing = true;
+        }
+        // Pings come off the queue in order, so nothing else is due either
+        if (mPendingPing.scheduled > newTime)
+            break;
+
+        Time t(mContext->simTime());
+        // If the send fails, hold on to the ping and try again next time so
+        // the delay shows up as drift
+        if (!mContext->objectHost->sendPing(t, mPendingPing.objA, mPendingPing.srcPort, mPendingPing.objB, mPendingPing.destPort, mPendingPing.ping))
+            break;
+
+        int64 drift = (t - mPendingPing.scheduled).toMicro();
+        mReplayDriftTotal += drift;
+        mReplayDriftMax = std::max(mReplayDriftMax, drift);
+        mReplayLastSent = t;
+        delete mPendingPing.ping;
+        mHasPendingPing = false;
+    }
+    mNumTotalPings += i;
+}
+
+void LoadPacketTrace::reportReplay() {
+    if (mNumTotalPings == 0) {
+        SILOG(loadpackettrace,fatal,"LoadPacketTrace: Replayed no messages, skipped " << mReplaySkipped);
+        return;
+    }
+
+    // Compare the rate we actually sent at with the rate the schedule asked
+    // for over the same messages
+    double sent_secs = (mReplayLastSent - mStartTime).toSeconds();
+    double scheduled_secs = (mReplayLastScheduled - mReplayFirstScheduled).toSeconds();
+    SILOG(loadpackettrace,fatal,
+        "LoadPacketTrace: Replayed " << mNumTotalPings << " messages, skipped " << mReplaySkipped <<
+        ", achieved rate " << (sent_secs > 0 ? mNumTotalPings / sent_secs : 0) << "/s" <<
+        ", scheduled rate " << (scheduled_secs > 0 ? mNumGeneratedPings / scheduled_secs : 0) << "/s" <<
+        ", mean drift " << (mReplayDriftTotal / mNumTotalPings) << "us" <<
+        ", max drift " << mReplayDriftMax << "us");
+}
+
 }
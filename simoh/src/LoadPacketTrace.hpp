@@ -42,6 +42,8 @@ namespace Sirikata {
 
 class ScenarioFactory;
 class ConnectedObjectTracker;
+class MessageTraceReader;
+struct MessageTraceRecord;
 class LoadPacketTrace : public Scenario {
     double mNumPingsPerSecond;
 
@@ -57,6 +59,11 @@ class LoadPacketTrace : public Scenario {
         UUID objB;
         float dist;
         Sirikata::Protocol::Object::Ping* ping;
+        // When replaying a binary trace, the time the message should be sent
+        // and the ports it's sent between
+        Time scheduled;
+        uint16 srcPort;
+        uint16 destPort;
     };
     Sirikata::SizedThreadSafeQueue<PingInfo,CountResourceMonitor>* mPings;
     int64 mNumGeneratedPings;
@@ -100,6 +107,33 @@ class LoadPacketTrace : public Scenario {
     unsigned int mPacketTraceIndex;
     std::string mPacketTraceFileName;
     void loadPacketTrace(const std::string &tracefile, std::vector<std::pair<UUID,UUID> >&retval);
+
+    // Binary traces are streamed from a memory mapped file instead of being
+    // loaded up front, and messages are sent at their recorded times.
+    MessageTraceReader* mReplayTrace;
+    double mReplayRate;
+    bool mReplayLoop;
+    uint32 mReplayPartitions;
+    uint32 mReplayPartition;
+    // Next record to generate a ping for
+    uint64 mReplayIndex;
+    // Added to record times each time the trace loops, in microseconds
+    int64 mReplayLoopOffset;
+    // A ping taken off the queue that isn't due to be sent yet
+    PingInfo mPendingPing;
+    bool mHasPendingPing;
+    // Replay statistics
+    int64 mReplaySkipped;
+    int64 mReplayDriftTotal;
+    int64 mReplayDriftMax;
+    Time mReplayFirstScheduled;
+    Time mReplayLastScheduled;
+    Time mReplayLastSent;
+
+    Time replaySchedule(const MessageTraceRecord& rec) const;
+    void generateReplayPings();
+    void sendReplayPings();
+    void reportReplay();
 public:
     LoadPacketTrace(const String &options);
     ~LoadPacketTrace();
@@ -0,0 +1,149 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "MessageTrace.hpp"
+
+#define MSGTRACE_LOG(lvl, msg) SILOG(messagetrace, lvl, msg)
+
+namespace Sirikata {
+
+namespace {
+const char MESSAGE_TRACE_MAGIC[8] = { 'S', 'I', 'R', 'M', 'S', 'G', 'T', 'R' };
+}
+
+MessageTraceReader::MessageTraceReader()
+ : mRecords(NULL),
+   mCount(0)
+{
+}
+
+MessageTraceReader::~MessageTraceReader() {
+    close();
+}
+
+bool MessageTraceReader::isMessageTrace(const String& filename) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) return false;
+    char magic[sizeof(MESSAGE_TRACE_MAGIC)];
+    bool result = (fread(magic, sizeof(magic), 1, fp) == 1 &&
+        memcmp(magic, MESSAGE_TRACE_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+    return result;
+}
+
+bool MessageTraceReader::open(const String& filename) {
+    close();
+
+    try {
+        mFile.open(filename);
+    }
+    catch(std::exception& e) {
+        MSGTRACE_LOG(error, "Unable to map message trace " << filename << ": " << e.what());
+        return false;
+    }
+    if (!mFile.is_open() || mFile.size() < sizeof(MessageTraceHeader)) {
+        MSGTRACE_LOG(error, "Message trace " << filename << " is too short");
+        close();
+        return false;
+    }
+
+    const MessageTraceHeader* header = reinterpret_cast<const MessageTraceHeader*>(mFile.data());
+    if (memcmp(header->magic, MESSAGE_TRACE_MAGIC, sizeof(MESSAGE_TRACE_MAGIC)) != 0) {
+        MSGTRACE_LOG(error, filename << " is not a message trace");
+        close();
+        return false;
+    }
+    if (header->byteOrder != MessageTraceHeader::BYTE_ORDER_MARK) {
+        MSGTRACE_LOG(error, "Message trace " << filename << " was written with a different byte order");
+        close();
+        return false;
+    }
+    if (header->version != MessageTraceHeader::VERSION || header->recordSize != sizeof(MessageTraceRecord)) {
+        MSGTRACE_LOG(error, "Unsupported message trace version " << header->version << " in " << filename);
+        close();
+        return false;
+    }
+
+    // Tolerate truncated traces, e.g. from a writer that didn't finish, by
+    // only using the complete records
+    uint64 available = (mFile.size() - sizeof(MessageTraceHeader)) / sizeof(MessageTraceRecord);
+    mCount = std::min(header->count, available);
+    if (mCount < header->count)
+        MSGTRACE_LOG(warning, "Message trace " << filename << " is truncated, using " << mCount << " of " << header->count << " records");
+    mRecords = reinterpret_cast<const MessageTraceRecord*>(mFile.data() + sizeof(MessageTraceHeader));
+    return true;
+}
+
+void MessageTraceReader::close() {
+    if (mFile.is_open())
+        mFile.close();
+    mRecords = NULL;
+    mCount = 0;
+}
+
+int64 MessageTraceReader::duration() const {
+    if (mCount == 0) return 0;
+    return mRecords[mCount-1].time - mRecords[0].time;
+}
+
+
+MessageTraceWriter::MessageTraceWriter()
+ : mFile(NULL),
+   mCount(0),
+   mFailed(false)
+{
+}
+
+MessageTraceWriter::~MessageTraceWriter() {
+    if (mFile != NULL)
+        close();
+}
+
+bool MessageTraceWriter::open(const String& filename) {
+    mFile = fopen(filename.c_str(), "wb");
+    if (mFile == NULL) {
+        MSGTRACE_LOG(error, "Unable to open " << filename << " for writing");
+        return false;
+    }
+    mCount = 0;
+    mFailed = false;
+
+    // Written again with the real count by close()
+    MessageTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESSAGE_TRACE_MAGIC, sizeof(MESSAGE_TRACE_MAGIC));
+    header.version = MessageTraceHeader::VERSION;
+    header.byteOrder = MessageTraceHeader::BYTE_ORDER_MARK;
+    header.recordSize = sizeof(MessageTraceRecord);
+    if (fwrite(&header, sizeof(header), 1, mFile) != 1)
+        mFailed = true;
+    return !mFailed;
+}
+
+void MessageTraceWriter::write(const MessageTraceRecord& rec) {
+    if (fwrite(&rec, sizeof(rec), 1, mFile) != 1)
+        mFailed = true;
+    else
+        mCount++;
+}
+
+bool MessageTraceWriter::close() {
+    if (mFile == NULL) return false;
+
+    MessageTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESSAGE_TRACE_MAGIC, sizeof(MESSAGE_TRACE_MAGIC));
+    header.version = MessageTraceHeader::VERSION;
+    header.byteOrder = MessageTraceHeader::BYTE_ORDER_MARK;
+    header.recordSize = sizeof(MessageTraceRecord);
+    header.count = mCount;
+    if (fseek(mFile, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, mFile) != 1)
+        mFailed = true;
+    if (fclose(mFile) != 0)
+        mFailed = true;
+    mFile = NULL;
+    return !mFailed;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,103 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SIMOH_MESSAGE_TRACE_HPP_
+#define _SIRIKATA_SIMOH_MESSAGE_TRACE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Noncopyable.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace Sirikata {
+
+/** A single message in a binary message trace. Records are fixed size and
+ *  stored in host byte order, directly after a MessageTraceHeader, sorted by
+ *  time.
+ */
+struct MessageTraceRecord {
+    // Microseconds since the start of the trace
+    int64 time;
+    // Raw UUID bytes of the source and destination objects
+    uint8 source[16];
+    uint8 dest[16];
+    // Size of the message payload in bytes
+    uint32 size;
+    uint16 sourcePort;
+    uint16 destPort;
+
+    UUID sourceID() const { return UUID(source, UUID::static_size); }
+    UUID destID() const { return UUID(dest, UUID::static_size); }
+};
+
+struct MessageTraceHeader {
+    enum {
+        VERSION = 1,
+        // Written as a uint32 so readers can detect traces written on a host
+        // with a different byte order
+        BYTE_ORDER_MARK = 0x01020304
+    };
+
+    char magic[8];
+    uint32 version;
+    uint32 byteOrder;
+    uint32 recordSize;
+    uint32 reserved;
+    uint64 count;
+};
+
+/** Reads a binary message trace by mapping it into memory, so traces much
+ *  larger than memory can be replayed: records are only paged in as they're
+ *  accessed. Records are accessed by index and must be read in order to
+ *  replay them at their recorded times.
+ */
+class MessageTraceReader : Noncopyable {
+public:
+    MessageTraceReader();
+    ~MessageTraceReader();
+
+    /** Returns true if the file looks like a binary message trace. */
+    static bool isMessageTrace(const String& filename);
+
+    /** Open a trace, returning false and logging the reason if it can't be
+     *  used.
+     */
+    bool open(const String& filename);
+    void close();
+
+    uint64 size() const { return mCount; }
+    const MessageTraceRecord& record(uint64 idx) const { return mRecords[idx]; }
+    /** Get the span of time covered by the trace, in microseconds. */
+    int64 duration() const;
+
+private:
+    boost::iostreams::mapped_file_source mFile;
+    const MessageTraceRecord* mRecords;
+    uint64 mCount;
+};
+
+/** Writes a binary message trace. Records must be appended in time order. */
+class MessageTraceWriter : Noncopyable {
+public:
+    MessageTraceWriter();
+    ~MessageTraceWriter();
+
+    bool open(const String& filename);
+    void write(const MessageTraceRecord& rec);
+    /** Finish writing the trace, filling in the record count. Returns false if
+     *  any writes failed.
+     */
+    bool close();
+
+    uint64 size() const { return mCount; }
+
+private:
+    FILE* mFile;
+    uint64 mCount;
+    bool mFailed;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SIMOH_MESSAGE_TRACE_HPP_
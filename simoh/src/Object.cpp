@@ -46,6 +46,8 @@
 #include "Protocol_Loc.pbj.hpp"
 
 #include <sirikata/core/odp/SST.hpp>
+#include <sirikata/core/network/Frame.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 
 #define OBJ_LOG(level,msg) SILOG(obj,level,msg)
 
@@ -251,6 +253,12 @@ void Object::handleSpaceStreamCreated() {
       sstStream->listenSubstream(OBJECT_PORT_PROXIMITY,
           std::tr1::bind(&Object::handleProximitySubstream, this, _1, _2)
       );
+      ODPSST::ConnectionPtr conn = sstStream->connection().lock();
+      if (conn) {
+          conn->registerReadDatagramCallback(OBJECT_PORT_LOCATION,
+              std::tr1::bind(&Object::handleLocationDatagram, this, _1, _2)
+          );
+      }
   }
 }
 
@@ -319,6 +327,18 @@ void Object::handleProximitySubstream(int err, SSTStreamPtr s) {
 }
 
 void Object::handleLocationSubstreamRead(SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length) {
+    // A long-lived location stream starts with a Network::Frame, whose length
+    // always has a zero high byte, where a single update would start with a
+    // Protocol::Frame.
+    if (prevdata->tellp() == 0 && length > 0 && buffer[0] == 0) {
+        delete prevdata;
+        std::tr1::shared_ptr<String> framedata(new String());
+        CompactLocUpdateDecoderPtr decoder(new CompactLocUpdateDecoder());
+        s->registerReadCallback( std::tr1::bind(&Object::handleLocationChannelRead, this, s, framedata, decoder, _1, _2) );
+        handleLocationChannelRead(s, framedata, decoder, buffer, length);
+        return;
+    }
+
     prevdata->write((const char*)buffer, length);
     if (locationMessage(prevdata->str())) {
         // FIXME we should be getting a callback on stream close instead of
@@ -331,6 +351,24 @@ void Object::handleLocationSubstreamRead(SSTStreamPtr s, std::stringstream* prev
     }
 }
 
+void Object::handleLocationChannelRead(SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length) {
+    prevdata->append((const char*)buffer, length);
+    while(true) {
+        std::string msg = Network::Frame::parse(*prevdata);
+        if (msg.empty()) return;
+        Sirikata::Protocol::Loc::BulkLocationUpdate contents;
+        if (!decoder->decode(msg, contents)) {
+            OBJ_LOG(error,"Failed to decode location update message");
+            continue;
+        }
+        bulkLocationMessage(contents);
+    }
+}
+
+void Object::handleLocationDatagram(uint8* buffer, int length) {
+    bulkLocationMessage(std::string((const char*)buffer, length));
+}
+
 void Object::handleProximitySubstreamRead(SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length) {
     prevdata->write((const char*)buffer, length);
     if (proximityMessage(prevdata->str())) {
@@ -348,12 +386,25 @@ bool Object::locationMessage(const std::string& payload) {
     Sirikata::Protocol::Frame frame;
     bool parse_success = frame.ParseFromString(payload);
     if (!parse_success) return false;
+    bulkLocationMessage(frame.payload());
+    return true;
+}
+
+void Object::bulkLocationMessage(const std::string& payload) {
     Sirikata::Protocol::Loc::BulkLocationUpdate contents;
-    parse_success = contents.ParseFromString(frame.payload());
-    assert(parse_success);
+    bool parse_success = contents.ParseFromString(payload);
+    if (!parse_success) {
+        OBJ_LOG(error,"Failed to decode location update message");
+        return;
+    }
+    bulkLocationMessage(contents);
+}
 
+void Object::bulkLocationMessage(const Sirikata::Protocol::Loc::BulkLocationUpdate& contents) {
     for(int32 idx = 0; idx < contents.update_size(); idx++) {
         Sirikata::Protocol::Loc::LocationUpdate update = contents.update(idx);
+        // Compact updates leave out unchanged properties
+        if (!update.has_location()) continue;
 
         Sirikata::Protocol::TimedMotionVector update_loc = update.location();
         TimedMotionVector3f loc(update_loc.t(), MotionVector3f(update_loc.position(), update_loc.velocity()));
@@ -366,7 +417,8 @@ bool Object::locationMessage(const std::string& payload) {
 
         // FIXME do something with the data
     }
-    return true;
+
+    mContext->objectHost->handleLocationUpdates(this, contents.update_size());
 }
 
 bool Object::proximityMessage(const std::string& payload) {
@@ -410,6 +462,8 @@ bool Object::proximityMessage(const std::string& payload) {
         }
     }
 
+    mContext->objectHost->handleProximityResults(this);
+
     return true;
 }
 
@@ -50,6 +50,7 @@
 #include <boost/thread/shared_mutex.hpp>
 
 #include <sirikata/oh/DisconnectCodes.hpp>
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
 
 namespace Sirikata {
 
@@ -147,8 +148,13 @@ private:
     // Handlers for substream read events for space-managed updates
     void handleLocationSubstreamRead(SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
     void handleProximitySubstreamRead(SSTStreamPtr s, std::stringstream* prevdata, uint8* buffer, int length);
+    // Handlers for long-lived location substreams and location datagrams
+    void handleLocationChannelRead(SSTStreamPtr s, std::tr1::shared_ptr<String> prevdata, CompactLocUpdateDecoderPtr decoder, uint8* buffer, int length);
+    void handleLocationDatagram(uint8* buffer, int length);
 
     bool locationMessage(const std::string& payload);
+    void bulkLocationMessage(const std::string& payload);
+    void bulkLocationMessage(const Sirikata::Protocol::Loc::BulkLocationUpdate& contents);
     bool proximityMessage(const std::string& payload);
 
     // Handle a new connection to a space -- initiate session
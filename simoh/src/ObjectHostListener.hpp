@@ -48,6 +48,8 @@ public:
     virtual void objectHostConnectedObject(ObjectHost* oh, Object* obj, const ServerID& server) {}
     virtual void objectHostMigratedObject(ObjectHost* oh, const UUID& objid, const ServerID& from_server, const ServerID& to_server) {}
     virtual void objectHostDisconnectedObject(ObjectHost* oh, Object* obj) {}
+    virtual void objectHostProximityResults(ObjectHost* oh, Object* obj) {}
+    virtual void objectHostLocationUpdates(ObjectHost* oh, Object* obj, uint32 count) {}
 };
 
 } // namespace Sirikata
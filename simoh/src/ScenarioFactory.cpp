@@ -41,6 +41,8 @@
 #include "UnreliableHitPointScenario.hpp"
 #include "OSegScenario.hpp"
 #include "AirTrafficControllerScenario.hpp"
+#include "ConnectStormScenario.hpp"
+#include "BenchmarkScenario.hpp"
 AUTO_SINGLETON_INSTANCE(Sirikata::ScenarioFactory);
 namespace Sirikata {
 ScenarioFactory::ScenarioFactory(){
@@ -54,6 +56,8 @@ ScenarioFactory::ScenarioFactory(){
     HitPointScenario::addConstructorToFactory(this);
     UnreliableHitPointScenario::addConstructorToFactory(this);
     AirTrafficControllerScenario::addConstructorToFactory(this);
+    ConnectStormScenario::addConstructorToFactory(this);
+    BenchmarkScenario::addConstructorToFactory(this);
 }
 ScenarioFactory::~ScenarioFactory(){}
 ScenarioFactory&ScenarioFactory::getSingleton(){
@@ -176,9 +176,13 @@ void ObjectHost::fillPing(double distance, uint32 payload_size, Sirikata::Protoc
 }
 
 bool ObjectHost::sendPing(const Time& t, const UUID& src, const UUID& dest, Sirikata::Protocol::Object::Ping* ping_msg) {
+    return sendPing(t, src, OBJECT_PORT_PING, dest, OBJECT_PORT_PING, ping_msg);
+}
+
+bool ObjectHost::sendPing(const Time& t, const UUID& src, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, Sirikata::Protocol::Object::Ping* ping_msg) {
     ping_msg->set_ping(t);
     String ping_serialized = serializePBJMessage(*ping_msg);
-    bool send_success = mSessionManager.send(SpaceObjectReference(SpaceID::null(),ObjectReference(src)), OBJECT_PORT_PING, dest, OBJECT_PORT_PING, ping_serialized);
+    bool send_success = mSessionManager.send(SpaceObjectReference(SpaceID::null(),ObjectReference(src)), src_port, dest, dest_port, ping_serialized);
 
     if (send_success)
         CONTEXT_OHTRACE_NO_TIME(pingCreated,
@@ -246,6 +250,14 @@ void ObjectHost::handleObjectMessage(const SpaceObjectReference& sporef_internal
     }
 }
 
+void ObjectHost::handleProximityResults(Object* obj) {
+    notify(&ObjectHostListener::objectHostProximityResults, this, obj);
+}
+
+void ObjectHost::handleLocationUpdates(Object* obj, uint32 count) {
+    notify(&ObjectHostListener::objectHostLocationUpdates, this, obj, count);
+}
+
 void ObjectHost::handleObjectDisconnected(const SpaceObjectReference& sporef_objid, Disconnect::Code) {
     notify(&ObjectHostListener::objectHostDisconnectedObject, this, mObjects[sporef_objid.object().getAsUUID()]);
 }
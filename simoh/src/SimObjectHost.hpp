@@ -100,6 +100,9 @@ public:
     // Given a ping message constructed with fillPing(), finish constructing and
     // send it. Must be called from main strand.
     bool sendPing(const Time& t, const UUID& src, const UUID& dest, Sirikata::Protocol::Object::Ping* pmsg);
+    // As above, but sends the ping between the given ports instead of the
+    // ping ports, e.g. to reproduce a recorded message trace.
+    bool sendPing(const Time& t, const UUID& src, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, Sirikata::Protocol::Object::Ping* pmsg);
     // Construct and send a ping.  May be expensive since it needs to be
     // performed in main strand.
     bool ping(const Time& t, const UUID& src, const UUID&dest, double distance, uint32 payload_size);
@@ -111,6 +114,12 @@ public:
     ///Unregister to intercept all incoming messages on a given port
     bool unregisterService(uint64 port);
 
+    /// Invoked by objects when they receive a set of proximity results.
+    void handleProximityResults(Object* obj);
+    /// Invoked by objects when they receive a message with count location
+    /// updates.
+    void handleLocationUpdates(Object* obj, uint32 count);
+
 private:
     void dispatchConnectedCallback(const SpaceID& space, const ObjectReference& objid, const SessionManager::ConnectionInfo& ci, ConnectedCallback cb);
 
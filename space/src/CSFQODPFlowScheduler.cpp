@@ -31,7 +31,6 @@
  */
 
 #include "CSFQODPFlowScheduler.hpp"
-#include <sirikata/space/LocationService.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 #include <sirikata/core/util/Random.hpp>
 #include <sirikata/core/trace/Trace.hpp>
@@ -43,6 +42,9 @@
 #define _Ka (Duration::milliseconds((int64)200))
 #define _Ka_double (_Ka.toSeconds())
 
+// Flows idle this long have decayed to a negligible rate estimate
+#define _Kidle (Duration::milliseconds((int64)30000))
+
 #define KALPHA 29 // Max times fair rate can be decreased during interval
 
 #define CSFQLOG(level, msg) SILOG(csfqodp,level, mContext->id() << "->" << mDestServer << ": " << msg)
@@ -65,13 +67,24 @@ CSFQODPFlowScheduler::CSFQODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQu
    mCongestionStartTime(Time::null()),
    mCongestionWindow(_Kcwin),
    mKAlphaReductionsLeft(KALPHA),
+   mRegionCache(new RegionCache(loc)),
    mTotalActiveWeight(0)
 {
     for(int i = 0; i < NUM_DOWNSTREAM; i++)
         mTotalUsedWeight[i] = 0.0;
+
+    mContext->mainStrand->post(
+        std::tr1::bind(&RegionCache::addListener, mRegionCache),
+        "CSFQODPFlowScheduler::RegionCache::addListener"
+    );
 }
 
 CSFQODPFlowScheduler::~CSFQODPFlowScheduler() {
+    mContext->mainStrand->post(
+        std::tr1::bind(&RegionCache::removeListener, mRegionCache),
+        "CSFQODPFlowScheduler::RegionCache::removeListener"
+    );
+
 #ifdef CSFQODP_DEBUG
     CSFQLOG(warn,"Flow");
     for(FlowMap::iterator flow_it = mFlows.begin(); flow_it != mFlows.end(); flow_it++) {
@@ -95,7 +108,10 @@ bool CSFQODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg,
 
     ObjectPair op(msg->source_object(), msg->dest_object());
     Time curtime = mContext->recentSimTime();
+    expireIdleFlows(curtime);
     FlowInfo* flow_info = getFlow(op,source_entry,dest_entry, curtime);
+    flow_info->lastActive = curtime;
+    mFlowActivity.splice(mFlowActivity.end(), mFlowActivity, flow_info->activity);
 
     // FIXME update weights, due to possible movement?
     double weight = flow_info->weight;
@@ -348,14 +364,11 @@ float CSFQODPFlowScheduler::totalReceiverUsedWeight() {
     return mTotalUsedWeight[RECEIVER];
 }
 
-BoundingBox3f CSFQODPFlowScheduler::getObjectWeightRegion(const UUID& objid, const OSegEntry& info) const {
+BoundingBox3f CSFQODPFlowScheduler::getObjectWeightRegion(const UUID& objid, const OSegEntry& info) {
     // We might have exact info
-    if (mLoc->contains(objid)) {
-        Vector3f pos = mLoc->currentPosition(objid);
-        BoundingSphere3f bounds = mLoc->bounds(objid).fullBounds();
-        BoundingBox3f bb(pos + bounds.center(), bounds.radius());
-        return bb;
-    }
+    BoundingBox3f exact;
+    if (mRegionCache->lookup(objid, &exact))
+        return exact;
 
     if (info.server() == mContext->id())
         CSFQLOG(warn,"Using approximation for local object!");
@@ -387,6 +400,7 @@ CSFQODPFlowScheduler::FlowInfo* CSFQODPFlowScheduler::getFlow(const ObjectPair&
             mTotalUsedWeight[i] += weight;
 
         where = ins_it.first;
+        where->second.activity = mFlowActivity.insert(mFlowActivity.end(), new_packet_pair);
     }
     return &(where->second);
 }
@@ -394,15 +408,40 @@ CSFQODPFlowScheduler::FlowInfo* CSFQODPFlowScheduler::getFlow(const ObjectPair&
 void CSFQODPFlowScheduler::removeFlow(const ObjectPair& packet_pair) {
     FlowMap::iterator where = mFlows.find(packet_pair);
     assert(where != mFlows.end());
-    assert(0);
     FlowInfo* fi = &(where->second);
+    mSumEstimatedArrivalRates -= fi->rate.get();
     mTotalActiveWeight -= fi->weight;
     for(int i = 0; i < NUM_DOWNSTREAM; i++)
         mTotalUsedWeight[i] -= fi->usedWeight[i];
+    mFlowActivity.erase(fi->activity);
     fi = NULL;
     mFlows.erase(where);
 }
 
+void CSFQODPFlowScheduler::expireIdleFlows(const Time& t) {
+    bool removed = false;
+    while(!mFlowActivity.empty()) {
+        ObjectPair op = mFlowActivity.front();
+        FlowMap::iterator oldest = mFlows.find(op);
+        assert(oldest != mFlows.end());
+        if (t - oldest->second.lastActive <= _Kidle)
+            break;
+        removeFlow(op);
+        removed = true;
+    }
+    if (!removed)
+        return;
+
+    // Avoid accumulating floating point error in the running sums once
+    // everything has drained.
+    if (mFlows.empty()) {
+        mSumEstimatedArrivalRates = 0;
+        mTotalActiveWeight = 0;
+        for(int i = 0; i < NUM_DOWNSTREAM; i++)
+            mTotalUsedWeight[i] = 0.0;
+    }
+}
+
 int CSFQODPFlowScheduler::flowCount() const {
     return mFlows.size();
 }
@@ -414,4 +453,85 @@ float CSFQODPFlowScheduler::normalizedFlowWeight(float unnorm_weight) {
     return unnorm_weight / mTotalActiveWeight;
 }
 
+
+CSFQODPFlowScheduler::RegionCache::RegionCache(LocationService* loc)
+ : mLoc(loc)
+{
+}
+
+void CSFQODPFlowScheduler::RegionCache::addListener() {
+    mLoc->addListener(this, false);
+}
+
+void CSFQODPFlowScheduler::RegionCache::removeListener() {
+    mLoc->removeListener(this);
+}
+
+bool CSFQODPFlowScheduler::RegionCache::lookup(const UUID& objid, BoundingBox3f* region_out) {
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        RegionMap::iterator it = mRegions.find(objid);
+        if (it != mRegions.end()) {
+            *region_out = it->second;
+            return true;
+        }
+        // Note the lookup so an invalidation that arrives while we're asking
+        // LocationService keeps us from caching a stale region
+        mPending[objid].refs++;
+    }
+
+    // LocationService may call into our listener methods, so it must be
+    // called without the lock held
+    bool found = mLoc->contains(objid);
+    if (found) {
+        Vector3f pos = mLoc->currentPosition(objid);
+        BoundingSphere3f bounds = mLoc->bounds(objid).fullBounds();
+        *region_out = BoundingBox3f(pos + bounds.center(), bounds.radius());
+    }
+
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    PendingMap::iterator pending_it = mPending.find(objid);
+    assert(pending_it != mPending.end());
+    bool valid = !pending_it->second.invalidated;
+    if (--pending_it->second.refs == 0)
+        mPending.erase(pending_it);
+    if (found && valid)
+        mRegions[objid] = *region_out;
+    return found;
+}
+
+void CSFQODPFlowScheduler::RegionCache::invalidate(const UUID& objid) {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    mRegions.erase(objid);
+    PendingMap::iterator pending_it = mPending.find(objid);
+    if (pending_it != mPending.end())
+        pending_it->second.invalidated = true;
+}
+
+LocationServiceListener::RemovalStatus CSFQODPFlowScheduler::RegionCache::localObjectRemoved(const UUID& uuid, bool agg, const LocationServiceListener::RemovalCallback& callback) {
+    invalidate(uuid);
+    return IMMEDIATE;
+}
+
+void CSFQODPFlowScheduler::RegionCache::localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
+    invalidate(uuid);
+}
+
+void CSFQODPFlowScheduler::RegionCache::localBoundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval) {
+    invalidate(uuid);
+}
+
+LocationServiceListener::RemovalStatus CSFQODPFlowScheduler::RegionCache::replicaObjectRemoved(const UUID& uuid) {
+    invalidate(uuid);
+    return IMMEDIATE;
+}
+
+void CSFQODPFlowScheduler::RegionCache::replicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval) {
+    invalidate(uuid);
+}
+
+void CSFQODPFlowScheduler::RegionCache::replicaBoundsUpdated(const UUID& uuid, const AggregateBoundingInfo& newval) {
+    invalidate(uuid);
+}
+
 } // namespace Sirikata
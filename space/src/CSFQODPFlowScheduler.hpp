@@ -37,15 +37,17 @@
 #include <sirikata/core/queue/Queue.hpp>
 #include "RateEstimator.hpp"
 #include <sirikata/core/queue/SizedThreadSafeQueue.hpp>
+#include <sirikata/space/LocationService.hpp>
 
 //#define CSFQODP_DEBUG
 
 namespace Sirikata {
 
-class LocationService;
-
 /** CSFQODPFlowScheduler tracks all active flows and uses a CSFQ-style
- *  approach to enforce fairness over those flows.
+ *  approach to enforce fairness over those flows. Flows which haven't seen
+ *  traffic for a while are aged out of the flow table, and the regions used
+ *  to compute flow weights for local objects are cached until
+ *  LocationService reports that they have changed.
  */
 class CSFQODPFlowScheduler : public ODPFlowScheduler {
 public:
@@ -71,6 +73,57 @@ public:
     virtual float totalReceiverUsedWeight();
 private:
 
+    /** Exact regions for objects LocationService knows about. Filled in by
+     *  pushes (network threads) and invalidated by location updates (main
+     *  strand), so it has its own lock. The lock is never held while calling
+     *  into LocationService.
+     *
+     *  Schedulers may be created and destroyed from any thread, but
+     *  LocationService listeners are only managed from the main strand. The
+     *  cache is the listener instead of the scheduler: adding and removing it
+     *  are both posted to the main strand, in order, and each post holds a
+     *  reference, so it stays alive until it has been removed.
+     */
+    class RegionCache : public LocationServiceListener {
+    public:
+        RegionCache(LocationService* loc);
+
+        // Must be invoked on the main strand
+        void addListener();
+        void removeListener();
+
+        /** Get the exact region for an object, computing and caching it if
+         *  LocationService knows about the object. Returns false if it
+         *  doesn't.
+         */
+        bool lookup(const UUID& objid, BoundingBox3f* region_out);
+
+        // LocationServiceListener Interface
+        virtual LocationServiceListener::RemovalStatus localObjectRemoved(const UUID& uuid, bool agg, const LocationServiceListener::RemovalCallback& callback);
+        virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval);
+        virtual void localBoundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval);
+        virtual LocationServiceListener::RemovalStatus replicaObjectRemoved(const UUID& uuid);
+        virtual void replicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval);
+        virtual void replicaBoundsUpdated(const UUID& uuid, const AggregateBoundingInfo& newval);
+    private:
+        void invalidate(const UUID& objid);
+
+        LocationService* mLoc;
+        typedef std::tr1::unordered_map<UUID, BoundingBox3f, UUID::Hasher> RegionMap;
+        RegionMap mRegions;
+        // Lookups that are waiting on LocationService, and whether the
+        // object's region was invalidated while they were
+        struct PendingLookup {
+            PendingLookup() : refs(0), invalidated(false) {}
+            uint32 refs;
+            bool invalidated;
+        };
+        typedef std::tr1::unordered_map<UUID, PendingLookup, UUID::Hasher> PendingMap;
+        PendingMap mPending;
+        boost::mutex mMutex;
+    };
+    typedef std::tr1::shared_ptr<RegionCache> RegionCachePtr;
+
     enum {
         SENDER = 0,
         RECEIVER = 1,
@@ -93,7 +146,7 @@ private:
         class Hasher {
         public:
             size_t operator() (const ObjectPair& op) const {
-                return *(uint32*)op.source.getArray().data() ^ *(uint32*)op.dest.getArray().data();
+                return UUID::hash(op.source, op.dest);
             }
         };
 
@@ -101,10 +154,14 @@ private:
         UUID dest;
     };
 
+    // Flows ordered from least to most recently active
+    typedef std::list<ObjectPair> FlowActivityList;
+
     struct FlowInfo {
         FlowInfo(double w, const Time& start)
          : rate(0.0, start),
-           weight(w)
+           weight(w),
+           lastActive(start)
 #ifdef CSFQODP_DEBUG
            ,
            arrived(0),
@@ -118,6 +175,9 @@ private:
         RateEstimator rate;
         double weight;
         double usedWeight[NUM_DOWNSTREAM];
+        Time lastActive;
+        // This flow's entry in mFlowActivity
+        FlowActivityList::iterator activity;
 #ifdef CSFQODP_DEBUG
         uint64 arrived;
         uint64 accepted;
@@ -143,6 +203,9 @@ private:
 
     FlowInfo* getFlow(const ObjectPair& new_packet_pair, const OSegEntry&src_info, const OSegEntry&dst_info, const Time& t);
     void removeFlow(const ObjectPair& packet_pair);
+    // Remove flows which haven't had any traffic in the idle timeout. Only
+    // looks at the least recently active flows. Requires mPushMutex.
+    void expireIdleFlows(const Time& t);
     int flowCount() const;
     float normalizedFlowWeight(float unnorm_weight);
 
@@ -151,7 +214,7 @@ private:
     double minCongestedAlpha() const { return mCapacityRate.get() / std::max(1, flowCount()); }
 
     // Helper to get the region we compute weight over
-    BoundingBox3f getObjectWeightRegion(const UUID& objid, const OSegEntry& sid) const;
+    BoundingBox3f getObjectWeightRegion(const UUID& objid, const OSegEntry& sid);
 
 
     boost::mutex mPushMutex;
@@ -182,6 +245,8 @@ private:
     // Per Flow Information
     typedef std::tr1::unordered_map<ObjectPair, FlowInfo, ObjectPair::Hasher> FlowMap;
     FlowMap mFlows;
+    FlowActivityList mFlowActivity;
+    RegionCachePtr mRegionCache;
     // Flow Summary Information
     double mTotalActiveWeight;
     double mTotalUsedWeight[NUM_DOWNSTREAM];
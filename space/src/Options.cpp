@@ -42,7 +42,7 @@ void InitSpaceOptions() {
         .addOption(new OptionValue(OPT_CONFIG_FILE,"space.cfg",Sirikata::OptionValueType<String>(),"Configuration file to load."))
 
         .addOption(new OptionValue(OPT_SPACE_PLUGINS,
-                "weight-exp,weight-sqr,weight-const,space-null,space-local,space-standard,space-prox,colladamodels,mesh-billboard,mesh-ply,common-filters,space-bulletphysics,space-environment,nvtt"
+                "weight-exp,weight-sqr,weight-const,space-null,space-local,space-standard,space-prox,colladamodels,mesh-billboard,mesh-ply,mesh-binary,common-filters,space-bulletphysics,space-environment,nvtt"
 #if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
                 ",space-redis"
 #endif
@@ -98,6 +98,11 @@ void InitSpaceOptions() {
         .addOption(new OptionValue(OPT_PROX_OPTIONS, "", Sirikata::OptionValueType<String>(), "Arguments to pass to Proximity query processor. Note that many common options are already provided (type of top-level service, type of server-to-server and object-to-server handlers, etc) so they do not need to be passed through."))
 
       .addOption(new OptionValue("route-object-message-buffer", "64", Sirikata::OptionValueType<size_t>(), "size of the buffer between network and main strand for space server message routing"))
+      .addOption(new OptionValue(OPT_SERVER_SHARDS, "1", Sirikata::OptionValueType<uint32>(), "Number of strands per-object session handling and routing checks are split across. 1 keeps everything on the main strand."))
+      .addOption(new OptionValue(OPT_CONNECT_QUEUE_SIZE, "10000", Sirikata::OptionValueType<uint32>(), "Maximum number of object connection requests waiting for authentication. Requests beyond this are dropped without a reply, and the object host retries them when its connect attempt times out."))
+      .addOption(new OptionValue(OPT_CONNECT_BATCH_SIZE, "100", Sirikata::OptionValueType<uint32>(), "Maximum number of connection requests passed to the authenticator at once."))
+      .addOption(new OptionValue(OPT_CONNECT_RATE, "1000", Sirikata::OptionValueType<float64>(), "Connection requests admitted per second per object host. 0 disables rate limiting."))
+      .addOption(new OptionValue(OPT_CONNECT_BURST, "200", Sirikata::OptionValueType<float64>(), "Number of connection requests an object host may burst above connect.rate."))
 
         .addOption(new OptionValue(OPT_MODULES, "environment", Sirikata::OptionValueType< std::vector<String> >(), "Additional SpaceModules to load"))
 
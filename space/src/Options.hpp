@@ -73,6 +73,13 @@
 
 #define OSEG_LOOKUP_QUEUE_SIZE     "oseg_lookup_queue_size"
 
+#define OPT_SERVER_SHARDS          "server-shards"
+
+#define OPT_CONNECT_QUEUE_SIZE     "connect.queue-size"
+#define OPT_CONNECT_BATCH_SIZE     "connect.batch-size"
+#define OPT_CONNECT_RATE           "connect.rate"
+#define OPT_CONNECT_BURST          "connect.burst"
+
 #define OPT_PROX                   "prox"
 #define OPT_PROX_OPTIONS           "prox-options"
 
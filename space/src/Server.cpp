@@ -37,6 +37,7 @@
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/core/trace/Trace.hpp>
 #include <sirikata/core/options/CommonOptions.hpp>
+#include "Options.hpp"
 #include <sirikata/space/Authenticator.hpp>
 #include "Forwarder.hpp"
 #include "LocalForwarder.hpp"
@@ -94,13 +95,40 @@ Server::Server(SpaceContext* ctx, Authenticator* auth, Forwarder* forwarder, Loc
    mMigrationSendRunning(false),
    mShutdownRequested(false),
    mObjectHostConnectionManager(NULL),
-   mRouteObjectMessage(Sirikata::SizedResourceMonitor(GetOptionValue<size_t>("route-object-message-buffer"))),
-   mTimeSeriesObjects(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".objects")
+   mPendingConnectsCount(0),
+   mPendingConnectsMax(GetOptionValue<uint32>(OPT_CONNECT_QUEUE_SIZE)),
+   mAdmitBatchSize(std::max(GetOptionValue<uint32>(OPT_CONNECT_BATCH_SIZE), (uint32)1)),
+   mAdmitScheduled(false),
+   mConnectRate(GetOptionValue<float64>(OPT_CONNECT_RATE)),
+   mConnectBurst(std::max(GetOptionValue<float64>(OPT_CONNECT_BURST), 1.0)),
+   mOSegFlushScheduled(false),
+   mRoutedMessages(0),
+   mRouteLatencyTotal(Duration::zero()),
+   mTimeSeriesObjects(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".objects"),
+   mTimeSeriesRouteLatency(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".route_latency"),
+   mTimeSeriesConnectQueue(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".connect_queue"),
+   mTimeSeriesTimeToConnected(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".time_to_connected")
 {
     using std::tr1::placeholders::_1;
     using std::tr1::placeholders::_2;
     using std::tr1::placeholders::_3;
 
+    // With a single shard everything stays on the main strand, as it always
+    // has. Otherwise each shard gets its own strand.
+    uint32 nshards = std::max(GetOptionValue<uint32>(OPT_SERVER_SHARDS), (uint32)1);
+    size_t route_buffer_size = GetOptionValue<size_t>("route-object-message-buffer");
+    for(uint32 i = 0; i < nshards; i++) {
+        if (nshards == 1) {
+            mShards.push_back(new ObjectShard(mContext->mainStrand, false, route_buffer_size));
+        }
+        else {
+            Network::IOStrand* strand = mContext->ioService->createStrand(
+                String("Server Object Shard ") + boost::lexical_cast<String>(i)
+            );
+            mShards.push_back(new ObjectShard(strand, true, route_buffer_size));
+        }
+    }
+
     mTimeSyncServer = new TimeSyncServer(mContext, this);
 
     mMigrateServerMessageService = mForwarder->createServerMessageService("migrate");
@@ -159,6 +187,34 @@ Server::Server(SpaceContext* ctx, Authenticator* auth, Forwarder* forwarder, Loc
     }
 }
 
+Server::ObjectShard::ObjectShard(Network::IOStrand* _strand, bool _owns_strand, size_t route_buffer_size)
+ : strand(_strand),
+   ownsStrand(_owns_strand),
+   routeQueue(Sirikata::SizedResourceMonitor(route_buffer_size))
+{
+}
+
+Server::ObjectShard::~ObjectShard() {
+    if (ownsStrand)
+        delete strand;
+}
+
+size_t Server::numObjects() const {
+    size_t count = 0;
+    for(ObjectShardList::const_iterator it = mShards.begin(); it != mShards.end(); it++) {
+        boost::lock_guard<boost::mutex> lock((*it)->mutex);
+        count += (*it)->objects.size();
+    }
+    return count;
+}
+
+ObjectConnection* Server::findObjectConnection(const UUID& obj_id) const {
+    ObjectShard* shard = objectShard(obj_id);
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    ObjectConnectionMap::const_iterator it = shard->objects.find(obj_id);
+    return (it == shard->objects.end()) ? NULL : it->second;
+}
+
 void Server::newStream(int err, SST::Stream<SpaceObjectReference>::Ptr s) {
   if (err != SST_IMPL_SUCCESS){
     return;
@@ -166,7 +222,7 @@ void Server::newStream(int err, SST::Stream<SpaceObjectReference>::Ptr s) {
 
   // If we've lost the object's connection, we should just ignore this
   ObjectReference objid = s->remoteEndPoint().endPoint.object();
-  if (mObjects.find(objid.getAsUUID()) == mObjects.end()) {
+  if (!isObjectConnected(objid.getAsUUID())) {
       s->close(false);
       return;
   }
@@ -181,23 +237,26 @@ Server::~Server()
 
     mForwarder->unregisterMessageRecipient(SERVER_PORT_MIGRATION, this);
 
-    SPACE_LOG(debug, "mObjects.size=" << mObjects.size());
+    SPACE_LOG(debug, "mObjects.size=" << numObjects());
 
-    for(ObjectConnectionMap::iterator it = mObjects.begin(); it != mObjects.end(); it++) {
-        UUID obj_id = it->first;
+    for(ObjectShardList::iterator shard_it = mShards.begin(); shard_it != mShards.end(); shard_it++) {
+        ObjectShard* shard = *shard_it;
+        for(ObjectConnectionMap::iterator it = shard->objects.begin(); it != shard->objects.end(); it++) {
+            UUID obj_id = it->first;
 
-        // Stop any proximity queries for this object
-        mProximity->removeQuery(obj_id,&nop);
+            // Stop any proximity queries for this object
+            mProximity->removeQuery(obj_id,&nop);
 
-        mLocationService->removeLocalObject(obj_id,&nop);
+            mLocationService->removeLocalObject(obj_id,&nop);
 
-        // Stop Forwarder from delivering via this Object's
-        // connection, destroy said connection
-        mForwarder->removeObjectConnection(obj_id);
+            // Stop Forwarder from delivering via this Object's
+            // connection, destroy said connection
+            mForwarder->removeObjectConnection(obj_id);
 
-        // FIXME there's probably quite a bit more cleanup to do here
+            // FIXME there's probably quite a bit more cleanup to do here
+        }
+        shard->objects.clear();
     }
-    mObjects.clear();
 
     delete mObjectHostConnectionManager;
     delete mLocalForwarder;
@@ -205,6 +264,10 @@ Server::~Server()
     delete mMigrationMonitor;
 
     delete mTimeSyncServer;
+
+    for(ObjectShardList::iterator shard_it = mShards.begin(); shard_it != mShards.end(); shard_it++)
+        delete *shard_it;
+    mShards.clear();
 }
 
 ODP::DelegatePort* Server::createDelegateODPPort(ODP::DelegateService*, const SpaceObjectReference& sor, ODP::PortID port) {
@@ -285,18 +348,22 @@ bool Server::delegateOHDPPortSend(const OHDP::Endpoint& source_ep, const OHDP::E
 }
 
 bool Server::isObjectConnected(const UUID& object_id) const {
-    return (mObjects.find(object_id) != mObjects.end());
+    ObjectShard* shard = objectShard(object_id);
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    return (shard->objects.find(object_id) != shard->objects.end());
 }
 
 bool Server::isObjectConnecting(const UUID& object_id) const {
-    return (mStoredConnectionData.find(object_id) != mStoredConnectionData.end());
+    ObjectShard* shard = objectShard(object_id);
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    return (shard->storedConnectionData.find(object_id) != shard->storedConnectionData.end());
 }
 bool Server::isObjectDisconnecting(const UUID& object_id) const {
-    boost::lock_guard<boost::mutex> lock(const_cast<boost::mutex&>(mRouteObjectMessageMutex));
+    boost::lock_guard<boost::mutex> lock(const_cast<boost::mutex&>(mDisconnectingObjectsMutex));
     return mDisconnectingObjects.find(object_id)!=mDisconnectingObjects.end();
 }
 bool Server::markObjectDisconnecting(const UUID& object_id, int serviceCount) {
-    boost::lock_guard<boost::mutex> lock(mRouteObjectMessageMutex);
+    boost::lock_guard<boost::mutex> lock(mDisconnectingObjectsMutex);
     DisconnectingObjectMap::iterator where = mDisconnectingObjects.find(object_id);
     if (where==mDisconnectingObjects.end()) {
         mDisconnectingObjects[object_id]=serviceCount;
@@ -307,7 +374,7 @@ bool Server::markObjectDisconnecting(const UUID& object_id, int serviceCount) {
 }
 
 void Server::markObjectDisconnectedCallback(UUID object){
-    boost::lock_guard<boost::mutex> lock(mRouteObjectMessageMutex);
+    boost::lock_guard<boost::mutex> lock(mDisconnectingObjectsMutex);
     DisconnectingObjectMap::iterator where = mDisconnectingObjects.find(object);
     assert(where!=mDisconnectingObjects.end());
     where->second--;
@@ -358,7 +425,8 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
         bool space_dest = (obj_msg->dest_object() == spaceID);
 
         // FIXME infinite queue
-        mContext->mainStrand->post(
+        ObjectShard* shard = objectShard(obj_msg->source_object());
+        shard->strand->post(
 // As a debugging tool for session messages, we can introduce delay in the
 // handling of session messages as a compile-time constant
 #ifdef SIRIKATA_SPACE_DELAY_HANDLE_SESSION_MESSAGE
@@ -366,7 +434,7 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
 #endif
             std::tr1::bind(
                 &Server::handleSessionMessage, this,
-                conn_id, obj_msg
+                shard, conn_id, obj_msg
             ),
             "Server::handleSessionMessage"
         );
@@ -386,15 +454,17 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
     if (mForwarder->tryCacheForward(obj_msg))
         return true;
 
-    // 5. Otherwise, we're going to have to ship this to the main thread, either
-    // for handling session messages, messages to the space, or to make a
-    // routing decision.
+    // 5. Otherwise, we're going to have to ship this to the main strand,
+    // either for handling messages to the space, or to make a routing
+    // decision. Queues are per-shard so network threads don't all contend on
+    // one lock.
+    ObjectShard* shard = objectShard(obj_msg->source_object());
     bool hit_empty;
     bool push_for_processing_success;
     {
-        boost::lock_guard<boost::mutex> lock(mRouteObjectMessageMutex);
-        hit_empty = (mRouteObjectMessage.probablyEmpty());
-        push_for_processing_success = mRouteObjectMessage.push(ConnectionIDObjectMessagePair(conn_id,obj_msg),false);
+        boost::lock_guard<boost::mutex> lock(shard->routeMutex);
+        hit_empty = (shard->routeQueue.probablyEmpty());
+        push_for_processing_success = shard->routeQueue.push(ConnectionIDObjectMessagePair(conn_id,obj_msg,Timer::now()),false);
     }
     if (!push_for_processing_success) {
         TIMESTAMP(obj_msg, Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING);
@@ -402,7 +472,7 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
         delete obj_msg;
     } else {
         if (hit_empty)
-            scheduleObjectHostMessageRouting();
+            scheduleObjectHostMessageRouting(shard);
     }
 
     // NOTE: We always "accept" the data, even if we're just dropping
@@ -426,32 +496,43 @@ void Server::onObjectHostDisconnected(const ObjectHostConnectionID& oh_conn_id,
     mOHSessionManager->fireObjectHostSessionEnded( OHDP::NodeID(short_conn_id) );
 }
 
-void Server::scheduleObjectHostMessageRouting() {
+void Server::scheduleObjectHostMessageRouting(ObjectShard* shard) {
     mContext->mainStrand->post(
         std::tr1::bind(
             &Server::handleObjectHostMessageRouting,
-            this),
+            this, shard),
         "Server::handleObjectHostMessageRouting"
     );
 }
 
-void Server::handleObjectHostMessageRouting() {
+void Server::handleObjectHostMessageRouting(ObjectShard* shard) {
 #define MAX_OH_MESSAGES_HANDLED 100
 
+    Time now = Timer::now();
+    uint32 routed = 0;
+    Duration latency = Duration::zero();
     for(uint32 i = 0; i < MAX_OH_MESSAGES_HANDLED; i++)
-        if (!handleSingleObjectHostMessageRouting())
+        if (!handleSingleObjectHostMessageRouting(shard, now, &routed, &latency))
             break;
 
+    // Time from a message being pushed onto the shard's queue to it being
+    // handed to the forwarder, i.e. what main strand contention costs.
+    if (routed > 0) {
+        mRoutedMessages += routed;
+        mRouteLatencyTotal += latency;
+        mContext->timeSeries->report(mTimeSeriesRouteLatency, (latency / (float64)routed).toSeconds());
+    }
+
     {
-        boost::lock_guard<boost::mutex> lock(mRouteObjectMessageMutex);
-        if (!mRouteObjectMessage.probablyEmpty())
-            scheduleObjectHostMessageRouting();
+        boost::lock_guard<boost::mutex> lock(shard->routeMutex);
+        if (!shard->routeQueue.probablyEmpty())
+            scheduleObjectHostMessageRouting(shard);
     }
 }
 
-bool Server::handleSingleObjectHostMessageRouting() {
-    ConnectionIDObjectMessagePair front(ObjectHostConnectionID(),NULL);
-    if (!mRouteObjectMessage.pop(front))
+bool Server::handleSingleObjectHostMessageRouting(ObjectShard* shard, const Time& now, uint32* routed, Duration* latency) {
+    ConnectionIDObjectMessagePair front(ObjectHostConnectionID(),NULL,now);
+    if (!shard->routeQueue.pop(front))
         return false;
 
     UUID source_object = front.obj_msg->source_object();
@@ -462,19 +543,19 @@ bool Server::handleSingleObjectHostMessageRouting() {
     // messages that match this and dispatch the message.
     static UUID ohdp_ID = UUID::null();
     if (source_object == ohdp_ID) {
-        // Sanity check: if the destination isn't also null, then the message is
-        // non-sensical and we can just discard
+        // However, we only do this if the destination is also null. If it
+        // isn't, then the message is non-sensical and we can just discard.
         UUID dest_object = front.obj_msg->dest_object();
         if (dest_object != ohdp_ID) {
             delete front.obj_msg;
             return true;
         }
 
-        // We need to translate identifiers. The space identifiers are ignored
-        // on the space server (only one space to deal with, unlike object
-        // hosts). The NodeID uses null() for the local (destination) endpoint
-        // and the short ID of the object host connection for the remote
-        // (source).
+        // We need to translate identifiers. The space identifiers are
+        // ignored on the space server (only one space to deal with, unlike
+        // object hosts). The NodeID uses null() for the local (destination)
+        // endpoint and the short ID of the object host connection for the
+        // remote (source).
         ShortObjectHostConnectionID ohdp_node_id = front.conn_id.shortID();
 
         OHDP::DelegateService::deliver(
@@ -483,7 +564,6 @@ bool Server::handleSingleObjectHostMessageRouting() {
             MemoryReference(front.obj_msg->payload())
         );
         delete front.obj_msg;
-
         return true;
     }
 
@@ -494,34 +574,43 @@ bool Server::handleSingleObjectHostMessageRouting() {
     // connections and allow messages through.
     // NOTE that we check connecting objects as well since we need to get past this point to deliver
     // Session messages.
-    bool source_connected =
-        mObjects.find(source_object) != mObjects.end() ||
-        mMigratingConnections.find(source_object) != mMigratingConnections.end();
-    if (!source_connected)
+    // Since connections are only removed from the main strand, which we're
+    // on, the object can't go away between this check and routing below.
     {
-        if (mObjectsAwaitingMigration.find(source_object) == mObjectsAwaitingMigration.end() &&
-            mObjectMigrations.find(source_object) == mObjectMigrations.end())
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        bool source_connected =
+            shard->objects.find(source_object) != shard->objects.end() ||
+            shard->migratingConnections.find(source_object) != shard->migratingConnections.end();
+        if (!source_connected)
         {
-            SPACE_LOG(warn,"Got message for unknown object: " << source_object.toString());
-        }
-        else
-        {
-            SPACE_LOG(warn,"Server got message from object after migration started: " << source_object.toString());
-        }
+            if (shard->objectsAwaitingMigration.find(source_object) == shard->objectsAwaitingMigration.end() &&
+                shard->objectMigrations.find(source_object) == shard->objectMigrations.end())
+            {
+                SPACE_LOG(warn,"Got message for unknown object: " << source_object.toString());
+            }
+            else
+            {
+                SPACE_LOG(warn,"Server got message from object after migration started: " << source_object.toString());
+            }
 
-        delete front.obj_msg;
+            delete front.obj_msg;
 
-        return true;
+            return true;
+        }
     }
 
-
-    // Finally, if we've passed all these tests, then everything looks good and we can route it
+    // Finally, if we've passed all these tests, then everything looks good and
+    // we can route it
     mForwarder->routeObjectHostMessage(front.obj_msg);
+    (*routed)++;
+    *latency += Timer::now() - front.enqueued;
     return true;
 }
 
-// Handle Session messages from an object
-void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg) {
+// Handle Session messages from an object. This runs on the source object's
+// shard, which parses the message and filters out retries that can't change
+// anything before anything touches the main strand.
+void Server::handleSessionMessage(ObjectShard* shard, const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg) {
     Sirikata::Protocol::Session::Container session_msg;
     bool parse_success = session_msg.ParseFromString(msg->payload());
     if (!parse_success) {
@@ -530,6 +619,36 @@ void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Siri
         return;
     }
 
+    // During connection storms object hosts retry Fresh connects while we're
+    // still authenticating/registering the object. If the request matches the
+    // connection we're already working on, it's a no-op (see
+    // handleConnectAuthResponse), so drop it here.
+    if (session_msg.has_connect() &&
+        session_msg.connect().type() == Sirikata::Protocol::Session::Connect::Fresh)
+    {
+        uint64 seqno = (session_msg.has_seqno() ? session_msg.seqno() : 0);
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        StoredConnectionMap::iterator it = shard->storedConnectionData.find(msg->source_object());
+        if (it != shard->storedConnectionData.end() &&
+            it->second.conn_id == oh_conn_id &&
+            it->second.session_seqno == seqno)
+        {
+            delete msg;
+            return;
+        }
+    }
+
+    if (shard->strand == mContext->mainStrand) {
+        dispatchSessionMessage(oh_conn_id, msg, session_msg);
+        return;
+    }
+    mContext->mainStrand->post(
+        std::tr1::bind(&Server::dispatchSessionMessage, this, oh_conn_id, msg, session_msg),
+        "Server::dispatchSessionMessage"
+    );
+}
+
+void Server::dispatchSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const Sirikata::Protocol::Session::Container& session_msg) {
     // Backwards compatibility note: by defaulting to 0, all the later
     // checks on sequence numbers will always have them matching,
     // meaning we default to the old behavior where requests could end
@@ -558,10 +677,10 @@ void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Siri
         handleConnectAck(oh_conn_id, *msg, seqno);
     }
     else if (session_msg.has_disconnect()) {
-        ObjectConnectionMap::iterator it = mObjects.find(session_msg.disconnect().object());
-        if (it != mObjects.end()) {
-            handleDisconnect(session_msg.disconnect().object(), it->second, seqno);
-            mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+        ObjectConnection* obj_conn = findObjectConnection(session_msg.disconnect().object());
+        if (obj_conn != NULL) {
+            handleDisconnect(session_msg.disconnect().object(), obj_conn, seqno);
+            mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
         }
     }
 
@@ -573,20 +692,49 @@ void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Siri
 }
 
 void Server::handleObjectHostConnectionClosed(const ObjectHostConnectionID& oh_conn_id) {
-    for(ObjectConnectionMap::iterator it = mObjects.begin(); it != mObjects.end(); ) {
-        UUID obj_id = it->first;
-        ObjectConnection* obj_conn = it->second;
-
-        it++; // Iterator might get erased in handleDisconnect
-
-        if (obj_conn->connID() != oh_conn_id)
-            continue;
+    // Drop any connects still waiting for admission from this object host,
+    // along with its place in the ready and waiting lists. Short IDs are
+    // reused, so a leftover entry would give a new connection with the same ID
+    // an extra turn.
+    ShortObjectHostConnectionID host_id = oh_conn_id.shortID();
+    ConnectHostQueueMap::iterator host_it = mConnectHosts.find(host_id);
+    if (host_it != mConnectHosts.end()) {
+        PendingConnectQueue& requests = host_it->second.requests;
+        for(PendingConnectQueue::iterator it = requests.begin(); it != requests.end(); it++)
+            mPendingConnectIndex.erase(it->obj_id);
+        mPendingConnectsCount -= requests.size();
+        if (host_it->second.scheduled) {
+            mReadyConnectHosts.erase(
+                std::remove(mReadyConnectHosts.begin(), mReadyConnectHosts.end(), host_id),
+                mReadyConnectHosts.end()
+            );
+            for(WaitingConnectHostMap::iterator it = mWaitingConnectHosts.begin(); it != mWaitingConnectHosts.end(); ) {
+                if (it->second == host_id)
+                    mWaitingConnectHosts.erase(it++);
+                else
+                    it++;
+            }
+        }
+        mConnectHosts.erase(host_it);
+    }
 
+    // Collect the object host's connections first: handleDisconnect erases
+    // them and takes the shard's lock to do so.
+    std::vector<ObjectConnection*> closed;
+    for(ObjectShardList::iterator shard_it = mShards.begin(); shard_it != mShards.end(); shard_it++) {
+        ObjectShard* shard = *shard_it;
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        for(ObjectConnectionMap::iterator it = shard->objects.begin(); it != shard->objects.end(); it++) {
+            if (it->second->connID() == oh_conn_id)
+                closed.push_back(it->second);
+        }
+    }
+    for(std::vector<ObjectConnection*>::iterator it = closed.begin(); it != closed.end(); it++) {
         // By passing in the session ID we already have, we guarantee
         // this will force disconnection
-        handleDisconnect(obj_id, obj_conn, obj_conn->sessionID());
+        handleDisconnect((*it)->id(), *it, (*it)->sessionID());
     }
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
 }
 
 void Server::sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno) {
@@ -659,16 +807,145 @@ void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirik
     // FIXME sanity check the new connection
     // -- verify object may connect, i.e. not already in system (e.g. check oseg)
 
-    String auth_data = "";
-    if (connect_msg.has_auth())
-        auth_data = connect_msg.auth();
-    mAuthenticator->authenticate(
-        obj_id, MemoryReference(auth_data),
-        std::tr1::bind(&Server::handleConnectAuthResponse, this, oh_conn_id, obj_id, connect_msg, seqno, std::tr1::placeholders::_1)
-    );
+    // A retry of a request that's still waiting for admission doesn't need to
+    // be queued again. A different request for the same object conflicts,
+    // just as it would once the first one had been authenticated.
+    PendingConnectIndex::iterator pending_it = mPendingConnectIndex.find(obj_id);
+    if (pending_it != mPendingConnectIndex.end()) {
+        if (!(pending_it->second.first == oh_conn_id) || pending_it->second.second != seqno)
+            sendConnectError(oh_conn_id, obj_id, seqno);
+        return;
+    }
+
+    // Shed load instead of queuing without bound. The request is dropped
+    // without a reply: an error response would make the object host give up
+    // on the object, but with no response its connect retry timer resends the
+    // same request later.
+    if (mPendingConnectsCount >= mPendingConnectsMax) {
+        SPACE_LOG(detailed, "Connect queue full, dropping connection request from " << obj_id);
+        return;
+    }
+
+    PendingConnect pc;
+    pc.conn_id = oh_conn_id;
+    pc.obj_id = obj_id;
+    pc.conn_msg = connect_msg;
+    pc.session_seqno = seqno;
+    pc.requested = Timer::now();
+    ConnectHostQueue& host = mConnectHosts[oh_conn_id.shortID()];
+    host.requests.push_back(pc);
+    mPendingConnectsCount++;
+    mPendingConnectIndex[obj_id] = std::make_pair(oh_conn_id, seqno);
+    if (!host.scheduled) {
+        host.scheduled = true;
+        mReadyConnectHosts.push_back(oh_conn_id.shortID());
+    }
+
+    // Posting (rather than admitting immediately) lets all the connects
+    // already waiting in the strand get batched together.
+    scheduleAdmitConnects(Duration::zero());
+}
+
+void Server::scheduleAdmitConnects(Duration delay) {
+    if (mAdmitScheduled)
+        return;
+    mAdmitScheduled = true;
+    if (delay > Duration::zero())
+        mContext->mainStrand->post(
+            delay,
+            std::tr1::bind(&Server::admitConnects, this),
+            "Server::admitConnects"
+        );
+    else
+        mContext->mainStrand->post(
+            std::tr1::bind(&Server::admitConnects, this),
+            "Server::admitConnects"
+        );
+}
+
+void Server::admitConnects() {
+    mAdmitScheduled = false;
+
+    Time now = Timer::now();
+    // Hosts whose next token has arrived can be admitted from again
+    while(!mWaitingConnectHosts.empty() && mWaitingConnectHosts.begin()->first <= now) {
+        mReadyConnectHosts.push_back(mWaitingConnectHosts.begin()->second);
+        mWaitingConnectHosts.erase(mWaitingConnectHosts.begin());
+    }
+
+    Authenticator::RequestBatch batch;
+    // Take one request at a time from each ready host until the batch is
+    // full. Hosts that are over their rate move to mWaitingConnectHosts, so
+    // they aren't looked at again until they have a token.
+    while(!mReadyConnectHosts.empty() && batch.size() < mAdmitBatchSize) {
+        ShortObjectHostConnectionID host_id = mReadyConnectHosts.front();
+        mReadyConnectHosts.pop_front();
+
+        ConnectHostQueueMap::iterator host_it = mConnectHosts.find(host_id);
+        if (host_it == mConnectHosts.end())
+            continue;
+        ConnectHostQueue& host = host_it->second;
+        if (host.requests.empty()) {
+            host.scheduled = false;
+            continue;
+        }
+
+        if (mConnectRate > 0) {
+            if (host.last == Time::null())
+                host.tokens = mConnectBurst;
+            else
+                host.tokens = std::min(mConnectBurst, host.tokens + (now - host.last).toSeconds() * mConnectRate);
+            host.last = now;
+            if (host.tokens < 1.0) {
+                mWaitingConnectHosts.insert(
+                    std::make_pair(now + Duration::seconds((1.0 - host.tokens) / mConnectRate), host_id)
+                );
+                continue;
+            }
+            host.tokens -= 1.0;
+        }
+
+        PendingConnect& pc = host.requests.front();
+        mPendingConnectIndex.erase(pc.obj_id);
+        batch.push_back(
+            Authenticator::Request(
+                pc.obj_id, pc.conn_msg.has_auth() ? pc.conn_msg.auth() : String(""),
+                std::tr1::bind(&Server::handleConnectAuthResponse, this, pc.conn_id, pc.obj_id, pc.conn_msg, pc.session_seqno, pc.requested, std::tr1::placeholders::_1)
+            )
+        );
+        host.requests.pop_front();
+        mPendingConnectsCount--;
+
+        if (host.requests.empty())
+            host.scheduled = false;
+        else
+            mReadyConnectHosts.push_back(host_id);
+    }
+
+    mContext->timeSeries->report(mTimeSeriesConnectQueue, mPendingConnectsCount);
+
+    if (!batch.empty())
+        mAuthenticator->authenticateBatch(batch);
+
+    // Continue right away if there are hosts that may still have tokens,
+    // otherwise wait until the next host gets one.
+    if (!mReadyConnectHosts.empty())
+        scheduleAdmitConnects(Duration::zero());
+    else if (!mWaitingConnectHosts.empty())
+        scheduleAdmitConnects(std::max(mWaitingConnectHosts.begin()->first - now, Duration::zero()));
+}
+
+void Server::flushOSegAdds() {
+    mOSegFlushScheduled = false;
+    if (mPendingOSegAdds.empty())
+        return;
+
+    ObjectSegmentation::NewObjectList adds;
+    adds.swap(mPendingOSegAdds);
+    mOSeg->addNewObjects(adds);
 }
 
-void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool authenticated) {
+void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, Time requested, bool authenticated) {
     if (!authenticated) {
         sendConnectError(oh_conn_id, obj_id, seqno);
         return;
@@ -679,24 +956,37 @@ void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id,
     // case, just send them another one and ignore this
     // request. Alternatively, someone might just be trying to use the
     // same object ID.
-    if (isObjectConnected(obj_id) || isObjectConnecting(obj_id)) {
+    ObjectShard* shard = objectShard(obj_id);
+    bool connected, connecting;
+    bool connected_retry = false, connecting_retry = false;
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        ObjectConnectionMap::iterator obj_it = shard->objects.find(obj_id);
+        StoredConnectionMap::iterator stored_it = shard->storedConnectionData.find(obj_id);
+        connected = (obj_it != shard->objects.end());
+        connecting = (stored_it != shard->storedConnectionData.end());
+        //was already connected, the same oh sending msg, and the same
+        //session request id
+        if (connected)
+            connected_retry =
+                (obj_it->second->connID() == oh_conn_id) &&
+                (obj_it->second->sessionID() == seqno);
+        // or was connecting, the same oh sending msg, and the same request id
+        if (connecting)
+            connecting_retry =
+                (stored_it->second.conn_id == oh_conn_id) &&
+                (stored_it->second.session_seqno == seqno);
+    }
+    if (connected || connecting) {
 
         // Decide whether this is a conflict or a retry
 
-        if  //was already connected, the same oh sending msg, and the same
-            //session request id
-            (isObjectConnected(obj_id) &&
-                (mObjects[obj_id]->connID() == oh_conn_id) &&
-                (mObjects[obj_id]->sessionID() == seqno))
+        if (connected_retry)
         {
             // retry, tell them they're fine.
             sendConnectSuccess(oh_conn_id, obj_id, seqno);
         }
-        else if
-            // or was connecting, the same oh sending msg, and the same request id
-            (isObjectConnecting(obj_id) &&
-                (mStoredConnectionData[obj_id].conn_id == oh_conn_id) &&
-                (mStoredConnectionData[obj_id].session_seqno == seqno))
+        else if (connecting_retry)
         {
             // Do nothing, they're still working on the connection. We can't
             // send success (they aren't fully connected yet) and we can't send
@@ -721,26 +1011,47 @@ void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id,
     }
 
     // Update our oseg to show that we know that we have this object now. Also
-    // mark it as connecting (by storing in mStoredConnectionData) so any
-    // additional connection attempts will fail.
+    // mark it as connecting (by storing in the shard's storedConnectionData)
+    // so any additional connection attempts will fail.
     StoredConnection sc;
     sc.conn_id = oh_conn_id;
     sc.conn_msg = connect_msg;
     sc.session_seqno = seqno;
-    mStoredConnectionData[obj_id] = sc;
+    sc.requested = requested;
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->storedConnectionData[obj_id] = sc;
+    }
 
-    mOSeg->addNewObject(obj_id,connect_msg.bounds().radius());
+    // Authentication results for a batch arrive back to back, so collect the
+    // OSeg registrations and issue them together.
+    mPendingOSegAdds.push_back(std::make_pair(obj_id, connect_msg.bounds().radius()));
+    if (!mOSegFlushScheduled) {
+        mOSegFlushScheduled = true;
+        mContext->mainStrand->post(
+            std::tr1::bind(&Server::flushOSegAdds, this),
+            "Server::flushOSegAdds"
+        );
+    }
 }
 
 void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
 {
-  StoredConnectionMap::iterator storedConIter = mStoredConnectionData.find(obj_id);
-  if (storedConIter != mStoredConnectionData.end())
+  ObjectShard* shard = objectShard(obj_id);
+  StoredConnection sc;
+  bool stored;
+  {
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      StoredConnectionMap::iterator storedConIter = shard->storedConnectionData.find(obj_id);
+      stored = (storedConIter != shard->storedConnectionData.end());
+      if (stored)
+          sc = storedConIter->second;
+  }
+  if (stored)
   {
-      StoredConnection sc = mStoredConnectionData[obj_id];
       if (status == OSegWriteListener::SUCCESS)
       {
-          mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id)));
+          mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id), OHDP::NodeID(sc.conn_id.shortID())));
 
           // Note: we always use local time for connections. The client
           // accounts for by using the values we return in the response
@@ -755,12 +1066,16 @@ void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
           BoundingSphere3f bnds = sc.conn_msg.bounds();
           // Create and store the connection
           ObjectConnection* conn = new ObjectConnection(obj_id, mObjectHostConnectionManager, sc.conn_id, sc.session_seqno);
-          mObjects[obj_id] = conn;
-          mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+          {
+              boost::lock_guard<boost::mutex> lock(shard->mutex);
+              shard->objects[obj_id] = conn;
+          }
+          mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
+          mContext->timeSeries->report(mTimeSeriesTimeToConnected, (Timer::now() - sc.requested).toSeconds());
 
           //TODO: assumes each server process is assigned only one region... perhaps we should enforce this constraint
           //for cleaner semantics?
-          mCSeg->reportLoad(mContext->id(), mCSeg->serverRegion(mContext->id())[0] , mObjects.size()  );
+          mCSeg->reportLoad(mContext->id(), mCSeg->serverRegion(mContext->id())[0] , numObjects()  );
 
           mLocalForwarder->addActiveConnection(conn);
 
@@ -798,7 +1113,8 @@ void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
       {
           sendConnectError(sc.conn_id , obj_id, sc.session_seqno);
       }
-      mStoredConnectionData.erase(storedConIter);
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      shard->storedConnectionData.erase(obj_id);
   }
   else
   {
@@ -855,7 +1171,11 @@ void Server::handleMigrate(const ObjectHostConnectionID& oh_conn_id, const Sirik
 
     // Create and store the connection
     ObjectConnection* conn = new ObjectConnection(obj_id, mObjectHostConnectionManager, oh_conn_id, seqno);
-    mObjectsAwaitingMigration[obj_id] = conn;
+    {
+        ObjectShard* shard = objectShard(obj_id);
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->objectsAwaitingMigration[obj_id] = conn;
+    }
 
     // Try to handle this migration if all info is available
 
@@ -868,13 +1188,12 @@ void Server::handleConnectAck(const ObjectHostConnectionID& oh_conn_id, const Si
     UUID obj_id = container.source_object();
 
     // Ack must fully match the connection we have
-    ObjectConnectionMap::iterator it = mObjects.find(obj_id);
-    if (it == mObjects.end()) {
+    ObjectConnection* conn = findObjectConnection(obj_id);
+    if (conn == NULL) {
         SPACE_LOG(detailed, "Ignoring connection ack for unknown object " << obj_id << ". This ack is probably an outdated retry.");
         return;
     }
 
-    ObjectConnection* conn = it->second;
     if (conn->sessionID() != session_request_seqno) {
         SPACE_LOG(detailed, "Ignoring connection ack for " << obj_id << " because session request ID " << session_request_seqno << " doesn't match the connection's session ID " << conn->sessionID() << ". This probably means we got an outdated connection ack retry.");
         return;
@@ -911,7 +1230,11 @@ void Server::handleUniqueDisconnectWithDeletedObjectConnection(UUID obj_id) {
         
         mForwarder->removeObjectConnection(obj_id);
         
-        mObjects.erase(obj_id);
+        {
+            ObjectShard* shard = objectShard(obj_id);
+            boost::lock_guard<boost::mutex> lock(shard->mutex);
+            shard->objects.erase(obj_id);
+        }
         // Num objects is reported by the caller
         
         ObjectReference obj(obj_id);
@@ -970,7 +1293,11 @@ void Server::receiveMessage(Message* msg)
 
             SPACE_LOG(detailed,"Received server migration message for " << obj_id.toString() << " from server " << mig_msg->source_server());
 
-            mObjectMigrations[obj_id] = mig_msg;
+            {
+                ObjectShard* shard = objectShard(obj_id);
+                boost::lock_guard<boost::mutex> lock(shard->mutex);
+                shard->objectMigrations[obj_id] = mig_msg;
+            }
             // Try to handle this migration if all the info is available
             handleMigration(obj_id);
         }
@@ -989,27 +1316,35 @@ void Server::handleMigration(const UUID& obj_id)
 
     // Try to find the info in both lists -- the connection and migration information
 
-    MigrationRequestMap::iterator obj_map_it = mObjectsAwaitingMigration.find(obj_id);
-    if (obj_map_it == mObjectsAwaitingMigration.end())
+    ObjectShard* shard = objectShard(obj_id);
+
+    ObjectConnection* obj_conn;
+    Sirikata::Protocol::Migration::MigrationMessage* migrate_msg;
     {
-        return;
-    }
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
 
+        MigrationRequestMap::iterator obj_map_it = shard->objectsAwaitingMigration.find(obj_id);
+        if (obj_map_it == shard->objectsAwaitingMigration.end())
+        {
+            return;
+        }
 
-    ObjectMigrationMap::iterator migration_map_it = mObjectMigrations.find(obj_id);
-    if (migration_map_it == mObjectMigrations.end())
-    {
-        return;
+
+        ObjectMigrationMap::iterator migration_map_it = shard->objectMigrations.find(obj_id);
+        if (migration_map_it == shard->objectMigrations.end())
+        {
+            return;
+        }
+
+        // Get the data from the two maps
+        obj_conn = obj_map_it->second;
+        migrate_msg = migration_map_it->second;
     }
 
 
     SPACE_LOG(detailed,"Finishing migration of " << obj_id.toString());
 
-    mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id)));
-
-    // Get the data from the two maps
-    ObjectConnection* obj_conn = obj_map_it->second;
-    Sirikata::Protocol::Migration::MigrationMessage* migrate_msg = migration_map_it->second;
+    mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id), OHDP::NodeID(obj_conn->connID().shortID())));
 
 
     // Extract the migration message data
@@ -1027,8 +1362,11 @@ void Server::handleMigration(const UUID& obj_id)
     String obj_query_data ( migrate_msg->has_query_data() ? migrate_msg->query_data() : "");
 
     // Move from list waiting for migration message to active objects
-    mObjects[obj_id] = obj_conn;
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->objects[obj_id] = obj_conn;
+    }
+    mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
     mLocalForwarder->addActiveConnection(obj_conn);
 
 
@@ -1059,8 +1397,11 @@ void Server::handleMigration(const UUID& obj_id)
 
 
     // Clean out the two records from the migration maps
-    mObjectsAwaitingMigration.erase(obj_map_it);
-    mObjectMigrations.erase(migration_map_it);
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->objectsAwaitingMigration.erase(obj_id);
+        shard->objectMigrations.erase(obj_id);
+    }
 
 
     // Send reply back indicating that the migration was successful
@@ -1100,7 +1441,8 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
 
     if (mOSeg->clearToMigrate(obj_id)) //needs to check whether migration to this server has finished before can begin migrating to another server.
     {
-        ObjectConnection* obj_conn = mObjects[obj_id];
+        ObjectShard* shard = objectShard(obj_id);
+        ObjectConnection* obj_conn = findObjectConnection(obj_id);
 
         Vector3f obj_pos = mLocationService->currentPosition(obj_id);
         ServerID new_server_id = mCSeg->lookup(obj_pos);
@@ -1190,15 +1532,21 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
             mocd.bnds                 =          mLocationService->bounds(obj_id);
             mocd.serviceConnection    =                                      true;
 
-            mMigratingConnections[obj_id] = mocd;
+            {
+                boost::lock_guard<boost::mutex> lock(shard->mutex);
+                shard->migratingConnections[obj_id] = mocd;
+            }
 
 
 
             // Stop tracking the object locally
             mLocationService->removeLocalObject(obj_id, (markObjectDisconnectingCallCount--,disconnectedCb));
             mLocalForwarder->removeActiveConnection(obj_id);
-            mObjects.erase(obj_id);
-            mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+            {
+                boost::lock_guard<boost::mutex> lock(shard->mutex);
+                shard->objects.erase(obj_id);
+            }
+            mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
             ObjectReference obj(obj_id);
 
             mObjectSessionManager->removeSession(obj);
@@ -1252,24 +1600,32 @@ void Server::trySendMigrationMessages() {
 void Server::processAlreadyMigrating(const UUID& obj_id)
 {
 
-    MigrationRequestMap::iterator obj_map_it = mObjectsAwaitingMigration.find(obj_id);
-    if (obj_map_it == mObjectsAwaitingMigration.end())
+    ObjectShard* shard = objectShard(obj_id);
+
+    ObjectConnection* obj_conn;
+    Sirikata::Protocol::Migration::MigrationMessage* migrate_msg;
     {
-        return;
-    }
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
 
+        MigrationRequestMap::iterator obj_map_it = shard->objectsAwaitingMigration.find(obj_id);
+        if (obj_map_it == shard->objectsAwaitingMigration.end())
+        {
+            return;
+        }
 
-    ObjectMigrationMap::iterator migration_map_it = mObjectMigrations.find(obj_id);
-    if (migration_map_it == mObjectMigrations.end())
-    {
-        return;
-    }
 
-    mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id)));
+        ObjectMigrationMap::iterator migration_map_it = shard->objectMigrations.find(obj_id);
+        if (migration_map_it == shard->objectMigrations.end())
+        {
+            return;
+        }
 
-    // Get the data from the two maps
-    ObjectConnection* obj_conn = obj_map_it->second;
-    Sirikata::Protocol::Migration::MigrationMessage* migrate_msg = migration_map_it->second;
+        // Get the data from the two maps
+        obj_conn = obj_map_it->second;
+        migrate_msg = migration_map_it->second;
+    }
+
+    mObjectSessionManager->addSession(new ObjectSession(ObjectReference(obj_id), OHDP::NodeID(obj_conn->connID().shortID())));
 
 
     // Extract the migration message data
@@ -1289,8 +1645,11 @@ void Server::processAlreadyMigrating(const UUID& obj_id)
     // Remove the previous connection from the local forwarder
     mLocalForwarder->removeActiveConnection( obj_id );
     // Move from list waiting for migration message to active objects
-    mObjects[obj_id] = obj_conn;
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->objects[obj_id] = obj_conn;
+    }
+    mContext->timeSeries->report(mTimeSeriesObjects, numObjects());
     mLocalForwarder->addActiveConnection(obj_conn);
 
 
@@ -1323,14 +1682,20 @@ void Server::processAlreadyMigrating(const UUID& obj_id)
     delete migrated_conn_old;
 
  //change the boolean value associated with object so that you know not to keep servicing the connection associated with this object in mMigratingConnections
-   mMigratingConnections[obj_id].serviceConnection = false;
+   {
+       boost::lock_guard<boost::mutex> lock(shard->mutex);
+       shard->migratingConnections[obj_id].serviceConnection = false;
+   }
 
    // Stage this connection with the forwarder, enabled when ack received
    mForwarder->addObjectConnection(obj_id, obj_conn);
 
     // Clean out the two records from the migration maps
-    mObjectsAwaitingMigration.erase(obj_map_it);
-    mObjectMigrations.erase(migration_map_it);
+    {
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        shard->objectsAwaitingMigration.erase(obj_id);
+        shard->objectMigrations.erase(obj_id);
+    }
 
 
     // Send reply back indicating that the migration was successful
@@ -1355,7 +1720,9 @@ void Server::processAlreadyMigrating(const UUID& obj_id)
 //returns false otherwise.
 bool Server::checkAlreadyMigrating(const UUID& obj_id)
 {
-  if (mMigratingConnections.find(obj_id) != mMigratingConnections.end())
+  ObjectShard* shard = objectShard(obj_id);
+  boost::lock_guard<boost::mutex> lock(shard->mutex);
+  if (shard->migratingConnections.find(obj_id) != shard->migratingConnections.end())
     return true; //it is already migrating
 
   return false;  //it isn't.
@@ -1365,14 +1732,23 @@ bool Server::checkAlreadyMigrating(const UUID& obj_id)
 //This shouldn't get called yet.
 void Server::killObjectConnection(const UUID& obj_id)
 {
-  MigConnectionsMap::iterator objConMapIt = mMigratingConnections.find(obj_id);
+  ObjectShard* shard = objectShard(obj_id);
+  MigratingObjectConnectionsData migData;
+  bool migrating;
+  {
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    MigConnectionsMap::iterator objConMapIt = shard->migratingConnections.find(obj_id);
+    migrating = (objConMapIt != shard->migratingConnections.end());
+    if (migrating)
+      migData = objConMapIt->second;
+  }
 
-  if (objConMapIt != mMigratingConnections.end())
+  if (migrating)
   {
     uint64 connIDer;
     mForwarder->getObjectConnection(obj_id,connIDer);
 
-    if (connIDer == objConMapIt->second.uniqueConnId)
+    if (connIDer == migData.uniqueConnId)
     {
       //means that the object did not undergo an intermediate migrate.  Should go ahead and remove this connection from forwarder
       mForwarder->removeObjectConnection(obj_id);
@@ -1384,11 +1760,12 @@ void Server::killObjectConnection(const UUID& obj_id)
 
     //log the event's completion.
     Duration currentDur = mMigrationTimer.elapsed();
-    Duration timeTakenMs = Duration::milliseconds(currentDur.toMilliseconds() - mMigratingConnections[obj_id].milliseconds);
-    ServerID migTo  = mMigratingConnections[obj_id].migratingTo;
+    Duration timeTakenMs = Duration::milliseconds(currentDur.toMilliseconds() - migData.milliseconds);
+    ServerID migTo  = migData.migratingTo;
     CONTEXT_SPACETRACE(objectMigrationRoundTrip, obj_id, mContext->id(), migTo , timeTakenMs);
 
-    mMigratingConnections.erase(objConMapIt);
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    shard->migratingConnections.erase(obj_id);
   }
 }
 
@@ -1398,11 +1775,24 @@ void Server::killObjectConnection(const UUID& obj_id)
 // Commander commands
 void Server::commandObjectsCount(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
     Command::Result result = Command::EmptyResult();
-    result.put("objects.active", mObjects.size());
-    result.put("objects.connecting", mStoredConnectionData.size());
-    result.put("objects.migrating_to", mObjectsAwaitingMigration.size());
-    result.put("objects.other_server_requested_migration", mObjectMigrations.size());
-    result.put("objects.migrating_from", mMigratingConnections.size());
+    size_t connecting = 0, migrating_to = 0, other_requested = 0, migrating_from = 0;
+    for(ObjectShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        boost::lock_guard<boost::mutex> lock((*it)->mutex);
+        connecting += (*it)->storedConnectionData.size();
+        migrating_to += (*it)->objectsAwaitingMigration.size();
+        other_requested += (*it)->objectMigrations.size();
+        migrating_from += (*it)->migratingConnections.size();
+    }
+    result.put("objects.active", numObjects());
+    result.put("objects.connecting", connecting);
+    result.put("objects.awaiting_admission", mPendingConnectsCount);
+    result.put("objects.migrating_to", migrating_to);
+    result.put("objects.other_server_requested_migration", other_requested);
+    result.put("objects.migrating_from", migrating_from);
+    result.put("shards", mShards.size());
+    result.put("routing.messages", mRoutedMessages);
+    if (mRoutedMessages > 0)
+        result.put("routing.average_latency", (mRouteLatencyTotal / (float64)mRoutedMessages).toString());
     cmdr->result(cmdid, result);
 }
 
@@ -1414,8 +1804,12 @@ void Server::commandObjectsList(const Command::Command& cmd, Command::Commander*
 
     // This only lists regular, active objects. Connecting, migrating, etc are
     // ignored.
-    for(ObjectConnectionMap::iterator objit = mObjects.begin(); objit != mObjects.end(); objit++)
-        objects_ary.push_back(objit->first.toString());
+    for(ObjectShardList::iterator shard_it = mShards.begin(); shard_it != mShards.end(); shard_it++) {
+        ObjectShard* shard = *shard_it;
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        for(ObjectConnectionMap::iterator objit = shard->objects.begin(); objit != shard->objects.end(); objit++)
+            objects_ary.push_back(objit->first.toString());
+    }
     cmdr->result(cmdid, result);
 }
 
@@ -1431,14 +1825,14 @@ void Server::commandObjectsDisconnect(const Command::Command& cmd, Command::Comm
     UUID objid(obj_string, UUID::HumanReadable());
 
 
-    ObjectConnectionMap::iterator objit = mObjects.find(objid);
-    if (objit == mObjects.end()) {
+    ObjectConnection* obj_conn = findObjectConnection(objid);
+    if (obj_conn == NULL) {
         result.put("error", "Object not found");
     }
     else {
         // By passing in the session ID we already have, we guarantee
         // this will force disconnection
-        handleDisconnect(objit->first, objit->second, objit->second->sessionID());
+        handleDisconnect(objid, obj_conn, obj_conn->sessionID());
         // Lack of 'error' field indicates success
     }
 
@@ -147,19 +147,33 @@ private:
 
     // Handle an object host closing its connection
     void handleObjectHostConnectionClosed(const ObjectHostConnectionID& conn_id);
-    // Schedule main thread to handle oh message routing
-    void scheduleObjectHostMessageRouting();
-    void handleObjectHostMessageRouting();
-    // Perform forwarding for a message on the front of mRouteObjectMessage from the object host which
-    // couldn't be forwarded directly by the networking code
-    // (i.e. needs routing to another node)
-    bool handleSingleObjectHostMessageRouting();
-
-    // Handle Session messages from an object
-    void handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
+
+    struct ObjectShard;
+    struct ConnectionIDObjectMessagePair;
+    // Schedule the main strand to drain the shard's routing queue
+    void scheduleObjectHostMessageRouting(ObjectShard* shard);
+    void handleObjectHostMessageRouting(ObjectShard* shard);
+    // Handle a message on the front of the shard's routing queue from the
+    // object host which couldn't be forwarded directly by the networking code
+    // (i.e. needs routing to another node). Main strand only, so the source
+    // object can't disconnect between checking for it and routing.
+    bool handleSingleObjectHostMessageRouting(ObjectShard* shard, const Time& now, uint32* routed, Duration* latency);
+
+    // Handle Session messages from an object. Parsing and filtering of retried
+    // requests happens in the object's shard, the rest in the main strand.
+    void handleSessionMessage(ObjectShard* shard, const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
+    void dispatchSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg, const Sirikata::Protocol::Session::Container& session_msg);
     // Handle Connect message from object
     void handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno);
-    void handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool authenticated);
+    void handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, Time requested, bool authenticated);
+
+    // Connect admission. Connects which pass the initial checks wait in a
+    // bounded queue and are released, subject to a per-object host token
+    // bucket, to the authenticator in batches. Main strand only.
+    void scheduleAdmitConnects(Duration delay);
+    void admitConnects();
+    // Successfully authenticated objects are registered with OSeg in batches
+    void flushOSegAdds();
 
     void sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno);
     void sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno);
@@ -220,12 +234,9 @@ private:
 
     typedef std::tr1::unordered_map<UUID, ObjectConnection*, UUID::Hasher> ObjectConnectionMap;
 
-    ObjectConnectionMap mObjects; // NOTE: only Forwarder and LocalForwarder
-                                  // should actually use the connection, this is
-                                  // only still a map to handle migrations
-                                  // properly
     typedef std::tr1::unordered_map<UUID,int,UUID::Hasher> DisconnectingObjectMap;
-    ///Maps UUID to a count of the number of services we need callbacks from: guarded by mRouteObjectMessageMutex
+    ///Maps UUID to a count of the number of services we need callbacks from: guarded by mDisconnectingObjectsMutex
+    boost::mutex mDisconnectingObjectsMutex;
     DisconnectingObjectMap mDisconnectingObjects;
     bool isObjectDisconnecting(const UUID &object)const;
     ///Other services end up calling this callback to mark an object as being disconnected. Bound by the handleDisconnect function which passes this to the service for the final disconnection call
@@ -236,9 +247,7 @@ private:
     // Information to be able to respond to a migration request *from
     // the object*.
     typedef ObjectConnectionMap MigrationRequestMap;
-    MigrationRequestMap mObjectsAwaitingMigration;
     typedef std::tr1::unordered_map<UUID, Sirikata::Protocol::Migration::MigrationMessage*, UUID::Hasher> ObjectMigrationMap;
-    ObjectMigrationMap mObjectMigrations;
 
     //std::map<UUID,ObjectConnection*>
     struct MigratingObjectConnectionsData
@@ -256,9 +265,7 @@ private:
       // Outstanding MigrateMessages, which get objects to other servers.
       MigrateMessageQueue mMigrateMessages;
 
-    //    ObjectConnectionMap mMigratingConnections;//bftm add
     typedef std::map<UUID,MigratingObjectConnectionsData> MigConnectionsMap;
-    MigConnectionsMap mMigratingConnections;//bftm add
     Timer mMigrationTimer;
 
     struct StoredConnection
@@ -268,15 +275,62 @@ private:
         // Sequence number from session request so we can uniquely
         // identify the request
         uint64 session_seqno;
+        // When the connect request was admitted to the queue, for
+        // time-to-connected stats
+        Time requested;
+    };
+
+    struct PendingConnect {
+        ObjectHostConnectionID conn_id;
+        UUID obj_id;
+        Sirikata::Protocol::Session::Connect conn_msg;
+        uint64 session_seqno;
+        Time requested;
+    };
+    typedef std::deque<PendingConnect> PendingConnectQueue;
+    // Objects with a queued connect and the request they're waiting on, so
+    // retries don't get queued twice
+    typedef std::tr1::unordered_map<UUID, std::pair<ObjectHostConnectionID, uint64>, UUID::Hasher> PendingConnectIndex;
+    PendingConnectIndex mPendingConnectIndex;
+    uint32 mPendingConnectsCount;
+    uint32 mPendingConnectsMax;
+    uint32 mAdmitBatchSize;
+    bool mAdmitScheduled;
+
+    // Queued connects for each object host, along with a token bucket rate
+    // limiting that host's connects
+    struct ConnectHostQueue {
+        ConnectHostQueue() : tokens(0), last(Time::null()), scheduled(false) {}
+        PendingConnectQueue requests;
+        float64 tokens;
+        Time last;
+        // Whether the host is in mReadyConnectHosts or mWaitingConnectHosts
+        bool scheduled;
     };
+    typedef std::tr1::unordered_map<ShortObjectHostConnectionID, ConnectHostQueue> ConnectHostQueueMap;
+    ConnectHostQueueMap mConnectHosts;
+    // Hosts with queued connects that may have a token available, in round
+    // robin order
+    std::deque<ShortObjectHostConnectionID> mReadyConnectHosts;
+    // Hosts with queued connects that are out of tokens, ordered by when
+    // their next token is available
+    typedef std::multimap<Time, ShortObjectHostConnectionID> WaitingConnectHostMap;
+    WaitingConnectHostMap mWaitingConnectHosts;
+    float64 mConnectRate; // per object host per second, 0 for unlimited
+    float64 mConnectBurst;
+
+    ObjectSegmentation::NewObjectList mPendingOSegAdds;
+    bool mOSegFlushScheduled;
 
     typedef std::map<UUID, StoredConnection> StoredConnectionMap;
-    StoredConnectionMap  mStoredConnectionData;
 
     struct ConnectionIDObjectMessagePair{
         ObjectHostConnectionID conn_id;
         Sirikata::Protocol::Object::ObjectMessage* obj_msg;
-        ConnectionIDObjectMessagePair(ObjectHostConnectionID conn_id, Sirikata::Protocol::Object::ObjectMessage*msg) {
+        Time enqueued;
+        ConnectionIDObjectMessagePair(ObjectHostConnectionID conn_id, Sirikata::Protocol::Object::ObjectMessage*msg, const Time& enqueued)
+         : enqueued(enqueued)
+        {
             this->conn_id=conn_id;
             this->obj_msg=msg;
         }
@@ -285,14 +339,62 @@ private:
         }
     };
 
-    // FIXME Another place where needing a size queue and notifications causes
-    // double locking...
-    boost::mutex mRouteObjectMessageMutex;
-    Sirikata::SizedThreadSafeQueue<ConnectionIDObjectMessagePair>mRouteObjectMessage;
+    /** Per-object state is partitioned across shards by the hash of the
+     *  object's UUID. Each shard has its own strand, which parses session
+     *  messages for the shard's objects and filters out retries, so those no
+     *  longer all funnel through the main strand. Each shard also has its own
+     *  routing queue so network threads don't contend on a single lock, but
+     *  the queues are drained on the main strand: OSeg lookups and the
+     *  Forwarder live there.
+     *
+     *  The maps are only modified from the main strand, which is also where
+     *  the Forwarder, LocationService, Proximity and OSeg calls that go along
+     *  with those modifications have to happen. All access, reads included,
+     *  holds the shard's mutex.
+     */
+    struct ObjectShard {
+        ObjectShard(Network::IOStrand* _strand, bool _owns_strand, size_t route_buffer_size);
+        ~ObjectShard();
+
+        Network::IOStrand* strand;
+        bool ownsStrand;
+
+        boost::mutex mutex;
+        ObjectConnectionMap objects; // NOTE: only Forwarder and LocalForwarder
+                                     // should actually use the connection, this is
+                                     // only still a map to handle migrations
+                                     // properly
+        StoredConnectionMap storedConnectionData;
+        MigrationRequestMap objectsAwaitingMigration;
+        ObjectMigrationMap objectMigrations;
+        MigConnectionsMap migratingConnections;
+
+        // FIXME Another place where needing a size queue and notifications causes
+        // double locking...
+        boost::mutex routeMutex;
+        Sirikata::SizedThreadSafeQueue<ConnectionIDObjectMessagePair> routeQueue;
+    };
+    typedef std::vector<ObjectShard*> ObjectShardList;
+    ObjectShardList mShards;
+
+    ObjectShard* objectShard(const UUID& obj_id) const {
+        return mShards[UUID::Hasher()(obj_id) % mShards.size()];
+    }
+    // Number of active objects across all shards
+    size_t numObjects() const;
+    // Find the active connection for an object, or NULL
+    ObjectConnection* findObjectConnection(const UUID& obj_id) const;
+
+    // Routing latency from a shard's queue to the forwarder. Main strand only.
+    uint64 mRoutedMessages;
+    Duration mRouteLatencyTotal;
 
     // TimeSeries identifiers. Must include the ServerID for uniqueness, so we
     // cache them so TimeSeries reports are fast
     String mTimeSeriesObjects;
+    String mTimeSeriesRouteLatency;
+    String mTimeSeriesConnectQueue;
+    String mTimeSeriesTimeToConnected;
 
 }; // class Server
 
@@ -36,6 +36,7 @@
 #include <sirikata/core/network/NTPTimeSync.hpp>
 
 #include <sirikata/core/network/IOStrandImpl.hpp>
+#include <sirikata/core/network/IOServicePool.hpp>
 
 #include <sirikata/space/ObjectHostSession.hpp>
 #include <sirikata/space/ObjectSessionManager.hpp>
@@ -164,13 +165,41 @@ int main(int argc, char** argv) {
 
     Duration duration = GetOptionValue<Duration>("duration");
 
-    Network::IOService* ios = new Network::IOService("Space");
+    // Extra shards only help if there are threads to run their strands on
+    uint32 nshards = GetOptionValue<uint32>(OPT_SERVER_SHARDS);
+    uint32 nthreads = std::max<uint32>(3, nshards + 2);
+
+    Network::IOServicePool* ios_pool = NULL;
+    Network::IOService* ios = NULL;
+    Network::IOServicePool::ThreadingModel threading =
+        Network::IOServicePool::parseThreadingModel(GetOptionValue<String>(OPT_IOSERVICE_POOL));
+    if (threading == Network::IOServicePool::PerThreadServices) {
+        ios_pool = new Network::IOServicePool("Space", nthreads, threading);
+        ios_pool->setWorkStealing(GetOptionValue<bool>(OPT_IOSERVICE_POOL_STEAL));
+        ios_pool->setCPUAffinity(Network::IOServicePool::parseCPUList(GetOptionValue<String>(OPT_IOSERVICE_POOL_CPUS)));
+        ios = ios_pool->service();
+    }
+    else {
+        ios = new Network::IOService("Space");
+    }
+    if (GetOptionValue<bool>(OPT_IOSERVICE_TIMER_WHEEL)) {
+        Duration slack = GetOptionValue<Duration>(OPT_IOSERVICE_TIMER_WHEEL_SLACK);
+        if (ios_pool != NULL)
+            ios_pool->enableTimerWheel(slack);
+        else
+            ios->enableTimerWheel(slack);
+    }
     Network::IOStrand* mainStrand = ios->createStrand("Space Main");
 
     ODPSST::ConnectionManager* sstConnMgr = new ODPSST::ConnectionManager();
     OHDPSST::ConnectionManager* ohSstConnMgr = new OHDPSST::ConnectionManager();
 
     SpaceContext* space_context = new SpaceContext("space", server_id, sstConnMgr, ohSstConnMgr, ios, mainStrand, start_time, gTrace, duration);
+    space_context->setServicePool(ios_pool);
+
+    Network::EventQueueProfile::setSlowThreshold(GetOptionValue<Duration>(OPT_PROFILE_EVENT_QUEUES_SLOW));
+    Network::EventQueueProfile::setEnabled(GetOptionValue<bool>(OPT_PROFILE_EVENT_QUEUES));
+    space_context->setEventQueueProfileReportInterval(GetOptionValue<Duration>(OPT_PROFILE_EVENT_QUEUES_INTERVAL));
 
     String servermap_type = GetOptionValue<String>("servermap");
     String servermap_options = GetOptionValue<String>("servermap-options");
@@ -376,7 +405,7 @@ int main(int argc, char** argv) {
     space_context->add(ohSstConnMgr);
     space_context->add(prox);
 
-    space_context->run(3);
+    space_context->run(nthreads);
 
     space_context->cleanup();
 
@@ -430,7 +459,10 @@ int main(int argc, char** argv) {
     delete mainStrand;
     delete osegStrand;
 
-    delete ios;
+    if (ios_pool != NULL)
+        delete ios_pool;
+    else
+        delete ios;
 
     delete sstConnMgr;
     delete ohSstConnMgr;
@@ -1,7 +1,7 @@
 /**
  serializationTest -- Tests serialization of arrays, objects, and
- functions.  Note, still missing tests for serializing presences,
- visibles, etc.
+ functions, in both the binary and pbj formats.  Note, still missing
+ tests for serializing presences, visibles, etc.
  
   Scene.db:
   * Ent 1 : Anything
@@ -22,8 +22,29 @@ function failed(failText)
     hasFailed = true;
 }
 
+//format every test serializes with, see runTests
+serializeFormat = 'binary';
+function serialize(toSerialize)
+{
+    return system.serialize(toSerialize, serializeFormat);
+}
+
 function runTests()
 {
+    runFormatTests('binary');
+    runFormatTests('pbj');
+    mixedFormats();
+    deeplyNested();
+
+    if (!hasFailed)
+        mTest.success('Got all the way through serializations.');
+
+    system.killEntity();
+}
+
+function runFormatTests(format)
+{
+    serializeFormat = format;
     emptyObject();
     emptyArray();
     emptyFunction();
@@ -38,18 +59,75 @@ function runTests()
 
     undefinedObject();
     nullObject();
-    
-    if (!hasFailed)
-        mTest.success('Got all the way through serializations.');
+}
 
-    system.killEntity();
+//deserialize accepts either format, regardless of the default
+function mixedFormats()
+{
+    var toSerialize = {'a': [1, -2, 3.5, 'four'], 'b': {'c': null}};
+    toSerialize.b.d = toSerialize;
+
+    var fromBinary = system.deserialize(system.serialize(toSerialize, 'binary'));
+    var fromPBJ    = system.deserialize(system.serialize(toSerialize, 'pbj'));
+    compareObjs(toSerialize, fromBinary, 'mixedFormats binary');
+    compareObjs(toSerialize, fromPBJ, 'mixedFormats pbj');
+    if (fromBinary.b.d !== fromBinary)
+        failed('error serializing looped object in binary format.  loop was not restored.');
+}
+
+//binary data nested deeper than the decoder's limit (64) is rejected
+//instead of overflowing the stack
+function deeplyNested()
+{
+    //magic and version bytes
+    var header = system.serialize(null, 'binary').substr(0, 2);
+    //an array with a single field named '0' and, at the bottom, null
+    var arrayStart = String.fromCharCode(9, 1, 1) + '0';
+    var nullValue = String.fromCharCode(1);
+    function nested(depth)
+    {
+        var parts = [header];
+        for (var i = 0; i < depth; ++i)
+            parts.push(arrayStart);
+        parts.push(nullValue);
+        return parts.join('');
+    }
+
+    try
+    {
+        var deserialized = system.deserialize(nested(64));
+        for (var i = 0; i < 64; ++i)
+            deserialized = deserialized[0];
+        if (deserialized !== null)
+            failed('error deserializing nested arrays.  innermost value was not restored.');
+    }
+    catch(excep)
+    {
+        failed('error deserializing arrays nested at the limit.  here is exception: ' + excep.toString());
+    }
+
+    var depths = [65, 300000];
+    for (var d in depths)
+    {
+        var threw = false;
+        try
+        {
+            system.deserialize(nested(depths[d]));
+        }
+        catch(excep)
+        {
+            threw = true;
+        }
+        if (!threw)
+            failed('error deserializing arrays nested ' + depths[d] + ' deep.  should have been rejected.');
+    }
 }
 
 //testSerialize empty object
 function emptyObject()
 {
     var empty = {};
-    var serialized   = system.serialize(empty);
+    var serialized   = serialize(empty);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'object' )
@@ -65,7 +143,7 @@ function emptyObject()
 function emptyArray()
 {
     var empty = [];
-    var serialized   = system.serialize(empty);
+    var serialized   = serialize(empty);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'object' )
@@ -104,7 +182,7 @@ function emptyFunction()
 {
     var empty = function(){};
     var prevAsString = empty.toString();
-    var serialized   = system.serialize(empty);
+    var serialized   = serialize(empty);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'function' )
@@ -125,7 +203,7 @@ function emptyFunction()
 function basicFunction()
 {
     var toSerialize  = function(a,b){ return a+b;};
-    var serialized   = system.serialize(toSerialize);
+    var serialized   = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'function')
@@ -152,7 +230,7 @@ function populatedObject()
                         '6': -1.3,
                         '7': function (a,b){ return a+b;}};
 
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'object')
@@ -194,7 +272,7 @@ function nestedObject()
                               }
                       };
 
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'object')
@@ -233,7 +311,7 @@ function loopedObject()
     toSerialize['a'] = toSerialize;
     toSerialize['1']['b'] = toSerialize;
     
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) != 'object')
@@ -259,7 +337,7 @@ function loopedObject()
 function populatedArray()
 {
     var toSerialize = [1,2,3,{},'abcd',false,true];
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
     
 
@@ -277,7 +355,7 @@ function funcWithFields()
     toSerialize.f2  = 3;
     toSerialize.f3  = toSerialize;
 
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(toSerialize) !== typeof(deserialized))
@@ -315,7 +393,7 @@ function prototypeObject()
     };
 
     var toSerialize = new SomeConstructor();
-    var serialized = system.serialize(toSerialize);
+    var serialized = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
     
 
@@ -349,7 +427,7 @@ function prototypeChain()
     c.__proto__ = {}; //default object
 
 
-    var serialized = system.serialize(a);
+    var serialized = serialize(a);
     var deserialized = system.deserialize(serialized);
     if (deserialized.field !== a.field)
         failed('error serializing and deserializng chained prototypes.');
@@ -358,7 +436,7 @@ function prototypeChain()
 function undefinedObject()
 {
     var toSerialize  = undefined;
-    var serialized   = system.serialize(toSerialize);
+    var serialized   = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (typeof(deserialized) !== 'undefined')
@@ -368,7 +446,7 @@ function undefinedObject()
 function nullObject()
 {
     var toSerialize  = null;
-    var serialized   = system.serialize(toSerialize);
+    var serialized   = serialize(toSerialize);
     var deserialized = system.deserialize(serialized);
 
     if (deserialized !== null)
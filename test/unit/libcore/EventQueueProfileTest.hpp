@@ -0,0 +1,126 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/EventQueueProfile.hpp>
+
+using namespace Sirikata;
+using Network::EventQueueProfile;
+
+class EventQueueProfileTest : public CxxTest::TestSuite {
+    Network::IOService* ios;
+    Network::IOStrand* strand;
+
+    static void noop() {}
+
+public:
+    void setUp() {
+        ios = new Network::IOService("EventQueueProfileTest");
+        strand = ios->createStrand("EventQueueProfileTest Strand");
+    }
+    void tearDown() {
+        EventQueueProfile::setEnabled(false);
+        delete strand; strand = NULL;
+        delete ios; ios = NULL;
+    }
+
+    void testHistogramBuckets() {
+        typedef EventQueueProfile::Histogram Histogram;
+        TS_ASSERT_EQUALS(Histogram::bucket(Duration::zero()), (uint32)0);
+        TS_ASSERT_EQUALS(Histogram::bucket(Duration::microseconds((int64)1)), (uint32)1);
+        TS_ASSERT_EQUALS(Histogram::bucket(Duration::microseconds((int64)3)), (uint32)2);
+        TS_ASSERT_EQUALS(Histogram::bucket(Duration::microseconds((int64)4)), (uint32)3);
+        TS_ASSERT_EQUALS(Histogram::bucket(Duration::seconds(1000000.0)), (uint32)(Histogram::NumBuckets-1));
+        // Every sample must be below the upper bound of its bucket
+        for(int64 us = 0; us < 5000; us += 7) {
+            Duration d = Duration::microseconds(us);
+            TS_ASSERT_LESS_THAN(d, Histogram::bucketUpperBound(Histogram::bucket(d)));
+        }
+    }
+
+    void testHistogramStats() {
+        EventQueueProfile::Histogram hist;
+        TS_ASSERT_EQUALS(hist.count(), (uint64)0);
+        TS_ASSERT_EQUALS(hist.percentile(50), Duration::zero());
+
+        for(int i = 0; i < 99; i++)
+            hist.sample(Duration::microseconds((int64)10));
+        hist.sample(Duration::milliseconds((int64)10));
+
+        TS_ASSERT_EQUALS(hist.count(), (uint64)100);
+        TS_ASSERT_EQUALS(hist.mean(), Duration::microseconds((int64)(99*10 + 10000)/100));
+        TS_ASSERT_EQUALS(hist.percentile(50), Duration::microseconds((int64)16));
+        TS_ASSERT_EQUALS(hist.percentile(99), Duration::microseconds((int64)16));
+        TS_ASSERT_EQUALS(hist.percentile(100), Duration::microseconds((int64)16384));
+        TS_ASSERT_EQUALS(hist.max(), Duration::microseconds((int64)16384));
+
+        EventQueueProfile::Histogram merged;
+        merged.merge(hist);
+        merged.merge(hist);
+        TS_ASSERT_EQUALS(merged.count(), (uint64)200);
+        TS_ASSERT_EQUALS(merged.mean(), hist.mean());
+
+        hist.clear();
+        TS_ASSERT_EQUALS(hist.count(), (uint64)0);
+    }
+
+    void testDisabledByDefault() {
+        strand->post(&noop, "EventQueueProfileTest::noop");
+        ios->run();
+        TS_ASSERT_EQUALS(strand->profile().queued(), (uint32)0);
+        TS_ASSERT_EQUALS(strand->profile().executed(), (uint32)0);
+        TS_ASSERT(strand->profile().tagProfile("EventQueueProfileTest::noop") == NULL);
+    }
+
+    void testStrandProfile() {
+        static const char* tag = "EventQueueProfileTest::noop";
+        EventQueueProfile::setEnabled(true);
+        for(int i = 0; i < 10; i++)
+            strand->post(&noop, tag);
+        strand->post(Duration::milliseconds((int64)1), &noop, tag);
+        TS_ASSERT_EQUALS(strand->profile().queued(), (uint32)11);
+        ios->run();
+
+        TS_ASSERT_EQUALS(strand->profile().executed(), (uint32)11);
+        const EventQueueProfile::TagProfile* prof = strand->profile().tagProfile(tag);
+        TS_ASSERT(prof != NULL);
+        if (prof == NULL) return;
+        TS_ASSERT_EQUALS(prof->execution.count(), (uint64)11);
+        TS_ASSERT_EQUALS(prof->wait.count(), (uint64)11);
+        TS_ASSERT_EQUALS(prof->slow.read(), (uint32)0);
+
+        strand->profile().reset();
+        TS_ASSERT_EQUALS(prof->execution.count(), (uint64)0);
+        TS_ASSERT_EQUALS(strand->profile().executed(), (uint32)11);
+    }
+
+    void testHandlerOutlivesProfile() {
+        static const char* tag = "EventQueueProfileTest::noop";
+        EventQueueProfile* profile = new EventQueueProfile("EventQueueProfileTest Profile");
+        Network::IOCallback cb = profile->wrap(&noop, tag);
+        TS_ASSERT_EQUALS(profile->queued(), (uint32)1);
+        TS_ASSERT(profile->tagProfile(tag) != NULL);
+        // The wrapped handler still records into the profile's statistics
+        delete profile;
+        cb();
+    }
+
+    void testSlowHandlers() {
+        static const char* tag = "EventQueueProfileTest::noop";
+        Duration old_threshold = EventQueueProfile::slowThreshold();
+        EventQueueProfile::setSlowThreshold(Duration::microseconds((int64)-1));
+        EventQueueProfile::setEnabled(true);
+        ios->post(&noop, tag);
+        ios->run();
+        EventQueueProfile::setSlowThreshold(old_threshold);
+
+        const EventQueueProfile::TagProfile* prof = ios->profile().tagProfile(tag);
+        TS_ASSERT(prof != NULL);
+        if (prof == NULL) return;
+        TS_ASSERT_EQUALS(prof->slow.read(), (uint32)1);
+    }
+};
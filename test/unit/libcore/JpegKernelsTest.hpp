@@ -0,0 +1,39 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/jpeg-arhc/Kernels.hpp>
+#include <vector>
+#include <stdlib.h>
+
+class JpegKernelsTest : public CxxTest::TestSuite
+{
+public:
+    void testFindStuffedByteMatchesScalar( void )
+    {
+        using namespace Sirikata;
+        // Cover every alignment and tail length around the vector widths.
+        std::vector<uint8> buf(256 + 64);
+        srand(42);
+        for (size_t i = 0; i < buf.size(); ++i) {
+            buf[i] = (uint8)(rand() % 0xff);
+        }
+        for (size_t ff = 0; ff < 96; ++ff) {
+            std::vector<uint8> data(buf);
+            data[ff] = 0xff;
+            for (size_t offset = 0; offset < 40; ++offset) {
+                for (size_t len = 0; len < 100; ++len) {
+                    TS_ASSERT_EQUALS(FindStuffedByte(&data[offset], len),
+                                     FindStuffedByteScalar(&data[offset], len));
+                }
+            }
+        }
+        TS_ASSERT_EQUALS(FindStuffedByte(&buf[0], buf.size()), buf.size());
+    }
+
+    void testKernelName( void )
+    {
+        TS_ASSERT(Sirikata::JpegKernelName() != NULL);
+    }
+};
@@ -0,0 +1,104 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/IOTimer.hpp>
+#include <sirikata/core/network/TimerWheel.hpp>
+#include <sirikata/core/util/Timer.hpp>
+
+using namespace Sirikata;
+using Network::TimerWheel;
+
+class TimerWheelTest : public CxxTest::TestSuite {
+    Network::IOService* ios;
+    Network::IOStrand* strand;
+
+    static void record(std::vector<Time>* fired) {
+        fired->push_back(Timer::now());
+    }
+
+public:
+    void setUp() {
+        ios = new Network::IOService("TimerWheelTest");
+        ios->enableTimerWheel(Duration::milliseconds((int64)1));
+        strand = ios->createStrand("TimerWheelTest Strand");
+    }
+    void tearDown() {
+        delete strand; strand = NULL;
+        delete ios; ios = NULL;
+    }
+
+    void testNeverEarly() {
+        std::vector<Time> fired;
+        TimerWheel::Entry entries[20];
+        Time start = Timer::now();
+        for(int i = 0; i < 20; i++)
+            ios->timerWheel()->schedule(&entries[i], Duration::milliseconds((int64)i*3), std::tr1::bind(&record, &fired), strand);
+        TS_ASSERT_EQUALS(ios->timerWheel()->size(), (uint32)20);
+        ios->run();
+
+        TS_ASSERT_EQUALS(fired.size(), (size_t)20);
+        TS_ASSERT_EQUALS(ios->timerWheel()->size(), (uint32)0);
+        // Timers fire in order of expiry and never early
+        for(uint32 i = 0; i < fired.size(); i++)
+            TS_ASSERT(fired[i] - start >= Duration::milliseconds((int64)i*3));
+    }
+
+    void testCascade() {
+        // Use a small slack so the timer starts out in a coarser level
+        Network::IOService* fine = new Network::IOService("TimerWheelTest Fine");
+        fine->enableTimerWheel(Duration::microseconds((int64)10));
+        std::vector<Time> fired;
+        TimerWheel::Entry entry;
+        Time start = Timer::now();
+        fine->timerWheel()->schedule(&entry, Duration::milliseconds((int64)20), std::tr1::bind(&record, &fired));
+        fine->run();
+        TS_ASSERT_EQUALS(fired.size(), (size_t)1);
+        if (!fired.empty())
+            TS_ASSERT(fired[0] - start >= Duration::milliseconds((int64)20));
+        delete fine;
+    }
+
+    void testCancelAndReschedule() {
+        std::vector<Time> fired;
+        TimerWheel::Entry cancelled, rescheduled;
+        TimerWheel* wheel = ios->timerWheel();
+        TS_ASSERT_EQUALS(wheel->schedule(&cancelled, Duration::milliseconds((int64)5), std::tr1::bind(&record, &fired)), (uint32)0);
+        TS_ASSERT_EQUALS(wheel->cancel(&cancelled), (uint32)1);
+        TS_ASSERT_EQUALS(wheel->cancel(&cancelled), (uint32)0);
+
+        wheel->schedule(&rescheduled, Duration::seconds(100.0), std::tr1::bind(&record, &fired));
+        TS_ASSERT_LESS_THAN(Duration::seconds(10.0), wheel->expiresFromNow(&rescheduled));
+        TS_ASSERT_EQUALS(wheel->schedule(&rescheduled, Duration::milliseconds((int64)5), std::tr1::bind(&record, &fired)), (uint32)1);
+        TS_ASSERT_EQUALS(wheel->size(), (uint32)1);
+        ios->run();
+
+        TS_ASSERT_EQUALS(fired.size(), (size_t)1);
+        TS_ASSERT_LESS_THAN(wheel->expiresFromNow(&rescheduled), Duration::zero());
+    }
+
+    void testIOTimerUsesWheel() {
+        std::vector<Time> fired;
+        Network::IOTimerPtr timer = Network::IOTimer::create(strand, std::tr1::bind(&record, &fired));
+        Network::IOTimerPtr cancelled = Network::IOTimer::create(strand, std::tr1::bind(&record, &fired));
+        timer->wait(Duration::milliseconds((int64)2));
+        cancelled->wait(Duration::milliseconds((int64)2));
+        TS_ASSERT_EQUALS(ios->timerWheel()->size(), (uint32)2);
+        TS_ASSERT_EQUALS(cancelled->cancel(), (uint32)1);
+        ios->run();
+        TS_ASSERT_EQUALS(fired.size(), (size_t)1);
+    }
+
+    void testTimedPost() {
+        std::vector<Time> fired;
+        ios->post(Duration::milliseconds((int64)2), std::tr1::bind(&record, &fired));
+        strand->post(Duration::milliseconds((int64)2), std::tr1::bind(&record, &fired));
+        TS_ASSERT_EQUALS(ios->timerWheel()->size(), (uint32)2);
+        ios->run();
+        TS_ASSERT_EQUALS(fired.size(), (size_t)2);
+    }
+};
@@ -0,0 +1,181 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/mesh/Meshdata.hpp>
+#include <sirikata/mesh/ModelsSystemFactory.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+#include <sstream>
+
+using namespace Sirikata;
+using namespace Sirikata::Mesh;
+
+class BinaryModelSystemTest : public CxxTest::TestSuite
+{
+    PluginManager _pmgr;
+    ModelsSystem* _lossless;
+    ModelsSystem* _quantized;
+
+    // A small textured grid with a single instance and a light.
+    MeshdataPtr makeMesh() {
+        MeshdataPtr mesh(new Meshdata());
+        mesh->id = 17;
+        mesh->hasAnimations = false;
+
+        SubMeshGeometry geo;
+        geo.name = "grid";
+        SubMeshGeometry::TextureSet uvs;
+        uvs.stride = 2;
+        const int dim = 8;
+        for(int y = 0; y < dim; y++) {
+            for(int x = 0; x < dim; x++) {
+                geo.positions.push_back(Vector3f(x * 0.5f, y * 0.25f, (float)((x+y) % 3)));
+                geo.normals.push_back(Vector3f(x - 3.5f, y - 3.5f, -2.f).normal());
+                uvs.uvs.push_back(x / (float)dim);
+                uvs.uvs.push_back(y / (float)dim);
+            }
+        }
+        geo.texUVs.push_back(uvs);
+        SubMeshGeometry::Primitive prim;
+        prim.primitiveType = SubMeshGeometry::Primitive::TRIANGLES;
+        prim.materialId = 0;
+        for(int y = 0; y < dim-1; y++) {
+            for(int x = 0; x < dim-1; x++) {
+                unsigned short i = y*dim+x;
+                prim.indices.push_back(i); prim.indices.push_back(i+1); prim.indices.push_back(i+dim);
+                prim.indices.push_back(i+1); prim.indices.push_back(i+dim+1); prim.indices.push_back(i+dim);
+            }
+        }
+        geo.primitives.push_back(prim);
+        geo.recomputeBounds();
+        mesh->geometry.push_back(geo);
+
+        MaterialEffectInfo mat;
+        MaterialEffectInfo::Texture tex;
+        tex.uri = "grid.png";
+        tex.color = Vector4f(1.f, 0.5f, 0.25f, 1.f);
+        tex.texCoord = 0;
+        tex.affecting = MaterialEffectInfo::Texture::DIFFUSE;
+        tex.samplerType = MaterialEffectInfo::Texture::SAMPLER_TYPE_2D;
+        tex.minFilter = MaterialEffectInfo::Texture::SAMPLER_FILTER_LINEAR;
+        tex.magFilter = MaterialEffectInfo::Texture::SAMPLER_FILTER_LINEAR;
+        tex.wrapS = tex.wrapT = tex.wrapU = MaterialEffectInfo::Texture::WRAP_MODE_WRAP;
+        tex.maxMipLevel = 4;
+        tex.mipBias = 0.f;
+        mat.textures.push_back(tex);
+        mat.shininess = 2.f;
+        mat.reflectivity = 0.5f;
+        mesh->materials.push_back(mat);
+        mesh->textures.push_back("grid.png");
+
+        mesh->lights.push_back(LightInfo().setLightPower(12.f).setLightType(LightInfo::SPOTLIGHT));
+
+        Node node(Matrix4x4f::identity());
+        mesh->nodes.push_back(node);
+        mesh->rootNodes.push_back(0);
+
+        GeometryInstance inst;
+        inst.geometryIndex = 0;
+        inst.parentNode = 0;
+        inst.materialBindingMap[0] = 0;
+        mesh->instances.push_back(inst);
+
+        LightInstance linst;
+        linst.lightIndex = 0;
+        linst.parentNode = 0;
+        mesh->lightInstances.push_back(linst);
+
+        mesh->globalTransform = Matrix4x4f::identity();
+        return mesh;
+    }
+
+    MeshdataPtr roundTrip(ModelsSystem* msys, MeshdataPtr mesh, size_t* size_out = NULL) {
+        std::stringstream ss;
+        TS_ASSERT(msys->convertVisual(mesh, "", ss));
+        String encoded = ss.str();
+        if (size_out) *size_out = encoded.size();
+
+        Transfer::DenseDataPtr data(new Transfer::DenseData(encoded));
+        TS_ASSERT(msys->canLoad(data));
+        return std::tr1::dynamic_pointer_cast<Meshdata>(msys->load(data));
+    }
+
+public:
+    void setUp( void )
+    {
+        _pmgr.loadList("mesh-binary");
+        _lossless = ModelsSystemFactory::getSingleton().getConstructor("mesh-binary")("");
+        _quantized = ModelsSystemFactory::getSingleton().getConstructor("mesh-binary-quantized")("");
+    }
+    void tearDown( void )
+    {
+        delete _lossless;
+        delete _quantized;
+        _pmgr.gc();
+    }
+
+    void testLosslessRoundTrip( void ) {
+        MeshdataPtr orig = makeMesh();
+        MeshdataPtr loaded = roundTrip(_lossless, orig);
+        TS_ASSERT_DIFFERS(loaded, MeshdataPtr());
+        if (!loaded) return;
+
+        TS_ASSERT_EQUALS(loaded->id, orig->id);
+        TS_ASSERT_EQUALS(loaded->geometry.size(), 1);
+        const SubMeshGeometry& a = orig->geometry[0];
+        const SubMeshGeometry& b = loaded->geometry[0];
+        TS_ASSERT_EQUALS(b.name, a.name);
+        TS_ASSERT(b.positions == a.positions);
+        TS_ASSERT(b.normals == a.normals);
+        TS_ASSERT(b.texUVs[0].uvs == a.texUVs[0].uvs);
+        TS_ASSERT(b.primitives[0].indices == a.primitives[0].indices);
+        TS_ASSERT_EQUALS(b.aabb.min(), a.aabb.min());
+        TS_ASSERT_EQUALS(b.aabb.max(), a.aabb.max());
+
+        TS_ASSERT(loaded->materials == orig->materials);
+        TS_ASSERT_EQUALS(loaded->textures.size(), 1);
+        TS_ASSERT_EQUALS(loaded->lights.size(), 1);
+        TS_ASSERT_EQUALS(loaded->lights[0].mPower, 12.f);
+        TS_ASSERT_EQUALS(loaded->lights[0].mType, LightInfo::SPOTLIGHT);
+        TS_ASSERT_EQUALS(loaded->instances[0].materialBindingMap.size(), 1);
+        TS_ASSERT_EQUALS(loaded->getInstancedGeometryCount(), 1);
+        TS_ASSERT_EQUALS(loaded->getInstancedLightCount(), 1);
+        TS_ASSERT_EQUALS(loaded->globalTransform, Matrix4x4f::identity());
+    }
+
+    void testQuantizedRoundTrip( void ) {
+        MeshdataPtr orig = makeMesh();
+        size_t lossless_size = 0, quantized_size = 0;
+        roundTrip(_lossless, orig, &lossless_size);
+        MeshdataPtr loaded = roundTrip(_quantized, orig, &quantized_size);
+        TS_ASSERT_DIFFERS(loaded, MeshdataPtr());
+        if (!loaded) return;
+        TS_ASSERT_LESS_THAN(quantized_size, lossless_size);
+
+        const SubMeshGeometry& a = orig->geometry[0];
+        const SubMeshGeometry& b = loaded->geometry[0];
+        TS_ASSERT_EQUALS(b.positions.size(), a.positions.size());
+        TS_ASSERT_EQUALS(b.normals.size(), a.normals.size());
+        for(uint32 i = 0; i < a.positions.size(); i++) {
+            TS_ASSERT_LESS_THAN((b.positions[i] - a.positions[i]).length(), 1e-3f);
+            TS_ASSERT_LESS_THAN((b.normals[i] - a.normals[i]).length(), 1e-3f);
+        }
+        // Index compression is lossless
+        TS_ASSERT(b.primitives[0].indices == a.primitives[0].indices);
+    }
+
+    void testRejectsTruncated( void ) {
+        std::stringstream ss;
+        TS_ASSERT(_lossless->convertVisual(makeMesh(), "", ss));
+        String encoded = ss.str();
+        encoded.resize(encoded.size() / 2);
+
+        Transfer::DenseDataPtr data(new Transfer::DenseData(encoded));
+        TS_ASSERT(_lossless->canLoad(data));
+        TS_ASSERT_EQUALS(_lossless->load(data), VisualPtr());
+
+        Transfer::DenseDataPtr other(new Transfer::DenseData(String("ply\nformat ascii 1.0\n")));
+        TS_ASSERT(!_lossless->canLoad(other));
+    }
+};
@@ -0,0 +1,186 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sirikata/pintoloc/CompactLocUpdate.hpp>
+#include <sirikata/core/network/Message.hpp>
+#include "Protocol_Loc.pbj.hpp"
+
+using namespace Sirikata;
+
+class CompactLocUpdateTest : public CxxTest::TestSuite {
+    static UUID objectID(uint8 n) {
+        uint8 data[UUID::static_size] = { 0 };
+        data[0] = n;
+        return UUID(data, UUID::static_size);
+    }
+
+    // Fills in an update with every property. The position moves a little
+    // each round, everything else stays the same.
+    static void fillUpdate(Protocol::Loc::ILocationUpdate u, uint8 obj, int round) {
+        u.set_object(objectID(obj));
+        u.set_seqno(round * 10 + obj);
+        Protocol::ITimedMotionVector loc = u.mutable_location();
+        loc.set_t(Time::microseconds(1000000 + round * 33000));
+        loc.set_position(Vector3f(100.f + round * 0.37f + obj, -20.f, 5.5f * obj));
+        loc.set_velocity(Vector3f(11.2f, 0.f, -3.f));
+        Protocol::ITimedMotionQuaternion orient = u.mutable_orientation();
+        orient.set_t(Time::microseconds(500000));
+        orient.set_position(Quaternion(Vector3f(0, 1, 0), 0.3f * obj));
+        orient.set_velocity(Quaternion::identity());
+        Protocol::IAggregateBoundingInfo bounds = u.mutable_aggregate_bounds();
+        bounds.set_center_offset(Vector3f(0, 0, 0));
+        bounds.set_center_bounds_radius(0);
+        bounds.set_max_object_size(1.5f);
+        u.set_mesh("meerkat:///test/duck.dae/optimized/0/duck.dae");
+        u.set_physics("");
+    }
+
+    static bool closeQuaternion(const Quaternion& a, const Quaternion& b) {
+        return fabs(a.x-b.x) + fabs(a.y-b.y) + fabs(a.z-b.z) + fabs(a.w-b.w) < 1e-3;
+    }
+
+public:
+    void testRoundTrip() {
+        CompactLocUpdateEncoder encoder(0.001f, 0.001f);
+        CompactLocUpdateDecoder decoder;
+
+        Protocol::Loc::BulkLocationUpdate blu;
+        fillUpdate(blu.add_update(), 1, 0);
+        fillUpdate(blu.add_update(), 2, 0);
+        blu.mutable_update(1).set_epoch(7);
+
+        String data = encoder.encode(blu);
+        TS_ASSERT(CompactLocUpdateDecoder::isCompact(data));
+
+        Protocol::Loc::BulkLocationUpdate out;
+        TS_ASSERT(decoder.decode(data, out));
+        TS_ASSERT_EQUALS(out.update_size(), 2);
+        for(int32 i = 0; i < 2; i++) {
+            const Protocol::Loc::LocationUpdate& a = blu.update(i);
+            const Protocol::Loc::LocationUpdate& b = out.update(i);
+            TS_ASSERT_EQUALS(a.object(), b.object());
+            TS_ASSERT_EQUALS(a.seqno(), b.seqno());
+            TS_ASSERT(b.has_location());
+            TS_ASSERT_EQUALS(a.location().t(), b.location().t());
+            TS_ASSERT((a.location().position() - b.location().position()).length() <= 0.001f);
+            TS_ASSERT((a.location().velocity() - b.location().velocity()).length() <= 0.001f);
+            TS_ASSERT(b.has_orientation());
+            TS_ASSERT(closeQuaternion(a.orientation().position(), b.orientation().position()));
+            TS_ASSERT(b.has_aggregate_bounds());
+            TS_ASSERT_EQUALS(b.aggregate_bounds().max_object_size(), 1.5f);
+            TS_ASSERT_EQUALS(a.mesh(), b.mesh());
+            TS_ASSERT(b.has_physics());
+        }
+        TS_ASSERT(!out.update(0).has_epoch());
+        TS_ASSERT(out.update(1).has_epoch());
+        TS_ASSERT_EQUALS(out.update(1).epoch(), (uint64)7);
+    }
+
+    void testUnchangedPropertiesOmitted() {
+        CompactLocUpdateEncoder encoder(0.001f, 0.001f);
+        CompactLocUpdateDecoder decoder;
+
+        String first, later;
+        for(int round = 0; round < 20; round++) {
+            Protocol::Loc::BulkLocationUpdate blu;
+            fillUpdate(blu.add_update(), 1, round);
+            String data = encoder.encode(blu);
+            if (round == 0) first = data;
+            else later = data;
+
+            Protocol::Loc::BulkLocationUpdate out;
+            TS_ASSERT(decoder.decode(data, out));
+            TS_ASSERT_EQUALS(out.update_size(), 1);
+            const Protocol::Loc::LocationUpdate& b = out.update(0);
+            TS_ASSERT_EQUALS(b.object(), objectID(1));
+            TS_ASSERT((blu.update(0).location().position() - b.location().position()).length() <= 0.001f);
+            // Only the location changes after the first update
+            TS_ASSERT_EQUALS(b.has_orientation(), round == 0);
+            TS_ASSERT_EQUALS(b.has_mesh(), round == 0);
+            TS_ASSERT_EQUALS(b.has_aggregate_bounds(), round == 0);
+        }
+        TS_ASSERT(later.size() < first.size());
+
+        Protocol::Loc::BulkLocationUpdate blu;
+        fillUpdate(blu.add_update(), 1, 20);
+        TS_ASSERT(later.size() * 4 < serializePBJMessage(blu).size());
+    }
+
+    void testPlainUpdates() {
+        // Decoders accept regular BulkLocationUpdates too
+        CompactLocUpdateDecoder decoder;
+        Protocol::Loc::BulkLocationUpdate blu;
+        fillUpdate(blu.add_update(), 3, 0);
+        String data = serializePBJMessage(blu);
+        TS_ASSERT(!CompactLocUpdateDecoder::isCompact(data));
+
+        Protocol::Loc::BulkLocationUpdate out;
+        TS_ASSERT(decoder.decode(data, out));
+        TS_ASSERT_EQUALS(out.update_size(), 1);
+        TS_ASSERT_EQUALS(out.update(0).object(), objectID(3));
+        TS_ASSERT_EQUALS(out.update(0).location().position(), blu.update(0).location().position());
+    }
+
+    void testRemoveAndReadd() {
+        CompactLocUpdateEncoder encoder(0.001f, 0.001f);
+        CompactLocUpdateDecoder decoder;
+
+        Protocol::Loc::BulkLocationUpdate first;
+        fillUpdate(first.add_update(), 1, 0);
+        fillUpdate(first.add_update(), 2, 0);
+        Protocol::Loc::BulkLocationUpdate first_out;
+        TS_ASSERT(decoder.decode(encoder.encode(first), first_out));
+        TS_ASSERT_EQUALS(encoder.objectCount(), (uint32)2);
+        TS_ASSERT_EQUALS(decoder.objectCount(), (uint32)2);
+
+        // The decoder drops the object when it gets the next message
+        encoder.removeObject(objectID(1));
+        TS_ASSERT_EQUALS(encoder.objectCount(), (uint32)1);
+        Protocol::Loc::BulkLocationUpdate second;
+        fillUpdate(second.add_update(), 2, 1);
+        Protocol::Loc::BulkLocationUpdate second_out;
+        TS_ASSERT(decoder.decode(encoder.encode(second), second_out));
+        TS_ASSERT_EQUALS(decoder.objectCount(), (uint32)1);
+        TS_ASSERT_EQUALS(second_out.update_size(), 1);
+        TS_ASSERT_EQUALS(second_out.update(0).object(), objectID(2));
+
+        // A new object reuses the number and the removed one comes back with
+        // all its properties
+        Protocol::Loc::BulkLocationUpdate third;
+        fillUpdate(third.add_update(), 3, 2);
+        fillUpdate(third.add_update(), 1, 2);
+        fillUpdate(third.add_update(), 2, 2);
+        Protocol::Loc::BulkLocationUpdate out;
+        TS_ASSERT(decoder.decode(encoder.encode(third), out));
+        TS_ASSERT_EQUALS(encoder.objectCount(), (uint32)3);
+        TS_ASSERT_EQUALS(decoder.objectCount(), (uint32)3);
+        TS_ASSERT_EQUALS(out.update_size(), 3);
+        if (out.update_size() != 3) return;
+        for(int32 i = 0; i < 3; i++) {
+            TS_ASSERT_EQUALS(out.update(i).object(), third.update(i).object());
+            TS_ASSERT(out.update(i).has_location());
+            TS_ASSERT((out.update(i).location().position() - third.update(i).location().position()).length() < 0.002f);
+        }
+        TS_ASSERT(out.update(1).has_mesh());
+        TS_ASSERT_EQUALS(out.update(1).mesh(), third.update(1).mesh());
+        TS_ASSERT(closeQuaternion(out.update(1).orientation().position(), third.update(1).orientation().position()));
+        // Nothing changed for the object we kept but its position
+        TS_ASSERT(!out.update(2).has_mesh());
+    }
+
+    void testTruncated() {
+        CompactLocUpdateEncoder encoder(0.001f, 0.001f);
+        Protocol::Loc::BulkLocationUpdate blu;
+        fillUpdate(blu.add_update(), 1, 0);
+        String data = encoder.encode(blu);
+
+        for(size_t len = 2; len < data.size(); len++) {
+            CompactLocUpdateDecoder decoder;
+            Protocol::Loc::BulkLocationUpdate out;
+            TS_ASSERT(!decoder.decode(data.substr(0, len), out));
+        }
+    }
+};
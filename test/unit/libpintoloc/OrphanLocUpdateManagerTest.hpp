@@ -0,0 +1,205 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sirikata/pintoloc/OrphanLocUpdateManager.hpp>
+#include <sirikata/core/network/IOService.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/service/Context.hpp>
+
+using namespace Sirikata;
+
+class OrphanLocUpdateManagerTest : public CxxTest::TestSuite {
+    struct SavedUpdate {
+        ObjectReference object;
+        bool fromExisting;
+        bool hasLocation;
+        bool hasMesh;
+        Vector3f position;
+        uint64 locationSeqno;
+        uint32 numIndexIDs;
+    };
+
+    class RecordingListener : public OrphanLocUpdateManager::Listener {
+    public:
+        void onOrphanLocUpdate(const LocUpdate& lu, bool fromExisting) {
+            SavedUpdate s;
+            s.object = lu.object();
+            s.fromExisting = fromExisting;
+            s.hasLocation = lu.has_location();
+            s.hasMesh = lu.has_mesh();
+            s.position = lu.has_location() ? lu.location().position() : Vector3f::zero();
+            s.locationSeqno = lu.has_location() ? lu.location_seqno() : 0;
+            s.numIndexIDs = lu.index_id_size();
+            updates.push_back(s);
+        }
+
+        std::vector<SavedUpdate> updates;
+    };
+
+    // Only carries a location, as most orphaned updates do
+    class LocationOnlyUpdate : public LocUpdate {
+    public:
+        LocationOnlyUpdate(const ObjectReference& o, const Vector3f& pos, uint64 seqno)
+         : mObject(o), mLoc(Time::null(), MotionVector3f(pos, Vector3f::zero())), mSeqno(seqno)
+        {}
+
+        virtual ObjectReference object() const { return mObject; }
+        virtual bool has_epoch() const { return false; }
+        virtual uint64 epoch() const { return 0; }
+        virtual bool has_parent() const { return false; }
+        virtual ObjectReference parent() const { return ObjectReference::null(); }
+        virtual uint64 parent_seqno() const { return 0; }
+        virtual bool has_location() const { return true; }
+        virtual TimedMotionVector3f location() const { return mLoc; }
+        virtual uint64 location_seqno() const { return mSeqno; }
+        virtual bool has_orientation() const { return false; }
+        virtual TimedMotionQuaternion orientation() const { return TimedMotionQuaternion(); }
+        virtual uint64 orientation_seqno() const { return 0; }
+        virtual bool has_bounds() const { return false; }
+        virtual AggregateBoundingInfo bounds() const { return AggregateBoundingInfo(); }
+        virtual uint64 bounds_seqno() const { return 0; }
+        virtual bool has_mesh() const { return false; }
+        virtual String mesh() const { return ""; }
+        virtual uint64 mesh_seqno() const { return 0; }
+        virtual bool has_physics() const { return false; }
+        virtual String physics() const { return ""; }
+        virtual uint64 physics_seqno() const { return 0; }
+        virtual bool has_query_data() const { return false; }
+        virtual String query_data() const { return ""; }
+        virtual uint64 query_data_seqno() const { return 0; }
+        virtual uint32 index_id_size() const { return 2; }
+        virtual ProxIndexID index_id(int32 idx) const { return idx + 5; }
+        virtual uint64 index_id_seqno() const { return mSeqno; }
+    private:
+        ObjectReference mObject;
+        TimedMotionVector3f mLoc;
+        uint64 mSeqno;
+    };
+
+    static SpaceObjectReference objectID(uint8 n) {
+        uint8 data[UUID::static_size] = { 0 };
+        data[0] = n;
+        return SpaceObjectReference(SpaceID(UUID(data, UUID::static_size)), ObjectReference(UUID(data, UUID::static_size)));
+    }
+
+    Network::IOService* _ios;
+    Network::IOStrand* _strand;
+    Context* _ctx;
+    OrphanLocUpdateManager* _orphans;
+
+public:
+    OrphanLocUpdateManagerTest()
+     : _ios(NULL), _strand(NULL), _ctx(NULL), _orphans(NULL)
+    {}
+
+    void setUp() {
+        _ios = new Network::IOService("OrphanLocUpdateManagerTest");
+        _strand = _ios->createStrand("OrphanLocUpdateManagerTest");
+        _ctx = new Context("orphan test", _ios, _strand, NULL, Timer::now());
+        // Never started, tests drive expiration directly
+        _orphans = new OrphanLocUpdateManager(_ctx, _strand, Duration::milliseconds(100));
+    }
+
+    void tearDown() {
+        delete _orphans;
+        delete _ctx;
+        delete _strand;
+        delete _ios;
+    }
+
+    void testInvoke() {
+        RecordingListener listener;
+        _orphans->addOrphanUpdate(objectID(1), LocationOnlyUpdate(objectID(1).object(), Vector3f(1, 0, 0), 3));
+        _orphans->addOrphanUpdate(objectID(2), LocationOnlyUpdate(objectID(2).object(), Vector3f(2, 0, 0), 4));
+        _orphans->addOrphanUpdate(objectID(1), LocationOnlyUpdate(objectID(1).object(), Vector3f(3, 0, 0), 5));
+        SequencedPresenceProperties props;
+        props.setMesh(Transfer::URI("meerkat:///test/duck.dae"), 2);
+        _orphans->addUpdateFromExisting(objectID(1), props);
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)4);
+
+        _orphans->invokeOrphanUpdates1(objectID(1), &listener, false);
+        // In the order they were added
+        TS_ASSERT_EQUALS(listener.updates.size(), (size_t)3);
+        TS_ASSERT_EQUALS(listener.updates[0].object, objectID(1).object());
+        TS_ASSERT_EQUALS(listener.updates[0].position, Vector3f(1, 0, 0));
+        TS_ASSERT_EQUALS(listener.updates[0].locationSeqno, (uint64)3);
+        TS_ASSERT(!listener.updates[0].hasMesh);
+        TS_ASSERT_EQUALS(listener.updates[0].numIndexIDs, (uint32)2);
+        TS_ASSERT_EQUALS(listener.updates[1].position, Vector3f(3, 0, 0));
+        TS_ASSERT_EQUALS(listener.updates[1].locationSeqno, (uint64)5);
+        // Backed up properties report everything
+        TS_ASSERT(listener.updates[2].hasMesh);
+        TS_ASSERT(listener.updates[2].hasLocation);
+
+        // Updates are only delivered once
+        listener.updates.clear();
+        _orphans->invokeOrphanUpdates1(objectID(1), &listener, false);
+        TS_ASSERT(listener.updates.empty());
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)1);
+        TS_ASSERT(!_orphans->empty());
+
+        _orphans->invokeOrphanUpdates1(objectID(2), &listener, false);
+        TS_ASSERT_EQUALS(listener.updates.size(), (size_t)1);
+        TS_ASSERT_EQUALS(listener.updates[0].position, Vector3f(2, 0, 0));
+        TS_ASSERT(_orphans->empty());
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)0);
+    }
+
+    void testReuse() {
+        // Records released by invoking are reused and don't leak old values
+        RecordingListener listener;
+        for(uint32 round = 0; round < 10; round++) {
+            _orphans->addOrphanUpdate(objectID(1), LocationOnlyUpdate(objectID(1).object(), Vector3f((float32)round, 0, 0), round));
+            _orphans->invokeOrphanUpdates1(objectID(1), &listener, false);
+            SequencedPresenceProperties props;
+            _orphans->addUpdateFromExisting(objectID(1), props);
+            _orphans->invokeOrphanUpdates1(objectID(1), &listener, true);
+        }
+        TS_ASSERT_EQUALS(listener.updates.size(), (size_t)20);
+        for(uint32 round = 0; round < 10; round++) {
+            const SavedUpdate& s = listener.updates[round*2];
+            TS_ASSERT(!s.fromExisting);
+            TS_ASSERT_EQUALS(s.position, Vector3f((float32)round, 0, 0));
+            TS_ASSERT(!s.hasMesh);
+            TS_ASSERT(listener.updates[round*2+1].hasMesh);
+        }
+        TS_ASSERT(_orphans->empty());
+
+        // Expiring entries for records that have been reused leaves the new
+        // updates alone
+        _orphans->addOrphanUpdate(objectID(2), LocationOnlyUpdate(objectID(2).object(), Vector3f(2, 0, 0), 1));
+        _orphans->expire(_ctx->simTime() + Duration::seconds(1));
+        TS_ASSERT(_orphans->empty());
+    }
+
+    void testExpire() {
+        RecordingListener listener;
+        _orphans->addOrphanUpdate(objectID(1), LocationOnlyUpdate(objectID(1).object(), Vector3f(1, 0, 0), 1));
+        _orphans->addOrphanUpdate(objectID(2), LocationOnlyUpdate(objectID(2).object(), Vector3f(2, 0, 0), 1));
+
+        // Nothing has timed out yet
+        _orphans->expire(_ctx->simTime());
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)2);
+
+        Timer::sleep(Duration::milliseconds(150));
+        _orphans->addOrphanUpdate(objectID(1), LocationOnlyUpdate(objectID(1).object(), Vector3f(3, 0, 0), 2));
+        _orphans->expire(_ctx->simTime());
+        // Only the newer update is left
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)1);
+        _orphans->invokeOrphanUpdates1(objectID(2), &listener, false);
+        TS_ASSERT(listener.updates.empty());
+        _orphans->invokeOrphanUpdates1(objectID(1), &listener, false);
+        TS_ASSERT_EQUALS(listener.updates.size(), (size_t)1);
+        TS_ASSERT_EQUALS(listener.updates[0].position, Vector3f(3, 0, 0));
+
+        // Expiring well past the wheel's span still finds everything
+        for(uint8 i = 0; i < 100; i++)
+            _orphans->addOrphanUpdate(objectID(i), LocationOnlyUpdate(objectID(i).object(), Vector3f(i, 0, 0), 3));
+        _orphans->expire(_ctx->simTime() + Duration::seconds(60));
+        TS_ASSERT(_orphans->empty());
+        TS_ASSERT_EQUALS(_orphans->size(), (uint32)0);
+    }
+};
@@ -0,0 +1,115 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+
+#include <sirikata/proxyobject/ProxyObject.hpp>
+#include <sirikata/proxyobject/ProxyManager.hpp>
+
+using namespace Sirikata;
+
+class ProxyManagerTest : public CxxTest::TestSuite {
+    class BatchCounter : public ProxyUpdateBatchListener {
+    public:
+        BatchCounter() : batches(0) {}
+
+        virtual void onProxiesUpdated(ProxyManagerPtr pm, const ProxyChangeList& changes) {
+            batches++;
+            last = changes;
+        }
+
+        uint32 batches;
+        ProxyChangeList last;
+    };
+
+    static SpaceObjectReference objectID(uint8 n) {
+        uint8 data[UUID::static_size] = { 0 };
+        data[0] = n;
+        return SpaceObjectReference(SpaceID::null(), ObjectReference(UUID(data, UUID::static_size)));
+    }
+
+    static ProxyObjectPtr create(ProxyManagerPtr pm, uint8 n, uint64 seqno) {
+        return pm->createObject(
+            objectID(n),
+            TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(n, 0, 0), Vector3f(0, 0, 0))),
+            TimedMotionQuaternion(Time::null(), MotionQuaternion(Quaternion::identity(), Quaternion::identity())),
+            AggregateBoundingInfo(Vector3f(0, 0, 0), 0.f, 1.f),
+            Transfer::URI(), "", false, seqno
+        );
+    }
+
+public:
+    void testCreateDestroyReuse() {
+        ProxyManagerPtr pm = ProxyManager::construct(VWObjectPtr(), objectID(0));
+
+        ProxyObjectPtr a = create(pm, 1, 1);
+        ProxyObjectPtr b = create(pm, 2, 1);
+        TS_ASSERT_EQUALS(pm->size(), 2);
+        TS_ASSERT_EQUALS(pm->activeSize(), 2);
+        TS_ASSERT_EQUALS(pm->getProxyObject(objectID(1)), a);
+
+        // Destroyed but still referenced: recreating returns the same proxy
+        pm->destroyObject(a);
+        TS_ASSERT_EQUALS(pm->activeSize(), 1);
+        TS_ASSERT(!pm->getProxyObject(objectID(1)));
+        TS_ASSERT_EQUALS(create(pm, 1, 2), a);
+        TS_ASSERT_EQUALS(pm->activeSize(), 2);
+
+        // Once the last reference goes away the entry is gone
+        pm->destroyObject(b);
+        b.reset();
+        TS_ASSERT_EQUALS(pm->size(), 1);
+
+        // And new proxies can take its place
+        ProxyObjectPtr c = create(pm, 3, 1);
+        TS_ASSERT_EQUALS(pm->size(), 2);
+        TS_ASSERT_EQUALS(pm->getProxyObject(objectID(3)), c);
+        TS_ASSERT(!pm->getProxyObject(objectID(2)));
+
+        std::vector<SpaceObjectReference> refs;
+        pm->getAllObjectReferences(refs);
+        TS_ASSERT_EQUALS(refs.size(), (size_t)2);
+
+        pm->destroy();
+        TS_ASSERT_EQUALS(pm->size(), 0);
+    }
+
+    void testBatchedUpdates() {
+        ProxyManagerPtr pm = ProxyManager::construct(VWObjectPtr(), objectID(0));
+        ProxyObjectPtr a = create(pm, 1, 1);
+        ProxyObjectPtr b = create(pm, 2, 1);
+
+        BatchCounter counter;
+        pm->addBatchListener(&counter);
+        pm->flushUpdates();
+        TS_ASSERT_EQUALS(counter.batches, (uint32)0);
+
+        // Several changes to one proxy are reported once, with all the parts
+        a->setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(5, 0, 0), Vector3f(0, 0, 0))), 2);
+        a->setBounds(AggregateBoundingInfo(Vector3f(0, 0, 0), 0.f, 2.f), 2);
+        a->setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(6, 0, 0), Vector3f(0, 0, 0))), 3);
+        // Stale updates don't count
+        b->setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(6, 0, 0), Vector3f(0, 0, 0))), 0);
+        pm->flushUpdates();
+        TS_ASSERT_EQUALS(counter.batches, (uint32)1);
+        TS_ASSERT_EQUALS(counter.last.size(), (size_t)1);
+        TS_ASSERT_EQUALS(counter.last[0].proxy, a);
+        TS_ASSERT_EQUALS(counter.last[0].parts,
+            (uint32)((1 << SequencedPresenceProperties::LOC_POS_PART) | (1 << SequencedPresenceProperties::LOC_BOUNDS_PART)));
+
+        // Destroyed proxies are left out
+        b->setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(7, 0, 0), Vector3f(0, 0, 0))), 2);
+        pm->destroyObject(b);
+        pm->flushUpdates();
+        TS_ASSERT_EQUALS(counter.batches, (uint32)1);
+
+        // Nothing is collected once the listener is removed
+        pm->removeBatchListener(&counter);
+        a->setLocation(TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(8, 0, 0), Vector3f(0, 0, 0))), 4);
+        pm->flushUpdates();
+        TS_ASSERT_EQUALS(counter.batches, (uint32)1);
+
+        pm->destroy();
+    }
+};
@@ -0,0 +1,303 @@
+#!/usr/bin/env python
+
+# This script runs an end-to-end benchmark of a space on this machine: a
+# pinto manager, a single space server using the local OSeg and uniform
+# CSeg, and a simoh object host running the 'benchmark' scenario, all
+# talking over loopback. It runs a matrix of configurations (object count,
+# ping rate, fraction of objects with queries, loc update channel, whether
+# proximity results are sent per querier or batched per object host) and writes
+# a JSON report with the delivered message and loc update rates, end-to-end
+# latency and time to first proximity result measured by simoh, plus the CPU
+# time used by each process and thread and the loopback bytes sent per loc
+# update and the space server's proximity statistics, so results can be
+# compared between builds.
+
+import server
+import os
+import os.path
+import sys
+import time
+import json
+import itertools
+import httplib, socket
+from optparse import OptionParser
+
+port_base = 6666
+pinto_port = 6665
+http_command_port = 9000
+
+region = '<<-1000,-1000,-1000>,<1000,1000,1000>>'
+layout = '<1,1,1>'
+
+clock_ticks = os.sysconf(os.sysconf_names['SC_CLK_TCK'])
+
+
+def command(port, name, params=None, retries=1, wait=0.25):
+    '''Run an HTTP command against a process, returning the decoded
+    response or None on failure.'''
+    for attempt in range(retries):
+        try:
+            conn = httplib.HTTPConnection('localhost', port, timeout=5)
+            body = (params and json.dumps(params)) or None
+            conn.request("POST", "/" + name, body=body)
+            resp = conn.getresponse()
+            result = None
+            if resp.status == 200:
+                result = json.loads(resp.read())
+            conn.close()
+            return result
+        except socket.error:
+            time.sleep(wait)
+        except httplib.HTTPException:
+            return None
+    return None
+
+
+def read_cpu(pid):
+    '''Get the CPU time, in seconds, used by a process and each of its
+    threads, as (total, {tid : (name, seconds)}). Only supported on
+    Linux, returns None elsewhere or if the process has exited.'''
+    def parse_stat(path):
+        with open(path) as f:
+            data = f.read()
+        # The name is in parens and may contain spaces
+        name = data[data.index('(')+1:data.rindex(')')]
+        fields = data[data.rindex(')')+2:].split()
+        # utime and stime are the 14th and 15th fields overall
+        return name, (int(fields[11]) + int(fields[12])) / float(clock_ticks)
+
+    try:
+        total = parse_stat('/proc/%d/stat' % pid)[1]
+        threads = {}
+        for tid in os.listdir('/proc/%d/task' % pid):
+            threads[tid] = parse_stat('/proc/%d/task/%s/stat' % (pid, tid))
+        return (total, threads)
+    except (IOError, OSError):
+        return None
+
+
+def read_loopback_bytes():
+    '''Get the number of bytes sent over the loopback interface so far, or
+    None if it isn't available. Only supported on Linux.'''
+    try:
+        with open('/proc/net/dev') as f:
+            for line in f:
+                if ':' not in line: continue
+                iface, data = line.split(':', 1)
+                if iface.strip() != 'lo': continue
+                # Receive fields come first, tx bytes is the 9th field
+                return int(data.split()[8])
+    except (IOError, OSError, ValueError, IndexError):
+        pass
+    return None
+
+
+def cpu_report(start, end, elapsed):
+    if start is None or end is None: return None
+    threads = []
+    for tid, (name, secs) in end[1].iteritems():
+        before = (tid in start[1] and start[1][tid][1]) or 0
+        threads.append({ 'tid' : int(tid), 'name' : name, 'seconds' : secs - before })
+    threads.sort(key=lambda t: -t['seconds'])
+    return {
+        'seconds' : end[0] - start[0],
+        'utilization' : (end[0] - start[0]) / elapsed,
+        'threads' : threads
+        }
+
+
+def terminate(processes):
+    for ps in processes:
+        if ps.poll() is None: ps.terminate()
+    for x in range(100):
+        if all([ps.poll() is not None for ps in processes]): return
+        time.sleep(0.1)
+    for ps in processes:
+        if ps.poll() is None: ps.kill()
+
+
+def run_one(objects, rate, query_frac, loc_channel, loc_encoding, prox_results, run_dir, **kwargs):
+    if not os.path.exists(run_dir): os.makedirs(run_dir)
+    app_kwargs = { 'sirikata_path' : kwargs['sirikata_path'], 'save_log' : run_dir }
+
+    servermap = os.path.join(run_dir, 'servermap.txt')
+    with open(servermap, 'w') as f:
+        print >>f, 'localhost:' + str(port_base) + ':' + str(port_base+1)
+
+    common = [
+        '--servermap=tabular',
+        '--servermap-options=--filename=' + servermap,
+        '--layout=' + layout,
+        '--region=' + region,
+        ]
+
+    processes = {}
+    try:
+        if kwargs['pinto']:
+            processes['pinto'] = server.RunPinto([
+                    '--port=' + str(pinto_port),
+                    '--handler=rtreecut',
+                    ], **app_kwargs)
+
+        space_args = common + [
+            '--id=1',
+            '--oseg=local',
+            '--cseg=uniform',
+            '--command.commander=http',
+            '--command.commander-options=--port=' + str(http_command_port),
+            '--loc-update-options=--loc.channel=' + loc_channel + ' --loc.encoding=' + loc_encoding,
+            '--prox.object-host-results=' + ((prox_results == 'oh') and 'true' or 'false'),
+            ]
+        if kwargs['pinto']:
+            space_args += [
+                '--pinto=master',
+                '--pinto-options=--host=localhost --port=' + str(pinto_port)
+                ]
+        if kwargs['space_config']:
+            space_args += [ '--cfg=' + kwargs['space_config'] ]
+        processes['space'] = server.RunSpace(1, space_args, **app_kwargs)
+
+        if command(http_command_port, 'meta.commands', retries=80) is None:
+            print >>sys.stderr, 'Space server never became responsive'
+            return None
+
+        report_file = os.path.join(run_dir, 'simoh-report.json')
+        if os.path.exists(report_file): os.remove(report_file)
+        processes['simoh'] = server.RunSimOH(1, common + [
+                '--ohid=1',
+                '--duration=%ds' % (kwargs['duration']),
+                '--object.num.random=%d' % (objects),
+                '--object.query-frac=%f' % (query_frac),
+                '--object.connect=%ds' % (kwargs['connect']),
+                '--scenario=benchmark',
+                '--scenario-options=--num-pings-per-second=%d --warmup=%ds --report-file=%s' % (rate, kwargs['warmup'], report_file),
+                ], **app_kwargs)
+
+        # Sample CPU use over the measured part of the run. simoh's last
+        # sample is taken while polling since it exits on its own.
+        time.sleep(kwargs['connect'] + kwargs['warmup'])
+        start_time = time.time()
+        cpu_start = dict([(name, read_cpu(ps.pid)) for name, ps in processes.iteritems()])
+        cpu_end = dict(cpu_start)
+        lo_start = read_loopback_bytes()
+        lo_end = lo_start
+        end_time = start_time
+        while processes['simoh'].poll() is None:
+            sample = read_cpu(processes['simoh'].pid)
+            if sample is not None:
+                cpu_end['simoh'] = sample
+                lo_end = read_loopback_bytes()
+                end_time = time.time()
+            time.sleep(0.5)
+        for name, ps in processes.iteritems():
+            if name != 'simoh': cpu_end[name] = read_cpu(ps.pid)
+        elapsed = max(end_time - start_time, 0.001)
+
+        strands = command(http_command_port, 'context.report-all-stats')
+        prox_stats = command(http_command_port, 'space.prox.stats')
+
+        if not os.path.exists(report_file):
+            print >>sys.stderr, 'simoh did not write a report, check the logs in', run_dir
+            return None
+        with open(report_file) as f:
+            simoh_report = json.load(f)
+
+        # This includes all other traffic, but loc updates dominate when
+        # objects move and the ping rate is low
+        loc_received = simoh_report.get('loc', {}).get('received', 0)
+        bytes_per_update = None
+        if lo_start is not None and lo_end is not None and loc_received > 0:
+            bytes_per_update = (lo_end - lo_start) / float(loc_received)
+
+        return {
+            'objects' : objects,
+            'rate' : rate,
+            'query_frac' : query_frac,
+            'loc_channel' : loc_channel,
+            'loc_encoding' : loc_encoding,
+            'prox_results' : prox_results,
+            'results' : simoh_report,
+            'loopback' : {
+                'bytes' : (lo_start is not None and lo_end is not None and lo_end - lo_start) or None,
+                'bytes_per_loc_update' : bytes_per_update
+                },
+            'cpu' : dict([(name, cpu_report(cpu_start[name], cpu_end[name], elapsed)) for name in processes]),
+            'ioservices' : strands and strands.get('ioservices'),
+            'prox' : prox_stats
+            }
+    finally:
+        terminate(processes.values())
+
+
+def print_summary(runs):
+    print
+    print '%8s %8s %6s %9s %7s %5s | %10s %10s %10s | %10s %10s | %10s %10s %10s | %8s' % ('objects', 'rate', 'query', 'channel', 'enc', 'prox', 'pings/s', 'p50 ms', 'p99 ms', 'prox p50', 'prox p99', 'loc/s', 'B/update', 'lo MB', 'space %')
+    for run in runs:
+        r = run['results']
+        space_cpu = run['cpu'].get('space')
+        print '%8d %8d %6.2f %9s %7s %5s | %10.1f %10.2f %10.2f | %10.2f %10.2f | %10.1f %10.1f %10.2f | %8.1f' % (
+            run['objects'], run['rate'], run['query_frac'], run['loc_channel'], run['loc_encoding'], run['prox_results'],
+            r['pings']['rate'], r['pings']['latency']['p50'], r['pings']['latency']['p99'],
+            r['prox']['first_result']['p50'], r['prox']['first_result']['p99'],
+            r.get('loc', {}).get('rate', 0), run['loopback']['bytes_per_loc_update'] or 0,
+            (run['loopback']['bytes'] or 0) / 1048576.0,
+            (space_cpu and space_cpu['utilization'] * 100) or 0)
+
+
+def int_list(s): return [int(x) for x in s.split(',')]
+def float_list(s): return [float(x) for x in s.split(',')]
+
+parser = OptionParser()
+parser.add_option("--sirikata", help="Path to sirikata binaries", action="store", type="str", dest="sirikata_path", default=None)
+parser.add_option("--objects", help="Comma separated list of object counts", action="store", type="str", dest="objects", default="100,1000")
+parser.add_option("--rates", help="Comma separated list of ping rates (pings/s)", action="store", type="str", dest="rates", default="1000,10000")
+parser.add_option("--query-fracs", help="Comma separated list of fractions of objects with queries", action="store", type="str", dest="query_fracs", default="0.1")
+parser.add_option("--loc-channels", help="Comma separated list of channels the space sends loc updates over (stream, datagram, substream)", action="store", type="str", dest="loc_channels", default="stream")
+parser.add_option("--loc-encodings", help="Comma separated list of encodings for loc updates (pbj, compact). 'compact' only applies to the stream channel", action="store", type="str", dest="loc_encodings", default="pbj")
+parser.add_option("--prox-results", help="Comma separated list of how the space sends object query results (querier, oh). 'oh' batches them per object host; use a dense crowd, e.g. a high --query-fracs, to exercise it", action="store", type="str", dest="prox_results", default="querier")
+parser.add_option("--duration", help="Length of each run in seconds", action="store", type="int", dest="duration", default=60)
+parser.add_option("--connect", help="Seconds to spread object connections over", action="store", type="int", dest="connect", default=5)
+parser.add_option("--warmup", help="Seconds after connecting before measuring", action="store", type="int", dest="warmup", default=5)
+parser.add_option("--no-pinto", help="Don't run a pinto manager", action="store_false", dest="pinto", default=True)
+parser.add_option("--space-config", help="Extra configuration file to load on the space server", action="store", type="string", dest="space_config", default=None)
+parser.add_option("--output-dir", help="Directory for logs and the report", action="store", type="str", dest="output_dir", default="loopback-bench")
+parser.add_option("--report", help="Filename of the JSON report, relative to the output directory", action="store", type="str", dest="report", default="report.json")
+
+(options, args) = parser.parse_args()
+
+if options.duration <= options.connect + options.warmup:
+    print >>sys.stderr, '--duration must be longer than --connect plus --warmup'
+    sys.exit(1)
+
+for loc_encoding in options.loc_encodings.split(','):
+    if loc_encoding not in ('pbj', 'compact'):
+        print >>sys.stderr, 'Unknown --loc-encodings value', loc_encoding
+        sys.exit(1)
+
+for prox_results in options.prox_results.split(','):
+    if prox_results not in ('querier', 'oh'):
+        print >>sys.stderr, 'Unknown --prox-results value', prox_results
+        sys.exit(1)
+
+runs = []
+failed = 0
+for objects, rate, query_frac, loc_channel, loc_encoding, prox_results in itertools.product(int_list(options.objects), int_list(options.rates), float_list(options.query_fracs), options.loc_channels.split(','), options.loc_encodings.split(','), options.prox_results.split(',')):
+    run_dir = os.path.join(options.output_dir, 'objects%d-rate%d-query%g-loc%s-%s-prox%s' % (objects, rate, query_frac, loc_channel, loc_encoding, prox_results))
+    result = run_one(objects, rate, query_frac, loc_channel, loc_encoding, prox_results, run_dir,
+                     sirikata_path=options.sirikata_path,
+                     duration=options.duration,
+                     connect=options.connect,
+                     warmup=options.warmup,
+                     pinto=options.pinto,
+                     space_config=options.space_config)
+    if result is None:
+        failed += 1
+    else:
+        runs.append(result)
+
+if not os.path.exists(options.output_dir): os.makedirs(options.output_dir)
+with open(os.path.join(options.output_dir, options.report), 'w') as f:
+    json.dump({ 'runs' : runs, 'failed' : failed }, f, indent=2)
+
+print_summary(runs)
+sys.exit(failed and 1 or 0)
@@ -61,3 +61,6 @@ def RunCSeg(args, **kwargs):
 
 def RunSpace(ssid, args, **kwargs):
     return RunApp('space_d', ssid, args, **kwargs)
+
+def RunSimOH(ohid, args, **kwargs):
+    return RunApp('simoh_d', ohid, args, **kwargs)